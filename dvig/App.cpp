@@ -1,7 +1,6 @@
 // TODO:
 // * vertex buffer for quad should be 6 vertices, not 4 lol
 // * add color to draw_quad
-// * Texture
 // * draw_quad(), draw_rect() to renderer?
 // * Uniform buffer abstraction. Change fields by name
 // * Abstract shader layout struct
@@ -9,53 +8,128 @@
 // * App::go_fullscreen(), App::toggle_fullscreen()
 // * Rasterizer State
 // * Borderless window fullscreen, Real fullscreen
-// * Camera: Orhographic, Perspective
-// * Core Components, Systems (e.g. Drawable, Input)
-
-// Milestone:
-// Draw a bunch of rects with camera that you can control
 
 #include "pch.h"
 #include "App.h"
 #include "Input.h"
 
 namespace dvig {
-	App::App(const AppSpec& spec) : _app_spec(spec) {}
+	App::App(const AppSpec& spec)
+		: _app_spec(spec), _frame_arena(spec.frame_arena_size),
+		_jobs(spec.job_threads == 0 ? JobSystem::default_worker_count() : spec.job_threads), _systems(&_jobs) {
+		_clock = spec.clock ? spec.clock : Clock(steady_clock_now);
+		_renderer.set_job_system(&_jobs);
+		_renderer.set_frame_arena(&_frame_arena);
+
+		Profiler::get().set_enabled(spec.profiling);
+		Profiler::get().set_thread_name("Main");
+	}
 
 	App::~App() {
-		::DestroyWindow(_hwnd);
+	#ifdef _WIN32
+		if (_hwnd) {
+			::DestroyWindow(_hwnd);
+		}
+	#endif
 	}
 
 	void App::run() {
 		init_self();
 		init();
-		_start_time = std::chrono::high_resolution_clock::now();
+		_start_time = _clock();
+
+		run_frames(0, true);
+		_renderer.wait_idle();
+	}
+
+	void App::run_headless(uint32_t frame_count) {
+		if (!is_headless()) {
+			_app_spec.render_backend = RenderBackendType::Headless;
+		}
+
+		init_self();
+		init();
+		_start_time = _clock();
+
+		if (_app_spec.clock) {
+			if (frame_count > 0) {
+				run_frames(frame_count, false);
+			}
+		} else {
+			assert(_app_spec.fixed_ups != 0);
+			const float fixed_update_dt = 1.0f / _app_spec.fixed_ups;
+			for (uint32_t frame = 0; frame < frame_count && !_should_close; ++frame) {
+				step_frame(1, fixed_update_dt, fixed_update_dt, 0.0f, 0, nullptr);
+			}
+		}
+
+		_renderer.wait_idle();
+	}
+
+	void App::run_frames(uint32_t frame_count, bool paced) {
+		FixedTimestep timestep(_app_spec.fixed_ups, _app_spec.max_fixed_steps_per_frame);
+
+		const bool vsync = paced && _app_spec.pacing == FramePacing::VSync;
+		Unique<FramePacer> pacer;
+		if (paced && _app_spec.pacing == FramePacing::TargetFps) {
+			pacer = std::make_unique<FramePacer>(_clock, _app_spec.target_fps);
+		}
+
+		int64_t last_time = _clock();
+		for (uint32_t frame = 0; (frame_count == 0 || frame < frame_count) && !_should_close; ++frame) {
+			const int64_t now = _clock();
+			const int64_t elapsed = now - last_time;
+			last_time = now;
 
-		float timer = 0;
-		float dt = 0;
+			const uint32_t steps = timestep.advance(elapsed);
+			step_frame(steps, timestep.fixed_dt(), static_cast<float>(elapsed) * 1e-9f, timestep.alpha(), vsync ? 1 : 0, pacer.get());
+		}
+	}
+
+	void App::step_frame(uint32_t fixed_steps, float fixed_dt, float dt, float alpha, uint32_t sync_interval, FramePacer* pacer) {
+		{
+			DVIG_PROFILE_SCOPE("frame");
+			{
+				MemoryTagScope memory_scope(MemoryTag::Input);
+				Input::begin_frame();
+			}
+
+			for (uint32_t step = 0; step < fixed_steps && !_should_close; ++step) {
+				DVIG_PROFILE_SCOPE("fixed_update");
+				fixed_update(fixed_dt);
+				_systems.run(_world, fixed_dt);
+			}
 
-		assert(_app_spec.fixed_ups != 0);
-		const float fixed_update_dt = 1.0f / _app_spec.fixed_ups;
+			{
+				DVIG_PROFILE_SCOPE("update");
+				update(dt);
+			}
 
-		float start_time = get_time();
-		while (!_should_close) {
-			timer += dt;
+			{
+				DVIG_PROFILE_SCOPE("render");
+				GpuProfileScope gpu_scope(_renderer, "render");
+				render(dt, alpha);
+			}
 
-			/* Fixed Update */
-			if (timer >= fixed_update_dt) {
-				// NOTE: We have to save the delta so we can call the fixedUpdate
-				//       function a little bit earlier to compensate the dt lag.
-				//       This is especially important if VSync is on.
-				timer = timer - fixed_update_dt;
-				fixed_update(fixed_update_dt);
+			{
+				DVIG_PROFILE_SCOPE("present");
+				MemoryTagScope memory_scope(MemoryTag::Render);
+				_renderer.present(sync_interval);
 			}
 
-			update(dt);
-			render(dt);
-			_renderer.present(1);
-			dt = get_time() - start_time;
-			start_time = get_time();
+			if (pacer) {
+				DVIG_PROFILE_SCOPE("pacing");
+				pacer->wait();
+			}
 		}
+
+		end_frame();
+	}
+
+	void App::end_frame() {
+		_frame_arena.reset();
+		MemoryTracker::get().end_frame();
+		Profiler::get().end_frame();
 	}
 
 	void App::close() {
@@ -63,8 +137,7 @@ namespace dvig {
 	}
 
 	float App::get_time() {
-		auto current_time = std::chrono::high_resolution_clock::now();
-		return std::chrono::duration_cast<std::chrono::duration<float>>(current_time - _start_time).count();
+		return static_cast<float>(static_cast<double>(_clock() - _start_time) * 1e-9);
 	}
 
 	float App::window_aspect_ratio() const {
@@ -73,11 +146,17 @@ namespace dvig {
 	}
 
 	glm::ivec2 App::window_size() const {
+		if (is_headless()) {
+			return { static_cast<int>(_app_spec.width), static_cast<int>(_app_spec.height) };
+		}
+
 		glm::ivec2 result = {};
+	#ifdef _WIN32
 		RECT client_rect;
 		::GetClientRect(_hwnd, &client_rect);
 		result.x = client_rect.right - client_rect.left;
 		result.y = client_rect.bottom - client_rect.top;
+	#endif
 		return result;
 	}
 
@@ -86,13 +165,32 @@ namespace dvig {
 	}
 
 	void App::init_self() {
-		create_window();
-		Input::init(_hwnd);
-		_renderer.init(_app_spec, _hwnd);
+		if (is_headless()) {
+			if (_app_spec.width == 0) {
+				_app_spec.width = 1280;
+			}
+
+			if (_app_spec.height == 0) {
+				_app_spec.height = 720;
+			}
+
+			_renderer.init(_app_spec, nullptr);
+		} else {
+		#ifdef _WIN32
+			create_window();
+			Input::init(_hwnd);
+			_renderer.init(_app_spec, _hwnd);
+		#else
+			std::cerr << "Only the headless backend is available on this platform!\n";
+			abort();
+		#endif
+		}
+
 		_renderer.compile_core_shaders(*this);
 		_renderer.create_core_vertex_buffers();
 	}
 
+#ifdef _WIN32
 	void App::create_window() {
 		WNDCLASS window_class = { };
 		const wchar_t className[] = L"Dvig Window Class";
@@ -158,4 +256,5 @@ namespace dvig {
 
 		::ShowWindow(_hwnd, SW_SHOW);
 	}
+#endif
 }
@@ -1,6 +1,12 @@
 #pragma once
 #include "pch.h"
 #include "Renderer.h"
+#include "FrameTiming.h"
+#include "Profiler.h"
+#include "World.h"
+#include "Schedule.h"
+#include "JobSystem.h"
+#include "Memory.h"
 
 namespace dvig {
 	struct AppSpec {
@@ -8,6 +14,48 @@ namespace dvig {
 		uint32_t width = 0;
 		uint32_t height = 0;
 		float fixed_ups = 60;
+		// Fixed updates past this many in one frame are dropped, the simulation slows down instead of locking up
+		uint32_t max_fixed_steps_per_frame = 8;
+		FramePacing pacing = FramePacing::VSync;
+		float target_fps = 60; // Only used with FramePacing::TargetFps
+		// Draw calls are recorded and executed on a render thread, so the next frame's update
+		// overlaps this frame's submission and present. Off, they execute in present() on the calling thread
+		bool render_thread = true;
+		uint32_t frames_in_flight = 2; // Recorded frames that can be queued, 2 or 3
+		// Dynamic vertex buffers and uniforms are sub-allocated from per frame upload rings of these sizes (D3D11).
+		// 0 gives every one its own buffer that's discarded on each update
+		uint32_t vertex_upload_ring_size = 8 * 1024 * 1024;
+		uint32_t constant_upload_ring_size = 1024 * 1024;
+		// Textures from Renderer::load_texture are decoded on this many threads (0 is hardware threads - 1)
+		// and uploaded no faster than texture_upload_budget bytes per frame
+		uint32_t texture_load_threads = 0;
+		uint64_t texture_upload_budget = 4 * 1024 * 1024;
+		// Worker threads of App::jobs() besides the main thread (0 is hardware threads - 1, none on a single core)
+		uint32_t job_threads = 0;
+		// First block of App::frame_arena(). A frame that needs more grows it for the next ones
+		size_t frame_arena_size = 1024 * 1024;
+		// Every frame time comes from here. Empty uses steady_clock
+		Clock clock;
+		// Compiled shader bytecode is cached here between runs. Empty disables the cache
+		std::filesystem::path shader_cache_path = "shader_cache";
+		// Turns Profiler scopes and GPU timings on. Off they cost next to nothing
+	#ifdef _DEBUG
+		bool profiling = true;
+	#else
+		bool profiling = false;
+	#endif
+		// Watches shader files and swaps in recompiled versions between frames
+	#ifdef _DEBUG
+		bool shader_hot_reload = true;
+	#else
+		bool shader_hot_reload = false;
+	#endif
+
+	#ifdef _WIN32
+		RenderBackendType render_backend = RenderBackendType::D3D11;
+	#else
+		RenderBackendType render_backend = RenderBackendType::Headless;
+	#endif
 
 		int arg_count = 1;
 		char** args;
@@ -22,17 +70,33 @@ namespace dvig {
 
 		~App();
 
+		// fixed_update runs as often as the elapsed time needs (up to max_fixed_steps_per_frame),
+		// update and render once per frame.
 		void run();
+		// Runs frame_count frames without a window or input.
+		// Uses the headless backend unless a windowless one (e.g. Software) is already set in the spec.
+		// Without AppSpec::clock every frame gets one fixed_update with dt = 1 / fixed_ups, so runs are deterministic.
+		// With it frames are timed like run(), only never paced.
+		void run_headless(uint32_t frame_count);
 		void close();
 		// Returns time since init()
 		float get_time();
 
 		float window_aspect_ratio() const;
 		glm::ivec2 window_size() const;
+		bool is_headless() const { return _app_spec.render_backend != RenderBackendType::D3D11; }
 
 		const Renderer& renderer() const { return _renderer; }
 		Renderer& renderer() { return _renderer; }
 
+		// Shared by everything that runs in parallel, usable from fixed_update, update and render
+		JobSystem& jobs() { return _jobs; }
+		// Systems added to systems() run on world() right after every fixed_update, spread over jobs()
+		World& world() { return _world; }
+		Schedule& systems() { return _systems; }
+		// Scratch memory of the current frame, reset after present. Main thread only
+		FrameArena& frame_arena() { return _frame_arena; }
+
 		std::wstring get_abs_path(std::wstring path) const;
 
 	protected:
@@ -40,19 +104,35 @@ namespace dvig {
 		// Has to return absolute path where dvig project lives.
 		virtual void fixed_update(float fixed_dt) = 0;
 		virtual void update(float dt) = 0;
-		virtual void render(float dt) = 0;
+		// alpha is how far the frame is between the last fixed_update and the next one, 0..1
+		virtual void render(float dt, float alpha) = 0;
 		virtual void init() {}
 
 	private:
 		void init_self();
+		// frame_count 0 runs until close()
+		void run_frames(uint32_t frame_count, bool paced);
+		// Input, fixed_steps fixed updates, update, render, present and the pacer's wait, then end_frame()
+		void step_frame(uint32_t fixed_steps, float fixed_dt, float dt, float alpha, uint32_t sync_interval, FramePacer* pacer);
+		// After the frame presented: resets the frame arena and closes the memory and profiler stats
+		void end_frame();
+	#ifdef _WIN32
 		void create_window();
+	#endif
 
 	private:
 		AppSpec _app_spec;
+	#ifdef _WIN32
 		HWND _hwnd = nullptr;
+	#endif
+		FrameArena _frame_arena; // Outlives the Renderer, which sorts in it
+		JobSystem _jobs;         // Outlives the Renderer too, its backend and workers use it until they're gone
 		Renderer _renderer;
+		World _world;
+		Schedule _systems;
 
 		bool _should_close = false;
-		std::chrono::steady_clock::time_point _start_time; // time since init()
+		Clock _clock;
+		int64_t _start_time = 0; // get_time() counts from here
 	};
 }
@@ -0,0 +1,113 @@
+#include "pch.h"
+#include "Camera.h"
+
+namespace dvig {
+	namespace {
+		glm::vec2 rotate(glm::vec2 v, float radians) {
+			const float c = std::cos(radians);
+			const float s = std::sin(radians);
+			return { c * v.x - s * v.y, s * v.x + c * v.y };
+		}
+	}
+
+	void OrthoCamera::zoom_at(glm::vec2 pixel, float factor) {
+		const glm::vec2 anchor = screen_to_world(pixel);
+		set_zoom(_zoom * factor);
+		move(anchor - screen_to_world(pixel));
+	}
+
+	const glm::mat4& OrthoCamera::view() const {
+		update();
+		return _view;
+	}
+
+	const glm::mat4& OrthoCamera::projection() const {
+		update();
+		return _projection;
+	}
+
+	const glm::mat4& OrthoCamera::view_projection() const {
+		update();
+		return _view_projection;
+	}
+
+	Rect OrthoCamera::view_rect() const {
+		const glm::vec2 half = _viewport_size * (0.5f / _zoom);
+		if (_rotation == 0.0f) {
+			return { _position - half, _position + half };
+		}
+
+		// Bounds of the rotated viewport
+		const float c = std::abs(std::cos(_rotation));
+		const float s = std::abs(std::sin(_rotation));
+		const glm::vec2 extent = { c * half.x + s * half.y, s * half.x + c * half.y };
+		return { _position - extent, _position + extent };
+	}
+
+	glm::vec2 OrthoCamera::screen_to_world(glm::vec2 pixel) const {
+		return _position + rotate((pixel - _viewport_size * 0.5f) / _zoom, _rotation);
+	}
+
+	glm::vec2 OrthoCamera::world_to_screen(glm::vec2 world) const {
+		return rotate(world - _position, -_rotation) * _zoom + _viewport_size * 0.5f;
+	}
+
+	void OrthoCamera::update() const {
+		if (!_view_dirty && !_projection_dirty) {
+			return;
+		}
+
+		if (_view_dirty) {
+			// Pixels relative to the viewport center: zoom * rotate(world - position, -rotation)
+			const float c = std::cos(_rotation) * _zoom;
+			const float s = std::sin(_rotation) * _zoom;
+
+			_view = glm::mat4(1.0f);
+			_view[0] = { c, -s, 0.0f, 0.0f };
+			_view[1] = { s, c, 0.0f, 0.0f };
+			_view[3] = { -(c * _position.x + s * _position.y), s * _position.x - c * _position.y, 0.0f, 1.0f };
+			_view_dirty = false;
+		}
+
+		if (_projection_dirty) {
+			const glm::vec2 half = _viewport_size * 0.5f;
+			_projection = glm::orthoLH(-half.x, half.x, half.y, -half.y, -1.0f, 1.0f);
+			_projection_dirty = false;
+		}
+
+		_view_projection = _projection * _view;
+	}
+
+	const glm::mat4& PerspectiveCamera::view() const {
+		update();
+		return _view;
+	}
+
+	const glm::mat4& PerspectiveCamera::projection() const {
+		update();
+		return _projection;
+	}
+
+	const glm::mat4& PerspectiveCamera::view_projection() const {
+		update();
+		return _view_projection;
+	}
+
+	void PerspectiveCamera::update() const {
+		if (!_view_dirty && !_projection_dirty) {
+			return;
+		}
+
+		if (_view_dirty) {
+			_view = glm::lookAtLH(_position, _target, _up);
+			_view_dirty = false;
+		}
+
+		if (_projection_dirty) {
+			_projection = glm::perspectiveLH(_fov, _aspect_ratio, _near, _far);
+			_projection_dirty = false;
+		}
+
+		_view_projection = _projection * _view;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "pch.h"
+
+namespace dvig {
+	// Axis aligned, world units
+	struct Rect {
+		glm::vec2 min = glm::vec2(0.0f);
+		glm::vec2 max = glm::vec2(0.0f);
+
+		glm::vec2 size() const { return max - min; }
+		glm::vec2 center() const { return (min + max) * 0.5f; }
+		bool contains(glm::vec2 point) const { return point.x >= min.x && point.x <= max.x && point.y >= min.y && point.y <= max.y; }
+		// Touching edges count
+		bool overlaps(const Rect& other) const {
+			return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+		}
+	};
+
+	enum class CameraType {
+		Ortho,
+		Perspective,
+	};
+
+	// 2D camera over a world with y down, the same way draw_rect and draw_quad take pixels.
+	// position is the world point at the center of the viewport, zoom is viewport pixels per world unit.
+	// The matrices are rebuilt on first use after a change, reading them every frame costs nothing.
+	class OrthoCamera {
+	public:
+		OrthoCamera() = default;
+		explicit OrthoCamera(glm::vec2 viewport_size) : _viewport_size(viewport_size) {}
+
+		void set_position(glm::vec2 position) { _position = position; _view_dirty = true; }
+		void move(glm::vec2 offset) { set_position(_position + offset); }
+		void set_zoom(float zoom) { assert(zoom > 0.0f); _zoom = zoom; _view_dirty = true; }
+		// Keeps the world point under the screen pixel where it is, for zooming at the cursor
+		void zoom_at(glm::vec2 pixel, float factor);
+		void set_rotation(float radians) { _rotation = radians; _view_dirty = true; }
+		void set_viewport_size(glm::vec2 size) { _viewport_size = size; _projection_dirty = true; }
+
+		glm::vec2 position() const { return _position; }
+		float zoom() const { return _zoom; }
+		float rotation() const { return _rotation; }
+		glm::vec2 viewport_size() const { return _viewport_size; }
+
+		const glm::mat4& view() const;
+		const glm::mat4& projection() const;
+		const glm::mat4& view_projection() const;
+		// World space bounds of what's visible. Bigger than the viewport when rotated
+		Rect view_rect() const;
+
+		// Pixels from the top left of the viewport
+		glm::vec2 screen_to_world(glm::vec2 pixel) const;
+		glm::vec2 world_to_screen(glm::vec2 world) const;
+
+	private:
+		void update() const;
+
+	private:
+		glm::vec2 _position = glm::vec2(0.0f);
+		float _zoom = 1.0f;
+		float _rotation = 0.0f;
+		glm::vec2 _viewport_size = glm::vec2(1.0f);
+
+		mutable bool _view_dirty = true;
+		mutable bool _projection_dirty = true;
+		mutable glm::mat4 _view = glm::mat4(1.0f);
+		mutable glm::mat4 _projection = glm::mat4(1.0f);
+		mutable glm::mat4 _view_projection = glm::mat4(1.0f);
+	};
+
+	// Left handed, looking from position at target. Same caching as OrthoCamera
+	class PerspectiveCamera {
+	public:
+		void set_position(const glm::vec3& position) { _position = position; _view_dirty = true; }
+		void set_target(const glm::vec3& target) { _target = target; _view_dirty = true; }
+		void set_up(const glm::vec3& up) { _up = up; _view_dirty = true; }
+		void set_fov(float radians) { _fov = radians; _projection_dirty = true; }
+		void set_aspect_ratio(float aspect_ratio) { _aspect_ratio = aspect_ratio; _projection_dirty = true; }
+		void set_clip_planes(float near_plane, float far_plane) { _near = near_plane; _far = far_plane; _projection_dirty = true; }
+
+		const glm::vec3& position() const { return _position; }
+		const glm::vec3& target() const { return _target; }
+		float fov() const { return _fov; }
+		float aspect_ratio() const { return _aspect_ratio; }
+
+		const glm::mat4& view() const;
+		const glm::mat4& projection() const;
+		const glm::mat4& view_projection() const;
+
+	private:
+		void update() const;
+
+	private:
+		glm::vec3 _position = glm::vec3(0.0f, 0.0f, -5.0f);
+		glm::vec3 _target = glm::vec3(0.0f);
+		glm::vec3 _up = glm::vec3(0.0f, 1.0f, 0.0f);
+		float _fov = glm::radians(45.0f);
+		float _aspect_ratio = 16.0f / 9.0f;
+		float _near = 0.1f;
+		float _far = 100.0f;
+
+		mutable bool _view_dirty = true;
+		mutable bool _projection_dirty = true;
+		mutable glm::mat4 _view = glm::mat4(1.0f);
+		mutable glm::mat4 _projection = glm::mat4(1.0f);
+		mutable glm::mat4 _view_projection = glm::mat4(1.0f);
+	};
+}
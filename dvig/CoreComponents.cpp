@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "CoreComponents.h"
+#include "Renderer.h"
+#include "Schedule.h"
+#include "Camera.h"
+#include "Profiler.h"
+
+namespace dvig {
+	void integrate_velocities(World& world, float dt) {
+		world.each_chunk<Transform2D, const Velocity2D>([dt](uint32_t count, const Entity*, Transform2D* transforms, const Velocity2D* velocities) {
+			for (uint32_t i = 0; i < count; ++i) {
+				transforms[i].position += velocities[i].linear * dt;
+				transforms[i].rotation += velocities[i].angular * dt;
+			}
+		});
+	}
+
+	void add_core_systems(Schedule& schedule) {
+		schedule.add(
+			"integrate_velocities",
+			component_mask<Velocity2D>(), component_mask<Transform2D>(),
+			[](World& world, CommandBuffer&, float dt) { integrate_velocities(world, dt); }
+		);
+	}
+
+	void draw_drawables(World& world, Renderer& renderer, const glm::mat4& view_projection) {
+		world.each_chunk<const Transform2D, const Drawable>([&](uint32_t count, const Entity*, const Transform2D* transforms, const Drawable* drawables) {
+			for (uint32_t i = 0; i < count; ++i) {
+				const Transform2D& transform = transforms[i];
+				const Drawable& drawable = drawables[i];
+
+				// The rect's pos is its unrotated top left, the origin has to land on the transform's position
+				const glm::vec2 size = drawable.size * transform.scale;
+				const glm::vec2 pos = transform.position - drawable.origin * size;
+				renderer.draw_rect(pos, size, transform.rotation, drawable.origin, drawable.color, view_projection);
+			}
+		});
+	}
+
+	Rect drawable_bounds(const Transform2D& transform, const Drawable& drawable) {
+		const glm::vec2 size = drawable.size * transform.scale;
+		// Corners relative to the origin, which the rotation keeps in place
+		const glm::vec2 min = -drawable.origin * size;
+		const glm::vec2 max = min + size;
+		if (transform.rotation == 0.0f) {
+			return { transform.position + min, transform.position + max };
+		}
+
+		const float c = std::cos(transform.rotation);
+		const float s = std::sin(transform.rotation);
+		Rect bounds = { glm::vec2(std::numeric_limits<float>::max()), glm::vec2(std::numeric_limits<float>::lowest()) };
+		for (const glm::vec2 corner : { min, max, glm::vec2(min.x, max.y), glm::vec2(max.x, min.y) }) {
+			const glm::vec2 rotated = { c * corner.x - s * corner.y, s * corner.x + c * corner.y };
+			bounds.min = glm::min(bounds.min, rotated);
+			bounds.max = glm::max(bounds.max, rotated);
+		}
+		bounds.min += transform.position;
+		bounds.max += transform.position;
+		return bounds;
+	}
+
+	namespace {
+		uint64_t pack_entity(Entity entity) {
+			return (uint64_t(entity.generation) << 32) | entity.index;
+		}
+
+		Entity unpack_entity(uint64_t user) {
+			Entity entity;
+			entity.index = static_cast<uint32_t>(user);
+			entity.generation = static_cast<uint32_t>(user >> 32);
+			return entity;
+		}
+	}
+
+	void DrawableIndex::sync(World& world) {
+		// Can't add SpatialEntry while the query runs, the entities move archetype
+		_scratch_entities.clear();
+		world.each<const Transform2D, const Drawable>([&](Entity entity, const Transform2D&, const Drawable&) {
+			_scratch_entities.push_back(entity);
+		}, component_mask<SpatialEntry>());
+
+		for (Entity entity : _scratch_entities) {
+			const Rect bounds = drawable_bounds(*world.get<Transform2D>(entity), *world.get<Drawable>(entity));
+			world.add(entity, SpatialEntry{ _grid.insert(bounds, pack_entity(entity)) });
+		}
+
+		world.each_chunk<const Transform2D, const Drawable, const SpatialEntry, const Velocity2D>(
+			[&](uint32_t count, const Entity*, const Transform2D* transforms, const Drawable* drawables, const SpatialEntry* entries, const Velocity2D*) {
+				for (uint32_t i = 0; i < count; ++i) {
+					_grid.update(entries[i].handle, drawable_bounds(transforms[i], drawables[i]));
+				}
+			}
+		);
+	}
+
+	void DrawableIndex::moved(World& world, Entity entity) {
+		const SpatialEntry* entry = world.get<SpatialEntry>(entity);
+		const Transform2D* transform = world.get<Transform2D>(entity);
+		const Drawable* drawable = world.get<Drawable>(entity);
+		if (entry != nullptr && transform != nullptr && drawable != nullptr) {
+			_grid.update(entry->handle, drawable_bounds(*transform, *drawable));
+		}
+	}
+
+	void DrawableIndex::remove(World& world, Entity entity) {
+		if (const SpatialEntry* entry = world.get<SpatialEntry>(entity)) {
+			_grid.remove(entry->handle);
+			world.remove<SpatialEntry>(entity);
+		}
+	}
+
+	uint32_t DrawableIndex::draw(World& world, Renderer& renderer, const OrthoCamera& camera) {
+		DVIG_PROFILE_SCOPE("DrawableIndex::draw");
+
+		const glm::mat4& view_projection = camera.view_projection();
+		uint32_t drawn = 0;
+		_scratch_handles.clear();
+
+		_grid.query(camera.view_rect(), [&](SpatialGrid::Handle handle, uint64_t user) {
+			const Entity entity = unpack_entity(user);
+			const Transform2D* transform = world.get<Transform2D>(entity);
+			const Drawable* drawable = world.get<Drawable>(entity);
+			if (transform == nullptr || drawable == nullptr) {
+				// Destroyed, or lost a component, without remove()
+				_scratch_handles.push_back(handle);
+				return;
+			}
+
+			const glm::vec2 size = drawable->size * transform->scale;
+			const glm::vec2 pos = transform->position - drawable->origin * size;
+			renderer.draw_rect(pos, size, transform->rotation, drawable->origin, drawable->color, view_projection);
+			drawn++;
+		});
+
+		for (SpatialGrid::Handle handle : _scratch_handles) {
+			const Entity entity = unpack_entity(_grid.user(handle));
+			_grid.remove(handle);
+			// Still alive with a Drawable removed, it gets indexed again once it has both
+			if (world.has<SpatialEntry>(entity)) {
+				world.remove<SpatialEntry>(entity);
+			}
+		}
+
+		return drawn;
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "pch.h"
+
+#include "World.h"
+#include "SpatialGrid.h"
+
+namespace dvig {
+	class Renderer;
+	class Schedule;
+	class OrthoCamera;
+
+	struct Transform2D {
+		glm::vec2 position = glm::vec2(0.0f); // Where the Drawable's origin ends up
+		float rotation = 0.0f;                // Radians
+		glm::vec2 scale = glm::vec2(1.0f);
+	};
+
+	// Per second
+	struct Velocity2D {
+		glm::vec2 linear = glm::vec2(0.0f);
+		float angular = 0.0f;
+	};
+
+	// A rect of size (times the transform's scale), rotated around origin (0..1 in rect space)
+	struct Drawable {
+		glm::vec2 size = glm::vec2(1.0f);
+		glm::vec2 origin = glm::vec2(0.5f);
+		glm::vec4 color = glm::vec4(1.0f);
+	};
+
+	// Moves every Transform2D by its Velocity2D
+	void integrate_velocities(World& world, float dt);
+	// Adds "integrate_velocities" to the schedule
+	void add_core_systems(Schedule& schedule);
+
+	// The Drawable system: every entity with a Transform2D and a Drawable becomes one rect of the
+	// instanced rect batch, in storage order. Call it from App::render
+	void draw_drawables(World& world, Renderer& renderer, const glm::mat4& view_projection);
+
+	// World space bounds of the rotated rect
+	Rect drawable_bounds(const Transform2D& transform, const Drawable& drawable);
+
+	// Added by DrawableIndex to what it indexed
+	struct SpatialEntry {
+		SpatialGrid::Handle handle = SpatialGrid::INVALID_HANDLE;
+	};
+
+	// Culled version of draw_drawables: keeps a SpatialGrid over every Transform2D + Drawable and only
+	// submits what overlaps the camera's view rect, so drawing costs what's visible and not the world size.
+	// Keeping the grid current costs the moving entities (the ones with a Velocity2D, and what's passed to moved()).
+	// Destroyed entities drop out when a query next runs into them, remove() them first to free the slot right away
+	class DrawableIndex {
+	public:
+		explicit DrawableIndex(float cell_size = 64.0f) : _grid(cell_size) {}
+
+		// Indexes new drawables and refreshes the ones with a Velocity2D. After the systems ran, before draw()
+		void sync(World& world);
+		// For a Transform2D or Drawable changed outside of a Velocity2D
+		void moved(World& world, Entity entity);
+		void remove(World& world, Entity entity);
+		// Returns how many rects were submitted
+		uint32_t draw(World& world, Renderer& renderer, const OrthoCamera& camera);
+		void clear() { _grid.clear(); }
+
+		const SpatialGrid& grid() const { return _grid; }
+
+	private:
+		SpatialGrid _grid;
+		std::vector<Entity> _scratch_entities;
+		std::vector<SpatialGrid::Handle> _scratch_handles;
+	};
+}
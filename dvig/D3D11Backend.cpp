@@ -0,0 +1,1128 @@
+#include "pch.h"
+#include "D3D11Backend.h"
+
+#ifdef _WIN32
+#include "App.h"
+#include "Utils.h"
+#include "Profiler.h"
+
+namespace dvig {
+	void D3D11Backend::init(const AppSpec& app_spec, void* native_window) {
+		HWND hwnd = static_cast<HWND>(native_window);
+
+		BOOL windowed = TRUE;
+		DXGI_SWAP_CHAIN_DESC swap_chain_desc;
+		{
+			DXGI_MODE_DESC mode_desc = {
+				static_cast<UINT>(app_spec.width),
+				static_cast<UINT>(app_spec.height),
+				DXGI_RATIONAL { 0, 1 },
+				DXGI_FORMAT_R8G8B8A8_UNORM,
+				DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED,
+				DXGI_MODE_SCALING_UNSPECIFIED
+			};
+
+			// The default sampler mode, with no anti-aliasing, has a count of 1 and a quality level of 0.
+			// From https://learn.microsoft.com/en-us/windows/win32/api/dxgicommon/ns-dxgicommon-dxgi_sample_desc
+			DXGI_SAMPLE_DESC sample_desc = {
+				1,
+				0
+			};
+
+			UINT flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+			swap_chain_desc = {
+				mode_desc,
+				sample_desc,
+				DXGI_USAGE_RENDER_TARGET_OUTPUT,
+				2, // Buffer count
+				hwnd,
+				windowed,
+				DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL,
+				flags
+			};
+		}
+
+		UINT flags = 0;
+	#ifdef _DEBUG
+		flags = D3D11_CREATE_DEVICE_DEBUG;
+	#endif
+
+		const D3D_FEATURE_LEVEL feature_levels[] = { D3D_FEATURE_LEVEL_11_0 };
+		D3D_FEATURE_LEVEL feature_level;
+		HRESULT result = D3D11CreateDeviceAndSwapChain(
+			nullptr,
+			D3D_DRIVER_TYPE_HARDWARE,
+			nullptr,
+			flags,
+			feature_levels,
+			1,
+			D3D11_SDK_VERSION,
+			&swap_chain_desc,
+			&_swap_chain,
+			&_device,
+			&feature_level,
+			&_device_context
+		);
+
+		check_d3d_error(result);
+
+		{ // Partial constant buffer updates and upload rings
+			D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+			utils::zero_memory(&options);
+			bool constant_buffer_offsets = false;
+			if (SUCCEEDED(_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)))
+				&& SUCCEEDED(_device_context.As(&_device_context1))) {
+				_partial_constant_buffer_updates = options.ConstantBufferPartialUpdate == TRUE;
+				constant_buffer_offsets = options.ConstantBufferOffsetting == TRUE && options.MapNoOverwriteOnDynamicConstantBuffer == TRUE;
+			}
+
+			// Constant buffer offsets are in 256 byte steps
+			if (app_spec.vertex_upload_ring_size >= 256) {
+				_vertex_uploads = create_upload_buffer(app_spec.vertex_upload_ring_size & ~255u, D3D11_BIND_VERTEX_BUFFER);
+			}
+			if (constant_buffer_offsets && app_spec.constant_upload_ring_size >= 256) {
+				_constant_uploads = create_upload_buffer(app_spec.constant_upload_ring_size & ~255u, D3D11_BIND_CONSTANT_BUFFER);
+			}
+		}
+
+		// Render Target
+		{
+			ComPtr<ID3D11Texture2D> backbuffer;
+			result = _swap_chain->GetBuffer(0, __uuidof(ID3D11Texture2D), &backbuffer);
+			check_d3d_error(result);
+
+			result = _device->CreateRenderTargetView(backbuffer.Get(), nullptr, &_swap_chain_render_target);
+			check_d3d_error(result);
+		}
+
+		{ // Blend states. Opaque is the context's default, nullptr
+			D3D11_BLEND_DESC blend_desc;
+			utils::zero_memory(&blend_desc);
+			D3D11_RENDER_TARGET_BLEND_DESC& target = blend_desc.RenderTarget[0];
+			target.BlendEnable = TRUE;
+			target.SrcBlend = D3D11_BLEND_ONE;
+			target.DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+			target.BlendOp = D3D11_BLEND_OP_ADD;
+			target.SrcBlendAlpha = D3D11_BLEND_ONE;
+			target.DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+			target.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+			target.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+			result = _device->CreateBlendState(&blend_desc, &_premultiplied_blend_state);
+			check_d3d_error(result);
+		}
+
+		if (!app_spec.shader_cache_path.empty()) {
+			_shader_cache = std::make_unique<ShaderCache>(app_spec.shader_cache_path);
+		}
+
+		set_viewport({}, { (float)app_spec.width, (float)app_spec.height });
+		begin_gpu_frame();
+	}
+
+	void D3D11Backend::set_viewport(glm::vec2 pos, glm::vec2 size) {
+		D3D11_VIEWPORT viewport;
+		utils::zero_memory(&viewport);
+
+		viewport.TopLeftX = pos.x;
+		viewport.TopLeftY = pos.y;
+		viewport.Width = size.x;
+		viewport.Height = size.y;
+
+		const bool changed = !_bound.viewport.has_value() || memcmp(&*_bound.viewport, &viewport, sizeof(viewport)) != 0;
+		_bound.viewport = viewport;
+		count_state_call(changed);
+		if (changed) {
+			_device_context->RSSetViewports(1, &viewport);
+		}
+	}
+
+	void D3D11Backend::clear_color(const glm::vec4& color) {
+		_device_context->ClearRenderTargetView(_swap_chain_render_target.Get(), reinterpret_cast<const FLOAT*>(&color));
+		if (track(_bound.render_target, _swap_chain_render_target.Get())) {
+			_device_context->OMSetRenderTargets(1, _swap_chain_render_target.GetAddressOf(), nullptr);
+		}
+	}
+
+	void D3D11Backend::present(int VSync) {
+		end_gpu_frame();
+
+		UINT flags = 0;
+		_swap_chain->Present(VSync, flags);
+
+		// Flip model swap chains unbind the back buffer on present
+		_bound.render_target = nullptr;
+		forget_ring_users();
+		end_state_frame();
+		end_upload_frame();
+
+		begin_gpu_frame();
+	}
+
+	void D3D11Backend::collect_resources(uint64_t executed_frames) {
+		_vertex_buffers.collect(executed_frames);
+		_index_buffers.collect(executed_frames);
+		_vertex_shaders.collect(executed_frames);
+		_pixel_shaders.collect(executed_frames);
+	}
+
+	VertexBufferHandle D3D11Backend::create_vertex_buffer(
+		const void* data,
+		uint32_t vertex_size,
+		uint32_t vertex_count,
+		BufferDataType data_type
+	) {
+		D3D11VertexBuffer vertex_buffer;
+		vertex_buffer.count = vertex_count;
+		vertex_buffer.vertex_size = vertex_size;
+		vertex_buffer.data_type = data_type;
+
+		const uint32_t size = vertex_size * vertex_count;
+		if (data_type == BufferDataType::Dynamic && _vertex_uploads && size <= _vertex_uploads->ring.capacity() / 4) {
+			// Uploaded on the first bind
+			vertex_buffer.in_ring = true;
+			vertex_buffer.shadow.resize(size);
+			if (data != nullptr) {
+				memcpy(vertex_buffer.shadow.data(), data, size);
+			}
+		} else {
+			vertex_buffer.d3d11_buffer = create_buffer(data, size, D3D11_BIND_VERTEX_BUFFER, data_type);
+		}
+
+		return _vertex_buffers.add(std::move(vertex_buffer));
+	}
+
+	void D3D11Backend::update(VertexBuffer& buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count) {
+		auto& d3d11_buffer = static_cast<D3D11VertexBuffer&>(buffer);
+		buffer.count = vertex_count;
+
+		if (!d3d11_buffer.in_ring) {
+			write_buffer(d3d11_buffer.d3d11_buffer.Get(), data, vertex_size * vertex_count);
+			return;
+		}
+
+		assert(vertex_size * vertex_count <= d3d11_buffer.shadow.size());
+		memcpy(d3d11_buffer.shadow.data(), data, vertex_size * vertex_count);
+		upload(d3d11_buffer);
+		// The buffer may be bound already, now at another offset
+		refresh_ring_vertex_buffers();
+	}
+
+	void D3D11Backend::bind_vertex_buffers(
+		uint32_t first_slot, uint32_t buffer_count,
+		VertexBuffer* const* buffers, const uint32_t* strides
+	) {
+		constexpr uint32_t MAX_SLOTS = D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT;
+		assert(buffer_count <= MAX_SLOTS);
+
+		assert(first_slot + buffer_count <= MAX_SLOTS);
+
+		ID3D11Buffer* d3d11_buffers[MAX_SLOTS];
+		UINT offsets[MAX_SLOTS] = {};
+		bool changed = false;
+		const uint64_t pass = _vertex_uploads ? _vertex_uploads->ring.pass() : 0;
+		for (uint32_t i = 0; i < buffer_count; ++i) {
+			auto& d3d11_buffer = *static_cast<D3D11VertexBuffer*>(buffers[i]);
+			const uint32_t slot = first_slot + i;
+
+			if (d3d11_buffer.in_ring) {
+				if (d3d11_buffer.ring_pass != _vertex_uploads->ring.pass()) {
+					upload(d3d11_buffer);
+				}
+				d3d11_buffers[i] = _vertex_uploads->buffer.Get();
+				offsets[i] = d3d11_buffer.ring_offset;
+				_bound.ring_vertex_buffers[slot] = &d3d11_buffer;
+			} else {
+				d3d11_buffers[i] = d3d11_buffer.d3d11_buffer.Get();
+				_bound.ring_vertex_buffers[slot] = nullptr;
+			}
+
+			changed |= _bound.vertex_buffers[slot] != d3d11_buffers[i]
+				|| _bound.vertex_strides[slot] != strides[i]
+				|| _bound.vertex_offsets[slot] != offsets[i];
+			_bound.vertex_buffers[slot] = d3d11_buffers[i];
+			_bound.vertex_strides[slot] = strides[i];
+			_bound.vertex_offsets[slot] = offsets[i];
+		}
+
+		count_state_call(changed);
+		if (changed) {
+			_device_context->IASetVertexBuffers(first_slot, buffer_count, d3d11_buffers, strides, offsets);
+		}
+
+		// An upload wrapped the ring, whatever was uploaded before it is gone
+		if (_vertex_uploads && _vertex_uploads->ring.pass() != pass) {
+			refresh_ring_vertex_buffers();
+		}
+	}
+
+	IndexBufferHandle D3D11Backend::create_index_buffer(
+		const void* data,
+		IndexFormat format,
+		uint32_t index_count,
+		BufferDataType data_type
+	) {
+		D3D11IndexBuffer index_buffer;
+		index_buffer.count = index_count;
+		index_buffer.format = format;
+		index_buffer.data_type = data_type;
+		index_buffer.d3d11_buffer = create_buffer(data, index_format_size(format) * index_count, D3D11_BIND_INDEX_BUFFER, data_type);
+
+		return _index_buffers.add(std::move(index_buffer));
+	}
+
+	void D3D11Backend::update(IndexBuffer& buffer, const void* data, uint32_t index_count) {
+		auto& d3d11_buffer = static_cast<D3D11IndexBuffer&>(buffer);
+		write_buffer(d3d11_buffer.d3d11_buffer.Get(), data, index_format_size(buffer.format) * index_count);
+		buffer.count = index_count;
+	}
+
+	void D3D11Backend::bind(IndexBuffer& buffer) {
+		auto& d3d11_buffer = static_cast<D3D11IndexBuffer&>(buffer);
+		const DXGI_FORMAT format = buffer.format == IndexFormat::UInt16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+		const bool changed = _bound.index_buffer != d3d11_buffer.d3d11_buffer.Get() || _bound.index_format != format;
+		_bound.index_buffer = d3d11_buffer.d3d11_buffer.Get();
+		_bound.index_format = format;
+
+		count_state_call(changed);
+		if (changed) {
+			_device_context->IASetIndexBuffer(d3d11_buffer.d3d11_buffer.Get(), format, 0);
+		}
+	}
+
+	Shared<Texture2D> D3D11Backend::create_texture(uint32_t width, uint32_t height, uint32_t mip_count, TextureFormat format) {
+		Shared<D3D11Texture2D> texture = std::make_shared<D3D11Texture2D>();
+		texture->width = width;
+		texture->height = height;
+		texture->mip_count = mip_count;
+		texture->format = format;
+
+		// NOTE: Default usage, rows are streamed in with UpdateSubresource over several frames
+		D3D11_TEXTURE2D_DESC texture_desc;
+		utils::zero_memory(&texture_desc);
+		texture_desc.Width = width;
+		texture_desc.Height = height;
+		texture_desc.MipLevels = mip_count;
+		texture_desc.ArraySize = 1;
+		texture_desc.Format = convert_texture_format_to_d3d11(format);
+		texture_desc.SampleDesc.Count = 1;
+		texture_desc.Usage = D3D11_USAGE_DEFAULT;
+		texture_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		HRESULT result = _device->CreateTexture2D(&texture_desc, nullptr, &texture->d3d11_texture);
+		check_d3d_error(result);
+
+		result = _device->CreateShaderResourceView(texture->d3d11_texture.Get(), nullptr, &texture->view);
+		check_d3d_error(result);
+
+		return texture;
+	}
+
+	void D3D11Backend::update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data) {
+		auto& d3d11_texture = static_cast<D3D11Texture2D&>(texture);
+		assert(mip < texture.mip_count);
+		assert(region.x + region.width <= texture.mip_width(mip) && region.y + region.height <= texture.mip_height(mip));
+
+		D3D11_BOX box;
+		box.left = region.x;
+		box.right = region.x + region.width;
+		box.top = region.y;
+		box.bottom = region.y + region.height;
+		box.front = 0;
+		box.back = 1;
+
+		const UINT row_size = region.width * texture_format_size(texture.format);
+		_device_context->UpdateSubresource(d3d11_texture.d3d11_texture.Get(), mip, &box, data, row_size, row_size * region.height);
+	}
+
+	Shared<Sampler> D3D11Backend::create_sampler(const SamplerDesc& desc) {
+		Shared<D3D11Sampler> sampler = std::make_shared<D3D11Sampler>();
+		sampler->desc = desc;
+
+		const D3D11_TEXTURE_ADDRESS_MODE address = desc.address == TextureAddress::Wrap ? D3D11_TEXTURE_ADDRESS_WRAP : D3D11_TEXTURE_ADDRESS_CLAMP;
+
+		D3D11_SAMPLER_DESC sampler_desc;
+		utils::zero_memory(&sampler_desc);
+		sampler_desc.Filter = desc.filter == TextureFilter::Point ? D3D11_FILTER_MIN_MAG_MIP_POINT : D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		sampler_desc.AddressU = address;
+		sampler_desc.AddressV = address;
+		sampler_desc.AddressW = address;
+		sampler_desc.MaxAnisotropy = 1;
+		sampler_desc.ComparisonFunc = D3D11_COMPARISON_NEVER;
+		sampler_desc.MaxLOD = D3D11_FLOAT32_MAX;
+
+		const HRESULT result = _device->CreateSamplerState(&sampler_desc, &sampler->d3d11_sampler);
+		check_d3d_error(result);
+
+		return sampler;
+	}
+
+	void D3D11Backend::bind(Texture2D& texture, uint32_t slot) {
+		assert(slot < MAX_TEXTURE_SLOTS);
+
+		ID3D11ShaderResourceView* view = static_cast<D3D11Texture2D&>(texture).view.Get();
+		if (track(_bound.pixel_textures[slot], view)) {
+			_device_context->PSSetShaderResources(slot, 1, &view);
+		}
+	}
+
+	void D3D11Backend::bind(Sampler& sampler, uint32_t slot) {
+		assert(slot < MAX_TEXTURE_SLOTS);
+
+		ID3D11SamplerState* sampler_state = static_cast<D3D11Sampler&>(sampler).d3d11_sampler.Get();
+		if (track(_bound.pixel_samplers[slot], sampler_state)) {
+			_device_context->PSSetSamplers(slot, 1, &sampler_state);
+		}
+	}
+
+	Shared<VertexShader> D3D11Backend::try_compile_vertex_shader(
+		const std::wstring& shader_path,
+		const std::vector<VertexElement>& layout,
+		uint32_t uniform_buffer_size,
+		const std::string& main_name,
+		std::string& error
+	) {
+		Shared<D3D11VertexShader> shader = std::make_shared<D3D11VertexShader>();
+		shader->layout = layout;
+		shader->uniform_buffer_size = uniform_buffer_size;
+
+		{ // Compilation
+			if (!compile_shader_blob(shader_path, main_name, "vs_4_0", shader->blob, error)) {
+				return nullptr;
+			}
+
+			HRESULT result = _device->CreateVertexShader(shader->blob->GetBufferPointer(), shader->blob->GetBufferSize(), nullptr, &shader->d3d11_shader);
+			if (FAILED(result)) {
+				error = "CreateVertexShader failed for '" + std::filesystem::path(shader_path).string() + "'";
+				return nullptr;
+			}
+		}
+
+		{ /* Layout */
+			std::vector<D3D11_INPUT_ELEMENT_DESC> layout_array;
+			layout_array.reserve(layout.size());
+			for (const VertexElement& element : layout) {
+				D3D11_INPUT_ELEMENT_DESC desc;
+				desc.SemanticName = element.semantic;
+				desc.SemanticIndex = element.semantic_index;
+				desc.Format = convert_vertex_format_to_d3d11(element.format);
+				desc.InputSlot = element.slot;
+				desc.AlignedByteOffset = element.offset;
+				desc.InputSlotClass = element.per_instance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+				desc.InstanceDataStepRate = element.per_instance ? element.instance_step_rate : 0;
+				layout_array.push_back(desc);
+			}
+
+			HRESULT result = _device->CreateInputLayout(
+				layout_array.data(),
+				static_cast<UINT>(layout_array.size()),
+				shader->blob->GetBufferPointer(),
+				shader->blob->GetBufferSize(),
+				&shader->d3d11_layout
+			);
+
+			// Usually the layout doesn't match the shader inputs anymore
+			if (FAILED(result)) {
+				error = "CreateInputLayout failed for '" + std::filesystem::path(shader_path).string() + "'";
+				return nullptr;
+			}
+		}
+
+		reflect_uniform_layout(*shader);
+
+		if (uniform_buffer_size > 0 && _constant_uploads) {
+			// Whole 256 byte blocks, the ring hands out constant buffer offsets in those
+			shader->uniform_shadow.resize((uniform_buffer_size + 255) & ~255u);
+		} else if (uniform_buffer_size > 0) {
+			// Fill in a buffer description
+			D3D11_BUFFER_DESC buffer_desc;
+			utils::zero_memory(&buffer_desc);
+			buffer_desc.ByteWidth = (uniform_buffer_size + 15) & ~15u; // Constant buffers are whole registers
+			buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+			if (_partial_constant_buffer_updates) {
+				buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+			} else {
+				buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+				buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+			}
+			shader->uniform_shadow.resize(buffer_desc.ByteWidth);
+
+			// Create the buffer
+			// NOTE: nullptr for data, have to use update_uniform_buffer to fill the data.
+			//       Maybe it's a bit slow, but who cares, right?
+			HRESULT result = _device->CreateBuffer(
+				&buffer_desc,
+				nullptr,
+				&shader->const_buffer
+			);
+			check_d3d_error(result);
+		}
+
+		return shader;
+	}
+
+	Shared<PixelShader> D3D11Backend::try_compile_pixel_shader(
+		const std::wstring& shader_path,
+		const std::string& main_name,
+		std::string& error
+	) {
+		Shared<D3D11PixelShader> shader = std::make_shared<D3D11PixelShader>();
+
+		if (!compile_shader_blob(shader_path, main_name, "ps_4_0", shader->blob, error)) {
+			return nullptr;
+		}
+
+		HRESULT result = _device->CreatePixelShader(shader->blob->GetBufferPointer(), shader->blob->GetBufferSize(), nullptr, &shader->d3d11_shader);
+		if (FAILED(result)) {
+			error = "CreatePixelShader failed for '" + std::filesystem::path(shader_path).string() + "'";
+			return nullptr;
+		}
+	
+		return shader;
+	}
+
+	VertexShaderHandle D3D11Backend::add(VertexShader&& compiled) {
+		return _vertex_shaders.add(std::move(static_cast<D3D11VertexShader&>(compiled)));
+	}
+
+	PixelShaderHandle D3D11Backend::add(PixelShader&& compiled) {
+		return _pixel_shaders.add(std::move(static_cast<D3D11PixelShader&>(compiled)));
+	}
+
+	void D3D11Backend::replace(VertexShader& shader, VertexShader& compiled) {
+		auto& d3d11_shader = static_cast<D3D11VertexShader&>(shader);
+		auto& d3d11_compiled = static_cast<D3D11VertexShader&>(compiled);
+
+		const bool keep_uniforms = d3d11_shader.uniform_shadow.size() == d3d11_compiled.uniform_shadow.size();
+		std::swap(d3d11_shader, d3d11_compiled);
+		if (keep_uniforms) {
+			std::swap(d3d11_shader.const_buffer, d3d11_compiled.const_buffer);
+			std::swap(d3d11_shader.uniform_shadow, d3d11_compiled.uniform_shadow);
+			std::swap(d3d11_shader.ring_offset, d3d11_compiled.ring_offset);
+			std::swap(d3d11_shader.ring_pass, d3d11_compiled.ring_pass);
+		}
+
+		// The new D3D11 objects differ from the shadowed ones, only the pipeline shortcut has to go
+		_bound_pipeline = nullptr;
+	}
+
+	void D3D11Backend::replace(PixelShader& shader, PixelShader& compiled) {
+		std::swap(static_cast<D3D11PixelShader&>(shader), static_cast<D3D11PixelShader&>(compiled));
+		_bound_pipeline = nullptr;
+	}
+
+	void D3D11Backend::bind(VertexShader& shader) {
+		_bound_pipeline = nullptr;
+		auto& d3d11_shader = static_cast<D3D11VertexShader&>(shader);
+
+		// Set Layout
+		if (track(_bound.input_layout, d3d11_shader.d3d11_layout.Get())) {
+			_device_context->IASetInputLayout(d3d11_shader.d3d11_layout.Get());
+		}
+
+		// Set const buffer
+		if (_constant_uploads && !d3d11_shader.uniform_shadow.empty()) {
+			if (d3d11_shader.ring_pass != _constant_uploads->ring.pass()) {
+				upload(d3d11_shader);
+			}
+			bind_ring_constants(d3d11_shader);
+		} else {
+			_bound.ring_vertex_shader = nullptr;
+			_bound.vertex_constant_offset = 0;
+			if (track(_bound.vertex_constant_buffer, d3d11_shader.const_buffer.Get())) {
+				_device_context->VSSetConstantBuffers(0, 1, d3d11_shader.const_buffer.GetAddressOf());
+			}
+		}
+
+		// Set the shader
+		if (track(_bound.vertex_shader, d3d11_shader.d3d11_shader.Get())) {
+			_device_context->VSSetShader(d3d11_shader.d3d11_shader.Get(), nullptr, 0);
+		}
+	}
+
+	void D3D11Backend::bind(PixelShader& shader) {
+		_bound_pipeline = nullptr;
+		auto& d3d11_shader = static_cast<D3D11PixelShader&>(shader);
+		if (track(_bound.pixel_shader, d3d11_shader.d3d11_shader.Get())) {
+			_device_context->PSSetShader(d3d11_shader.d3d11_shader.Get(), nullptr, 0);
+		}
+	}
+
+	void D3D11Backend::update(VertexShader& shader, const void* data_ptr, uint32_t offset, uint32_t data_size) {
+		auto& d3d11_shader = static_cast<D3D11VertexShader&>(shader);
+		assert(offset + data_size <= shader.uniform_buffer_size);
+
+		memcpy(d3d11_shader.uniform_shadow.data() + offset, data_ptr, data_size);
+
+		if (_constant_uploads) {
+			// A fresh block gets the whole shadow, the bound one the GPU may still read stays untouched
+			upload(d3d11_shader);
+			refresh_ring_constants();
+			return;
+		}
+
+		if (_partial_constant_buffer_updates) {
+			// The box has to cover whole 16 byte registers, the shadow fills in the rest
+			const uint32_t begin = offset & ~15u;
+			const uint32_t end = (offset + data_size + 15) & ~15u;
+			D3D11_BOX box = { begin, 0, 0, end, 1, 1 };
+			_device_context1->UpdateSubresource1(d3d11_shader.const_buffer.Get(), 0, &box, d3d11_shader.uniform_shadow.data() + begin, 0, 0, 0);
+			return;
+		}
+
+		// Discard throws away the old contents, so the whole buffer is rewritten from the shadow copy
+		D3D11_MAPPED_SUBRESOURCE mapped_sub_res;
+		_device_context->Map(d3d11_shader.const_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_sub_res);
+		memcpy(mapped_sub_res.pData, d3d11_shader.uniform_shadow.data(), d3d11_shader.uniform_shadow.size());
+		_device_context->Unmap(d3d11_shader.const_buffer.Get(), 0);
+	}
+
+	void D3D11Backend::set_topology(TopologyType topology) {
+		_bound_pipeline = nullptr;
+		D3D_PRIMITIVE_TOPOLOGY converted_topology = convert_topology_to_d3d11(topology);
+
+		if (track(_bound.topology, converted_topology)) {
+			_device_context->IASetPrimitiveTopology(converted_topology);
+		}
+	}
+
+	void D3D11Backend::set_blend_mode(BlendMode mode) {
+		_bound_pipeline = nullptr;
+		ID3D11BlendState* blend_state = mode == BlendMode::PremultipliedAlpha ? _premultiplied_blend_state.Get() : nullptr;
+
+		if (track(_bound.blend_state, blend_state)) {
+			_device_context->OMSetBlendState(blend_state, nullptr, 0xffffffff);
+		}
+	}
+
+	void D3D11Backend::draw(uint32_t vertex_count, uint32_t vertex_start_location) {
+		_device_context->Draw(vertex_count, vertex_start_location);
+	}
+
+	void D3D11Backend::draw_instanced(
+		uint32_t vertex_count, uint32_t instance_count,
+		uint32_t vertex_start_location, uint32_t instance_start_location
+	) {
+		_device_context->DrawInstanced(vertex_count, instance_count, vertex_start_location, instance_start_location);
+	}
+
+	void D3D11Backend::draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) {
+		_device_context->DrawIndexed(index_count, index_start_location, base_vertex_location);
+	}
+
+	void D3D11Backend::begin_gpu_scope(const char* name) {
+		if (!_gpu_frame_open) {
+			return;
+		}
+
+		D3D11GpuFrame& frame = _gpu_frames[_gpu_frame_index];
+		if (frame.scope_count == frame.scopes.size()) {
+			D3D11_QUERY_DESC desc;
+			utils::zero_memory(&desc);
+			desc.Query = D3D11_QUERY_TIMESTAMP;
+
+			D3D11GpuScope scope;
+			check_d3d_error(_device->CreateQuery(&desc, &scope.begin));
+			check_d3d_error(_device->CreateQuery(&desc, &scope.end));
+			frame.scopes.push_back(scope);
+		}
+
+		D3D11GpuScope& scope = frame.scopes[frame.scope_count];
+		scope.name = name;
+		_device_context->End(scope.begin.Get()); // Timestamps only have End
+
+		_gpu_scope_stack.push_back(frame.scope_count);
+		frame.scope_count++;
+	}
+
+	void D3D11Backend::end_gpu_scope() {
+		if (!_gpu_frame_open || _gpu_scope_stack.empty()) {
+			return;
+		}
+
+		D3D11GpuFrame& frame = _gpu_frames[_gpu_frame_index];
+		_device_context->End(frame.scopes[_gpu_scope_stack.back()].end.Get());
+		_gpu_scope_stack.pop_back();
+	}
+
+	void D3D11Backend::begin_gpu_frame() {
+		if (!Profiler::get().enabled()) {
+			return;
+		}
+
+		// Issued GPU_FRAME_LATENCY frames ago, should be done by now
+		D3D11GpuFrame& frame = _gpu_frames[_gpu_frame_index];
+		if (frame.issued) {
+			collect_gpu_frame(frame);
+		}
+
+		if (frame.disjoint == nullptr) {
+			D3D11_QUERY_DESC desc;
+			utils::zero_memory(&desc);
+			desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+			check_d3d_error(_device->CreateQuery(&desc, &frame.disjoint));
+		}
+
+		_device_context->Begin(frame.disjoint.Get());
+		frame.scope_count = 0;
+		frame.cpu_start_ns = steady_clock_now();
+		_gpu_frame_open = true;
+
+		begin_gpu_scope("gpu_frame");
+	}
+
+	void D3D11Backend::end_gpu_frame() {
+		if (!_gpu_frame_open) {
+			return;
+		}
+
+		while (!_gpu_scope_stack.empty()) {
+			end_gpu_scope();
+		}
+
+		D3D11GpuFrame& frame = _gpu_frames[_gpu_frame_index];
+		_device_context->End(frame.disjoint.Get());
+		frame.issued = true;
+
+		_gpu_frame_open = false;
+		_gpu_frame_index = (_gpu_frame_index + 1) % GPU_FRAME_LATENCY;
+	}
+
+	void D3D11Backend::collect_gpu_frame(D3D11GpuFrame& frame) {
+		frame.issued = false;
+
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		const UINT flags = D3D11_ASYNC_GETDATA_DONOTFLUSH;
+		if (_device_context->GetData(frame.disjoint.Get(), &disjoint, sizeof(disjoint), flags) != S_OK || disjoint.Disjoint) {
+			return;
+		}
+
+		// Scope 0 is the whole frame, everything is placed relative to its start
+		UINT64 frame_begin = 0;
+		const double ns_per_tick = 1e9 / static_cast<double>(disjoint.Frequency);
+		for (uint32_t i = 0; i < frame.scope_count; ++i) {
+			const D3D11GpuScope& scope = frame.scopes[i];
+
+			UINT64 begin = 0;
+			UINT64 end = 0;
+			if (_device_context->GetData(scope.begin.Get(), &begin, sizeof(begin), flags) != S_OK
+				|| _device_context->GetData(scope.end.Get(), &end, sizeof(end), flags) != S_OK) {
+				if (i == 0) {
+					return;
+				}
+				continue;
+			}
+
+			if (i == 0) {
+				frame_begin = begin;
+			}
+
+			const int64_t start_ns = frame.cpu_start_ns + static_cast<int64_t>(static_cast<double>(begin - frame_begin) * ns_per_tick);
+			const int64_t end_ns = frame.cpu_start_ns + static_cast<int64_t>(static_cast<double>(end - frame_begin) * ns_per_tick);
+			Profiler::get().record_gpu(scope.name, start_ns, end_ns);
+		}
+	}
+
+	void D3D11Backend::check_d3d_error(HRESULT result) const {
+		switch (result) {
+			case S_OK: return;
+			case S_FALSE: printf("[D3D11 Error]: S_FALSE \n"); abort();
+			case E_NOTIMPL: printf("[D3D11 Error]: E_NOTIMPL\n"); abort();
+			case E_OUTOFMEMORY: printf("[D3D11 Error]: E_OUTOFMEMORY\n"); abort();
+			case E_INVALIDARG: printf("[D3D11 Error]: E_INVALIDARG\n"); abort();
+			case E_FAIL: printf("[D3D11 Error]: E_FAIL\n"); abort();
+			case DXGI_ERROR_WAS_STILL_DRAWING: printf("[D3D11 Error]: DXGI_ERROR_WAS_STILL_DRAWING\n"); abort();
+			case DXGI_ERROR_INVALID_CALL: printf("[D3D11 Error]: DXGI_ERROR_INVALID_CALL \n"); abort();
+			case D3D11_ERROR_DEFERRED_CONTEXT_MAP_WITHOUT_INITIAL_DISCARD: printf("[D3D11 Error]: D3D11_ERROR_DEFERRED_CONTEXT_MAP_WITHOUT_INITIAL_DISCARD\n"); abort();
+			case D3D11_ERROR_TOO_MANY_UNIQUE_VIEW_OBJECTS: printf("[D3D11 Error]: D3D11_ERROR_TOO_MANY_UNIQUE_VIEW_OBJECTS\n"); abort();
+			case D3D11_ERROR_TOO_MANY_UNIQUE_STATE_OBJECTS: printf("[D3D11 Error]: D3D11_ERROR_TOO_MANY_UNIQUE_STATE_OBJECTS\n"); abort();
+			case D3D11_ERROR_FILE_NOT_FOUND: printf("[D3D11 Error]: D3D11_ERROR_FILE_NOT_FOUND\n"); abort();
+			case DXGI_ERROR_ACCESS_DENIED: printf("[D3D11 Error]: DXGI_ERROR_ACCESS_DENIED\n"); abort();
+			case DXGI_ERROR_ACCESS_LOST: printf("[D3D11 Error]: DXGI_ERROR_ACCESS_LOST\n"); abort();
+			case DXGI_ERROR_ALREADY_EXISTS: printf("[D3D11 Error]: DXGI_ERROR_ALREADY_EXISTS\n"); abort();
+			case DXGI_ERROR_CANNOT_PROTECT_CONTENT: printf("[D3D11 Error]: DXGI_ERROR_CANNOT_PROTECT_CONTENT\n"); abort();
+			case DXGI_ERROR_DEVICE_HUNG: printf("[D3D11 Error]: DXGI_ERROR_DEVICE_HUNG\n"); abort();
+			case DXGI_ERROR_DEVICE_REMOVED: printf("[D3D11 Error]: DXGI_ERROR_DEVICE_REMOVED\n"); abort();
+			case DXGI_ERROR_DEVICE_RESET: printf("[D3D11 Error]: DXGI_ERROR_DEVICE_RESET\n"); abort();
+			case DXGI_ERROR_DRIVER_INTERNAL_ERROR: printf("[D3D11 Error]: DXGI_ERROR_DRIVER_INTERNAL_ERROR\n"); abort();
+			case DXGI_ERROR_FRAME_STATISTICS_DISJOINT: printf("[D3D11 Error]: DXGI_ERROR_FRAME_STATISTICS_DISJOINT\n"); abort();
+			case DXGI_ERROR_GRAPHICS_VIDPN_SOURCE_IN_USE: printf("[D3D11 Error]: DXGI_ERROR_GRAPHICS_VIDPN_SOURCE_IN_USE\n"); abort();
+			case DXGI_ERROR_MORE_DATA: printf("[D3D11 Error]: DXGI_ERROR_MORE_DATA\n"); abort();
+			case DXGI_ERROR_NAME_ALREADY_EXISTS: printf("[D3D11 Error]: DXGI_ERROR_NAME_ALREADY_EXISTS\n"); abort();
+			case DXGI_ERROR_NONEXCLUSIVE: printf("[D3D11 Error]: DXGI_ERROR_NONEXCLUSIVE\n"); abort();
+			case DXGI_ERROR_NOT_CURRENTLY_AVAILABLE: printf("[D3D11 Error]: DXGI_ERROR_NOT_CURRENTLY_AVAILABLE\n"); abort();
+			case DXGI_ERROR_NOT_FOUND: printf("[D3D11 Error]: DXGI_ERROR_NOT_FOUND\n"); abort();
+			case DXGI_ERROR_REMOTE_CLIENT_DISCONNECTED: printf("[D3D11 Error]: DXGI_ERROR_REMOTE_CLIENT_DISCONNECTED\n"); abort();
+			case DXGI_ERROR_REMOTE_OUTOFMEMORY: printf("[D3D11 Error]: DXGI_ERROR_REMOTE_OUTOFMEMORY\n"); abort();
+			case DXGI_ERROR_RESTRICT_TO_OUTPUT_STALE: printf("[D3D11 Error]: DXGI_ERROR_RESTRICT_TO_OUTPUT_STALE\n"); abort();
+			case DXGI_ERROR_SDK_COMPONENT_MISSING: printf("[D3D11 Error]: DXGI_ERROR_SDK_COMPONENT_MISSING\n"); abort();
+			case DXGI_ERROR_SESSION_DISCONNECTED: printf("[D3D11 Error]: DXGI_ERROR_SESSION_DISCONNECTED\n"); abort();
+			case DXGI_ERROR_UNSUPPORTED: printf("[D3D11 Error]: DXGI_ERROR_UNSUPPORTED\n"); abort();
+			case DXGI_ERROR_WAIT_TIMEOUT: printf("[D3D11 Error]: DXGI_ERROR_WAIT_TIMEOUT\n"); abort();
+			default:
+				auto s = std::to_string(result);
+				throw std::runtime_error(s.c_str());
+		}
+	}
+
+	ComPtr<ID3D11Buffer> D3D11Backend::create_buffer(const void* data, uint32_t size, UINT bind_flags, BufferDataType data_type) const {
+		D3D11_BUFFER_DESC buffer_desc;
+		utils::zero_memory(&buffer_desc);
+
+		if (data_type == BufferDataType::Default) {
+			buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+		} else if (data_type == BufferDataType::Static) {
+			buffer_desc.Usage = D3D11_USAGE_IMMUTABLE;
+		} else if (data_type == BufferDataType::Dynamic) {
+			buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+			buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		} else {
+			std::cerr << "Unknown buffer data type!\n";
+			abort();
+		}
+
+		buffer_desc.ByteWidth = size;
+		buffer_desc.BindFlags = bind_flags;
+
+		ComPtr<ID3D11Buffer> buffer;
+		if (data == nullptr) {
+			const HRESULT result = _device->CreateBuffer(&buffer_desc, nullptr, &buffer);
+			check_d3d_error(result);
+		} else {
+			D3D11_SUBRESOURCE_DATA initData;
+			utils::zero_memory(&initData);
+			initData.pSysMem = data;
+			const HRESULT result = _device->CreateBuffer(&buffer_desc, &initData, &buffer);
+			check_d3d_error(result);
+		}
+
+		return buffer;
+	}
+
+	void D3D11Backend::write_buffer(ID3D11Buffer* buffer, const void* data, uint32_t size) const {
+		D3D11_MAPPED_SUBRESOURCE resource;
+		HRESULT result = _device_context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+		check_d3d_error(result);
+
+		memcpy(resource.pData, data, size);
+
+		_device_context->Unmap(buffer, 0);
+	}
+
+	Unique<D3D11UploadBuffer> D3D11Backend::create_upload_buffer(uint32_t capacity, UINT bind_flags) const {
+		Unique<D3D11UploadBuffer> uploads = std::make_unique<D3D11UploadBuffer>(D3D11UploadBuffer { UploadRing(capacity) });
+		uploads->buffer = create_buffer(nullptr, capacity, bind_flags, BufferDataType::Dynamic);
+		return uploads;
+	}
+
+	uint32_t D3D11Backend::upload(D3D11UploadBuffer& uploads, const void* data, uint32_t size, uint32_t alignment) {
+		std::optional<UploadAllocation> allocation = uploads.ring.allocate(size, alignment);
+		if (!allocation.has_value()) {
+			// The GPU is a whole ring behind. Discard renames the buffer, so what it still reads stays valid
+			uploads.ring.reset();
+			allocation = uploads.ring.allocate(size, alignment);
+			assert(allocation.has_value());
+		}
+
+		const D3D11_MAP map_type = allocation->wrapped ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+		D3D11_MAPPED_SUBRESOURCE resource;
+		HRESULT result = _device_context->Map(uploads.buffer.Get(), 0, map_type, 0, &resource);
+		check_d3d_error(result);
+
+		const uint32_t offset = static_cast<uint32_t>(allocation->offset);
+		memcpy(static_cast<char*>(resource.pData) + offset, data, size);
+
+		_device_context->Unmap(uploads.buffer.Get(), 0);
+		return offset;
+	}
+
+	void D3D11Backend::upload(D3D11VertexBuffer& buffer) {
+		buffer.ring_offset = upload(*_vertex_uploads, buffer.shadow.data(), buffer.vertex_size * buffer.count, 16);
+		buffer.ring_pass = _vertex_uploads->ring.pass();
+	}
+
+	void D3D11Backend::upload(D3D11VertexShader& shader) {
+		shader.ring_offset = upload(*_constant_uploads, shader.uniform_shadow.data(), static_cast<uint32_t>(shader.uniform_shadow.size()), 256);
+		shader.ring_pass = _constant_uploads->ring.pass();
+	}
+
+	void D3D11Backend::refresh_ring_vertex_buffers() {
+		for (uint32_t slot = 0; slot < D3D11BoundState::MAX_VERTEX_SLOTS; ++slot) {
+			D3D11VertexBuffer* buffer = _bound.ring_vertex_buffers[slot];
+			if (buffer == nullptr) {
+				continue;
+			}
+
+			if (buffer->ring_pass != _vertex_uploads->ring.pass()) {
+				upload(*buffer);
+			}
+
+			const bool changed = _bound.vertex_offsets[slot] != buffer->ring_offset;
+			_bound.vertex_offsets[slot] = buffer->ring_offset;
+			count_state_call(changed);
+			if (changed) {
+				ID3D11Buffer* d3d11_buffer = _vertex_uploads->buffer.Get();
+				_device_context->IASetVertexBuffers(slot, 1, &d3d11_buffer, &_bound.vertex_strides[slot], &_bound.vertex_offsets[slot]);
+			}
+		}
+	}
+
+	void D3D11Backend::refresh_ring_constants() {
+		D3D11VertexShader* shader = _bound.ring_vertex_shader;
+		if (shader == nullptr) {
+			return;
+		}
+
+		if (shader->ring_pass != _constant_uploads->ring.pass()) {
+			upload(*shader);
+		}
+		bind_ring_constants(*shader);
+	}
+
+	void D3D11Backend::forget_ring_users() {
+		for (uint32_t slot = 0; slot < D3D11BoundState::MAX_VERTEX_SLOTS; ++slot) {
+			if (_bound.ring_vertex_buffers[slot] != nullptr) {
+				_bound.ring_vertex_buffers[slot] = nullptr;
+				_bound.vertex_buffers[slot] = nullptr;
+			}
+		}
+
+		if (_bound.ring_vertex_shader != nullptr) {
+			_bound.ring_vertex_shader = nullptr;
+			_bound.vertex_constant_buffer = nullptr;
+		}
+
+		// Binding the same pipeline again would skip the shader and its constants
+		_bound_pipeline = nullptr;
+	}
+
+	void D3D11Backend::bind_ring_constants(D3D11VertexShader& shader) {
+		ID3D11Buffer* buffer = _constant_uploads->buffer.Get();
+		const UINT first_constant = shader.ring_offset / 16;
+		const UINT constant_count = static_cast<UINT>(shader.uniform_shadow.size()) / 16;
+
+		const bool changed = _bound.vertex_constant_buffer != buffer || _bound.vertex_constant_offset != first_constant;
+		_bound.vertex_constant_buffer = buffer;
+		_bound.vertex_constant_offset = first_constant;
+		_bound.ring_vertex_shader = &shader;
+
+		count_state_call(changed);
+		if (changed) {
+			_device_context1->VSSetConstantBuffers1(0, 1, &buffer, &first_constant, &constant_count);
+		}
+	}
+
+	void D3D11Backend::end_upload_frame() {
+		if (!_vertex_uploads && !_constant_uploads) {
+			return;
+		}
+
+		D3D11FrameFence frame_fence;
+		frame_fence.fence = ++_frame_fence;
+		if (_free_fence_queries.empty()) {
+			D3D11_QUERY_DESC desc;
+			utils::zero_memory(&desc);
+			desc.Query = D3D11_QUERY_EVENT;
+			check_d3d_error(_device->CreateQuery(&desc, &frame_fence.query));
+		} else {
+			frame_fence.query = std::move(_free_fence_queries.back());
+			_free_fence_queries.pop_back();
+		}
+		_device_context->End(frame_fence.query.Get());
+		_frame_fences.push_back(std::move(frame_fence));
+
+		for (D3D11UploadBuffer* uploads : { _vertex_uploads.get(), _constant_uploads.get() }) {
+			if (uploads != nullptr) {
+				uploads->ring.end_frame(_frame_fence);
+			}
+		}
+
+		// Frames finish in order, the first one that isn't done ends it
+		while (!_frame_fences.empty()) {
+			BOOL done = FALSE;
+			const HRESULT result = _device_context->GetData(_frame_fences.front().query.Get(), &done, sizeof(done), D3D11_ASYNC_GETDATA_DONOTFLUSH);
+			if (result != S_OK || !done) {
+				break;
+			}
+
+			for (D3D11UploadBuffer* uploads : { _vertex_uploads.get(), _constant_uploads.get() }) {
+				if (uploads != nullptr) {
+					uploads->ring.retire(_frame_fences.front().fence);
+				}
+			}
+			_free_fence_queries.push_back(std::move(_frame_fences.front().query));
+			_frame_fences.pop_front();
+		}
+	}
+
+	D3D_PRIMITIVE_TOPOLOGY D3D11Backend::convert_topology_to_d3d11(TopologyType topology) const {
+		switch (topology) {
+			case TopologyType::TriangleList: return D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+			default:
+				std::cerr << "Unknown topology type!\n";
+				abort();
+		}
+	}
+
+	DXGI_FORMAT D3D11Backend::convert_texture_format_to_d3d11(TextureFormat format) const {
+		switch (format) {
+			case TextureFormat::RGBA8_UNorm: return DXGI_FORMAT_R8G8B8A8_UNORM;
+			default:
+				std::cerr << "Unknown texture format!\n";
+				abort();
+		}
+	}
+
+	bool D3D11Backend::compile_shader_blob(
+		const std::wstring& shader_path,
+		const std::string& main_name,
+		const char* profile,
+		ComPtr<ID3D10Blob>& blob,
+		std::string& error
+	) const {
+		namespace fs = std::filesystem;
+		if (!fs::exists(shader_path)) {
+			error = "shader file '" + fs::path(shader_path).string() + "' doesn't exist!";
+			return false;
+		}
+
+		const UINT flags = 0;
+
+		ShaderCacheKey key;
+		std::optional<uint64_t> source_hash;
+		if (_shader_cache) {
+			source_hash = hash_shader_source(shader_path);
+
+			key.source_hash = source_hash.value_or(0);
+			key.entry = main_name;
+			key.profile = profile;
+			key.flags = flags;
+			key.compiler_version = D3D_COMPILER_VERSION;
+
+			std::vector<char> bytecode;
+			if (source_hash.has_value() && _shader_cache->load(key, bytecode)) {
+				HRESULT result = D3DCreateBlob(bytecode.size(), &blob);
+				check_d3d_error(result);
+				memcpy(blob->GetBufferPointer(), bytecode.data(), bytecode.size());
+				return true;
+			}
+		}
+
+		ComPtr<ID3DBlob> error_message;
+		HRESULT result = D3DCompileFromFile(
+			shader_path.c_str(),
+			nullptr,
+			D3D_COMPILE_STANDARD_FILE_INCLUDE,
+			main_name.c_str(),
+			profile,
+			flags,
+			0,
+			&blob,
+			&error_message
+		);
+
+		if (FAILED(result)) {
+			if (error_message != nullptr) {
+				error = static_cast<const char*>(error_message->GetBufferPointer());
+			} else {
+				error = "D3DCompileFromFile failed for '" + fs::path(shader_path).string() + "'";
+			}
+			return false;
+		}
+
+		// Warnings
+		if (error_message != nullptr) {
+			const char* message = static_cast<const char*>(error_message->GetBufferPointer());
+			std::cerr << message << "\n";
+		}
+
+		if (_shader_cache && source_hash.has_value()) {
+			_shader_cache->store(key, blob->GetBufferPointer(), blob->GetBufferSize());
+		}
+
+		return true;
+	}
+
+	void D3D11Backend::reflect_uniform_layout(D3D11VertexShader& shader) const {
+		ComPtr<ID3D11ShaderReflection> reflection;
+		HRESULT result = D3DReflect(
+			shader.blob->GetBufferPointer(),
+			shader.blob->GetBufferSize(),
+			__uuidof(ID3D11ShaderReflection),
+			reinterpret_cast<void**>(reflection.GetAddressOf())
+		);
+		check_d3d_error(result);
+
+		D3D11_SHADER_DESC shader_desc;
+		reflection->GetDesc(&shader_desc);
+		if (shader_desc.ConstantBuffers == 0) {
+			return;
+		}
+
+		// NOTE: Only the first cbuffer, the one bound to slot 0
+		ID3D11ShaderReflectionConstantBuffer* constant_buffer = reflection->GetConstantBufferByIndex(0);
+		D3D11_SHADER_BUFFER_DESC buffer_desc;
+		constant_buffer->GetDesc(&buffer_desc);
+
+		for (UINT i = 0; i < buffer_desc.Variables; ++i) {
+			ID3D11ShaderReflectionVariable* variable = constant_buffer->GetVariableByIndex(i);
+			D3D11_SHADER_VARIABLE_DESC variable_desc;
+			variable->GetDesc(&variable_desc);
+
+			D3D11_SHADER_TYPE_DESC type_desc;
+			variable->GetType()->GetDesc(&type_desc);
+
+			UniformField field;
+			field.name = variable_desc.Name;
+			field.offset = variable_desc.StartOffset;
+			field.size = variable_desc.Size;
+			field.type = convert_uniform_type_from_d3d11(type_desc);
+			shader.uniform_layout.add_packed(field);
+		}
+	}
+
+	UniformType D3D11Backend::convert_uniform_type_from_d3d11(const D3D11_SHADER_TYPE_DESC& desc) const {
+		if (desc.Elements > 0) {
+			return UniformType::Other;
+		}
+
+		if (desc.Class == D3D_SVC_SCALAR || desc.Class == D3D_SVC_VECTOR) {
+			switch (desc.Type) {
+				case D3D_SVT_FLOAT:
+					switch (desc.Columns) {
+						case 1: return UniformType::Float;
+						case 2: return UniformType::Float2;
+						case 3: return UniformType::Float3;
+						case 4: return UniformType::Float4;
+					}
+					break;
+				case D3D_SVT_INT: return desc.Columns == 1 ? UniformType::Int : UniformType::Other;
+				case D3D_SVT_UINT: return desc.Columns == 1 ? UniformType::UInt : UniformType::Other;
+				default: break;
+			}
+		}
+
+		// column_major float4x4, same memory layout as glm::mat4
+		if (desc.Class == D3D_SVC_MATRIX_COLUMNS && desc.Type == D3D_SVT_FLOAT && desc.Rows == 4 && desc.Columns == 4) {
+			return UniformType::Mat4;
+		}
+
+		return UniformType::Other;
+	}
+
+	DXGI_FORMAT D3D11Backend::convert_vertex_format_to_d3d11(VertexFormat format) const {
+		switch (format) {
+			case VertexFormat::Float: return DXGI_FORMAT_R32_FLOAT;
+			case VertexFormat::Float2: return DXGI_FORMAT_R32G32_FLOAT;
+			case VertexFormat::Float3: return DXGI_FORMAT_R32G32B32_FLOAT;
+			case VertexFormat::Float4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+			case VertexFormat::RGBA8_UNorm: return DXGI_FORMAT_R8G8B8A8_UNORM;
+			case VertexFormat::UInt: return DXGI_FORMAT_R32_UINT;
+			default:
+				std::cerr << "Unknown vertex format!\n";
+				abort();
+		}
+	}
+}
+#endif
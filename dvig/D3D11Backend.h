@@ -0,0 +1,282 @@
+#pragma once
+#include "pch.h"
+
+#ifdef _WIN32
+#include "RenderBackend.h"
+#include "ShaderCache.h"
+#include "UploadRing.h"
+
+namespace dvig {
+	// Small dynamic buffers live in the vertex upload ring instead of their own buffer
+	struct D3D11VertexBuffer : VertexBuffer {
+	private:
+		friend class D3D11Backend;
+		ComPtr<ID3D11Buffer> d3d11_buffer; // nullptr when in the ring
+
+		bool in_ring = false;
+		std::vector<char> shadow; // Uploaded again when the ring wrapped since the last upload
+		uint32_t ring_offset = 0;
+		uint64_t ring_pass = 0;   // UploadRing::pass() of the upload
+	};
+
+	struct D3D11IndexBuffer : IndexBuffer {
+	private:
+		friend class D3D11Backend;
+		ComPtr<ID3D11Buffer> d3d11_buffer;
+	};
+
+	struct D3D11Texture2D : Texture2D {
+	private:
+		friend class D3D11Backend;
+		ComPtr<ID3D11Texture2D> d3d11_texture;
+		ComPtr<ID3D11ShaderResourceView> view;
+	};
+
+	struct D3D11Sampler : Sampler {
+	private:
+		friend class D3D11Backend;
+		ComPtr<ID3D11SamplerState> d3d11_sampler;
+	};
+
+	struct D3D11VertexShader : VertexShader {
+	private:
+		friend class D3D11Backend;
+
+		ComPtr<ID3D10Blob> blob;
+		ComPtr<ID3D11InputLayout> d3d11_layout; // May be abstracted into its own thing later
+		ComPtr<ID3D11Buffer> const_buffer; // nullptr when uniforms go through the constant upload ring
+		ComPtr<ID3D11VertexShader> d3d11_shader;
+		std::vector<char> uniform_shadow; // CPU copy of the whole buffer, the source of every upload
+		uint32_t ring_offset = 0;
+		uint64_t ring_pass = 0;
+	};
+
+	// One big dynamic buffer that per frame uploads are sub-allocated from.
+	// Written with MAP_WRITE_NO_OVERWRITE, only a wrap discards
+	struct D3D11UploadBuffer {
+		UploadRing ring;
+		ComPtr<ID3D11Buffer> buffer;
+	};
+
+	// D3D11_QUERY_EVENT issued after a frame's commands. Once it's signaled the frame's uploads are retired
+	struct D3D11FrameFence {
+		uint64_t fence = 0;
+		ComPtr<ID3D11Query> query;
+	};
+
+	struct D3D11PixelShader : PixelShader {
+	private:
+		friend class D3D11Backend;
+
+		ComPtr<ID3D10Blob> blob;
+		ComPtr<ID3D11PixelShader> d3d11_shader;
+	};
+
+	struct D3D11GpuScope {
+		const char* name = "";
+		ComPtr<ID3D11Query> begin; // D3D11_QUERY_TIMESTAMP
+		ComPtr<ID3D11Query> end;
+	};
+
+	// Timestamp queries of one frame. Read back GPU_FRAME_LATENCY frames later, when it's reused
+	struct D3D11GpuFrame {
+		ComPtr<ID3D11Query> disjoint; // D3D11_QUERY_TIMESTAMP_DISJOINT, gives the frequency
+		std::vector<D3D11GpuScope> scopes; // Queries are kept and reused, scope_count are used this frame
+		uint32_t scope_count = 0;
+		int64_t cpu_start_ns = 0; // GPU times are placed relative to this in the trace
+		bool issued = false;
+	};
+
+	// What's bound on the immediate context, calls that wouldn't change it are skipped.
+	// The context holds a reference to everything bound, so a shadowed pointer can't be freed
+	// and handed out again while it's in here.
+	struct D3D11BoundState {
+		static constexpr uint32_t MAX_VERTEX_SLOTS = D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT;
+
+		ID3D11InputLayout* input_layout = nullptr;
+		ID3D11VertexShader* vertex_shader = nullptr;
+		ID3D11Buffer* vertex_constant_buffer = nullptr; // Slot 0
+		UINT vertex_constant_offset = 0; // In 16 byte constants, only in the constant ring
+		ID3D11PixelShader* pixel_shader = nullptr;
+		D3D_PRIMITIVE_TOPOLOGY topology = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+		ID3D11BlendState* blend_state = nullptr; // nullptr is the default, opaque
+		ID3D11RenderTargetView* render_target = nullptr;
+		std::optional<D3D11_VIEWPORT> viewport;
+		ID3D11Buffer* vertex_buffers[MAX_VERTEX_SLOTS] = {};
+		UINT vertex_strides[MAX_VERTEX_SLOTS] = {};
+		UINT vertex_offsets[MAX_VERTEX_SLOTS] = {};
+		ID3D11Buffer* index_buffer = nullptr;
+		DXGI_FORMAT index_format = DXGI_FORMAT_UNKNOWN;
+		ID3D11ShaderResourceView* pixel_textures[MAX_TEXTURE_SLOTS] = {};
+		ID3D11SamplerState* pixel_samplers[MAX_TEXTURE_SLOTS] = {};
+
+		// Bound ring users. Their data is uploaded again and rebound when the ring wraps under them.
+		// Forgotten on present together with their slots, the pools may free them once the frame executed
+		D3D11VertexBuffer* ring_vertex_buffers[MAX_VERTEX_SLOTS] = {};
+		D3D11VertexShader* ring_vertex_shader = nullptr;
+	};
+
+	class D3D11Backend final : public RenderBackend {
+	public:
+		RenderBackendType type() const override { return RenderBackendType::D3D11; }
+
+		void init(const struct AppSpec& app_spec, void* native_window) override;
+		void set_viewport(glm::vec2 pos, glm::vec2 size) override;
+		void clear_color(const glm::vec4& color) override;
+		void present(int VSync) override;
+
+		VertexBuffer* find(VertexBufferHandle buffer) const override { return _vertex_buffers.find(buffer); }
+		IndexBuffer* find(IndexBufferHandle buffer) const override { return _index_buffers.find(buffer); }
+		VertexShader* find(VertexShaderHandle shader) const override { return _vertex_shaders.find(shader); }
+		PixelShader* find(PixelShaderHandle shader) const override { return _pixel_shaders.find(shader); }
+		void destroy(VertexBufferHandle buffer, uint64_t frame) override { _vertex_buffers.remove(buffer, frame); }
+		void destroy(IndexBufferHandle buffer, uint64_t frame) override { _index_buffers.remove(buffer, frame); }
+		void destroy(VertexShaderHandle shader, uint64_t frame) override { _vertex_shaders.remove(shader, frame); }
+		void destroy(PixelShaderHandle shader, uint64_t frame) override { _pixel_shaders.remove(shader, frame); }
+		void collect_resources(uint64_t executed_frames) override;
+
+		VertexBufferHandle create_vertex_buffer(
+			const void* data,
+			uint32_t vertex_size,
+			uint32_t vertex_count,
+			BufferDataType data_type
+		) override;
+		void update(VertexBuffer& buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count) override;
+		void bind_vertex_buffers(
+			uint32_t first_slot, uint32_t buffer_count,
+			VertexBuffer* const* buffers, const uint32_t* strides
+		) override;
+		IndexBufferHandle create_index_buffer(
+			const void* data,
+			IndexFormat format,
+			uint32_t index_count,
+			BufferDataType data_type
+		) override;
+		void update(IndexBuffer& buffer, const void* data, uint32_t index_count) override;
+		void bind(IndexBuffer& buffer) override;
+
+		Shared<Texture2D> create_texture(uint32_t width, uint32_t height, uint32_t mip_count, TextureFormat format) override;
+		void update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data) override;
+		Shared<Sampler> create_sampler(const SamplerDesc& desc) override;
+		void bind(Texture2D& texture, uint32_t slot) override;
+		void bind(Sampler& sampler, uint32_t slot) override;
+
+		Shared<VertexShader> try_compile_vertex_shader(
+			const std::wstring& shader_path,
+			const std::vector<VertexElement>& layout,
+			uint32_t uniform_buffer_size,
+			const std::string& main_name,
+			std::string& error
+		) override;
+		Shared<PixelShader> try_compile_pixel_shader(
+			const std::wstring& shader_path,
+			const std::string& main_name,
+			std::string& error
+		) override;
+		VertexShaderHandle add(VertexShader&& compiled) override;
+		PixelShaderHandle add(PixelShader&& compiled) override;
+		void replace(VertexShader& shader, VertexShader& compiled) override;
+		void replace(PixelShader& shader, PixelShader& compiled) override;
+		void bind(VertexShader& shader) override;
+		void bind(PixelShader& shader) override;
+		void update(VertexShader& shader, const void* data_ptr, uint32_t offset, uint32_t data_size) override;
+
+		void set_topology(TopologyType topology) override;
+		void set_blend_mode(BlendMode mode) override;
+		void draw(uint32_t vertex_count, uint32_t vertex_start_location) override;
+		void draw_instanced(
+			uint32_t vertex_count, uint32_t instance_count,
+			uint32_t vertex_start_location, uint32_t instance_start_location
+		) override;
+		void draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) override;
+
+		void begin_gpu_scope(const char* name) override;
+		void end_gpu_scope() override;
+
+		// Getters
+		ComPtr<ID3D11Device> device() { return _device; }
+		ComPtr<ID3D11DeviceContext> device_context() { return _device_context; }
+
+	private:
+		void check_d3d_error(HRESULT result) const;
+		// Vertex and index buffers. data may be nullptr, except for Static buffers
+		ComPtr<ID3D11Buffer> create_buffer(const void* data, uint32_t size, UINT bind_flags, BufferDataType data_type) const;
+		void write_buffer(ID3D11Buffer* buffer, const void* data, uint32_t size) const;
+		Unique<D3D11UploadBuffer> create_upload_buffer(uint32_t capacity, UINT bind_flags) const;
+		// Copies data into the ring and returns its offset. Discards on wrap and when the GPU is a whole ring behind
+		uint32_t upload(D3D11UploadBuffer& uploads, const void* data, uint32_t size, uint32_t alignment);
+		void upload(D3D11VertexBuffer& buffer);
+		void upload(D3D11VertexShader& shader);
+		// Re-uploads bound ring users from an earlier pass and rebinds the ones that moved
+		void refresh_ring_vertex_buffers();
+		void refresh_ring_constants();
+		// Drops the bound ring users and their shadowed slots, so the next frame binds them again
+		void forget_ring_users();
+		void bind_ring_constants(D3D11VertexShader& shader);
+		// Fences the frame's uploads and retires the ones the GPU is done with. Never waits
+		void end_upload_frame();
+		D3D_PRIMITIVE_TOPOLOGY convert_topology_to_d3d11(TopologyType topology) const;
+		DXGI_FORMAT convert_vertex_format_to_d3d11(VertexFormat format) const;
+		DXGI_FORMAT convert_texture_format_to_d3d11(TextureFormat format) const;
+		// Goes through the bytecode cache when there is one. Returns false with the compiler output in error
+		bool compile_shader_blob(
+			const std::wstring& shader_path,
+			const std::string& main_name,
+			const char* profile,
+			ComPtr<ID3D10Blob>& blob,
+			std::string& error
+		) const;
+		void reflect_uniform_layout(D3D11VertexShader& shader) const;
+		UniformType convert_uniform_type_from_d3d11(const D3D11_SHADER_TYPE_DESC& desc) const;
+		// Updates the shadow and counts the call. Returns true when the API has to be called
+		template<typename Type>
+		bool track(Type& bound, const Type& value) {
+			const bool changed = !(bound == value);
+			bound = value;
+			count_state_call(changed);
+			return changed;
+		}
+		// The whole frame is the outermost GPU scope, present ends one and begins the next
+		void begin_gpu_frame();
+		void end_gpu_frame();
+		// Never waits. Results that aren't ready are dropped
+		void collect_gpu_frame(D3D11GpuFrame& frame);
+
+	private:
+		ComPtr<IDXGISwapChain> _swap_chain;
+		ComPtr<ID3D11Device> _device;
+		ComPtr<ID3D11DeviceContext> _device_context;
+		ComPtr<ID3D11RenderTargetView> _swap_chain_render_target;
+
+		// D3D11.1 lets UpdateSubresource1 write a part of a constant buffer.
+		// Without it every uniform update maps the whole buffer with discard.
+		ComPtr<ID3D11DeviceContext1> _device_context1;
+		bool _partial_constant_buffer_updates = false;
+
+		// Dynamic vertex buffers up to a quarter of the ring and uniforms are sub-allocated from these.
+		// Uniforms need D3D11.1 constant buffer offsets and no overwrite maps, otherwise they use their own buffers.
+		// With discard on wrap D3D11 never overwrites what the GPU still reads, the fences keep the ring from
+		// wrapping into in flight frames in the first place.
+		Unique<D3D11UploadBuffer> _vertex_uploads;
+		Unique<D3D11UploadBuffer> _constant_uploads;
+		std::deque<D3D11FrameFence> _frame_fences; // Oldest first
+		std::vector<ComPtr<ID3D11Query>> _free_fence_queries;
+		uint64_t _frame_fence = 0;
+
+		Unique<ShaderCache> _shader_cache;
+		D3D11BoundState _bound;
+
+		ResourcePool<D3D11VertexBuffer, VertexBuffer> _vertex_buffers;
+		ResourcePool<D3D11IndexBuffer, IndexBuffer> _index_buffers;
+		ResourcePool<D3D11VertexShader, VertexShader> _vertex_shaders;
+		ResourcePool<D3D11PixelShader, PixelShader> _pixel_shaders;
+		ComPtr<ID3D11BlendState> _premultiplied_blend_state;
+
+		static constexpr uint32_t GPU_FRAME_LATENCY = 4;
+		std::array<D3D11GpuFrame, GPU_FRAME_LATENCY> _gpu_frames;
+		uint32_t _gpu_frame_index = 0;
+		bool _gpu_frame_open = false;
+		std::vector<uint32_t> _gpu_scope_stack;
+	};
+}
+#endif
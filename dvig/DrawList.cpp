@@ -0,0 +1,336 @@
+#include "pch.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "FrameTiming.h"
+#include "Profiler.h"
+#include "VertexKernels.h"
+#include "Memory.h"
+#include "Font.h"
+
+namespace dvig {
+	namespace {
+		constexpr uint32_t RADIX_BITS = 8;
+		constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+		constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+		// Items per chunk of the parallel sort, small ones aren't worth a job
+		constexpr uint32_t PARALLEL_SORT_CHUNK = 1 << 14;
+
+		using Histogram = std::array<uint32_t, RADIX_SIZE>;
+
+		uint32_t digit(uint64_t key, uint32_t pass) {
+			return static_cast<uint32_t>(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1);
+		}
+
+		// Returns whether [begin, end) already is in order
+		bool count_digits(const SortItem* items, uint32_t begin, uint32_t end, Histogram* histograms) {
+			bool in_order = true;
+			for (uint32_t i = begin; i < end; ++i) {
+				const uint64_t key = items[i].key;
+				in_order &= i == begin || items[i - 1].key <= key;
+				for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+					histograms[pass][digit(key, pass)]++;
+				}
+			}
+			return in_order;
+		}
+
+		// A pass where every key has the same digit wouldn't move anything
+		bool skip_pass(const Histogram& histogram, uint32_t count) {
+			return *std::max_element(histogram.begin(), histogram.end()) == count;
+		}
+
+		uint32_t sort_serial(SortItem*& from, SortItem*& to, uint32_t count) {
+			Histogram histograms[RADIX_PASSES] = {};
+			if (count_digits(from, 0, count, histograms)) {
+				return 0;
+			}
+
+			uint32_t passes = 0;
+			for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+				const Histogram& histogram = histograms[pass];
+				if (skip_pass(histogram, count)) {
+					continue;
+				}
+
+				Histogram offsets;
+				uint32_t offset = 0;
+				for (uint32_t bucket = 0; bucket < RADIX_SIZE; ++bucket) {
+					offsets[bucket] = offset;
+					offset += histogram[bucket];
+				}
+
+				for (uint32_t i = 0; i < count; ++i) {
+					to[offsets[digit(from[i].key, pass)]++] = from[i];
+				}
+
+				std::swap(from, to);
+				passes++;
+			}
+			return passes;
+		}
+
+		// Every pass counts digits per chunk, turns the counts into per chunk offsets (bucket major, so
+		// chunk order is kept inside a bucket and the sort stays stable) and scatters the chunks in parallel
+		uint32_t sort_parallel(SortItem*& from, SortItem*& to, uint32_t count, JobSystem& jobs, FrameArena& arena) {
+			const uint32_t chunk_count = std::min(jobs.thread_count() * 4, count / PARALLEL_SORT_CHUNK);
+			const uint32_t chunk_size = (count + chunk_count - 1) / chunk_count;
+			auto chunk_begin = [&](uint32_t chunk) { return std::min(chunk * chunk_size, count); };
+
+			// Every digit of the unsorted items, per chunk. The first pass that runs uses them as they are
+			Histogram* chunk_histograms = arena.allocate_array<Histogram>(size_t(chunk_count) * RADIX_PASSES);
+			uint8_t* chunk_in_order = arena.allocate_array<uint8_t>(chunk_count);
+			jobs.parallel_for(chunk_count, [&](uint32_t begin, uint32_t end) {
+				for (uint32_t chunk = begin; chunk < end; ++chunk) {
+					chunk_in_order[chunk] = count_digits(from, chunk_begin(chunk), chunk_begin(chunk + 1), &chunk_histograms[size_t(chunk) * RADIX_PASSES]);
+				}
+			});
+
+			bool in_order = true;
+			for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+				const uint32_t begin = chunk_begin(chunk);
+				in_order = in_order && chunk_in_order[chunk] && (begin == 0 || from[begin - 1].key <= from[begin].key);
+			}
+			if (in_order) {
+				return 0;
+			}
+
+			Histogram totals[RADIX_PASSES] = {};
+			for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+				for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+					for (uint32_t bucket = 0; bucket < RADIX_SIZE; ++bucket) {
+						totals[pass][bucket] += chunk_histograms[size_t(chunk) * RADIX_PASSES + pass][bucket];
+					}
+				}
+			}
+
+			Histogram* offsets = arena.allocate_array<Histogram>(chunk_count);
+			uint32_t passes = 0;
+			for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+				if (skip_pass(totals[pass], count)) {
+					continue;
+				}
+
+				if (passes > 0) {
+					// The items moved since they were counted
+					jobs.parallel_for(chunk_count, [&](uint32_t begin, uint32_t end) {
+						for (uint32_t chunk = begin; chunk < end; ++chunk) {
+							Histogram& histogram = offsets[chunk];
+							histogram.fill(0);
+							for (uint32_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+								histogram[digit(from[i].key, pass)]++;
+							}
+						}
+					});
+				} else {
+					for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+						offsets[chunk] = chunk_histograms[size_t(chunk) * RADIX_PASSES + pass];
+					}
+				}
+
+				uint32_t offset = 0;
+				for (uint32_t bucket = 0; bucket < RADIX_SIZE; ++bucket) {
+					for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+						const uint32_t chunk_count_in_bucket = offsets[chunk][bucket];
+						offsets[chunk][bucket] = offset;
+						offset += chunk_count_in_bucket;
+					}
+				}
+
+				jobs.parallel_for(chunk_count, [&](uint32_t begin, uint32_t end) {
+					for (uint32_t chunk = begin; chunk < end; ++chunk) {
+						Histogram& chunk_offsets = offsets[chunk];
+						for (uint32_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+							to[chunk_offsets[digit(from[i].key, pass)]++] = from[i];
+						}
+					}
+				});
+
+				std::swap(from, to);
+				passes++;
+			}
+			return passes;
+		}
+	}
+
+	SortItem* radix_sort(SortItem* items, SortItem* scratch, uint32_t count, JobSystem* jobs, uint32_t* pass_count, FrameArena* arena) {
+		SortItem* from = items;
+		SortItem* to = scratch;
+		uint32_t passes = 0;
+		if (count >= 2) {
+			if (jobs != nullptr && jobs->thread_count() > 1 && count >= PARALLEL_SORT_MIN_ITEMS) {
+				FrameArena heap_arena;
+				FrameArena& sort_arena = arena != nullptr ? *arena : heap_arena;
+				ArenaScope arena_scope(sort_arena);
+				passes = sort_parallel(from, to, count, *jobs, sort_arena);
+			} else {
+				passes = sort_serial(from, to, count);
+			}
+		}
+
+		if (pass_count != nullptr) {
+			*pass_count = passes;
+		}
+		return from;
+	}
+
+	void DrawList::set_order_independent(bool order_independent) {
+		if (order_independent != _order_independent) {
+			_order_independent = order_independent;
+			_new_sequence = true;
+		}
+	}
+
+	void DrawList::push_quad(const glm::vec2 corners[4], const glm::vec4& color, const glm::mat4& transform) {
+		if (_quad_transforms.empty() || std::memcmp(&_quad_transforms.back(), &transform, sizeof(glm::mat4)) != 0) {
+			_quad_transforms.push_back(transform);
+		}
+
+		QuadDraw& draw = _quads.emplace_back();
+		draw.color = pack_color_rgba8(color);
+		draw.transform = static_cast<uint32_t>(_quad_transforms.size() - 1);
+		for (uint32_t i = 0; i < 4; ++i) {
+			_quad_x.push_back(corners[i].x);
+			_quad_y.push_back(corners[i].y);
+		}
+		push(DrawType::Quad, 0, static_cast<uint32_t>(_quads.size() - 1));
+	}
+
+	void DrawList::push_rect(const RectInstance& instance, const glm::mat4& view_projection) {
+		if (_view_projections.empty() || std::memcmp(&_view_projections.back(), &view_projection, sizeof(glm::mat4)) != 0) {
+			_view_projections.push_back(view_projection);
+		}
+
+		// Already as dense as resource ids, saturating like them. Rects sharing 255 still draw right,
+		// the rect batcher splits where the view projection changes
+		const uint32_t view_projection_index = static_cast<uint32_t>(_view_projections.size() - 1);
+		_rects.push_back({ instance, view_projection_index });
+		push(DrawType::Rect, uint8_t(std::min(view_projection_index + 1, 255u)), static_cast<uint32_t>(_rects.size() - 1));
+	}
+
+	void DrawList::push_texture(TextureDraw draw) {
+		const uint8_t resource = resource_id(draw.texture.get());
+		_textures.push_back(std::move(draw));
+		push(DrawType::Texture, resource, static_cast<uint32_t>(_textures.size() - 1));
+	}
+
+	void DrawList::begin_text(const Font& font) {
+		TextDraw& draw = _texts.emplace_back();
+		draw.font = &font;
+		draw.distance_range = font.distance_range();
+		draw.glyph_start = static_cast<uint32_t>(_glyphs.size());
+		push(DrawType::Text, resource_id(&font), static_cast<uint32_t>(_texts.size() - 1));
+	}
+
+	void DrawList::push_glyph(uint32_t glyph, const glm::vec2 corners[4], uint32_t color) {
+		assert(!_texts.empty() && type(_items.back().value) == DrawType::Text && "push_glyph without begin_text");
+
+		GlyphDraw& draw = _glyphs.emplace_back();
+		std::copy(corners, corners + 4, draw.corners);
+		draw.glyph = glyph;
+		draw.color = color;
+		_texts.back().glyph_count++;
+	}
+
+	void DrawList::transform_quads() {
+		const uint32_t count = static_cast<uint32_t>(_quads.size());
+		uint32_t begin = _transformed_quads;
+		while (begin < count) {
+			const uint32_t transform = _quads[begin].transform;
+			uint32_t end = begin + 1;
+			while (end < count && _quads[end].transform == transform) {
+				end++;
+			}
+
+			float* x = _quad_x.data() + size_t(begin) * 4;
+			float* y = _quad_y.data() + size_t(begin) * 4;
+			transform_points_2d(_quad_transforms[transform], x, y, x, y, (end - begin) * 4);
+			begin = end;
+		}
+		_transformed_quads = count;
+	}
+
+	const SortItem* DrawList::sort(JobSystem* jobs, FrameArena* arena) {
+		DVIG_PROFILE_SCOPE("DrawList::sort");
+
+		const int64_t start = steady_clock_now();
+		_scratch.resize(_items.size());
+		uint32_t passes = 0;
+		const SortItem* sorted = radix_sort(_items.data(), _scratch.data(), size(), jobs, &passes, arena);
+
+		_stats.items += _items.size();
+		_stats.sorts++;
+		_stats.sort_passes += passes;
+		_stats.sort_ns += steady_clock_now() - start;
+		return sorted;
+	}
+
+	void DrawList::clear() {
+		_items.clear();
+		_quads.clear();
+		_quad_x.clear();
+		_quad_y.clear();
+		_quad_transforms.clear();
+		_transformed_quads = 0;
+		_rects.clear();
+		_textures.clear();
+		_texts.clear();
+		_glyphs.clear();
+		_view_projections.clear();
+		_sequence = 0;
+		_last_group = ~0ull;
+		_new_sequence = true;
+
+		if (_resource_count > 0) {
+			_resources.fill(nullptr);
+			_resource_count = 0;
+		}
+	}
+
+	void DrawList::push(DrawType type, uint8_t resource, uint32_t index) {
+		assert(index <= INDEX_MASK);
+
+		const uint64_t group = DrawKey::make(_layer, _depth, 0, uint8_t(type), resource);
+		if (_new_sequence || (!_order_independent && group != _last_group)) {
+			// Saturates rather than wraps, past it draws group like order independent ones
+			assert(_sequence < DrawKey::MAX_SEQUENCE && "Too many sequences in one flush");
+			_sequence = std::min(_sequence + 1, DrawKey::MAX_SEQUENCE);
+			_new_sequence = false;
+		}
+		_last_group = group;
+
+		_items.push_back({ group | (uint64_t(_sequence) << DrawKey::SEQUENCE_SHIFT), (static_cast<uint32_t>(type) << TYPE_SHIFT) | index });
+	}
+
+	bool DrawList::references(const void* resource) const {
+		if (resource == nullptr || _resource_count == 0) {
+			return false;
+		}
+		return _resources[find_resource_slot(resource)] == resource || _resource_count == 255;
+	}
+
+	uint32_t DrawList::find_resource_slot(const void* resource) const {
+		// Never more than half full, so the probes always reach an empty slot
+		uint32_t slot = static_cast<uint32_t>((reinterpret_cast<uintptr_t>(resource) >> 4) * 0x9E3779B1u) % RESOURCE_SLOTS;
+		while (_resources[slot] != nullptr && _resources[slot] != resource) {
+			slot = (slot + 1) % RESOURCE_SLOTS;
+		}
+		return slot;
+	}
+
+	uint8_t DrawList::resource_id(const void* resource) {
+		if (resource == nullptr) {
+			return 0;
+		}
+
+		const uint32_t slot = find_resource_slot(resource);
+		if (_resources[slot] == resource) {
+			return _resource_ids[slot];
+		}
+		if (_resource_count == 255) {
+			return 255;
+		}
+		_resources[slot] = resource;
+		_resource_ids[slot] = static_cast<uint8_t>(++_resource_count);
+		return _resource_ids[slot];
+	}
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "QuadBatch.h"
+
+namespace dvig {
+	class JobSystem;
+	class FrameArena;
+	class Font;
+	struct Texture2D;
+	struct Sampler;
+
+	// 64 bit sort key of a draw, compared as a plain integer. From the most significant bit:
+	//   layer 8 | depth 16 | sequence 24 | pipeline 8 | resource 8
+	// Layers draw in order, inside a layer depths do. Inside a depth the sequence keeps the draws in the order
+	// they were issued: it only moves on when a draw can't batch with the one before it, so a run of draws
+	// sharing pipeline and resource (texture, font, view projection) keeps one sequence and batches.
+	// Pipeline and resource only group draws that share a sequence, which order independent draws do.
+	// Resources get small ids in the order a flush first uses them, see DrawList::resource_id().
+	// Fields start on byte boundaries, radix_sort skips the bytes no key differs in
+	struct DrawKey {
+		static constexpr uint32_t RESOURCE_SHIFT = 0;
+		static constexpr uint32_t PIPELINE_SHIFT = 8;
+		static constexpr uint32_t SEQUENCE_SHIFT = 16;
+		static constexpr uint32_t DEPTH_SHIFT = 40;
+		static constexpr uint32_t LAYER_SHIFT = 56;
+		static constexpr uint16_t MAX_DEPTH = 0xffff;
+		static constexpr uint32_t MAX_SEQUENCE = (1 << 24) - 1;
+
+		static constexpr uint64_t make(uint8_t layer, uint16_t depth, uint32_t sequence, uint8_t pipeline, uint8_t resource) {
+			return (uint64_t(layer) << LAYER_SHIFT) | (uint64_t(depth & MAX_DEPTH) << DEPTH_SHIFT)
+				| (uint64_t(sequence & MAX_SEQUENCE) << SEQUENCE_SHIFT) | (uint64_t(pipeline) << PIPELINE_SHIFT)
+				| (uint64_t(resource) << RESOURCE_SHIFT);
+		}
+
+		static constexpr uint8_t layer(uint64_t key) { return uint8_t(key >> LAYER_SHIFT); }
+		static constexpr uint16_t depth(uint64_t key) { return uint16_t(key >> DEPTH_SHIFT) & MAX_DEPTH; }
+		static constexpr uint32_t sequence(uint64_t key) { return uint32_t(key >> SEQUENCE_SHIFT) & MAX_SEQUENCE; }
+		static constexpr uint8_t pipeline(uint64_t key) { return uint8_t(key >> PIPELINE_SHIFT); }
+		static constexpr uint8_t resource(uint64_t key) { return uint8_t(key >> RESOURCE_SHIFT); }
+	};
+
+	struct SortItem {
+		uint64_t key = 0;
+		uint32_t value = 0;
+	};
+
+	// Below this radix_sort stays on the calling thread
+	static constexpr uint32_t PARALLEL_SORT_MIN_ITEMS = 1 << 16;
+
+	// Stable LSD radix sort by key, a byte per pass. A first counting pass finds the bytes every key shares
+	// and those passes are skipped, so keys that only differ in a field or two cost a pass or two.
+	// Items already in order cost only the counting pass.
+	// scratch has to hold count items. Returns items or scratch, whichever ended up with the result.
+	// With jobs and at least PARALLEL_SORT_MIN_ITEMS every pass is split over the threads,
+	// with the per chunk counts in arena when there is one and on the heap otherwise.
+	// pass_count gets the passes that weren't skipped
+	SortItem* radix_sort(
+		SortItem* items, SortItem* scratch, uint32_t count,
+		JobSystem* jobs = nullptr, uint32_t* pass_count = nullptr, FrameArena* arena = nullptr
+	);
+
+	enum class DrawType : uint32_t {
+		Quad,
+		Rect,
+		Texture,
+		Text,
+	};
+
+	// The corners live in DrawList, transformed by transform_quads()
+	struct QuadDraw {
+		uint32_t color = 0;     // RGBA8
+		uint32_t transform = 0; // Index into DrawList's transforms
+	};
+
+	struct RectDraw {
+		RectInstance instance;
+		uint32_t view_projection = 0; // Index into DrawList::view_projections()
+	};
+
+	struct TextureDraw {
+		Shared<Texture2D> texture;
+		Shared<Sampler> sampler;
+		glm::vec4 uv_rect;
+		glm::vec4 tint;
+		glm::mat4 transform; // Unit quad to clip space
+	};
+
+	// Only the font's glyph slot is kept, the page and uvs are looked up when it's submitted.
+	// Rasterizing glyphs for a later draw_text can repack the page and move the ones recorded before
+	struct GlyphDraw {
+		glm::vec2 corners[4];
+		uint32_t glyph = 0;
+		uint32_t color = 0;
+	};
+
+	// The glyphs of one draw_text call. The font has to live until the draw list is submitted
+	struct TextDraw {
+		const Font* font = nullptr;
+		float distance_range = 0.0f;
+		uint32_t glyph_start = 0;
+		uint32_t glyph_count = 0;
+	};
+
+	struct DrawListStats {
+		uint64_t items = 0;
+		uint32_t sorts = 0;
+		uint32_t sort_passes = 0; // Radix passes that weren't skipped
+		int64_t sort_ns = 0;
+	};
+
+	// The 2D draws recorded between two flushes. Each gets a DrawKey from the current layer and depth,
+	// sort() puts them in key order and the Renderer submits them that way.
+	// The pipeline field is the DrawType, every type has its own pipeline. The resource field is the
+	// texture of texture draws, the font of text and the view projection of rects, quads have none
+	class DrawList {
+	public:
+		// Later layers draw over earlier ones. Inside a layer higher depths draw over lower ones
+		void set_layer(uint8_t layer) { _layer = layer; }
+		uint8_t layer() const { return _layer; }
+		// Every value fits, DrawKey::MAX_DEPTH draws over everything else in the layer
+		void set_depth(uint16_t depth) { _depth = depth; }
+		uint16_t depth() const { return _depth; }
+		// Draws pushed while it's on share one sequence, so inside their layer and depth they are grouped by
+		// pipeline and resource instead of keeping their order. Only for draws that don't overlap each other
+		void set_order_independent(bool order_independent);
+		bool order_independent() const { return _order_independent; }
+
+		// Corners as given, transform_quads() transforms them
+		void push_quad(const glm::vec2 corners[4], const glm::vec4& color, const glm::mat4& transform);
+		void push_rect(const RectInstance& instance, const glm::mat4& view_projection);
+		void push_texture(TextureDraw draw);
+		// Glyphs pushed after it belong to it, until the next push of any kind
+		void begin_text(const Font& font);
+		void push_glyph(uint32_t glyph, const glm::vec2 corners[4], uint32_t color);
+
+		// Transforms the corners of every quad pushed since the last call, a run of quads sharing a
+		// transform at a time with transform_points_2d
+		void transform_quads();
+		// The items in submission order, valid until the next push or clear()
+		const SortItem* sort(JobSystem* jobs = nullptr, FrameArena* arena = nullptr);
+		void clear();
+
+		// Whether a draw pushed since clear() may use the texture, font or other resource.
+		// Past 255 resources it can't tell and says yes
+		bool references(const void* resource) const;
+
+		bool empty() const { return _items.empty(); }
+		uint32_t size() const { return static_cast<uint32_t>(_items.size()); }
+
+		static DrawType type(uint32_t value) { return static_cast<DrawType>(value >> TYPE_SHIFT); }
+		static uint32_t index(uint32_t value) { return value & INDEX_MASK; }
+
+		const QuadDraw& quad(uint32_t index) const { return _quads[index]; }
+		// Transformed once transform_quads() ran
+		glm::vec2 quad_corner(uint32_t index, uint32_t corner) const { return { _quad_x[index * 4 + corner], _quad_y[index * 4 + corner] }; }
+		const RectDraw& rect(uint32_t index) const { return _rects[index]; }
+		const TextureDraw& texture(uint32_t index) const { return _textures[index]; }
+		const TextDraw& text(uint32_t index) const { return _texts[index]; }
+		const GlyphDraw& glyph(uint32_t index) const { return _glyphs[index]; }
+		const glm::mat4& view_projection(uint32_t index) const { return _view_projections[index]; }
+
+		const DrawListStats& stats() const { return _stats; }
+		void reset_stats() { _stats = {}; }
+
+	private:
+		static constexpr uint32_t TYPE_SHIFT = 30;
+		static constexpr uint32_t INDEX_MASK = (1u << TYPE_SHIFT) - 1;
+
+		void push(DrawType type, uint8_t resource, uint32_t index);
+		// 1 for the first resource of the flush, 2 for the next... Past 255 they all share 255, which only
+		// costs grouping: draws with equal keys keep their issue order
+		uint8_t resource_id(const void* resource);
+		// The resource's slot, or the empty one it would go in
+		uint32_t find_resource_slot(const void* resource) const;
+
+	private:
+		uint8_t _layer = 0;
+		uint16_t _depth = 0;
+		bool _order_independent = false;
+		// Of the last push, the next one that differs in anything but the index starts a new sequence
+		uint32_t _sequence = 0;
+		uint64_t _last_group = ~0ull;
+		bool _new_sequence = true;
+
+		// Open addressing from resource to id, twice the ids there are so probes stay short
+		static constexpr uint32_t RESOURCE_SLOTS = 512;
+		std::array<const void*, RESOURCE_SLOTS> _resources = {};
+		std::array<uint8_t, RESOURCE_SLOTS> _resource_ids = {};
+		uint32_t _resource_count = 0;
+
+		std::vector<SortItem> _items;
+		std::vector<SortItem> _scratch;
+
+		std::vector<QuadDraw> _quads;
+		// 4 per quad, kept apart so transform_quads() runs over plain arrays
+		std::vector<float> _quad_x;
+		std::vector<float> _quad_y;
+		// Deduplicated against the last one like the view projections
+		std::vector<glm::mat4> _quad_transforms;
+		uint32_t _transformed_quads = 0;
+		std::vector<RectDraw> _rects;
+		std::vector<TextureDraw> _textures;
+		std::vector<TextDraw> _texts;
+		std::vector<GlyphDraw> _glyphs;
+		// Deduplicated against the last one, consecutive rects mostly share it
+		std::vector<glm::mat4> _view_projections;
+
+		DrawListStats _stats;
+	};
+}
@@ -0,0 +1,383 @@
+#include "pch.h"
+#include "Font.h"
+#include "Utils.h"
+#include "Image.h"
+
+namespace dvig {
+	namespace {
+		constexpr uint32_t NO_SLOT = ~0u;
+		constexpr uint32_t REPLACEMENT_CHARACTER = 0xfffd;
+		// Outlines are flattened to a tenth of a distance field texel
+		constexpr float OUTLINE_TOLERANCE = 0.1f;
+
+		uint64_t now_ns() {
+			auto time = std::chrono::steady_clock::now().time_since_epoch();
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+		}
+
+		// Advances position past the codepoint. Invalid or overlong sequences give U+FFFD and skip one byte
+		uint32_t decode_utf8(std::string_view text, size_t& position) {
+			const uint32_t first = static_cast<uint8_t>(text[position++]);
+			if (first < 0x80) {
+				return first;
+			}
+
+			uint32_t length, codepoint, minimum;
+			if ((first & 0xe0) == 0xc0) {
+				length = 1; codepoint = first & 0x1f; minimum = 0x80;
+			} else if ((first & 0xf0) == 0xe0) {
+				length = 2; codepoint = first & 0x0f; minimum = 0x800;
+			} else if ((first & 0xf8) == 0xf0) {
+				length = 3; codepoint = first & 0x07; minimum = 0x10000;
+			} else {
+				return REPLACEMENT_CHARACTER;
+			}
+
+			const size_t start = position;
+			for (uint32_t i = 0; i < length; ++i) {
+				if (position >= text.size() || (static_cast<uint8_t>(text[position]) & 0xc0) != 0x80) {
+					position = start;
+					return REPLACEMENT_CHARACTER;
+				}
+				codepoint = (codepoint << 6) | (static_cast<uint8_t>(text[position]) & 0x3f);
+				position++;
+			}
+
+			if (codepoint < minimum || codepoint > 0x10ffff || (codepoint >= 0xd800 && codepoint <= 0xdfff)) {
+				position = start;
+				return REPLACEMENT_CHARACTER;
+			}
+			return codepoint;
+		}
+
+		float distance_squared_to_segment(glm::vec2 p, glm::vec2 a, glm::vec2 b) {
+			const glm::vec2 ab = b - a;
+			const glm::vec2 ap = p - a;
+			const float length_squared = glm::dot(ab, ab);
+			const float t = length_squared > 0.0f ? std::clamp(glm::dot(ap, ab) / length_squared, 0.0f, 1.0f) : 0.0f;
+			const glm::vec2 d = ap - ab * t;
+			return glm::dot(d, d);
+		}
+	}
+
+	Font::Font(Renderer& renderer, const FontDesc& desc)
+		: _desc(desc), _atlas(renderer, desc.atlas) {
+		assert(desc.sdf_size > 0.0f && desc.sdf_spread > 0.0f);
+		_ascii_slots.fill(NO_SLOT);
+	}
+
+	bool Font::load(const std::filesystem::path& path, std::string& error) {
+		TrueTypeFont file;
+		if (!file.load(path, error)) {
+			return false;
+		}
+
+		_file = std::move(file);
+		reset_glyphs();
+		return true;
+	}
+
+	bool Font::load(std::vector<uint8_t> data, std::string& error) {
+		TrueTypeFont file;
+		if (!file.load(std::move(data), error)) {
+			return false;
+		}
+
+		_file = std::move(file);
+		reset_glyphs();
+		return true;
+	}
+
+	void Font::layout(std::string_view text, float font_size, TextLayout& layout) {
+		const uint64_t start = now_ns();
+
+		layout.quads.clear();
+		layout.font_size = font_size;
+		layout.line_count = 1;
+
+		if (!_file.loaded()) {
+			layout.size = glm::vec2(0.0f);
+			return;
+		}
+
+		const float em_scale = font_size / _file.units_per_em();
+		const float texel_scale = font_size / _desc.sdf_size;
+		const float line_height = this->line_height(font_size);
+
+		glm::vec2 pen(0.0f, ascent(font_size));
+		float width = 0.0f;
+		uint32_t previous = NO_SLOT;
+		uint64_t glyph_count = 0;
+
+		for (size_t position = 0; position < text.size();) {
+			const uint32_t codepoint = decode_utf8(text, position);
+			if (codepoint == '\n') {
+				width = std::max(width, pen.x);
+				pen = glm::vec2(0.0f, pen.y + line_height);
+				layout.line_count++;
+				previous = NO_SLOT;
+				continue;
+			}
+			if (codepoint == '\r') {
+				continue;
+			}
+
+			const uint32_t slot = glyph_slot(codepoint);
+			const Glyph& glyph = _glyphs[slot];
+			if (previous != NO_SLOT) {
+				pen.x += _file.kerning(previous, glyph.index) * em_scale;
+			}
+
+			if (glyph.size.x > 0) {
+				TextQuad& quad = layout.quads.emplace_back();
+				quad.min = pen + glyph.offset * texel_scale;
+				quad.max = quad.min + glm::vec2(static_cast<float>(glyph.size.x), static_cast<float>(glyph.size.y)) * texel_scale;
+				quad.glyph = slot;
+			}
+
+			pen.x += glyph.advance * font_size;
+			previous = glyph.index;
+			glyph_count++;
+		}
+
+		width = std::max(width, pen.x);
+		layout.size = glm::vec2(width, layout.line_count * line_height);
+
+		_stats.layouts++;
+		_stats.glyphs_laid_out += glyph_count;
+		_stats.layout_ns += now_ns() - start;
+	}
+
+	const TextLayout& Font::cached_layout(std::string_view text, float font_size) {
+		uint64_t hash = utils::fnv1a_64(text.data(), text.size());
+		hash = utils::fnv1a_64(&font_size, sizeof(font_size), hash);
+
+		std::vector<Unique<CachedLayout>>& bucket = _layout_cache[hash];
+		for (const Unique<CachedLayout>& cached : bucket) {
+			if (cached->font_size == font_size && cached->text == text) {
+				cached->last_used = _frame;
+				_stats.cache_hits++;
+				return cached->layout;
+			}
+		}
+
+		_stats.cache_misses++;
+		_stats.cached_layouts++;
+
+		Unique<CachedLayout> cached = std::make_unique<CachedLayout>();
+		cached->text = text;
+		cached->font_size = font_size;
+		cached->last_used = _frame;
+		layout(text, font_size, cached->layout);
+
+		bucket.push_back(std::move(cached));
+		return bucket.back()->layout;
+	}
+
+	float Font::line_height(float font_size) const {
+		if (!_file.loaded()) {
+			return 0.0f;
+		}
+		return (_file.ascent() - _file.descent() + _file.line_gap()) * font_size / _file.units_per_em();
+	}
+
+	float Font::ascent(float font_size) const {
+		if (!_file.loaded()) {
+			return 0.0f;
+		}
+		return _file.ascent() * font_size / _file.units_per_em();
+	}
+
+	bool Font::resident(const TextLayout& layout) const {
+		for (const TextQuad& quad : layout.quads) {
+			if (!_atlas.contains(_glyphs[quad.glyph].handle)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Font::rasterize(const TextLayout& layout) {
+		// NOTE: Looking the resident ones up marks them used, so inserting the rest never evicts them
+		for (const TextQuad& quad : layout.quads) {
+			Glyph& glyph = _glyphs[quad.glyph];
+			if (_atlas.region(glyph.handle) == nullptr) {
+				rasterize_glyph(glyph);
+			}
+		}
+	}
+
+	const AtlasRegion* Font::glyph_region(uint32_t glyph) {
+		Glyph& cached = _glyphs[glyph];
+		_stats.glyph_lookups++;
+		const AtlasRegion* region = _atlas.region(cached.handle);
+		if (region == nullptr && rasterize_glyph(cached)) {
+			region = _atlas.region(cached.handle);
+		}
+		return region;
+	}
+
+	void Font::next_frame() {
+		_frame++;
+		_atlas.next_frame();
+
+		for (auto it = _layout_cache.begin(); it != _layout_cache.end();) {
+			std::vector<Unique<CachedLayout>>& bucket = it->second;
+			for (size_t i = 0; i < bucket.size();) {
+				if (bucket[i]->last_used + _desc.layout_cache_frames < _frame) {
+					bucket[i] = std::move(bucket.back());
+					bucket.pop_back();
+					_stats.cache_evictions++;
+					_stats.cached_layouts--;
+				} else {
+					i++;
+				}
+			}
+
+			it = bucket.empty() ? _layout_cache.erase(it) : std::next(it);
+		}
+	}
+
+	void Font::reset_stats() {
+		// Counts of what's cached right now aren't history
+		FontStats stats;
+		stats.glyphs = _stats.glyphs;
+		stats.cached_layouts = _stats.cached_layouts;
+		_stats = stats;
+	}
+
+	void Font::reset_glyphs() {
+		for (const Glyph& glyph : _glyphs) {
+			_atlas.remove(glyph.handle);
+		}
+		_glyphs.clear();
+		_glyph_slots.assign(_file.glyph_count(), NO_SLOT);
+		_ascii_slots.fill(NO_SLOT);
+		_layout_cache.clear();
+		_stats.glyphs = 0;
+		_stats.cached_layouts = 0;
+	}
+
+	uint32_t Font::glyph_slot(uint32_t codepoint) {
+		if (codepoint < _ascii_slots.size() && _ascii_slots[codepoint] != NO_SLOT) {
+			return _ascii_slots[codepoint];
+		}
+
+		const uint32_t index = _file.glyph_index(codepoint);
+		uint32_t slot = _glyph_slots[index];
+		if (slot == NO_SLOT) {
+			slot = static_cast<uint32_t>(_glyphs.size());
+			_glyph_slots[index] = slot;
+
+			Glyph& glyph = _glyphs.emplace_back();
+			glyph.index = index;
+
+			const GlyphMetrics metrics = _file.glyph_metrics(index);
+			const float scale = _desc.sdf_size / _file.units_per_em();
+			glyph.advance = metrics.advance / _file.units_per_em();
+
+			if (metrics.max.x > metrics.min.x && metrics.max.y > metrics.min.y) {
+				// y flips to go down. The field reaches spread texels past the box on every side
+				const float spread = std::ceil(_desc.sdf_spread);
+				const glm::vec2 top_left(std::floor(metrics.min.x * scale) - spread, std::floor(-metrics.max.y * scale) - spread);
+				const glm::vec2 bottom_right(std::ceil(metrics.max.x * scale) + spread, std::ceil(-metrics.min.y * scale) + spread);
+				glyph.offset = top_left;
+				glyph.size = glm::uvec2(static_cast<uint32_t>(bottom_right.x - top_left.x), static_cast<uint32_t>(bottom_right.y - top_left.y));
+
+				// A broken bounding box (or an sdf_size too big for the pages) would never fit, don't rasterize it every draw
+				const uint32_t max_size = _desc.atlas.page_size - 2 * _desc.atlas.padding;
+				if (glyph.size.x > max_size || glyph.size.y > max_size) {
+					glyph.size = glm::uvec2(0);
+					_stats.glyphs_failed++;
+				}
+			}
+
+			_stats.glyphs++;
+		}
+
+		if (codepoint < _ascii_slots.size()) {
+			_ascii_slots[codepoint] = slot;
+		}
+		return slot;
+	}
+
+	bool Font::rasterize_glyph(Glyph& glyph) {
+		assert(glyph.size.x > 0 && glyph.size.y > 0);
+		const uint64_t start = now_ns();
+
+		// Edges in field texels, y down
+		const float scale = _desc.sdf_size / _file.units_per_em();
+		_edges.clear();
+		if (!_file.glyph_outline(glyph.index, OUTLINE_TOLERANCE / scale, _edges)) {
+			_edges.clear(); // Broken glyph data, an empty field rather than half an outline
+		}
+		for (GlyphEdge& edge : _edges) {
+			edge.a = glm::vec2(edge.a.x * scale - glyph.offset.x, -edge.a.y * scale - glyph.offset.y);
+			edge.b = glm::vec2(edge.b.x * scale - glyph.offset.x, -edge.b.y * scale - glyph.offset.y);
+		}
+
+		// Nonzero winding along each row for inside, the nearest edge within spread for the distance.
+		// 0.5 is the outline, 0 and 1 are spread texels outside and inside
+		struct Crossing {
+			float x;
+			int32_t direction;
+		};
+		std::vector<Crossing> crossings;
+		std::vector<const GlyphEdge*> near_edges;
+
+		const float spread = _desc.sdf_spread;
+		const uint32_t width = glyph.size.x;
+		const uint32_t height = glyph.size.y;
+		_pixels.resize(static_cast<size_t>(width) * height * Image::PIXEL_SIZE);
+
+		for (uint32_t y = 0; y < height; ++y) {
+			const float center_y = y + 0.5f;
+
+			crossings.clear();
+			near_edges.clear();
+			for (const GlyphEdge& edge : _edges) {
+				if ((edge.a.y <= center_y) != (edge.b.y <= center_y)) {
+					const float t = (center_y - edge.a.y) / (edge.b.y - edge.a.y);
+					crossings.push_back({ edge.a.x + t * (edge.b.x - edge.a.x), edge.b.y > edge.a.y ? 1 : -1 });
+				}
+				if (std::min(edge.a.y, edge.b.y) - spread <= center_y && std::max(edge.a.y, edge.b.y) + spread >= center_y) {
+					near_edges.push_back(&edge);
+				}
+			}
+			std::sort(crossings.begin(), crossings.end(), [](const Crossing& a, const Crossing& b) { return a.x < b.x; });
+
+			int32_t winding = 0;
+			size_t crossing = 0;
+			uint8_t* row = _pixels.data() + static_cast<size_t>(y) * width * Image::PIXEL_SIZE;
+			for (uint32_t x = 0; x < width; ++x) {
+				const glm::vec2 center(x + 0.5f, center_y);
+				while (crossing < crossings.size() && crossings[crossing].x < center.x) {
+					winding += crossings[crossing].direction;
+					crossing++;
+				}
+
+				float nearest = spread * spread;
+				for (const GlyphEdge* edge : near_edges) {
+					if (std::min(edge->a.x, edge->b.x) - spread <= center.x && std::max(edge->a.x, edge->b.x) + spread >= center.x) {
+						nearest = std::min(nearest, distance_squared_to_segment(center, edge->a, edge->b));
+					}
+				}
+
+				const float distance = winding != 0 ? std::sqrt(nearest) : -std::sqrt(nearest);
+				const float value = std::clamp(0.5f + distance / (2.0f * spread), 0.0f, 1.0f);
+				const uint8_t byte = static_cast<uint8_t>(value * 255.0f + 0.5f);
+				memset(row + x * Image::PIXEL_SIZE, byte, Image::PIXEL_SIZE);
+			}
+		}
+
+		glyph.handle = _atlas.insert(_pixels.data(), width, height);
+
+		_stats.rasterize_ns += now_ns() - start;
+		if (!glyph.handle.valid()) {
+			_stats.glyphs_failed++;
+			return false;
+		}
+		_stats.glyphs_rasterized++;
+		return true;
+	}
+}
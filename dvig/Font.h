@@ -0,0 +1,154 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "TrueType.h"
+#include "TextureAtlas.h"
+
+namespace dvig {
+	class Renderer;
+
+	struct FontDesc {
+		float sdf_size = 32.0f;  // Pixels per em the distance fields are rasterized at. Text stays sharp well above it
+		float sdf_spread = 4.0f; // Texels the field reaches past the outline on each side
+		TextureAtlasDesc atlas = { 1024, 2, 1 };
+		uint32_t layout_cache_frames = 120; // Cached layouts unused for this many frames are dropped
+	};
+
+	// Pixels, y down, relative to the top left of the first line
+	struct TextQuad {
+		glm::vec2 min;
+		glm::vec2 max;
+		uint32_t glyph = 0; // Font's glyph cache slot
+	};
+
+	struct TextLayout {
+		std::vector<TextQuad> quads; // Only glyphs with an outline, spaces don't get one
+		glm::vec2 size = glm::vec2(0.0f); // Widest line by line count * line height
+		float font_size = 0.0f;           // Pixels per em
+		uint32_t line_count = 0;
+	};
+
+	struct FontStats {
+		uint32_t glyphs = 0;            // Glyph metrics cached
+		uint32_t glyphs_rasterized = 0; // Evicted glyphs are rasterized again
+		uint32_t glyphs_failed = 0;     // Didn't fit into the atlas, left out of the draw
+		uint64_t rasterize_ns = 0;
+		uint64_t layouts = 0;           // Layouts actually run, cache misses included
+		uint64_t glyphs_laid_out = 0;
+		uint64_t layout_ns = 0;
+		uint64_t cache_hits = 0;
+		uint64_t cache_misses = 0;
+		uint64_t cache_evictions = 0;
+		uint32_t cached_layouts = 0;
+		uint64_t glyph_lookups = 0;     // glyph_region() calls, one per glyph drawn
+
+		// Share of cached_layout() calls that didn't lay the text out again
+		double layout_hit_rate() const {
+			const uint64_t calls = cache_hits + cache_misses;
+			return calls == 0 ? 1.0 : static_cast<double>(cache_hits) / static_cast<double>(calls);
+		}
+
+		// Share of drawn glyphs that were already in the atlas, every rasterization is a miss, failed ones too
+		double glyph_hit_rate() const {
+			if (glyph_lookups == 0) {
+				return 1.0;
+			}
+			const uint64_t misses = std::min<uint64_t>(static_cast<uint64_t>(glyphs_rasterized) + glyphs_failed, glyph_lookups);
+			return static_cast<double>(glyph_lookups - misses) / static_cast<double>(glyph_lookups);
+		}
+	};
+
+	// Text from a TrueType font as signed distance fields in a TextureAtlas.
+	// Glyphs are rasterized once at FontDesc::sdf_size the first time they're drawn and scaled
+	// to any size, so one atlas page holds the glyphs of every size.
+	// Layout is a single pass of advances and 'kern' pairs, there is no shaping (ligatures,
+	// right to left, combining marks), which is plenty for Latin, Greek and Cyrillic UI text.
+	// Only on the thread that records render commands, like the atlas.
+	class Font {
+	public:
+		Font(Renderer& renderer, const FontDesc& desc = {});
+
+		Font(const Font&) = delete;
+		Font& operator=(const Font&) = delete;
+
+		// Returns false with the reason in error, the font loaded before stays usable
+		bool load(const std::filesystem::path& path, std::string& error);
+		bool load(std::vector<uint8_t> data, std::string& error);
+
+		// UTF-8, '\n' starts a new line, invalid bytes show up as U+FFFD.
+		// Doesn't touch the atlas, glyphs are only rasterized when drawn
+		void layout(std::string_view text, float font_size, TextLayout& layout);
+		// Same, but kept by text and size for the next call. For static strings, text that changes
+		// every frame (counters, timers) is better laid out into its own TextLayout.
+		// The reference is good until the next next_frame()
+		const TextLayout& cached_layout(std::string_view text, float font_size);
+
+		float line_height(float font_size) const;
+		float ascent(float font_size) const;
+
+		// Every glyph of the layout already is in the atlas
+		bool resident(const TextLayout& layout) const;
+		// Rasterizes the glyphs of the layout that aren't in the atlas.
+		// Inserting can repack a page and move the glyphs already in it
+		void rasterize(const TextLayout& layout);
+		// Marks the glyph used this frame. Rasterizes it when it isn't in the atlas,
+		// nullptr when it doesn't fit. The pointer is only good until the next rasterization
+		const AtlasRegion* glyph_region(uint32_t glyph);
+		// Where the glyph is now, without marking it used or rasterizing it. nullptr when it isn't in the atlas
+		const AtlasRegion* find_glyph_region(uint32_t glyph) const { return _atlas.find(_glyphs[glyph].handle); }
+		// Texels the distance field goes from 0 to 1 over, for the text shader
+		float distance_range() const { return 2.0f * _desc.sdf_spread; }
+
+		// Call once per frame, it's the clock for the layout cache and the atlas
+		void next_frame();
+
+		const FontDesc& desc() const { return _desc; }
+		const TrueTypeFont& file() const { return _file; }
+		TextureAtlas& atlas() { return _atlas; }
+		const FontStats& stats() const { return _stats; }
+		void reset_stats();
+
+	private:
+		struct Glyph {
+			uint32_t index = 0;      // In the font file
+			float advance = 0.0f;    // Ems
+			glm::vec2 offset = glm::vec2(0.0f); // Distance field texels, top left of the field relative to the pen on the baseline
+			glm::uvec2 size = glm::uvec2(0);    // Distance field texels, 0 for glyphs without an outline
+			AtlasHandle handle;
+		};
+
+		struct CachedLayout {
+			std::string text;
+			float font_size = 0.0f;
+			uint64_t last_used = 0;
+			TextLayout layout;
+		};
+
+		// Forgets every glyph and layout after loading another file
+		void reset_glyphs();
+		// Adds the glyph to the cache the first time it's seen
+		uint32_t glyph_slot(uint32_t codepoint);
+		// Into the atlas. Returns false when it didn't fit
+		bool rasterize_glyph(Glyph& glyph);
+
+	private:
+		TrueTypeFont _file;
+		FontDesc _desc;
+		TextureAtlas _atlas;
+		uint64_t _frame = 1;
+
+		std::vector<Glyph> _glyphs;
+		std::vector<uint32_t> _glyph_slots;     // By glyph index, ~0u until cached. Codepoints without a glyph share .notdef
+		std::array<uint32_t, 128> _ascii_slots; // Skips the character map for the common case
+
+		// Keyed by hash of text and size
+		std::unordered_map<uint64_t, std::vector<Unique<CachedLayout>>> _layout_cache;
+
+		// Scratch for rasterizing
+		std::vector<GlyphEdge> _edges;
+		std::vector<uint8_t> _pixels;
+
+		FontStats _stats;
+	};
+}
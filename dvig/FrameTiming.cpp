@@ -0,0 +1,96 @@
+#include "pch.h"
+#include "FrameTiming.h"
+
+namespace dvig {
+	int64_t steady_clock_now() {
+		auto time = std::chrono::steady_clock::now().time_since_epoch();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+	}
+
+	FixedTimestep::FixedTimestep(float fixed_ups, uint32_t max_steps_per_frame)
+		: _max_steps_per_frame(max_steps_per_frame) {
+		assert(fixed_ups > 0);
+		assert(max_steps_per_frame > 0);
+
+		_ups_milli = std::llround(static_cast<double>(fixed_ups) * 1000.0);
+		_fixed_dt = static_cast<float>(1000.0 / static_cast<double>(_ups_milli));
+	}
+
+	uint32_t FixedTimestep::advance(int64_t elapsed_ns) {
+		elapsed_ns = std::clamp<int64_t>(elapsed_ns, 0, MAX_FRAME_NS);
+		_accumulator += elapsed_ns * _ups_milli;
+
+		int64_t steps = _accumulator / UNITS_PER_STEP;
+		_accumulator -= steps * UNITS_PER_STEP;
+
+		if (steps > _max_steps_per_frame) {
+			_dropped_step_count += steps - _max_steps_per_frame;
+			steps = _max_steps_per_frame;
+		}
+
+		_step_count += steps;
+		return static_cast<uint32_t>(steps);
+	}
+
+	float FixedTimestep::alpha() const {
+		return static_cast<float>(static_cast<double>(_accumulator) / static_cast<double>(UNITS_PER_STEP));
+	}
+
+	FramePacer::FramePacer(const Clock& clock, float target_fps)
+		: _clock(clock) {
+		assert(target_fps > 0);
+		_frame_ns = std::llround(1'000'000'000.0 / static_cast<double>(target_fps));
+
+	#ifdef _WIN32
+		_timer = ::CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	#endif
+	}
+
+	FramePacer::~FramePacer() {
+	#ifdef _WIN32
+		if (_timer) {
+			::CloseHandle(_timer);
+		}
+	#endif
+	}
+
+	void FramePacer::wait() {
+		int64_t now = _clock();
+		if (!_started) {
+			_started = true;
+			_next_frame = now + _frame_ns;
+			return;
+		}
+
+		const int64_t remaining = _next_frame - now;
+		if (remaining > SPIN_NS) {
+			sleep(remaining - SPIN_NS);
+		}
+
+		while (_clock() < _next_frame) {
+			std::this_thread::yield();
+		}
+
+		_next_frame += _frame_ns;
+
+		// More than a frame behind. Start over instead of rushing frames to catch up
+		now = _clock();
+		if (_next_frame < now) {
+			_next_frame = now + _frame_ns;
+		}
+	}
+
+	void FramePacer::sleep(int64_t duration_ns) {
+	#ifdef _WIN32
+		if (_timer) {
+			LARGE_INTEGER due_time;
+			due_time.QuadPart = -(duration_ns / 100); // Relative, in 100ns units
+			if (::SetWaitableTimerEx(_timer, &due_time, 0, nullptr, nullptr, nullptr, 0)) {
+				::WaitForSingleObject(_timer, INFINITE);
+				return;
+			}
+		}
+	#endif
+		std::this_thread::sleep_for(std::chrono::nanoseconds(duration_ns));
+	}
+}
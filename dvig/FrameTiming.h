@@ -0,0 +1,77 @@
+#pragma once
+#include "pch.h"
+
+namespace dvig {
+	// Returns nanoseconds since any fixed point. The App reads time only through one of these,
+	// so the loop can be driven by a fake clock in headless runs.
+	using Clock = std::function<int64_t()>;
+
+	int64_t steady_clock_now();
+
+	enum class FramePacing {
+		VSync,     // present() waits for the vertical blank
+		TargetFps, // Sleeps most of the frame and spins the rest, see FramePacer
+		Uncapped,
+	};
+
+	// Fixed update accumulator.
+	// Time is counted in integer units of 1 / (fixed_ups * 1000) nanoseconds, so the step rate
+	// is exact for any rate with up to 3 decimals (50, 60, 120...) and doesn't drift like a float timer.
+	class FixedTimestep {
+	public:
+		static constexpr int64_t UNITS_PER_STEP = 1'000'000'000'000; // 1s in ns * 1000
+		static constexpr int64_t MAX_FRAME_NS = 1'000'000'000;       // Longer frames are clamped, keeps the math in range
+
+		FixedTimestep(float fixed_ups, uint32_t max_steps_per_frame = 8);
+
+		// Adds the real time a frame took and returns how many fixed updates to run for it.
+		// Anything past max_steps_per_frame is dropped, otherwise a slow frame would need even
+		// more updates the next frame (spiral of death). The time inside the current step is kept.
+		uint32_t advance(int64_t elapsed_ns);
+
+		float fixed_dt() const { return _fixed_dt; }
+		// How far into the next step the frame is, 0..1. For interpolating between the last two fixed states
+		float alpha() const;
+
+		uint64_t step_count() const { return _step_count; }
+		uint64_t dropped_step_count() const { return _dropped_step_count; }
+
+	private:
+		int64_t _ups_milli = 0;   // fixed_ups * 1000, the units added per nanosecond
+		int64_t _accumulator = 0; // Always below UNITS_PER_STEP between calls
+		uint32_t _max_steps_per_frame = 0;
+		float _fixed_dt = 0;
+
+		uint64_t _step_count = 0;
+		uint64_t _dropped_step_count = 0;
+	};
+
+	// Waits until target_fps frames per second are reached.
+	// OS sleeps wake up late, so it sleeps until SPIN_NS before the deadline and busy waits on the clock from there.
+	// It sleeps in real time, the clock has to follow real time too.
+	class FramePacer {
+	public:
+		static constexpr int64_t SPIN_NS = 2'000'000;
+
+		FramePacer(const Clock& clock, float target_fps);
+		~FramePacer();
+
+		FramePacer(const FramePacer&) = delete;
+		FramePacer& operator=(const FramePacer&) = delete;
+
+		// Call once per frame after present. The first call only starts the schedule.
+		void wait();
+
+	private:
+		void sleep(int64_t duration_ns);
+
+	private:
+		Clock _clock;
+		int64_t _frame_ns = 0;
+		int64_t _next_frame = 0;
+		bool _started = false;
+	#ifdef _WIN32
+		HANDLE _timer = nullptr; // High resolution waitable timer, Sleep() is only 15.6ms accurate by default
+	#endif
+	};
+}
@@ -0,0 +1,371 @@
+#include "pch.h"
+#include "HeadlessBackend.h"
+#include "App.h"
+
+namespace dvig {
+	void HeadlessBackend::init(const AppSpec& app_spec, void* /*native_window*/) {
+		_commands.reserve(1024);
+		_last_frame_commands.reserve(1024);
+
+		set_viewport({}, { (float)app_spec.width, (float)app_spec.height });
+	}
+
+	void HeadlessBackend::set_viewport(glm::vec2 pos, glm::vec2 size) {
+		glm::vec4 viewport = { pos.x, pos.y, size.x, size.y };
+		state_call(viewport != _viewport);
+		_viewport = viewport;
+
+		record(HeadlessCommandType::SetViewport,
+			static_cast<uint32_t>(pos.x), static_cast<uint32_t>(pos.y),
+			static_cast<uint32_t>(size.x), static_cast<uint32_t>(size.y));
+	}
+
+	void HeadlessBackend::clear_color(const glm::vec4& /*color*/) {
+		record(HeadlessCommandType::ClearColor);
+	}
+
+	void HeadlessBackend::present(int VSync) {
+		record(HeadlessCommandType::Present, static_cast<uint32_t>(VSync));
+		_frame_stats.presents++;
+		_total_stats.presents++;
+
+		_last_frame_stats = _frame_stats;
+		_frame_stats = {};
+
+		std::swap(_commands, _last_frame_commands);
+		_commands.clear();
+		end_state_frame();
+
+		_frame_index++;
+	}
+
+	void HeadlessBackend::collect_resources(uint64_t executed_frames) {
+		_vertex_buffers.collect(executed_frames);
+		_index_buffers.collect(executed_frames);
+		_vertex_shaders.collect(executed_frames);
+		_pixel_shaders.collect(executed_frames);
+	}
+
+	VertexBufferHandle HeadlessBackend::create_vertex_buffer(
+		const void* data,
+		uint32_t vertex_size,
+		uint32_t vertex_count,
+		BufferDataType data_type
+	) {
+		HeadlessVertexBuffer vertex_buffer;
+		vertex_buffer.count = vertex_count;
+		vertex_buffer.vertex_size = vertex_size;
+		vertex_buffer.data_type = data_type;
+		vertex_buffer.data.resize(static_cast<size_t>(vertex_size) * vertex_count);
+
+		if (data != nullptr) {
+			memcpy(vertex_buffer.data.data(), data, vertex_buffer.data.size());
+			add_upload(vertex_buffer.data.size());
+		}
+
+		return _vertex_buffers.add(std::move(vertex_buffer));
+	}
+
+	void HeadlessBackend::update(VertexBuffer& buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count) {
+		auto& headless_buffer = static_cast<HeadlessVertexBuffer&>(buffer);
+		const size_t size = static_cast<size_t>(vertex_size) * vertex_count;
+		assert(size <= headless_buffer.data.size());
+
+		memcpy(headless_buffer.data.data(), data, size);
+		buffer.count = vertex_count;
+
+		add_upload(size);
+		record(HeadlessCommandType::UpdateVertexBuffer, static_cast<uint32_t>(size));
+	}
+
+	void HeadlessBackend::bind_vertex_buffers(
+		uint32_t first_slot, uint32_t buffer_count,
+		VertexBuffer* const* buffers, const uint32_t* strides
+	) {
+		assert(first_slot + buffer_count <= MAX_VERTEX_SLOTS);
+
+		bool changed = false;
+		for (uint32_t i = 0; i < buffer_count; ++i) {
+			const uint32_t slot = first_slot + i;
+			changed |= _bound_vertex_buffers[slot] != buffers[i] || _bound_strides[slot] != strides[i];
+			_bound_vertex_buffers[slot] = buffers[i];
+			_bound_strides[slot] = strides[i];
+		}
+
+		state_call(changed);
+		record(HeadlessCommandType::BindVertexBuffers, first_slot, buffer_count);
+	}
+
+	IndexBufferHandle HeadlessBackend::create_index_buffer(
+		const void* data,
+		IndexFormat format,
+		uint32_t index_count,
+		BufferDataType data_type
+	) {
+		HeadlessIndexBuffer index_buffer;
+		index_buffer.count = index_count;
+		index_buffer.format = format;
+		index_buffer.data_type = data_type;
+		index_buffer.data.resize(static_cast<size_t>(index_format_size(format)) * index_count);
+
+		if (data != nullptr) {
+			memcpy(index_buffer.data.data(), data, index_buffer.data.size());
+			add_upload(index_buffer.data.size());
+		}
+
+		return _index_buffers.add(std::move(index_buffer));
+	}
+
+	void HeadlessBackend::update(IndexBuffer& buffer, const void* data, uint32_t index_count) {
+		auto& headless_buffer = static_cast<HeadlessIndexBuffer&>(buffer);
+		const size_t size = static_cast<size_t>(index_format_size(buffer.format)) * index_count;
+		assert(size <= headless_buffer.data.size());
+
+		memcpy(headless_buffer.data.data(), data, size);
+		buffer.count = index_count;
+
+		add_upload(size);
+		record(HeadlessCommandType::UpdateIndexBuffer, static_cast<uint32_t>(size));
+	}
+
+	void HeadlessBackend::bind(IndexBuffer& buffer) {
+		state_call(_bound_index_buffer != &buffer);
+		_bound_index_buffer = &buffer;
+		record(HeadlessCommandType::BindIndexBuffer, static_cast<uint32_t>(buffer.format));
+	}
+
+	size_t HeadlessTexture2D::mip_offset(uint32_t mip) const {
+		size_t offset = 0;
+		for (uint32_t i = 0; i < mip; ++i) {
+			offset += static_cast<size_t>(row_size(i)) * mip_height(i);
+		}
+		return offset;
+	}
+
+	Shared<Texture2D> HeadlessBackend::create_texture(uint32_t width, uint32_t height, uint32_t mip_count, TextureFormat format) {
+		assert(width > 0 && height > 0 && mip_count > 0);
+
+		Shared<HeadlessTexture2D> texture = std::make_shared<HeadlessTexture2D>();
+		texture->width = width;
+		texture->height = height;
+		texture->mip_count = mip_count;
+		texture->format = format;
+		texture->data.resize(texture->mip_offset(mip_count));
+		return texture;
+	}
+
+	void HeadlessBackend::update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data) {
+		auto& headless_texture = static_cast<HeadlessTexture2D&>(texture);
+		assert(mip < texture.mip_count);
+		assert(region.x + region.width <= texture.mip_width(mip) && region.y + region.height <= texture.mip_height(mip));
+
+		const size_t texel_size = texture_format_size(texture.format);
+		const size_t row_size = texture.row_size(mip);
+		const size_t region_row_size = region.width * texel_size;
+		uint8_t* destination = headless_texture.data.data() + headless_texture.mip_offset(mip) + row_size * region.y + texel_size * region.x;
+		const uint8_t* source = static_cast<const uint8_t*>(data);
+		if (region_row_size == row_size) {
+			memcpy(destination, source, row_size * region.height);
+		} else {
+			for (uint32_t row = 0; row < region.height; ++row) {
+				memcpy(destination + row * row_size, source + row * region_row_size, region_row_size);
+			}
+		}
+
+		const size_t size = region_row_size * region.height;
+		add_upload(size);
+		record(HeadlessCommandType::UpdateTexture, static_cast<uint32_t>(size), mip, region.y, region.height);
+	}
+
+	Shared<Sampler> HeadlessBackend::create_sampler(const SamplerDesc& desc) {
+		Shared<HeadlessSampler> sampler = std::make_shared<HeadlessSampler>();
+		sampler->desc = desc;
+		return sampler;
+	}
+
+	void HeadlessBackend::bind(Texture2D& texture, uint32_t slot) {
+		assert(slot < MAX_TEXTURE_SLOTS);
+
+		state_call(_bound_textures[slot] != &texture);
+		_bound_textures[slot] = &texture;
+		record(HeadlessCommandType::BindTexture, slot);
+	}
+
+	void HeadlessBackend::bind(Sampler& sampler, uint32_t slot) {
+		assert(slot < MAX_TEXTURE_SLOTS);
+
+		state_call(_bound_samplers[slot] != &sampler);
+		_bound_samplers[slot] = &sampler;
+		record(HeadlessCommandType::BindSampler, slot);
+	}
+
+	Shared<VertexShader> HeadlessBackend::try_compile_vertex_shader(
+		const std::wstring& shader_path,
+		const std::vector<VertexElement>& layout,
+		uint32_t uniform_buffer_size,
+		const std::string& main_name,
+		std::string& /*error*/
+	) {
+		// NOTE: Nothing is compiled. The shader only remembers what it was created with.
+		Shared<HeadlessVertexShader> shader = std::make_shared<HeadlessVertexShader>();
+		fill_vertex_shader(*shader, shader_path, layout, uniform_buffer_size, main_name);
+		return shader;
+	}
+
+	Shared<PixelShader> HeadlessBackend::try_compile_pixel_shader(
+		const std::wstring& shader_path,
+		const std::string& main_name,
+		std::string& /*error*/
+	) {
+		Shared<HeadlessPixelShader> shader = std::make_shared<HeadlessPixelShader>();
+		shader->path = shader_path;
+		shader->main_name = main_name;
+		return shader;
+	}
+
+	VertexShaderHandle HeadlessBackend::add(VertexShader&& compiled) {
+		return _vertex_shaders.add(std::move(static_cast<HeadlessVertexShader&>(compiled)));
+	}
+
+	PixelShaderHandle HeadlessBackend::add(PixelShader&& compiled) {
+		return _pixel_shaders.add(std::move(static_cast<HeadlessPixelShader&>(compiled)));
+	}
+
+	void HeadlessBackend::replace(VertexShader& shader, VertexShader& compiled) {
+		auto& headless_shader = static_cast<HeadlessVertexShader&>(shader);
+		auto& headless_compiled = static_cast<HeadlessVertexShader&>(compiled);
+
+		const bool keep_uniforms = headless_shader.uniform_data.size() == headless_compiled.uniform_data.size();
+		std::swap(headless_shader, headless_compiled);
+		if (keep_uniforms) {
+			std::swap(headless_shader.uniform_data, headless_compiled.uniform_data);
+		}
+
+		// Same object, but the next bind is a real state change
+		if (_bound_vertex_shader == &shader) {
+			_bound_vertex_shader = nullptr;
+		}
+		_bound_pipeline = nullptr;
+	}
+
+	void HeadlessBackend::replace(PixelShader& shader, PixelShader& compiled) {
+		std::swap(static_cast<HeadlessPixelShader&>(shader), static_cast<HeadlessPixelShader&>(compiled));
+
+		if (_bound_pixel_shader == &shader) {
+			_bound_pixel_shader = nullptr;
+		}
+		_bound_pipeline = nullptr;
+	}
+
+	void HeadlessBackend::bind(VertexShader& shader) {
+		_bound_pipeline = nullptr;
+		state_call(_bound_vertex_shader != &shader);
+		_bound_vertex_shader = &shader;
+		record(HeadlessCommandType::BindVertexShader);
+	}
+
+	void HeadlessBackend::bind(PixelShader& shader) {
+		_bound_pipeline = nullptr;
+		state_call(_bound_pixel_shader != &shader);
+		_bound_pixel_shader = &shader;
+		record(HeadlessCommandType::BindPixelShader);
+	}
+
+	void HeadlessBackend::update(VertexShader& shader, const void* data_ptr, uint32_t offset, uint32_t data_size) {
+		auto& headless_shader = static_cast<HeadlessVertexShader&>(shader);
+		assert(offset + data_size <= headless_shader.uniform_data.size());
+
+		memcpy(headless_shader.uniform_data.data() + offset, data_ptr, data_size);
+
+		add_upload(data_size);
+		record(HeadlessCommandType::UpdateUniformBuffer, data_size, offset);
+	}
+
+	void HeadlessBackend::set_topology(TopologyType topology) {
+		_bound_pipeline = nullptr;
+		state_call(_bound_topology != topology);
+		_bound_topology = topology;
+		record(HeadlessCommandType::SetTopology, static_cast<uint32_t>(topology));
+	}
+
+	void HeadlessBackend::set_blend_mode(BlendMode mode) {
+		_bound_pipeline = nullptr;
+		state_call(_bound_blend_mode != mode);
+		_bound_blend_mode = mode;
+		record(HeadlessCommandType::SetBlendMode, static_cast<uint32_t>(mode));
+	}
+
+	void HeadlessBackend::draw(uint32_t vertex_count, uint32_t vertex_start_location) {
+		add_draw(vertex_count, 1);
+		record(HeadlessCommandType::Draw, vertex_count, vertex_start_location);
+	}
+
+	void HeadlessBackend::draw_instanced(
+		uint32_t vertex_count, uint32_t instance_count,
+		uint32_t vertex_start_location, uint32_t instance_start_location
+	) {
+		add_draw(vertex_count, instance_count);
+		record(HeadlessCommandType::DrawInstanced, vertex_count, instance_count, vertex_start_location, instance_start_location);
+	}
+
+	void HeadlessBackend::draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) {
+		assert(_bound_index_buffer != nullptr && index_start_location + index_count <= _bound_index_buffer->count);
+
+		add_draw(index_count, 1);
+		record(HeadlessCommandType::DrawIndexed, index_count, index_start_location, static_cast<uint32_t>(base_vertex_location));
+	}
+
+	void HeadlessBackend::fill_vertex_shader(
+		HeadlessVertexShader& shader,
+		const std::wstring& shader_path,
+		const std::vector<VertexElement>& layout,
+		uint32_t uniform_buffer_size,
+		const std::string& main_name
+	) const {
+		shader.layout = layout;
+		shader.uniform_buffer_size = uniform_buffer_size;
+		shader.path = shader_path;
+		shader.main_name = main_name;
+		shader.uniform_data.resize(uniform_buffer_size);
+	}
+
+	void HeadlessBackend::record(HeadlessCommandType type, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+		if (!_record_commands) {
+			return;
+		}
+
+		HeadlessCommand command;
+		command.type = type;
+		command.args[0] = a;
+		command.args[1] = b;
+		command.args[2] = c;
+		command.args[3] = d;
+		_commands.push_back(command);
+	}
+
+	void HeadlessBackend::state_call(bool changed) {
+		_frame_stats.state_calls++;
+		_total_stats.state_calls++;
+		count_state_call(changed);
+
+		if (changed) {
+			_frame_stats.state_changes++;
+			_total_stats.state_changes++;
+		}
+	}
+
+	void HeadlessBackend::add_draw(uint32_t vertex_count, uint32_t instance_count) {
+		_frame_stats.draw_calls++;
+		_frame_stats.vertices += vertex_count * instance_count;
+		_frame_stats.instances += instance_count;
+
+		_total_stats.draw_calls++;
+		_total_stats.vertices += vertex_count * instance_count;
+		_total_stats.instances += instance_count;
+	}
+
+	void HeadlessBackend::add_upload(uint64_t bytes) {
+		_frame_stats.bytes_uploaded += bytes;
+		_total_stats.bytes_uploaded += bytes;
+	}
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include "pch.h"
+
+#include "RenderBackend.h"
+
+namespace dvig {
+	// Headless resources keep a CPU copy of everything that was uploaded
+	struct HeadlessVertexBuffer : VertexBuffer {
+		std::vector<char> data;
+	};
+
+	struct HeadlessIndexBuffer : IndexBuffer {
+		std::vector<char> data;
+	};
+
+	struct HeadlessVertexShader : VertexShader {
+		std::wstring path;
+		std::string main_name;
+		std::vector<char> uniform_data;
+	};
+
+	struct HeadlessPixelShader : PixelShader {
+		std::wstring path;
+		std::string main_name;
+	};
+
+	// Mips back to back, largest first
+	struct HeadlessTexture2D : Texture2D {
+		std::vector<uint8_t> data;
+
+		size_t mip_offset(uint32_t mip) const;
+	};
+
+	struct HeadlessSampler : Sampler {};
+
+	enum class HeadlessCommandType {
+		SetViewport,
+		ClearColor,
+		Present,
+		UpdateVertexBuffer,
+		BindVertexBuffers,
+		UpdateIndexBuffer,
+		BindIndexBuffer,
+		UpdateTexture,
+		BindTexture,
+		BindSampler,
+		BindVertexShader,
+		BindPixelShader,
+		UpdateUniformBuffer,
+		SetTopology,
+		SetBlendMode,
+		Draw,
+		DrawInstanced,
+		DrawIndexed,
+	};
+
+	// Commands only keep counts, the resources are not referenced
+	struct HeadlessCommand {
+		HeadlessCommandType type;
+		uint32_t args[4] = {};
+	};
+
+	struct HeadlessStats {
+		uint32_t draw_calls = 0;
+		uint32_t vertices = 0; // Vertices the vertex shader ran for, indices for indexed draws
+		uint32_t instances = 0;
+		uint64_t bytes_uploaded = 0;
+		uint32_t state_calls = 0;   // Every bind/set call
+		uint32_t state_changes = 0; // Calls that actually changed the bound state
+		uint32_t presents = 0;
+	};
+
+	class HeadlessBackend : public RenderBackend {
+	public:
+		RenderBackendType type() const override { return RenderBackendType::Headless; }
+
+		void init(const struct AppSpec& app_spec, void* native_window) override;
+		void set_viewport(glm::vec2 pos, glm::vec2 size) override;
+		void clear_color(const glm::vec4& color) override;
+		void present(int VSync) override;
+
+		VertexBuffer* find(VertexBufferHandle buffer) const override { return _vertex_buffers.find(buffer); }
+		IndexBuffer* find(IndexBufferHandle buffer) const override { return _index_buffers.find(buffer); }
+		VertexShader* find(VertexShaderHandle shader) const override { return _vertex_shaders.find(shader); }
+		PixelShader* find(PixelShaderHandle shader) const override { return _pixel_shaders.find(shader); }
+		void destroy(VertexBufferHandle buffer, uint64_t frame) override { _vertex_buffers.remove(buffer, frame); }
+		void destroy(IndexBufferHandle buffer, uint64_t frame) override { _index_buffers.remove(buffer, frame); }
+		void destroy(VertexShaderHandle shader, uint64_t frame) override { _vertex_shaders.remove(shader, frame); }
+		void destroy(PixelShaderHandle shader, uint64_t frame) override { _pixel_shaders.remove(shader, frame); }
+		void collect_resources(uint64_t executed_frames) override;
+
+		VertexBufferHandle create_vertex_buffer(
+			const void* data,
+			uint32_t vertex_size,
+			uint32_t vertex_count,
+			BufferDataType data_type
+		) override;
+		void update(VertexBuffer& buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count) override;
+		void bind_vertex_buffers(
+			uint32_t first_slot, uint32_t buffer_count,
+			VertexBuffer* const* buffers, const uint32_t* strides
+		) override;
+		IndexBufferHandle create_index_buffer(
+			const void* data,
+			IndexFormat format,
+			uint32_t index_count,
+			BufferDataType data_type
+		) override;
+		void update(IndexBuffer& buffer, const void* data, uint32_t index_count) override;
+		void bind(IndexBuffer& buffer) override;
+
+		Shared<Texture2D> create_texture(uint32_t width, uint32_t height, uint32_t mip_count, TextureFormat format) override;
+		void update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data) override;
+		Shared<Sampler> create_sampler(const SamplerDesc& desc) override;
+		void bind(Texture2D& texture, uint32_t slot) override;
+		void bind(Sampler& sampler, uint32_t slot) override;
+
+		Shared<VertexShader> try_compile_vertex_shader(
+			const std::wstring& shader_path,
+			const std::vector<VertexElement>& layout,
+			uint32_t uniform_buffer_size,
+			const std::string& main_name,
+			std::string& error
+		) override;
+		Shared<PixelShader> try_compile_pixel_shader(
+			const std::wstring& shader_path,
+			const std::string& main_name,
+			std::string& error
+		) override;
+		VertexShaderHandle add(VertexShader&& compiled) override;
+		PixelShaderHandle add(PixelShader&& compiled) override;
+		void replace(VertexShader& shader, VertexShader& compiled) override;
+		void replace(PixelShader& shader, PixelShader& compiled) override;
+		void bind(VertexShader& shader) override;
+		void bind(PixelShader& shader) override;
+		void update(VertexShader& shader, const void* data_ptr, uint32_t offset, uint32_t data_size) override;
+
+		void set_topology(TopologyType topology) override;
+		void set_blend_mode(BlendMode mode) override;
+		void draw(uint32_t vertex_count, uint32_t vertex_start_location) override;
+		void draw_instanced(
+			uint32_t vertex_count, uint32_t instance_count,
+			uint32_t vertex_start_location, uint32_t instance_start_location
+		) override;
+		void draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) override;
+
+		// Stats of the frame in progress. Moved to last_frame_stats() on present()
+		const HeadlessStats& frame_stats() const { return _frame_stats; }
+		const HeadlessStats& last_frame_stats() const { return _last_frame_stats; }
+		const HeadlessStats& total_stats() const { return _total_stats; }
+		uint64_t frame_index() const { return _frame_index; }
+
+		// Commands of the last presented frame. Recording is off by default
+		void set_record_commands(bool record) { _record_commands = record; }
+		const std::vector<HeadlessCommand>& last_frame_commands() const { return _last_frame_commands; }
+
+	protected:
+		void fill_vertex_shader(
+			HeadlessVertexShader& shader,
+			const std::wstring& shader_path,
+			const std::vector<VertexElement>& layout,
+			uint32_t uniform_buffer_size,
+			const std::string& main_name
+		) const;
+
+		void record(HeadlessCommandType type, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0);
+		void state_call(bool changed);
+		void add_draw(uint32_t vertex_count, uint32_t instance_count);
+		void add_upload(uint64_t bytes);
+
+	protected:
+		static constexpr uint32_t MAX_VERTEX_SLOTS = 16;
+
+		ResourcePool<HeadlessVertexBuffer, VertexBuffer> _vertex_buffers;
+		ResourcePool<HeadlessIndexBuffer, IndexBuffer> _index_buffers;
+		ResourcePool<HeadlessVertexShader, VertexShader> _vertex_shaders;
+		ResourcePool<HeadlessPixelShader, PixelShader> _pixel_shaders;
+
+		bool _record_commands = false;
+		std::vector<HeadlessCommand> _commands;
+		std::vector<HeadlessCommand> _last_frame_commands;
+
+		HeadlessStats _frame_stats;
+		HeadlessStats _last_frame_stats;
+		HeadlessStats _total_stats;
+		uint64_t _frame_index = 0;
+
+		// Shadowed state. Used to tell state changes from redundant calls
+		// and by derived backends that actually execute the draws
+		const VertexBuffer* _bound_vertex_buffers[MAX_VERTEX_SLOTS] = {};
+		uint32_t _bound_strides[MAX_VERTEX_SLOTS] = {};
+		const IndexBuffer* _bound_index_buffer = nullptr;
+		const Texture2D* _bound_textures[MAX_TEXTURE_SLOTS] = {};
+		const Sampler* _bound_samplers[MAX_TEXTURE_SLOTS] = {};
+		const VertexShader* _bound_vertex_shader = nullptr;
+		const PixelShader* _bound_pixel_shader = nullptr;
+		std::optional<TopologyType> _bound_topology;
+		BlendMode _bound_blend_mode = BlendMode::Opaque;
+		glm::vec4 _viewport = glm::vec4(0.0f);
+	};
+}
@@ -0,0 +1,1201 @@
+#include "pch.h"
+#include "Image.h"
+
+namespace dvig {
+	namespace {
+		uint32_t read_u16_le(const uint8_t* data) { return data[0] | (data[1] << 8); }
+		uint32_t read_u32_le(const uint8_t* data) { return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24); }
+		uint32_t read_u32_be(const uint8_t* data) { return (static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3]; }
+
+		uint32_t pack_rgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+			return r | (g << 8) | (b << 16) | (a << 24);
+		}
+
+		// Also sets mip_count to 1
+		void allocate_image(Image& image, uint32_t width, uint32_t height) {
+			image.width = width;
+			image.height = height;
+			image.mip_count = 1;
+			image.pixels.assign(static_cast<size_t>(width) * height * Image::PIXEL_SIZE, 0);
+		}
+
+		void store_pixel(Image& image, uint32_t x, uint32_t y, uint32_t rgba) {
+			memcpy(image.pixels.data() + (static_cast<size_t>(y) * image.width + x) * Image::PIXEL_SIZE, &rgba, sizeof(rgba));
+		}
+
+		// Anything bigger is a broken header, not an image
+		constexpr uint32_t MAX_DIMENSION = 1 << 15;
+
+		// Inflate (RFC 1950/1951)
+		// --------------------------------------------------
+
+		// LSB first, like deflate stores everything but the Huffman codes themselves.
+		// Reads zeros past the end, overrun() tells.
+		struct BitReader {
+			const uint8_t* data = nullptr;
+			size_t size = 0;
+			size_t position = 0;
+			uint64_t bits = 0;
+			uint32_t count = 0;
+
+			void refill() {
+				while (count <= 56) {
+					const uint64_t byte = position < size ? data[position] : 0;
+					position++;
+					bits |= byte << count;
+					count += 8;
+				}
+			}
+
+			uint32_t read(uint32_t bit_count) {
+				if (count < bit_count) {
+					refill();
+				}
+				const uint32_t value = static_cast<uint32_t>(bits & ((1ull << bit_count) - 1));
+				bits >>= bit_count;
+				count -= bit_count;
+				return value;
+			}
+
+			void consume(uint32_t bit_count) {
+				bits >>= bit_count;
+				count -= bit_count;
+			}
+
+			void align_to_byte() { consume(count % 8); }
+			bool overrun() const { return position - count / 8 > size; }
+		};
+
+		// Canonical Huffman decoding. Codes up to FAST_BITS long are one table lookup,
+		// longer ones are searched by length.
+		struct Huffman {
+			static constexpr uint32_t FAST_BITS = 9;
+			static constexpr uint32_t MAX_BITS = 15;
+
+			uint16_t fast[1 << FAST_BITS] = {}; // (length << 9) | symbol, 0 for longer codes
+			uint32_t first_code[MAX_BITS + 1] = {};
+			uint32_t first_symbol[MAX_BITS + 1] = {};
+			uint32_t max_code[MAX_BITS + 2] = {};   // One past the last code of a length, left aligned to 16 bits
+			uint16_t symbols[288] = {};             // Sorted by code
+
+			bool build(const uint8_t* lengths, uint32_t count) {
+				uint32_t length_count[MAX_BITS + 1] = {};
+				for (uint32_t i = 0; i < count; ++i) {
+					length_count[lengths[i]]++;
+				}
+				length_count[0] = 0;
+
+				uint32_t next_code[MAX_BITS + 1] = {};
+				uint32_t code = 0;
+				uint32_t symbol = 0;
+				for (uint32_t length = 1; length <= MAX_BITS; ++length) {
+					next_code[length] = code;
+					first_code[length] = code;
+					first_symbol[length] = symbol;
+					code += length_count[length];
+					if (code > (1u << length)) {
+						return false; // Over subscribed
+					}
+					max_code[length] = code << (16 - length);
+					code <<= 1;
+					symbol += length_count[length];
+				}
+				max_code[MAX_BITS + 1] = 0xffffffff;
+
+				memset(fast, 0, sizeof(fast));
+				for (uint32_t i = 0; i < count; ++i) {
+					const uint32_t length = lengths[i];
+					if (length == 0) {
+						continue;
+					}
+
+					const uint32_t code_value = next_code[length]++;
+					symbols[first_symbol[length] + code_value - first_code[length]] = static_cast<uint16_t>(i);
+
+					if (length <= FAST_BITS) {
+						// The stream has the code reversed
+						uint32_t reversed = 0;
+						for (uint32_t bit = 0; bit < length; ++bit) {
+							reversed |= ((code_value >> bit) & 1) << (length - 1 - bit);
+						}
+						for (uint32_t j = reversed; j < (1u << FAST_BITS); j += 1u << length) {
+							fast[j] = static_cast<uint16_t>((length << 9) | i);
+						}
+					}
+				}
+				return true;
+			}
+
+			// -1 for a code that isn't in the table
+			int32_t decode(BitReader& reader) const {
+				if (reader.count < 16) {
+					reader.refill();
+				}
+
+				const uint32_t entry = fast[reader.bits & ((1u << FAST_BITS) - 1)];
+				if (entry != 0) {
+					reader.consume(entry >> 9);
+					return static_cast<int32_t>(entry & 511);
+				}
+
+				uint32_t code = 0;
+				for (uint32_t bit = 0; bit < 16; ++bit) {
+					code |= static_cast<uint32_t>((reader.bits >> bit) & 1) << (15 - bit);
+				}
+
+				uint32_t length = FAST_BITS + 1;
+				while (length <= MAX_BITS && code >= max_code[length]) {
+					length++;
+				}
+				if (length > MAX_BITS) {
+					return -1;
+				}
+
+				reader.consume(length);
+				return symbols[first_symbol[length] + (code >> (16 - length)) - first_code[length]];
+			}
+		};
+
+		constexpr uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		constexpr uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		constexpr uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		constexpr uint8_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		bool inflate_codes(BitReader& reader, const Huffman& literals, const Huffman& distances, uint8_t* out, size_t out_size, size_t& out_position) {
+			while (true) {
+				if (reader.overrun()) {
+					return false;
+				}
+
+				const int32_t symbol = literals.decode(reader);
+				if (symbol < 0) {
+					return false;
+				}
+
+				if (symbol < 256) {
+					if (out_position == out_size) {
+						return false;
+					}
+					out[out_position++] = static_cast<uint8_t>(symbol);
+					continue;
+				}
+
+				if (symbol == 256) {
+					return true;
+				}
+
+				const uint32_t length_symbol = static_cast<uint32_t>(symbol) - 257;
+				if (length_symbol >= 29) {
+					return false;
+				}
+				const uint32_t length = LENGTH_BASE[length_symbol] + reader.read(LENGTH_EXTRA[length_symbol]);
+
+				const int32_t distance_symbol = distances.decode(reader);
+				if (distance_symbol < 0 || distance_symbol >= 30) {
+					return false;
+				}
+				const uint32_t distance = DISTANCE_BASE[distance_symbol] + reader.read(DISTANCE_EXTRA[distance_symbol]);
+
+				if (distance > out_position || length > out_size - out_position) {
+					return false;
+				}
+
+				// Byte by byte, the ranges may overlap
+				const uint8_t* source = out + out_position - distance;
+				uint8_t* destination = out + out_position;
+				for (uint32_t i = 0; i < length; ++i) {
+					destination[i] = source[i];
+				}
+				out_position += length;
+			}
+		}
+
+		// zlib stream into exactly out_size bytes
+		bool inflate_zlib(const uint8_t* data, size_t size, uint8_t* out, size_t out_size, std::string& error) {
+			if (size < 2 || (data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20) != 0) {
+				error = "bad zlib header";
+				return false;
+			}
+
+			BitReader reader;
+			reader.data = data + 2;
+			reader.size = size - 2;
+
+			static const std::pair<Huffman, Huffman> fixed = [] {
+				std::pair<Huffman, Huffman> tables;
+				uint8_t lengths[288];
+				for (uint32_t i = 0; i < 288; ++i) {
+					lengths[i] = i < 144 ? 8 : (i < 256 ? 9 : (i < 280 ? 7 : 8));
+				}
+				tables.first.build(lengths, 288);
+
+				std::fill(lengths, lengths + 30, static_cast<uint8_t>(5));
+				tables.second.build(lengths, 30);
+				return tables;
+			}();
+
+			size_t out_position = 0;
+			bool final_block = false;
+			while (!final_block) {
+				final_block = reader.read(1) == 1;
+				const uint32_t type = reader.read(2);
+
+				if (type == 0) {
+					reader.align_to_byte();
+					const uint32_t length = reader.read(16);
+					const uint32_t inverted = reader.read(16);
+					if ((length ^ 0xffff) != inverted || length > out_size - out_position) {
+						error = "bad stored block";
+						return false;
+					}
+					for (uint32_t i = 0; i < length; ++i) {
+						out[out_position++] = static_cast<uint8_t>(reader.read(8));
+					}
+				} else if (type == 1) {
+					if (!inflate_codes(reader, fixed.first, fixed.second, out, out_size, out_position)) {
+						error = "corrupt deflate data";
+						return false;
+					}
+				} else if (type == 2) {
+					const uint32_t literal_count = reader.read(5) + 257;
+					const uint32_t distance_count = reader.read(5) + 1;
+					const uint32_t code_length_count = reader.read(4) + 4;
+
+					constexpr uint8_t CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+					uint8_t code_lengths[19] = {};
+					for (uint32_t i = 0; i < code_length_count; ++i) {
+						code_lengths[CODE_LENGTH_ORDER[i]] = static_cast<uint8_t>(reader.read(3));
+					}
+
+					Huffman code_length_table;
+					if (!code_length_table.build(code_lengths, 19)) {
+						error = "corrupt deflate code lengths";
+						return false;
+					}
+
+					uint8_t lengths[288 + 32] = {};
+					uint32_t count = 0;
+					while (count < literal_count + distance_count) {
+						const int32_t symbol = code_length_table.decode(reader);
+						if (symbol < 0 || reader.overrun()) {
+							error = "corrupt deflate code lengths";
+							return false;
+						}
+
+						if (symbol < 16) {
+							lengths[count++] = static_cast<uint8_t>(symbol);
+							continue;
+						}
+
+						uint32_t repeat = 0;
+						uint8_t value = 0;
+						if (symbol == 16) {
+							if (count == 0) {
+								error = "corrupt deflate code lengths";
+								return false;
+							}
+							repeat = 3 + reader.read(2);
+							value = lengths[count - 1];
+						} else if (symbol == 17) {
+							repeat = 3 + reader.read(3);
+						} else {
+							repeat = 11 + reader.read(7);
+						}
+
+						if (count + repeat > literal_count + distance_count) {
+							error = "corrupt deflate code lengths";
+							return false;
+						}
+						std::fill(lengths + count, lengths + count + repeat, value);
+						count += repeat;
+					}
+
+					Huffman literals;
+					Huffman distances;
+					if (!literals.build(lengths, literal_count) || !distances.build(lengths + literal_count, distance_count)) {
+						error = "corrupt deflate tables";
+						return false;
+					}
+
+					if (!inflate_codes(reader, literals, distances, out, out_size, out_position)) {
+						error = "corrupt deflate data";
+						return false;
+					}
+				} else {
+					error = "bad deflate block type";
+					return false;
+				}
+
+				if (reader.overrun()) {
+					error = "truncated deflate data";
+					return false;
+				}
+			}
+
+			if (out_position != out_size) {
+				error = "deflate data is shorter than the image";
+				return false;
+			}
+			return true;
+		}
+
+		// PNG
+		// --------------------------------------------------
+
+		constexpr uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+		struct PngHeader {
+			uint32_t width = 0;
+			uint32_t height = 0;
+			uint32_t bit_depth = 0;
+			uint32_t color_type = 0;
+			bool interlaced = false;
+
+			uint32_t channels() const {
+				switch (color_type) {
+					case 0: return 1; // Gray
+					case 2: return 3; // RGB
+					case 3: return 1; // Palette
+					case 4: return 2; // Gray alpha
+					case 6: return 4; // RGBA
+				}
+				return 0;
+			}
+
+			uint32_t bits_per_pixel() const { return channels() * bit_depth; }
+			size_t row_size(uint32_t row_width) const { return (static_cast<size_t>(row_width) * bits_per_pixel() + 7) / 8; }
+		};
+
+		uint8_t paeth(int32_t a, int32_t b, int32_t c) {
+			const int32_t p = a + b - c;
+			const int32_t pa = std::abs(p - a);
+			const int32_t pb = std::abs(p - b);
+			const int32_t pc = std::abs(p - c);
+			if (pa <= pb && pa <= pc) {
+				return static_cast<uint8_t>(a);
+			}
+			return static_cast<uint8_t>(pb <= pc ? b : c);
+		}
+
+		// In place. row points past the filter byte, previous is nullptr for the first row
+		bool unfilter_row(uint32_t filter, uint8_t* row, const uint8_t* previous, size_t size, uint32_t pixel_bytes) {
+			switch (filter) {
+				case 0: return true;
+				case 1:
+					for (size_t i = pixel_bytes; i < size; ++i) {
+						row[i] = static_cast<uint8_t>(row[i] + row[i - pixel_bytes]);
+					}
+					return true;
+				case 2:
+					if (previous != nullptr) {
+						for (size_t i = 0; i < size; ++i) {
+							row[i] = static_cast<uint8_t>(row[i] + previous[i]);
+						}
+					}
+					return true;
+				case 3:
+					for (size_t i = 0; i < size; ++i) {
+						const uint32_t left = i >= pixel_bytes ? row[i - pixel_bytes] : 0;
+						const uint32_t up = previous != nullptr ? previous[i] : 0;
+						row[i] = static_cast<uint8_t>(row[i] + ((left + up) >> 1));
+					}
+					return true;
+				case 4:
+					for (size_t i = 0; i < size; ++i) {
+						const int32_t left = i >= pixel_bytes ? row[i - pixel_bytes] : 0;
+						const int32_t up = previous != nullptr ? previous[i] : 0;
+						const int32_t up_left = i >= pixel_bytes && previous != nullptr ? previous[i - pixel_bytes] : 0;
+						row[i] = static_cast<uint8_t>(row[i] + paeth(left, up, up_left));
+					}
+					return true;
+			}
+			return false;
+		}
+
+		struct PngColors {
+			uint32_t palette[256] = {};
+			uint32_t palette_size = 0;
+			bool has_key = false; // tRNS for gray and RGB: samples equal to key are transparent
+			uint32_t key[3] = {};
+		};
+
+		// Sample index of the row at the image's bit depth, not scaled
+		uint32_t png_sample(const uint8_t* row, size_t index, uint32_t bit_depth) {
+			switch (bit_depth) {
+				case 8: return row[index];
+				case 16: return (row[index * 2] << 8) | row[index * 2 + 1];
+				default: {
+					const size_t bit = index * bit_depth;
+					return (row[bit / 8] >> (8 - bit_depth - bit % 8)) & ((1u << bit_depth) - 1);
+				}
+			}
+		}
+
+		uint32_t png_to_8_bit(uint32_t sample, uint32_t bit_depth) {
+			if (bit_depth == 16) {
+				return sample >> 8;
+			}
+			return sample * 255 / ((1u << bit_depth) - 1);
+		}
+
+		// Unfiltered row of row_width pixels to x0, x0 + dx... of image row y
+		void expand_png_row(
+			const PngHeader& header, const PngColors& colors, const uint8_t* row, uint32_t row_width,
+			Image& image, uint32_t y, uint32_t x0, uint32_t dx
+		) {
+			uint8_t* out = image.pixels.data() + static_cast<size_t>(y) * image.width * Image::PIXEL_SIZE;
+
+			// The common cases
+			if (header.bit_depth == 8 && dx == 1 && x0 == 0 && !colors.has_key) {
+				if (header.color_type == 6) {
+					memcpy(out, row, static_cast<size_t>(row_width) * 4);
+					return;
+				}
+				if (header.color_type == 2) {
+					for (uint32_t x = 0; x < row_width; ++x) {
+						out[x * 4 + 0] = row[x * 3 + 0];
+						out[x * 4 + 1] = row[x * 3 + 1];
+						out[x * 4 + 2] = row[x * 3 + 2];
+						out[x * 4 + 3] = 255;
+					}
+					return;
+				}
+			}
+
+			const uint32_t channels = header.channels();
+			const uint32_t depth = header.bit_depth;
+			for (uint32_t i = 0; i < row_width; ++i) {
+				uint32_t rgba = 0;
+				const size_t sample = static_cast<size_t>(i) * channels;
+				switch (header.color_type) {
+					case 0: {
+						const uint32_t raw = png_sample(row, sample, depth);
+						const uint32_t gray = png_to_8_bit(raw, depth);
+						const bool transparent = colors.has_key && raw == colors.key[0];
+						rgba = pack_rgba(gray, gray, gray, transparent ? 0 : 255);
+					} break;
+					case 2: {
+						const uint32_t r = png_sample(row, sample + 0, depth);
+						const uint32_t g = png_sample(row, sample + 1, depth);
+						const uint32_t b = png_sample(row, sample + 2, depth);
+						const bool transparent = colors.has_key && r == colors.key[0] && g == colors.key[1] && b == colors.key[2];
+						rgba = pack_rgba(png_to_8_bit(r, depth), png_to_8_bit(g, depth), png_to_8_bit(b, depth), transparent ? 0 : 255);
+					} break;
+					case 3: {
+						const uint32_t index = png_sample(row, sample, depth);
+						rgba = index < colors.palette_size ? colors.palette[index] : pack_rgba(0, 0, 0, 255);
+					} break;
+					case 4: {
+						const uint32_t gray = png_to_8_bit(png_sample(row, sample + 0, depth), depth);
+						const uint32_t alpha = png_to_8_bit(png_sample(row, sample + 1, depth), depth);
+						rgba = pack_rgba(gray, gray, gray, alpha);
+					} break;
+					case 6: {
+						rgba = pack_rgba(
+							png_to_8_bit(png_sample(row, sample + 0, depth), depth),
+							png_to_8_bit(png_sample(row, sample + 1, depth), depth),
+							png_to_8_bit(png_sample(row, sample + 2, depth), depth),
+							png_to_8_bit(png_sample(row, sample + 3, depth), depth)
+						);
+					} break;
+				}
+
+				const uint32_t x = x0 + i * dx;
+				memcpy(out + static_cast<size_t>(x) * Image::PIXEL_SIZE, &rgba, sizeof(rgba));
+			}
+		}
+
+		bool decode_png(const uint8_t* data, size_t size, Image& image, std::string& error) {
+			if (size < 8 || memcmp(data, PNG_SIGNATURE, 8) != 0) {
+				error = "not a PNG file";
+				return false;
+			}
+
+			PngHeader header;
+			PngColors colors;
+			std::vector<uint8_t> compressed;
+			bool has_header = false;
+
+			size_t position = 8;
+			while (true) {
+				if (size - position < 12) {
+					error = "truncated PNG";
+					return false;
+				}
+
+				const uint32_t length = read_u32_be(data + position);
+				const uint8_t* type = data + position + 4;
+				const uint8_t* chunk = data + position + 8;
+				if (length > size - position - 12) {
+					error = "truncated PNG";
+					return false;
+				}
+				position += 12 + static_cast<size_t>(length);
+
+				if (memcmp(type, "IHDR", 4) == 0) {
+					if (length != 13) {
+						error = "bad PNG header";
+						return false;
+					}
+					header.width = read_u32_be(chunk);
+					header.height = read_u32_be(chunk + 4);
+					header.bit_depth = chunk[8];
+					header.color_type = chunk[9];
+					header.interlaced = chunk[12] == 1;
+
+					const uint32_t depth = header.bit_depth;
+					bool valid_depth = false;
+					switch (header.color_type) {
+						case 0: valid_depth = depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16; break;
+						case 3: valid_depth = depth == 1 || depth == 2 || depth == 4 || depth == 8; break;
+						case 2: case 4: case 6: valid_depth = depth == 8 || depth == 16; break;
+					}
+					if (!valid_depth || chunk[10] != 0 || chunk[11] != 0 || chunk[12] > 1) {
+						error = "unsupported PNG format";
+						return false;
+					}
+					if (header.width == 0 || header.height == 0 || header.width > MAX_DIMENSION || header.height > MAX_DIMENSION) {
+						error = "bad PNG size";
+						return false;
+					}
+					has_header = true;
+				} else if (memcmp(type, "PLTE", 4) == 0) {
+					colors.palette_size = std::min(256u, length / 3);
+					for (uint32_t i = 0; i < colors.palette_size; ++i) {
+						colors.palette[i] = pack_rgba(chunk[i * 3], chunk[i * 3 + 1], chunk[i * 3 + 2], 255);
+					}
+				} else if (memcmp(type, "tRNS", 4) == 0) {
+					if (header.color_type == 3) {
+						for (uint32_t i = 0; i < std::min(length, colors.palette_size); ++i) {
+							colors.palette[i] = (colors.palette[i] & 0x00ffffff) | (static_cast<uint32_t>(chunk[i]) << 24);
+						}
+					} else if (header.color_type == 0 && length >= 2) {
+						colors.has_key = true;
+						colors.key[0] = (chunk[0] << 8) | chunk[1];
+					} else if (header.color_type == 2 && length >= 6) {
+						colors.has_key = true;
+						for (uint32_t i = 0; i < 3; ++i) {
+							colors.key[i] = (chunk[i * 2] << 8) | chunk[i * 2 + 1];
+						}
+					}
+				} else if (memcmp(type, "IDAT", 4) == 0) {
+					compressed.insert(compressed.end(), chunk, chunk + length);
+				} else if (memcmp(type, "IEND", 4) == 0) {
+					break;
+				} else if ((type[0] & 0x20) == 0) {
+					error = "unknown critical PNG chunk";
+					return false;
+				}
+			}
+
+			if (!has_header || compressed.empty()) {
+				error = "PNG has no image data";
+				return false;
+			}
+			if (header.color_type == 3 && colors.palette_size == 0) {
+				error = "PNG has no palette";
+				return false;
+			}
+
+			// Interlaced images are 7 smaller images one after the other
+			struct Pass {
+				uint32_t x0, y0, dx, dy;
+			};
+			constexpr Pass ADAM7[7] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+			constexpr Pass WHOLE[1] = { { 0, 0, 1, 1 } };
+			const Pass* passes = header.interlaced ? ADAM7 : WHOLE;
+			const uint32_t pass_count = header.interlaced ? 7 : 1;
+
+			size_t raw_size = 0;
+			for (uint32_t i = 0; i < pass_count; ++i) {
+				const uint32_t pass_width = (header.width - passes[i].x0 + passes[i].dx - 1) / passes[i].dx;
+				const uint32_t pass_height = (header.height - passes[i].y0 + passes[i].dy - 1) / passes[i].dy;
+				if (pass_width > 0 && pass_height > 0) {
+					raw_size += (header.row_size(pass_width) + 1) * pass_height;
+				}
+			}
+
+			std::vector<uint8_t> raw(raw_size);
+			if (!inflate_zlib(compressed.data(), compressed.size(), raw.data(), raw.size(), error)) {
+				return false;
+			}
+
+			allocate_image(image, header.width, header.height);
+
+			const uint32_t pixel_bytes = std::max(1u, header.bits_per_pixel() / 8);
+			uint8_t* row = raw.data();
+			for (uint32_t i = 0; i < pass_count; ++i) {
+				const Pass& pass = passes[i];
+				const uint32_t pass_width = (header.width - pass.x0 + pass.dx - 1) / pass.dx;
+				const uint32_t pass_height = (header.height - pass.y0 + pass.dy - 1) / pass.dy;
+				if (pass_width == 0 || pass_height == 0) {
+					continue;
+				}
+
+				const size_t row_size = header.row_size(pass_width);
+				const uint8_t* previous = nullptr;
+				for (uint32_t y = 0; y < pass_height; ++y) {
+					if (!unfilter_row(row[0], row + 1, previous, row_size, pixel_bytes)) {
+						error = "bad PNG filter";
+						return false;
+					}
+
+					expand_png_row(header, colors, row + 1, pass_width, image, pass.y0 + y * pass.dy, pass.x0, pass.dx);
+					previous = row + 1;
+					row += row_size + 1;
+				}
+			}
+
+			return true;
+		}
+
+		// TGA
+		// --------------------------------------------------
+
+		// bytes is 1 to 4, BGR(A) like the file
+		uint32_t tga_color(const uint8_t* pixel, uint32_t bits) {
+			switch (bits) {
+				case 8: return pack_rgba(pixel[0], pixel[0], pixel[0], 255);
+				case 15:
+				case 16: {
+					const uint32_t value = read_u16_le(pixel);
+					const uint32_t r = ((value >> 10) & 31) * 255 / 31;
+					const uint32_t g = ((value >> 5) & 31) * 255 / 31;
+					const uint32_t b = (value & 31) * 255 / 31;
+					return pack_rgba(r, g, b, 255);
+				}
+				case 24: return pack_rgba(pixel[2], pixel[1], pixel[0], 255);
+				case 32: return pack_rgba(pixel[2], pixel[1], pixel[0], pixel[3]);
+			}
+			return 0;
+		}
+
+		bool decode_tga(const uint8_t* data, size_t size, Image& image, std::string& error) {
+			if (size < 18) {
+				error = "truncated TGA";
+				return false;
+			}
+
+			const uint32_t id_length = data[0];
+			const uint32_t color_map_type = data[1];
+			const uint32_t image_type = data[2];
+			const uint32_t color_map_first = read_u16_le(data + 3);
+			const uint32_t color_map_length = read_u16_le(data + 5);
+			const uint32_t color_map_bits = data[7];
+			const uint32_t width = read_u16_le(data + 12);
+			const uint32_t height = read_u16_le(data + 14);
+			const uint32_t bits = data[16];
+			const uint32_t descriptor = data[17];
+
+			const bool rle = image_type >= 9;
+			const uint32_t base_type = rle ? image_type - 8 : image_type;
+			const bool color_mapped = base_type == 1;
+			if ((base_type != 1 && base_type != 2 && base_type != 3) || (color_mapped && color_map_type != 1)) {
+				error = "unsupported TGA type";
+				return false;
+			}
+
+			const bool valid_bits = color_mapped ? (bits == 8 || bits == 16)
+				: (base_type == 3 ? bits == 8 : (bits == 15 || bits == 16 || bits == 24 || bits == 32));
+			if (!valid_bits) {
+				error = "unsupported TGA bit depth";
+				return false;
+			}
+			if (width == 0 || height == 0 || width > MAX_DIMENSION || height > MAX_DIMENSION) {
+				error = "bad TGA size";
+				return false;
+			}
+
+			size_t position = 18 + id_length;
+			if (position > size) {
+				error = "truncated TGA";
+				return false;
+			}
+
+			std::vector<uint32_t> color_map;
+			if (color_map_type == 1) {
+				const uint32_t entry_bytes = (color_map_bits + 7) / 8;
+				if (entry_bytes == 0 || entry_bytes > 4 || size < position + static_cast<size_t>(color_map_length) * entry_bytes) {
+					error = "bad TGA color map";
+					return false;
+				}
+				color_map.resize(color_map_first + color_map_length);
+				for (uint32_t i = 0; i < color_map_length; ++i) {
+					color_map[color_map_first + i] = tga_color(data + position + i * entry_bytes, color_map_bits);
+				}
+				position += static_cast<size_t>(color_map_length) * entry_bytes;
+			}
+
+			allocate_image(image, width, height);
+
+			const uint32_t pixel_bytes = (bits + 7) / 8;
+			const bool top_down = (descriptor & 0x20) != 0;
+			const bool right_to_left = (descriptor & 0x10) != 0;
+
+			auto read_pixel = [&](const uint8_t* pixel, uint32_t& rgba) {
+				if (!color_mapped) {
+					rgba = tga_color(pixel, bits);
+					return true;
+				}
+				const uint32_t index = pixel_bytes == 1 ? pixel[0] : read_u16_le(pixel);
+				if (index >= color_map.size()) {
+					return false;
+				}
+				rgba = color_map[index];
+				return true;
+			};
+
+			const size_t pixel_count = static_cast<size_t>(width) * height;
+			size_t written = 0;
+			auto write_pixel = [&](uint32_t rgba) {
+				const uint32_t file_x = static_cast<uint32_t>(written % width);
+				const uint32_t file_y = static_cast<uint32_t>(written / width);
+				const uint32_t x = right_to_left ? width - 1 - file_x : file_x;
+				const uint32_t y = top_down ? file_y : height - 1 - file_y;
+				store_pixel(image, x, y, rgba);
+				written++;
+			};
+
+			while (written < pixel_count) {
+				uint32_t run = 1;
+				bool repeat = false;
+				if (rle) {
+					if (position >= size) {
+						break;
+					}
+					const uint32_t packet = data[position++];
+					run = (packet & 0x7f) + 1;
+					repeat = (packet & 0x80) != 0;
+				}
+
+				run = static_cast<uint32_t>(std::min<size_t>(run, pixel_count - written));
+				for (uint32_t i = 0; i < run; ++i) {
+					if (i == 0 || !repeat) {
+						if (size - position < pixel_bytes) {
+							error = "truncated TGA";
+							return false;
+						}
+					}
+
+					uint32_t rgba = 0;
+					if (!read_pixel(data + position, rgba)) {
+						error = "TGA color map index out of range";
+						return false;
+					}
+					if (!repeat || i + 1 == run) {
+						position += pixel_bytes;
+					}
+					write_pixel(rgba);
+				}
+			}
+
+			if (written < pixel_count) {
+				error = "truncated TGA";
+				return false;
+			}
+			return true;
+		}
+
+		// DDS
+		// --------------------------------------------------
+
+		constexpr uint32_t fourcc(char a, char b, char c, char d) {
+			return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+		}
+
+		enum class DdsFormat {
+			BC1,
+			BC2,
+			BC3,
+			RGBA8,
+			BGRA8,
+			BGRX8,
+			Masked, // Legacy uncompressed, described by bit masks
+		};
+
+		uint32_t rgb565_to_rgba(uint32_t value) {
+			const uint32_t r = ((value >> 11) & 31) * 255 / 31;
+			const uint32_t g = ((value >> 5) & 63) * 255 / 63;
+			const uint32_t b = (value & 31) * 255 / 31;
+			return pack_rgba(r, g, b, 255);
+		}
+
+		uint32_t mix_rgba(uint32_t a, uint32_t b, uint32_t weight_a, uint32_t weight_b, uint32_t divisor) {
+			uint32_t result = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8) {
+				const uint32_t channel = (((a >> shift) & 0xff) * weight_a + ((b >> shift) & 0xff) * weight_b) / divisor;
+				result |= channel << shift;
+			}
+			return result;
+		}
+
+		// BC1 color part into 16 RGBA texels. BC2/BC3 always use the four color mode
+		void decode_bc1_colors(const uint8_t* block, uint32_t texels[16], bool four_color_only) {
+			const uint32_t color0 = read_u16_le(block);
+			const uint32_t color1 = read_u16_le(block + 2);
+
+			uint32_t palette[4];
+			palette[0] = rgb565_to_rgba(color0);
+			palette[1] = rgb565_to_rgba(color1);
+			if (color0 > color1 || four_color_only) {
+				palette[2] = mix_rgba(palette[0], palette[1], 2, 1, 3);
+				palette[3] = mix_rgba(palette[0], palette[1], 1, 2, 3);
+			} else {
+				palette[2] = mix_rgba(palette[0], palette[1], 1, 1, 2);
+				palette[3] = 0; // Transparent black
+			}
+
+			const uint32_t indices = read_u32_le(block + 4);
+			for (uint32_t i = 0; i < 16; ++i) {
+				texels[i] = palette[(indices >> (i * 2)) & 3];
+			}
+		}
+
+		void decode_bc_block(DdsFormat format, const uint8_t* block, uint32_t texels[16]) {
+			if (format == DdsFormat::BC1) {
+				decode_bc1_colors(block, texels, false);
+				return;
+			}
+
+			decode_bc1_colors(block + 8, texels, true);
+
+			if (format == DdsFormat::BC2) {
+				for (uint32_t i = 0; i < 16; ++i) {
+					const uint32_t alpha = ((block[i / 2] >> ((i % 2) * 4)) & 15) * 17;
+					texels[i] = (texels[i] & 0x00ffffff) | (alpha << 24);
+				}
+				return;
+			}
+
+			// BC3: two endpoints and 3 bit indices
+			const uint32_t alpha0 = block[0];
+			const uint32_t alpha1 = block[1];
+			uint32_t alphas[8] = { alpha0, alpha1 };
+			if (alpha0 > alpha1) {
+				for (uint32_t i = 1; i < 7; ++i) {
+					alphas[i + 1] = ((7 - i) * alpha0 + i * alpha1) / 7;
+				}
+			} else {
+				for (uint32_t i = 1; i < 5; ++i) {
+					alphas[i + 1] = ((5 - i) * alpha0 + i * alpha1) / 5;
+				}
+				alphas[6] = 0;
+				alphas[7] = 255;
+			}
+
+			uint64_t indices = 0;
+			for (uint32_t i = 0; i < 6; ++i) {
+				indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+			}
+			for (uint32_t i = 0; i < 16; ++i) {
+				const uint32_t alpha = alphas[(indices >> (i * 3)) & 7];
+				texels[i] = (texels[i] & 0x00ffffff) | (alpha << 24);
+			}
+		}
+
+		// Value of a channel under mask, scaled to 8 bits
+		uint32_t masked_channel(uint32_t pixel, uint32_t mask) {
+			if (mask == 0) {
+				return 0;
+			}
+			uint32_t shift = 0;
+			while (((mask >> shift) & 1) == 0) {
+				shift++;
+			}
+			const uint32_t max = mask >> shift;
+			return ((pixel & mask) >> shift) * 255 / max;
+		}
+
+		bool decode_dds(const uint8_t* data, size_t size, Image& image, std::string& error) {
+			if (size < 128 || read_u32_le(data) != fourcc('D', 'D', 'S', ' ') || read_u32_le(data + 4) != 124) {
+				error = "not a DDS file";
+				return false;
+			}
+
+			const uint32_t height = read_u32_le(data + 12);
+			const uint32_t width = read_u32_le(data + 16);
+			const uint32_t pixel_format_flags = read_u32_le(data + 80);
+			const uint32_t four_cc = read_u32_le(data + 84);
+			const uint32_t bit_count = read_u32_le(data + 88);
+			const uint32_t masks[4] = { read_u32_le(data + 92), read_u32_le(data + 96), read_u32_le(data + 100), read_u32_le(data + 104) };
+			const uint32_t caps2 = read_u32_le(data + 112);
+
+			constexpr uint32_t DDPF_ALPHAPIXELS = 0x1;
+			constexpr uint32_t DDPF_FOURCC = 0x4;
+			constexpr uint32_t DDPF_RGB = 0x40;
+			constexpr uint32_t DDPF_LUMINANCE = 0x20000;
+			constexpr uint32_t DDSCAPS2_CUBEMAP = 0x200;
+			constexpr uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+			if ((caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) != 0) {
+				error = "DDS cube maps and volumes aren't supported";
+				return false;
+			}
+			if (width == 0 || height == 0 || width > MAX_DIMENSION || height > MAX_DIMENSION) {
+				error = "bad DDS size";
+				return false;
+			}
+
+			size_t position = 128;
+			DdsFormat format = DdsFormat::Masked;
+			uint32_t pixel_bytes = 0;
+
+			if ((pixel_format_flags & DDPF_FOURCC) != 0) {
+				if (four_cc == fourcc('D', 'X', '1', '0')) {
+					if (size < 148) {
+						error = "truncated DDS";
+						return false;
+					}
+					const uint32_t dxgi_format = read_u32_le(data + 128);
+					const uint32_t dimension = read_u32_le(data + 132);
+					const uint32_t array_size = read_u32_le(data + 140);
+					position = 148;
+
+					constexpr uint32_t DIMENSION_TEXTURE2D = 3;
+					if (dimension != DIMENSION_TEXTURE2D || array_size > 1) {
+						error = "only single 2D DDS textures are supported";
+						return false;
+					}
+
+					switch (dxgi_format) {
+						case 71: case 72: format = DdsFormat::BC1; break;   // BC1_UNORM(_SRGB)
+						case 74: case 75: format = DdsFormat::BC2; break;   // BC2_UNORM(_SRGB)
+						case 77: case 78: format = DdsFormat::BC3; break;   // BC3_UNORM(_SRGB)
+						case 28: case 29: format = DdsFormat::RGBA8; break; // R8G8B8A8_UNORM(_SRGB)
+						case 87: case 91: format = DdsFormat::BGRA8; break; // B8G8R8A8_UNORM(_SRGB)
+						case 88: case 93: format = DdsFormat::BGRX8; break; // B8G8R8X8_UNORM(_SRGB)
+						default:
+							error = "unsupported DXGI format " + std::to_string(dxgi_format) + " in DDS";
+							return false;
+					}
+				} else if (four_cc == fourcc('D', 'X', 'T', '1')) {
+					format = DdsFormat::BC1;
+				} else if (four_cc == fourcc('D', 'X', 'T', '2') || four_cc == fourcc('D', 'X', 'T', '3')) {
+					format = DdsFormat::BC2;
+				} else if (four_cc == fourcc('D', 'X', 'T', '4') || four_cc == fourcc('D', 'X', 'T', '5')) {
+					format = DdsFormat::BC3;
+				} else {
+					error = "unsupported DDS four CC";
+					return false;
+				}
+			} else if ((pixel_format_flags & (DDPF_RGB | DDPF_LUMINANCE)) != 0) {
+				if (bit_count != 8 && bit_count != 16 && bit_count != 24 && bit_count != 32) {
+					error = "unsupported DDS bit count";
+					return false;
+				}
+				format = DdsFormat::Masked;
+				pixel_bytes = bit_count / 8;
+
+				// The common 32 bit layouts skip the per channel mask math
+				const bool alpha_mask = (pixel_format_flags & DDPF_ALPHAPIXELS) != 0 && masks[3] == 0xff000000u;
+				if (bit_count == 32 && (pixel_format_flags & DDPF_RGB) != 0 && masks[1] == 0x0000ff00u) {
+					if (masks[0] == 0x00ff0000u && masks[2] == 0x000000ffu) {
+						format = alpha_mask ? DdsFormat::BGRA8 : DdsFormat::BGRX8;
+					} else if (masks[0] == 0x000000ffu && masks[2] == 0x00ff0000u && alpha_mask) {
+						format = DdsFormat::RGBA8;
+					}
+				}
+			} else {
+				error = "unsupported DDS pixel format";
+				return false;
+			}
+
+			allocate_image(image, width, height);
+
+			if (format == DdsFormat::BC1 || format == DdsFormat::BC2 || format == DdsFormat::BC3) {
+				const uint32_t block_size = format == DdsFormat::BC1 ? 8 : 16;
+				const uint32_t blocks_x = (width + 3) / 4;
+				const uint32_t blocks_y = (height + 3) / 4;
+				if (size - position < static_cast<size_t>(blocks_x) * blocks_y * block_size) {
+					error = "truncated DDS";
+					return false;
+				}
+
+				uint32_t texels[16];
+				for (uint32_t block_y = 0; block_y < blocks_y; ++block_y) {
+					for (uint32_t block_x = 0; block_x < blocks_x; ++block_x) {
+						decode_bc_block(format, data + position, texels);
+						position += block_size;
+
+						for (uint32_t i = 0; i < 16; ++i) {
+							const uint32_t x = block_x * 4 + i % 4;
+							const uint32_t y = block_y * 4 + i / 4;
+							if (x < width && y < height) {
+								store_pixel(image, x, y, texels[i]);
+							}
+						}
+					}
+				}
+				return true;
+			}
+
+			if (format != DdsFormat::Masked) {
+				pixel_bytes = 4;
+			}
+			if (size - position < static_cast<size_t>(width) * height * pixel_bytes) {
+				error = "truncated DDS";
+				return false;
+			}
+
+			const bool has_alpha = (pixel_format_flags & DDPF_ALPHAPIXELS) != 0 && masks[3] != 0;
+			const bool luminance = (pixel_format_flags & DDPF_LUMINANCE) != 0;
+			for (uint32_t y = 0; y < height; ++y) {
+				for (uint32_t x = 0; x < width; ++x) {
+					const uint8_t* pixel = data + position + (static_cast<size_t>(y) * width + x) * pixel_bytes;
+					uint32_t rgba = 0;
+					switch (format) {
+						case DdsFormat::RGBA8: rgba = read_u32_le(pixel); break;
+						case DdsFormat::BGRA8: rgba = pack_rgba(pixel[2], pixel[1], pixel[0], pixel[3]); break;
+						case DdsFormat::BGRX8: rgba = pack_rgba(pixel[2], pixel[1], pixel[0], 255); break;
+						default: {
+							uint32_t value = 0;
+							memcpy(&value, pixel, pixel_bytes);
+							const uint32_t alpha = has_alpha ? masked_channel(value, masks[3]) : 255;
+							if (luminance) {
+								const uint32_t gray = masked_channel(value, masks[0]);
+								rgba = pack_rgba(gray, gray, gray, alpha);
+							} else {
+								rgba = pack_rgba(masked_channel(value, masks[0]), masked_channel(value, masks[1]), masked_channel(value, masks[2]), alpha);
+							}
+						} break;
+					}
+					store_pixel(image, x, y, rgba);
+				}
+			}
+			return true;
+		}
+	}
+
+	size_t Image::mip_offset(uint32_t mip) const {
+		size_t offset = 0;
+		for (uint32_t i = 0; i < mip; ++i) {
+			offset += mip_size(i);
+		}
+		return offset;
+	}
+
+	uint32_t full_mip_count(uint32_t width, uint32_t height) {
+		uint32_t count = 1;
+		while (width > 1 || height > 1) {
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+			count++;
+		}
+		return count;
+	}
+
+	ImageFileFormat detect_image_format(const uint8_t* data, size_t size) {
+		if (size >= 8 && memcmp(data, PNG_SIGNATURE, 8) == 0) {
+			return ImageFileFormat::Png;
+		}
+		if (size >= 4 && memcmp(data, "DDS ", 4) == 0) {
+			return ImageFileFormat::Dds;
+		}
+		return ImageFileFormat::Unknown;
+	}
+
+	bool decode_image(const uint8_t* data, size_t size, ImageFileFormat format, Image& image, std::string& error) {
+		image = {};
+		switch (format) {
+			case ImageFileFormat::Png: return decode_png(data, size, image, error);
+			case ImageFileFormat::Tga: return decode_tga(data, size, image, error);
+			case ImageFileFormat::Dds: return decode_dds(data, size, image, error);
+			default:
+				error = "unknown image format";
+				return false;
+		}
+	}
+
+	bool load_image(const std::filesystem::path& path, Image& image, std::string& error) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			error = "can't open '" + path.string() + "'";
+			return false;
+		}
+
+		const std::streamsize size = file.tellg();
+		std::vector<uint8_t> data(static_cast<size_t>(std::max<std::streamsize>(size, 0)));
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
+			error = "can't read '" + path.string() + "'";
+			return false;
+		}
+
+		ImageFileFormat format = detect_image_format(data.data(), data.size());
+		if (format == ImageFileFormat::Unknown) {
+			std::string extension = path.extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+			if (extension == ".tga") {
+				format = ImageFileFormat::Tga;
+			}
+		}
+
+		if (!decode_image(data.data(), data.size(), format, image, error)) {
+			error = "'" + path.string() + "': " + error;
+			return false;
+		}
+		return true;
+	}
+
+	void premultiply_alpha(Image& image) {
+		uint8_t* pixels = image.mip_data(0);
+		const size_t pixel_count = static_cast<size_t>(image.width) * image.height;
+		for (size_t i = 0; i < pixel_count; ++i) {
+			uint8_t* pixel = pixels + i * Image::PIXEL_SIZE;
+			const uint32_t alpha = pixel[3];
+			if (alpha == 255) {
+				continue;
+			}
+			// Exact round(c * alpha / 255) without the divide
+			for (uint32_t c = 0; c < 3; ++c) {
+				const uint32_t product = pixel[c] * alpha + 128;
+				pixel[c] = static_cast<uint8_t>((product + (product >> 8)) >> 8);
+			}
+		}
+	}
+
+	void generate_mips(Image& image) {
+		assert(!image.empty());
+
+		image.mip_count = full_mip_count(image.width, image.height);
+		image.pixels.resize(image.mip_offset(image.mip_count));
+
+		// Two channels per 16 bit lane, a sum of four fits
+		constexpr uint32_t LOW = 0x00ff00ff;
+		auto average = [](uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+			const uint32_t low = ((a & LOW) + (b & LOW) + (c & LOW) + (d & LOW) + 0x00020002) >> 2;
+			const uint32_t high = (((a >> 8) & LOW) + ((b >> 8) & LOW) + ((c >> 8) & LOW) + ((d >> 8) & LOW) + 0x00020002) >> 2;
+			return (low & LOW) | ((high & LOW) << 8);
+		};
+
+		for (uint32_t mip = 1; mip < image.mip_count; ++mip) {
+			const uint32_t source_width = image.mip_width(mip - 1);
+			const uint32_t source_height = image.mip_height(mip - 1);
+			const uint32_t width = image.mip_width(mip);
+			const uint32_t height = image.mip_height(mip);
+			const uint8_t* source = image.mip_data(mip - 1);
+			uint8_t* destination = image.mip_data(mip);
+
+			// An odd last row or column is dropped, a 1 wide side is repeated
+			for (uint32_t y = 0; y < height; ++y) {
+				const uint8_t* row0 = source + static_cast<size_t>(std::min(y * 2, source_height - 1)) * source_width * Image::PIXEL_SIZE;
+				const uint8_t* row1 = source + static_cast<size_t>(std::min(y * 2 + 1, source_height - 1)) * source_width * Image::PIXEL_SIZE;
+				uint8_t* out = destination + static_cast<size_t>(y) * width * Image::PIXEL_SIZE;
+
+				for (uint32_t x = 0; x < width; ++x) {
+					const size_t x0 = static_cast<size_t>(std::min(x * 2, source_width - 1)) * Image::PIXEL_SIZE;
+					const size_t x1 = static_cast<size_t>(std::min(x * 2 + 1, source_width - 1)) * Image::PIXEL_SIZE;
+
+					uint32_t p00, p10, p01, p11;
+					memcpy(&p00, row0 + x0, sizeof(p00));
+					memcpy(&p10, row0 + x1, sizeof(p10));
+					memcpy(&p01, row1 + x0, sizeof(p01));
+					memcpy(&p11, row1 + x1, sizeof(p11));
+
+					const uint32_t result = average(p00, p10, p01, p11);
+					memcpy(out + x * Image::PIXEL_SIZE, &result, sizeof(result));
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "pch.h"
+
+namespace dvig {
+	enum class ImageFileFormat {
+		Unknown,
+		Png,
+		Tga,
+		Dds,
+	};
+
+	// RGBA8, R in the lowest byte like the rest of the renderer.
+	// Mips are stored back to back, largest first, every row tightly packed.
+	struct Image {
+		static constexpr uint32_t PIXEL_SIZE = 4;
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mip_count = 0;
+		std::vector<uint8_t> pixels;
+
+		uint32_t mip_width(uint32_t mip) const { return std::max(1u, width >> mip); }
+		uint32_t mip_height(uint32_t mip) const { return std::max(1u, height >> mip); }
+		size_t mip_size(uint32_t mip) const { return static_cast<size_t>(mip_width(mip)) * mip_height(mip) * PIXEL_SIZE; }
+		size_t mip_offset(uint32_t mip) const;
+		const uint8_t* mip_data(uint32_t mip) const { return pixels.data() + mip_offset(mip); }
+		uint8_t* mip_data(uint32_t mip) { return pixels.data() + mip_offset(mip); }
+
+		bool empty() const { return mip_count == 0; }
+	};
+
+	// Mips down to 1x1
+	uint32_t full_mip_count(uint32_t width, uint32_t height);
+
+	// From the magic bytes. TGA has none, it's only picked by load_image from the file extension
+	ImageFileFormat detect_image_format(const uint8_t* data, size_t size);
+
+	// Only the top mip is decoded, DDS files with mips too. Returns false with the reason in error.
+	// PNG: every color type and bit depth, interlaced too. CRCs and the zlib checksum aren't checked.
+	// TGA: uncompressed and RLE true color, gray and color mapped.
+	// DDS: 24/32 bit RGB(A), luminance and BC1/BC2/BC3 (DXT1-5), DX10 header included. No cube maps or arrays.
+	bool decode_image(const uint8_t* data, size_t size, ImageFileFormat format, Image& image, std::string& error);
+	bool load_image(const std::filesystem::path& path, Image& image, std::string& error);
+
+	// Scales color by alpha. Only the top mip, run it before generate_mips
+	void premultiply_alpha(Image& image);
+	// Replaces the mips below the top one with a full chain, each a 2x2 box filter of the one above.
+	// Filter premultiplied images, straight alpha bleeds the color of transparent texels
+	void generate_mips(Image& image);
+}
@@ -1,56 +1,204 @@
 #include "pch.h"
 #include "Input.h"
+#include "FrameTiming.h"
 
 namespace dvig {
-	bool Input::poll_events(Event& event) {
-		MSG msg = {};
-		if (PeekMessage(&msg, _hwnd, 0, 0, PM_REMOVE)) {
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
+	InputQueue::InputQueue(uint32_t capacity) {
+		uint32_t size = 1;
+		while (size < capacity) {
+			size *= 2;
+		}
+
+		_events.resize(size);
+		_mask = size - 1;
+	}
+
+	void InputQueue::push(Event event) {
+		if (event.time == 0) {
+			event.time = steady_clock_now();
 		}
 
-		if (!_events.empty()) {
-			event = _events.back();
-			_events.pop_back();
-			return true;
+		// State first, a dropped event still moves keys
+		apply(event);
+
+		if (_write - _read == _events.size()) {
+			_dropped++;
+			return;
 		}
 
-		return false;
+		_events[_write & _mask] = event;
+		_write++;
 	}
-	
-	void Input::init(HWND hwnd) {
-		_hwnd = hwnd;
+
+	void InputQueue::begin_frame() {
+		// Whatever the last frame didn't poll
+		_read = _frame_end;
+		_frame_end = _write;
+
+		_state = _live;
+		_live.keys_pressed.reset();
+		_live.keys_released.reset();
+		_live.buttons_pressed.reset();
+		_live.buttons_released.reset();
+		_live.mouse_delta = glm::ivec2(0);
+		_live.wheel = 0.0f;
 	}
 
-	bool Input::key_down(uint32_t key_code) {
-		SHORT key_state = ::GetAsyncKeyState(static_cast<int>(key_code));
+	bool InputQueue::poll(Event& event) {
+		if (_read == _frame_end) {
+			return false;
+		}
 
-		if ((1 << 15) & key_state) {
-			return true;
+		event = _events[_read & _mask];
+		_read++;
+		return true;
+	}
+
+	void InputQueue::apply(Event& event) {
+		const size_t button = static_cast<size_t>(event.button);
+
+		switch (event.type) {
+			case EventType::KeyPressed:
+				if (event.key_code < InputState::KEY_COUNT) {
+					event.repeat = _live.keys_down[event.key_code];
+					if (!event.repeat) {
+						_live.keys_down.set(event.key_code);
+						_live.keys_pressed.set(event.key_code);
+					}
+				}
+				break;
+			case EventType::KeyReleased:
+				if (event.key_code < InputState::KEY_COUNT && _live.keys_down[event.key_code]) {
+					_live.keys_down.reset(event.key_code);
+					_live.keys_released.set(event.key_code);
+				}
+				break;
+			case EventType::MouseMoved:
+				_live.mouse_delta += event.position - _live.mouse_position;
+				_live.mouse_position = event.position;
+				break;
+			case EventType::MouseButtonPressed:
+				if (button < _live.buttons_down.size() && !_live.buttons_down[button]) {
+					_live.buttons_down.set(button);
+					_live.buttons_pressed.set(button);
+				}
+				break;
+			case EventType::MouseButtonReleased:
+				if (button < _live.buttons_down.size() && _live.buttons_down[button]) {
+					_live.buttons_down.reset(button);
+					_live.buttons_released.set(button);
+				}
+				break;
+			case EventType::MouseWheel:
+				_live.wheel += event.wheel;
+				break;
+			case EventType::FocusGained:
+				_live.focused = true;
+				break;
+			case EventType::FocusLost:
+				// Releases never arrive once the window lost focus, let go of everything now
+				_live.focused = false;
+				_live.keys_released |= _live.keys_down;
+				_live.keys_down.reset();
+				_live.buttons_released |= _live.buttons_down;
+				_live.buttons_down.reset();
+				break;
+			default:
+				break;
 		}
+	}
+
+	void Input::begin_frame() {
+	#ifdef _WIN32
+		MSG msg = {};
+		while (PeekMessage(&msg, _hwnd, 0, 0, PM_REMOVE)) {
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+	#endif
+
+		_queue.begin_frame();
+	}
+
+	bool Input::poll_events(Event& event) {
+		return _queue.poll(event);
+	}
+
+	void Input::push_event(const Event& event) {
+		_queue.push(event);
+	}
 
-		return false;
+#ifdef _WIN32
+	void Input::init(HWND hwnd) {
+		_hwnd = hwnd;
 	}
 
 	LRESULT Input::window_proc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
 		Event event = {};
+		// Client coordinates are signed, they go negative left of and above the window while captured
+		const glm::ivec2 position = { static_cast<int16_t>(LOWORD(lParam)), static_cast<int16_t>(HIWORD(lParam)) };
+
+		auto push_button = [&](EventType type, MouseButton button) {
+			event.type = type;
+			event.button = button;
+			event.position = position;
+			_queue.push(event);
+		};
 
 		switch (uMsg) {
 			case WM_CLOSE:
 				event.type = EventType::Close;
-				_events.push_back(event);
-				break;
+				_queue.push(event);
+				return {};
 			case WM_KEYDOWN:
+			case WM_SYSKEYDOWN:
 				event.type = EventType::KeyPressed;
 				event.key_code = static_cast<uint32_t>(wParam);
-				_events.push_back(event);
-
+				_queue.push(event);
+				break;
+			case WM_KEYUP:
+			case WM_SYSKEYUP:
+				event.type = EventType::KeyReleased;
+				event.key_code = static_cast<uint32_t>(wParam);
+				_queue.push(event);
+				break;
+			case WM_MOUSEMOVE:
+				event.type = EventType::MouseMoved;
+				event.position = position;
+				_queue.push(event);
+				break;
+			case WM_LBUTTONDOWN: push_button(EventType::MouseButtonPressed, MouseButton::Left); break;
+			case WM_LBUTTONUP:   push_button(EventType::MouseButtonReleased, MouseButton::Left); break;
+			case WM_RBUTTONDOWN: push_button(EventType::MouseButtonPressed, MouseButton::Right); break;
+			case WM_RBUTTONUP:   push_button(EventType::MouseButtonReleased, MouseButton::Right); break;
+			case WM_MBUTTONDOWN: push_button(EventType::MouseButtonPressed, MouseButton::Middle); break;
+			case WM_MBUTTONUP:   push_button(EventType::MouseButtonReleased, MouseButton::Middle); break;
+			case WM_XBUTTONDOWN: push_button(EventType::MouseButtonPressed, HIWORD(wParam) == XBUTTON1 ? MouseButton::X1 : MouseButton::X2); break;
+			case WM_XBUTTONUP:   push_button(EventType::MouseButtonReleased, HIWORD(wParam) == XBUTTON1 ? MouseButton::X1 : MouseButton::X2); break;
+			case WM_MOUSEWHEEL:
+				event.type = EventType::MouseWheel;
+				event.wheel = static_cast<float>(GET_WHEEL_DELTA_WPARAM(wParam)) / WHEEL_DELTA;
+				_queue.push(event);
+				break;
+			case WM_SIZE:
+				event.type = EventType::Resized;
+				event.size = { LOWORD(lParam), HIWORD(lParam) };
+				_queue.push(event);
+				break;
+			case WM_SETFOCUS:
+				event.type = EventType::FocusGained;
+				_queue.push(event);
+				break;
+			case WM_KILLFOCUS:
+				event.type = EventType::FocusLost;
+				_queue.push(event);
 				break;
 			default:
-				return DefWindowProc(hwnd, uMsg, wParam, lParam);
+				break;
 		}
 
-		//return DefWindowProc(hwnd, uMsg, wParam, lParam);
-		return {};
+		// Everything but closing keeps the default handling (Alt+F4, system menu, cursor)
+		return DefWindowProc(hwnd, uMsg, wParam, lParam);
 	}
+#endif
 }
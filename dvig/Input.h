@@ -1,32 +1,135 @@
 #pragma once
+#include "pch.h"
+
 #include "KeyCodes.h"
+#include "Memory.h"
 
 namespace dvig {
 	enum class EventType {
 		None,
 
 		Close,
-		KeyPressed
+		KeyPressed,
+		KeyReleased,
+		MouseMoved,
+		MouseButtonPressed,
+		MouseButtonReleased,
+		MouseWheel,
+		Resized,
+		FocusGained,
+		FocusLost,
+	};
+
+	enum class MouseButton : uint32_t {
+		Left,
+		Right,
+		Middle,
+		X1,
+		X2,
+
+		Count,
 	};
 
 	struct Event {
-		EventType type;
+		EventType type = EventType::None;
+		int64_t time = 0;      // steady_clock_now() when it was pushed
+		uint32_t key_code = 0; // Key events, VK_ for now
+		bool repeat = false;   // KeyPressed while the key already was down
+		MouseButton button = MouseButton::Left;
+		glm::ivec2 position = glm::ivec2(0); // Mouse events, client pixels
+		glm::ivec2 size = glm::ivec2(0);     // Resized, new client size
+		float wheel = 0.0f;                  // MouseWheel, notches, positive away from the user
+	};
+
+	// Keys and mouse buttons at the start of a frame. pressed and released collect every transition
+	// since the frame before, so a tap shorter than a frame shows up as both with down false
+	struct InputState {
+		static constexpr uint32_t KEY_COUNT = 256;
+
+		std::bitset<KEY_COUNT> keys_down;
+		std::bitset<KEY_COUNT> keys_pressed;
+		std::bitset<KEY_COUNT> keys_released;
+		std::bitset<static_cast<size_t>(MouseButton::Count)> buttons_down;
+		std::bitset<static_cast<size_t>(MouseButton::Count)> buttons_pressed;
+		std::bitset<static_cast<size_t>(MouseButton::Count)> buttons_released;
+		glm::ivec2 mouse_position = glm::ivec2(0);
+		glm::ivec2 mouse_delta = glm::ivec2(0); // Since the frame before
+		float wheel = 0.0f;                     // Notches since the frame before
+		bool focused = true;
+
+		bool key_down(uint32_t key_code) const { return key_code < KEY_COUNT && keys_down[key_code]; }
+		bool key_pressed(uint32_t key_code) const { return key_code < KEY_COUNT && keys_pressed[key_code]; }
+		bool key_released(uint32_t key_code) const { return key_code < KEY_COUNT && keys_released[key_code]; }
+		bool mouse_down(MouseButton button) const { return buttons_down[static_cast<size_t>(button)]; }
+		bool mouse_pressed(MouseButton button) const { return buttons_pressed[static_cast<size_t>(button)]; }
+		bool mouse_released(MouseButton button) const { return buttons_released[static_cast<size_t>(button)]; }
+	};
+
+	// Platform neutral side of input: the platform layer pushes events as it gets them, begin_frame() makes
+	// them the current frame's batch (read in order with poll) and snapshots the key state.
+	// Events live in a preallocated ring. Events of the previous frame that weren't polled are dropped,
+	// and when the ring is full new events are dropped too, but they still update the key state.
+	// Only on one thread.
+	class InputQueue {
+	public:
+		InputQueue() : InputQueue(1024) {}
+		// Rounded up to a power of two
+		explicit InputQueue(uint32_t capacity);
+
+		void push(Event event);
+		void begin_frame();
+		// Oldest first, only events from before the last begin_frame()
+		bool poll(Event& event);
+
+		const InputState& state() const { return _state; }
+		uint32_t capacity() const { return static_cast<uint32_t>(_events.size()); }
+		// Events that didn't fit, since the start
+		uint64_t dropped() const { return _dropped; }
+
+	private:
+		void apply(Event& event);
 
-		union {
-			uint32_t key_code;
-		};
+	private:
+		TrackedVector<Event, MemoryTag::Input> _events;
+		uint32_t _mask = 0;
+		// Running counts, wrapped into the ring with _mask. [_read, _frame_end) is the current frame
+		uint32_t _read = 0;
+		uint32_t _frame_end = 0;
+		uint32_t _write = 0;
+		uint64_t _dropped = 0;
+
+		InputState _live;  // Up to the latest push
+		InputState _state; // Snapshot of _live at begin_frame()
 	};
 
 	class Input {
 	public:
+		// Drains the platform's pending messages into the queue once and snapshots the key state.
+		// App calls it at the start of every frame
+		static void begin_frame();
+		// This frame's events, oldest first
 		static bool poll_events(Event& event);
-		static void init(HWND hwnd);
-		static bool key_down(uint32_t key_code); // VK_ for now
+		// As if the platform reported it, shows up after the next begin_frame(). For tests and replays
+		static void push_event(const Event& event);
 
+		// From the snapshot, no syscalls
+		static bool key_down(uint32_t key_code) { return _queue.state().key_down(key_code); } // VK_ for now
+		static bool key_pressed(uint32_t key_code) { return _queue.state().key_pressed(key_code); }
+		static bool key_released(uint32_t key_code) { return _queue.state().key_released(key_code); }
+		static bool mouse_down(MouseButton button) { return _queue.state().mouse_down(button); }
+		static glm::ivec2 mouse_position() { return _queue.state().mouse_position; }
+		static const InputState& state() { return _queue.state(); }
+		static const InputQueue& queue() { return _queue; }
+
+	#ifdef _WIN32
+		static void init(HWND hwnd);
 		static LRESULT CALLBACK window_proc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+	#endif
 
 	private:
+	#ifdef _WIN32
 		static inline HWND _hwnd;
-		static inline std::vector<Event> _events;
+	#endif
+		static inline InputQueue _queue;
 	};
 }
@@ -0,0 +1,295 @@
+#include "pch.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace dvig {
+	struct Job {
+		JobSystem::Function function;
+		JobCounter* counter = nullptr;
+		uint32_t queued_by = ~0u; // Worker index, for the steal count
+	};
+
+	namespace {
+		// Which system's worker the current thread is
+		thread_local const JobSystem* t_system = nullptr;
+		thread_local uint32_t t_index = ~0u;
+
+		// Tries before an idle worker goes to sleep
+		constexpr uint32_t IDLE_SPINS = 64;
+	}
+
+	bool JobDeque::push(Job* job) {
+		const int64_t bottom = _bottom.load(std::memory_order_relaxed);
+		const int64_t top = _top.load(std::memory_order_acquire);
+		if (bottom - top >= CAPACITY) {
+			return false;
+		}
+
+		_jobs[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	Job* JobDeque::pop() {
+		const int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+		_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = _top.load(std::memory_order_relaxed);
+
+		if (top > bottom) {
+			_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = _jobs[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (top == bottom) {
+			// Last one, race the thieves for it
+			if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+				job = nullptr;
+			}
+			_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* JobDeque::steal() {
+		int64_t top = _top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t bottom = _bottom.load(std::memory_order_acquire);
+		if (top >= bottom) {
+			return nullptr;
+		}
+
+		Job* job = _jobs[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+		if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			return nullptr;
+		}
+		return job;
+	}
+
+	uint32_t JobSystem::default_worker_count() {
+		const uint32_t hardware_threads = std::thread::hardware_concurrency();
+		return hardware_threads > 1 ? hardware_threads - 1 : 0;
+	}
+
+	JobSystem::JobSystem(uint32_t worker_count)
+		: _job_pool(sizeof(Job), alignof(Job), 1024) {
+		_workers.reserve(worker_count + 1);
+		for (uint32_t i = 0; i < worker_count + 1; ++i) {
+			_workers.push_back(std::make_unique<Worker>());
+		}
+
+		t_system = this;
+		t_index = 0;
+
+		for (uint32_t i = 1; i < worker_count + 1; ++i) {
+			_workers[i]->thread = std::thread(&JobSystem::worker_main, this, i);
+		}
+	}
+
+	JobSystem::~JobSystem() {
+		// Whatever the main thread queued and never waited for
+		while (Job* job = find_job(0)) {
+			execute(job, 0);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_sleep_mutex);
+			_stopping = true;
+		}
+		_wake.notify_all();
+
+		for (uint32_t i = 1; i < _workers.size(); ++i) {
+			_workers[i]->thread.join();
+		}
+
+		if (t_system == this) {
+			t_system = nullptr;
+			t_index = ~0u;
+		}
+	}
+
+	void JobSystem::run(Function function, JobCounter* counter) {
+		if (counter != nullptr) {
+			counter->_pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		queue(_job_pool.create<Job>(Job{ std::move(function), counter, current_index() }));
+	}
+
+	void JobSystem::run_after(JobCounter& dependency, Function function, JobCounter* counter) {
+		if (counter != nullptr) {
+			counter->_pending.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Job* job = _job_pool.create<Job>(Job{ std::move(function), counter, ~0u });
+		{
+			std::lock_guard<std::mutex> lock(dependency._mutex);
+			if (dependency._pending.load(std::memory_order_acquire) != 0) {
+				dependency._continuations.push_back(job);
+				return;
+			}
+		}
+
+		job->queued_by = current_index();
+		queue(job);
+	}
+
+	void JobSystem::wait(JobCounter& counter) {
+		const uint32_t index = current_index();
+		while (!counter.done()) {
+			if (Job* job = find_job(index)) {
+				execute(job, index);
+			} else {
+				std::this_thread::yield();
+			}
+		}
+
+		// The last finish() may still hold the lock, the counter can't go away before it lets go
+		std::lock_guard<std::mutex> lock(counter._mutex);
+	}
+
+	JobSystemStats JobSystem::stats() const {
+		JobSystemStats stats;
+		for (const Unique<Worker>& worker : _workers) {
+			stats.jobs += worker->jobs.load(std::memory_order_relaxed);
+			stats.stolen += worker->stolen.load(std::memory_order_relaxed);
+		}
+		stats.injected = _injected_count.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	void JobSystem::reset_stats() {
+		for (Unique<Worker>& worker : _workers) {
+			worker->jobs.store(0, std::memory_order_relaxed);
+			worker->stolen.store(0, std::memory_order_relaxed);
+		}
+		_injected_count.store(0, std::memory_order_relaxed);
+	}
+
+	uint32_t JobSystem::range_count(uint32_t count, uint32_t min_grain) const {
+		// Rounded down, so no range ends up shorter than min_grain
+		const uint32_t max_ranges = std::max(count / std::max(min_grain, 1u), 1u);
+		return std::min(max_ranges, thread_count() * 4);
+	}
+
+	void JobSystem::worker_main(uint32_t index) {
+		t_system = this;
+		t_index = index;
+		Profiler::get().set_thread_name("JobSystem");
+
+		while (true) {
+			Job* job = nullptr;
+			for (uint32_t spin = 0; spin < IDLE_SPINS && job == nullptr; ++spin) {
+				job = find_job(index);
+				if (job == nullptr) {
+					std::this_thread::yield();
+				}
+			}
+
+			if (job != nullptr) {
+				execute(job, index);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(_sleep_mutex);
+			_sleeping.fetch_add(1);
+			_wake.wait(lock, [&] { return _stopping || _queued.load() > 0; });
+			_sleeping.fetch_sub(1);
+			if (_stopping && _queued.load() <= 0) {
+				return;
+			}
+		}
+	}
+
+	Job* JobSystem::find_job(uint32_t index) {
+		if (_queued.load(std::memory_order_relaxed) <= 0) {
+			return nullptr;
+		}
+
+		Job* job = nullptr;
+		if (index != ~0u) {
+			job = _workers[index]->deque.pop();
+		}
+
+		if (job == nullptr && _injected_size.load(std::memory_order_relaxed) > 0) {
+			std::lock_guard<std::mutex> lock(_injected_mutex);
+			if (!_injected.empty()) {
+				job = _injected.front();
+				_injected.pop_front();
+				_injected_size.store(static_cast<uint32_t>(_injected.size()), std::memory_order_relaxed);
+			}
+		}
+
+		// Starts at the next worker, so thieves spread over the victims
+		const uint32_t count = thread_count();
+		const uint32_t start = index == ~0u ? 0 : index + 1;
+		for (uint32_t i = 0; i < count && job == nullptr; ++i) {
+			const uint32_t victim = (start + i) % count;
+			if (victim != index) {
+				job = _workers[victim]->deque.steal();
+			}
+		}
+
+		if (job != nullptr) {
+			_queued.fetch_sub(1);
+		}
+		return job;
+	}
+
+	void JobSystem::execute(Job* job, uint32_t index) {
+		job->function();
+
+		if (index != ~0u) {
+			Worker& worker = *_workers[index];
+			worker.jobs.store(worker.jobs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			if (job->queued_by != ~0u && job->queued_by != index) {
+				worker.stolen.store(worker.stolen.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			}
+		}
+
+		if (job->counter != nullptr) {
+			finish(*job->counter);
+		}
+		_job_pool.destroy(job);
+	}
+
+	void JobSystem::queue(Job* job) {
+		// Counted first, a worker can take the job the moment it's pushed
+		_queued.fetch_add(1);
+
+		const uint32_t index = current_index();
+		if (index == ~0u || !_workers[index]->deque.push(job)) {
+			std::lock_guard<std::mutex> lock(_injected_mutex);
+			_injected.push_back(job);
+			_injected_size.store(static_cast<uint32_t>(_injected.size()), std::memory_order_relaxed);
+			_injected_count.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (_sleeping.load() > 0) {
+			std::lock_guard<std::mutex> lock(_sleep_mutex);
+			_wake.notify_one();
+		}
+	}
+
+	void JobSystem::finish(JobCounter& counter) {
+		std::vector<Job*> continuations;
+		{
+			std::lock_guard<std::mutex> lock(counter._mutex);
+			if (counter._pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				continuations.swap(counter._continuations);
+			}
+		}
+
+		const uint32_t index = current_index();
+		for (Job* job : continuations) {
+			job->queued_by = index;
+			queue(job);
+		}
+	}
+
+	uint32_t JobSystem::current_index() const {
+		return t_system == this ? t_index : ~0u;
+	}
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "Memory.h"
+
+namespace dvig {
+	struct Job;
+
+	// Counts jobs that haven't finished. Wait on it with JobSystem::wait or hang jobs off it with run_after.
+	// Has to be waited on before it's destroyed, jobs decrement it from other threads
+	class JobCounter {
+		friend class JobSystem;
+	public:
+		JobCounter() = default;
+		~JobCounter() { assert(done() && "JobCounter destroyed with jobs still running"); }
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool done() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		std::atomic<uint32_t> _pending = 0;
+		std::mutex _mutex;               // Hitting 0 and adding continuations
+		std::vector<Job*> _continuations; // Queued once _pending hits 0
+	};
+
+	// Fixed size Chase-Lev deque. The owner pushes and pops at the bottom (LIFO, what it just queued is still in cache),
+	// any other thread steals from the top
+	class JobDeque {
+	public:
+		static constexpr int64_t CAPACITY = 4096;
+
+		// Owner only. false when full
+		bool push(Job* job);
+		// Owner only. nullptr when empty
+		Job* pop();
+		// Any thread. nullptr when empty or another thief won
+		Job* steal();
+
+	private:
+		alignas(64) std::atomic<int64_t> _top = 0;
+		alignas(64) std::atomic<int64_t> _bottom = 0;
+		alignas(64) std::array<std::atomic<Job*>, CAPACITY> _jobs = {};
+	};
+
+	struct JobSystemStats {
+		uint64_t jobs = 0;     // Run by the workers and the main thread
+		uint64_t stolen = 0;   // Of those, taken from another thread's deque
+		uint64_t injected = 0; // Went through the shared queue: queued outside the system or onto a full deque
+	};
+
+	// Work stealing thread pool. Every worker and the thread that created the system (the main thread) own a deque:
+	// jobs queued on one of those threads go to its own deque, idle threads steal from the others.
+	// Jobs queued from any other thread (render thread, texture loader) go through a shared queue.
+	// The main thread only runs jobs inside wait() and parallel_for(), so waiting for work never wastes a core.
+	// Jobs can queue more jobs and wait on them.
+	class JobSystem {
+	public:
+		using Function = std::function<void()>;
+
+		// hardware threads - 1, the main thread takes the last one
+		static uint32_t default_worker_count();
+
+		// worker_count threads besides the calling one. 0 runs every job inside wait() on the caller
+		explicit JobSystem(uint32_t worker_count);
+		// Runs what's still queued, then joins the workers. On the thread that created it
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// Any thread. counter goes up now and down once function returned
+		void run(Function function, JobCounter* counter = nullptr);
+		// Queued once dependency is done, right away when it is already. counter goes up now
+		void run_after(JobCounter& dependency, Function function, JobCounter* counter = nullptr);
+		// Runs queued jobs on the calling thread until counter is done
+		void wait(JobCounter& counter);
+
+		// function(begin, end) over ranges covering [0, count), returns once all of them ran.
+		// Ranges are at least min_grain long and there are about 4 per thread, so stealing evens out
+		// uneven ones without paying the queueing cost per index. The calling thread takes the first range
+		template<typename RangeFunction>
+		void parallel_for(uint32_t count, RangeFunction&& function, uint32_t min_grain = 1) {
+			const uint32_t ranges = range_count(count, min_grain);
+			if (ranges <= 1) {
+				if (count > 0) {
+					function(0u, count);
+				}
+				return;
+			}
+
+			const uint32_t base = count / ranges;
+			const uint32_t extra = count % ranges;
+			auto range_begin = [&](uint32_t range) { return range * base + std::min(range, extra); };
+
+			JobCounter counter;
+			for (uint32_t range = 1; range < ranges; ++range) {
+				const uint32_t begin = range_begin(range);
+				const uint32_t end = range_begin(range + 1);
+				run([&function, begin, end]() { function(begin, end); }, &counter);
+			}
+
+			function(0u, range_begin(1));
+			wait(counter);
+		}
+
+		uint32_t worker_count() const { return static_cast<uint32_t>(_workers.size()) - 1; }
+		// Workers plus the main thread
+		uint32_t thread_count() const { return static_cast<uint32_t>(_workers.size()); }
+
+		// Since the last reset_stats
+		JobSystemStats stats() const;
+		void reset_stats();
+
+	private:
+		struct Worker {
+			JobDeque deque;
+			std::thread thread; // Not for the main thread
+			std::atomic<uint64_t> jobs = 0;
+			std::atomic<uint64_t> stolen = 0;
+		};
+
+		uint32_t range_count(uint32_t count, uint32_t min_grain) const;
+
+		void worker_main(uint32_t index);
+		// Own deque, then the shared queue, then the other deques. nullptr when there's nothing
+		Job* find_job(uint32_t index);
+		void execute(Job* job, uint32_t index);
+		void queue(Job* job);
+		void finish(JobCounter& counter);
+		// Index of the calling thread's worker, ~0u outside the system
+		uint32_t current_index() const;
+
+	private:
+		PoolAllocator _job_pool; // Every Job, freed once it ran
+		std::vector<Unique<Worker>> _workers; // 0 is the main thread
+
+		std::mutex _injected_mutex;
+		std::deque<Job*> _injected;
+		std::atomic<uint32_t> _injected_size = 0; // Peeked without the lock
+		std::atomic<uint64_t> _injected_count = 0;
+
+		// Jobs queued and not taken yet, idle workers sleep while it's 0
+		std::atomic<int32_t> _queued = 0;
+		std::atomic<uint32_t> _sleeping = 0;
+		std::mutex _sleep_mutex;
+		std::condition_variable _wake;
+		bool _stopping = false;
+	};
+}
@@ -0,0 +1,346 @@
+#include "pch.h"
+#include "Memory.h"
+
+namespace dvig {
+	namespace {
+		thread_local MemoryTag t_memory_tag = MemoryTag::User;
+
+		// malloc for alignments it already guarantees, the aligned allocation of the platform above
+		void* raw_allocate(size_t size, size_t alignment) {
+			if (alignment <= alignof(std::max_align_t)) {
+				return std::malloc(size);
+			}
+		#ifdef _WIN32
+			return _aligned_malloc(size, alignment);
+		#else
+			return std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+		#endif
+		}
+
+		void raw_free(void* memory, size_t alignment) {
+			if (alignment <= alignof(std::max_align_t)) {
+				std::free(memory);
+				return;
+			}
+		#ifdef _WIN32
+			_aligned_free(memory);
+		#else
+			std::free(memory);
+		#endif
+		}
+
+		size_t align_up(size_t value, size_t alignment) {
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	const char* memory_tag_name(MemoryTag tag) {
+		switch (tag) {
+			case MemoryTag::Render: return "Render";
+			case MemoryTag::Input: return "Input";
+			case MemoryTag::Assets: return "Assets";
+			case MemoryTag::User: return "User";
+		}
+		return "";
+	}
+
+	void MemoryTracker::record_allocation(MemoryTag tag, size_t size) {
+		TagCounters& counters = _tags[static_cast<uint32_t>(tag)];
+
+		const uint64_t live = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+		uint64_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+		while (live > peak && !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+		}
+		counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void MemoryTracker::record_free(MemoryTag tag, size_t size) {
+		_tags[static_cast<uint32_t>(tag)].live_bytes.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	void MemoryTracker::end_frame() {
+		for (TagCounters& counters : _tags) {
+			const uint64_t allocations = counters.allocations.load(std::memory_order_relaxed);
+			counters.frame_allocations = allocations - counters.frame_start_allocations;
+			counters.frame_start_allocations = allocations;
+			counters.max_frame_allocations = std::max(counters.max_frame_allocations, counters.frame_allocations);
+		}
+	}
+
+	MemoryTagStats MemoryTracker::stats(MemoryTag tag) const {
+		const TagCounters& counters = _tags[static_cast<uint32_t>(tag)];
+
+		MemoryTagStats stats;
+		stats.live_bytes = counters.live_bytes.load(std::memory_order_relaxed);
+		stats.peak_bytes = counters.peak_bytes.load(std::memory_order_relaxed);
+		stats.allocations = counters.allocations.load(std::memory_order_relaxed);
+		stats.frame_allocations = counters.frame_allocations;
+		stats.max_frame_allocations = counters.max_frame_allocations;
+		return stats;
+	}
+
+	MemoryTagStats MemoryTracker::total_stats() const {
+		MemoryTagStats total;
+		for (uint32_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+			const MemoryTagStats tag_stats = stats(static_cast<MemoryTag>(tag));
+			total.live_bytes += tag_stats.live_bytes;
+			total.peak_bytes += tag_stats.peak_bytes;
+			total.allocations += tag_stats.allocations;
+			total.frame_allocations += tag_stats.frame_allocations;
+			total.max_frame_allocations += tag_stats.max_frame_allocations;
+		}
+		return total;
+	}
+
+	void MemoryTracker::reset_peaks() {
+		for (TagCounters& counters : _tags) {
+			counters.peak_bytes.store(counters.live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			counters.max_frame_allocations = 0;
+		}
+	}
+
+	MemoryTag current_memory_tag() {
+		return t_memory_tag;
+	}
+
+	MemoryTagScope::MemoryTagScope(MemoryTag tag)
+		: _previous(t_memory_tag) {
+		t_memory_tag = tag;
+	}
+
+	MemoryTagScope::~MemoryTagScope() {
+		t_memory_tag = _previous;
+	}
+
+	void* tracked_allocate(size_t size, size_t alignment, MemoryTag tag) {
+		void* memory = raw_allocate(std::max<size_t>(size, 1), alignment);
+		if (memory == nullptr) {
+			std::cerr << "Out of memory allocating " << size << " bytes!\n";
+			abort();
+		}
+
+		MemoryTracker::get().record_allocation(tag, size);
+		return memory;
+	}
+
+	void tracked_free(void* memory, size_t size, size_t alignment, MemoryTag tag) {
+		if (memory == nullptr) {
+			return;
+		}
+
+		MemoryTracker::get().record_free(tag, size);
+		raw_free(memory, alignment);
+	}
+
+	FrameArena::FrameArena(size_t capacity, MemoryTag tag)
+		: _tag(tag) {
+		if (capacity > 0) {
+			add_block(capacity);
+		}
+	}
+
+	FrameArena::~FrameArena() {
+		free_blocks(0);
+	}
+
+	void* FrameArena::allocate(size_t size, size_t alignment) {
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+		if (!_blocks.empty()) {
+			const Block& block = _blocks[_block];
+			// Blocks are only aligned to max_align_t, larger alignments are done on the address
+			const uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+			const size_t offset = align_up(base + _offset, alignment) - base;
+			if (offset + size <= block.size) {
+				_offset = offset + size;
+				_frame_peak = std::max(_frame_peak, _full_bytes + _offset);
+				return block.data + offset;
+			}
+		}
+
+		add_block(size + alignment);
+
+		const Block& block = _blocks[_block];
+		const uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+		const size_t offset = align_up(base, alignment) - base;
+		_offset = offset + size;
+		_frame_peak = std::max(_frame_peak, _full_bytes + _offset);
+		return block.data + offset;
+	}
+
+	void FrameArena::rewind(Marker marker) {
+		if (_blocks.empty()) {
+			return;
+		}
+
+		assert(marker.block < _block || (marker.block == _block && marker.offset <= _offset));
+		free_blocks(marker.block + 1);
+		_block = marker.block;
+		_offset = marker.offset;
+	}
+
+	void FrameArena::reset() {
+		_high_water = std::max(_high_water, _frame_peak);
+
+		// The frame needed more than the first block, next frame it all fits in one
+		if (!_blocks.empty() && _frame_peak > _blocks[0].size) {
+			const size_t capacity = align_up(_frame_peak, MIN_BLOCK_SIZE);
+			free_blocks(0);
+			add_block(capacity);
+		} else if (!_blocks.empty()) {
+			free_blocks(1);
+		}
+
+		_block = 0;
+		_offset = 0;
+		_frame_peak = 0;
+	}
+
+	size_t FrameArena::used() const {
+		return _blocks.empty() ? 0 : _full_bytes + _offset;
+	}
+
+	size_t FrameArena::capacity() const {
+		size_t capacity = 0;
+		for (const Block& block : _blocks) {
+			capacity += block.size;
+		}
+		return capacity;
+	}
+
+	void FrameArena::add_block(size_t min_size) {
+		// Doubling keeps the chain short when a frame needs far more than the capacity
+		size_t size = std::max(min_size, MIN_BLOCK_SIZE);
+		if (_blocks.empty()) {
+			// Chained blocks shouldn't have to grow the list. Not in the constructor, an unused arena costs nothing
+			_blocks.reserve(8);
+		} else {
+			size = std::max(size, _blocks.back().size * 2);
+			_full_bytes += _blocks.back().size;
+		}
+
+		Block block;
+		block.data = static_cast<char*>(tracked_allocate(size, alignof(std::max_align_t), _tag));
+		block.size = size;
+		_blocks.push_back(block);
+		_block = _blocks.size() - 1;
+		_offset = 0;
+	}
+
+	void FrameArena::free_blocks(size_t first) {
+		for (size_t i = first; i < _blocks.size(); ++i) {
+			tracked_free(_blocks[i].data, _blocks[i].size, alignof(std::max_align_t), _tag);
+		}
+		_blocks.resize(std::min(first, _blocks.size()));
+
+		_full_bytes = 0;
+		for (size_t i = 0; i + 1 < _blocks.size(); ++i) {
+			_full_bytes += _blocks[i].size;
+		}
+	}
+
+	PoolAllocator::PoolAllocator(size_t block_size, size_t alignment, uint32_t blocks_per_page, MemoryTag tag)
+		: _alignment(std::max(alignment, alignof(FreeBlock))), _blocks_per_page(blocks_per_page), _tag(tag) {
+		assert((alignment & (alignment - 1)) == 0 && blocks_per_page > 0);
+
+		// Every block has to hold the free list link and keep the next one aligned
+		_block_size = align_up(std::max(block_size, sizeof(FreeBlock)), _alignment);
+	}
+
+	PoolAllocator::~PoolAllocator() {
+		for (void* page : _pages) {
+			tracked_free(page, _block_size * _blocks_per_page, _alignment, _tag);
+		}
+	}
+
+	void* PoolAllocator::allocate() {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_free == nullptr) {
+			char* page = static_cast<char*>(tracked_allocate(_block_size * _blocks_per_page, _alignment, _tag));
+			_pages.push_back(page);
+
+			// Linked back to front, so blocks are handed out in address order
+			for (uint32_t i = _blocks_per_page; i-- > 0;) {
+				_free = new (page + i * _block_size) FreeBlock{ _free };
+			}
+		}
+
+		FreeBlock* block = _free;
+		_free = block->next;
+		_live_count++;
+		return block;
+	}
+
+	void PoolAllocator::free(void* block) {
+		if (block == nullptr) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_free = new (block) FreeBlock{ _free };
+		_live_count--;
+	}
+
+	uint32_t PoolAllocator::live_count() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _live_count;
+	}
+
+	uint32_t PoolAllocator::capacity() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return static_cast<uint32_t>(_pages.size()) * _blocks_per_page;
+	}
+}
+
+#ifdef DVIG_TRACK_HEAP
+// Every heap allocation of the program, counted under the allocating thread's tag.
+// A header in front of the memory keeps the size and tag, so frees are counted right from any thread.
+namespace {
+	struct HeapHeader {
+		uint64_t size = 0;
+		dvig::MemoryTag tag = dvig::MemoryTag::User;
+	};
+
+	constexpr size_t HEAP_HEADER_SIZE = 16;
+	static_assert(sizeof(HeapHeader) <= HEAP_HEADER_SIZE);
+
+	void* heap_allocate(size_t size, size_t alignment) {
+		const size_t offset = std::max(alignment, HEAP_HEADER_SIZE);
+		char* base = static_cast<char*>(dvig::raw_allocate(size + offset, std::max(alignment, alignof(std::max_align_t))));
+		if (base == nullptr) {
+			throw std::bad_alloc();
+		}
+
+		const dvig::MemoryTag tag = dvig::current_memory_tag();
+		new (base + offset - HEAP_HEADER_SIZE) HeapHeader{ size, tag };
+		dvig::MemoryTracker::get().record_allocation(tag, size);
+		return base + offset;
+	}
+
+	void heap_free(void* memory, size_t alignment) {
+		if (memory == nullptr) {
+			return;
+		}
+
+		char* header_memory = static_cast<char*>(memory) - HEAP_HEADER_SIZE;
+		const HeapHeader header = *reinterpret_cast<HeapHeader*>(header_memory);
+		dvig::MemoryTracker::get().record_free(header.tag, header.size);
+		dvig::raw_free(static_cast<char*>(memory) - std::max(alignment, HEAP_HEADER_SIZE), std::max(alignment, alignof(std::max_align_t)));
+	}
+}
+
+void* operator new(size_t size) { return heap_allocate(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return heap_allocate(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment) { return heap_allocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return heap_allocate(size, static_cast<size_t>(alignment)); }
+
+void operator delete(void* memory) noexcept { heap_free(memory, alignof(std::max_align_t)); }
+void operator delete[](void* memory) noexcept { heap_free(memory, alignof(std::max_align_t)); }
+void operator delete(void* memory, size_t) noexcept { heap_free(memory, alignof(std::max_align_t)); }
+void operator delete[](void* memory, size_t) noexcept { heap_free(memory, alignof(std::max_align_t)); }
+void operator delete(void* memory, std::align_val_t alignment) noexcept { heap_free(memory, static_cast<size_t>(alignment)); }
+void operator delete[](void* memory, std::align_val_t alignment) noexcept { heap_free(memory, static_cast<size_t>(alignment)); }
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept { heap_free(memory, static_cast<size_t>(alignment)); }
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept { heap_free(memory, static_cast<size_t>(alignment)); }
+#endif
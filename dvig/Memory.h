@@ -0,0 +1,256 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+
+namespace dvig {
+	// Subsystem an allocation is counted under
+	enum class MemoryTag : uint32_t {
+		Render,
+		Input,
+		Assets,
+		User, // Anything not inside a MemoryTagScope
+	};
+
+	constexpr uint32_t MEMORY_TAG_COUNT = 4;
+
+	const char* memory_tag_name(MemoryTag tag);
+
+	struct MemoryTagStats {
+		uint64_t live_bytes = 0;
+		uint64_t peak_bytes = 0;            // Since the start or the last reset_peaks()
+		uint64_t allocations = 0;           // Since the start
+		uint64_t frame_allocations = 0;     // In the last frame
+		uint64_t max_frame_allocations = 0; // Most in one frame since the start or the last reset_peaks()
+	};
+
+	// Counts the allocations of every tag. Lock free, any thread can allocate.
+	// Sees what goes through TrackedAllocator, FrameArena and PoolAllocator. Built with DVIG_TRACK_HEAP
+	// it also replaces the global operator new and counts every heap allocation under the calling thread's
+	// MemoryTagScope, so a steady state frame doing any allocation at all shows up in frame_allocations.
+	class MemoryTracker {
+	public:
+	#ifdef DVIG_TRACK_HEAP
+		static constexpr bool TRACKS_HEAP = true;
+	#else
+		static constexpr bool TRACKS_HEAP = false;
+	#endif
+
+		static MemoryTracker& get() {
+			static MemoryTracker tracker;
+			return tracker;
+		}
+
+		void record_allocation(MemoryTag tag, size_t size);
+		void record_free(MemoryTag tag, size_t size);
+
+		// Closes the frame's allocation counts. App::run calls it once per frame
+		void end_frame();
+
+		MemoryTagStats stats(MemoryTag tag) const;
+		// Every tag summed up. peak_bytes is the sum of the peaks, not the peak of the sum
+		MemoryTagStats total_stats() const;
+		// Starts the peaks over from the current values, e.g. once the first frames warmed everything up
+		void reset_peaks();
+
+	private:
+		struct alignas(64) TagCounters {
+			std::atomic<uint64_t> live_bytes = 0;
+			std::atomic<uint64_t> peak_bytes = 0;
+			std::atomic<uint64_t> allocations = 0;
+			// Only touched by end_frame() and the getters, on the main thread
+			uint64_t frame_start_allocations = 0;
+			uint64_t frame_allocations = 0;
+			uint64_t max_frame_allocations = 0;
+		};
+
+	private:
+		std::array<TagCounters, MEMORY_TAG_COUNT> _tags;
+	};
+
+	// Tag of the calling thread's allocations, User until a MemoryTagScope says otherwise
+	MemoryTag current_memory_tag();
+
+	// Counts the calling thread's allocations under tag until it's destroyed. Scopes nest
+	class MemoryTagScope {
+	public:
+		explicit MemoryTagScope(MemoryTag tag);
+		~MemoryTagScope();
+
+		MemoryTagScope(const MemoryTagScope&) = delete;
+		MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+	private:
+		MemoryTag _previous;
+	};
+
+	// Heap memory counted under tag, bypassing the global operator new so it's counted only once.
+	// Free with the same size, alignment and tag
+	void* tracked_allocate(size_t size, size_t alignment, MemoryTag tag);
+	void tracked_free(void* memory, size_t size, size_t alignment, MemoryTag tag);
+
+	// Standard allocator counted under TAG, for containers that stay alive
+	template<typename Type, MemoryTag TAG>
+	class TrackedAllocator {
+	public:
+		using value_type = Type;
+
+		template<typename Other>
+		struct rebind { using other = TrackedAllocator<Other, TAG>; };
+
+		TrackedAllocator() = default;
+		template<typename Other>
+		TrackedAllocator(const TrackedAllocator<Other, TAG>&) {}
+
+		Type* allocate(size_t count) {
+			return static_cast<Type*>(tracked_allocate(count * sizeof(Type), alignof(Type), TAG));
+		}
+
+		void deallocate(Type* memory, size_t count) {
+			tracked_free(memory, count * sizeof(Type), alignof(Type), TAG);
+		}
+
+		template<typename Other>
+		bool operator==(const TrackedAllocator<Other, TAG>&) const { return true; }
+		template<typename Other>
+		bool operator!=(const TrackedAllocator<Other, TAG>&) const { return false; }
+	};
+
+	template<typename Type, MemoryTag TAG>
+	using TrackedVector = std::vector<Type, TrackedAllocator<Type, TAG>>;
+
+	// Bump allocator for memory that only lives until the end of the frame. Allocating is an add and a compare,
+	// reset() drops everything at once without running destructors, so only trivially destructible types go in.
+	// Past the capacity it chains heap blocks (counted as allocations), and the next reset() replaces them
+	// with one block as large as the frame needed, so after a few frames a steady state doesn't touch the heap.
+	// Only on one thread, jobs can fill memory allocated before they were queued.
+	class FrameArena {
+	public:
+		static constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+		// Where mark() was, for rewind()
+		struct Marker {
+			size_t block = 0;
+			size_t offset = 0;
+		};
+
+		// capacity 0 allocates the first block on the first allocate()
+		explicit FrameArena(size_t capacity = 0, MemoryTag tag = MemoryTag::User);
+		~FrameArena();
+
+		FrameArena(const FrameArena&) = delete;
+		FrameArena& operator=(const FrameArena&) = delete;
+
+		// Never nullptr. alignment has to be a power of two
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		// count value initialized elements
+		template<typename Type>
+		Type* allocate_array(size_t count) {
+			static_assert(std::is_trivially_destructible_v<Type>, "reset() doesn't run destructors");
+
+			Type* array = static_cast<Type*>(allocate(sizeof(Type) * count, alignof(Type)));
+			std::uninitialized_value_construct_n(array, count);
+			return array;
+		}
+
+		template<typename Type, typename... Args>
+		Type* create(Args&&... args) {
+			static_assert(std::is_trivially_destructible_v<Type>, "reset() doesn't run destructors");
+
+			return new (allocate(sizeof(Type), alignof(Type))) Type(std::forward<Args>(args)...);
+		}
+
+		Marker mark() const { return { _block, _offset }; }
+		// Frees everything allocated since marker, blocks chained since are given back right away
+		void rewind(Marker marker);
+		// Frees everything. App calls it at the end of every frame
+		void reset();
+
+		// Bytes in use, including what's left at the end of full blocks
+		size_t used() const;
+		size_t capacity() const;
+		// Most bytes used at once since construction
+		size_t high_water() const { return std::max(_high_water, _frame_peak); }
+
+	private:
+		struct Block {
+			char* data = nullptr;
+			size_t size = 0;
+		};
+
+		void add_block(size_t min_size);
+		void free_blocks(size_t first);
+
+	private:
+		MemoryTag _tag;
+		std::vector<Block> _blocks;
+		size_t _block = 0;      // Being allocated from, always the last one
+		size_t _offset = 0;     // Into _blocks[_block]
+		size_t _full_bytes = 0; // Sizes of the blocks before _block
+		size_t _frame_peak = 0;
+		size_t _high_water = 0;
+	};
+
+	// Frees what was allocated from the arena in the scope when it ends
+	class ArenaScope {
+	public:
+		explicit ArenaScope(FrameArena& arena) : _arena(arena), _marker(arena.mark()) {}
+		~ArenaScope() { _arena.rewind(_marker); }
+
+		ArenaScope(const ArenaScope&) = delete;
+		ArenaScope& operator=(const ArenaScope&) = delete;
+
+	private:
+		FrameArena& _arena;
+		FrameArena::Marker _marker;
+	};
+
+	// Fixed size blocks carved out of pages of blocks_per_page. Freed blocks go on a free list threaded
+	// through the blocks themselves and are handed out again first, so once the pool reached its
+	// high water mark allocating and freeing don't touch the heap. Pages are only freed with the pool.
+	// Thread safe, one lock per call.
+	class PoolAllocator {
+	public:
+		PoolAllocator(size_t block_size, size_t alignment, uint32_t blocks_per_page = 256, MemoryTag tag = MemoryTag::User);
+		~PoolAllocator();
+
+		PoolAllocator(const PoolAllocator&) = delete;
+		PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+		void* allocate();
+		void free(void* block);
+
+		template<typename Type, typename... Args>
+		Type* create(Args&&... args) {
+			assert(sizeof(Type) <= _block_size && alignof(Type) <= _alignment);
+			return new (allocate()) Type(std::forward<Args>(args)...);
+		}
+
+		template<typename Type>
+		void destroy(Type* object) {
+			object->~Type();
+			free(object);
+		}
+
+		size_t block_size() const { return _block_size; }
+		uint32_t live_count() const;
+		uint32_t capacity() const;
+
+	private:
+		struct FreeBlock {
+			FreeBlock* next = nullptr;
+		};
+
+	private:
+		size_t _block_size = 0;
+		size_t _alignment = 0;
+		uint32_t _blocks_per_page = 0;
+		MemoryTag _tag;
+
+		mutable std::mutex _mutex;
+		FreeBlock* _free = nullptr;
+		std::vector<void*> _pages;
+		uint32_t _live_count = 0;
+	};
+}
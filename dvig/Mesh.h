@@ -0,0 +1,44 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "RenderBackend.h"
+
+namespace dvig {
+	// Range of a mesh's indices drawn on its own (e.g. with another material).
+	// Indices are into the vertices of the whole mesh.
+	struct SubMesh {
+		uint32_t index_start = 0;
+		uint32_t index_count = 0;
+	};
+
+	// CPU side mesh. What loaders produce and optimize_mesh works on, Renderer::create_mesh uploads it.
+	// Vertices are raw bytes so any vertex struct works, layout says what's in them.
+	struct MeshData {
+		std::vector<char> vertices;
+		uint32_t vertex_size = 0;
+		std::vector<VertexElement> layout;
+		std::vector<uint32_t> indices;  // Triangle list
+		std::vector<SubMesh> submeshes; // Don't overlap. Empty is one submesh with every index
+
+		uint32_t vertex_count() const { return vertex_size > 0 ? static_cast<uint32_t>(vertices.size() / vertex_size) : 0; }
+
+		template<typename Vertex>
+		static MeshData create(const Vertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count) {
+			MeshData mesh;
+			mesh.vertex_size = vertex_stride<Vertex>();
+			mesh.layout = vertex_elements<Vertex>();
+			mesh.vertices.resize(static_cast<size_t>(mesh.vertex_size) * vertex_count);
+			memcpy(mesh.vertices.data(), vertices, mesh.vertices.size());
+			mesh.indices.assign(indices, indices + index_count);
+			return mesh;
+		}
+	};
+
+	// GPU side, see Renderer::create_mesh, Renderer::draw_mesh and Renderer::destroy
+	struct Mesh {
+		VertexBufferHandle vertex_buffer;
+		IndexBufferHandle index_buffer; // 16 bit indices when the vertices allow it
+		std::vector<SubMesh> submeshes;   // At least one
+	};
+}
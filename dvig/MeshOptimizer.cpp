@@ -0,0 +1,410 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+namespace dvig {
+	namespace {
+		// FIFO cache with timestamps: a vertex is cached while fewer than cache_size misses happened since it was added
+		class CacheSimulator {
+		public:
+			CacheSimulator(uint32_t vertex_count, uint32_t cache_size)
+				: _cached_at(vertex_count, 0), _cache_size(cache_size), _time(cache_size + 1) {}
+
+			bool access(uint32_t vertex) {
+				if (_time - _cached_at[vertex] > _cache_size) {
+					_cached_at[vertex] = _time++;
+					return false;
+				}
+				return true;
+			}
+
+			// Everything misses afterwards
+			void flush() { _time += _cache_size + 1; }
+
+		private:
+			std::vector<uint32_t> _cached_at;
+			uint32_t _cache_size = 0;
+			uint32_t _time = 0;
+		};
+
+		uint32_t triangle_misses(CacheSimulator& cache, const uint32_t* triangle) {
+			uint32_t misses = 0;
+			for (uint32_t i = 0; i < 3; ++i) {
+				misses += cache.access(triangle[i]) ? 0 : 1;
+			}
+			return misses;
+		}
+
+		const VertexElement* find_position(const std::vector<VertexElement>& layout) {
+			for (const VertexElement& element : layout) {
+				if (std::strcmp(element.semantic, "POSITION") == 0 && element.semantic_index == 0 &&
+					(element.format == VertexFormat::Float3 || element.format == VertexFormat::Float4)) {
+					return &element;
+				}
+			}
+			return nullptr;
+		}
+	}
+
+	VertexCacheStats analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size) {
+		VertexCacheStats stats;
+		if (index_count < 3) {
+			return stats;
+		}
+
+		CacheSimulator cache(vertex_count, cache_size);
+		std::vector<bool> referenced(vertex_count, false);
+		uint32_t misses = 0;
+		uint32_t referenced_count = 0;
+
+		for (uint32_t i = 0; i < index_count; ++i) {
+			const uint32_t vertex = indices[i];
+			assert(vertex < vertex_count);
+
+			misses += cache.access(vertex) ? 0 : 1;
+			if (!referenced[vertex]) {
+				referenced[vertex] = true;
+				referenced_count++;
+			}
+		}
+
+		stats.acmr = static_cast<float>(misses) / static_cast<float>(index_count / 3);
+		stats.atvr = static_cast<float>(misses) / static_cast<float>(referenced_count);
+		return stats;
+	}
+
+	uint32_t deduplicate_vertices(MeshData& mesh) {
+		const uint32_t vertex_count = mesh.vertex_count();
+		const uint32_t vertex_size = mesh.vertex_size;
+
+		// Keys point into mesh.vertices, which is only replaced at the end
+		std::unordered_map<std::string_view, uint32_t> unique;
+		unique.reserve(vertex_count);
+
+		std::vector<uint32_t> remap(vertex_count);
+		std::vector<char> vertices;
+		vertices.reserve(mesh.vertices.size());
+
+		for (uint32_t vertex = 0; vertex < vertex_count; ++vertex) {
+			const char* data = mesh.vertices.data() + static_cast<size_t>(vertex) * vertex_size;
+			const uint32_t next = static_cast<uint32_t>(unique.size());
+
+			auto [it, inserted] = unique.try_emplace(std::string_view(data, vertex_size), next);
+			if (inserted) {
+				vertices.insert(vertices.end(), data, data + vertex_size);
+			}
+			remap[vertex] = it->second;
+		}
+
+		for (uint32_t& index : mesh.indices) {
+			index = remap[index];
+		}
+
+		const uint32_t removed = vertex_count - static_cast<uint32_t>(unique.size());
+		mesh.vertices = std::move(vertices);
+		return removed;
+	}
+
+	void optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size) {
+		assert(index_count % 3 == 0);
+		const uint32_t triangle_count = index_count / 3;
+		if (triangle_count == 0) {
+			return;
+		}
+
+		// Triangles of every vertex
+		std::vector<uint32_t> live(vertex_count, 0); // Triangles not emitted yet
+		for (uint32_t i = 0; i < index_count; ++i) {
+			assert(indices[i] < vertex_count);
+			live[indices[i]]++;
+		}
+
+		std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+		for (uint32_t vertex = 0; vertex < vertex_count; ++vertex) {
+			adjacency_offsets[vertex + 1] = adjacency_offsets[vertex] + live[vertex];
+		}
+
+		std::vector<uint32_t> adjacency(index_count);
+		{
+			std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+			for (uint32_t i = 0; i < index_count; ++i) {
+				adjacency[fill[indices[i]]++] = i / 3;
+			}
+		}
+
+		std::vector<uint32_t> cached_at(vertex_count, 0);
+		std::vector<bool> emitted(triangle_count, false);
+		std::vector<uint32_t> dead_ends; // Recently used vertices, where to continue when the fan runs out
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> result;
+		result.reserve(index_count);
+		dead_ends.reserve(index_count);
+
+		constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+		uint32_t time = cache_size + 1;
+		uint32_t cursor = 0;
+
+		auto next_live_vertex = [&]() -> uint32_t {
+			while (!dead_ends.empty()) {
+				const uint32_t vertex = dead_ends.back();
+				dead_ends.pop_back();
+				if (live[vertex] > 0) {
+					return vertex;
+				}
+			}
+
+			for (; cursor < vertex_count; ++cursor) {
+				if (live[cursor] > 0) {
+					return cursor;
+				}
+			}
+			return NONE;
+		};
+
+		uint32_t fanning = next_live_vertex();
+		while (fanning != NONE) {
+			// Emit every triangle around the fanning vertex
+			candidates.clear();
+			for (uint32_t a = adjacency_offsets[fanning]; a < adjacency_offsets[fanning + 1]; ++a) {
+				const uint32_t triangle = adjacency[a];
+				if (emitted[triangle]) {
+					continue;
+				}
+
+				for (uint32_t i = 0; i < 3; ++i) {
+					const uint32_t vertex = indices[triangle * 3 + i];
+					result.push_back(vertex);
+					dead_ends.push_back(vertex);
+					candidates.push_back(vertex);
+					live[vertex]--;
+
+					if (time - cached_at[vertex] > cache_size) {
+						cached_at[vertex] = time++;
+					}
+				}
+				emitted[triangle] = true;
+			}
+
+			// Next fan: the oldest candidate that is still cached after emitting all of its triangles
+			uint32_t best = NONE;
+			int64_t best_priority = -1;
+			for (uint32_t vertex : candidates) {
+				if (live[vertex] == 0) {
+					continue;
+				}
+
+				int64_t priority = 0;
+				const uint32_t age = time - cached_at[vertex];
+				if (age + 2 * live[vertex] <= cache_size) {
+					priority = age;
+				}
+
+				if (priority > best_priority) {
+					best_priority = priority;
+					best = vertex;
+				}
+			}
+
+			fanning = best != NONE ? best : next_live_vertex();
+		}
+
+		assert(result.size() == index_count);
+		memcpy(indices, result.data(), index_count * sizeof(uint32_t));
+	}
+
+	bool optimize_overdraw(
+		uint32_t* indices, uint32_t index_count,
+		const char* positions, uint32_t vertex_stride, uint32_t vertex_count,
+		uint32_t cache_size, float threshold
+	) {
+		const uint32_t triangle_count = index_count / 3;
+		if (triangle_count < 2) {
+			return false;
+		}
+
+		// Hard boundaries: Tipsify jumped somewhere new, every vertex of the triangle misses
+		std::vector<uint32_t> hard_starts;
+		{
+			CacheSimulator cache(vertex_count, cache_size);
+			for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+				if (triangle_misses(cache, indices + triangle * 3) == 3) {
+					hard_starts.push_back(triangle);
+				}
+			}
+		}
+		hard_starts.push_back(triangle_count);
+
+		// Soft boundaries: inside a hard cluster, split as soon as the ACMR since the last split is
+		// within threshold of the cluster's. Each split flushes the cache, which is where the threshold goes.
+		std::vector<uint32_t> cluster_starts;
+		CacheSimulator cache(vertex_count, cache_size);
+		for (size_t h = 0; h + 1 < hard_starts.size(); ++h) {
+			const uint32_t start = hard_starts[h];
+			const uint32_t end = hard_starts[h + 1];
+
+			cache.flush();
+			uint32_t cluster_misses = 0;
+			for (uint32_t triangle = start; triangle < end; ++triangle) {
+				cluster_misses += triangle_misses(cache, indices + triangle * 3);
+			}
+			const float cluster_acmr = static_cast<float>(cluster_misses) / static_cast<float>(end - start);
+
+			cache.flush();
+			cluster_starts.push_back(start);
+			uint32_t misses = 0;
+			uint32_t split = start;
+			for (uint32_t triangle = start; triangle < end; ++triangle) {
+				misses += triangle_misses(cache, indices + triangle * 3);
+
+				const float acmr = static_cast<float>(misses) / static_cast<float>(triangle + 1 - split);
+				if (acmr <= cluster_acmr * threshold && triangle + 1 < end) {
+					split = triangle + 1;
+					cluster_starts.push_back(split);
+					misses = 0;
+					cache.flush();
+				}
+			}
+		}
+		cluster_starts.push_back(triangle_count);
+
+		auto position = [&](uint32_t vertex) {
+			glm::vec3 result;
+			memcpy(&result, positions + static_cast<size_t>(vertex) * vertex_stride, sizeof(result));
+			return result;
+		};
+
+		// Area weighted centroid and normal of every cluster. Normals are (b - a) x (c - a)
+		struct Cluster {
+			uint32_t start = 0;
+			uint32_t end = 0;
+			float sort_key = 0;
+		};
+
+		const size_t cluster_count = cluster_starts.size() - 1;
+		std::vector<Cluster> clusters(cluster_count);
+		std::vector<glm::vec3> centroids(cluster_count);
+		std::vector<glm::vec3> normals(cluster_count);
+
+		glm::vec3 mesh_centroid(0.0f);
+		float mesh_area = 0;
+		for (size_t c = 0; c < cluster_count; ++c) {
+			clusters[c].start = cluster_starts[c];
+			clusters[c].end = cluster_starts[c + 1];
+
+			glm::vec3 centroid(0.0f);
+			glm::vec3 normal(0.0f);
+			float area = 0;
+			for (uint32_t triangle = clusters[c].start; triangle < clusters[c].end; ++triangle) {
+				const glm::vec3 a = position(indices[triangle * 3 + 0]);
+				const glm::vec3 b = position(indices[triangle * 3 + 1]);
+				const glm::vec3 p = position(indices[triangle * 3 + 2]);
+
+				const glm::vec3 cross = glm::cross(b - a, p - a);
+				const float triangle_area = glm::length(cross) * 0.5f;
+				centroid += (a + b + p) * (triangle_area / 3.0f);
+				normal += cross;
+				area += triangle_area;
+			}
+
+			mesh_centroid += centroid;
+			mesh_area += area;
+			centroids[c] = area > 0 ? centroid / area : centroid;
+			normals[c] = normal;
+		}
+
+		if (mesh_area > 0) {
+			mesh_centroid /= mesh_area;
+		}
+
+		for (size_t c = 0; c < cluster_count; ++c) {
+			const float length = glm::length(normals[c]);
+			clusters[c].sort_key = length > 0 ? glm::dot(centroids[c] - mesh_centroid, normals[c] / length) : 0.0f;
+		}
+
+		// Outward facing first, they are the likely occluders
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+			return a.sort_key > b.sort_key;
+		});
+
+		std::vector<uint32_t> result;
+		result.reserve(index_count);
+		for (const Cluster& cluster : clusters) {
+			result.insert(result.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+		}
+
+		// Clusters also shared vertices with their neighbours. When the input order wasn't coherent
+		// (e.g. vertices in random order) losing that costs more than the threshold, keep the input then
+		const float acmr_before = analyze_vertex_cache(indices, index_count, vertex_count, cache_size).acmr;
+		const float acmr_after = analyze_vertex_cache(result.data(), index_count, vertex_count, cache_size).acmr;
+		if (acmr_after > acmr_before * threshold) {
+			return false;
+		}
+
+		memcpy(indices, result.data(), triangle_count * 3 * sizeof(uint32_t));
+		return true;
+	}
+
+	uint32_t optimize_vertex_fetch(MeshData& mesh) {
+		constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+		const uint32_t vertex_size = mesh.vertex_size;
+
+		std::vector<uint32_t> remap(mesh.vertex_count(), UNUSED);
+		std::vector<char> vertices;
+		vertices.reserve(mesh.vertices.size());
+
+		uint32_t vertex_count = 0;
+		for (uint32_t& index : mesh.indices) {
+			if (remap[index] == UNUSED) {
+				const char* data = mesh.vertices.data() + static_cast<size_t>(index) * vertex_size;
+				vertices.insert(vertices.end(), data, data + vertex_size);
+				remap[index] = vertex_count++;
+			}
+			index = remap[index];
+		}
+
+		mesh.vertices = std::move(vertices);
+		return vertex_count;
+	}
+
+	MeshOptimizeStats optimize_mesh(MeshData& mesh, const MeshOptimizeOptions& options) {
+		assert(mesh.vertex_size > 0 && mesh.indices.size() % 3 == 0);
+
+		MeshOptimizeStats stats;
+		stats.vertices_before = mesh.vertex_count();
+		stats.cache_before = analyze_vertex_cache(mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), mesh.vertex_count(), options.cache_size);
+
+		if (options.deduplicate) {
+			deduplicate_vertices(mesh);
+		}
+
+		std::vector<SubMesh> submeshes = mesh.submeshes;
+		if (submeshes.empty()) {
+			submeshes.push_back({ 0, static_cast<uint32_t>(mesh.indices.size()) });
+		}
+
+		const VertexElement* position = options.overdraw ? find_position(mesh.layout) : nullptr;
+		for (const SubMesh& submesh : submeshes) {
+			assert(submesh.index_start % 3 == 0 && submesh.index_count % 3 == 0);
+			uint32_t* indices = mesh.indices.data() + submesh.index_start;
+
+			if (options.vertex_cache) {
+				optimize_vertex_cache(indices, submesh.index_count, mesh.vertex_count(), options.cache_size);
+			}
+
+			if (position != nullptr) {
+				stats.overdraw_sorted |= optimize_overdraw(
+					indices, submesh.index_count,
+					mesh.vertices.data() + position->offset, mesh.vertex_size, mesh.vertex_count(),
+					options.cache_size, options.overdraw_threshold
+				);
+			}
+		}
+
+		if (options.vertex_fetch) {
+			optimize_vertex_fetch(mesh);
+		}
+
+		stats.vertices_after = mesh.vertex_count();
+		stats.cache_after = analyze_vertex_cache(mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), mesh.vertex_count(), options.cache_size);
+		return stats;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "pch.h"
+
+#include "Mesh.h"
+
+namespace dvig {
+	// Nothing here needs a GPU, meshes can be optimized offline or right after loading.
+	// Every pass keeps triangles inside their submesh.
+
+	struct MeshOptimizeOptions {
+		bool deduplicate = true;  // Merge bitwise equal vertices
+		bool vertex_cache = true; // Tipsify triangle order for the post transform cache
+		// Outward facing clusters first. Needs a Float3/Float4 POSITION. Float2 ones (Vertex2D) are skipped:
+		// a flat mesh has no outside to sort by, what overlaps draws in triangle order
+		bool overdraw = true;
+		bool vertex_fetch = true; // Vertices in first use order, unused ones are dropped
+		uint32_t cache_size = 16; // Cache the order is tuned for and ACMR is measured with
+		float overdraw_threshold = 1.05f; // How much worse than the vertex cache order the overdraw order may get
+	};
+
+	struct VertexCacheStats {
+		float acmr = 0; // Cache misses per triangle. 3 is the worst, ~0.5 the best for big regular meshes
+		float atvr = 0; // Cache misses per referenced vertex. 1 is the best
+	};
+
+	struct MeshOptimizeStats {
+		uint32_t vertices_before = 0;
+		uint32_t vertices_after = 0;
+		VertexCacheStats cache_before;
+		VertexCacheStats cache_after;
+		bool overdraw_sorted = false; // At least one submesh
+	};
+
+	// Simulates a FIFO post transform cache of cache_size vertices
+	VertexCacheStats analyze_vertex_cache(const uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size);
+
+	// Returns the number of vertices removed. Compares raw bytes, so padding has to be zeroed
+	// (VertexLayout doesn't allow padding anyway)
+	uint32_t deduplicate_vertices(MeshData& mesh);
+
+	// Tipsify (Sander, Nehab, Barczak 2007). Linear in the triangle count
+	void optimize_vertex_cache(uint32_t* indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size);
+
+	// Splits vertex cache optimized indices into clusters and draws the ones facing out of the mesh first.
+	// Run it after optimize_vertex_cache with the same cache_size. positions has vertex_stride bytes per vertex.
+	// Leaves the indices alone and returns false when it would make ACMR worse than threshold times the input's
+	bool optimize_overdraw(
+		uint32_t* indices, uint32_t index_count,
+		const char* positions, uint32_t vertex_stride, uint32_t vertex_count,
+		uint32_t cache_size, float threshold
+	);
+
+	// Returns the new vertex count
+	uint32_t optimize_vertex_fetch(MeshData& mesh);
+
+	// Runs the passes in options on every submesh
+	MeshOptimizeStats optimize_mesh(MeshData& mesh, const MeshOptimizeOptions& options = {});
+}
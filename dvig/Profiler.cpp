@@ -0,0 +1,196 @@
+#include "pch.h"
+#include "Profiler.h"
+
+namespace dvig {
+	void Profiler::record(const char* name, int64_t start_ns, int64_t end_ns) {
+		if (!thread_ring().ring.push({ name, start_ns, end_ns })) {
+			_dropped_events.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void Profiler::record_gpu(const char* name, int64_t start_ns, int64_t end_ns) {
+		if (!_gpu_ring.ring.push({ name, start_ns, end_ns })) {
+			_dropped_events.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void Profiler::set_thread_name(const char* name) {
+		ThreadRing& ring = thread_ring();
+
+		std::lock_guard<std::mutex> lock(_rings_mutex);
+		ring.name = name;
+	}
+
+	Profiler::ThreadRing& Profiler::thread_ring() {
+		thread_local ThreadRing* ring = nullptr;
+		if (ring == nullptr) {
+			std::lock_guard<std::mutex> lock(_rings_mutex);
+			_rings.push_back(std::make_unique<ThreadRing>());
+			ring = _rings.back().get();
+			ring->thread_id = static_cast<uint32_t>(_rings.size()); // 0 is the GPU
+			ring->name = "Thread " + std::to_string(ring->thread_id);
+		}
+
+		return *ring;
+	}
+
+	void Profiler::end_frame() {
+		{
+			std::lock_guard<std::mutex> lock(_rings_mutex);
+			for (Unique<ThreadRing>& ring : _rings) {
+				const uint32_t thread_id = ring->thread_id;
+				ring->ring.drain([&](const ProfileEvent& event) { add_event(event, thread_id); });
+			}
+		}
+
+		_gpu_ring.ring.drain([&](const ProfileEvent& event) { add_event(event, GPU_THREAD_ID); });
+	}
+
+	void Profiler::add_event(const ProfileEvent& event, uint32_t thread_id) {
+		auto& histories = thread_id == GPU_THREAD_ID ? _gpu_history : _cpu_history;
+		ScopeHistory& history = histories[event.name];
+		history.durations_ms[history.count % HISTORY_SIZE] = static_cast<float>(static_cast<double>(event.end_ns - event.start_ns) * 1e-6);
+		history.count++;
+
+		if (_capturing) {
+			if (_capture.size() < _max_capture_events) {
+				_capture.push_back({ event, thread_id });
+			} else {
+				_capturing = false;
+			}
+		}
+	}
+
+	void Profiler::start_capture(uint32_t max_events) {
+		_capture.clear();
+		_capture.reserve(std::min<uint32_t>(max_events, 65536));
+		_max_capture_events = max_events;
+		_capturing = true;
+	}
+
+	void Profiler::stop_capture() {
+		_capturing = false;
+	}
+
+	std::string Profiler::chrome_trace_json() const {
+		// Names are usually literals, but a quote would still break the file
+		auto append_escaped = [](std::string& out, std::string_view string) {
+			for (char c : string) {
+				if (c == '"' || c == '\\') {
+					out += '\\';
+				}
+				out += c;
+			}
+		};
+
+		int64_t first_ns = std::numeric_limits<int64_t>::max();
+		for (const CapturedEvent& captured : _capture) {
+			first_ns = std::min(first_ns, captured.event.start_ns);
+		}
+
+		std::string json;
+		json.reserve(_capture.size() * 96 + 256);
+		json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+		json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+		{
+			std::lock_guard<std::mutex> lock(_rings_mutex);
+			for (const Unique<ThreadRing>& ring : _rings) {
+				json += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":";
+				json += std::to_string(ring->thread_id);
+				json += ",\"args\":{\"name\":\"";
+				append_escaped(json, ring->name);
+				json += "\"}}";
+			}
+		}
+
+		// Complete events, timestamps in microseconds
+		char number[32];
+		for (const CapturedEvent& captured : _capture) {
+			json += ",\n{\"name\":\"";
+			append_escaped(json, captured.event.name);
+			json += "\",\"cat\":\"";
+			json += captured.thread_id == GPU_THREAD_ID ? "gpu" : "cpu";
+			json += "\",\"ph\":\"X\",\"pid\":0,\"tid\":";
+			json += std::to_string(captured.thread_id);
+
+			snprintf(number, sizeof(number), "%.3f", static_cast<double>(captured.event.start_ns - first_ns) * 1e-3);
+			json += ",\"ts\":";
+			json += number;
+
+			snprintf(number, sizeof(number), "%.3f", static_cast<double>(captured.event.end_ns - captured.event.start_ns) * 1e-3);
+			json += ",\"dur\":";
+			json += number;
+			json += "}";
+		}
+
+		json += "\n]}\n";
+		return json;
+	}
+
+	bool Profiler::write_chrome_trace(const std::filesystem::path& path) const {
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+
+		const std::string json = chrome_trace_json();
+		file.write(json.data(), json.size());
+		return file.good();
+	}
+
+	std::vector<ProfileScopeStats> Profiler::stats() const {
+		std::vector<ProfileScopeStats> result;
+		std::vector<float> window;
+
+		auto add_stats = [&](const std::unordered_map<std::string_view, ScopeHistory>& histories, bool gpu) {
+			const size_t first = result.size();
+			for (const auto& [name, history] : histories) {
+				if (history.count == 0) {
+					continue;
+				}
+
+				const uint32_t samples = std::min(history.count, HISTORY_SIZE);
+				window.assign(history.durations_ms.begin(), history.durations_ms.begin() + samples);
+
+				ProfileScopeStats stats;
+				stats.name = std::string(name);
+				stats.gpu = gpu;
+				stats.samples = samples;
+				stats.last_ms = history.durations_ms[(history.count - 1) % HISTORY_SIZE];
+
+				double sum = 0;
+				stats.min_ms = window[0];
+				for (float duration : window) {
+					sum += duration;
+					stats.min_ms = std::min(stats.min_ms, static_cast<double>(duration));
+				}
+				stats.avg_ms = sum / samples;
+
+				// Nearest rank
+				const size_t rank = static_cast<size_t>(std::ceil(0.99 * samples)) - 1;
+				std::nth_element(window.begin(), window.begin() + rank, window.end());
+				stats.p99_ms = window[rank];
+
+				result.push_back(std::move(stats));
+			}
+
+			std::sort(result.begin() + first, result.end(), [](const ProfileScopeStats& a, const ProfileScopeStats& b) {
+				return a.name < b.name;
+			});
+		};
+
+		add_stats(_cpu_history, false);
+		add_stats(_gpu_history, true);
+		return result;
+	}
+
+	void Profiler::reset() {
+		end_frame(); // Empties the rings
+		_cpu_history.clear();
+		_gpu_history.clear();
+		_capture.clear();
+		_capturing = false;
+		_dropped_events.store(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "FrameTiming.h"
+
+namespace dvig {
+	// name has to outlive the profiler, use string literals
+	struct ProfileEvent {
+		const char* name = "";
+		int64_t start_ns = 0;
+		int64_t end_ns = 0;
+	};
+
+	// Events of one thread. Single producer (the owning thread), single consumer (Profiler::end_frame),
+	// so pushing is two atomics and a copy. When the ring is full new events are dropped.
+	class ProfileRing {
+	public:
+		static constexpr uint32_t CAPACITY = 4096; // Power of two
+
+		bool push(const ProfileEvent& event) {
+			const uint32_t write = _write.load(std::memory_order_relaxed);
+			if (write - _read.load(std::memory_order_acquire) >= CAPACITY) {
+				return false;
+			}
+
+			_events[write & (CAPACITY - 1)] = event;
+			_write.store(write + 1, std::memory_order_release);
+			return true;
+		}
+
+		template<typename Function>
+		void drain(Function function) {
+			uint32_t read = _read.load(std::memory_order_relaxed);
+			const uint32_t write = _write.load(std::memory_order_acquire);
+			for (; read != write; ++read) {
+				function(_events[read & (CAPACITY - 1)]);
+			}
+			_read.store(read, std::memory_order_release);
+		}
+
+	private:
+		std::array<ProfileEvent, CAPACITY> _events;
+		alignas(64) std::atomic<uint32_t> _write = 0;
+		alignas(64) std::atomic<uint32_t> _read = 0;
+	};
+
+	struct ProfileScopeStats {
+		std::string name;
+		bool gpu = false;
+		uint32_t samples = 0; // In the rolling window, up to Profiler::HISTORY_SIZE
+		double last_ms = 0;
+		double min_ms = 0;
+		double avg_ms = 0;
+		double p99_ms = 0;
+	};
+
+	// Collects CPU scopes from every thread plus GPU timings from the backend.
+	// Threads only ever touch their own ring, everything else happens in end_frame() on the main thread.
+	// Disabled it costs one relaxed atomic load per scope. Build with DVIG_DISABLE_PROFILER to remove scopes completely.
+	class Profiler {
+	public:
+		static constexpr uint32_t HISTORY_SIZE = 256; // Samples per scope for the rolling stats
+		static constexpr uint32_t GPU_THREAD_ID = 0;  // Thread id of GPU events in the trace, CPU threads start at 1
+
+		static Profiler& get() {
+			static Profiler profiler;
+			return profiler;
+		}
+
+		void set_enabled(bool enabled) { _enabled.store(enabled, std::memory_order_relaxed); }
+		bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+		// Into the calling thread's ring
+		void record(const char* name, int64_t start_ns, int64_t end_ns);
+		// Called by the backend on the render thread, start/end already converted to the CPU clock
+		void record_gpu(const char* name, int64_t start_ns, int64_t end_ns);
+		// Shows up as the thread name in the trace
+		void set_thread_name(const char* name);
+
+		// Drains every ring into the rolling stats and the capture. App::run calls it once per frame
+		void end_frame();
+
+		// Keeps the events of the next frames, up to max_events, for write_chrome_trace()
+		void start_capture(uint32_t max_events = 1'000'000);
+		void stop_capture();
+		bool capturing() const { return _capturing; }
+
+		// Chrome trace event format, open with chrome://tracing or ui.perfetto.dev
+		std::string chrome_trace_json() const;
+		bool write_chrome_trace(const std::filesystem::path& path) const;
+
+		// Sorted by name, CPU scopes first
+		std::vector<ProfileScopeStats> stats() const;
+		uint64_t dropped_event_count() const { return _dropped_events.load(std::memory_order_relaxed); }
+		void reset();
+
+	private:
+		struct ThreadRing {
+			ProfileRing ring;
+			uint32_t thread_id = 0;
+			std::string name;
+		};
+
+		struct ScopeHistory {
+			std::array<float, HISTORY_SIZE> durations_ms = {};
+			uint32_t count = 0; // Total samples, the window is the last HISTORY_SIZE
+		};
+
+		struct CapturedEvent {
+			ProfileEvent event;
+			uint32_t thread_id = 0;
+		};
+
+		ThreadRing& thread_ring();
+		void add_event(const ProfileEvent& event, uint32_t thread_id);
+
+	private:
+		std::atomic<bool> _enabled = false;
+		std::atomic<uint64_t> _dropped_events = 0;
+
+		// Rings are never freed, a thread_local pointer to them stays valid after the thread exits
+		mutable std::mutex _rings_mutex;
+		std::vector<Unique<ThreadRing>> _rings;
+		ThreadRing _gpu_ring;
+
+		// Only touched by end_frame() and the getters, on the main thread
+		std::unordered_map<std::string_view, ScopeHistory> _cpu_history;
+		std::unordered_map<std::string_view, ScopeHistory> _gpu_history;
+		std::vector<CapturedEvent> _capture;
+		uint32_t _max_capture_events = 0;
+		bool _capturing = false;
+	};
+
+	// Records the time between construction and destruction
+	class ProfileScope {
+	public:
+		explicit ProfileScope(const char* name) {
+			if (Profiler::get().enabled()) {
+				_name = name;
+				_start_ns = steady_clock_now();
+			}
+		}
+
+		~ProfileScope() {
+			if (_name != nullptr) {
+				Profiler::get().record(_name, _start_ns, steady_clock_now());
+			}
+		}
+
+		ProfileScope(const ProfileScope&) = delete;
+		ProfileScope& operator=(const ProfileScope&) = delete;
+
+	private:
+		const char* _name = nullptr;
+		int64_t _start_ns = 0;
+	};
+}
+
+#define DVIG_PROFILE_CONCAT_INNER(a, b) a##b
+#define DVIG_PROFILE_CONCAT(a, b) DVIG_PROFILE_CONCAT_INNER(a, b)
+
+#ifndef DVIG_DISABLE_PROFILER
+#define DVIG_PROFILE_SCOPE(name) ::dvig::ProfileScope DVIG_PROFILE_CONCAT(_profile_scope_, __LINE__)(name)
+#else
+#define DVIG_PROFILE_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,240 @@
+#include "pch.h"
+#include "QuadBatch.h"
+#include "VertexKernels.h"
+
+namespace dvig {
+	uint32_t pack_color_rgba8(const glm::vec4& color) {
+		auto to_byte = [](float value) -> uint32_t {
+			value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+			return static_cast<uint32_t>(value * 255.0f + 0.5f);
+		};
+
+		return to_byte(color.x) | (to_byte(color.y) << 8) | (to_byte(color.z) << 16) | (to_byte(color.w) << 24);
+	}
+
+	QuadBatcher::QuadBatcher(uint32_t max_quads) : _max_quads(max_quads) {
+		assert(max_quads > 0);
+		_vertices.resize(max_vertices());
+		_ranges.reserve(64);
+	}
+
+	void QuadBatcher::set_state(uint64_t state) {
+		if (state == _state) {
+			return;
+		}
+
+		// NOTE: The range itself is opened lazily on the next quad,
+		//       so switching back and forth without drawing costs nothing.
+		_stats.state_changes++;
+		_state = state;
+	}
+
+	void QuadBatcher::push_quad(
+		glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, glm::vec2 p4,
+		const glm::vec4& color,
+		const glm::mat4& transform
+	) {
+		const glm::vec2 corners[4] = {
+			glm::vec2(transform * glm::vec4(p1, 0, 1)),
+			glm::vec2(transform * glm::vec4(p2, 0, 1)),
+			glm::vec2(transform * glm::vec4(p3, 0, 1)),
+			glm::vec2(transform * glm::vec4(p4, 0, 1)),
+		};
+
+		push_quad(corners, color);
+	}
+
+	void QuadBatcher::push_quad(const glm::vec2 corners[4], const glm::vec4& color) {
+		push_quad(corners, pack_color_rgba8(color));
+	}
+
+	void QuadBatcher::push_quad(const glm::vec2 corners[4], uint32_t color) {
+		BatchVertex2D* vertices = reserve_quad();
+
+		vertices[0] = { corners[0], color };
+		vertices[1] = { corners[1], color };
+		vertices[2] = { corners[2], color };
+		vertices[3] = { corners[3], color };
+
+		_stats.quads++;
+	}
+
+	void QuadBatcher::push_quads(const QuadInstances& quads, uint32_t count, glm::vec2 origin, const glm::mat4& transform) {
+		QuadInstances rest = quads;
+		while (count > 0) {
+			BatchVertex2D* vertices = nullptr;
+			const uint32_t reserved = reserve_quads(count, vertices);
+			expand_quads(rest, reserved, origin, transform, vertices);
+
+			rest.x += reserved;
+			rest.y += reserved;
+			rest.width += reserved;
+			rest.height += reserved;
+			rest.color += reserved;
+			if (rest.rotation != nullptr) {
+				rest.rotation += reserved;
+			}
+
+			count -= reserved;
+			_stats.quads += reserved;
+		}
+	}
+
+	void QuadBatcher::flush() {
+		if (empty()) {
+			return;
+		}
+
+		if (_sink) {
+			_sink->submit_batch(_vertices.data(), _vertex_count, _ranges.data(), static_cast<uint32_t>(_ranges.size()));
+		}
+
+		_stats.flushes++;
+		_stats.draw_calls += static_cast<uint32_t>(_ranges.size());
+		_stats.bytes_uploaded += static_cast<uint64_t>(_vertex_count) * sizeof(BatchVertex2D);
+
+		_vertex_count = 0;
+		_ranges.clear();
+	}
+
+	BatchVertex2D* QuadBatcher::reserve_quad() {
+		BatchVertex2D* result = nullptr;
+		reserve_quads(1, result);
+		return result;
+	}
+
+	uint32_t QuadBatcher::reserve_quads(uint32_t count, BatchVertex2D*& vertices) {
+		if (_vertex_count + VERTICES_PER_QUAD > max_vertices()) {
+			flush();
+		}
+
+		if (_ranges.empty() || _ranges.back().state != _state) {
+			BatchRange range;
+			range.state = _state;
+			range.index_start = _vertex_count / VERTICES_PER_QUAD * INDICES_PER_QUAD;
+			_ranges.push_back(range);
+		}
+
+		const uint32_t reserved = std::min(count, (max_vertices() - _vertex_count) / VERTICES_PER_QUAD);
+		_ranges.back().index_count += reserved * INDICES_PER_QUAD;
+
+		vertices = _vertices.data() + _vertex_count;
+		_vertex_count += reserved * VERTICES_PER_QUAD;
+		return reserved;
+	}
+
+	RectBatcher::RectBatcher(uint32_t max_instances) : _max_instances(max_instances) {
+		assert(max_instances > 0);
+		_instances.resize(max_instances);
+	}
+
+	void RectBatcher::push_rect(const RectInstance& instance, const glm::mat4& view_projection) {
+		if (!empty() && view_projection != _view_projection) {
+			flush();
+			_stats.state_changes++;
+		}
+
+		if (_instance_count == _max_instances) {
+			flush();
+		}
+
+		_view_projection = view_projection;
+		_instances[_instance_count++] = instance;
+		_stats.quads++;
+	}
+
+	void RectBatcher::flush() {
+		if (empty()) {
+			return;
+		}
+
+		if (_sink) {
+			_sink->submit_instances(_instances.data(), _instance_count, _view_projection);
+		}
+
+		_stats.flushes++;
+		_stats.draw_calls++;
+		_stats.bytes_uploaded += static_cast<uint64_t>(_instance_count) * sizeof(RectInstance) + sizeof(glm::mat4);
+
+		_instance_count = 0;
+	}
+
+	TextBatcher::TextBatcher(uint32_t max_quads) : _max_quads(max_quads) {
+		assert(max_quads > 0);
+		_vertices.resize(static_cast<size_t>(max_quads) * QuadBatcher::VERTICES_PER_QUAD);
+	}
+
+	void TextBatcher::push_quad(
+		const Shared<Texture2D>& texture, float distance_range,
+		const glm::vec2 corners[4], glm::vec2 uv_min, glm::vec2 uv_max,
+		uint32_t color
+	) {
+		if (_quad_count == _max_quads) {
+			flush();
+		}
+
+		if (_last_bucket >= _bucket_count
+			|| _buckets[_last_bucket].texture != texture
+			|| _buckets[_last_bucket].distance_range != distance_range) {
+			uint32_t bucket = 0;
+			while (bucket < _bucket_count && (_buckets[bucket].texture != texture || _buckets[bucket].distance_range != distance_range)) {
+				bucket++;
+			}
+
+			if (bucket == _bucket_count) {
+				if (_bucket_count == _buckets.size()) {
+					_buckets.emplace_back();
+				}
+				_buckets[bucket].texture = texture;
+				_buckets[bucket].distance_range = distance_range;
+				_bucket_count++;
+				_stats.state_changes++;
+			}
+			_last_bucket = bucket;
+		}
+
+		std::vector<TextVertex2D>& vertices = _buckets[_last_bucket].vertices;
+		vertices.push_back({ corners[0], uv_min, color });
+		vertices.push_back({ corners[1], glm::vec2(uv_max.x, uv_min.y), color });
+		vertices.push_back({ corners[2], glm::vec2(uv_min.x, uv_max.y), color });
+		vertices.push_back({ corners[3], uv_max, color });
+
+		_quad_count++;
+		_stats.quads++;
+	}
+
+	void TextBatcher::flush() {
+		if (empty()) {
+			return;
+		}
+
+		uint32_t vertex_count = 0;
+		for (uint32_t i = 0; i < _bucket_count; ++i) {
+			Bucket& bucket = _buckets[i];
+
+			TextRange range;
+			range.texture = std::move(bucket.texture);
+			range.distance_range = bucket.distance_range;
+			range.index_start = vertex_count / QuadBatcher::VERTICES_PER_QUAD * QuadBatcher::INDICES_PER_QUAD;
+			range.index_count = static_cast<uint32_t>(bucket.vertices.size()) / QuadBatcher::VERTICES_PER_QUAD * QuadBatcher::INDICES_PER_QUAD;
+			_ranges.push_back(std::move(range));
+
+			memcpy(_vertices.data() + vertex_count, bucket.vertices.data(), bucket.vertices.size() * sizeof(TextVertex2D));
+			vertex_count += static_cast<uint32_t>(bucket.vertices.size());
+			bucket.vertices.clear();
+		}
+
+		if (_sink) {
+			_sink->submit_text(_vertices.data(), vertex_count, _ranges.data(), static_cast<uint32_t>(_ranges.size()));
+		}
+
+		_stats.flushes++;
+		_stats.draw_calls += static_cast<uint32_t>(_ranges.size());
+		_stats.bytes_uploaded += static_cast<uint64_t>(vertex_count) * sizeof(TextVertex2D);
+
+		_quad_count = 0;
+		_bucket_count = 0;
+		_last_bucket = 0;
+		_ranges.clear();
+	}
+}
@@ -0,0 +1,290 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "VertexLayout.h"
+
+namespace dvig {
+	struct Texture2D;
+	struct QuadInstances;
+
+	// Vertex used by the batched 2D path.
+	// Positions are transformed on the CPU so the shader only passes them through.
+	// NOTE: Only xy of the transformed position is kept, so the transform has to be
+	//       affine (e.g. orthographic projection). That's all the 2D path needs for now.
+	struct BatchVertex2D {
+		glm::vec2 pos;
+		uint32_t color = 0; // RGBA8, R in the lowest byte
+	};
+
+	static_assert(sizeof(BatchVertex2D) == 12, "BatchVertex2D has to stay 12 bytes");
+
+	template<> struct VertexLayout<BatchVertex2D> {
+		static constexpr std::array attributes = {
+			DVIG_VERTEX_ATTRIBUTE(BatchVertex2D, pos, "POSITION"),
+			DVIG_VERTEX_ATTRIBUTE_FORMAT(BatchVertex2D, color, "COLOR", VertexFormat::RGBA8_UNorm),
+		};
+	};
+
+	// Indices [index_start, index_start + index_count) share the same state
+	// and can be drawn with a single indexed draw call.
+	struct BatchRange {
+		uint64_t state = 0;
+		uint32_t index_start = 0;
+		uint32_t index_count = 0;
+	};
+
+	struct BatchStats {
+		uint32_t quads = 0;
+		uint32_t flushes = 0;
+		uint32_t draw_calls = 0;
+		uint32_t state_changes = 0;
+		uint64_t bytes_uploaded = 0;
+	};
+
+	// Compact per instance data for the instanced rect path. 32 bytes vs 80 for UniformVertex2D.
+	// The unit quad is scaled by size around origin (0..1 in rect space), rotated and moved to pos.
+	struct RectInstance {
+		glm::vec2 pos;
+		glm::vec2 size;
+		glm::vec2 origin;
+		float rotation = 0; // Radians
+		uint32_t color = 0; // RGBA8, R in the lowest byte (DXGI_FORMAT_R8G8B8A8_UNORM)
+	};
+
+	static_assert(sizeof(RectInstance) == 32, "RectInstance has to stay 32 bytes");
+
+	template<> struct VertexLayout<RectInstance> {
+		static constexpr std::array attributes = {
+			DVIG_VERTEX_ATTRIBUTE(RectInstance, pos, "INSTANCE_POS"),
+			DVIG_VERTEX_ATTRIBUTE(RectInstance, size, "INSTANCE_SIZE"),
+			DVIG_VERTEX_ATTRIBUTE(RectInstance, origin, "INSTANCE_ORIGIN"),
+			DVIG_VERTEX_ATTRIBUTE(RectInstance, rotation, "INSTANCE_ROTATION"),
+			DVIG_VERTEX_ATTRIBUTE_FORMAT(RectInstance, color, "INSTANCE_COLOR", VertexFormat::RGBA8_UNorm),
+		};
+	};
+
+	// Vertex of the batched text path. Positions are transformed on the CPU like BatchVertex2D.
+	// The color is straight alpha, the shader premultiplies it once the distance field gave the coverage
+	struct TextVertex2D {
+		glm::vec2 pos;
+		glm::vec2 uv;
+		uint32_t color = 0; // RGBA8, R in the lowest byte
+	};
+
+	static_assert(sizeof(TextVertex2D) == 20, "TextVertex2D has to stay 20 bytes");
+
+	template<> struct VertexLayout<TextVertex2D> {
+		static constexpr std::array attributes = {
+			DVIG_VERTEX_ATTRIBUTE(TextVertex2D, pos, "POSITION"),
+			DVIG_VERTEX_ATTRIBUTE(TextVertex2D, uv, "TEXCOORD"),
+			DVIG_VERTEX_ATTRIBUTE_FORMAT(TextVertex2D, color, "COLOR", VertexFormat::RGBA8_UNorm),
+		};
+	};
+
+	// Glyphs of one distance field page, drawn with a single indexed draw
+	struct TextRange {
+		Shared<Texture2D> texture;
+		float distance_range = 0.0f; // Texels the distance field goes from 0 to 1 over
+		uint32_t index_start = 0;
+		uint32_t index_count = 0;
+	};
+
+	uint32_t pack_color_rgba8(const glm::vec4& color);
+
+	// Receives a full batch on flush: one upload for all the vertices and one draw per range.
+	// Ranges index into the static QuadBatcher::make_indices() buffer.
+	// Renderer implements it for D3D11. Headless builds can implement it to
+	// count flushes and bytes without a GPU.
+	class BatchSink {
+	public:
+		virtual ~BatchSink() = default;
+
+		virtual void submit_batch(
+			const BatchVertex2D* vertices, uint32_t vertex_count,
+			const BatchRange* ranges, uint32_t range_count
+		) = 0;
+	};
+
+	// Receives instanced rects on flush: one instance upload and one instanced draw.
+	class InstanceSink {
+	public:
+		virtual ~InstanceSink() = default;
+
+		virtual void submit_instances(
+			const RectInstance* instances, uint32_t instance_count,
+			const glm::mat4& view_projection
+		) = 0;
+	};
+
+	// Receives the text of a flush: one upload for all the vertices and one draw per page.
+	// Ranges index into the same static index buffer as BatchSink's.
+	class TextSink {
+	public:
+		virtual ~TextSink() = default;
+
+		virtual void submit_text(
+			const TextVertex2D* vertices, uint32_t vertex_count,
+			const TextRange* ranges, uint32_t range_count
+		) = 0;
+	};
+
+	// Collects quads into a CPU side vertex array, 4 vertices per quad.
+	// The indices never change, the sink draws them from a static index buffer.
+	// Flushes to the sink when the array is full or when flush() is called (end of frame).
+	// Changing the state only closes the current range, so a frame is still
+	// uploaded with one Map and drawn with one draw call per state run.
+	class QuadBatcher {
+	public:
+		static constexpr uint32_t VERTICES_PER_QUAD = 4;
+		static constexpr uint32_t INDICES_PER_QUAD = 6;
+		static constexpr uint32_t DEFAULT_MAX_QUADS = 10000;
+
+		QuadBatcher(uint32_t max_quads = DEFAULT_MAX_QUADS);
+
+		void set_sink(BatchSink* sink) { _sink = sink; }
+
+		// State is opaque to the batcher. The sink decides what it means (shader, texture...)
+		void set_state(uint64_t state);
+		uint64_t state() const { return _state; }
+
+		// Triangles p1, p4, p3 and p1, p2, p4
+		void push_quad(
+			glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, glm::vec2 p4,
+			const glm::vec4& color,
+			const glm::mat4& transform
+		);
+
+		// Corners are already transformed
+		void push_quad(const glm::vec2 corners[4], const glm::vec4& color);
+		void push_quad(const glm::vec2 corners[4], uint32_t color);
+
+		// Many quads at once through expand_quads, see VertexKernels.h
+		void push_quads(const QuadInstances& quads, uint32_t count, glm::vec2 origin, const glm::mat4& transform);
+
+		void flush();
+
+		bool empty() const { return _vertex_count == 0; }
+		uint32_t vertex_count() const { return _vertex_count; }
+		uint32_t max_quads() const { return _max_quads; }
+		uint32_t max_vertices() const { return _max_quads * VERTICES_PER_QUAD; }
+		uint32_t max_indices() const { return _max_quads * INDICES_PER_QUAD; }
+
+		// Index buffer for max_quads(). Index has to hold max_vertices() - 1
+		template<typename Index>
+		std::vector<Index> make_indices() const {
+			assert(max_vertices() - 1 <= std::numeric_limits<Index>::max());
+
+			// Corners are stored p1, p2, p3, p4
+			constexpr uint32_t pattern[INDICES_PER_QUAD] = { 0, 3, 2, 0, 1, 3 };
+
+			std::vector<Index> indices(max_indices());
+			for (uint32_t quad = 0; quad < _max_quads; ++quad) {
+				for (uint32_t i = 0; i < INDICES_PER_QUAD; ++i) {
+					indices[quad * INDICES_PER_QUAD + i] = static_cast<Index>(quad * VERTICES_PER_QUAD + pattern[i]);
+				}
+			}
+			return indices;
+		}
+
+		const BatchStats& stats() const { return _stats; }
+		void reset_stats() { _stats = {}; }
+
+	private:
+		BatchVertex2D* reserve_quad();
+		// Up to count quads in the current range, flushing first when full. Returns how many were reserved
+		uint32_t reserve_quads(uint32_t count, BatchVertex2D*& vertices);
+
+	private:
+		BatchSink* _sink = nullptr;
+		uint32_t _max_quads = 0;
+
+		std::vector<BatchVertex2D> _vertices; // Preallocated, never grows
+		uint32_t _vertex_count = 0;
+		std::vector<BatchRange> _ranges;
+		uint64_t _state = 0;
+
+		BatchStats _stats;
+	};
+
+	// Collects rect instances that share a view projection.
+	// Flushes when full, when the view projection changes or when flush() is called.
+	class RectBatcher {
+	public:
+		static constexpr uint32_t DEFAULT_MAX_INSTANCES = 10000;
+
+		RectBatcher(uint32_t max_instances = DEFAULT_MAX_INSTANCES);
+
+		void set_sink(InstanceSink* sink) { _sink = sink; }
+
+		void push_rect(const RectInstance& instance, const glm::mat4& view_projection);
+		void flush();
+
+		bool empty() const { return _instance_count == 0; }
+		uint32_t instance_count() const { return _instance_count; }
+		uint32_t max_instances() const { return _max_instances; }
+
+		const BatchStats& stats() const { return _stats; }
+		void reset_stats() { _stats = {}; }
+
+	private:
+		InstanceSink* _sink = nullptr;
+		uint32_t _max_instances = 0;
+
+		std::vector<RectInstance> _instances; // Preallocated, never grows
+		uint32_t _instance_count = 0;
+		glm::mat4 _view_projection = glm::mat4(1.0f);
+
+		BatchStats _stats;
+	};
+
+	// Collects glyph quads into one bucket per page, so a flush draws every page once
+	// however strings and pages interleave. Glyphs of different pages can end up drawn
+	// in another order than pushed, which only shows where text overlaps other text.
+	// Flushes when max_quads are collected or when flush() is called.
+	class TextBatcher {
+	public:
+		static constexpr uint32_t DEFAULT_MAX_QUADS = QuadBatcher::DEFAULT_MAX_QUADS;
+
+		TextBatcher(uint32_t max_quads = DEFAULT_MAX_QUADS);
+
+		void set_sink(TextSink* sink) { _sink = sink; }
+
+		// Corners are already transformed, p1..p4 like QuadBatcher. uv_min goes to p1, uv_max to p4
+		void push_quad(
+			const Shared<Texture2D>& texture, float distance_range,
+			const glm::vec2 corners[4], glm::vec2 uv_min, glm::vec2 uv_max,
+			uint32_t color
+		);
+
+		void flush();
+
+		bool empty() const { return _quad_count == 0; }
+		uint32_t quad_count() const { return _quad_count; }
+		uint32_t max_quads() const { return _max_quads; }
+
+		const BatchStats& stats() const { return _stats; }
+		void reset_stats() { _stats = {}; }
+
+	private:
+		struct Bucket {
+			Shared<Texture2D> texture; // nullptr when unused
+			float distance_range = 0.0f;
+			std::vector<TextVertex2D> vertices;
+		};
+
+	private:
+		TextSink* _sink = nullptr;
+		uint32_t _max_quads = 0;
+		uint32_t _quad_count = 0;
+
+		std::vector<Bucket> _buckets; // Kept with their capacity across flushes
+		uint32_t _bucket_count = 0;   // In use, at the front
+		uint32_t _last_bucket = 0;    // Consecutive glyphs mostly share a page
+
+		std::vector<TextVertex2D> _vertices; // Buckets back to back on flush, preallocated
+		std::vector<TextRange> _ranges;
+
+		BatchStats _stats;
+	};
+}
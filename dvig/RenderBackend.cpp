@@ -0,0 +1,97 @@
+#include "pch.h"
+#include "RenderBackend.h"
+#include "D3D11Backend.h"
+#include "HeadlessBackend.h"
+#include "SoftwareBackend.h"
+#include "Utils.h"
+
+namespace dvig {
+	Shared<VertexShader> RenderBackend::compile_vertex_shader(
+		const std::wstring& shader_path,
+		const std::vector<VertexElement>& layout,
+		uint32_t uniform_buffer_size,
+		const std::string& main_name
+	) {
+		std::string error;
+		Shared<VertexShader> shader = try_compile_vertex_shader(shader_path, layout, uniform_buffer_size, main_name, error);
+		if (shader == nullptr) {
+			std::cerr << error << "\n";
+			abort();
+		}
+
+		return shader;
+	}
+
+	Shared<PixelShader> RenderBackend::compile_pixel_shader(
+		const std::wstring& shader_path,
+		const std::string& main_name
+	) {
+		std::string error;
+		Shared<PixelShader> shader = try_compile_pixel_shader(shader_path, main_name, error);
+		if (shader == nullptr) {
+			std::cerr << error << "\n";
+			abort();
+		}
+
+		return shader;
+	}
+
+	uint64_t PipelineStateDesc::hash() const {
+		const uint32_t vertex_value = vertex.value();
+		const uint32_t pixel_value = pixel.value();
+
+		uint64_t result = utils::fnv1a_64(&vertex_value, sizeof(vertex_value));
+		result = utils::fnv1a_64(&pixel_value, sizeof(pixel_value), result);
+		result = utils::fnv1a_64(&topology, sizeof(topology), result);
+		result = utils::fnv1a_64(&blend, sizeof(blend), result);
+		return result;
+	}
+
+	bool PipelineStateDesc::operator==(const PipelineStateDesc& other) const {
+		return vertex == other.vertex && pixel == other.pixel && topology == other.topology && blend == other.blend;
+	}
+
+	void RenderBackend::bind_pipeline(const PipelineState& pipeline) {
+		_frame_state_stats.pipeline_binds++;
+		if (_bound_pipeline == &pipeline) {
+			_frame_state_stats.pipeline_binds_skipped++;
+			return;
+		}
+
+		bind(pipeline.vertex);
+		bind(pipeline.pixel);
+		set_topology(pipeline.desc.topology);
+		set_blend_mode(pipeline.desc.blend);
+		_bound_pipeline = &pipeline;
+	}
+
+	void RenderBackend::count_state_call(bool changed) {
+		if (changed) {
+			_frame_state_stats.issued++;
+		} else {
+			_frame_state_stats.skipped++;
+		}
+	}
+
+	void RenderBackend::end_state_frame() {
+		_last_frame_state_stats = _frame_state_stats;
+		_frame_state_stats = {};
+	}
+
+	Unique<RenderBackend> create_render_backend(RenderBackendType type) {
+		switch (type) {
+			case RenderBackendType::D3D11:
+			#ifdef _WIN32
+				return std::make_unique<D3D11Backend>();
+			#else
+				std::cerr << "D3D11 backend is only available on Windows!\n";
+				abort();
+			#endif
+			case RenderBackendType::Headless: return std::make_unique<HeadlessBackend>();
+			case RenderBackendType::Software: return std::make_unique<SoftwareBackend>();
+			default:
+				std::cerr << "Unknown render backend type!\n";
+				abort();
+		}
+	}
+}
@@ -0,0 +1,355 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "ResourcePool.h"
+#include "UniformBuffer.h"
+#include "VertexLayout.h"
+
+namespace dvig {
+	enum class RenderBackendType {
+		D3D11,
+		Headless, // Records commands and counts stats. No window, no GPU
+		Software, // Headless + CPU rasterizer into an in memory RGBA8 framebuffer
+	};
+
+	enum class TopologyType {
+		TriangleList,
+	};
+
+	enum class BlendMode {
+		Opaque,
+		PremultipliedAlpha, // src + dst * (1 - src.a)
+	};
+
+	enum class BufferDataType {
+		Default,
+		Static,
+		Dynamic
+	};
+
+	enum class IndexFormat {
+		UInt16,
+		UInt32,
+	};
+
+	constexpr uint32_t index_format_size(IndexFormat format) {
+		return format == IndexFormat::UInt16 ? 2 : 4;
+	}
+
+	enum class TextureFormat {
+		RGBA8_UNorm, // R in the lowest byte
+	};
+
+	constexpr uint32_t texture_format_size(TextureFormat format) {
+		switch (format) {
+			case TextureFormat::RGBA8_UNorm: return 4;
+		}
+		return 0;
+	}
+
+	enum class TextureFilter {
+		Point,
+		Linear, // Bilinear in a mip, linear between mips
+	};
+
+	enum class TextureAddress {
+		Clamp,
+		Wrap,
+	};
+
+	// Pixel shader texture and sampler slots
+	constexpr uint32_t MAX_TEXTURE_SLOTS = 8;
+
+	// Resources are created by the backend, which returns its own derived type.
+	// Only the backend that created a resource may use it.
+	// Buffers and shaders are movable, backends keep them by value in their ResourcePools
+	struct VertexBuffer {
+		VertexBuffer() = default;
+		VertexBuffer(VertexBuffer&&) = default;
+		VertexBuffer& operator=(VertexBuffer&&) = default;
+		virtual ~VertexBuffer() = default;
+
+		uint32_t count = 0;
+		uint32_t vertex_size = 0; // Stride, sizeof the vertex struct
+		BufferDataType data_type = BufferDataType::Default;
+	};
+
+	struct IndexBuffer {
+		IndexBuffer() = default;
+		IndexBuffer(IndexBuffer&&) = default;
+		IndexBuffer& operator=(IndexBuffer&&) = default;
+		virtual ~IndexBuffer() = default;
+
+		uint32_t count = 0;
+		IndexFormat format = IndexFormat::UInt16;
+		BufferDataType data_type = BufferDataType::Default;
+	};
+
+	struct VertexShader {
+		VertexShader() = default;
+		VertexShader(VertexShader&&) = default;
+		VertexShader& operator=(VertexShader&&) = default;
+		virtual ~VertexShader() = default;
+
+		std::vector<VertexElement> layout;
+		uint32_t uniform_buffer_size = 0; // 0 when the shader has no uniform buffer
+		UniformLayout uniform_layout;     // Reflected by backends that can, empty otherwise
+	};
+
+	struct PixelShader {
+		PixelShader() = default;
+		PixelShader(PixelShader&&) = default;
+		PixelShader& operator=(PixelShader&&) = default;
+		virtual ~PixelShader() = default;
+	};
+
+	// Backends keep buffers and shaders in ResourcePools, the Renderer hands these out
+	using VertexBufferHandle = Handle<VertexBuffer>;
+	using IndexBufferHandle = Handle<IndexBuffer>;
+	using VertexShaderHandle = Handle<VertexShader>;
+	using PixelShaderHandle = Handle<PixelShader>;
+
+	struct Texture2D {
+		virtual ~Texture2D() = default;
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t mip_count = 1;
+		TextureFormat format = TextureFormat::RGBA8_UNorm;
+
+		uint32_t mip_width(uint32_t mip) const { return std::max(1u, width >> mip); }
+		uint32_t mip_height(uint32_t mip) const { return std::max(1u, height >> mip); }
+		uint32_t row_size(uint32_t mip) const { return mip_width(mip) * texture_format_size(format); }
+	};
+
+	// Texels of one mip, x and y from the top left
+	struct TextureRegion {
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		// Whole rows [row_start, row_start + row_count)
+		static TextureRegion rows(const Texture2D& texture, uint32_t mip, uint32_t row_start, uint32_t row_count) {
+			return { 0, row_start, texture.mip_width(mip), row_count };
+		}
+	};
+
+	struct SamplerDesc {
+		TextureFilter filter = TextureFilter::Linear;
+		TextureAddress address = TextureAddress::Clamp; // Both U and V
+
+		bool operator==(const SamplerDesc& other) const { return filter == other.filter && address == other.address; }
+	};
+
+	// Immutable, Renderer::create_sampler returns the same object for equal descs
+	struct Sampler {
+		virtual ~Sampler() = default;
+
+		SamplerDesc desc;
+	};
+
+	// Blend, rasterizer and depth state go here too once they exist
+	struct PipelineStateDesc {
+		VertexShaderHandle vertex;
+		PixelShaderHandle pixel;
+		TopologyType topology = TopologyType::TriangleList;
+		BlendMode blend = BlendMode::Opaque;
+
+		uint64_t hash() const;
+		bool operator==(const PipelineStateDesc& other) const;
+	};
+
+	// Immutable. Renderer::create_pipeline_state returns the same object for equal descs,
+	// so two pipelines are the same state exactly when they are the same object.
+	// The shaders are looked up once here, they have to outlive the pipeline
+	struct PipelineState {
+		PipelineState(const PipelineStateDesc& desc, VertexShader& vertex, PixelShader& pixel)
+			: desc(desc), hash(desc.hash()), vertex(vertex), pixel(pixel) {}
+
+		const PipelineStateDesc desc;
+		const uint64_t hash;
+		VertexShader& vertex;
+		PixelShader& pixel;
+	};
+
+	// State calls of one frame
+	struct StateCallStats {
+		uint32_t issued = 0;  // Reached the API because the state changed
+		uint32_t skipped = 0; // Dropped because the state was already bound
+		uint32_t pipeline_binds = 0;
+		uint32_t pipeline_binds_skipped = 0; // Same pipeline again, nothing else was looked at
+	};
+
+	// Everything the Renderer needs from a graphics API.
+	// The Renderer builds batching and the rest of the higher level API on top of it.
+	class RenderBackend {
+	public:
+		virtual ~RenderBackend() = default;
+
+		virtual RenderBackendType type() const = 0;
+
+		// native_window is HWND for D3D11, ignored by headless
+		virtual void init(const struct AppSpec& app_spec, void* native_window) = 0;
+		virtual void set_viewport(glm::vec2 pos, glm::vec2 size) = 0;
+		virtual void clear_color(const glm::vec4& color) = 0;
+		virtual void present(int VSync) = 0;
+
+		// Buffers and shaders
+		// They live by value in the backend's pools and are referred to by handle. find() returns nullptr
+		// for null and stale handles. destroy() makes the handle stale, the object stays until collect_resources()
+		// is told the frame (the one being recorded) has executed.
+		// Only on the recording thread, commands reach the render thread with the objects already looked up.
+		virtual VertexBuffer* find(VertexBufferHandle buffer) const = 0;
+		virtual IndexBuffer* find(IndexBufferHandle buffer) const = 0;
+		virtual VertexShader* find(VertexShaderHandle shader) const = 0;
+		virtual PixelShader* find(PixelShaderHandle shader) const = 0;
+
+		// The handle has to be alive, debug builds catch stale ones
+		template<typename Type>
+		Type& get(Handle<Type> handle) const {
+			Type* object = find(handle);
+			assert(object != nullptr && "Null or stale handle, the resource was removed");
+			return *object;
+		}
+
+		virtual void destroy(VertexBufferHandle buffer, uint64_t frame) = 0;
+		virtual void destroy(IndexBufferHandle buffer, uint64_t frame) = 0;
+		virtual void destroy(VertexShaderHandle shader, uint64_t frame) = 0;
+		virtual void destroy(PixelShaderHandle shader, uint64_t frame) = 0;
+		// Frees what was destroyed in frames below executed_frames
+		virtual void collect_resources(uint64_t executed_frames) = 0;
+
+		// Buffers
+		virtual VertexBufferHandle create_vertex_buffer(
+			const void* data,
+			uint32_t vertex_size,
+			uint32_t vertex_count,
+			BufferDataType data_type
+		) = 0;
+		virtual void update(VertexBuffer& buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count) = 0;
+		virtual void bind_vertex_buffers(
+			uint32_t first_slot, uint32_t buffer_count,
+			VertexBuffer* const* buffers, const uint32_t* strides
+		) = 0;
+		virtual IndexBufferHandle create_index_buffer(
+			const void* data,
+			IndexFormat format,
+			uint32_t index_count,
+			BufferDataType data_type
+		) = 0;
+		virtual void update(IndexBuffer& buffer, const void* data, uint32_t index_count) = 0;
+		virtual void bind(IndexBuffer& buffer) = 0;
+
+		// Textures
+		// Creating textures and samplers has to be thread safe, the Renderer creates them
+		// without waiting for the render thread so streaming doesn't stall it.
+		// A new texture's contents are undefined until every mip was updated.
+		virtual Shared<Texture2D> create_texture(uint32_t width, uint32_t height, uint32_t mip_count, TextureFormat format) = 0;
+		// Writes a region of a mip. data is tightly packed, region.width texels per row
+		virtual void update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data) = 0;
+		virtual Shared<Sampler> create_sampler(const SamplerDesc& desc) = 0;
+		// Pixel shader slots, below MAX_TEXTURE_SLOTS
+		virtual void bind(Texture2D& texture, uint32_t slot) = 0;
+		virtual void bind(Sampler& sampler, uint32_t slot) = 0;
+
+		// Shaders
+		// Compiling has to be thread safe, the Renderer compiles independent shaders in parallel
+		// and the shader library recompiles on a background thread, so the result is a loose object
+		// until add() moves it into the pool. The try_ versions return nullptr and fill error when the shader doesn't compile.
+		virtual Shared<VertexShader> try_compile_vertex_shader(
+			const std::wstring& shader_path,
+			const std::vector<VertexElement>& layout,
+			uint32_t uniform_buffer_size,
+			const std::string& main_name,
+			std::string& error
+		) = 0;
+		virtual Shared<PixelShader> try_compile_pixel_shader(
+			const std::wstring& shader_path,
+			const std::string& main_name,
+			std::string& error
+		) = 0;
+
+		// Abort with the error when the shader doesn't compile
+		Shared<VertexShader> compile_vertex_shader(
+			const std::wstring& shader_path,
+			const std::vector<VertexElement>& layout,
+			uint32_t uniform_buffer_size,
+			const std::string& main_name
+		);
+		Shared<PixelShader> compile_pixel_shader(
+			const std::wstring& shader_path,
+			const std::string& main_name
+		);
+
+		// Moves a compiled shader into the pool
+		virtual VertexShaderHandle add(VertexShader&& compiled) = 0;
+		virtual PixelShaderHandle add(PixelShader&& compiled) = 0;
+
+		// Moves a freshly compiled shader into an existing one, so every handle and pipeline
+		// picks up the new version. Only between frames with nothing in flight, on the recording thread.
+		// The uniform buffer contents are kept when its size didn't change.
+		virtual void replace(VertexShader& shader, VertexShader& compiled) = 0;
+		virtual void replace(PixelShader& shader, PixelShader& compiled) = 0;
+		virtual void bind(VertexShader& shader) = 0;
+		virtual void bind(PixelShader& shader) = 0;
+		// Binds the shaders, topology and blend mode. Binding the pipeline that's already bound is one comparison,
+		// the individual bind/set_topology/set_blend_mode calls and replace() forget the bound pipeline.
+		void bind_pipeline(const PipelineState& pipeline);
+		// Writes data_size bytes at offset into the shader's uniform buffer
+		virtual void update(VertexShader& shader, const void* data_ptr, uint32_t offset, uint32_t data_size) = 0;
+
+		// Draw
+		virtual void set_topology(TopologyType topology) = 0;
+		virtual void set_blend_mode(BlendMode mode) = 0;
+		virtual void draw(uint32_t vertex_count, uint32_t vertex_start_location) = 0;
+		virtual void draw_instanced(
+			uint32_t vertex_count, uint32_t instance_count,
+			uint32_t vertex_start_location, uint32_t instance_start_location
+		) = 0;
+		// Uses the bound index buffer. base_vertex_location is added to every index
+		virtual void draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) = 0;
+
+		// Profiling
+		// GPU time between the two calls goes to the Profiler, a few frames late so nothing waits on the GPU.
+		// Only while the Profiler is enabled. Backends without GPU timers ignore it
+		virtual void begin_gpu_scope(const char* /*name*/) {}
+		virtual void end_gpu_scope() {}
+
+		// Of the last presented frame
+		const StateCallStats& last_frame_state_stats() const { return _last_frame_state_stats; }
+
+	protected:
+		void count_state_call(bool changed);
+		// Backends call it on present
+		void end_state_frame();
+
+	protected:
+		const PipelineState* _bound_pipeline = nullptr;
+		StateCallStats _frame_state_stats;
+		StateCallStats _last_frame_state_stats;
+	};
+
+	// Target is anything with begin_gpu_scope/end_gpu_scope, the backend or the Renderer
+	template<typename Target>
+	class GpuProfileScope {
+	public:
+		GpuProfileScope(Target& target, const char* name) : _target(target) {
+			_target.begin_gpu_scope(name);
+		}
+
+		~GpuProfileScope() {
+			_target.end_gpu_scope();
+		}
+
+		GpuProfileScope(const GpuProfileScope&) = delete;
+		GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+	private:
+		Target& _target;
+	};
+
+	// D3D11 is only available on Windows. Aborts when the type isn't supported.
+	Unique<RenderBackend> create_render_backend(RenderBackendType type);
+}
@@ -0,0 +1,324 @@
+#include "pch.h"
+#include "RenderCommands.h"
+#include "Profiler.h"
+
+namespace dvig {
+	RenderCommandBuffer::RenderCommandBuffer(size_t capacity) {
+		_data.resize(capacity);
+		_retained.reserve(64);
+	}
+
+	void RenderCommandBuffer::set_viewport(glm::vec2 pos, glm::vec2 size) {
+		push(RenderCommandType::SetViewport, SetViewportCommand{ pos, size });
+	}
+
+	void RenderCommandBuffer::clear_color(const glm::vec4& color) {
+		push(RenderCommandType::ClearColor, ClearColorCommand{ color });
+	}
+
+	void RenderCommandBuffer::update(VertexBuffer& buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count) {
+		UpdateVertexBufferCommand command;
+		command.buffer = &buffer;
+		command.vertex_size = vertex_size;
+		command.vertex_count = vertex_count;
+		push(RenderCommandType::UpdateVertexBuffer, command, data, vertex_size * vertex_count);
+	}
+
+	void RenderCommandBuffer::bind_vertex_buffers(uint32_t first_slot, uint32_t buffer_count, VertexBuffer* const* buffers, const uint32_t* strides) {
+		assert(buffer_count <= BindVertexBuffersCommand::MAX_BUFFERS);
+
+		BindVertexBuffersCommand command;
+		command.first_slot = first_slot;
+		command.buffer_count = buffer_count;
+		for (uint32_t i = 0; i < buffer_count; ++i) {
+			command.buffers[i] = buffers[i];
+			command.strides[i] = strides[i];
+		}
+		push(RenderCommandType::BindVertexBuffers, command);
+	}
+
+	void RenderCommandBuffer::update(IndexBuffer& buffer, const void* data, uint32_t index_count) {
+		UpdateIndexBufferCommand command;
+		command.buffer = &buffer;
+		command.index_count = index_count;
+		push(RenderCommandType::UpdateIndexBuffer, command, data, index_format_size(buffer.format) * index_count);
+	}
+
+	void RenderCommandBuffer::bind(IndexBuffer& buffer) {
+		push(RenderCommandType::BindIndexBuffer, BindIndexBufferCommand{ &buffer });
+	}
+
+	void RenderCommandBuffer::update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data) {
+		UpdateTextureCommand command;
+		command.texture = &texture;
+		command.mip = mip;
+		command.region = region;
+		push(RenderCommandType::UpdateTexture, command, data, region.width * region.height * texture_format_size(texture.format));
+	}
+
+	void RenderCommandBuffer::bind(Texture2D& texture, uint32_t slot) {
+		push(RenderCommandType::BindTexture, BindTextureCommand{ &texture, slot });
+	}
+
+	void RenderCommandBuffer::bind(Sampler& sampler, uint32_t slot) {
+		push(RenderCommandType::BindSampler, BindSamplerCommand{ &sampler, slot });
+	}
+
+	void RenderCommandBuffer::bind(VertexShader& shader) {
+		push(RenderCommandType::BindVertexShader, BindVertexShaderCommand{ &shader });
+	}
+
+	void RenderCommandBuffer::bind(PixelShader& shader) {
+		push(RenderCommandType::BindPixelShader, BindPixelShaderCommand{ &shader });
+	}
+
+	void RenderCommandBuffer::bind(const PipelineState& pipeline) {
+		push(RenderCommandType::BindPipeline, BindPipelineCommand{ &pipeline });
+	}
+
+	void RenderCommandBuffer::update(VertexShader& shader, const void* data, uint32_t offset, uint32_t data_size) {
+		UpdateUniformsCommand command;
+		command.shader = &shader;
+		command.offset = offset;
+		command.size = data_size;
+		push(RenderCommandType::UpdateUniforms, command, data, data_size);
+	}
+
+	void RenderCommandBuffer::set_topology(TopologyType topology) {
+		push(RenderCommandType::SetTopology, SetTopologyCommand{ topology });
+	}
+
+	void RenderCommandBuffer::draw(uint32_t vertex_count, uint32_t vertex_start_location) {
+		push(RenderCommandType::Draw, DrawCommand{ vertex_count, vertex_start_location });
+	}
+
+	void RenderCommandBuffer::draw_instanced(
+		uint32_t vertex_count, uint32_t instance_count,
+		uint32_t vertex_start_location, uint32_t instance_start_location
+	) {
+		push(RenderCommandType::DrawInstanced, DrawInstancedCommand{ vertex_count, instance_count, vertex_start_location, instance_start_location });
+	}
+
+	void RenderCommandBuffer::draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) {
+		push(RenderCommandType::DrawIndexed, DrawIndexedCommand{ index_count, index_start_location, base_vertex_location });
+	}
+
+	void RenderCommandBuffer::begin_gpu_scope(const char* name) {
+		push(RenderCommandType::BeginGpuScope, BeginGpuScopeCommand{ name });
+	}
+
+	void RenderCommandBuffer::end_gpu_scope() {
+		push(RenderCommandType::EndGpuScope, EndGpuScopeCommand{});
+	}
+
+	void RenderCommandBuffer::present(int VSync) {
+		push(RenderCommandType::Present, PresentCommand{ VSync });
+	}
+
+	void RenderCommandBuffer::execute(RenderBackend& backend) const {
+		for_each([&](const RenderCommandHeader& header, const uint8_t* payload) {
+			switch (header.type) {
+				case RenderCommandType::SetViewport: {
+					auto command = read_render_command<SetViewportCommand>(payload);
+					backend.set_viewport(command.pos, command.size);
+				} break;
+
+				case RenderCommandType::ClearColor: {
+					auto command = read_render_command<ClearColorCommand>(payload);
+					backend.clear_color(command.color);
+				} break;
+
+				case RenderCommandType::UpdateVertexBuffer: {
+					auto command = read_render_command<UpdateVertexBufferCommand>(payload);
+					backend.update(*command.buffer, payload + sizeof(command), command.vertex_size, command.vertex_count);
+				} break;
+
+				case RenderCommandType::BindVertexBuffers: {
+					auto command = read_render_command<BindVertexBuffersCommand>(payload);
+					backend.bind_vertex_buffers(command.first_slot, command.buffer_count, command.buffers, command.strides);
+				} break;
+
+				case RenderCommandType::UpdateIndexBuffer: {
+					auto command = read_render_command<UpdateIndexBufferCommand>(payload);
+					backend.update(*command.buffer, payload + sizeof(command), command.index_count);
+				} break;
+
+				case RenderCommandType::BindIndexBuffer: {
+					auto command = read_render_command<BindIndexBufferCommand>(payload);
+					backend.bind(*command.buffer);
+				} break;
+
+				case RenderCommandType::UpdateTexture: {
+					auto command = read_render_command<UpdateTextureCommand>(payload);
+					backend.update(*command.texture, command.mip, command.region, payload + sizeof(command));
+				} break;
+
+				case RenderCommandType::BindTexture: {
+					auto command = read_render_command<BindTextureCommand>(payload);
+					backend.bind(*command.texture, command.slot);
+				} break;
+
+				case RenderCommandType::BindSampler: {
+					auto command = read_render_command<BindSamplerCommand>(payload);
+					backend.bind(*command.sampler, command.slot);
+				} break;
+
+				case RenderCommandType::BindVertexShader: {
+					auto command = read_render_command<BindVertexShaderCommand>(payload);
+					backend.bind(*command.shader);
+				} break;
+
+				case RenderCommandType::BindPixelShader: {
+					auto command = read_render_command<BindPixelShaderCommand>(payload);
+					backend.bind(*command.shader);
+				} break;
+
+				case RenderCommandType::BindPipeline: {
+					auto command = read_render_command<BindPipelineCommand>(payload);
+					backend.bind_pipeline(*command.pipeline);
+				} break;
+
+				case RenderCommandType::UpdateUniforms: {
+					auto command = read_render_command<UpdateUniformsCommand>(payload);
+					backend.update(*command.shader, payload + sizeof(command), command.offset, command.size);
+				} break;
+
+				case RenderCommandType::SetTopology: {
+					auto command = read_render_command<SetTopologyCommand>(payload);
+					backend.set_topology(command.topology);
+				} break;
+
+				case RenderCommandType::Draw: {
+					auto command = read_render_command<DrawCommand>(payload);
+					backend.draw(command.vertex_count, command.vertex_start_location);
+				} break;
+
+				case RenderCommandType::DrawInstanced: {
+					auto command = read_render_command<DrawInstancedCommand>(payload);
+					backend.draw_instanced(command.vertex_count, command.instance_count, command.vertex_start_location, command.instance_start_location);
+				} break;
+
+				case RenderCommandType::DrawIndexed: {
+					auto command = read_render_command<DrawIndexedCommand>(payload);
+					backend.draw_indexed(command.index_count, command.index_start_location, command.base_vertex_location);
+				} break;
+
+				case RenderCommandType::BeginGpuScope: {
+					auto command = read_render_command<BeginGpuScopeCommand>(payload);
+					backend.begin_gpu_scope(command.name);
+				} break;
+
+				case RenderCommandType::EndGpuScope: {
+					backend.end_gpu_scope();
+				} break;
+
+				case RenderCommandType::Present: {
+					auto command = read_render_command<PresentCommand>(payload);
+					backend.present(command.VSync);
+				} break;
+			}
+		});
+	}
+
+	void RenderCommandBuffer::clear() {
+		_size = 0;
+		_command_count = 0;
+		_retained.clear();
+	}
+
+	uint8_t* RenderCommandBuffer::reserve(uint32_t size) {
+		if (_size + size > _data.size()) {
+			_data.resize(std::max(_data.size() * 2, _size + size));
+		}
+
+		uint8_t* memory = _data.data() + _size;
+		_size += size;
+		_command_count++;
+		return memory;
+	}
+
+	RenderQueue::RenderQueue(uint32_t frames_in_flight, bool threaded, Executor executor)
+		: _executor(std::move(executor)) {
+		assert(frames_in_flight >= 1);
+
+		// Without a thread nothing is ever in flight, one buffer is enough
+		const uint32_t buffer_count = threaded ? std::max(frames_in_flight, 2u) : 1u;
+		for (uint32_t i = 0; i < buffer_count; ++i) {
+			_buffers.push_back(std::make_unique<RenderCommandBuffer>());
+		}
+
+		if (threaded) {
+			_thread = std::thread(&RenderQueue::render_thread_main, this);
+		}
+	}
+
+	RenderQueue::~RenderQueue() {
+		if (!_thread.joinable()) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_submitted_cv.notify_one();
+		_thread.join();
+	}
+
+	void RenderQueue::submit() {
+		if (!_thread.joinable()) {
+			RenderCommandBuffer& buffer = commands();
+			_executor(buffer);
+			buffer.clear();
+			_submitted++;
+			_executed.store(_submitted, std::memory_order_release);
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_submitted++;
+		_submitted_cv.notify_one();
+
+		// The next buffer was used buffers.size() frames ago, wait until that frame is done
+		const uint64_t buffer_count = _buffers.size();
+		_executed_cv.wait(lock, [&] { return _submitted - _executed.load(std::memory_order_relaxed) < buffer_count; });
+	}
+
+	void RenderQueue::wait_idle() {
+		if (!_thread.joinable()) {
+			return;
+		}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_executed_cv.wait(lock, [&] { return _executed.load(std::memory_order_relaxed) == _submitted; });
+	}
+
+	void RenderQueue::render_thread_main() {
+		Profiler::get().set_thread_name("Render");
+		MemoryTagScope memory_scope(MemoryTag::Render);
+
+		while (true) {
+			uint64_t frame = 0;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_submitted_cv.wait(lock, [&] { return _quit || _executed.load(std::memory_order_relaxed) < _submitted; });
+
+				// Frames that were submitted before quitting still get executed
+				frame = _executed.load(std::memory_order_relaxed);
+				if (frame == _submitted) {
+					return;
+				}
+			}
+
+			RenderCommandBuffer& buffer = *_buffers[frame % _buffers.size()];
+			_executor(buffer);
+			buffer.clear();
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_executed.store(frame + 1, std::memory_order_release);
+			}
+			_executed_cv.notify_all();
+		}
+	}
+}
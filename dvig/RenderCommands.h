@@ -0,0 +1,283 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "Memory.h"
+#include "RenderBackend.h"
+
+namespace dvig {
+	enum class RenderCommandType : uint32_t {
+		SetViewport,
+		ClearColor,
+		UpdateVertexBuffer,
+		BindVertexBuffers,
+		UpdateIndexBuffer,
+		BindIndexBuffer,
+		UpdateTexture,
+		BindTexture,
+		BindSampler,
+		BindVertexShader,
+		BindPixelShader,
+		BindPipeline,
+		UpdateUniforms,
+		SetTopology,
+		Draw,
+		DrawInstanced,
+		DrawIndexed,
+		BeginGpuScope,
+		EndGpuScope,
+		Present,
+	};
+
+	// Every command is a header, a trivially copyable payload and optional inline data (uploads).
+	// Commands are padded to RenderCommandBuffer::ALIGNMENT.
+	struct RenderCommandHeader {
+		RenderCommandType type = RenderCommandType::Draw;
+		uint32_t size = 0; // Header + payload + data + padding
+	};
+
+	struct SetViewportCommand {
+		glm::vec2 pos;
+		glm::vec2 size;
+	};
+
+	struct ClearColorCommand {
+		glm::vec4 color;
+	};
+
+	// Followed by vertex_size * vertex_count bytes
+	struct UpdateVertexBufferCommand {
+		VertexBuffer* buffer = nullptr;
+		uint32_t vertex_size = 0;
+		uint32_t vertex_count = 0;
+	};
+
+	struct BindVertexBuffersCommand {
+		static constexpr uint32_t MAX_BUFFERS = 8;
+
+		uint32_t first_slot = 0;
+		uint32_t buffer_count = 0;
+		VertexBuffer* buffers[MAX_BUFFERS] = {};
+		uint32_t strides[MAX_BUFFERS] = {};
+	};
+
+	// Followed by index_count indices of the buffer's format
+	struct UpdateIndexBufferCommand {
+		IndexBuffer* buffer = nullptr;
+		uint32_t index_count = 0;
+	};
+
+	struct BindIndexBufferCommand {
+		IndexBuffer* buffer = nullptr;
+	};
+
+	// Followed by region.height rows of region.width texels
+	struct UpdateTextureCommand {
+		Texture2D* texture = nullptr;
+		uint32_t mip = 0;
+		TextureRegion region;
+	};
+
+	struct BindTextureCommand {
+		Texture2D* texture = nullptr;
+		uint32_t slot = 0;
+	};
+
+	struct BindSamplerCommand {
+		Sampler* sampler = nullptr;
+		uint32_t slot = 0;
+	};
+
+	struct BindVertexShaderCommand {
+		VertexShader* shader = nullptr;
+	};
+
+	struct BindPixelShaderCommand {
+		PixelShader* shader = nullptr;
+	};
+
+	struct BindPipelineCommand {
+		const PipelineState* pipeline = nullptr;
+	};
+
+	// Followed by size bytes
+	struct UpdateUniformsCommand {
+		VertexShader* shader = nullptr;
+		uint32_t offset = 0;
+		uint32_t size = 0;
+	};
+
+	struct SetTopologyCommand {
+		TopologyType topology = TopologyType::TriangleList;
+	};
+
+	struct DrawCommand {
+		uint32_t vertex_count = 0;
+		uint32_t vertex_start_location = 0;
+	};
+
+	struct DrawInstancedCommand {
+		uint32_t vertex_count = 0;
+		uint32_t instance_count = 0;
+		uint32_t vertex_start_location = 0;
+		uint32_t instance_start_location = 0;
+	};
+
+	struct DrawIndexedCommand {
+		uint32_t index_count = 0;
+		uint32_t index_start_location = 0;
+		int32_t base_vertex_location = 0;
+	};
+
+	struct BeginGpuScopeCommand {
+		const char* name = ""; // String literal
+	};
+
+	struct EndGpuScopeCommand {};
+
+	struct PresentCommand {
+		int VSync = 0;
+	};
+
+	// Linear buffer of recorded RenderBackend calls. Memory is kept between frames,
+	// so once it reached its high water mark recording doesn't allocate.
+	// Resources are referenced by raw pointer. Renderer retains the Shared<> of textures and samplers
+	// until the buffer was executed and cleared, pooled buffers and shaders outlive it by deferred destruction.
+	class RenderCommandBuffer {
+	public:
+		static constexpr uint32_t ALIGNMENT = 8;
+		static constexpr size_t DEFAULT_CAPACITY = 1024 * 1024;
+
+		explicit RenderCommandBuffer(size_t capacity = DEFAULT_CAPACITY);
+
+		void set_viewport(glm::vec2 pos, glm::vec2 size);
+		void clear_color(const glm::vec4& color);
+		void update(VertexBuffer& buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count);
+		void bind_vertex_buffers(uint32_t first_slot, uint32_t buffer_count, VertexBuffer* const* buffers, const uint32_t* strides);
+		void update(IndexBuffer& buffer, const void* data, uint32_t index_count);
+		void bind(IndexBuffer& buffer);
+		void update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data);
+		void bind(Texture2D& texture, uint32_t slot);
+		void bind(Sampler& sampler, uint32_t slot);
+		void bind(VertexShader& shader);
+		void bind(PixelShader& shader);
+		void bind(const PipelineState& pipeline);
+		void update(VertexShader& shader, const void* data, uint32_t offset, uint32_t data_size);
+		void set_topology(TopologyType topology);
+		void draw(uint32_t vertex_count, uint32_t vertex_start_location);
+		void draw_instanced(
+			uint32_t vertex_count, uint32_t instance_count,
+			uint32_t vertex_start_location, uint32_t instance_start_location
+		);
+		void draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location);
+		void begin_gpu_scope(const char* name);
+		void end_gpu_scope();
+		void present(int VSync);
+
+		// Keeps the resource alive until clear()
+		void retain(Shared<const void> resource) { _retained.push_back(std::move(resource)); }
+
+		// Replays every command on the backend in recording order
+		void execute(RenderBackend& backend) const;
+
+		// Calls visitor(header, payload) for every command. payload points to the command struct,
+		// read it with read_render_command(). Inline data starts right after the struct.
+		template<typename Visitor>
+		void for_each(Visitor visitor) const {
+			size_t offset = 0;
+			while (offset < _size) {
+				RenderCommandHeader header;
+				memcpy(&header, _data.data() + offset, sizeof(header));
+
+				const uint8_t* payload = _data.data() + offset + sizeof(RenderCommandHeader);
+				visitor(header, payload);
+				offset += header.size;
+			}
+		}
+
+		void clear();
+
+		bool empty() const { return _size == 0; }
+		size_t size() const { return _size; }
+		size_t capacity() const { return _data.size(); }
+		uint32_t command_count() const { return _command_count; }
+
+	private:
+		template<typename Command>
+		void push(RenderCommandType type, const Command& command, const void* data = nullptr, uint32_t data_size = 0) {
+			static_assert(std::is_trivially_copyable_v<Command>, "Commands are copied as bytes");
+
+			const uint32_t unpadded = static_cast<uint32_t>(sizeof(RenderCommandHeader) + sizeof(Command)) + data_size;
+			const uint32_t size = (unpadded + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+			uint8_t* memory = reserve(size);
+
+			RenderCommandHeader header;
+			header.type = type;
+			header.size = size;
+			memcpy(memory, &header, sizeof(header));
+			memcpy(memory + sizeof(header), &command, sizeof(Command));
+			if (data_size > 0) {
+				memcpy(memory + sizeof(header) + sizeof(Command), data, data_size);
+			}
+		}
+
+		uint8_t* reserve(uint32_t size);
+
+	private:
+		TrackedVector<uint8_t, MemoryTag::Render> _data; // Only grows
+		size_t _size = 0;
+		uint32_t _command_count = 0;
+		TrackedVector<Shared<const void>, MemoryTag::Render> _retained;
+	};
+
+	// Reads a command payload out of for_each()
+	template<typename Command>
+	Command read_render_command(const uint8_t* payload) {
+		Command command;
+		memcpy(&command, payload, sizeof(Command));
+		return command;
+	}
+
+	// Hands recorded frames from the thread that records (game thread) to the thread that executes them.
+	// frames_in_flight buffers rotate: the producer records one while the render thread executes the others,
+	// and submit() only waits when all of them are in flight.
+	// Without a thread submit() executes the frame right away.
+	class RenderQueue {
+	public:
+		using Executor = std::function<void(RenderCommandBuffer& commands)>;
+
+		RenderQueue(uint32_t frames_in_flight, bool threaded, Executor executor);
+		~RenderQueue();
+
+		RenderQueue(const RenderQueue&) = delete;
+		RenderQueue& operator=(const RenderQueue&) = delete;
+
+		// The buffer of the frame being recorded
+		RenderCommandBuffer& commands() { return *_buffers[_submitted % _buffers.size()]; }
+
+		void submit();
+		// Waits until every submitted frame was executed
+		void wait_idle();
+
+		bool threaded() const { return _thread.joinable(); }
+		uint32_t frames_in_flight() const { return static_cast<uint32_t>(_buffers.size()); }
+		uint64_t submitted_frames() const { return _submitted; }
+		uint64_t executed_frames() const { return _executed.load(std::memory_order_acquire); }
+
+	private:
+		void render_thread_main();
+
+	private:
+		std::vector<Unique<RenderCommandBuffer>> _buffers;
+		Executor _executor;
+
+		std::mutex _mutex;
+		std::condition_variable _submitted_cv; // Producer -> render thread
+		std::condition_variable _executed_cv;  // Render thread -> producer
+		uint64_t _submitted = 0;               // Only written by the producer
+		std::atomic<uint64_t> _executed = 0;
+		bool _quit = false;
+
+		std::thread _thread;
+	};
+}
@@ -3,443 +3,798 @@
 #include "App.h"
 #include "Utils.h"
 #include "Macros.h"
+#include "Profiler.h"
+#include "RenderCommands.h"
+#include "Font.h"
+#include "MeshOptimizer.h"
 
 namespace dvig {
-	void UniformBuffer::set_data(const std::string& name, const void* data, int size) {
-		auto result = get_entry(name);
-		if (result.has_value()) {
-			auto value = result.value();
-			assert(value.size == size);
-			char* dst = _data.data() + value.index;
-			memcpy(dst, data, size);
+	void Renderer::init(const AppSpec& app_spec, void* native_window) {
+		_backend = create_render_backend(app_spec.render_backend);
+		_backend->init(app_spec, native_window);
+
+		if (app_spec.shader_hot_reload) {
+			_shader_library = std::make_unique<ShaderLibrary>(*_backend);
+			_shader_library->start();
 		}
+
+		_texture_loader = std::make_unique<TextureLoader>(*this, app_spec.texture_load_threads, app_spec.texture_upload_budget);
+		_default_sampler = create_sampler({});
+
+		_quad_batcher.set_sink(this);
+		_rect_batcher.set_sink(this);
+		_text_batcher.set_sink(this);
+
+		_queue = std::make_unique<RenderQueue>(app_spec.frames_in_flight, app_spec.render_thread, [this](RenderCommandBuffer& commands) {
+			DVIG_PROFILE_SCOPE("execute_commands");
+			commands.execute(*_backend);
+		});
 	}
 
-	void UniformBuffer::add_data(const std::string& name, const void* data, int size) {
-		_dirty = true;
-		int old_size = (int)_data.size();
-		_data.reserve(_data.size() + size);
+	void Renderer::set_viewport(glm::vec2 pos, glm::vec2 size) {
+		flush_batch();
+		commands().set_viewport(pos, size);
+	}
 
-		for (int i = 0; i < size; ++i) {
-			_data.push_back(((char*)data)[i]);
-		}
+	void Renderer::clear_color(const glm::vec4& color) {
+		flush_batch();
+		commands().clear_color(color);
+	}
 
-		BufferEntry entry;
-		entry.name = name;
-		entry.size = size;
-		entry.index = old_size;
+	void Renderer::draw_quad(
+		glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, glm::vec2 p4,
+		const glm::vec4& color, const glm::mat4& transform
+	) {
+		const glm::vec2 corners[4] = { p1, p2, p3, p4 };
+		_draw_list.push_quad(corners, color, transform);
+	}
 
-		_entries.push_back(entry);
+	void Renderer::draw_rect(glm::vec2 pos, glm::vec2 size, const glm::vec4& color, const glm::mat4& transform) {
+		draw_rect(pos, size, 0.0f, {}, color, transform);
 	}
 
-	std::optional<UniformBuffer::BufferEntry> UniformBuffer::get_entry(const std::string& name) {
-		for (auto& entry : _entries) {
-			if (entry.name == name) {
-				return entry;
+	void Renderer::draw_rect(
+		glm::vec2 pos, glm::vec2 size, float rotation, glm::vec2 origin,
+		const glm::vec4& color,
+		const glm::mat4& transform
+	) {
+		RectInstance instance;
+		instance.pos = pos;
+		instance.size = size;
+		instance.origin = origin;
+		instance.rotation = rotation;
+		instance.color = pack_color_rgba8(color);
+		_draw_list.push_rect(instance, transform);
+	}
+
+	void Renderer::flush_batch() {
+		submit_draw_list();
+		_quad_batcher.flush();
+		_rect_batcher.flush();
+		_text_batcher.flush();
+	}
+
+	void Renderer::draw_text(
+		Font& font, std::string_view text,
+		glm::vec2 pos, float font_size,
+		const glm::vec4& color,
+		const glm::mat4& transform
+	) {
+		draw_text(font, font.cached_layout(text, font_size), pos, color, transform);
+	}
+
+	void Renderer::draw_text(
+		Font& font, const TextLayout& layout,
+		glm::vec2 pos,
+		const glm::vec4& color,
+		const glm::mat4& transform
+	) {
+		// NOTE: Repacking a page doesn't need a flush, recorded glyphs only look their uvs up when submitted
+		if (!font.resident(layout)) {
+			font.rasterize(layout);
+		}
+
+		// Affine, so every corner is the transformed origin plus the transformed axes
+		const glm::vec2 axis_x(transform[0]);
+		const glm::vec2 axis_y(transform[1]);
+		const glm::vec2 origin(transform * glm::vec4(pos, 0.0f, 1.0f));
+		const uint32_t packed_color = pack_color_rgba8(color);
+		_draw_list.begin_text(font);
+
+		for (const TextQuad& quad : layout.quads) {
+			if (font.glyph_region(quad.glyph) == nullptr) {
+				continue;
 			}
+
+			const glm::vec2 top_left = origin + axis_x * quad.min.x + axis_y * quad.min.y;
+			const glm::vec2 width = axis_x * (quad.max.x - quad.min.x);
+			const glm::vec2 height = axis_y * (quad.max.y - quad.min.y);
+			const glm::vec2 corners[4] = { top_left, top_left + width, top_left + height, top_left + width + height };
+			_draw_list.push_glyph(quad.glyph, corners, packed_color);
 		}
+	}
 
-		return std::nullopt;
+	void Renderer::draw_texture(
+		const Shared<Texture2D>& texture,
+		glm::vec2 pos, glm::vec2 size,
+		const glm::vec4& tint,
+		const glm::mat4& transform,
+		const Shared<Sampler>& sampler
+	) {
+		draw_texture(texture, glm::vec2(0.0f), glm::vec2(1.0f), pos, size, tint, transform, sampler);
 	}
 
-	void Renderer::init(const AppSpec& app_spec, HWND hwnd) {
-		BOOL windowed = TRUE;
-		DXGI_SWAP_CHAIN_DESC swap_chain_desc;
-		{
-			DXGI_MODE_DESC mode_desc = {
-				static_cast<UINT>(app_spec.width),
-				static_cast<UINT>(app_spec.height),
-				DXGI_RATIONAL { 0, 1 },
-				DXGI_FORMAT_R8G8B8A8_UNORM,
-				DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED,
-				DXGI_MODE_SCALING_UNSPECIFIED
-			};
+	void Renderer::draw_texture(
+		const Shared<Texture2D>& texture,
+		glm::vec2 uv_min, glm::vec2 uv_max,
+		glm::vec2 pos, glm::vec2 size,
+		const glm::vec4& tint,
+		const glm::mat4& transform,
+		const Shared<Sampler>& sampler
+	) {
+		TextureDraw draw;
+		draw.texture = texture;
+		draw.sampler = sampler != nullptr ? sampler : _default_sampler;
+		draw.uv_rect = glm::vec4(uv_min, uv_max);
+		draw.tint = tint;
+		draw.transform = transform
+			* glm::translate(glm::mat4(1.0f), glm::vec3(pos, 0.0f))
+			* glm::scale(glm::mat4(1.0f), glm::vec3(size, 1.0f));
+		_draw_list.push_texture(std::move(draw));
+	}
 
-			// The default sampler mode, with no anti-aliasing, has a count of 1 and a quality level of 0.
-			// From https://learn.microsoft.com/en-us/windows/win32/api/dxgicommon/ns-dxgicommon-dxgi_sample_desc
-			DXGI_SAMPLE_DESC sample_desc = {
-				1,
-				0
-			};
+	void Renderer::submit_texture(const TextureDraw& draw) {
+		UniformTextured2D uniform;
+		uniform.color = draw.tint;
+		uniform.uv_rect = draw.uv_rect;
+		uniform.transform = draw.transform;
 
-			UINT flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
-			swap_chain_desc = {
-				mode_desc,
-				sample_desc,
-				DXGI_USAGE_RENDER_TARGET_OUTPUT,
-				2, // Buffer count
-				hwnd,
-				windowed,
-				DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL,
-				flags
-			};
+		// NOTE: Straight to the command buffer like the batch sinks, this runs inside flush_batch()
+		RenderCommandBuffer& commands = this->commands();
+		commands.update(_backend->get(_shader_2d_textured_vertex), &uniform, 0, sizeof(uniform));
+
+		VertexBuffer& quad = _backend->get(_textured_quad_vertex_buffer);
+		VertexBuffer* buffers[1] = { &quad };
+		uint32_t strides[1] = { quad.vertex_size };
+		commands.bind_vertex_buffers(0, 1, buffers, strides);
+		commands.bind(*_pipeline_2d_textured);
+
+		commands.bind(*draw.texture, 0);
+		commands.bind(*draw.sampler, 0);
+		commands.draw(quad.count, 0);
+
+		commands.retain(draw.texture);
+		commands.retain(draw.sampler);
+	}
+
+	void Renderer::submit_draw_list() {
+		if (_draw_list.empty()) {
+			return;
 		}
 
-		UINT flags = 0;
-	#ifdef _DEBUG
-		flags = D3D11_CREATE_DEVICE_DEBUG;
-	#endif
+		DVIG_PROFILE_SCOPE("submit_draw_list");
 
-		const D3D_FEATURE_LEVEL feature_levels[] = { D3D_FEATURE_LEVEL_11_0 };
-		D3D_FEATURE_LEVEL feature_level;
-		HRESULT result = D3D11CreateDeviceAndSwapChain(
-			nullptr,
-			D3D_DRIVER_TYPE_HARDWARE,
-			nullptr,
-			flags,
-			feature_levels,
-			1,
-			D3D11_SDK_VERSION,
-			&swap_chain_desc,
-			&_swap_chain,
-			&_device,
-			&feature_level,
-			&_device_context
-		);
-
-		check_d3d_error(result);
-
-		// Render Target
-		{
-			ComPtr<ID3D11Texture2D> backbuffer;
-			result = _swap_chain->GetBuffer(0, __uuidof(ID3D11Texture2D), &backbuffer);
-			check_d3d_error(result);
+		_draw_list.transform_quads();
+		const SortItem* items = _draw_list.sort(_jobs, _frame_arena);
+		const uint32_t count = _draw_list.size();
+
+		DrawType previous = DrawType::Quad;
+		for (uint32_t i = 0; i < count; ++i) {
+			const DrawType type = DrawList::type(items[i].value);
+			const uint32_t index = DrawList::index(items[i].value);
+
+			// Only one batcher holds anything at a time, so the batches execute in key order
+			if (type != previous) {
+				_quad_batcher.flush();
+				_rect_batcher.flush();
+				_text_batcher.flush();
+				previous = type;
+			}
 
-			result = _device->CreateRenderTargetView(backbuffer.Get(), nullptr, &_swap_chain_render_target);
-			check_d3d_error(result);
+			switch (type) {
+				case DrawType::Quad: {
+					const glm::vec2 corners[4] = {
+						_draw_list.quad_corner(index, 0),
+						_draw_list.quad_corner(index, 1),
+						_draw_list.quad_corner(index, 2),
+						_draw_list.quad_corner(index, 3),
+					};
+					_quad_batcher.push_quad(corners, _draw_list.quad(index).color);
+					break;
+				}
+				case DrawType::Rect: {
+					const RectDraw& draw = _draw_list.rect(index);
+					_rect_batcher.push_rect(draw.instance, _draw_list.view_projection(draw.view_projection));
+					break;
+				}
+				case DrawType::Texture:
+					submit_texture(_draw_list.texture(index));
+					break;
+				case DrawType::Text: {
+					const TextDraw& text = _draw_list.text(index);
+					for (uint32_t glyph_index = text.glyph_start; glyph_index < text.glyph_start + text.glyph_count; ++glyph_index) {
+						const GlyphDraw& glyph = _draw_list.glyph(glyph_index);
+						// Used this frame, so it wasn't evicted since, but it may have moved
+						const AtlasRegion* region = text.font->find_glyph_region(glyph.glyph);
+						if (region != nullptr) {
+							_text_batcher.push_quad(region->texture, text.distance_range, glyph.corners, region->uv_min, region->uv_max, glyph.color);
+						}
+					}
+					break;
+				}
+			}
 		}
 
-		set_viewport({}, { (float)app_spec.width, (float)app_spec.height });
+		_draw_list.clear();
 	}
 
-	void Renderer::set_viewport(glm::vec2 pos, glm::vec2 size) const {
-		D3D11_VIEWPORT viewport;
-		utils::zero_memory(&viewport);
+	void Renderer::set_topology(TopologyType topology) {
+		flush_batch();
+		commands().set_topology(topology);
+	}
 
-		viewport.TopLeftX = pos.x;
-		viewport.TopLeftY = pos.y;
-		viewport.Width = size.x;
-		viewport.Height = size.y;
+	void Renderer::draw(uint32_t vertex_count, uint32_t vertex_start_location) {
+		flush_batch();
+		commands().draw(vertex_count, vertex_start_location);
+	}
 
-		_device_context->RSSetViewports(1, &viewport);
+	void Renderer::draw_instanced(
+		uint32_t vertex_count, uint32_t instance_count,
+		uint32_t vertex_start_location, uint32_t instance_start_location
+	) {
+		flush_batch();
+		commands().draw_instanced(vertex_count, instance_count, vertex_start_location, instance_start_location);
 	}
 
-	void Renderer::clear_color(const glm::vec4& color) const {
-		_device_context->ClearRenderTargetView(_swap_chain_render_target.Get(), reinterpret_cast<const FLOAT*>(&color));
-		_device_context->OMSetRenderTargets(1, _swap_chain_render_target.GetAddressOf(), nullptr);
+	void Renderer::draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) {
+		flush_batch();
+		commands().draw_indexed(index_count, index_start_location, base_vertex_location);
 	}
 
-	void Renderer::draw_quad(
-		glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, glm::vec2 p4,
-		const glm::vec4& color, const glm::mat4& transform
-	) {
+	void Renderer::present(int VSync) {
+		flush_batch();
 		{
-			Vertex2D vertex_array[6] = {
-				{ p1 }, // { glm::vec2{ -0.5f,  0.5f } },
-				{ p4 }, // { glm::vec2{  0.5f, -0.5f } },
-				{ p3 }, // { glm::vec2{ -0.5f, -0.5f } },
-
-	            { p1 },// { glm::vec2{ -0.5f,  0.5f } },
-	            { p2 },// { glm::vec2{  0.5f,  0.5f } },
-				{ p4 },// { glm::vec2{  0.5f, -0.5f } },
-			};
+			MemoryTagScope memory_scope(MemoryTag::Assets);
 
-			update(_quad_vertex_buffer, vertex_array, sizeof(Vertex2D), _quad_vertex_buffer->count);
+			_texture_loader->update();
 		}
-
-		{
-			UniformVertex2D uniform_buffer;
-			uniform_buffer.transform = transform;
-			uniform_buffer.color = color;
-			update(_shader_2d_mesh_vertex, uniform_buffer);
+		commands().present(VSync);
+		_queue->submit();
+
+		// Reloads swap shaders the game thread reads and the render thread executes with,
+		// so they go in here while nothing is in flight
+		if (_shader_library && _shader_library->has_pending_reloads()) {
+			_queue->wait_idle();
+			_shader_library->apply_reloads();
 		}
+		collect_resources();
+	}
 
-		bind(_quad_vertex_buffer);
-		bind(_shader_2d_mesh_vertex);
-		bind(_shader_2d_mesh_pixel);
-		set_topology(TopologyType::TriangleList);
+	void Renderer::begin_gpu_scope(const char* name) {
+		flush_batch();
+		commands().begin_gpu_scope(name);
+	}
 
-		draw(_quad_vertex_buffer->count);
+	void Renderer::end_gpu_scope() {
+		flush_batch();
+		commands().end_gpu_scope();
 	}
 
-	void Renderer::draw_rect(glm::vec2 pos, glm::vec2 size, const glm::vec4& color, const glm::mat4& transform) {
-		TODO();
+	void Renderer::wait_idle() {
+		_queue->wait_idle();
+	}
+
+	RenderCommandBuffer& Renderer::commands() const {
+		return _queue->commands();
+	}
+
+	VertexBufferHandle Renderer::create_vertex_buffer(
+		const void* data,
+		uint32_t vertex_size,
+		uint32_t vertex_count,
+		BufferDataType data_type
+	) {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+
+		// Creating is rare, waiting keeps backends that aren't thread safe (headless stats) out of trouble
+		if (_queue) {
+			_queue->wait_idle();
+		}
+		return _backend->create_vertex_buffer(data, vertex_size, vertex_count, data_type);
 	}
 
-	void Renderer::set_topology(TopologyType topology) const {
-		D3D_PRIMITIVE_TOPOLOGY converted_topology = convert_topology_to_d3d11(topology);
+	void Renderer::bind(VertexBufferHandle buffer) {
+		flush_batch();
 
-		_device_context->IASetPrimitiveTopology(converted_topology);
+		VertexBuffer& object = _backend->get(buffer);
+		VertexBuffer* buffers[1] = { &object };
+		uint32_t strides[1] = { object.vertex_size };
+		commands().bind_vertex_buffers(0, 1, buffers, strides);
 	}
 
-	void Renderer::draw(uint32_t vertex_count, uint32_t vertex_start_location) const {
-		_device_context->Draw(vertex_count, vertex_start_location);
+	void Renderer::update(VertexBufferHandle buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count) {
+		commands().update(_backend->get(buffer), data, vertex_size, vertex_count);
 	}
 
-	void Renderer::present(int VSync) const {
-		UINT flags = 0;
-		_swap_chain->Present(VSync, flags);
+	void Renderer::destroy(VertexBufferHandle buffer) {
+		_backend->destroy(buffer, _queue->submitted_frames());
 	}
 
-	Shared<VertexBuffer> Renderer::create_vertex_buffer(
+	IndexBufferHandle Renderer::create_index_buffer(
 		const void* data,
-		uint32_t vertex_size,
-		uint32_t vertex_count,
+		IndexFormat format,
+		uint32_t index_count,
 		BufferDataType data_type
-	) const {
-		Shared<VertexBuffer> vertex_buffer = std::make_shared<VertexBuffer>();
-		vertex_buffer->count = vertex_count;
+	) {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
 
-		{
-			ComPtr<ID3D11Buffer> buffer;
-			D3D11_BUFFER_DESC buffer_desc;
-			utils::zero_memory(&buffer_desc);
-
-			if (data_type == BufferDataType::Default) {
-				buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-			} else if (data_type == BufferDataType::Static) {
-				buffer_desc.Usage = D3D11_USAGE_IMMUTABLE;
-			} else if (data_type == BufferDataType::Dynamic) {
-				buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
-				buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-			} else {
-				std::cerr << "Unknown vertex buffer data type!\n";
-				abort();
-			}
+		if (_queue) {
+			_queue->wait_idle();
+		}
+		return _backend->create_index_buffer(data, format, index_count, data_type);
+	}
 
-			buffer_desc.ByteWidth = vertex_size * vertex_count;
-			buffer_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	void Renderer::bind(IndexBufferHandle buffer) {
+		flush_batch();
+		commands().bind(_backend->get(buffer));
+	}
 
-			if (data == nullptr) {
-				const HRESULT result = _device->CreateBuffer(&buffer_desc, nullptr, &buffer);
-				check_d3d_error(result);
-			} else {
-				D3D11_SUBRESOURCE_DATA initData;
-				utils::zero_memory(&initData);
-				initData.pSysMem = data;
-				const HRESULT result = _device->CreateBuffer(&buffer_desc, &initData, &buffer);
-				check_d3d_error(result);
-			}
+	void Renderer::update(IndexBufferHandle buffer, const void* data, uint32_t index_count) {
+		commands().update(_backend->get(buffer), data, index_count);
+	}
+
+	void Renderer::destroy(IndexBufferHandle buffer) {
+		_backend->destroy(buffer, _queue->submitted_frames());
+	}
 
-			vertex_buffer->d3d11_buffer = buffer;
+	Shared<Texture2D> Renderer::create_texture(uint32_t width, uint32_t height, uint32_t mip_count, TextureFormat format) const {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+
+		// NOTE: Creation is thread safe in every backend, waiting here would stall streaming
+		return _backend->create_texture(width, height, mip_count, format);
+	}
+
+	Shared<Texture2D> Renderer::create_texture(const Image& image) const {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+
+		assert(!image.empty());
+
+		// Nothing recorded can use a new texture, so no flush
+		Shared<Texture2D> texture = create_texture(image.width, image.height, image.mip_count, TextureFormat::RGBA8_UNorm);
+		for (uint32_t mip = 0; mip < image.mip_count; ++mip) {
+			commands().update(*texture, mip, TextureRegion::rows(*texture, mip, 0, image.mip_height(mip)), image.mip_data(mip));
+		}
+		commands().retain(texture);
+		return texture;
+	}
+
+	void Renderer::update(Shared<Texture2D> texture, uint32_t mip, const TextureRegion& region, const void* data) {
+		// NOTE: Text draws don't count, their glyphs look the page and uvs up when they're submitted
+		if (_draw_list.references(texture.get())) {
+			flush_batch();
 		}
 
-		return vertex_buffer;
+		commands().update(*texture, mip, region, data);
+		commands().retain(std::move(texture));
 	}
 
-	void Renderer::bind(Shared<VertexBuffer> buffer) const {
-		UINT stride = sizeof(Vertex2D);
-		UINT offset = 0;
-		_device_context->IASetVertexBuffers(0, 1, buffer->d3d11_buffer.GetAddressOf(), &stride, &offset);
+	Shared<TextureLoad> Renderer::load_texture(const std::filesystem::path& path, const TextureLoadOptions& options) {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+
+		return _texture_loader->load(path, options);
 	}
 
-	void Renderer::update(Shared<VertexBuffer> buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count) {
-		D3D11_MAPPED_SUBRESOURCE resource;
-		_device_context->Map(buffer->d3d11_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &resource);
+	Shared<Sampler> Renderer::create_sampler(const SamplerDesc& desc) {
+		for (const Shared<Sampler>& sampler : _samplers) {
+			if (sampler->desc == desc) {
+				return sampler;
+			}
+		}
 
-		memcpy(resource.pData, data, vertex_size * vertex_count);
+		_samplers.push_back(_backend->create_sampler(desc));
+		return _samplers.back();
+	}
 
-		_device_context->Unmap(buffer->d3d11_buffer.Get(), 0);
-		buffer->count = vertex_count;
+	void Renderer::bind(Shared<Texture2D> texture, uint32_t slot) {
+		flush_batch();
+		commands().bind(*texture, slot);
+		commands().retain(std::move(texture));
 	}
 
-	Shared<VertexShader> Renderer::compile_vertex_shader(
+	void Renderer::bind(Shared<Sampler> sampler, uint32_t slot) {
+		flush_batch();
+		commands().bind(*sampler, slot);
+		commands().retain(std::move(sampler));
+	}
+
+	Shared<Mesh> Renderer::create_mesh(const MeshData& data, BufferDataType data_type, bool optimize) {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+
+		assert(data.vertex_size > 0 && !data.indices.empty());
+
+		// Dynamic meshes keep their vertex order, whoever updates them relies on it
+		if (optimize && data_type == BufferDataType::Static) {
+			MeshData optimized = data;
+			optimize_mesh(optimized);
+			return create_mesh(optimized, data_type, false);
+		}
+
+		Shared<Mesh> mesh = std::make_shared<Mesh>();
+		mesh->vertex_buffer = create_vertex_buffer(data.vertices.data(), data.vertex_size, data.vertex_count(), data_type);
+
+		// Half the index bandwidth when every index fits
+		const uint32_t index_count = static_cast<uint32_t>(data.indices.size());
+		if (data.vertex_count() <= std::numeric_limits<uint16_t>::max() + 1u) {
+			std::vector<uint16_t> indices(data.indices.begin(), data.indices.end());
+			mesh->index_buffer = create_index_buffer(indices.data(), index_count, data_type);
+		} else {
+			mesh->index_buffer = create_index_buffer(data.indices.data(), index_count, data_type);
+		}
+
+		mesh->submeshes = data.submeshes;
+		if (mesh->submeshes.empty()) {
+			mesh->submeshes.push_back({ 0, index_count });
+		}
+
+		return mesh;
+	}
+
+	void Renderer::draw_mesh(const Shared<Mesh>& mesh, uint32_t submesh) {
+		assert(submesh < mesh->submeshes.size());
+
+		bind(mesh->vertex_buffer);
+		bind(mesh->index_buffer);
+
+		const SubMesh& range = mesh->submeshes[submesh];
+		commands().draw_indexed(range.index_count, range.index_start, 0);
+	}
+
+	void Renderer::destroy(const Mesh& mesh) {
+		destroy(mesh.vertex_buffer);
+		destroy(mesh.index_buffer);
+	}
+
+	VertexShaderHandle Renderer::compile_vertex_shader(
 		const std::wstring& shader_path,
-		const std::vector<D3D11_INPUT_ELEMENT_DESC>& layout_array,
+		const std::vector<VertexElement>& layout_array,
 		bool create_uniform_buffer,
 		uint32_t uniform_buffer_size,
 		const std::string& main_name
-	) const {
-		Shared<VertexShader> shader = std::make_shared<VertexShader>();
-		{ // Compilation
-			namespace fs = std::filesystem;
-			if (!fs::exists(shader_path)) {
-				std::wcout << "shader file '" << shader_path << "' doesn't exist!\n";
-				abort();
-			}
+	) {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
 
-			ID3DBlob* error_message;
-			HRESULT result = D3DCompileFromFile(
-				shader_path.c_str(),
-				nullptr,
-				nullptr,
-				main_name.c_str(),
-				"vs_4_0",
-				0,
-				0,
-				&shader->blob,
-				&error_message
-			);
-
-			if (error_message != nullptr) {
-				const char* message = static_cast<const char*>(error_message->GetBufferPointer());
-				std::cerr << message << "\n";
-			}
-			check_d3d_error(result);
-
-			result = _device->CreateVertexShader(shader->blob->GetBufferPointer(), shader->blob->GetBufferSize(), nullptr, &shader->d3d11_shader);
-			check_d3d_error(result);
-		}
-
-		{ /* Layout */
-			HRESULT result = _device->CreateInputLayout(
-				layout_array.data(),
-				static_cast<UINT>(layout_array.size()),
-				shader->blob->GetBufferPointer(),
-				shader->blob->GetBufferSize(),
-				&shader->layout
-			);
-			check_d3d_error(result);
-		}
-
-		if (create_uniform_buffer) {
-			// Fill in a buffer description
-			D3D11_BUFFER_DESC buffer_desc;
-			utils::zero_memory(&buffer_desc);
-			buffer_desc.ByteWidth = uniform_buffer_size;
-			buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
-			buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-			buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-
-			// Create the buffer
-			// NOTE: nullptr for data, have to use update_uniform_buffer to fill the data.
-			//       Maybe it's a bit slow, but who cares, right?
-			HRESULT result = _device->CreateBuffer(
-				&buffer_desc,
-				nullptr,
-				&shader->const_buffer
-			);
-			check_d3d_error(result);
+		const uint32_t size = create_uniform_buffer ? uniform_buffer_size : 0;
+		Shared<VertexShader> compiled = _backend->compile_vertex_shader(shader_path, layout_array, size, main_name);
+		const VertexShaderHandle shader = _backend->add(std::move(*compiled));
+		if (_shader_library) {
+			_shader_library->add(shader, shader_path, layout_array, size, main_name);
 		}
-
 		return shader;
 	}
 
-	Shared<PixelShader> Renderer::compile_pixel_shader(
+	PixelShaderHandle Renderer::compile_pixel_shader(
 		const std::wstring& shader_path,
 		const std::string& main_name
-	) const {
-		Shared<PixelShader> shader = std::make_shared<PixelShader>();
-
-		HRESULT result;
-		ID3DBlob* error_message;
-		result = D3DCompileFromFile(
-			shader_path.c_str(),
-			nullptr,
-			nullptr,
-			main_name.c_str(),
-			"ps_4_0",
-			0,
-			0,
-			&shader->blob,
-			&error_message
-		);
-		check_d3d_error(result);
-
-		if (error_message != nullptr) {
-			const char* message = static_cast<const char*>(error_message->GetBufferPointer());
-			std::cerr<< message << "\n";
-		}
-
-		result = _device->CreatePixelShader(shader->blob->GetBufferPointer(), shader->blob->GetBufferSize(), nullptr, &shader->d3d11_shader);
-		check_d3d_error(result);
-	
+	) {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+
+		Shared<PixelShader> compiled = _backend->compile_pixel_shader(shader_path, main_name);
+		const PixelShaderHandle shader = _backend->add(std::move(*compiled));
+		if (_shader_library) {
+			_shader_library->add(shader, shader_path, main_name);
+		}
 		return shader;
 	}
 
-	void Renderer::bind(Shared<VertexShader> shader) const {
-		// Set Layout
-		_device_context->IASetInputLayout(shader->layout.Get());
+	std::vector<ShaderProgram> Renderer::compile_shaders(const std::vector<ShaderProgramDesc>& descs) {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+
+		std::vector<Shared<VertexShader>> vertex_shaders(descs.size());
+		std::vector<Shared<PixelShader>> pixel_shaders(descs.size());
+
+		// Even tasks are vertex shaders, odd ones pixel shaders
+		utils::parallel_for(static_cast<uint32_t>(descs.size() * 2), [&](uint32_t task) {
+			const ShaderProgramDesc& desc = descs[task / 2];
+			if (task % 2 == 0) {
+				vertex_shaders[task / 2] = _backend->compile_vertex_shader(desc.path, desc.layout, desc.uniform_buffer_size, desc.vertex_main_name);
+			} else {
+				pixel_shaders[task / 2] = _backend->compile_pixel_shader(desc.path, desc.pixel_main_name);
+			}
+		});
+
+		// The pools aren't thread safe, the shaders go in once every compile is done
+		std::vector<ShaderProgram> programs(descs.size());
+		for (size_t i = 0; i < descs.size(); ++i) {
+			programs[i].vertex = _backend->add(std::move(*vertex_shaders[i]));
+			programs[i].pixel = _backend->add(std::move(*pixel_shaders[i]));
+			if (_shader_library) {
+				_shader_library->add(programs[i].vertex, descs[i].path, descs[i].layout, descs[i].uniform_buffer_size, descs[i].vertex_main_name);
+				_shader_library->add(programs[i].pixel, descs[i].path, descs[i].pixel_main_name);
+			}
+		}
+
+		return programs;
+	}
+
+	void Renderer::bind(VertexShaderHandle shader) {
+		flush_batch();
+		commands().bind(_backend->get(shader));
+	}
+
+	void Renderer::bind(PixelShaderHandle shader) {
+		flush_batch();
+		commands().bind(_backend->get(shader));
+	}
+
+	void Renderer::destroy(VertexShaderHandle shader) {
+	#ifndef NDEBUG
+		for (const auto& [hash, bucket] : _pipeline_states) {
+			for (const Shared<PipelineState>& pipeline : bucket) {
+				assert(pipeline->desc.vertex != shader && "A pipeline still uses the shader");
+			}
+		}
+	#endif
+		if (_shader_library) {
+			_shader_library->remove(shader);
+		}
+		_backend->destroy(shader, _queue->submitted_frames());
+	}
+
+	void Renderer::destroy(PixelShaderHandle shader) {
+	#ifndef NDEBUG
+		for (const auto& [hash, bucket] : _pipeline_states) {
+			for (const Shared<PipelineState>& pipeline : bucket) {
+				assert(pipeline->desc.pixel != shader && "A pipeline still uses the shader");
+			}
+		}
+	#endif
+		if (_shader_library) {
+			_shader_library->remove(shader);
+		}
+		_backend->destroy(shader, _queue->submitted_frames());
+	}
+
+	Shared<PipelineState> Renderer::create_pipeline_state(const PipelineStateDesc& desc) {
+		std::vector<Shared<PipelineState>>& bucket = _pipeline_states[desc.hash()];
+		for (const Shared<PipelineState>& pipeline : bucket) {
+			if (pipeline->desc == desc) {
+				return pipeline;
+			}
+		}
+
+		bucket.push_back(std::make_shared<PipelineState>(desc, _backend->get(desc.vertex), _backend->get(desc.pixel)));
+		return bucket.back();
+	}
 
-		// Set const buffer
-		_device_context->VSSetConstantBuffers(0, 1, shader->const_buffer.GetAddressOf());
+	void Renderer::bind(Shared<PipelineState> pipeline) {
+		flush_batch();
+		commands().bind(*pipeline);
+		commands().retain(std::move(pipeline));
+	}
 
-		// Set the shader
-		_device_context->VSSetShader(shader->d3d11_shader.Get(), nullptr, 0);
+	void Renderer::update(VertexShaderHandle shader, const void* data_ptr, uint32_t data_size) const {
+		commands().update(_backend->get(shader), data_ptr, 0, data_size);
 	}
 
-	void Renderer::bind(Shared<PixelShader> shader) const {
-		_device_context->PSSetShader(shader->d3d11_shader.Get(), nullptr, 0);
+	void Renderer::update(VertexShaderHandle shader, UniformBuffer& uniform_buffer) const {
+		if (!uniform_buffer.is_dirty()) {
+			return;
+		}
+
+		VertexShader& object = _backend->get(shader);
+		const uint32_t begin = uniform_buffer.dirty_begin();
+		const uint32_t end = std::min(uniform_buffer.dirty_end(), object.uniform_buffer_size);
+		if (begin < end) {
+			commands().update(object, uniform_buffer.data() + begin, begin, end - begin);
+		}
+		uniform_buffer.clear_dirty();
 	}
 
-	void Renderer::update(Shared<VertexShader>& shader, const void* data_ptr, uint32_t data_size) const {
-		D3D11_MAPPED_SUBRESOURCE mapped_sub_res;
-		_device_context->Map(shader->const_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_sub_res);
-		memcpy(mapped_sub_res.pData, data_ptr, data_size);
-		_device_context->Unmap(shader->const_buffer.Get(), 0);
+	void Renderer::collect_resources() {
+		_backend->collect_resources(_queue->executed_frames());
 	}
 
 	void Renderer::create_core_vertex_buffers() {
-		_quad_vertex_buffer = create_vertex_buffer(nullptr, sizeof(Vertex2D), 6, BufferDataType::Dynamic);
+		_batch_vertex_buffer = create_vertex_buffer(nullptr, vertex_stride<BatchVertex2D>(), _quad_batcher.max_vertices(), BufferDataType::Dynamic);
+
+		if (_quad_batcher.max_vertices() <= std::numeric_limits<uint16_t>::max() + 1u) {
+			const std::vector<uint16_t> indices = _quad_batcher.make_indices<uint16_t>();
+			_batch_index_buffer = create_index_buffer(indices.data(), _quad_batcher.max_indices(), BufferDataType::Static);
+		} else {
+			const std::vector<uint32_t> indices = _quad_batcher.make_indices<uint32_t>();
+			_batch_index_buffer = create_index_buffer(indices.data(), _quad_batcher.max_indices(), BufferDataType::Static);
+		}
+
+		{ /* Unit quad for instancing */
+			Vertex2D vertex_array[6] = {
+				{ glm::vec2{ 0.0f, 0.0f } },
+				{ glm::vec2{ 1.0f, 1.0f } },
+				{ glm::vec2{ 0.0f, 1.0f } },
+
+				{ glm::vec2{ 0.0f, 0.0f } },
+				{ glm::vec2{ 1.0f, 0.0f } },
+				{ glm::vec2{ 1.0f, 1.0f } },
+			};
+
+			_unit_quad_vertex_buffer = create_vertex_buffer(vertex_array, 6, BufferDataType::Static);
+		}
+
+		// Text quads share the quad batch's index buffer
+		assert(_text_batcher.max_quads() <= _quad_batcher.max_quads());
+		_text_vertex_buffer = create_vertex_buffer(nullptr, vertex_stride<TextVertex2D>(), _text_batcher.max_quads() * QuadBatcher::VERTICES_PER_QUAD, BufferDataType::Dynamic);
+
+		_rect_instance_buffer = create_vertex_buffer(nullptr, vertex_stride<RectInstance>(), _rect_batcher.max_instances(), BufferDataType::Dynamic);
+
+		{ /* Unit quad for textures, same winding as the instancing one */
+			TexturedVertex2D vertex_array[6] = {
+				{ glm::vec2{ 0.0f, 0.0f }, glm::vec2{ 0.0f, 0.0f } },
+				{ glm::vec2{ 1.0f, 1.0f }, glm::vec2{ 1.0f, 1.0f } },
+				{ glm::vec2{ 0.0f, 1.0f }, glm::vec2{ 0.0f, 1.0f } },
+
+				{ glm::vec2{ 0.0f, 0.0f }, glm::vec2{ 0.0f, 0.0f } },
+				{ glm::vec2{ 1.0f, 0.0f }, glm::vec2{ 1.0f, 0.0f } },
+				{ glm::vec2{ 1.0f, 1.0f }, glm::vec2{ 1.0f, 1.0f } },
+			};
+
+			_textured_quad_vertex_buffer = create_vertex_buffer(vertex_array, 6, BufferDataType::Static);
+		}
 	}
 
 	void Renderer::compile_core_shaders(App& app) {
 		namespace fs = std::filesystem;
 		std::wstring shaders_path = app.get_abs_path(L"/shaders/");
 
-		if (!fs::exists(shaders_path)) {
+		// NOTE: Headless backends never read the shader files
+		if (_backend->type() == RenderBackendType::D3D11 && !fs::exists(shaders_path)) {
 			std::wcerr << "Core shaders path '" << shaders_path << "' doesn't exist\n";
 			abort();
 		}
 
+		std::vector<ShaderProgramDesc> descs(5);
+
 		{ /* Mesh 2d */
-			std::vector<D3D11_INPUT_ELEMENT_DESC> layout = {
-				{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			};
+			ShaderProgramDesc& desc = descs[0];
+			desc.path = shaders_path + L"mesh_2d.hlsl";
+			desc.layout = vertex_elements<Vertex2D>();
+			desc.uniform_buffer_size = sizeof(UniformVertex2D);
+		}
+
+		{ /* Mesh 2d batched */
+			ShaderProgramDesc& desc = descs[1];
+			desc.path = shaders_path + L"mesh_2d_batched.hlsl";
+			desc.layout = vertex_elements<BatchVertex2D>();
+		}
+
+		{ /* Mesh 2d instanced */
+			ShaderProgramDesc& desc = descs[2];
+			desc.path = shaders_path + L"mesh_2d_instanced.hlsl";
+			append_vertex_elements<Vertex2D>(desc.layout, 0);            // Slot 0: unit quad
+			append_vertex_elements<RectInstance>(desc.layout, 1, true); // Slot 1: one RectInstance per instance
+			desc.uniform_buffer_size = sizeof(UniformInstanced2D);
+		}
+
+		{ /* Mesh 2d textured */
+			ShaderProgramDesc& desc = descs[3];
+			desc.path = shaders_path + L"mesh_2d_textured.hlsl";
+			desc.layout = vertex_elements<TexturedVertex2D>();
+			desc.uniform_buffer_size = sizeof(UniformTextured2D);
+		}
+
+		{ /* Text 2d */
+			ShaderProgramDesc& desc = descs[4];
+			desc.path = shaders_path + L"text_2d.hlsl";
+			desc.layout = vertex_elements<TextVertex2D>();
+			desc.uniform_buffer_size = sizeof(UniformText2D);
+		}
+
+		std::vector<ShaderProgram> programs = compile_shaders(descs);
+
+		_shader_2d_mesh_vertex = programs[0].vertex;
+		_shader_2d_mesh_pixel = programs[0].pixel;
+		_shader_2d_batch_vertex = programs[1].vertex;
+		_shader_2d_batch_pixel = programs[1].pixel;
+		_shader_2d_instanced_vertex = programs[2].vertex;
+		_shader_2d_instanced_pixel = programs[2].pixel;
+		_shader_2d_textured_vertex = programs[3].vertex;
+		_shader_2d_textured_pixel = programs[3].pixel;
+		_shader_2d_text_vertex = programs[4].vertex;
+		_shader_2d_text_pixel = programs[4].pixel;
+
+		_pipeline_2d_batch = create_pipeline_state({ _shader_2d_batch_vertex, _shader_2d_batch_pixel, TopologyType::TriangleList });
+		_pipeline_2d_instanced = create_pipeline_state({ _shader_2d_instanced_vertex, _shader_2d_instanced_pixel, TopologyType::TriangleList });
+		_pipeline_2d_textured = create_pipeline_state({ _shader_2d_textured_vertex, _shader_2d_textured_pixel, TopologyType::TriangleList, BlendMode::PremultipliedAlpha });
+		_pipeline_2d_text = create_pipeline_state({ _shader_2d_text_vertex, _shader_2d_text_pixel, TopologyType::TriangleList, BlendMode::PremultipliedAlpha });
+	}
+
+	void Renderer::submit_batch(
+		const BatchVertex2D* vertices, uint32_t vertex_count,
+		const BatchRange* ranges, uint32_t range_count
+	) {
+		DVIG_PROFILE_SCOPE("submit_batch");
+
+		// NOTE: Goes straight to the command buffer. The public bind/draw functions
+		//       flush the batch themselves, so calling them here would recurse.
+		//       Core resources live as long as the Renderer, they don't need retaining.
+		RenderCommandBuffer& commands = this->commands();
+		commands.begin_gpu_scope("submit_batch");
+		VertexBuffer& vertex_buffer = _backend->get(_batch_vertex_buffer);
+		commands.update(vertex_buffer, vertices, sizeof(BatchVertex2D), vertex_count);
+
+		VertexBuffer* buffers[1] = { &vertex_buffer };
+		uint32_t strides[1] = { vertex_buffer.vertex_size };
+		commands.bind_vertex_buffers(0, 1, buffers, strides);
+		commands.bind(_backend->get(_batch_index_buffer));
+		commands.bind(*_pipeline_2d_batch);
+
+		// Only one batch state exists for now, so every range is drawn with the same pipeline.
+		for (uint32_t i = 0; i < range_count; ++i) {
+			commands.draw_indexed(ranges[i].index_count, ranges[i].index_start, 0);
+		}
+		commands.end_gpu_scope();
+	}
+
+	void Renderer::submit_instances(
+		const RectInstance* instances, uint32_t instance_count,
+		const glm::mat4& view_projection
+	) {
+		DVIG_PROFILE_SCOPE("submit_instances");
+
+		// NOTE: Same as submit_batch, straight to the command buffer to not recurse into flush_batch().
+		RenderCommandBuffer& commands = this->commands();
+		commands.begin_gpu_scope("submit_instances");
+		VertexBuffer& instance_buffer = _backend->get(_rect_instance_buffer);
+		commands.update(instance_buffer, instances, sizeof(RectInstance), instance_count);
+
+		UniformInstanced2D uniform_buffer;
+		uniform_buffer.view_projection = view_projection;
+		commands.update(_backend->get(_shader_2d_instanced_vertex), &uniform_buffer, 0, sizeof(uniform_buffer));
+
+		VertexBuffer& quad = _backend->get(_unit_quad_vertex_buffer);
+		VertexBuffer* buffers[2] = { &quad, &instance_buffer };
+		uint32_t strides[2] = { quad.vertex_size, instance_buffer.vertex_size };
+		commands.bind_vertex_buffers(0, 2, buffers, strides);
+		commands.bind(*_pipeline_2d_instanced);
+
+		commands.draw_instanced(quad.count, instance_count, 0, 0);
+		commands.end_gpu_scope();
+	}
+
+	void Renderer::submit_text(
+		const TextVertex2D* vertices, uint32_t vertex_count,
+		const TextRange* ranges, uint32_t range_count
+	) {
+		DVIG_PROFILE_SCOPE("submit_text");
+
+		// NOTE: Same as submit_batch, straight to the command buffer to not recurse into flush_batch().
+		RenderCommandBuffer& commands = this->commands();
+		commands.begin_gpu_scope("submit_text");
+		VertexBuffer& vertex_buffer = _backend->get(_text_vertex_buffer);
+		commands.update(vertex_buffer, vertices, sizeof(TextVertex2D), vertex_count);
+
+		VertexBuffer* buffers[1] = { &vertex_buffer };
+		uint32_t strides[1] = { vertex_buffer.vertex_size };
+		commands.bind_vertex_buffers(0, 1, buffers, strides);
+		commands.bind(_backend->get(_batch_index_buffer));
+		commands.bind(*_pipeline_2d_text);
+		commands.bind(*_default_sampler, 0);
+
+		VertexShader& text_shader = _backend->get(_shader_2d_text_vertex);
+		float distance_range = -1.0f;
+		for (uint32_t i = 0; i < range_count; ++i) {
+			const TextRange& range = ranges[i];
+			if (range.distance_range != distance_range) {
+				distance_range = range.distance_range;
+
+				UniformText2D uniform;
+				uniform.distance_range = distance_range;
+				commands.update(text_shader, &uniform, 0, sizeof(uniform));
+			}
 
-			_shader_2d_mesh_vertex = compile_vertex_shader(shaders_path + L"mesh_2d.hlsl", layout, true, sizeof(UniformVertex2D));
-			_shader_2d_mesh_pixel = compile_pixel_shader(shaders_path + L"mesh_2d.hlsl");
-		}
-	}
-
-	void Renderer::check_d3d_error(HRESULT result) const {
-		switch (result) {
-			case S_OK: return;
-			case S_FALSE: printf("[D3D11 Error]: S_FALSE \n"); abort();
-			case E_NOTIMPL: printf("[D3D11 Error]: E_NOTIMPL\n"); abort();
-			case E_OUTOFMEMORY: printf("[D3D11 Error]: E_OUTOFMEMORY\n"); abort();
-			case E_INVALIDARG: printf("[D3D11 Error]: E_INVALIDARG\n"); abort();
-			case E_FAIL: printf("[D3D11 Error]: E_FAIL\n"); abort();
-			case DXGI_ERROR_WAS_STILL_DRAWING: printf("[D3D11 Error]: DXGI_ERROR_WAS_STILL_DRAWING\n"); abort();
-			case DXGI_ERROR_INVALID_CALL: printf("[D3D11 Error]: DXGI_ERROR_INVALID_CALL \n"); abort();
-			case D3D11_ERROR_DEFERRED_CONTEXT_MAP_WITHOUT_INITIAL_DISCARD: printf("[D3D11 Error]: D3D11_ERROR_DEFERRED_CONTEXT_MAP_WITHOUT_INITIAL_DISCARD\n"); abort();
-			case D3D11_ERROR_TOO_MANY_UNIQUE_VIEW_OBJECTS: printf("[D3D11 Error]: D3D11_ERROR_TOO_MANY_UNIQUE_VIEW_OBJECTS\n"); abort();
-			case D3D11_ERROR_TOO_MANY_UNIQUE_STATE_OBJECTS: printf("[D3D11 Error]: D3D11_ERROR_TOO_MANY_UNIQUE_STATE_OBJECTS\n"); abort();
-			case D3D11_ERROR_FILE_NOT_FOUND: printf("[D3D11 Error]: D3D11_ERROR_FILE_NOT_FOUND\n"); abort();
-			case DXGI_ERROR_ACCESS_DENIED: printf("[D3D11 Error]: DXGI_ERROR_ACCESS_DENIED\n"); abort();
-			case DXGI_ERROR_ACCESS_LOST: printf("[D3D11 Error]: DXGI_ERROR_ACCESS_LOST\n"); abort();
-			case DXGI_ERROR_ALREADY_EXISTS: printf("[D3D11 Error]: DXGI_ERROR_ALREADY_EXISTS\n"); abort();
-			case DXGI_ERROR_CANNOT_PROTECT_CONTENT: printf("[D3D11 Error]: DXGI_ERROR_CANNOT_PROTECT_CONTENT\n"); abort();
-			case DXGI_ERROR_DEVICE_HUNG: printf("[D3D11 Error]: DXGI_ERROR_DEVICE_HUNG\n"); abort();
-			case DXGI_ERROR_DEVICE_REMOVED: printf("[D3D11 Error]: DXGI_ERROR_DEVICE_REMOVED\n"); abort();
-			case DXGI_ERROR_DEVICE_RESET: printf("[D3D11 Error]: DXGI_ERROR_DEVICE_RESET\n"); abort();
-			case DXGI_ERROR_DRIVER_INTERNAL_ERROR: printf("[D3D11 Error]: DXGI_ERROR_DRIVER_INTERNAL_ERROR\n"); abort();
-			case DXGI_ERROR_FRAME_STATISTICS_DISJOINT: printf("[D3D11 Error]: DXGI_ERROR_FRAME_STATISTICS_DISJOINT\n"); abort();
-			case DXGI_ERROR_GRAPHICS_VIDPN_SOURCE_IN_USE: printf("[D3D11 Error]: DXGI_ERROR_GRAPHICS_VIDPN_SOURCE_IN_USE\n"); abort();
-			case DXGI_ERROR_MORE_DATA: printf("[D3D11 Error]: DXGI_ERROR_MORE_DATA\n"); abort();
-			case DXGI_ERROR_NAME_ALREADY_EXISTS: printf("[D3D11 Error]: DXGI_ERROR_NAME_ALREADY_EXISTS\n"); abort();
-			case DXGI_ERROR_NONEXCLUSIVE: printf("[D3D11 Error]: DXGI_ERROR_NONEXCLUSIVE\n"); abort();
-			case DXGI_ERROR_NOT_CURRENTLY_AVAILABLE: printf("[D3D11 Error]: DXGI_ERROR_NOT_CURRENTLY_AVAILABLE\n"); abort();
-			case DXGI_ERROR_NOT_FOUND: printf("[D3D11 Error]: DXGI_ERROR_NOT_FOUND\n"); abort();
-			case DXGI_ERROR_REMOTE_CLIENT_DISCONNECTED: printf("[D3D11 Error]: DXGI_ERROR_REMOTE_CLIENT_DISCONNECTED\n"); abort();
-			case DXGI_ERROR_REMOTE_OUTOFMEMORY: printf("[D3D11 Error]: DXGI_ERROR_REMOTE_OUTOFMEMORY\n"); abort();
-			case DXGI_ERROR_RESTRICT_TO_OUTPUT_STALE: printf("[D3D11 Error]: DXGI_ERROR_RESTRICT_TO_OUTPUT_STALE\n"); abort();
-			case DXGI_ERROR_SDK_COMPONENT_MISSING: printf("[D3D11 Error]: DXGI_ERROR_SDK_COMPONENT_MISSING\n"); abort();
-			case DXGI_ERROR_SESSION_DISCONNECTED: printf("[D3D11 Error]: DXGI_ERROR_SESSION_DISCONNECTED\n"); abort();
-			case DXGI_ERROR_UNSUPPORTED: printf("[D3D11 Error]: DXGI_ERROR_UNSUPPORTED\n"); abort();
-			case DXGI_ERROR_WAIT_TIMEOUT: printf("[D3D11 Error]: DXGI_ERROR_WAIT_TIMEOUT\n"); abort();
-			default:
-				auto s = std::to_string(result);
-				throw std::runtime_error(s.c_str());
-		}
-	}
-
-	D3D_PRIMITIVE_TOPOLOGY Renderer::convert_topology_to_d3d11(TopologyType topology) const {
-		switch (topology) {
-			case TopologyType::TriangleList: return D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-			default:
-				std::cerr << "Unknown topology type!\n";
-				abort();
+			commands.bind(*range.texture, 0);
+			commands.draw_indexed(range.index_count, range.index_start, 0);
+			// Pages go away with their font, which may happen before the frame executes
+			commands.retain(range.texture);
 		}
+		commands.end_gpu_scope();
 	}
 }
@@ -3,34 +3,30 @@
 
 #include "Types.h"
 #include "Utils.h"
-
-using Microsoft::WRL::ComPtr;
+#include "QuadBatch.h"
+#include "RenderBackend.h"
+#include "Mesh.h"
+#include "UniformBuffer.h"
+#include "ShaderLibrary.h"
+#include "RenderCommands.h"
+#include "TextureLoader.h"
+#include "Camera.h"
+#include "DrawList.h"
 
 namespace dvig {
 	class Renderer;
-
-	enum class CameraType {
-		Ortho,
-		Perspective,
-	};
-
-	class OrthoCamera {
-		
-	};
-
-	class PerspectiveCamera {
-
-	};
+	class JobSystem;
+	class Font;
+	struct TextLayout;
 
 	class Framebuffer {
 
 	};
 
 	struct SceneDesc {
-		union {
-			OrthoCamera ortho_camera;
-			PerspectiveCamera perspective_camera;
-		};
+		CameraType camera_type = CameraType::Ortho;
+		OrthoCamera ortho_camera;
+		PerspectiveCamera perspective_camera;
 	};
 
 	class SceneRenderer {
@@ -39,75 +35,27 @@ namespace dvig {
 		Shared<Framebuffer> end_scene();
 	};
 
-	// OpenGL Style uniform buffer where every entry has a name
-	class UniformBuffer {
-	public:
-		struct BufferEntry {
-			std::string name;
-			int size = 0;
-			int index = 0;
-		};
-
-		void update() {
-			// TODO:
-			// Will update the actuall d3d11 uniform buffer
-		}
-
-		void set_data(const std::string& name, const void* data, int size);
-		void add_data(const std::string& name, const void* data, int size);
-		std::optional<BufferEntry> get_entry(const std::string& name);
-
-		template<typename Type>
-		std::optional<Type> get_data(const std::string& name) {
-			auto entry = get_entry(name);
-			if (entry.has_value()) {
-				Type* data = reinterpret_cast<Type*>(_data.data() + entry.value().index);
-				return *data;
-			}
-
-			return std::nullopt;
-		}
-
-		template<typename Type>
-		void set_data(const std::string& name, const Type& data) {
-			set_data(name, &data, sizeof(data));
-		}
-
-		template<typename Type>
-		void add_data(const std::string& name, const Type& data) {
-			add_data(name, &data, sizeof(Type));
-		}
-
-	private:
-		ComPtr<ID3D11Buffer> uniform_buffer;
-
-		bool _dirty = false;
-		std::vector<char> _data;
-		std::vector<BufferEntry> _entries;
+	struct Vertex2D {
+		glm::vec2 pos;
 	};
 
-	// Shaders
-	struct PixelShader {
-	private:
-		friend class Renderer;
-
-		ComPtr<ID3D10Blob> blob;
-		ComPtr<ID3D11PixelShader> d3d11_shader;
+	template<> struct VertexLayout<Vertex2D> {
+		static constexpr std::array attributes = {
+			DVIG_VERTEX_ATTRIBUTE(Vertex2D, pos, "POSITION"),
+		};
 	};
 
-	struct VertexShader {
-	private:
-		friend class Renderer;
-
-		ComPtr<ID3D10Blob> blob;
-		ComPtr<ID3D11InputLayout> layout; // May be abstracted into its own thing later
-		ComPtr<ID3D11Buffer> const_buffer;
-		ComPtr<ID3D11VertexShader> d3d11_shader;
-		UniformBuffer uniform_buffer; // TODO:
+	// uv (0, 0) is the top left of the texture
+	struct TexturedVertex2D {
+		glm::vec2 pos;
+		glm::vec2 uv;
 	};
 
-	struct Vertex2D {
-		glm::vec2 pos;
+	template<> struct VertexLayout<TexturedVertex2D> {
+		static constexpr std::array attributes = {
+			DVIG_VERTEX_ATTRIBUTE(TexturedVertex2D, pos, "POSITION"),
+			DVIG_VERTEX_ATTRIBUTE(TexturedVertex2D, uv, "TEXCOORD"),
+		};
 	};
 
 	struct UniformVertex2D {
@@ -115,132 +63,371 @@ namespace dvig {
 		glm::mat4 transform;
 	};
 
-	struct VertexBuffer {
-	private:
-		friend class Renderer;
-		ComPtr<ID3D11Buffer> d3d11_buffer;
-		int count = 0;
+	// uv_rect maps the quad's 0..1 uvs to a sub rect of the texture: xy at (0, 0), zw at (1, 1)
+	struct UniformTextured2D {
+		glm::vec4 color;
+		glm::mat4 transform;
+		glm::vec4 uv_rect;
 	};
 
-	struct IndexBuffer {
-	private:
-		// TODO:
-		friend class Renderer;
-		ComPtr<ID3D11Buffer> d3d11_buffer;
+	struct UniformText2D {
+		float distance_range = 0.0f; // Font::distance_range
+		float padding[3] = {};
 	};
 
-	struct Mesh {
-		// TODO: Material, Vertex, Index buffers
+	struct UniformInstanced2D {
+		glm::mat4 view_projection;
 	};
 
-	enum class TopologyType {
-		TriangleList = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST,
+	// One vertex + pixel shader pair, for compiling many at once with Renderer::compile_shaders
+	struct ShaderProgramDesc {
+		std::wstring path; // Both stages come from the same file
+		std::vector<VertexElement> layout;
+		uint32_t uniform_buffer_size = 0; // 0 for no uniform buffer
+		std::string vertex_main_name = "vertex_main";
+		std::string pixel_main_name = "pixel_main";
 	};
 
-	enum class BufferDataType {
-		Default,
-		Static,
-		Dynamic
+	struct ShaderProgram {
+		VertexShaderHandle vertex;
+		PixelShaderHandle pixel;
 	};
 
-	class Renderer {
+	class Renderer : private BatchSink, private InstanceSink, private TextSink {
 		friend class App;
 	public:
 		Renderer() = default;
 		~Renderer() = default;
 
 		// Basic API
-		void init(const struct AppSpec& app_spec, HWND hwnd);
-		void set_viewport(glm::vec2 pos, glm::vec2 size) const;
-		void clear_color(const glm::vec4& color) const;
+		void init(const struct AppSpec& app_spec, void* native_window);
+		void set_viewport(glm::vec2 pos, glm::vec2 size);
+		void clear_color(const glm::vec4& color);
 
 		// Draw stuff. These are usually almost raw draw calls
 
 		// Simple 2D stuff
 		// Draws go to the bound render target aka framebuffer.
 		// If none bound, they go to the default one
+		// The 2D draws below are recorded into a DrawList and only hit the GPU on flush_batch(), sorted by
+		// layer and depth (see DrawKey). Draws of one layer and depth keep the order they were issued in,
+		// consecutive ones of the same kind batch. Between set_order_independent(true) and (false) they are
+		// grouped by pipeline instead, for draws that don't overlap.
+		// Any low level call below flushes first, so order against those is kept.
+		void set_layer(uint8_t layer) { _draw_list.set_layer(layer); }
+		void set_depth(uint16_t depth) { _draw_list.set_depth(depth); }
+		void set_order_independent(bool order_independent) { _draw_list.set_order_independent(order_independent); }
+
 		void draw_quad(
 			glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, glm::vec2 p4,
 			const glm::vec4& color,
 			const glm::mat4& transform
 		);
+
+		// Rects are instanced: a static unit quad plus one 32 byte RectInstance per rect.
+		// pos is the top left corner, rotation (radians) goes around origin (0..1 in rect space).
 		void draw_rect(glm::vec2 pos, glm::vec2 size, const glm::vec4& color, const glm::mat4& transform);
+		void draw_rect(
+			glm::vec2 pos, glm::vec2 size, float rotation, glm::vec2 origin,
+			const glm::vec4& color,
+			const glm::mat4& transform
+		);
+		void flush_batch();
+
+		// Not batched, one draw per call. Textures are expected premultiplied (TextureLoadOptions default)
+		// and blended over what's there, tint multiplies every channel. sampler nullptr is linear clamp
+		void draw_texture(
+			const Shared<Texture2D>& texture,
+			glm::vec2 pos, glm::vec2 size,
+			const glm::vec4& tint,
+			const glm::mat4& transform,
+			const Shared<Sampler>& sampler = nullptr
+		);
+		// Only the uv_min..uv_max part of the texture, e.g. an AtlasRegion
+		void draw_texture(
+			const Shared<Texture2D>& texture,
+			glm::vec2 uv_min, glm::vec2 uv_max,
+			glm::vec2 pos, glm::vec2 size,
+			const glm::vec4& tint,
+			const glm::mat4& transform,
+			const Shared<Sampler>& sampler = nullptr
+		);
+
+		// Batched, one draw per glyph page on flush_batch(). pos is the top left of the first line,
+		// color is straight alpha. The layout comes from the font's cache, see Font::cached_layout
+		void draw_text(
+			Font& font, std::string_view text,
+			glm::vec2 pos, float font_size,
+			const glm::vec4& color,
+			const glm::mat4& transform
+		);
+		// Text laid out by the caller, e.g. with Font::layout for text that changes every frame.
+		// The transform has to be affine like the quad batch's
+		void draw_text(
+			Font& font, const TextLayout& layout,
+			glm::vec2 pos,
+			const glm::vec4& color,
+			const glm::mat4& transform
+		);
+
+		const DrawList& draw_list() const { return _draw_list; }
+		DrawList& draw_list() { return _draw_list; }
+		// Draw lists of PARALLEL_SORT_MIN_ITEMS and up are sorted on it. App sets its own
+		void set_job_system(JobSystem* jobs) { _jobs = jobs; }
+		// The parallel sort's scratch comes from it instead of the heap. App sets its frame arena
+		void set_frame_arena(FrameArena* arena) { _frame_arena = arena; }
+
+		const QuadBatcher& quad_batcher() const { return _quad_batcher; }
+		QuadBatcher& quad_batcher() { return _quad_batcher; }
+		const RectBatcher& rect_batcher() const { return _rect_batcher; }
+		RectBatcher& rect_batcher() { return _rect_batcher; }
+		const TextBatcher& text_batcher() const { return _text_batcher; }
+		TextBatcher& text_batcher() { return _text_batcher; }
 
 		// Core low level api
-		void set_topology(TopologyType topology) const;
-		void draw(uint32_t vertex_count, uint32_t vertex_start_location = 0) const;
-		void present(int VSync) const;
+		void set_topology(TopologyType topology);
+		void draw(uint32_t vertex_count, uint32_t vertex_start_location = 0);
+		void draw_instanced(
+			uint32_t vertex_count, uint32_t instance_count,
+			uint32_t vertex_start_location = 0, uint32_t instance_start_location = 0
+		);
+		void draw_indexed(uint32_t index_count, uint32_t index_start_location = 0, int32_t base_vertex_location = 0);
+		// Hands the recorded frame to the render thread. Waits only when AppSpec::frames_in_flight are queued.
+		// Also the frame boundary where hot reloaded shaders are swapped in
+		void present(int VSync);
+		// Waits until the render thread executed every presented frame
+		void wait_idle();
+
+		// GPU timing, see RenderBackend::begin_gpu_scope
+		void begin_gpu_scope(const char* name);
+		void end_gpu_scope();
 
 		// Buffers
 		// --------------------------------------------------
+		// Buffers and shaders are handles into pools the backend owns, binding one is a lookup with nothing
+		// reference counted. destroy() makes the handle stale right away (debug builds assert on stale handles),
+		// the object itself goes once the render thread executed the frame. Stale handles are ignored by destroy()
 
 		// Vertex
-		Shared<VertexBuffer> create_vertex_buffer(
+		VertexBufferHandle create_vertex_buffer(
 			const void* data,
 			uint32_t vertex_size,
 			uint32_t vertex_count,
 			BufferDataType data_type = BufferDataType::Default
-		) const;
+		);
+
+		// Stride from the VertexLayout<Vertex>, which is checked against the struct at compile time
+		template<typename Vertex>
+		VertexBufferHandle create_vertex_buffer(
+			const Vertex* data,
+			uint32_t vertex_count,
+			BufferDataType data_type = BufferDataType::Default
+		) {
+			return create_vertex_buffer(data, vertex_stride<Vertex>(), vertex_count, data_type);
+		}
+
+		// Binds to slot 0 with the stride the buffer was created with
+		void bind(VertexBufferHandle buffer);
+		void update(VertexBufferHandle buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count);
+
+		template<typename Vertex>
+		void update(VertexBufferHandle buffer, const Vertex* data, uint32_t vertex_count) {
+			assert(get(buffer).vertex_size == vertex_stride<Vertex>() && "Buffer was created for another vertex type");
+			update(buffer, data, vertex_stride<Vertex>(), vertex_count);
+		}
+
+		void destroy(VertexBufferHandle buffer);
+		const VertexBuffer& get(VertexBufferHandle buffer) const { return _backend->get(buffer); }
+
+		// Index
+		IndexBufferHandle create_index_buffer(
+			const void* data,
+			IndexFormat format,
+			uint32_t index_count,
+			BufferDataType data_type = BufferDataType::Default
+		);
+
+		IndexBufferHandle create_index_buffer(const uint16_t* data, uint32_t index_count, BufferDataType data_type = BufferDataType::Default) {
+			return create_index_buffer(data, IndexFormat::UInt16, index_count, data_type);
+		}
+
+		IndexBufferHandle create_index_buffer(const uint32_t* data, uint32_t index_count, BufferDataType data_type = BufferDataType::Default) {
+			return create_index_buffer(data, IndexFormat::UInt32, index_count, data_type);
+		}
+
+		void bind(IndexBufferHandle buffer);
+		// index_count indices in the buffer's format
+		void update(IndexBufferHandle buffer, const void* data, uint32_t index_count);
+
+		void destroy(IndexBufferHandle buffer);
+		const IndexBuffer& get(IndexBufferHandle buffer) const { return _backend->get(buffer); }
 
-		void bind(Shared<VertexBuffer> buffer) const;
-		void update(Shared<VertexBuffer> buffer, const void* data, uint32_t vertex_size, uint32_t vertex_count);
+		// Meshes
+		// --------------------------------------------------
+
+		// Static meshes go through optimize_mesh (MeshOptimizer.h) on a copy of the data first. Pass optimize = false
+		// for data optimized offline, or when overlapping triangles have to draw in their order (2D)
+		Shared<Mesh> create_mesh(const MeshData& data, BufferDataType data_type = BufferDataType::Static, bool optimize = true);
+		// Binds the buffers and draws one submesh with whatever shaders are bound
+		void draw_mesh(const Shared<Mesh>& mesh, uint32_t submesh = 0);
+		// Destroys the buffers, the Mesh itself only holds handles
+		void destroy(const Mesh& mesh);
+
+		// Textures
+		// --------------------------------------------------
 
-		// Indexed
-		// TODO:
+		// Empty, update every mip before drawing with it. Doesn't wait for the render thread
+		Shared<Texture2D> create_texture(uint32_t width, uint32_t height, uint32_t mip_count, TextureFormat format) const;
+		// Records every mip of the image at once. Use load_texture for files, it spreads the upload over frames
+		Shared<Texture2D> create_texture(const Image& image) const;
+		// region.height tightly packed rows of region.width texels, copied into the command buffer.
+		// Flushes first when a recorded 2D draw uses the texture, so that draw still sees the old texels
+		void update(Shared<Texture2D> texture, uint32_t mip, const TextureRegion& region, const void* data);
+		// Decodes on the loader's threads, see TextureLoader
+		Shared<TextureLoad> load_texture(const std::filesystem::path& path, const TextureLoadOptions& options = {});
+		TextureLoader& texture_loader() { return *_texture_loader; }
+
+		// Equal descs give the same object
+		Shared<Sampler> create_sampler(const SamplerDesc& desc);
+
+		// Pixel shader slots
+		void bind(Shared<Texture2D> texture, uint32_t slot = 0);
+		void bind(Shared<Sampler> sampler, uint32_t slot = 0);
 
 		// Shaders
 		// --------------------------------------------------
 		
 		// Compile
-		Shared<VertexShader> compile_vertex_shader(
+		VertexShaderHandle compile_vertex_shader(
 			const std::wstring& shader_path,
-			const std::vector<D3D11_INPUT_ELEMENT_DESC>& layout_array,
+			const std::vector<VertexElement>& layout_array,
 			bool create_uniform_buffer = false,
 			uint32_t uniform_buffer_size = 0,
 			const std::string& main_name = "vertex_main"
-		) const;
+		);
 
-		Shared<PixelShader> compile_pixel_shader(
+		PixelShaderHandle compile_pixel_shader(
 			const std::wstring& shader_path,
 			const std::string& main_name = "pixel_main"
-		) const;
+		);
+
+		// Compiles every stage of every program in parallel. Results are in the order of descs
+		std::vector<ShaderProgram> compile_shaders(const std::vector<ShaderProgramDesc>& descs);
+
+		void bind(VertexShaderHandle shader);
+		void bind(PixelShaderHandle shader);
+
+		// Pipelines are never freed, so shaders a pipeline was created with can't be destroyed
+		void destroy(VertexShaderHandle shader);
+		void destroy(PixelShaderHandle shader);
+		const VertexShader& get(VertexShaderHandle shader) const { return _backend->get(shader); }
+		const PixelShader& get(PixelShaderHandle shader) const { return _backend->get(shader); }
+
+		// Pipelines
+		// --------------------------------------------------
 
-		void bind(Shared<VertexShader> shader) const;
-		void bind(Shared<PixelShader> shader) const;
+		// Equal descs give the same object, so switching pipelines is one pointer comparison in the backend
+		Shared<PipelineState> create_pipeline_state(const PipelineStateDesc& desc);
+		void bind(Shared<PipelineState> pipeline);
 
-		void update(Shared<VertexShader>& shader, const void* data_ptr, uint32_t data_size) const;
+		void update(VertexShaderHandle shader, const void* data_ptr, uint32_t data_size) const;
 
 		template<typename Type>
-		void update(Shared<VertexShader>& shader, const Type& data) const {
+		void update(VertexShaderHandle shader, const Type& data) const {
 			update(shader, &data, sizeof(Type));
 		}
 
+		// Uploads only the dirty range of the buffer, does nothing when it's clean
+		void update(VertexShaderHandle shader, UniformBuffer& uniform_buffer) const;
+
 		// Getters
-		ComPtr<ID3D11Device> device() { return _device; }
-		ComPtr<ID3D11DeviceContext> device_context() { return _device_context; }
+		// The render thread uses the backend too. wait_idle() before reading its state
+		RenderBackend& backend() { return *_backend; }
+		const RenderBackend& backend() const { return *_backend; }
+		// nullptr unless AppSpec::shader_hot_reload is set
+		ShaderLibrary* shader_library() { return _shader_library.get(); }
 
 	private:
+		// Every draw API call is recorded here and executed by the queue
+		RenderCommandBuffer& commands() const;
 		void create_core_vertex_buffers();
+		// Frees what was destroyed in frames the render thread is done with
+		void collect_resources();
 		void compile_core_shaders(class App& app);
-		void check_d3d_error(HRESULT result) const;
-		D3D_PRIMITIVE_TOPOLOGY convert_topology_to_d3d11(TopologyType topology) const;
+		// Sorts the draw list and feeds it to the batchers in key order
+		void submit_draw_list();
+		void submit_texture(const TextureDraw& draw);
+		void submit_batch(
+			const BatchVertex2D* vertices, uint32_t vertex_count,
+			const BatchRange* ranges, uint32_t range_count
+		) override;
+
+		void submit_instances(
+			const RectInstance* instances, uint32_t instance_count,
+			const glm::mat4& view_projection
+		) override;
+
+		void submit_text(
+			const TextVertex2D* vertices, uint32_t vertex_count,
+			const TextRange* ranges, uint32_t range_count
+		) override;
 
 	private:
-		ComPtr<IDXGISwapChain> _swap_chain;
-		ComPtr<ID3D11Device> _device;
-		ComPtr<ID3D11DeviceContext> _device_context;
-		ComPtr<ID3D11RenderTargetView> _swap_chain_render_target;
+		Unique<RenderBackend> _backend;
+		Unique<ShaderLibrary> _shader_library; // Declared after _backend so it's destroyed first
+		Unique<TextureLoader> _texture_loader;
 
 	private:
 		// Core shaders gonna be here.
 		// In the future I may store them in a map with name or something.
 		// For now it's fine to keep them here
 
-		Shared<VertexShader> _shader_2d_mesh_vertex;
-		Shared<PixelShader> _shader_2d_mesh_pixel;
+		VertexShaderHandle _shader_2d_mesh_vertex;
+		PixelShaderHandle _shader_2d_mesh_pixel;
+
+		VertexShaderHandle _shader_2d_batch_vertex;
+		PixelShaderHandle _shader_2d_batch_pixel;
+
+		VertexShaderHandle _shader_2d_instanced_vertex;
+		PixelShaderHandle _shader_2d_instanced_pixel;
+
+		VertexShaderHandle _shader_2d_textured_vertex;
+		PixelShaderHandle _shader_2d_textured_pixel;
+
+		VertexShaderHandle _shader_2d_text_vertex;
+		PixelShaderHandle _shader_2d_text_pixel;
+
+		Shared<PipelineState> _pipeline_2d_batch;
+		Shared<PipelineState> _pipeline_2d_instanced;
+		Shared<PipelineState> _pipeline_2d_textured;
+		Shared<PipelineState> _pipeline_2d_text;
+
+		// Keyed by PipelineState::hash. Pipelines are never freed, there are only a handful
+		std::unordered_map<uint64_t, std::vector<Shared<PipelineState>>> _pipeline_states;
+		std::vector<Shared<Sampler>> _samplers; // Also never freed
+		Shared<Sampler> _default_sampler;
 
 	private:
 		// Render Data
-		Shared<VertexBuffer> _quad_vertex_buffer;
+		DrawList _draw_list;
+		JobSystem* _jobs = nullptr;
+		FrameArena* _frame_arena = nullptr;
+
+		QuadBatcher _quad_batcher;
+		VertexBufferHandle _batch_vertex_buffer;
+		IndexBufferHandle _batch_index_buffer; // Static, QuadBatcher::make_indices
+
+		RectBatcher _rect_batcher;
+		VertexBufferHandle _unit_quad_vertex_buffer; // Static, shared by every instance
+		VertexBufferHandle _rect_instance_buffer;
+
+		VertexBufferHandle _textured_quad_vertex_buffer; // Static unit quad with matching uvs
+
+		TextBatcher _text_batcher;
+		VertexBufferHandle _text_vertex_buffer; // Indexed with _batch_index_buffer
+
+	private:
+		// Last, so the render thread is stopped before anything it uses is destroyed
+		Unique<RenderQueue> _queue;
 	};
 }
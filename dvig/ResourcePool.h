@@ -0,0 +1,151 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+
+namespace dvig {
+	// 32 bit reference to an object of a ResourcePool: generation 12 | index 20.
+	// The generation goes up every time the slot is freed, so a handle kept past remove() is stale
+	// instead of pointing at whatever took the slot. Generations start at 1, 0 is the null handle
+	template<typename Type>
+	class Handle {
+	public:
+		static constexpr uint32_t INDEX_BITS = 20;
+		static constexpr uint32_t MAX_INDEX = (1u << INDEX_BITS) - 1;
+		static constexpr uint32_t MAX_GENERATION = (1u << (32 - INDEX_BITS)) - 1;
+
+		Handle() = default;
+		Handle(uint32_t index, uint32_t generation) : _value((generation << INDEX_BITS) | index) {
+			assert(index <= MAX_INDEX && generation >= 1 && generation <= MAX_GENERATION);
+		}
+
+		uint32_t index() const { return _value & MAX_INDEX; }
+		uint32_t generation() const { return _value >> INDEX_BITS; }
+		uint32_t value() const { return _value; }
+
+		bool is_null() const { return _value == 0; }
+		explicit operator bool() const { return _value != 0; }
+		bool operator==(const Handle& other) const { return _value == other._value; }
+		bool operator!=(const Handle& other) const { return _value != other._value; }
+
+	private:
+		uint32_t _value = 0;
+	};
+
+	// Owns objects by value behind Handles. Looking one up is an index and a generation compare,
+	// nothing is reference counted. Slots are allocated in pages of PAGE_SIZE that never move,
+	// so pointers to an object (recorded commands hold them) stay valid until collect() destroys it.
+	// remove() makes the handle stale right away but keeps the object until collect() is told the frame it
+	// was removed in has executed, so commands recorded before still find it alive.
+	// Freed slots are reused only then, which also spreads the generations out.
+	// Handles are Handle<Base>, so a backend can keep its own derived types in here and hand out
+	// handles of the type the Renderer knows. Not thread safe, only touched from the thread that records
+	template<typename Type, typename Base = Type>
+	class ResourcePool {
+	public:
+		static constexpr uint32_t PAGE_SIZE = 64;
+
+		using HandleType = Handle<Base>;
+
+		HandleType add(Type&& object) {
+			uint32_t index = 0;
+			if (_free_slots.empty()) {
+				index = _slot_count;
+				if (index > HandleType::MAX_INDEX) {
+					std::cerr << "Resource pool is full!\n";
+					abort();
+				}
+				if (index % PAGE_SIZE == 0) {
+					_pages.push_back(std::make_unique<Page>());
+				}
+				_slot_count++;
+			} else {
+				index = _free_slots.back();
+				_free_slots.pop_back();
+			}
+
+			Slot& slot = get_slot(index);
+			slot.object.emplace(std::move(object));
+			slot.live = true;
+			_size++;
+			return { index, slot.generation };
+		}
+
+		bool alive(HandleType handle) const {
+			if (handle.index() >= _slot_count) {
+				return false;
+			}
+
+			const Slot& slot = get_slot(handle.index());
+			return slot.live && slot.generation == handle.generation();
+		}
+
+		// nullptr for null and stale handles
+		Type* find(HandleType handle) const {
+			return alive(handle) ? &*get_slot(handle.index()).object : nullptr;
+		}
+
+		// The handle has to be alive, debug builds catch stale ones
+		Type& get(HandleType handle) const {
+			assert(alive(handle) && "Null or stale handle, the resource was removed");
+			return *get_slot(handle.index()).object;
+		}
+
+		// frame is the one being recorded. Stale handles are ignored
+		void remove(HandleType handle, uint64_t frame) {
+			if (!alive(handle)) {
+				return;
+			}
+
+			Slot& slot = get_slot(handle.index());
+			slot.live = false;
+			slot.generation = slot.generation == HandleType::MAX_GENERATION ? 1 : slot.generation + 1;
+			_retired.push_back({ handle.index(), frame });
+			_size--;
+		}
+
+		// Destroys the objects removed in frames below executed_frames and frees their slots
+		void collect(uint64_t executed_frames) {
+			size_t kept = 0;
+			for (const Retired& retired : _retired) {
+				if (retired.frame < executed_frames) {
+					get_slot(retired.index).object.reset();
+					_free_slots.push_back(retired.index);
+				} else {
+					_retired[kept++] = retired;
+				}
+			}
+			_retired.resize(kept);
+		}
+
+		// Live objects, removed ones waiting for collect() aren't counted
+		uint32_t size() const { return _size; }
+		uint32_t retired_count() const { return static_cast<uint32_t>(_retired.size()); }
+		uint32_t slot_count() const { return _slot_count; }
+
+	private:
+		struct Slot {
+			std::optional<Type> object; // Still set while retired
+			uint32_t generation = 1;
+			bool live = false;
+		};
+
+		using Page = std::array<Slot, PAGE_SIZE>;
+
+		struct Retired {
+			uint32_t index = 0;
+			uint64_t frame = 0;
+		};
+
+		Slot& get_slot(uint32_t index) const {
+			return (*_pages[index / PAGE_SIZE])[index % PAGE_SIZE];
+		}
+
+	private:
+		std::vector<Unique<Page>> _pages; // Only grow, a slot keeps its index and address for good
+		uint32_t _slot_count = 0;
+		std::vector<uint32_t> _free_slots;
+		std::vector<Retired> _retired;
+		uint32_t _size = 0;
+	};
+}
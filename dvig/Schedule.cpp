@@ -0,0 +1,76 @@
+#include "pch.h"
+#include "Schedule.h"
+#include "FrameTiming.h"
+#include "Profiler.h"
+
+namespace dvig {
+	void Schedule::add(std::string name, ComponentMask reads, ComponentMask writes, SystemFunction function) {
+		Unique<System> system = std::make_unique<System>();
+		system->name = std::move(name);
+		system->reads = reads | writes;
+		system->writes = writes;
+		system->function = std::move(function);
+
+		_systems.push_back(std::move(system));
+		_stages_dirty = true;
+	}
+
+	void Schedule::run(World& world, float dt) {
+		for (const std::vector<uint32_t>& stage : stages()) {
+			if (_jobs == nullptr || stage.size() == 1) {
+				for (uint32_t system : stage) {
+					run_system(*_systems[system], world, dt);
+				}
+			} else {
+				JobCounter counter;
+				for (uint32_t i = 1; i < stage.size(); ++i) {
+					System& system = *_systems[stage[i]];
+					_jobs->run([this, &system, &world, dt]() { run_system(system, world, dt); }, &counter);
+				}
+
+				run_system(*_systems[stage[0]], world, dt);
+				_jobs->wait(counter);
+			}
+
+			for (uint32_t system : stage) {
+				world.apply(_systems[system]->commands);
+			}
+		}
+	}
+
+	const std::vector<std::vector<uint32_t>>& Schedule::stages() {
+		if (!_stages_dirty) {
+			return _stages;
+		}
+
+		// A system goes one stage after the latest earlier system it conflicts with
+		std::vector<uint32_t> system_stages(_systems.size(), 0);
+		_stages.clear();
+		for (uint32_t i = 0; i < _systems.size(); ++i) {
+			const System& system = *_systems[i];
+			for (uint32_t j = 0; j < i; ++j) {
+				const System& earlier = *_systems[j];
+				const bool conflict = (system.writes & earlier.reads) != 0 || (earlier.writes & system.reads) != 0;
+				if (conflict) {
+					system_stages[i] = std::max(system_stages[i], system_stages[j] + 1);
+				}
+			}
+
+			if (system_stages[i] == _stages.size()) {
+				_stages.emplace_back();
+			}
+			_stages[system_stages[i]].push_back(i);
+		}
+
+		_stages_dirty = false;
+		return _stages;
+	}
+
+	void Schedule::run_system(System& system, World& world, float dt) {
+		DVIG_PROFILE_SCOPE(system.name.c_str());
+
+		const int64_t start = steady_clock_now();
+		system.function(world, system.commands, dt);
+		system.time_ns = static_cast<uint64_t>(steady_clock_now() - start);
+	}
+}
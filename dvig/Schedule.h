@@ -0,0 +1,54 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "World.h"
+#include "JobSystem.h"
+
+namespace dvig {
+	// Systems run together over a World, in parallel where their component access allows.
+	// Every system declares the components it reads and writes. It waits for the earlier systems it conflicts with
+	// (one writes what the other reads or writes), systems that don't conflict share a stage and run at the same time.
+	// Structural changes go through the CommandBuffer a system gets. The buffers are applied after each stage in
+	// the order the systems were added, so the result doesn't depend on which thread finished first.
+	class Schedule {
+	public:
+		using SystemFunction = std::function<void(World& world, CommandBuffer& commands, float dt)>;
+
+		// Stages with more than one system spread over jobs. Without a job system everything runs on the calling thread
+		explicit Schedule(JobSystem* jobs = nullptr) : _jobs(jobs) {}
+
+		Schedule(const Schedule&) = delete;
+		Schedule& operator=(const Schedule&) = delete;
+
+		// Masks from component_mask<...>(), writes don't have to be listed in reads as well.
+		// A system touching components it didn't declare races with the others
+		void add(std::string name, ComponentMask reads, ComponentMask writes, SystemFunction function);
+		void run(World& world, float dt);
+
+		uint32_t system_count() const { return static_cast<uint32_t>(_systems.size()); }
+		const std::string& system_name(uint32_t system) const { return _systems[system]->name; }
+		// Wall time of the system in the last run
+		uint64_t system_time_ns(uint32_t system) const { return _systems[system]->time_ns; }
+		// System indices by stage, in the order they were added
+		const std::vector<std::vector<uint32_t>>& stages();
+
+	private:
+		struct System {
+			std::string name; // Profiler scope, stays put while the schedule lives
+			ComponentMask reads = 0;
+			ComponentMask writes = 0;
+			SystemFunction function;
+			CommandBuffer commands;
+			uint64_t time_ns = 0;
+		};
+
+		void run_system(System& system, World& world, float dt);
+
+	private:
+		std::vector<Unique<System>> _systems;
+		std::vector<std::vector<uint32_t>> _stages; // Rebuilt when a system is added
+		bool _stages_dirty = false;
+		JobSystem* _jobs = nullptr;
+	};
+}
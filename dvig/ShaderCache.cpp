@@ -0,0 +1,219 @@
+#include "pch.h"
+#include "ShaderCache.h"
+#include "Utils.h"
+
+namespace dvig {
+	namespace {
+		bool read_file(const std::filesystem::path& path, std::string& content) {
+			std::ifstream file(path, std::ios::binary);
+			if (!file) {
+				return false;
+			}
+
+			content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			return true;
+		}
+
+		// Both #include "file" and #include <file>, anything else is skipped
+		void find_includes(const std::string& source, std::vector<std::string>& includes) {
+			size_t line_start = 0;
+			while (line_start < source.size()) {
+				size_t line_end = source.find('\n', line_start);
+				if (line_end == std::string::npos) {
+					line_end = source.size();
+				}
+
+				size_t i = source.find_first_not_of(" \t", line_start);
+				if (i < line_end && source[i] == '#') {
+					i = source.find_first_not_of(" \t", i + 1);
+					if (i < line_end && source.compare(i, 7, "include") == 0) {
+						i = source.find_first_not_of(" \t", i + 7);
+						if (i < line_end && (source[i] == '"' || source[i] == '<')) {
+							const char close = source[i] == '"' ? '"' : '>';
+							const size_t end = source.find(close, i + 1);
+							if (end < line_end) {
+								includes.push_back(source.substr(i + 1, end - i - 1));
+							}
+						}
+					}
+				}
+
+				line_start = line_end + 1;
+			}
+		}
+
+		uint64_t hash_source_recursive(
+			const std::filesystem::path& path,
+			const std::string& source,
+			const ShaderIncludeReader& read_include,
+			std::vector<std::filesystem::path>& visited,
+			uint64_t hash
+		) {
+			hash = utils::fnv1a_64(source, hash);
+
+			std::vector<std::string> includes;
+			find_includes(source, includes);
+
+			for (const std::string& include : includes) {
+				const std::filesystem::path include_path = (path.parent_path() / include).lexically_normal();
+
+				// Include names are part of the hash, so renaming an include is a change too
+				hash = utils::fnv1a_64(include, hash);
+
+				if (std::find(visited.begin(), visited.end(), include_path) != visited.end()) {
+					continue;
+				}
+				visited.push_back(include_path);
+
+				std::string include_source;
+				if (!read_include(include_path, include_source)) {
+					// The compile is going to fail and report it, nothing to cache anyway
+					hash = utils::fnv1a_64("<missing>", 9, hash);
+					continue;
+				}
+
+				hash = hash_source_recursive(include_path, include_source, read_include, visited, hash);
+			}
+
+			return hash;
+		}
+	}
+
+	std::string ShaderCacheKey::to_string() const {
+		char source_hash_hex[17];
+		snprintf(source_hash_hex, sizeof(source_hash_hex), "%016llx", static_cast<unsigned long long>(source_hash));
+
+		return std::string("source=") + source_hash_hex
+			+ ";entry=" + entry
+			+ ";profile=" + profile
+			+ ";flags=" + std::to_string(flags)
+			+ ";compiler=" + std::to_string(compiler_version);
+	}
+
+	uint64_t ShaderCacheKey::hash() const {
+		return utils::fnv1a_64(to_string());
+	}
+
+	std::optional<uint64_t> hash_shader_source(const std::filesystem::path& path) {
+		std::string source;
+		if (!read_file(path, source)) {
+			return std::nullopt;
+		}
+
+		return hash_shader_source(path, source, read_file);
+	}
+
+	std::optional<uint64_t> hash_shader_source(
+		const std::filesystem::path& path,
+		const std::string& source,
+		const ShaderIncludeReader& read_include
+	) {
+		std::vector<std::filesystem::path> visited = { path.lexically_normal() };
+		return hash_source_recursive(path, source, read_include, visited, utils::FNV1A_64_SEED);
+	}
+
+	ShaderCache::ShaderCache(const std::filesystem::path& directory)
+		: _directory(directory) {
+		std::error_code error;
+		std::filesystem::create_directories(_directory, error);
+		if (error) {
+			std::cerr << "Can't create shader cache directory '" << _directory.string() << "': " << error.message() << "\n";
+		}
+	}
+
+	std::filesystem::path ShaderCache::entry_path(const ShaderCacheKey& key) const {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.dvsc", static_cast<unsigned long long>(key.hash()));
+		return _directory / name;
+	}
+
+	bool ShaderCache::load(const ShaderCacheKey& key, std::vector<char>& bytecode) const {
+		const std::filesystem::path path = entry_path(key);
+
+		bool valid = false;
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file) {
+				return false;
+			}
+
+			const std::string key_string = key.to_string();
+
+			std::error_code error;
+			const uintmax_t file_size = std::filesystem::file_size(path, error);
+
+			ShaderCacheFileHeader header;
+			file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+			// The sizes are checked against the file before anything is allocated with them
+			valid = file
+				&& !error
+				&& header.magic == MAGIC
+				&& header.version == VERSION
+				&& header.key_hash == key.hash()
+				&& header.key_size == key_string.size()
+				&& file_size == sizeof(header) + uintmax_t(header.key_size) + header.bytecode_size;
+
+			if (valid) {
+				std::string stored_key(header.key_size, '\0');
+				file.read(stored_key.data(), header.key_size);
+				valid = file && stored_key == key_string;
+			}
+
+			if (valid) {
+				bytecode.resize(header.bytecode_size);
+				file.read(bytecode.data(), header.bytecode_size);
+				valid = file && utils::fnv1a_64(bytecode.data(), bytecode.size()) == header.bytecode_hash;
+			}
+		}
+
+		if (!valid) {
+			bytecode.clear();
+
+			std::error_code error;
+			std::filesystem::remove(path, error);
+		}
+
+		return valid;
+	}
+
+	void ShaderCache::store(const ShaderCacheKey& key, const void* bytecode, size_t bytecode_size) const {
+		const std::filesystem::path path = entry_path(key);
+		std::filesystem::path temp_path = path;
+		temp_path += ".tmp";
+
+		const std::string key_string = key.to_string();
+
+		ShaderCacheFileHeader header;
+		header.key_hash = key.hash();
+		header.bytecode_hash = utils::fnv1a_64(bytecode, bytecode_size);
+		header.key_size = static_cast<uint32_t>(key_string.size());
+		header.bytecode_size = static_cast<uint32_t>(bytecode_size);
+
+		{
+			std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				std::cerr << "Can't write shader cache entry '" << temp_path.string() << "'\n";
+				return;
+			}
+
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(key_string.data(), key_string.size());
+			file.write(static_cast<const char*>(bytecode), bytecode_size);
+			file.close();
+			if (!file) {
+				// Never renamed, so the entry isn't there at all instead of half written
+				std::cerr << "Can't write shader cache entry '" << temp_path.string() << "'\n";
+				std::error_code error;
+				std::filesystem::remove(temp_path, error);
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temp_path, path, error);
+		if (error) {
+			std::filesystem::remove(temp_path, error);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "pch.h"
+
+namespace dvig {
+	// Everything that changes the compiled bytecode
+	struct ShaderCacheKey {
+		uint64_t source_hash = 0; // hash_shader_source() of the file and its includes
+		std::string entry;        // e.g. "vertex_main"
+		std::string profile;      // e.g. "vs_4_0"
+		uint32_t flags = 0;       // Compile flags
+		uint32_t compiler_version = 0;
+
+		// Stored in the cache file and compared on load, so hash collisions can't return wrong bytecode
+		std::string to_string() const;
+		uint64_t hash() const;
+	};
+
+	// Hashes the file content together with every file it pulls in with #include "...".
+	// Includes are resolved relative to the including file, like D3D_COMPILE_STANDARD_FILE_INCLUDE.
+	// Returns std::nullopt when the file or one of its includes can't be read.
+	std::optional<uint64_t> hash_shader_source(const std::filesystem::path& path);
+
+	// Same as above for source already in memory. read_include gets the include path
+	// relative to the including file's directory and returns false when it doesn't exist.
+	using ShaderIncludeReader = std::function<bool(const std::filesystem::path& path, std::string& content)>;
+	std::optional<uint64_t> hash_shader_source(
+		const std::filesystem::path& path,
+		const std::string& source,
+		const ShaderIncludeReader& read_include
+	);
+
+	// On disk bytecode cache, one file per key.
+	// File: ShaderCacheFileHeader, key string, bytecode.
+	// A file whose header, key or bytecode hash doesn't match is treated as a miss and removed.
+	// Different keys go to different files, so load/store from several threads is fine.
+	class ShaderCache {
+	public:
+		static constexpr uint32_t MAGIC = 0x43535644; // "DVSC"
+		static constexpr uint32_t VERSION = 1;
+
+		explicit ShaderCache(const std::filesystem::path& directory);
+
+		bool load(const ShaderCacheKey& key, std::vector<char>& bytecode) const;
+		// Writes to a temporary file first so a crash never leaves a half written entry
+		void store(const ShaderCacheKey& key, const void* bytecode, size_t bytecode_size) const;
+
+		std::filesystem::path entry_path(const ShaderCacheKey& key) const;
+		const std::filesystem::path& directory() const { return _directory; }
+
+	private:
+		std::filesystem::path _directory;
+	};
+
+	struct ShaderCacheFileHeader {
+		uint32_t magic = ShaderCache::MAGIC;
+		uint32_t version = ShaderCache::VERSION;
+		uint64_t key_hash = 0;
+		uint64_t bytecode_hash = 0;
+		uint32_t key_size = 0;
+		uint32_t bytecode_size = 0;
+	};
+}
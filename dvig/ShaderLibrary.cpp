@@ -0,0 +1,221 @@
+#include "pch.h"
+#include "ShaderLibrary.h"
+#include "ShaderCache.h"
+#include "Memory.h"
+
+namespace dvig {
+	ShaderLibrary::ShaderLibrary(RenderBackend& backend)
+		: _backend(backend) {
+	}
+
+	ShaderLibrary::~ShaderLibrary() {
+		stop();
+	}
+
+	void ShaderLibrary::add(
+		VertexShaderHandle shader,
+		const std::wstring& shader_path,
+		const std::vector<VertexElement>& layout,
+		uint32_t uniform_buffer_size,
+		const std::string& main_name
+	) {
+		VertexEntry entry;
+		entry.shader = shader;
+		entry.path = shader_path;
+		entry.layout = layout;
+		entry.uniform_buffer_size = uniform_buffer_size;
+		entry.main_name = main_name;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_vertex_entries.push_back(std::move(entry));
+		watch(shader_path);
+	}
+
+	void ShaderLibrary::add(PixelShaderHandle shader, const std::wstring& shader_path, const std::string& main_name) {
+		PixelEntry entry;
+		entry.shader = shader;
+		entry.path = shader_path;
+		entry.main_name = main_name;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pixel_entries.push_back(std::move(entry));
+		watch(shader_path);
+	}
+
+	void ShaderLibrary::remove(VertexShaderHandle shader) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto entry_matches = [&](const VertexEntry& entry) { return entry.shader == shader; };
+		auto pending_matches = [&](const PendingVertex& pending) { return pending.target == shader; };
+		_vertex_entries.erase(std::remove_if(_vertex_entries.begin(), _vertex_entries.end(), entry_matches), _vertex_entries.end());
+		_pending_vertex.erase(std::remove_if(_pending_vertex.begin(), _pending_vertex.end(), pending_matches), _pending_vertex.end());
+	}
+
+	void ShaderLibrary::remove(PixelShaderHandle shader) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto entry_matches = [&](const PixelEntry& entry) { return entry.shader == shader; };
+		auto pending_matches = [&](const PendingPixel& pending) { return pending.target == shader; };
+		_pixel_entries.erase(std::remove_if(_pixel_entries.begin(), _pixel_entries.end(), entry_matches), _pixel_entries.end());
+		_pending_pixel.erase(std::remove_if(_pending_pixel.begin(), _pending_pixel.end(), pending_matches), _pending_pixel.end());
+	}
+
+	void ShaderLibrary::watch(const std::wstring& shader_path) {
+		for (const WatchedFile& file : _files) {
+			if (file.path == shader_path) {
+				return;
+			}
+		}
+
+		WatchedFile file;
+		file.path = shader_path;
+		file.source_hash = hash_shader_source(shader_path);
+		_files.push_back(file);
+	}
+
+	void ShaderLibrary::start(std::chrono::milliseconds poll_interval) {
+		assert(!_watcher.joinable());
+
+		_quit = false;
+		_watcher = std::thread(&ShaderLibrary::watcher_main, this, poll_interval);
+	}
+
+	void ShaderLibrary::stop() {
+		if (!_watcher.joinable()) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_quit_cv.notify_all();
+		_watcher.join();
+	}
+
+	void ShaderLibrary::poll() {
+		std::vector<VertexEntry> vertex_entries;
+		std::vector<PixelEntry> pixel_entries;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			std::vector<WatchedFile> files = _files;
+			lock.unlock();
+
+			// NOTE: Hashing reads the files, so it's done without holding the lock
+			std::vector<std::wstring> changed;
+			for (WatchedFile& file : files) {
+				std::optional<uint64_t> source_hash = hash_shader_source(file.path);
+				if (source_hash.has_value() && source_hash != file.source_hash) {
+					changed.push_back(file.path);
+				}
+				file.source_hash = source_hash;
+			}
+
+			lock.lock();
+			for (WatchedFile& file : _files) {
+				for (const WatchedFile& polled : files) {
+					if (polled.path == file.path) {
+						file.source_hash = polled.source_hash;
+					}
+				}
+			}
+
+			if (changed.empty()) {
+				return;
+			}
+
+			auto is_changed = [&](const std::wstring& path) {
+				return std::find(changed.begin(), changed.end(), path) != changed.end();
+			};
+
+			for (const VertexEntry& entry : _vertex_entries) {
+				if (is_changed(entry.path)) {
+					vertex_entries.push_back(entry);
+				}
+			}
+
+			for (const PixelEntry& entry : _pixel_entries) {
+				if (is_changed(entry.path)) {
+					pixel_entries.push_back(entry);
+				}
+			}
+		}
+
+		for (const VertexEntry& entry : vertex_entries) {
+			std::string error;
+			Shared<VertexShader> compiled = _backend.try_compile_vertex_shader(entry.path, entry.layout, entry.uniform_buffer_size, entry.main_name, error);
+			if (compiled == nullptr) {
+				std::cerr << "Shader reload failed, keeping the old version:\n" << error << "\n";
+				_failed_reload_count++;
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pending_vertex.push_back({ entry.shader, compiled });
+		}
+
+		for (const PixelEntry& entry : pixel_entries) {
+			std::string error;
+			Shared<PixelShader> compiled = _backend.try_compile_pixel_shader(entry.path, entry.main_name, error);
+			if (compiled == nullptr) {
+				std::cerr << "Shader reload failed, keeping the old version:\n" << error << "\n";
+				_failed_reload_count++;
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pending_pixel.push_back({ entry.shader, compiled });
+		}
+	}
+
+	bool ShaderLibrary::has_pending_reloads() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return !_pending_vertex.empty() || !_pending_pixel.empty();
+	}
+
+	uint32_t ShaderLibrary::apply_reloads() {
+		std::vector<PendingVertex> pending_vertex;
+		std::vector<PendingPixel> pending_pixel;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_pending_vertex.empty() && _pending_pixel.empty()) {
+				return 0;
+			}
+
+			pending_vertex.swap(_pending_vertex);
+			pending_pixel.swap(_pending_pixel);
+		}
+
+		uint32_t replaced = 0;
+		for (PendingVertex& pending : pending_vertex) {
+			// Destroyed since, the handle is stale
+			if (VertexShader* target = _backend.find(pending.target)) {
+				_backend.replace(*target, *pending.compiled);
+				replaced++;
+			}
+		}
+
+		for (PendingPixel& pending : pending_pixel) {
+			if (PixelShader* target = _backend.find(pending.target)) {
+				_backend.replace(*target, *pending.compiled);
+				replaced++;
+			}
+		}
+
+		_reload_count += replaced;
+		return replaced;
+	}
+
+	void ShaderLibrary::watcher_main(std::chrono::milliseconds poll_interval) {
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				if (_quit_cv.wait_for(lock, poll_interval, [this] { return _quit; })) {
+					return;
+				}
+			}
+
+			poll();
+		}
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "RenderBackend.h"
+
+namespace dvig {
+	// Remembers how every shader was compiled and watches the source files.
+	// A changed file (or one of its includes) is recompiled on the watcher thread,
+	// the result is swapped into the existing shader object by apply_reloads() at a frame boundary.
+	// When the new version doesn't compile the old one stays and the error is printed.
+	class ShaderLibrary {
+	public:
+		ShaderLibrary(RenderBackend& backend);
+		~ShaderLibrary();
+
+		void add(
+			VertexShaderHandle shader,
+			const std::wstring& shader_path,
+			const std::vector<VertexElement>& layout,
+			uint32_t uniform_buffer_size,
+			const std::string& main_name
+		);
+		void add(PixelShaderHandle shader, const std::wstring& shader_path, const std::string& main_name);
+		// Stops reloading the shader, a reload already compiled for it is dropped
+		void remove(VertexShaderHandle shader);
+		void remove(PixelShaderHandle shader);
+
+		// Starts the watcher thread, which calls poll() every poll_interval
+		void start(std::chrono::milliseconds poll_interval = std::chrono::milliseconds(250));
+		void stop();
+
+		// Checks every watched file and recompiles the shaders of the changed ones on the calling thread
+		void poll();
+
+		bool has_pending_reloads();
+
+		// Swaps recompiled shaders in. Call on the recording thread between frames, with no frame in flight.
+		// Returns how many shaders were replaced
+		uint32_t apply_reloads();
+
+		uint32_t reload_count() const { return _reload_count; }
+		uint32_t failed_reload_count() const { return _failed_reload_count; }
+
+	private:
+		struct VertexEntry {
+			VertexShaderHandle shader;
+			std::wstring path;
+			std::vector<VertexElement> layout;
+			uint32_t uniform_buffer_size = 0;
+			std::string main_name;
+		};
+
+		struct PixelEntry {
+			PixelShaderHandle shader;
+			std::wstring path;
+			std::string main_name;
+		};
+
+		struct WatchedFile {
+			std::wstring path;
+			std::optional<uint64_t> source_hash; // std::nullopt while the file can't be read
+		};
+
+		struct PendingVertex {
+			VertexShaderHandle target;
+			Shared<VertexShader> compiled;
+		};
+
+		struct PendingPixel {
+			PixelShaderHandle target;
+			Shared<PixelShader> compiled;
+		};
+
+		void watch(const std::wstring& shader_path);
+		void watcher_main(std::chrono::milliseconds poll_interval);
+
+	private:
+		RenderBackend& _backend;
+
+		// Guards everything below except the thread itself
+		std::mutex _mutex;
+		std::vector<VertexEntry> _vertex_entries;
+		std::vector<PixelEntry> _pixel_entries;
+		std::vector<WatchedFile> _files;
+		std::vector<PendingVertex> _pending_vertex;
+		std::vector<PendingPixel> _pending_pixel;
+
+		std::atomic<uint32_t> _reload_count = 0;
+		std::atomic<uint32_t> _failed_reload_count = 0;
+
+		std::thread _watcher;
+		std::condition_variable _quit_cv;
+		bool _quit = false;
+	};
+}
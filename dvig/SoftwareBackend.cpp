@@ -0,0 +1,974 @@
+#include "pch.h"
+#include "SoftwareBackend.h"
+#include "App.h"
+#include "Renderer.h"
+#include "QuadBatch.h"
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define DVIG_RASTER_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define DVIG_RASTER_SSE2 1
+#endif
+
+namespace dvig {
+	namespace {
+		constexpr int32_t SUBPIXEL_BITS = 4;
+		constexpr int32_t SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+		constexpr int32_t SUBPIXEL_HALF = SUBPIXEL_ONE / 2;
+
+		// Snapped coordinates have to stay within +-2^17 subpixels, so edge deltas fit in 18 bits
+		// and edge values inside a tile fit in int32. Triangles crossing it get clipped.
+		constexpr float GUARD_BAND = 8192.0f;
+
+	#if defined(DVIG_RASTER_AVX2)
+		constexpr int32_t LANES = 8;
+	#elif defined(DVIG_RASTER_SSE2)
+		constexpr int32_t LANES = 4;
+	#else
+		constexpr int32_t LANES = 1;
+	#endif
+
+		static_assert(SoftwareBackend::TILE_SIZE % 8 == 0, "Tile rows have to be a multiple of the SIMD width");
+
+		// Sutherland-Hodgman against the guard band box. Returns the vertex count of the result.
+		int clip_to_guard_band(const glm::vec2 triangle[3], glm::vec2 result[8]) {
+			glm::vec2 buffer_a[8];
+			glm::vec2 buffer_b[8];
+			int count = 3;
+			for (int i = 0; i < 3; ++i) {
+				buffer_a[i] = triangle[i];
+			}
+
+			glm::vec2* in = buffer_a;
+			glm::vec2* out = buffer_b;
+
+			for (int plane = 0; plane < 4; ++plane) {
+				const int axis = plane / 2;
+				const float sign = (plane % 2 == 0) ? 1.0f : -1.0f;
+
+				// Inside when sign * p[axis] <= GUARD_BAND
+				int out_count = 0;
+				for (int i = 0; i < count; ++i) {
+					const glm::vec2 current = in[i];
+					const glm::vec2 next = in[(i + 1) % count];
+					const float d_current = GUARD_BAND - sign * current[axis];
+					const float d_next = GUARD_BAND - sign * next[axis];
+
+					if (d_current >= 0.0f) {
+						out[out_count++] = current;
+					}
+
+					if ((d_current >= 0.0f) != (d_next >= 0.0f)) {
+						const float t = d_current / (d_current - d_next);
+						out[out_count++] = current + (next - current) * t;
+					}
+				}
+
+				std::swap(in, out);
+				count = out_count;
+				if (count == 0) {
+					return 0;
+				}
+			}
+
+			for (int i = 0; i < count; ++i) {
+				result[i] = in[i];
+			}
+
+			return count;
+		}
+
+		// Writes color to row[x] for x in [x0, x1] where all three edge values are >= 0.
+		// row_e is the edge value at xs (x0 aligned down to LANES), step is the per pixel increment.
+		void fill_span(
+			uint32_t* row, int32_t xs, int32_t x0, int32_t x1,
+			const int32_t row_e[3], const int32_t step[3], uint32_t color
+		) {
+		#if defined(DVIG_RASTER_AVX2)
+			__m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(row_e[0]), _mm256_mullo_epi32(_mm256_set1_epi32(step[0]), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+			__m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(row_e[1]), _mm256_mullo_epi32(_mm256_set1_epi32(step[1]), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+			__m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(row_e[2]), _mm256_mullo_epi32(_mm256_set1_epi32(step[2]), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+			const __m256i step0 = _mm256_set1_epi32(step[0] * LANES);
+			const __m256i step1 = _mm256_set1_epi32(step[1] * LANES);
+			const __m256i step2 = _mm256_set1_epi32(step[2] * LANES);
+
+			__m256i x = _mm256_add_epi32(_mm256_set1_epi32(xs), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+			const __m256i x_step = _mm256_set1_epi32(LANES);
+			const __m256i x_lo = _mm256_set1_epi32(x0 - 1);
+			const __m256i x_hi = _mm256_set1_epi32(x1 + 1);
+			const __m256i color_v = _mm256_set1_epi32(static_cast<int>(color));
+
+			for (int32_t px = xs; px <= x1; px += LANES) {
+				const __m256i outside = _mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(e0, e1), e2), 31);
+				const __m256i in_span = _mm256_and_si256(_mm256_cmpgt_epi32(x, x_lo), _mm256_cmpgt_epi32(x_hi, x));
+				const __m256i mask = _mm256_andnot_si256(outside, in_span);
+
+				if (_mm256_movemask_epi8(mask)) {
+					__m256i* dst = reinterpret_cast<__m256i*>(row + px);
+					const __m256i pixels = _mm256_loadu_si256(dst);
+					_mm256_storeu_si256(dst, _mm256_blendv_epi8(pixels, color_v, mask));
+				}
+
+				e0 = _mm256_add_epi32(e0, step0);
+				e1 = _mm256_add_epi32(e1, step1);
+				e2 = _mm256_add_epi32(e2, step2);
+				x = _mm256_add_epi32(x, x_step);
+			}
+		#elif defined(DVIG_RASTER_SSE2)
+			// NOTE: No _mm_mullo_epi32 in SSE2, lane offsets are built by hand
+			__m128i e0 = _mm_add_epi32(_mm_set1_epi32(row_e[0]), _mm_setr_epi32(0, step[0], step[0] * 2, step[0] * 3));
+			__m128i e1 = _mm_add_epi32(_mm_set1_epi32(row_e[1]), _mm_setr_epi32(0, step[1], step[1] * 2, step[1] * 3));
+			__m128i e2 = _mm_add_epi32(_mm_set1_epi32(row_e[2]), _mm_setr_epi32(0, step[2], step[2] * 2, step[2] * 3));
+			const __m128i step0 = _mm_set1_epi32(step[0] * LANES);
+			const __m128i step1 = _mm_set1_epi32(step[1] * LANES);
+			const __m128i step2 = _mm_set1_epi32(step[2] * LANES);
+
+			__m128i x = _mm_setr_epi32(xs, xs + 1, xs + 2, xs + 3);
+			const __m128i x_step = _mm_set1_epi32(LANES);
+			const __m128i x_lo = _mm_set1_epi32(x0 - 1);
+			const __m128i x_hi = _mm_set1_epi32(x1 + 1);
+			const __m128i color_v = _mm_set1_epi32(static_cast<int>(color));
+
+			for (int32_t px = xs; px <= x1; px += LANES) {
+				const __m128i outside = _mm_srai_epi32(_mm_or_si128(_mm_or_si128(e0, e1), e2), 31);
+				const __m128i in_span = _mm_and_si128(_mm_cmpgt_epi32(x, x_lo), _mm_cmplt_epi32(x, x_hi));
+				const __m128i mask = _mm_andnot_si128(outside, in_span);
+
+				if (_mm_movemask_epi8(mask)) {
+					__m128i* dst = reinterpret_cast<__m128i*>(row + px);
+					const __m128i pixels = _mm_loadu_si128(dst);
+					_mm_storeu_si128(dst, _mm_or_si128(_mm_andnot_si128(mask, pixels), _mm_and_si128(mask, color_v)));
+				}
+
+				e0 = _mm_add_epi32(e0, step0);
+				e1 = _mm_add_epi32(e1, step1);
+				e2 = _mm_add_epi32(e2, step2);
+				x = _mm_add_epi32(x, x_step);
+			}
+		#else
+			int32_t e0 = row_e[0] + step[0] * (x0 - xs);
+			int32_t e1 = row_e[1] + step[1] * (x0 - xs);
+			int32_t e2 = row_e[2] + step[2] * (x0 - xs);
+
+			for (int32_t px = x0; px <= x1; ++px) {
+				if ((e0 | e1 | e2) >= 0) {
+					row[px] = color;
+				}
+
+				e0 += step[0];
+				e1 += step[1];
+				e2 += step[2];
+			}
+		#endif
+		}
+
+		int32_t address_texel(int32_t i, int32_t size, TextureAddress address) {
+			if (address == TextureAddress::Wrap) {
+				const int32_t wrapped = i % size;
+				return wrapped < 0 ? wrapped + size : wrapped;
+			}
+			return std::clamp(i, 0, size - 1);
+		}
+
+		// Mip 0 only
+		uint32_t sample_texture(const HeadlessTexture2D& texture, const SamplerDesc& sampler, float u, float v) {
+			const int32_t width = static_cast<int32_t>(texture.width);
+			const int32_t height = static_cast<int32_t>(texture.height);
+			auto texel = [&](int32_t x, int32_t y) {
+				uint32_t value;
+				const size_t index = static_cast<size_t>(address_texel(y, height, sampler.address)) * width + address_texel(x, width, sampler.address);
+				memcpy(&value, texture.data.data() + index * sizeof(uint32_t), sizeof(value));
+				return value;
+			};
+
+			// Clamped before the conversion, wrapping only cares about the fraction
+			const float limit = 1 << 20;
+			const float x = std::clamp(u * width, -limit, limit);
+			const float y = std::clamp(v * height, -limit, limit);
+
+			if (sampler.filter == TextureFilter::Point) {
+				return texel(static_cast<int32_t>(std::floor(x)), static_cast<int32_t>(std::floor(y)));
+			}
+
+			const float fx = x - 0.5f;
+			const float fy = y - 0.5f;
+			const int32_t x0 = static_cast<int32_t>(std::floor(fx));
+			const int32_t y0 = static_cast<int32_t>(std::floor(fy));
+			const float tx = fx - x0;
+			const float ty = fy - y0;
+
+			const uint32_t t00 = texel(x0, y0);
+			const uint32_t t10 = texel(x0 + 1, y0);
+			const uint32_t t01 = texel(x0, y0 + 1);
+			const uint32_t t11 = texel(x0 + 1, y0 + 1);
+
+			uint32_t result = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8) {
+				const float top = ((t00 >> shift) & 0xff) * (1.0f - tx) + ((t10 >> shift) & 0xff) * tx;
+				const float bottom = ((t01 >> shift) & 0xff) * (1.0f - tx) + ((t11 >> shift) & 0xff) * tx;
+				const uint32_t channel = static_cast<uint32_t>(top * (1.0f - ty) + bottom * ty + 0.5f);
+				result |= std::min(channel, 255u) << shift;
+			}
+			return result;
+		}
+
+		uint32_t modulate_rgba8(uint32_t a, uint32_t b) {
+			uint32_t result = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8) {
+				const uint32_t channel = (((a >> shift) & 0xff) * ((b >> shift) & 0xff) + 127) / 255;
+				result |= channel << shift;
+			}
+			return result;
+		}
+
+		uint32_t scale_rgba8(uint32_t color, float scale) {
+			uint32_t result = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8) {
+				const uint32_t channel = static_cast<uint32_t>(((color >> shift) & 0xff) * scale + 0.5f);
+				result |= channel << shift;
+			}
+			return result;
+		}
+
+		// src + dst * (1 - src.a), every channel
+		uint32_t blend_premultiplied(uint32_t src, uint32_t dst) {
+			const uint32_t inverse_alpha = 255 - (src >> 24);
+			uint32_t result = 0;
+			for (uint32_t shift = 0; shift < 32; shift += 8) {
+				const uint32_t channel = ((src >> shift) & 0xff) + (((dst >> shift) & 0xff) * inverse_alpha + 127) / 255;
+				result |= std::min(channel, 255u) << shift;
+			}
+			return result;
+		}
+	}
+
+	SoftwareBackend::SoftwareBackend(uint32_t worker_count) {
+		if (worker_count == 0) {
+			const uint32_t hardware_threads = std::thread::hardware_concurrency();
+			worker_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+		}
+
+		_workers.reserve(worker_count);
+		for (uint32_t i = 0; i < worker_count; ++i) {
+			_workers.emplace_back(&SoftwareBackend::worker_main, this);
+		}
+	}
+
+	SoftwareBackend::~SoftwareBackend() {
+		{
+			std::lock_guard<std::mutex> lock(_pool_mutex);
+			_quit = true;
+		}
+		_work_cv.notify_all();
+
+		for (std::thread& worker : _workers) {
+			worker.join();
+		}
+	}
+
+	void SoftwareBackend::init(const AppSpec& app_spec, void* native_window) {
+		HeadlessBackend::init(app_spec, native_window);
+
+		_width = static_cast<int32_t>(app_spec.width);
+		_height = static_cast<int32_t>(app_spec.height);
+		assert(_width > 0 && _height > 0);
+
+		_tiles_x = (_width + TILE_SIZE - 1) / TILE_SIZE;
+		_tiles_y = (_height + TILE_SIZE - 1) / TILE_SIZE;
+		_stride = _tiles_x * TILE_SIZE;
+
+		_framebuffer.assign(static_cast<size_t>(_stride) * _tiles_y * TILE_SIZE, 0);
+		_tile_bins.resize(static_cast<size_t>(_tiles_x) * _tiles_y);
+		_active_tiles.reserve(_tile_bins.size());
+		_triangles.reserve(1 << 16);
+	}
+
+	void SoftwareBackend::clear_color(const glm::vec4& color) {
+		HeadlessBackend::clear_color(color);
+
+		// NOTE: The clear ignores the viewport and covers everything,
+		//       so pending triangles would be overwritten anyway.
+		for (uint32_t tile : _active_tiles) {
+			_tile_bins[tile].clear();
+		}
+		_active_tiles.clear();
+		_triangles.clear();
+		_texture_mappings.clear();
+
+		std::fill(_framebuffer.begin(), _framebuffer.end(), pack_color_rgba8(color));
+	}
+
+	void SoftwareBackend::present(int VSync) {
+		resolve();
+
+		_last_frame_software_stats = _software_stats;
+		_software_stats = {};
+
+		HeadlessBackend::present(VSync);
+	}
+
+	void SoftwareBackend::collect_resources(uint64_t executed_frames) {
+		HeadlessBackend::collect_resources(executed_frames);
+		_software_vertex_shaders.collect(executed_frames);
+	}
+
+	Shared<VertexShader> SoftwareBackend::try_compile_vertex_shader(
+		const std::wstring& shader_path,
+		const std::vector<VertexElement>& layout,
+		uint32_t uniform_buffer_size,
+		const std::string& main_name,
+		std::string& error
+	) {
+		Shared<SoftwareVertexShader> shader = std::make_shared<SoftwareVertexShader>();
+		fill_vertex_shader(*shader, shader_path, layout, uniform_buffer_size, main_name);
+
+		const std::wstring file_name = std::filesystem::path(shader_path).filename().wstring();
+		if (file_name == L"mesh_2d.hlsl") {
+			shader->program = SoftwareProgram::Mesh2D;
+		} else if (file_name == L"mesh_2d_batched.hlsl") {
+			shader->program = SoftwareProgram::Mesh2DBatched;
+		} else if (file_name == L"mesh_2d_instanced.hlsl") {
+			shader->program = SoftwareProgram::Mesh2DInstanced;
+		} else if (file_name == L"mesh_2d_textured.hlsl") {
+			shader->program = SoftwareProgram::Mesh2DTextured;
+		} else if (file_name == L"text_2d.hlsl") {
+			shader->program = SoftwareProgram::Text2D;
+		} else {
+			error = "Software backend has no CPU version of shader '" + std::filesystem::path(shader_path).string() + "'";
+			return nullptr;
+		}
+
+		return shader;
+	}
+
+	VertexShaderHandle SoftwareBackend::add(VertexShader&& compiled) {
+		return _software_vertex_shaders.add(std::move(static_cast<SoftwareVertexShader&>(compiled)));
+	}
+
+	void SoftwareBackend::replace(VertexShader& shader, VertexShader& compiled) {
+		HeadlessBackend::replace(shader, compiled);
+		std::swap(static_cast<SoftwareVertexShader&>(shader).program, static_cast<SoftwareVertexShader&>(compiled).program);
+	}
+
+	void SoftwareBackend::draw(uint32_t vertex_count, uint32_t vertex_start_location) {
+		HeadlessBackend::draw(vertex_count, vertex_start_location);
+
+		DrawVertices vertices;
+		vertices.start = vertex_start_location;
+		execute_draw(vertices, vertex_count, 1, 0);
+	}
+
+	void SoftwareBackend::draw_instanced(
+		uint32_t vertex_count, uint32_t instance_count,
+		uint32_t vertex_start_location, uint32_t instance_start_location
+	) {
+		HeadlessBackend::draw_instanced(vertex_count, instance_count, vertex_start_location, instance_start_location);
+
+		DrawVertices vertices;
+		vertices.start = vertex_start_location;
+		execute_draw(vertices, vertex_count, instance_count, instance_start_location);
+	}
+
+	void SoftwareBackend::draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) {
+		HeadlessBackend::draw_indexed(index_count, index_start_location, base_vertex_location);
+
+		auto* index_buffer = static_cast<const HeadlessIndexBuffer*>(_bound_index_buffer);
+		DrawVertices vertices;
+		vertices.start = index_start_location;
+		vertices.indices = index_buffer->data.data();
+		vertices.index_format = index_buffer->format;
+		vertices.base_vertex = base_vertex_location;
+		execute_draw(vertices, index_count, 1, 0);
+	}
+
+	void SoftwareBackend::update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data) {
+		resolve();
+		HeadlessBackend::update(texture, mip, region, data);
+	}
+
+	void SoftwareBackend::resolve() {
+		if (_active_tiles.empty()) {
+			return;
+		}
+
+		_next_tile = 0;
+
+		const bool use_workers = !_workers.empty() && _active_tiles.size() > 1;
+		if (use_workers) {
+			{
+				std::lock_guard<std::mutex> lock(_pool_mutex);
+				_busy_workers = static_cast<uint32_t>(_workers.size());
+				_work_generation++;
+			}
+			_work_cv.notify_all();
+		}
+
+		rasterize_tiles();
+
+		if (use_workers) {
+			std::unique_lock<std::mutex> lock(_pool_mutex);
+			_done_cv.wait(lock, [this] { return _busy_workers == 0; });
+		}
+
+		_software_stats.tiles += static_cast<uint32_t>(_active_tiles.size());
+
+		for (uint32_t tile : _active_tiles) {
+			_tile_bins[tile].clear();
+		}
+		_active_tiles.clear();
+		_triangles.clear();
+		_texture_mappings.clear();
+	}
+
+	void SoftwareBackend::read_pixels(std::vector<uint32_t>& pixels) const {
+		pixels.resize(static_cast<size_t>(_width) * _height);
+		for (int32_t y = 0; y < _height; ++y) {
+			memcpy(pixels.data() + static_cast<size_t>(y) * _width, _framebuffer.data() + static_cast<size_t>(y) * _stride, _width * sizeof(uint32_t));
+		}
+	}
+
+	uint32_t SoftwareBackend::DrawVertices::operator[](uint32_t i) const {
+		if (indices == nullptr) {
+			return start + i;
+		}
+
+		if (index_format == IndexFormat::UInt16) {
+			uint16_t index;
+			memcpy(&index, indices + (start + i) * sizeof(uint16_t), sizeof(index));
+			return static_cast<uint32_t>(index + base_vertex);
+		}
+
+		uint32_t index;
+		memcpy(&index, indices + (start + i) * sizeof(uint32_t), sizeof(index));
+		return static_cast<uint32_t>(static_cast<int64_t>(index) + base_vertex);
+	}
+
+	SoftwareBackend::FetchStream SoftwareBackend::find_stream(const VertexShader& shader, const char* semantic) const {
+		for (const VertexElement& element : shader.layout) {
+			if (std::strcmp(element.semantic, semantic) != 0) {
+				continue;
+			}
+
+			auto* buffer = static_cast<const HeadlessVertexBuffer*>(_bound_vertex_buffers[element.slot]);
+			if (buffer == nullptr) {
+				std::cerr << "Software backend: no vertex buffer bound for '" << semantic << "'\n";
+				abort();
+			}
+
+			FetchStream stream;
+			stream.base = buffer->data.data() + element.offset;
+			stream.stride = _bound_strides[element.slot];
+			stream.count = stream.stride > 0 ? static_cast<uint32_t>(buffer->data.size() / stream.stride) : 0;
+			stream.format = element.format;
+			stream.per_instance = element.per_instance;
+			stream.step_rate = element.instance_step_rate > 0 ? element.instance_step_rate : 1;
+			return stream;
+		}
+
+		std::cerr << "Software backend: shader has no '" << semantic << "' input\n";
+		abort();
+	}
+
+	glm::vec4 SoftwareBackend::fetch(const FetchStream& stream, uint32_t vertex, uint32_t instance) const {
+		const uint32_t index = stream.per_instance ? instance / stream.step_rate : vertex;
+		assert(index < stream.count);
+		const char* data = stream.base + static_cast<size_t>(index) * stream.stride;
+
+		// Missing components default to (0, 0, 0, 1) like the input assembler
+		glm::vec4 result(0.0f, 0.0f, 0.0f, 1.0f);
+		switch (stream.format) {
+			case VertexFormat::Float: memcpy(&result[0], data, sizeof(float) * 1); break;
+			case VertexFormat::Float2: memcpy(&result[0], data, sizeof(float) * 2); break;
+			case VertexFormat::Float3: memcpy(&result[0], data, sizeof(float) * 3); break;
+			case VertexFormat::Float4: memcpy(&result[0], data, sizeof(float) * 4); break;
+			case VertexFormat::RGBA8_UNorm: {
+				uint32_t packed;
+				memcpy(&packed, data, sizeof(packed));
+				for (int i = 0; i < 4; ++i) {
+					result[i] = static_cast<float>((packed >> (i * 8)) & 0xff) / 255.0f;
+				}
+			} break;
+			case VertexFormat::UInt: {
+				uint32_t value;
+				memcpy(&value, data, sizeof(value));
+				result[0] = static_cast<float>(value);
+			} break;
+		}
+
+		return result;
+	}
+
+	void SoftwareBackend::execute_draw(
+		const DrawVertices& vertices, uint32_t vertex_count,
+		uint32_t instance_count, uint32_t instance_start_location
+	) {
+		auto* shader = static_cast<const SoftwareVertexShader*>(_bound_vertex_shader);
+		if (shader == nullptr) {
+			std::cerr << "Software backend: draw without a vertex shader\n";
+			abort();
+		}
+
+		assert(_bound_topology == TopologyType::TriangleList);
+		const uint32_t triangle_count = vertex_count / 3;
+
+		switch (shader->program) {
+			case SoftwareProgram::Mesh2D: {
+				assert(shader->uniform_data.size() >= sizeof(UniformVertex2D));
+				UniformVertex2D uniform;
+				memcpy(&uniform, shader->uniform_data.data(), sizeof(uniform));
+				const uint32_t color = pack_color_rgba8(uniform.color);
+
+				const FetchStream position = find_stream(*shader, "POSITION");
+
+				for (uint32_t instance = instance_start_location; instance < instance_start_location + instance_count; ++instance) {
+					for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+						glm::vec4 clip[3];
+						for (uint32_t i = 0; i < 3; ++i) {
+							const glm::vec4 pos = fetch(position, vertices[triangle * 3 + i], instance);
+							clip[i] = uniform.transform * glm::vec4(pos.x, pos.y, 0.0f, 1.0f);
+						}
+
+						setup_triangle(clip, color);
+					}
+				}
+			} break;
+
+			case SoftwareProgram::Mesh2DBatched: {
+				const FetchStream position = find_stream(*shader, "POSITION");
+				const FetchStream color = find_stream(*shader, "COLOR");
+
+				for (uint32_t instance = instance_start_location; instance < instance_start_location + instance_count; ++instance) {
+					for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+						glm::vec4 clip[3];
+						for (uint32_t i = 0; i < 3; ++i) {
+							const glm::vec4 pos = fetch(position, vertices[triangle * 3 + i], instance);
+							clip[i] = glm::vec4(pos.x, pos.y, 0.0f, 1.0f);
+						}
+
+						// Flat color: the first vertex of the triangle provides it
+						setup_triangle(clip, pack_color_rgba8(fetch(color, vertices[triangle * 3], instance)));
+					}
+				}
+			} break;
+
+			case SoftwareProgram::Mesh2DInstanced: {
+				assert(shader->uniform_data.size() >= sizeof(UniformInstanced2D));
+				UniformInstanced2D uniform;
+				memcpy(&uniform, shader->uniform_data.data(), sizeof(uniform));
+
+				const FetchStream position = find_stream(*shader, "POSITION");
+				const FetchStream instance_pos = find_stream(*shader, "INSTANCE_POS");
+				const FetchStream instance_size = find_stream(*shader, "INSTANCE_SIZE");
+				const FetchStream instance_origin = find_stream(*shader, "INSTANCE_ORIGIN");
+				const FetchStream instance_rotation = find_stream(*shader, "INSTANCE_ROTATION");
+				const FetchStream instance_color = find_stream(*shader, "INSTANCE_COLOR");
+
+				for (uint32_t instance = instance_start_location; instance < instance_start_location + instance_count; ++instance) {
+					const glm::vec2 pos = glm::vec2(fetch(instance_pos, 0, instance));
+					const glm::vec2 size = glm::vec2(fetch(instance_size, 0, instance));
+					const glm::vec2 origin = glm::vec2(fetch(instance_origin, 0, instance));
+					const float rotation = fetch(instance_rotation, 0, instance).x;
+					const uint32_t color = pack_color_rgba8(fetch(instance_color, 0, instance));
+
+					const float s = std::sin(rotation);
+					const float c = std::cos(rotation);
+
+					// Same math as mesh_2d_instanced.hlsl
+					for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+						glm::vec4 clip[3];
+						for (uint32_t i = 0; i < 3; ++i) {
+							const glm::vec2 corner = glm::vec2(fetch(position, vertices[triangle * 3 + i], instance));
+							const glm::vec2 local = (corner - origin) * size;
+							const glm::vec2 rotated = { local.x * c - local.y * s, local.x * s + local.y * c };
+							const glm::vec2 world = pos + origin * size + rotated;
+							clip[i] = uniform.view_projection * glm::vec4(world.x, world.y, 0.0f, 1.0f);
+						}
+
+						setup_triangle(clip, color);
+					}
+				}
+			} break;
+
+			case SoftwareProgram::Mesh2DTextured: {
+				assert(shader->uniform_data.size() >= sizeof(UniformTextured2D));
+				UniformTextured2D uniform;
+				memcpy(&uniform, shader->uniform_data.data(), sizeof(uniform));
+				const uint32_t color = pack_color_rgba8(uniform.color);
+				const glm::vec2 uv_min(uniform.uv_rect.x, uniform.uv_rect.y);
+				const glm::vec2 uv_max(uniform.uv_rect.z, uniform.uv_rect.w);
+
+				const TextureMapping mapping = bound_texture_mapping();
+
+				const FetchStream position = find_stream(*shader, "POSITION");
+				const FetchStream texcoord = find_stream(*shader, "TEXCOORD");
+
+				for (uint32_t instance = instance_start_location; instance < instance_start_location + instance_count; ++instance) {
+					for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+						glm::vec4 clip[3];
+						glm::vec2 uvs[3];
+						for (uint32_t i = 0; i < 3; ++i) {
+							const uint32_t vertex = vertices[triangle * 3 + i];
+							const glm::vec4 pos = fetch(position, vertex, instance);
+							clip[i] = uniform.transform * glm::vec4(pos.x, pos.y, 0.0f, 1.0f);
+							uvs[i] = glm::mix(uv_min, uv_max, glm::vec2(fetch(texcoord, vertex, instance)));
+						}
+
+						setup_triangle(clip, color, uvs, &mapping);
+					}
+				}
+			} break;
+
+			case SoftwareProgram::Text2D: {
+				assert(shader->uniform_data.size() >= sizeof(UniformText2D));
+				UniformText2D uniform;
+				memcpy(&uniform, shader->uniform_data.data(), sizeof(uniform));
+
+				TextureMapping mapping = bound_texture_mapping();
+				mapping.distance_range = uniform.distance_range;
+
+				const FetchStream position = find_stream(*shader, "POSITION");
+				const FetchStream texcoord = find_stream(*shader, "TEXCOORD");
+				const FetchStream color = find_stream(*shader, "COLOR");
+
+				for (uint32_t instance = instance_start_location; instance < instance_start_location + instance_count; ++instance) {
+					for (uint32_t triangle = 0; triangle < triangle_count; ++triangle) {
+						glm::vec4 clip[3];
+						glm::vec2 uvs[3];
+						for (uint32_t i = 0; i < 3; ++i) {
+							const uint32_t vertex = vertices[triangle * 3 + i];
+							const glm::vec4 pos = fetch(position, vertex, instance);
+							clip[i] = glm::vec4(pos.x, pos.y, 0.0f, 1.0f);
+							uvs[i] = glm::vec2(fetch(texcoord, vertex, instance));
+						}
+
+						// Flat color from the first vertex like Mesh2DBatched, premultiplied like the shader does
+						const glm::vec4 straight = fetch(color, vertices[triangle * 3], instance);
+						const glm::vec4 premultiplied(straight.x * straight.w, straight.y * straight.w, straight.z * straight.w, straight.w);
+						setup_triangle(clip, pack_color_rgba8(premultiplied), uvs, &mapping);
+					}
+				}
+			} break;
+		}
+	}
+
+	SoftwareBackend::TextureMapping SoftwareBackend::bound_texture_mapping() const {
+		TextureMapping mapping;
+		mapping.texture = static_cast<const HeadlessTexture2D*>(_bound_textures[0]);
+		if (mapping.texture == nullptr) {
+			std::cerr << "Software backend: no texture bound to slot 0\n";
+			abort();
+		}
+		// Unbound sampler is D3D11's default, linear clamp
+		if (_bound_samplers[0] != nullptr) {
+			mapping.sampler = _bound_samplers[0]->desc;
+		}
+		mapping.blend = _bound_blend_mode == BlendMode::PremultipliedAlpha;
+		return mapping;
+	}
+
+	void SoftwareBackend::setup_triangle(const glm::vec4 clip[3], uint32_t color, const glm::vec2* uvs, const TextureMapping* mapping) {
+		// NOTE: No near plane clipping. The 2D pipeline never produces w <= 0.
+		glm::vec2 pixels[3];
+		bool inside_guard_band = true;
+		for (int i = 0; i < 3; ++i) {
+			if (clip[i].w <= 0.0f) {
+				_software_stats.culled_triangles++;
+				return;
+			}
+
+			const float ndc_x = clip[i].x / clip[i].w;
+			const float ndc_y = clip[i].y / clip[i].w;
+			pixels[i].x = (ndc_x + 1.0f) * 0.5f * _viewport.z + _viewport.x;
+			pixels[i].y = (1.0f - ndc_y) * 0.5f * _viewport.w + _viewport.y;
+
+			inside_guard_band &= std::abs(pixels[i].x) <= GUARD_BAND && std::abs(pixels[i].y) <= GUARD_BAND;
+		}
+
+		uint32_t mapping_index = NO_MAPPING;
+		if (mapping != nullptr) {
+			// UV planes of the whole triangle, before clipping
+			const glm::vec2 d1 = pixels[1] - pixels[0];
+			const glm::vec2 d2 = pixels[2] - pixels[0];
+			const float det = d1.x * d2.y - d2.x * d1.y;
+			if (det == 0.0f) {
+				_software_stats.culled_triangles++;
+				return;
+			}
+
+			auto plane = [&](float f0, float f1, float f2) {
+				const float dx = ((f1 - f0) * d2.y - (f2 - f0) * d1.y) / det;
+				const float dy = ((f2 - f0) * d1.x - (f1 - f0) * d2.x) / det;
+				return glm::vec3(dx, dy, f0 - dx * pixels[0].x - dy * pixels[0].y);
+			};
+
+			TextureMapping triangle_mapping = *mapping;
+			triangle_mapping.u = plane(uvs[0].x, uvs[1].x, uvs[2].x);
+			triangle_mapping.v = plane(uvs[0].y, uvs[1].y, uvs[2].y);
+			if (triangle_mapping.distance_range > 0.0f) {
+				// Same as text_2d.hlsl, where fwidth(uv) is |du/dx| + |du/dy|
+				const float texels_u = (std::abs(triangle_mapping.u.x) + std::abs(triangle_mapping.u.y)) * mapping->texture->width;
+				const float texels_v = (std::abs(triangle_mapping.v.x) + std::abs(triangle_mapping.v.y)) * mapping->texture->height;
+				const float range = 0.5f * triangle_mapping.distance_range * (1.0f / std::max(texels_u, 1e-6f) + 1.0f / std::max(texels_v, 1e-6f));
+				triangle_mapping.screen_range = std::max(range, 1.0f);
+			}
+			mapping_index = static_cast<uint32_t>(_texture_mappings.size());
+			_texture_mappings.push_back(triangle_mapping);
+		}
+
+		if (inside_guard_band) {
+			add_triangle(pixels, color, mapping_index);
+			return;
+		}
+
+		glm::vec2 polygon[8];
+		const int count = clip_to_guard_band(pixels, polygon);
+		if (count < 3) {
+			_software_stats.culled_triangles++;
+			return;
+		}
+
+		for (int i = 1; i + 1 < count; ++i) {
+			const glm::vec2 fan[3] = { polygon[0], polygon[i], polygon[i + 1] };
+			add_triangle(fan, color, mapping_index);
+		}
+	}
+
+	void SoftwareBackend::add_triangle(const glm::vec2 pixels[3], uint32_t color, uint32_t mapping) {
+		int32_t x[3];
+		int32_t y[3];
+		for (int i = 0; i < 3; ++i) {
+			x[i] = static_cast<int32_t>(std::floor(pixels[i].x * SUBPIXEL_ONE + 0.5f));
+			y[i] = static_cast<int32_t>(std::floor(pixels[i].y * SUBPIXEL_ONE + 0.5f));
+		}
+
+		// Clockwise on screen (y down) is front facing
+		const int64_t area = static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(y[1] - y[0]) * (x[2] - x[0]);
+		if (area <= 0) {
+			_software_stats.culled_triangles++;
+			return;
+		}
+
+		// Pixels whose centers are inside the subpixel bounding box
+		const int32_t min_sx = std::min(x[0], std::min(x[1], x[2]));
+		const int32_t max_sx = std::max(x[0], std::max(x[1], x[2]));
+		const int32_t min_sy = std::min(y[0], std::min(y[1], y[2]));
+		const int32_t max_sy = std::max(y[0], std::max(y[1], y[2]));
+
+		RasterTriangle triangle;
+		triangle.min_x = (min_sx - SUBPIXEL_HALF + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS;
+		triangle.max_x = (max_sx - SUBPIXEL_HALF) >> SUBPIXEL_BITS;
+		triangle.min_y = (min_sy - SUBPIXEL_HALF + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS;
+		triangle.max_y = (max_sy - SUBPIXEL_HALF) >> SUBPIXEL_BITS;
+
+		// Viewport scissor
+		const int32_t viewport_x0 = std::max(0, static_cast<int32_t>(std::ceil(_viewport.x)));
+		const int32_t viewport_y0 = std::max(0, static_cast<int32_t>(std::ceil(_viewport.y)));
+		const int32_t viewport_x1 = std::min(_width, static_cast<int32_t>(std::floor(_viewport.x + _viewport.z))) - 1;
+		const int32_t viewport_y1 = std::min(_height, static_cast<int32_t>(std::floor(_viewport.y + _viewport.w))) - 1;
+
+		triangle.min_x = std::max(triangle.min_x, viewport_x0);
+		triangle.min_y = std::max(triangle.min_y, viewport_y0);
+		triangle.max_x = std::min(triangle.max_x, viewport_x1);
+		triangle.max_y = std::min(triangle.max_y, viewport_y1);
+
+		if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+			_software_stats.culled_triangles++;
+			return;
+		}
+
+		for (int i = 0; i < 3; ++i) {
+			const int j = (i + 1) % 3;
+			const int32_t dx = x[j] - x[i];
+			const int32_t dy = y[j] - y[i];
+
+			// E(p) = dx * (p.y - y[i]) - dy * (p.x - x[i])
+			triangle.a[i] = -dy;
+			triangle.b[i] = dx;
+			triangle.c[i] = static_cast<int64_t>(dy) * x[i] - static_cast<int64_t>(dx) * y[i];
+
+			// Top-left rule: pixels exactly on an edge only belong to top and left edges
+			const bool top_left = dy < 0 || (dy == 0 && dx > 0);
+			if (!top_left) {
+				triangle.c[i] -= 1;
+			}
+		}
+
+		triangle.color = color;
+		triangle.mapping = mapping;
+
+		const uint32_t triangle_index = static_cast<uint32_t>(_triangles.size());
+		_triangles.push_back(triangle);
+		_software_stats.triangles++;
+
+		for (int32_t tile_y = triangle.min_y / TILE_SIZE; tile_y <= triangle.max_y / TILE_SIZE; ++tile_y) {
+			for (int32_t tile_x = triangle.min_x / TILE_SIZE; tile_x <= triangle.max_x / TILE_SIZE; ++tile_x) {
+				const uint32_t tile = static_cast<uint32_t>(tile_y * _tiles_x + tile_x);
+				std::vector<uint32_t>& bin = _tile_bins[tile];
+				if (bin.empty()) {
+					_active_tiles.push_back(tile);
+				}
+				bin.push_back(triangle_index);
+			}
+		}
+	}
+
+	void SoftwareBackend::rasterize_tiles() {
+		const uint32_t tile_count = static_cast<uint32_t>(_active_tiles.size());
+		for (uint32_t i = _next_tile.fetch_add(1); i < tile_count; i = _next_tile.fetch_add(1)) {
+			rasterize_tile(_active_tiles[i]);
+		}
+	}
+
+	void SoftwareBackend::rasterize_tile(uint32_t tile_index) {
+		const int32_t tile_x = static_cast<int32_t>(tile_index % _tiles_x) * TILE_SIZE;
+		const int32_t tile_y = static_cast<int32_t>(tile_index / _tiles_x) * TILE_SIZE;
+
+		for (uint32_t triangle_index : _tile_bins[tile_index]) {
+			rasterize_triangle(_triangles[triangle_index], tile_x, tile_y);
+		}
+	}
+
+	void SoftwareBackend::rasterize_triangle(const RasterTriangle& triangle, int32_t tile_x, int32_t tile_y) {
+		const int32_t x0 = std::max(triangle.min_x, tile_x);
+		const int32_t y0 = std::max(triangle.min_y, tile_y);
+		const int32_t x1 = std::min(triangle.max_x, tile_x + TILE_SIZE - 1);
+		const int32_t y1 = std::min(triangle.max_y, tile_y + TILE_SIZE - 1);
+		if (x0 > x1 || y0 > y1) {
+			return;
+		}
+
+		// Classify every edge against the corners of the covered rect.
+		// Edges that contain the whole rect drop out of the per pixel test. For the ones that
+		// cross it the values inside the tile are small enough for int32.
+		const int32_t xs = x0 & ~(LANES - 1); // Stays inside the tile, tiles are a multiple of LANES
+		const int64_t sx0 = static_cast<int64_t>(x0) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+		const int64_t sx1 = static_cast<int64_t>(x1) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+		const int64_t sy0 = static_cast<int64_t>(y0) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+		const int64_t sy1 = static_cast<int64_t>(y1) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+		const int64_t sxs = static_cast<int64_t>(xs) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+
+		int32_t row_e[3];
+		int32_t step_x[3];
+		int32_t step_y[3];
+		bool partial = false;
+
+		for (int i = 0; i < 3; ++i) {
+			const int64_t a = triangle.a[i];
+			const int64_t b = triangle.b[i];
+			const int64_t c = triangle.c[i];
+
+			const int64_t e00 = a * sx0 + b * sy0 + c;
+			const int64_t e10 = a * sx1 + b * sy0 + c;
+			const int64_t e01 = a * sx0 + b * sy1 + c;
+			const int64_t e11 = a * sx1 + b * sy1 + c;
+
+			if (e00 < 0 && e10 < 0 && e01 < 0 && e11 < 0) {
+				return;
+			}
+
+			if (e00 >= 0 && e10 >= 0 && e01 >= 0 && e11 >= 0) {
+				row_e[i] = 0;
+				step_x[i] = 0;
+				step_y[i] = 0;
+				continue;
+			}
+
+			partial = true;
+			row_e[i] = static_cast<int32_t>(a * sxs + b * sy0 + c);
+			step_x[i] = triangle.a[i] * SUBPIXEL_ONE;
+			step_y[i] = triangle.b[i] * SUBPIXEL_ONE;
+		}
+
+		if (triangle.mapping != NO_MAPPING) {
+			for (int32_t y = y0; y <= y1; ++y) {
+				uint32_t* row = _framebuffer.data() + static_cast<size_t>(y) * _stride;
+				shade_span(row, y, xs, x0, x1, row_e, step_x, triangle);
+
+				row_e[0] += step_y[0];
+				row_e[1] += step_y[1];
+				row_e[2] += step_y[2];
+			}
+			return;
+		}
+
+		if (!partial) {
+			for (int32_t y = y0; y <= y1; ++y) {
+				uint32_t* row = _framebuffer.data() + static_cast<size_t>(y) * _stride;
+				std::fill(row + x0, row + x1 + 1, triangle.color);
+			}
+			return;
+		}
+
+		for (int32_t y = y0; y <= y1; ++y) {
+			uint32_t* row = _framebuffer.data() + static_cast<size_t>(y) * _stride;
+			fill_span(row, xs, x0, x1, row_e, step_x, triangle.color);
+
+			row_e[0] += step_y[0];
+			row_e[1] += step_y[1];
+			row_e[2] += step_y[2];
+		}
+	}
+
+	void SoftwareBackend::shade_span(
+		uint32_t* row, int32_t y, int32_t xs, int32_t x0, int32_t x1,
+		const int32_t row_e[3], const int32_t step[3], const RasterTriangle& triangle
+	) const {
+		const TextureMapping& mapping = _texture_mappings[triangle.mapping];
+		const float center_y = y + 0.5f;
+
+		int32_t e0 = row_e[0] + step[0] * (x0 - xs);
+		int32_t e1 = row_e[1] + step[1] * (x0 - xs);
+		int32_t e2 = row_e[2] + step[2] * (x0 - xs);
+
+		for (int32_t px = x0; px <= x1; ++px) {
+			if ((e0 | e1 | e2) >= 0) {
+				const float center_x = px + 0.5f;
+				const float u = mapping.u.x * center_x + mapping.u.y * center_y + mapping.u.z;
+				const float v = mapping.v.x * center_x + mapping.v.y * center_y + mapping.v.z;
+				const uint32_t texel = sample_texture(*mapping.texture, mapping.sampler, u, v);
+
+				uint32_t color;
+				if (mapping.screen_range > 0.0f) {
+					const float distance = static_cast<float>(texel >> 24) / 255.0f;
+					const float coverage = std::clamp((distance - 0.5f) * mapping.screen_range + 0.5f, 0.0f, 1.0f);
+					color = scale_rgba8(triangle.color, coverage);
+				} else {
+					color = modulate_rgba8(texel, triangle.color);
+				}
+
+				row[px] = mapping.blend ? blend_premultiplied(color, row[px]) : color;
+			}
+
+			e0 += step[0];
+			e1 += step[1];
+			e2 += step[2];
+		}
+	}
+
+	void SoftwareBackend::worker_main() {
+		uint64_t seen_generation = 0;
+
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(_pool_mutex);
+				_work_cv.wait(lock, [&] { return _quit || _work_generation != seen_generation; });
+				if (_quit) {
+					return;
+				}
+				seen_generation = _work_generation;
+			}
+
+			rasterize_tiles();
+
+			{
+				std::lock_guard<std::mutex> lock(_pool_mutex);
+				_busy_workers--;
+				if (_busy_workers == 0) {
+					_done_cv.notify_one();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include "pch.h"
+
+#include "HeadlessBackend.h"
+
+namespace dvig {
+	// CPU versions of the core shaders. Picked by shader file name when compiling.
+	enum class SoftwareProgram {
+		Mesh2D,          // mesh_2d.hlsl: POSITION * UniformVertex2D::transform, uniform color
+		Mesh2DBatched,   // mesh_2d_batched.hlsl: pre-transformed POSITION, per vertex COLOR.
+		                 // COLOR isn't interpolated, each triangle is flat in its first vertex's color (batched quads are one color)
+		Mesh2DInstanced, // mesh_2d_instanced.hlsl: unit quad + RectInstance stream
+		Mesh2DTextured,  // mesh_2d_textured.hlsl: Mesh2D + TEXCOORD, texture and sampler slot 0 times the color
+		Text2D,          // text_2d.hlsl: pre-transformed POSITION, TEXCOORD and flat COLOR, distance field coverage from slot 0 alpha
+	};
+
+	struct SoftwareVertexShader : HeadlessVertexShader {
+		SoftwareProgram program = SoftwareProgram::Mesh2D;
+	};
+
+	struct SoftwareStats {
+		uint32_t triangles = 0;        // Triangles that made it to binning
+		uint32_t culled_triangles = 0; // Back facing, degenerate, behind the camera or out of the viewport
+		uint32_t tiles = 0;            // Tiles that had at least one triangle
+	};
+
+	// Executes the core 2D pipeline on the CPU into an RGBA8 framebuffer (R in the lowest byte).
+	// Triangles are set up and binned into 64x64 tiles on the calling thread and
+	// rasterized on present() with the tiles spread across a worker pool.
+	// Edge functions are evaluated in 28.4 fixed point with the D3D top-left rule,
+	// back faces (counter clockwise on screen) are culled like the default D3D11 rasterizer state.
+	// Output only depends on the draws, not on the thread count or SIMD path.
+	// Textured triangles are sampled from mip 0 with affine UVs (fine for the 2D pipeline) on a scalar path,
+	// which is also the only one that blends. Flat color triangles are always opaque.
+	class SoftwareBackend final : public HeadlessBackend {
+	public:
+		static constexpr int32_t TILE_SIZE = 64;
+
+		// worker_count of 0 uses hardware_concurrency() - 1. The calling thread always helps.
+		SoftwareBackend(uint32_t worker_count = 0);
+		~SoftwareBackend();
+
+		RenderBackendType type() const override { return RenderBackendType::Software; }
+
+		void init(const struct AppSpec& app_spec, void* native_window) override;
+		void clear_color(const glm::vec4& color) override;
+		void present(int VSync) override;
+
+		// Vertex shaders are SoftwareVertexShaders, kept in a pool of their own
+		VertexShader* find(VertexShaderHandle shader) const override { return _software_vertex_shaders.find(shader); }
+		void destroy(VertexShaderHandle shader, uint64_t frame) override { _software_vertex_shaders.remove(shader, frame); }
+		void collect_resources(uint64_t executed_frames) override;
+		using HeadlessBackend::find;
+		using HeadlessBackend::destroy;
+
+		Shared<VertexShader> try_compile_vertex_shader(
+			const std::wstring& shader_path,
+			const std::vector<VertexElement>& layout,
+			uint32_t uniform_buffer_size,
+			const std::string& main_name,
+			std::string& error
+		) override;
+		VertexShaderHandle add(VertexShader&& compiled) override;
+		using HeadlessBackend::add;
+		void replace(VertexShader& shader, VertexShader& compiled) override;
+		using HeadlessBackend::replace;
+
+		void draw(uint32_t vertex_count, uint32_t vertex_start_location) override;
+		void draw_instanced(
+			uint32_t vertex_count, uint32_t instance_count,
+			uint32_t vertex_start_location, uint32_t instance_start_location
+		) override;
+		void draw_indexed(uint32_t index_count, uint32_t index_start_location, int32_t base_vertex_location) override;
+
+		// Resolves first, pending triangles may sample the texture
+		void update(Texture2D& texture, uint32_t mip, const TextureRegion& region, const void* data) override;
+		using HeadlessBackend::update;
+
+		// Rasterizes everything drawn so far. present() calls it.
+		void resolve();
+
+		glm::ivec2 framebuffer_size() const { return { _width, _height }; }
+		uint32_t pixel(int32_t x, int32_t y) const { return _framebuffer[y * _stride + x]; }
+		// Tightly packed width * height copy of the framebuffer
+		void read_pixels(std::vector<uint32_t>& pixels) const;
+
+		const SoftwareStats& last_frame_software_stats() const { return _last_frame_software_stats; }
+		uint32_t worker_count() const { return static_cast<uint32_t>(_workers.size()); }
+
+	private:
+		struct RasterTriangle {
+			int32_t min_x, min_y, max_x, max_y; // Inclusive pixel bounds, clamped to the viewport
+			int32_t a[3], b[3];                 // Edge i: a * x + b * y + c >= 0 inside, x/y in 1/16 pixels
+			int64_t c[3];
+			uint32_t color;                     // Tint when textured
+			uint32_t mapping;                   // Into _texture_mappings, NO_MAPPING for flat color
+		};
+
+		static constexpr uint32_t NO_MAPPING = ~0u;
+
+		// u = u.x * x + u.y * y + u.z at pixel x, y, same for v. Clipped triangles share their source's
+		struct TextureMapping {
+			const HeadlessTexture2D* texture = nullptr;
+			SamplerDesc sampler;
+			glm::vec3 u = glm::vec3(0.0f);
+			glm::vec3 v = glm::vec3(0.0f);
+			float distance_range = 0.0f; // Texels the distance field spans, 0 for plain textures
+			float screen_range = 0.0f;   // Same in screen pixels, from the uv planes
+			bool blend = false;          // Premultiplied alpha
+		};
+
+		// One vertex input of the bound shader, resolved against the bound vertex buffers
+		struct FetchStream {
+			const char* base = nullptr;
+			uint32_t stride = 0;
+			uint32_t count = 0; // Elements available in the buffer
+			VertexFormat format = VertexFormat::Float;
+			bool per_instance = false;
+			uint32_t step_rate = 1;
+		};
+
+		// Turns the i-th vertex of a draw into the vertex to fetch, through the index buffer for indexed draws
+		struct DrawVertices {
+			uint32_t start = 0;           // First vertex, or first index
+			const char* indices = nullptr; // nullptr for non indexed draws
+			IndexFormat index_format = IndexFormat::UInt16;
+			int32_t base_vertex = 0;
+
+			uint32_t operator[](uint32_t i) const;
+		};
+
+		FetchStream find_stream(const VertexShader& shader, const char* semantic) const;
+		// Texture and sampler in slot 0 and the blend mode
+		TextureMapping bound_texture_mapping() const;
+		glm::vec4 fetch(const FetchStream& stream, uint32_t vertex, uint32_t instance) const;
+
+		void execute_draw(
+			const DrawVertices& vertices, uint32_t vertex_count,
+			uint32_t instance_count, uint32_t instance_start_location
+		);
+		// uvs and mapping (texture and sampler) are nullptr for flat color
+		void setup_triangle(const glm::vec4 clip[3], uint32_t color, const glm::vec2* uvs = nullptr, const TextureMapping* mapping = nullptr);
+		void add_triangle(const glm::vec2 pixels[3], uint32_t color, uint32_t mapping);
+
+		void rasterize_tiles();
+		void rasterize_tile(uint32_t tile_index);
+		void rasterize_triangle(const RasterTriangle& triangle, int32_t tile_x, int32_t tile_y);
+		void shade_span(
+			uint32_t* row, int32_t y, int32_t xs, int32_t x0, int32_t x1,
+			const int32_t row_e[3], const int32_t step[3], const RasterTriangle& triangle
+		) const;
+
+		void worker_main();
+
+	private:
+		ResourcePool<SoftwareVertexShader, VertexShader> _software_vertex_shaders;
+
+		int32_t _width = 0;
+		int32_t _height = 0;
+		int32_t _stride = 0; // Pixels per row, padded to whole tiles
+		int32_t _tiles_x = 0;
+		int32_t _tiles_y = 0;
+		std::vector<uint32_t> _framebuffer;
+
+		std::vector<RasterTriangle> _triangles;
+		std::vector<TextureMapping> _texture_mappings;
+		std::vector<std::vector<uint32_t>> _tile_bins; // Triangle indices per tile, in submission order
+		std::vector<uint32_t> _active_tiles;           // Tiles with a non empty bin
+
+		SoftwareStats _software_stats;
+		SoftwareStats _last_frame_software_stats;
+
+		// Worker pool
+		std::vector<std::thread> _workers;
+		std::mutex _pool_mutex;
+		std::condition_variable _work_cv;
+		std::condition_variable _done_cv;
+		uint64_t _work_generation = 0;
+		uint32_t _busy_workers = 0;
+		bool _quit = false;
+		std::atomic<uint32_t> _next_tile = 0;
+	};
+}
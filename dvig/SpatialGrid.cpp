@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "SpatialGrid.h"
+
+namespace dvig {
+	SpatialGrid::SpatialGrid(float cell_size)
+		: _cell_size(cell_size), _inverse_cell_size(1.0f / cell_size) {
+		assert(cell_size > 0.0f);
+	}
+
+	SpatialGrid::Handle SpatialGrid::insert(const Rect& bounds, uint64_t user) {
+		Handle handle;
+		if (!_free.empty()) {
+			handle = _free.back();
+			_free.pop_back();
+		} else {
+			handle = static_cast<Handle>(_items.size());
+			_items.emplace_back();
+		}
+
+		_items[handle].user = user;
+		link(handle, bounds, cell_of(bounds));
+		_size++;
+		return handle;
+	}
+
+	void SpatialGrid::update(Handle handle, const Rect& bounds) {
+		assert(valid(handle));
+		Item& item = _items[handle];
+
+		const uint64_t cell = cell_of(bounds);
+		if (cell == item.cell) {
+			cell_entries(cell)[item.slot].bounds = bounds;
+			return;
+		}
+
+		unlink(handle);
+		link(handle, bounds, cell);
+	}
+
+	void SpatialGrid::remove(Handle handle) {
+		assert(valid(handle));
+		unlink(handle);
+		_items[handle].cell = FREE_CELL;
+		_free.push_back(handle);
+		_size--;
+	}
+
+	void SpatialGrid::clear() {
+		_cells.clear();
+		_oversized.clear();
+		_items.clear();
+		_free.clear();
+		_size = 0;
+	}
+
+	int32_t SpatialGrid::cell_coordinate(float position) const {
+		// Clamped as float, converting an out of range float to int is undefined
+		const float cell = std::floor(position * _inverse_cell_size);
+		return static_cast<int32_t>(std::clamp(cell, float(-CELL_LIMIT), float(CELL_LIMIT)));
+	}
+
+	uint64_t SpatialGrid::cell_of(const Rect& bounds) const {
+		const glm::vec2 size = bounds.size();
+		if (size.x > _cell_size || size.y > _cell_size) {
+			return OVERSIZED_CELL;
+		}
+
+		const glm::vec2 center = bounds.center();
+		return cell_key(cell_coordinate(center.x), cell_coordinate(center.y));
+	}
+
+	void SpatialGrid::link(Handle handle, const Rect& bounds, uint64_t cell) {
+		std::vector<Entry>& entries = cell_entries(cell);
+		if (entries.capacity() == 0) {
+			// A new cell, skip growing through 1 and 2
+			entries.reserve(4);
+		}
+
+		_items[handle].cell = cell;
+		_items[handle].slot = static_cast<uint32_t>(entries.size());
+		entries.push_back({ bounds, handle });
+	}
+
+	void SpatialGrid::unlink(Handle handle) {
+		const Item& item = _items[handle];
+		std::vector<Entry>& entries = cell_entries(item.cell);
+
+		// Swap remove, the moved entry's item has to follow
+		if (item.slot != entries.size() - 1) {
+			entries[item.slot] = entries.back();
+			_items[entries[item.slot].handle].slot = item.slot;
+		}
+		entries.pop_back();
+	}
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "pch.h"
+
+#include "Camera.h"
+
+namespace dvig {
+	// Loose uniform grid hashed by cell, for culling lots of small rects against a view.
+	// An item lives in the one cell its center falls in, and queries grow by half a cell to catch the
+	// overhang, so moving an item is a bounds write unless its center changes cell.
+	// Items bigger than a cell go in a list every query checks, keep them rare.
+	// Cells store the bounds next to the handle so a query only walks the cells it overlaps.
+	// A query costs the cells it overlaps plus the items in them, never the total item count.
+	class SpatialGrid {
+	public:
+		using Handle = uint32_t;
+		static constexpr Handle INVALID_HANDLE = ~0u;
+
+		explicit SpatialGrid(float cell_size = 64.0f);
+
+		// user comes back from query()
+		Handle insert(const Rect& bounds, uint64_t user);
+		void update(Handle handle, const Rect& bounds);
+		void remove(Handle handle);
+		void clear();
+
+		// function(Handle, uint64_t user) for every item whose bounds overlap rect.
+		// Don't insert, update or remove from inside the function
+		template<typename Function>
+		void query(const Rect& rect, Function&& function) const;
+
+		bool valid(Handle handle) const { return handle < _items.size() && _items[handle].cell != FREE_CELL; }
+		const Rect& bounds(Handle handle) const { assert(valid(handle)); return cell_entries(_items[handle].cell)[_items[handle].slot].bounds; }
+		uint64_t user(Handle handle) const { assert(valid(handle)); return _items[handle].user; }
+
+		float cell_size() const { return _cell_size; }
+		uint32_t size() const { return _size; }
+		// Cells ever used, empty ones are kept for the next item that comes by
+		uint32_t cell_count() const { return static_cast<uint32_t>(_cells.size()); }
+		uint32_t oversized_count() const { return static_cast<uint32_t>(_oversized.size()); }
+
+	private:
+		struct Entry {
+			Rect bounds;
+			Handle handle;
+		};
+
+		struct Item {
+			uint64_t user = 0;
+			uint64_t cell = FREE_CELL;
+			uint32_t slot = 0; // Index into the cell's entries
+		};
+
+		struct CellHash {
+			size_t operator()(uint64_t key) const {
+				// Neighbouring cells differ in the low bits of either half, mix them over the whole word
+				key ^= key >> 33;
+				key *= 0xff51afd7ed558ccdull;
+				key ^= key >> 33;
+				return static_cast<size_t>(key);
+			}
+		};
+
+		// Cell coordinates are clamped to +-CELL_LIMIT and packed biased, so no key reaches these two
+		static constexpr int32_t CELL_LIMIT = 1 << 30;
+		static constexpr uint64_t OVERSIZED_CELL = ~0ull;
+		static constexpr uint64_t FREE_CELL = ~0ull - 1;
+
+		int32_t cell_coordinate(float position) const;
+		uint64_t cell_key(int32_t x, int32_t y) const { return (uint64_t(uint32_t(x) + uint32_t(CELL_LIMIT)) << 32) | (uint32_t(y) + uint32_t(CELL_LIMIT)); }
+		uint64_t cell_of(const Rect& bounds) const;
+
+		std::vector<Entry>& cell_entries(uint64_t cell) { return cell == OVERSIZED_CELL ? _oversized : _cells[cell]; }
+		const std::vector<Entry>& cell_entries(uint64_t cell) const { return cell == OVERSIZED_CELL ? _oversized : _cells.at(cell); }
+		void link(Handle handle, const Rect& bounds, uint64_t cell);
+		void unlink(Handle handle);
+
+	private:
+		float _cell_size;
+		float _inverse_cell_size;
+		std::unordered_map<uint64_t, std::vector<Entry>, CellHash> _cells;
+		std::vector<Entry> _oversized;
+		std::vector<Item> _items;
+		std::vector<Handle> _free;
+		uint32_t _size = 0;
+	};
+
+	template<typename Function>
+	void SpatialGrid::query(const Rect& rect, Function&& function) const {
+		auto visit = [&](const std::vector<Entry>& entries) {
+			for (const Entry& entry : entries) {
+				if (entry.bounds.overlaps(rect)) {
+					function(entry.handle, _items[entry.handle].user);
+				}
+			}
+		};
+
+		visit(_oversized);
+
+		// Everything in a cell reaches at most half a cell out of it
+		const float loose = _cell_size * 0.5f;
+		const int32_t min_x = cell_coordinate(rect.min.x - loose);
+		const int32_t min_y = cell_coordinate(rect.min.y - loose);
+		const int32_t max_x = cell_coordinate(rect.max.x + loose);
+		const int32_t max_y = cell_coordinate(rect.max.y + loose);
+
+		// Zoomed far out the rect covers more cells than exist, walking the map is cheaper than probing
+		const uint64_t covered = uint64_t(int64_t(max_x) - min_x + 1) * uint64_t(int64_t(max_y) - min_y + 1);
+		if (covered > _cells.size()) {
+			for (const auto& [key, entries] : _cells) {
+				visit(entries);
+			}
+			return;
+		}
+
+		for (int32_t y = min_y; y <= max_y; ++y) {
+			for (int32_t x = min_x; x <= max_x; ++x) {
+				auto it = _cells.find(cell_key(x, y));
+				if (it != _cells.end()) {
+					visit(it->second);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,391 @@
+#include "pch.h"
+#include "TextureAtlas.h"
+#include "Renderer.h"
+#include "Image.h"
+
+namespace dvig {
+	static constexpr uint32_t NO_FIT = ~0u;
+	// Evicting frees at least 1/8 of a page more than the new image needs
+	static constexpr uint64_t EVICTION_HEADROOM_DIVISOR = 8;
+
+	void SkylinePacker::reset(uint32_t width, uint32_t height) {
+		_width = width;
+		_height = height;
+		_used_area = 0;
+		_smallest_failure = glm::uvec2(width + 1, height + 1);
+		_skyline.clear();
+		_skyline.push_back({ 0, 0, width });
+	}
+
+	uint32_t SkylinePacker::used_height() const {
+		uint32_t height = 0;
+		for (const Segment& segment : _skyline) {
+			height = std::max(height, segment.y);
+		}
+		return height;
+	}
+
+	uint32_t SkylinePacker::fit(size_t segment, uint32_t width, uint32_t height) const {
+		const uint32_t x = _skyline[segment].x;
+		if (x + width > _width) {
+			return NO_FIT;
+		}
+
+		// The rect rests on the highest segment below it
+		uint32_t y = 0;
+		uint32_t covered = 0;
+		for (size_t i = segment; covered < width; ++i) {
+			y = std::max(y, _skyline[i].y);
+			if (y + height > _height) {
+				return NO_FIT;
+			}
+			covered += _skyline[i].width;
+		}
+		return y;
+	}
+
+	bool SkylinePacker::insert(uint32_t width, uint32_t height, glm::uvec2& position) {
+		if (width == 0 || height == 0 || (width >= _smallest_failure.x && height >= _smallest_failure.y)) {
+			return false;
+		}
+
+		size_t best_segment = 0;
+		uint32_t best_bottom = NO_FIT;
+		uint32_t best_y = 0;
+		for (size_t i = 0; i < _skyline.size(); ++i) {
+			const uint32_t y = fit(i, width, height);
+			if (y != NO_FIT && y + height < best_bottom) {
+				best_segment = i;
+				best_bottom = y + height;
+				best_y = y;
+			}
+		}
+		if (best_bottom == NO_FIT) {
+			if (static_cast<uint64_t>(width) * height < static_cast<uint64_t>(_smallest_failure.x) * _smallest_failure.y) {
+				_smallest_failure = glm::uvec2(width, height);
+			}
+			return false;
+		}
+
+		position = glm::uvec2(_skyline[best_segment].x, best_y);
+		_used_area += static_cast<uint64_t>(width) * height;
+
+		// The new segment replaces whatever it covers
+		_skyline.insert(_skyline.begin() + best_segment, Segment{ position.x, best_bottom, width });
+		const uint32_t right = position.x + width;
+		size_t next = best_segment + 1;
+		while (next < _skyline.size() && _skyline[next].x < right) {
+			Segment& segment = _skyline[next];
+			const uint32_t segment_right = segment.x + segment.width;
+			if (segment_right <= right) {
+				_skyline.erase(_skyline.begin() + next);
+				continue;
+			}
+			segment.width = segment_right - right;
+			segment.x = right;
+			break;
+		}
+
+		// Merge neighbours at the same height
+		const size_t first = best_segment > 0 ? best_segment - 1 : 0;
+		for (size_t i = first; i + 1 < _skyline.size() && i <= best_segment + 1;) {
+			if (_skyline[i].y == _skyline[i + 1].y) {
+				_skyline[i].width += _skyline[i + 1].width;
+				_skyline.erase(_skyline.begin() + i + 1);
+			} else {
+				++i;
+			}
+		}
+		return true;
+	}
+
+	TextureAtlas::TextureAtlas(Renderer& renderer, const TextureAtlasDesc& desc)
+		: _renderer(renderer), _desc(desc) {
+		assert(desc.page_size > 2 * desc.padding && desc.max_pages > 0);
+	}
+
+	AtlasHandle TextureAtlas::insert(const Image& image) {
+		assert(!image.empty());
+		return insert(image.mip_data(0), image.width, image.height);
+	}
+
+	AtlasHandle TextureAtlas::insert(const void* pixels, uint32_t width, uint32_t height) {
+		const uint32_t padding = _desc.padding;
+		const uint32_t padded_width = width + 2 * padding;
+		const uint32_t padded_height = height + 2 * padding;
+		if (width == 0 || height == 0 || padded_width > _desc.page_size || padded_height > _desc.page_size) {
+			_stats.failed++;
+			return {};
+		}
+
+		// Cheapest first: room left in a page, a new page, repacking a page with removed images, evicting
+		glm::uvec2 position;
+		uint32_t page_index = NO_FIT;
+		for (uint32_t i = 0; i < _pages.size() && page_index == NO_FIT; ++i) {
+			if (_pages[i].packer.insert(padded_width, padded_height, position)) {
+				page_index = i;
+			}
+		}
+
+		if (page_index == NO_FIT && _pages.size() < _desc.max_pages) {
+			add_page();
+			if (_pages.back().packer.insert(padded_width, padded_height, position)) {
+				page_index = static_cast<uint32_t>(_pages.size() - 1);
+			}
+		}
+
+		if (page_index == NO_FIT) {
+			std::vector<uint32_t> pages(_pages.size());
+			std::iota(pages.begin(), pages.end(), 0);
+			std::sort(pages.begin(), pages.end(), [&](uint32_t a, uint32_t b) {
+				return reclaimable_area(_pages[a]) > reclaimable_area(_pages[b]);
+			});
+			for (uint32_t page : pages) {
+				if (place(page, padded_width, padded_height, position)) {
+					page_index = page;
+					break;
+				}
+			}
+		}
+
+		if (page_index == NO_FIT) {
+			std::vector<uint32_t> candidates;
+			for (uint32_t i = 0; i < _entries.size(); ++i) {
+				if (_entries[i].live && _entries[i].last_used < _frame) {
+					candidates.push_back(i);
+				}
+			}
+			std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+				return _entries[a].last_used < _entries[b].last_used;
+			});
+
+			// Every repack re-uploads a whole page, so free some headroom for the next inserts too
+			const uint64_t headroom = static_cast<uint64_t>(padded_width) * padded_height
+				+ static_cast<uint64_t>(_desc.page_size) * _desc.page_size / EVICTION_HEADROOM_DIVISOR;
+			for (uint32_t candidate : candidates) {
+				const uint32_t page = _entries[candidate].region.page;
+				kill(candidate);
+				_stats.evicted++;
+				if (reclaimable_area(_pages[page]) >= headroom && place(page, padded_width, padded_height, position)) {
+					page_index = page;
+					break;
+				}
+			}
+
+			// Ran out of images to evict, settle for less headroom
+			for (uint32_t i = 0; i < _pages.size() && page_index == NO_FIT; ++i) {
+				if (place(i, padded_width, padded_height, position)) {
+					page_index = i;
+				}
+			}
+		}
+
+		if (page_index == NO_FIT) {
+			_stats.failed++;
+			return {};
+		}
+
+		// Pad by repeating the edge texels
+		const uint32_t texel_size = Image::PIXEL_SIZE;
+		const size_t row_size = static_cast<size_t>(width) * texel_size;
+		const size_t padded_row_size = static_cast<size_t>(padded_width) * texel_size;
+		_staging.resize(padded_row_size * padded_height);
+		const uint8_t* source_pixels = static_cast<const uint8_t*>(pixels);
+		for (uint32_t row = 0; row < padded_height; ++row) {
+			const uint32_t source_row = static_cast<uint32_t>(std::clamp<int64_t>(static_cast<int64_t>(row) - padding, 0, height - 1));
+			const uint8_t* source = source_pixels + source_row * row_size;
+			uint8_t* destination = _staging.data() + row * padded_row_size;
+			for (uint32_t i = 0; i < padding; ++i) {
+				memcpy(destination + i * texel_size, source, texel_size);
+				memcpy(destination + (padding + width + i) * texel_size, source + row_size - texel_size, texel_size);
+			}
+			memcpy(destination + padding * texel_size, source, row_size);
+		}
+
+		Page& page = _pages[page_index];
+		const size_t page_row_size = static_cast<size_t>(_desc.page_size) * texel_size;
+		for (uint32_t row = 0; row < padded_height; ++row) {
+			memcpy(
+				page.pixels.get() + (position.y + row) * page_row_size + position.x * texel_size,
+				_staging.data() + row * padded_row_size,
+				padded_row_size
+			);
+		}
+		_renderer.update(page.texture, 0, { position.x, position.y, padded_width, padded_height }, _staging.data());
+		_stats.uploaded_bytes += _staging.size();
+		page.live_area += static_cast<uint64_t>(padded_width) * padded_height;
+
+		uint32_t index;
+		if (!_free_entries.empty()) {
+			index = _free_entries.back();
+			_free_entries.pop_back();
+		} else {
+			index = static_cast<uint32_t>(_entries.size());
+			_entries.emplace_back();
+		}
+
+		Entry& entry = _entries[index];
+		entry.live = true;
+		entry.last_used = _frame;
+		entry.region.texture = page.texture;
+		entry.region.page = page_index;
+		entry.region.width = width;
+		entry.region.height = height;
+		set_position(entry.region, position);
+
+		_stats.inserted++;
+		_stats.entries++;
+		return { index, entry.generation };
+	}
+
+	void TextureAtlas::remove(AtlasHandle handle) {
+		if (contains(handle)) {
+			kill(handle.index);
+		}
+	}
+
+	bool TextureAtlas::contains(AtlasHandle handle) const {
+		return handle.index < _entries.size()
+			&& _entries[handle.index].live
+			&& _entries[handle.index].generation == handle.generation;
+	}
+
+	const AtlasRegion* TextureAtlas::region(AtlasHandle handle) {
+		if (!contains(handle)) {
+			return nullptr;
+		}
+		Entry& entry = _entries[handle.index];
+		entry.last_used = _frame;
+		return &entry.region;
+	}
+
+	const AtlasRegion* TextureAtlas::find(AtlasHandle handle) const {
+		return contains(handle) ? &_entries[handle.index].region : nullptr;
+	}
+
+	TextureAtlasStats TextureAtlas::stats() const {
+		TextureAtlasStats stats = _stats;
+		stats.pages = static_cast<uint32_t>(_pages.size());
+		stats.used_area = 0;
+		for (const Page& page : _pages) {
+			stats.used_area += page.live_area;
+		}
+		stats.page_area = static_cast<uint64_t>(_desc.page_size) * _desc.page_size * _pages.size();
+		return stats;
+	}
+
+	bool TextureAtlas::place(uint32_t page_index, uint32_t width, uint32_t height, glm::uvec2& position) {
+		Page& page = _pages[page_index];
+		if (page.packer.insert(width, height, position)) {
+			return true;
+		}
+
+		// Only worth a try when the live images plus the new one could fit at all,
+		// and after a failure only once enough space was freed to make a difference
+		const uint64_t area = static_cast<uint64_t>(width) * height;
+		const uint64_t page_area = static_cast<uint64_t>(_desc.page_size) * _desc.page_size;
+		const uint64_t reclaimable = reclaimable_area(page);
+		if (page.live_area + area > page_area || reclaimable == 0 || reclaimable < page.failed_reclaimable + area) {
+			return false;
+		}
+		return repack(page_index, width, height, position);
+	}
+
+	bool TextureAtlas::repack(uint32_t page_index, uint32_t width, uint32_t height, glm::uvec2& position) {
+		Page& page = _pages[page_index];
+		const uint32_t padding = _desc.padding;
+
+		struct Item {
+			uint32_t entry; // NO_FIT for the new rect
+			uint32_t width;
+			uint32_t height;
+			glm::uvec2 position;
+		};
+
+		std::vector<Item> items;
+		for (uint32_t i = 0; i < _entries.size(); ++i) {
+			const Entry& entry = _entries[i];
+			if (entry.live && entry.region.page == page_index) {
+				items.push_back({ i, entry.region.width + 2 * padding, entry.region.height + 2 * padding, {} });
+			}
+		}
+		items.push_back({ NO_FIT, width, height, {} });
+
+		// Tallest first packs much tighter than insertion order
+		std::sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+			return a.height != b.height ? a.height > b.height : a.width > b.width;
+		});
+
+		SkylinePacker packer(_desc.page_size, _desc.page_size);
+		for (Item& item : items) {
+			if (!packer.insert(item.width, item.height, item.position)) {
+				page.failed_reclaimable = reclaimable_area(page);
+				return false;
+			}
+		}
+
+		const uint32_t texel_size = Image::PIXEL_SIZE;
+		const size_t page_row_size = static_cast<size_t>(_desc.page_size) * texel_size;
+		Unique<uint8_t[]> pixels(new uint8_t[page_row_size * _desc.page_size]);
+		for (const Item& item : items) {
+			if (item.entry == NO_FIT) {
+				position = item.position;
+				continue;
+			}
+
+			AtlasRegion& region = _entries[item.entry].region;
+			const size_t source_x = region.x - padding;
+			const size_t source_y = region.y - padding;
+			for (uint32_t row = 0; row < item.height; ++row) {
+				memcpy(
+					pixels.get() + (item.position.y + row) * page_row_size + item.position.x * texel_size,
+					page.pixels.get() + (source_y + row) * page_row_size + source_x * texel_size,
+					static_cast<size_t>(item.width) * texel_size
+				);
+			}
+			set_position(region, item.position);
+		}
+
+		page.pixels = std::move(pixels);
+		page.packer = packer;
+		page.failed_reclaimable = 0;
+
+		// Rows below the packed ones are never sampled
+		const uint32_t row_count = packer.used_height();
+		_renderer.update(page.texture, 0, TextureRegion::rows(*page.texture, 0, 0, row_count), page.pixels.get());
+		_stats.uploaded_bytes += page_row_size * row_count;
+		_stats.repacks++;
+		return true;
+	}
+
+	void TextureAtlas::add_page() {
+		Page& page = _pages.emplace_back();
+		page.texture = _renderer.create_texture(_desc.page_size, _desc.page_size, 1, TextureFormat::RGBA8_UNorm);
+		page.packer.reset(_desc.page_size, _desc.page_size);
+		page.pixels.reset(new uint8_t[static_cast<size_t>(_desc.page_size) * _desc.page_size * Image::PIXEL_SIZE]);
+	}
+
+	void TextureAtlas::kill(uint32_t entry_index) {
+		Entry& entry = _entries[entry_index];
+		const uint32_t padding = _desc.padding;
+		_pages[entry.region.page].live_area -= static_cast<uint64_t>(entry.region.width + 2 * padding) * (entry.region.height + 2 * padding);
+
+		entry.live = false;
+		entry.generation++;
+		entry.region.texture.reset();
+		_free_entries.push_back(entry_index);
+		_stats.entries--;
+	}
+
+	uint64_t TextureAtlas::reclaimable_area(const Page& page) const {
+		return page.packer.used_area() - page.live_area;
+	}
+
+	void TextureAtlas::set_position(AtlasRegion& region, glm::uvec2 padded_position) const {
+		region.x = padded_position.x + _desc.padding;
+		region.y = padded_position.y + _desc.padding;
+		const float scale = 1.0f / static_cast<float>(_desc.page_size);
+		region.uv_min = glm::vec2(static_cast<float>(region.x), static_cast<float>(region.y)) * scale;
+		region.uv_max = glm::vec2(static_cast<float>(region.x + region.width), static_cast<float>(region.y + region.height)) * scale;
+	}
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "RenderBackend.h"
+
+namespace dvig {
+	class Renderer;
+	struct Image;
+
+	// Bottom left skyline packer, y grows down. An insert walks the skyline once, so it stays cheap
+	// while a page fills up, unlike MaxRects whose free list grows with every rect.
+	// Space can't be given back, repack into a fresh packer to reclaim it.
+	class SkylinePacker {
+	public:
+		SkylinePacker() = default;
+		SkylinePacker(uint32_t width, uint32_t height) { reset(width, height); }
+
+		void reset(uint32_t width, uint32_t height);
+		// Places the rect where its bottom ends up highest, the leftmost one on ties.
+		// Returns false when it doesn't fit anywhere
+		bool insert(uint32_t width, uint32_t height, glm::uvec2& position);
+
+		uint32_t width() const { return _width; }
+		uint32_t height() const { return _height; }
+		uint64_t used_area() const { return _used_area; }
+		// Rows below this are still empty
+		uint32_t used_height() const;
+		float occupancy() const { return static_cast<float>(_used_area) / (static_cast<float>(_width) * _height); }
+
+	private:
+		// Everything above y is taken in [x, x + width)
+		struct Segment {
+			uint32_t x;
+			uint32_t y;
+			uint32_t width;
+		};
+
+		// Top of the rect when placed at segment's x, ~0u when it doesn't fit
+		uint32_t fit(size_t segment, uint32_t width, uint32_t height) const;
+
+	private:
+		uint32_t _width = 0;
+		uint32_t _height = 0;
+		uint64_t _used_area = 0;
+		std::vector<Segment> _skyline; // Left to right, covering the whole width
+		// Space only shrinks, so anything at least this big fails without walking the skyline. Keeps full pages cheap to try
+		glm::uvec2 _smallest_failure;
+	};
+
+	struct TextureAtlasDesc {
+		uint32_t page_size = 2048; // Square RGBA8 pages, one mip
+		uint32_t max_pages = 4;
+		uint32_t padding = 1;      // Edge texels repeated around every image so linear filtering doesn't pick up neighbours
+	};
+
+	// Stays valid while the image moves around on repacks, goes stale once it's removed or evicted
+	struct AtlasHandle {
+		uint32_t index = ~0u;
+		uint32_t generation = 0;
+
+		bool valid() const { return index != ~0u; }
+		bool operator==(const AtlasHandle& other) const { return index == other.index && generation == other.generation; }
+	};
+
+	struct AtlasRegion {
+		Shared<Texture2D> texture; // The page
+		glm::vec2 uv_min;
+		glm::vec2 uv_max;
+		uint32_t page = 0;
+		uint32_t x = 0;            // Texels in the page, padding not included
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	struct TextureAtlasStats {
+		uint32_t entries = 0;        // Live images
+		uint32_t pages = 0;
+		uint64_t used_area = 0;      // Texels of the live images, padding included
+		uint64_t page_area = 0;      // Texels of every page
+		uint32_t inserted = 0;
+		uint32_t failed = 0;         // Inserts that didn't fit even after evicting everything allowed
+		uint32_t evicted = 0;
+		uint32_t repacks = 0;
+		uint64_t uploaded_bytes = 0; // Sub rects and repacked pages
+	};
+
+	// Packs many small images into a few big textures so draws using them can share one texture.
+	// Images are added and removed at runtime, each insert records only its own sub rect as a texture update.
+	// When no page has room and max_pages are in use, a page with removed images is repacked
+	// (its live images are moved and the whole page re-uploaded from a CPU copy). If that isn't enough either,
+	// the least recently used images are evicted, never those looked up during the current frame.
+	// Handles keep working across repacks, look the region up again every frame instead of caching uvs.
+	// Only on the thread that records render commands.
+	class TextureAtlas {
+	public:
+		TextureAtlas(Renderer& renderer, const TextureAtlasDesc& desc = {});
+
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		// width * height RGBA8 texels, tightly packed, premultiplied like the rest of the 2D pipeline.
+		// Returns an invalid handle when the image is bigger than a page or nothing more can be evicted
+		AtlasHandle insert(const void* pixels, uint32_t width, uint32_t height);
+		// Only the top mip
+		AtlasHandle insert(const Image& image);
+		// Stale handles are ignored
+		void remove(AtlasHandle handle);
+		bool contains(AtlasHandle handle) const;
+
+		// Also marks the image used this frame. nullptr for stale handles.
+		// The pointer is only good until the next insert
+		const AtlasRegion* region(AtlasHandle handle);
+		// Same without counting as a use
+		const AtlasRegion* find(AtlasHandle handle) const;
+		// Call once per frame, it's the clock for eviction
+		void next_frame() { _frame++; }
+
+		const TextureAtlasDesc& desc() const { return _desc; }
+		TextureAtlasStats stats() const;
+
+	private:
+		struct Page {
+			Shared<Texture2D> texture;
+			SkylinePacker packer;
+			Unique<uint8_t[]> pixels;    // CPU copy for repacking. Left uninitialized, only texels inside packed rects are ever read back
+			uint64_t live_area = 0;      // Padded area of the live images, the rest of packer.used_area() is reclaimable
+			uint64_t failed_reclaimable = 0; // Reclaimable area when a repack last failed, don't retry before it grows
+		};
+
+		struct Entry {
+			AtlasRegion region;
+			uint64_t last_used = 0;
+			uint32_t generation = 0;
+			bool live = false;
+		};
+
+		// Tries to fit a padded rect into the page, repacking it when that could help
+		bool place(uint32_t page_index, uint32_t width, uint32_t height, glm::uvec2& position);
+		// Moves the live images of the page into a fresh packer together with the new rect and re-uploads the page.
+		// Leaves everything as is when they don't fit
+		bool repack(uint32_t page_index, uint32_t width, uint32_t height, glm::uvec2& position);
+		void add_page();
+		void kill(uint32_t entry_index);
+		uint64_t reclaimable_area(const Page& page) const;
+		// Sets x, y and the uvs from where the padded rect was placed
+		void set_position(AtlasRegion& region, glm::uvec2 padded_position) const;
+
+	private:
+		Renderer& _renderer;
+		TextureAtlasDesc _desc;
+		uint64_t _frame = 1;
+
+		std::vector<Page> _pages;
+		std::vector<Entry> _entries;
+		std::vector<uint32_t> _free_entries;
+		std::vector<uint8_t> _staging; // Padded image before it's copied into the page
+		TextureAtlasStats _stats;
+	};
+}
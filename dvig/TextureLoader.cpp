@@ -0,0 +1,197 @@
+#include "pch.h"
+#include "TextureLoader.h"
+#include "Renderer.h"
+#include "Profiler.h"
+#include "FrameTiming.h"
+#include "Memory.h"
+
+namespace dvig {
+	TextureLoader::TextureLoader(Renderer& renderer, uint32_t thread_count, uint64_t upload_budget)
+		: _renderer(renderer), _upload_budget(upload_budget) {
+		if (thread_count == 0) {
+			const uint32_t hardware_threads = std::thread::hardware_concurrency();
+			thread_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+		}
+
+		_workers.reserve(thread_count);
+		for (uint32_t i = 0; i < thread_count; ++i) {
+			_workers.emplace_back(&TextureLoader::worker_main, this);
+		}
+	}
+
+	TextureLoader::~TextureLoader() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_work_cv.notify_all();
+
+		for (std::thread& worker : _workers) {
+			worker.join();
+		}
+	}
+
+	Shared<TextureLoad> TextureLoader::load(const std::filesystem::path& path, const TextureLoadOptions& options) {
+		Shared<TextureLoad> load = std::make_shared<TextureLoad>();
+		load->path = path;
+		load->options = options;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pending.push_back(load);
+		}
+		_work_cv.notify_one();
+
+		return load;
+	}
+
+	void TextureLoader::update() {
+		DVIG_PROFILE_SCOPE("texture_loader_update");
+
+		std::vector<Shared<TextureLoad>> decoded;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::swap(decoded, _decoded);
+		}
+
+		for (Shared<TextureLoad>& load : decoded) {
+			if (load->image.empty()) {
+				load->state.store(TextureLoadState::Failed, std::memory_order_release);
+				continue;
+			}
+
+			// NOTE: Creating doesn't wait for the render thread, only the rows go through the budget
+			const Image& image = load->image;
+			load->texture = _renderer.create_texture(image.width, image.height, image.mip_count, TextureFormat::RGBA8_UNorm);
+			load->state.store(TextureLoadState::Uploading, std::memory_order_release);
+			_uploading.push_back(std::move(load));
+		}
+
+		uint64_t uploaded = 0;
+		uint32_t completed = 0;
+		while (!_uploading.empty() && uploaded < _upload_budget) {
+			TextureLoad& load = *_uploading.front();
+			uploaded += upload(load, _upload_budget - uploaded, uploaded == 0);
+
+			if (load.mip < load.image.mip_count) {
+				break; // Out of budget
+			}
+
+			load.image = {};
+			load.state.store(TextureLoadState::Ready, std::memory_order_release);
+			_uploading.pop_front();
+			completed++;
+		}
+
+		if (uploaded > 0) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stats.uploaded_bytes += uploaded;
+			_stats.uploaded += completed;
+			_stats.upload_frames++;
+		}
+	}
+
+	void TextureLoader::wait_decoded() {
+		std::unique_lock<std::mutex> lock(_mutex);
+		_decoded_cv.wait(lock, [&] { return _pending.empty() && _decoding == 0; });
+	}
+
+	bool TextureLoader::idle() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _pending.empty() && _decoding == 0 && _decoded.empty() && _uploading.empty();
+	}
+
+	TextureLoaderStats TextureLoader::stats() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _stats;
+	}
+
+	void TextureLoader::worker_main() {
+		Profiler::get().set_thread_name("TextureLoader");
+		MemoryTagScope memory_scope(MemoryTag::Assets);
+
+		while (true) {
+			Shared<TextureLoad> load;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_work_cv.wait(lock, [&] { return _quit || !_pending.empty(); });
+				if (_quit) {
+					return;
+				}
+
+				load = std::move(_pending.front());
+				_pending.pop_front();
+				_decoding++;
+			}
+
+			const int64_t start = steady_clock_now();
+			decode(*load);
+			const int64_t elapsed = steady_clock_now() - start;
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (load->image.empty()) {
+					_stats.failed++;
+				} else {
+					_stats.decoded++;
+					_stats.decoded_bytes += load->image.pixels.size();
+				}
+				_stats.decode_ns += static_cast<uint64_t>(elapsed);
+
+				_decoded.push_back(std::move(load));
+				_decoding--;
+			}
+			_decoded_cv.notify_all();
+		}
+	}
+
+	void TextureLoader::decode(TextureLoad& load) {
+		DVIG_PROFILE_SCOPE("decode_texture");
+
+		if (!load_image(load.path, load.image, load.error)) {
+			load.image = {};
+			return;
+		}
+
+		if (load.options.premultiply_alpha) {
+			premultiply_alpha(load.image);
+		}
+		if (load.options.generate_mips) {
+			generate_mips(load.image);
+		}
+	}
+
+	uint64_t TextureLoader::upload(TextureLoad& load, uint64_t budget, bool force_row) {
+		const Image& image = load.image;
+		uint64_t uploaded = 0;
+
+		while (load.mip < image.mip_count) {
+			const uint32_t height = image.mip_height(load.mip);
+			const uint64_t row_size = static_cast<uint64_t>(image.mip_width(load.mip)) * Image::PIXEL_SIZE;
+
+			uint64_t row_count = std::min<uint64_t>(height - load.row, (budget - uploaded) / row_size);
+			if (row_count == 0) {
+				if (!force_row || uploaded > 0) {
+					break;
+				}
+				row_count = 1;
+			}
+
+			const uint8_t* rows = image.mip_data(load.mip) + load.row * row_size;
+			_renderer.update(load.texture, load.mip, TextureRegion::rows(*load.texture, load.mip, load.row, static_cast<uint32_t>(row_count)), rows);
+			uploaded += row_count * row_size;
+
+			load.row += static_cast<uint32_t>(row_count);
+			if (load.row == height) {
+				load.mip++;
+				load.row = 0;
+			}
+
+			if (uploaded >= budget) {
+				break;
+			}
+		}
+
+		return uploaded;
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+#include "Image.h"
+#include "RenderBackend.h"
+
+namespace dvig {
+	class Renderer;
+
+	struct TextureLoadOptions {
+		bool premultiply_alpha = true;
+		bool generate_mips = true;
+	};
+
+	enum class TextureLoadState : uint32_t {
+		Decoding,  // Queued or on a worker
+		Uploading, // texture exists, its rows are being recorded a budget at a time
+		Ready,     // Every row is recorded, draws recorded from now on see the whole texture
+		Failed,    // error says why
+	};
+
+	// Handed out by TextureLoader::load right away and filled in by the loader.
+	// state can be read from any thread, texture and error only on the thread calling TextureLoader::update.
+	struct TextureLoad {
+		std::filesystem::path path;
+		TextureLoadOptions options;
+		std::atomic<TextureLoadState> state = TextureLoadState::Decoding;
+		Shared<Texture2D> texture; // Set once Uploading
+		std::string error;
+
+		bool ready() const { return state.load(std::memory_order_acquire) == TextureLoadState::Ready; }
+		bool failed() const { return state.load(std::memory_order_acquire) == TextureLoadState::Failed; }
+
+	private:
+		friend class TextureLoader;
+		Image image;        // Freed once uploaded
+		uint32_t mip = 0;   // Next rows to upload
+		uint32_t row = 0;
+	};
+
+	struct TextureLoaderStats {
+		uint32_t decoded = 0;         // Images decoded, premultiplied and mipped
+		uint32_t failed = 0;
+		uint32_t uploaded = 0;        // Textures that became Ready
+		uint64_t decoded_bytes = 0;   // RGBA8 bytes produced, mips included
+		uint64_t decode_ns = 0;       // Summed over the workers, so above the wall time when they overlap
+		uint64_t uploaded_bytes = 0;
+		uint32_t upload_frames = 0;   // update() calls that recorded rows
+	};
+
+	// Loads image files into textures without stalling the frame.
+	// Reading, decoding, premultiplying and mip generation run on worker threads.
+	// update() (Renderer::present calls it) creates the textures and records their rows as
+	// texture updates, no more than upload_budget bytes per frame (or a single row when it's bigger),
+	// so a burst of loads spreads out over several frames instead of hitching one.
+	class TextureLoader {
+	public:
+		// thread_count of 0 uses hardware_concurrency() - 1, at least one
+		TextureLoader(Renderer& renderer, uint32_t thread_count, uint64_t upload_budget);
+		~TextureLoader();
+
+		TextureLoader(const TextureLoader&) = delete;
+		TextureLoader& operator=(const TextureLoader&) = delete;
+
+		// Any thread
+		Shared<TextureLoad> load(const std::filesystem::path& path, const TextureLoadOptions& options = {});
+
+		// Only on the thread that records render commands. Never waits for the workers
+		void update();
+
+		// Waits until every queued image is decoded. Doesn't upload anything
+		void wait_decoded();
+		// Nothing is decoding or waiting for upload. Same thread as update()
+		bool idle() const;
+
+		void set_upload_budget(uint64_t bytes) { _upload_budget = bytes; }
+		uint64_t upload_budget() const { return _upload_budget; }
+		uint32_t thread_count() const { return static_cast<uint32_t>(_workers.size()); }
+
+		TextureLoaderStats stats() const;
+
+	private:
+		void worker_main();
+		void decode(TextureLoad& load);
+		// Records rows of load within budget. Returns the bytes recorded.
+		// force_row records one row even when it's over budget, so a frame always makes progress
+		uint64_t upload(TextureLoad& load, uint64_t budget, bool force_row);
+
+	private:
+		Renderer& _renderer;
+		uint64_t _upload_budget = 0;
+
+		mutable std::mutex _mutex;
+		std::condition_variable _work_cv;
+		std::condition_variable _decoded_cv;
+		std::deque<Shared<TextureLoad>> _pending; // Waiting for a worker
+		std::vector<Shared<TextureLoad>> _decoded; // Decoded or failed, waiting for update()
+		uint32_t _decoding = 0;                    // On a worker right now
+		bool _quit = false;
+		TextureLoaderStats _stats;
+
+		std::deque<Shared<TextureLoad>> _uploading; // Only touched by update(), oldest first
+
+		std::vector<std::thread> _workers;
+	};
+}
@@ -0,0 +1,542 @@
+#include "pch.h"
+#include "TrueType.h"
+
+namespace dvig {
+	namespace {
+		constexpr uint32_t tag(const char (&name)[5]) {
+			return (static_cast<uint32_t>(name[0]) << 24) | (name[1] << 16) | (name[2] << 8) | name[3];
+		}
+
+		// Simple glyph flags
+		constexpr uint32_t ON_CURVE = 0x01;
+		constexpr uint32_t X_SHORT = 0x02;
+		constexpr uint32_t Y_SHORT = 0x04;
+		constexpr uint32_t REPEAT = 0x08;
+		constexpr uint32_t X_SAME_OR_POSITIVE = 0x10;
+		constexpr uint32_t Y_SAME_OR_POSITIVE = 0x20;
+
+		// Composite glyph flags
+		constexpr uint32_t ARGS_ARE_WORDS = 0x0001;
+		constexpr uint32_t ARGS_ARE_XY_VALUES = 0x0002;
+		constexpr uint32_t HAS_SCALE = 0x0008;
+		constexpr uint32_t MORE_COMPONENTS = 0x0020;
+		constexpr uint32_t HAS_X_AND_Y_SCALE = 0x0040;
+		constexpr uint32_t HAS_TWO_BY_TWO = 0x0080;
+		constexpr uint32_t SCALED_COMPONENT_OFFSET = 0x0800;
+
+		// Components of components of... Real fonts stop at 2 or 3, this only guards against cycles
+		constexpr uint32_t MAX_COMPONENT_DEPTH = 8;
+		constexpr uint32_t MAX_CURVE_SEGMENTS = 32;
+
+		float f2dot14(int32_t value) { return static_cast<float>(value) / 16384.0f; }
+
+		void append_quadratic(glm::vec2 p0, glm::vec2 control, glm::vec2 p1, float tolerance, std::vector<GlyphEdge>& edges) {
+			// The curve strays at most |p0 - 2c + p1| / 4 from its chord, split into n that shrinks by n^2
+			const float deviation = glm::length(p0 - control * 2.0f + p1) / 4.0f;
+			const uint32_t segments = std::clamp(static_cast<uint32_t>(std::ceil(std::sqrt(deviation / tolerance))), 1u, MAX_CURVE_SEGMENTS);
+
+			glm::vec2 previous = p0;
+			for (uint32_t i = 1; i <= segments; ++i) {
+				const float t = static_cast<float>(i) / segments;
+				const float s = 1.0f - t;
+				const glm::vec2 point = i == segments ? p1 : p0 * (s * s) + control * (2.0f * s * t) + p1 * (t * t);
+				edges.push_back({ previous, point });
+				previous = point;
+			}
+		}
+	}
+
+	bool TrueTypeFont::load(const std::filesystem::path& path, std::string& error) {
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file) {
+			error = "can't open '" + path.string() + "'";
+			return false;
+		}
+
+		const std::streamsize size = file.tellg();
+		std::vector<uint8_t> data(static_cast<size_t>(std::max<std::streamsize>(size, 0)));
+		file.seekg(0);
+		if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
+			error = "can't read '" + path.string() + "'";
+			return false;
+		}
+
+		if (!load(std::move(data), error)) {
+			error = "'" + path.string() + "': " + error;
+			return false;
+		}
+		return true;
+	}
+
+	bool TrueTypeFont::load(std::vector<uint8_t> data, std::string& error) {
+		*this = {};
+		_data = std::move(data);
+
+		auto fail = [&](const char* reason) {
+			error = reason;
+			_data.clear();
+			return false;
+		};
+
+		const uint32_t version = u32(0);
+		if (version == tag("OTTO")) {
+			return fail("CFF based OpenType fonts aren't supported");
+		}
+		if (version == tag("ttcf")) {
+			return fail("font collections aren't supported");
+		}
+		if (version != 0x00010000 && version != tag("true")) {
+			return fail("not a TrueType font");
+		}
+
+		size_t head = 0, hhea = 0, maxp = 0, cmap = 0, kern = 0;
+		const uint32_t table_count = u16(4);
+		for (uint32_t i = 0; i < table_count; ++i) {
+			const size_t record = 12 + i * 16;
+			const size_t offset = u32(record + 8);
+			const size_t length = u32(record + 12);
+			if (offset + length > _data.size()) {
+				return fail("table outside the file");
+			}
+
+			switch (u32(record)) {
+				case tag("head"): head = offset; break;
+				case tag("hhea"): hhea = offset; break;
+				case tag("maxp"): maxp = offset; break;
+				case tag("cmap"): cmap = offset; break;
+				case tag("hmtx"): _hmtx = offset; break;
+				case tag("loca"): _loca = offset; break;
+				case tag("glyf"): _glyf = offset; _glyf_size = length; break;
+				case tag("kern"): kern = offset; break;
+			}
+		}
+
+		if (head == 0 || hhea == 0 || maxp == 0 || cmap == 0 || _hmtx == 0 || _loca == 0 || _glyf == 0) {
+			return fail("missing a required table (glyf outlines only)");
+		}
+
+		_units_per_em = u16(head + 18);
+		_long_loca = i16(head + 50) != 0;
+		_ascent = static_cast<float>(i16(hhea + 4));
+		_descent = static_cast<float>(i16(hhea + 6));
+		_line_gap = static_cast<float>(i16(hhea + 8));
+		_horizontal_metric_count = u16(hhea + 34);
+		_glyph_count = u16(maxp + 4);
+		if (_units_per_em == 0 || _glyph_count == 0 || _horizontal_metric_count == 0) {
+			return fail("broken header");
+		}
+
+		// Full Unicode (format 12) over BMP only (format 4)
+		uint32_t best_score = 0;
+		const uint32_t encoding_count = u16(cmap + 2);
+		for (uint32_t i = 0; i < encoding_count; ++i) {
+			const size_t record = cmap + 4 + i * 8;
+			const uint32_t platform = u16(record);
+			const uint32_t encoding = u16(record + 2);
+			const size_t subtable = cmap + u32(record + 4);
+			const uint32_t format = u16(subtable);
+
+			const bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+			const uint32_t score = !unicode ? 0 : (format == 12 ? 2 : (format == 4 ? 1 : 0));
+			if (score > best_score) {
+				best_score = score;
+				_cmap = subtable;
+				_cmap_format = format;
+			}
+		}
+		if (_cmap == 0) {
+			return fail("no Unicode character map");
+		}
+
+		// Only the old MS style table (version 0), Apple's version 1 tables are skipped
+		if (kern != 0 && u16(kern) == 0) {
+			size_t subtable = kern + 4;
+			const uint32_t subtable_count = u16(kern + 2);
+			for (uint32_t i = 0; i < subtable_count; ++i) {
+				const uint32_t coverage = u16(subtable + 4);
+				const bool horizontal = (coverage & 0x1) != 0;
+				const bool minimum = (coverage & 0x2) != 0;
+				const bool cross_stream = (coverage & 0x4) != 0;
+				if ((coverage >> 8) == 0 && horizontal && !minimum && !cross_stream) {
+					load_kerning(subtable + 14, u16(subtable + 6));
+					break;
+				}
+				subtable += u16(subtable + 2);
+			}
+		}
+
+		return true;
+	}
+
+	void TrueTypeFont::load_kerning(size_t pairs, uint32_t pair_count) {
+		if (pairs + pair_count * 6ull > _data.size()) {
+			return;
+		}
+
+		// Sorted by (left << 16) | right in the file already, but a broken order would only break lookups
+		std::vector<std::pair<uint32_t, int16_t>> sorted;
+		sorted.reserve(pair_count);
+		for (uint32_t i = 0; i < pair_count; ++i) {
+			const size_t pair = pairs + i * 6ull;
+			if (u16(pair) < _glyph_count) {
+				sorted.push_back({ u32(pair), static_cast<int16_t>(i16(pair + 4)) });
+			}
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+		_kerning_pairs.resize(sorted.size());
+		_kerning_starts.assign(_glyph_count + 1, 0);
+		for (size_t i = 0; i < sorted.size(); ++i) {
+			_kerning_pairs[i] = { static_cast<uint16_t>(sorted[i].first & 0xffff), sorted[i].second };
+			_kerning_starts[(sorted[i].first >> 16) + 1]++;
+		}
+		std::partial_sum(_kerning_starts.begin(), _kerning_starts.end(), _kerning_starts.begin());
+	}
+
+	uint32_t TrueTypeFont::glyph_index(uint32_t codepoint) const {
+		uint32_t glyph = 0;
+
+		if (_cmap_format == 4) {
+			if (codepoint > 0xffff) {
+				return 0;
+			}
+
+			const uint32_t segment_count = u16(_cmap + 6) / 2;
+			const size_t ends = _cmap + 14;
+			const size_t starts = ends + segment_count * 2 + 2;
+			const size_t deltas = starts + segment_count * 2;
+			const size_t range_offsets = deltas + segment_count * 2;
+
+			// First segment ending at or after the codepoint
+			uint32_t low = 0;
+			uint32_t high = segment_count;
+			while (low < high) {
+				const uint32_t middle = (low + high) / 2;
+				if (u16(ends + middle * 2) < codepoint) {
+					low = middle + 1;
+				} else {
+					high = middle;
+				}
+			}
+			if (low == segment_count) {
+				return 0;
+			}
+
+			const uint32_t start = u16(starts + low * 2);
+			if (codepoint < start) {
+				return 0;
+			}
+
+			const uint32_t delta = u16(deltas + low * 2);
+			const uint32_t range_offset = u16(range_offsets + low * 2);
+			if (range_offset == 0) {
+				glyph = (codepoint + delta) & 0xffff;
+			} else {
+				// Offset from the range offset entry itself into the glyph id array
+				glyph = u16(range_offsets + low * 2 + range_offset + (codepoint - start) * 2);
+				if (glyph != 0) {
+					glyph = (glyph + delta) & 0xffff;
+				}
+			}
+		} else if (_cmap_format == 12) {
+			const uint32_t group_count = u32(_cmap + 12);
+			const size_t groups = _cmap + 16;
+
+			uint32_t low = 0;
+			uint32_t high = group_count;
+			while (low < high) {
+				const uint32_t middle = (low + high) / 2;
+				if (u32(groups + middle * 12ull + 4) < codepoint) {
+					low = middle + 1;
+				} else {
+					high = middle;
+				}
+			}
+			if (low == group_count) {
+				return 0;
+			}
+
+			const size_t group = groups + low * 12ull;
+			const uint32_t start = u32(group);
+			if (codepoint < start) {
+				return 0;
+			}
+			glyph = u32(group + 8) + (codepoint - start);
+		}
+
+		return glyph < _glyph_count ? glyph : 0;
+	}
+
+	GlyphMetrics TrueTypeFont::glyph_metrics(uint32_t glyph) const {
+		GlyphMetrics metrics;
+		if (glyph >= _glyph_count) {
+			return metrics;
+		}
+
+		// Monospaced tails repeat the last advance and only store bearings
+		if (glyph < _horizontal_metric_count) {
+			metrics.advance = static_cast<float>(u16(_hmtx + glyph * 4));
+			metrics.left_side_bearing = static_cast<float>(i16(_hmtx + glyph * 4 + 2));
+		} else {
+			metrics.advance = static_cast<float>(u16(_hmtx + (_horizontal_metric_count - 1) * 4));
+			metrics.left_side_bearing = static_cast<float>(i16(_hmtx + _horizontal_metric_count * 4 + (glyph - _horizontal_metric_count) * 2));
+		}
+
+		size_t offset = 0;
+		size_t size = 0;
+		if (glyph_range(glyph, offset, size) && size >= 10) {
+			metrics.min = glm::vec2(static_cast<float>(i16(offset + 2)), static_cast<float>(i16(offset + 4)));
+			metrics.max = glm::vec2(static_cast<float>(i16(offset + 6)), static_cast<float>(i16(offset + 8)));
+		}
+		return metrics;
+	}
+
+	float TrueTypeFont::kerning(uint32_t left, uint32_t right) const {
+		if (left + 1 >= _kerning_starts.size()) {
+			return 0.0f;
+		}
+
+		const KerningPair* begin = _kerning_pairs.data() + _kerning_starts[left];
+		const KerningPair* end = _kerning_pairs.data() + _kerning_starts[left + 1];
+		const KerningPair* pair = std::lower_bound(begin, end, right, [](const KerningPair& pair, uint32_t right) { return pair.right < right; });
+		return pair != end && pair->right == right ? static_cast<float>(pair->value) : 0.0f;
+	}
+
+	bool TrueTypeFont::glyph_outline(uint32_t glyph, float tolerance, std::vector<GlyphEdge>& edges) const {
+		assert(tolerance > 0.0f);
+		return append_outline(glyph, Transform(), tolerance, 0, edges);
+	}
+
+	bool TrueTypeFont::glyph_range(uint32_t glyph, size_t& offset, size_t& size) const {
+		if (glyph >= _glyph_count) {
+			return false;
+		}
+
+		size_t start, end;
+		if (_long_loca) {
+			start = u32(_loca + glyph * 4ull);
+			end = u32(_loca + glyph * 4ull + 4);
+		} else {
+			start = u16(_loca + glyph * 2ull) * 2ull;
+			end = u16(_loca + glyph * 2ull + 2) * 2ull;
+		}
+		if (start > end || end > _glyf_size) {
+			return false;
+		}
+
+		offset = _glyf + start;
+		size = end - start;
+		return true;
+	}
+
+	bool TrueTypeFont::append_outline(uint32_t glyph, const Transform& transform, float tolerance, uint32_t depth, std::vector<GlyphEdge>& edges) const {
+		size_t offset = 0;
+		size_t size = 0;
+		if (depth > MAX_COMPONENT_DEPTH || !glyph_range(glyph, offset, size)) {
+			return false;
+		}
+		if (size == 0) {
+			return true;
+		}
+		if (size < 10) {
+			return false;
+		}
+
+		const int32_t contour_count = i16(offset);
+		if (contour_count >= 0) {
+			return append_simple_outline(offset, size, contour_count, transform, tolerance, edges);
+		}
+
+		// Composite: other glyphs placed with a 2x2 matrix and an offset
+		const size_t end = offset + size;
+		size_t position = offset + 10;
+		uint32_t flags = 0;
+		do {
+			if (position + 4 > end) {
+				return false;
+			}
+			flags = u16(position);
+			const uint32_t component = u16(position + 2);
+			position += 4;
+
+			Transform local;
+			if (flags & ARGS_ARE_WORDS) {
+				local.a.z = static_cast<float>(i16(position));
+				local.b.z = static_cast<float>(i16(position + 2));
+				position += 4;
+			} else {
+				local.a.z = static_cast<float>(static_cast<int8_t>(u8(position)));
+				local.b.z = static_cast<float>(static_cast<int8_t>(u8(position + 1)));
+				position += 2;
+			}
+			// NOTE: Matching points instead of offsets would need the hinted outlines, it's rare outside of CJK fonts
+			if (!(flags & ARGS_ARE_XY_VALUES)) {
+				local.a.z = 0.0f;
+				local.b.z = 0.0f;
+			}
+
+			if (flags & HAS_SCALE) {
+				local.a.x = local.b.y = f2dot14(i16(position));
+				position += 2;
+			} else if (flags & HAS_X_AND_Y_SCALE) {
+				local.a.x = f2dot14(i16(position));
+				local.b.y = f2dot14(i16(position + 2));
+				position += 4;
+			} else if (flags & HAS_TWO_BY_TWO) {
+				local.a.x = f2dot14(i16(position));
+				local.b.x = f2dot14(i16(position + 2));
+				local.a.y = f2dot14(i16(position + 4));
+				local.b.y = f2dot14(i16(position + 6));
+				position += 8;
+			}
+			if (flags & SCALED_COMPONENT_OFFSET) {
+				const glm::vec2 scaled(local.a.x * local.a.z + local.a.y * local.b.z, local.b.x * local.a.z + local.b.y * local.b.z);
+				local.a.z = scaled.x;
+				local.b.z = scaled.y;
+			}
+
+			// transform(local(p))
+			Transform combined;
+			combined.a = glm::vec3(
+				transform.a.x * local.a.x + transform.a.y * local.b.x,
+				transform.a.x * local.a.y + transform.a.y * local.b.y,
+				transform.a.x * local.a.z + transform.a.y * local.b.z + transform.a.z
+			);
+			combined.b = glm::vec3(
+				transform.b.x * local.a.x + transform.b.y * local.b.x,
+				transform.b.x * local.a.y + transform.b.y * local.b.y,
+				transform.b.x * local.a.z + transform.b.y * local.b.z + transform.b.z
+			);
+
+			if (!append_outline(component, combined, tolerance, depth + 1, edges)) {
+				return false;
+			}
+		} while (flags & MORE_COMPONENTS);
+
+		return true;
+	}
+
+	bool TrueTypeFont::append_simple_outline(
+		size_t offset, size_t size, int32_t contour_count,
+		const Transform& transform, float tolerance, std::vector<GlyphEdge>& edges
+	) const {
+		if (contour_count == 0) {
+			return true;
+		}
+
+		const size_t end = offset + size;
+		const size_t end_points = offset + 10;
+		const uint32_t point_count = u16(end_points + (contour_count - 1) * 2) + 1;
+		const uint32_t instruction_size = u16(end_points + contour_count * 2);
+		size_t position = end_points + contour_count * 2 + 2 + instruction_size;
+
+		// Flags, run length encoded
+		std::vector<uint8_t> flags(point_count);
+		for (uint32_t i = 0; i < point_count;) {
+			if (position >= end) {
+				return false;
+			}
+			const uint8_t flag = static_cast<uint8_t>(u8(position++));
+			flags[i++] = flag;
+			if (flag & REPEAT) {
+				for (uint32_t repeat = u8(position++); repeat > 0 && i < point_count; --repeat) {
+					flags[i++] = flag;
+				}
+			}
+		}
+
+		// Coordinates are deltas, all x first then all y
+		std::vector<glm::vec2> points(point_count);
+		int32_t value = 0;
+		for (uint32_t i = 0; i < point_count; ++i) {
+			if (flags[i] & X_SHORT) {
+				const int32_t delta = u8(position++);
+				value += (flags[i] & X_SAME_OR_POSITIVE) ? delta : -delta;
+			} else if (!(flags[i] & X_SAME_OR_POSITIVE)) {
+				value += i16(position);
+				position += 2;
+			}
+			points[i].x = static_cast<float>(value);
+		}
+		value = 0;
+		for (uint32_t i = 0; i < point_count; ++i) {
+			if (flags[i] & Y_SHORT) {
+				const int32_t delta = u8(position++);
+				value += (flags[i] & Y_SAME_OR_POSITIVE) ? delta : -delta;
+			} else if (!(flags[i] & Y_SAME_OR_POSITIVE)) {
+				value += i16(position);
+				position += 2;
+			}
+			points[i].y = static_cast<float>(value);
+		}
+		if (position > end) {
+			return false;
+		}
+
+		for (glm::vec2& point : points) {
+			point = transform.apply(point);
+		}
+
+		uint32_t first = 0;
+		for (int32_t contour = 0; contour < contour_count; ++contour) {
+			const uint32_t last = u16(end_points + contour * 2);
+			if (last < first || last >= point_count) {
+				return false;
+			}
+			const uint32_t count = last - first + 1;
+
+			// Two off curve points in a row have an implied on curve point halfway between them.
+			// Start on a real on curve point, or on the implied one before the first point when there is none
+			uint32_t start = 0;
+			while (start < count && !(flags[first + start] & ON_CURVE)) {
+				start++;
+			}
+
+			glm::vec2 origin;
+			uint32_t remaining = count;
+			if (start == count) {
+				origin = (points[last] + points[first]) * 0.5f;
+				start = count - 1; // The walk below begins after start
+			} else {
+				origin = points[first + start];
+				remaining = count - 1;
+			}
+
+			glm::vec2 current = origin;
+			glm::vec2 control;
+			bool has_control = false;
+			for (uint32_t i = 1; i <= remaining; ++i) {
+				const uint32_t index = first + (start + i) % count;
+				const glm::vec2 point = points[index];
+
+				if (flags[index] & ON_CURVE) {
+					if (has_control) {
+						append_quadratic(current, control, point, tolerance, edges);
+					} else {
+						edges.push_back({ current, point });
+					}
+					current = point;
+					has_control = false;
+				} else {
+					if (has_control) {
+						const glm::vec2 middle = (control + point) * 0.5f;
+						append_quadratic(current, control, middle, tolerance, edges);
+						current = middle;
+					}
+					control = point;
+					has_control = true;
+				}
+			}
+
+			if (has_control) {
+				append_quadratic(current, control, origin, tolerance, edges);
+			} else if (current != origin) {
+				edges.push_back({ current, origin });
+			}
+
+			first = last + 1;
+		}
+
+		return true;
+	}
+}
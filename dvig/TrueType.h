@@ -0,0 +1,93 @@
+#pragma once
+#include "pch.h"
+
+namespace dvig {
+	// Straight piece of a flattened outline, font units with y up
+	struct GlyphEdge {
+		glm::vec2 a;
+		glm::vec2 b;
+	};
+
+	// Font units
+	struct GlyphMetrics {
+		float advance = 0.0f;
+		float left_side_bearing = 0.0f;
+		glm::vec2 min = glm::vec2(0.0f); // Bounding box, min == max for empty glyphs (space)
+		glm::vec2 max = glm::vec2(0.0f);
+	};
+
+	// glyf based TrueType fonts (.ttf). The whole file stays in memory, glyphs are parsed when asked for.
+	// Hinting instructions are ignored. CFF outlines (.otf) and collections (.ttc) aren't supported,
+	// kerning only comes from format 0 of the 'kern' table, not from GPOS.
+	// Every read is bounds checked, a broken file gives empty glyphs instead of crashing.
+	class TrueTypeFont {
+	public:
+		// Returns false with the reason in error
+		bool load(const std::filesystem::path& path, std::string& error);
+		bool load(std::vector<uint8_t> data, std::string& error);
+
+		bool loaded() const { return !_data.empty(); }
+		uint32_t units_per_em() const { return _units_per_em; }
+		float ascent() const { return _ascent; }     // Above the baseline, positive
+		float descent() const { return _descent; }   // Below the baseline, negative
+		float line_gap() const { return _line_gap; }
+		uint32_t glyph_count() const { return _glyph_count; }
+
+		// 0 (.notdef) when the font has no glyph for it
+		uint32_t glyph_index(uint32_t codepoint) const;
+		GlyphMetrics glyph_metrics(uint32_t glyph) const;
+		// Added to the advance of left when right follows it. 0 for most pairs
+		float kerning(uint32_t left, uint32_t right) const;
+		// Appends the closed contours of the glyph, curves flattened until no point strays further than
+		// tolerance from its edge. Composite glyphs are resolved. Returns false for broken glyph data
+		bool glyph_outline(uint32_t glyph, float tolerance, std::vector<GlyphEdge>& edges) const;
+
+	private:
+		// Row major 2x3, x' = a.x * x + a.y * y + a.z
+		struct Transform {
+			glm::vec3 a = glm::vec3(1.0f, 0.0f, 0.0f);
+			glm::vec3 b = glm::vec3(0.0f, 1.0f, 0.0f);
+
+			glm::vec2 apply(glm::vec2 p) const { return { a.x * p.x + a.y * p.y + a.z, b.x * p.x + b.y * p.y + b.z }; }
+		};
+
+		struct KerningPair {
+			uint16_t right = 0;
+			int16_t value = 0;
+		};
+
+		uint32_t u8(size_t offset) const { return offset < _data.size() ? _data[offset] : 0; }
+		uint32_t u16(size_t offset) const { return (u8(offset) << 8) | u8(offset + 1); }
+		int32_t i16(size_t offset) const { return static_cast<int16_t>(u16(offset)); }
+		uint32_t u32(size_t offset) const { return (u16(offset) << 16) | u16(offset + 2); }
+
+		void load_kerning(size_t pairs, uint32_t pair_count);
+		// Byte range of the glyph in 'glyf', size 0 for empty glyphs
+		bool glyph_range(uint32_t glyph, size_t& offset, size_t& size) const;
+		bool append_outline(uint32_t glyph, const Transform& transform, float tolerance, uint32_t depth, std::vector<GlyphEdge>& edges) const;
+		bool append_simple_outline(size_t offset, size_t size, int32_t contour_count, const Transform& transform, float tolerance, std::vector<GlyphEdge>& edges) const;
+
+	private:
+		std::vector<uint8_t> _data;
+
+		uint32_t _units_per_em = 0;
+		float _ascent = 0.0f;
+		float _descent = 0.0f;
+		float _line_gap = 0.0f;
+		uint32_t _glyph_count = 0;
+		uint32_t _horizontal_metric_count = 0;
+		bool _long_loca = false;
+
+		// Table offsets, 0 when missing
+		size_t _cmap = 0;   // The picked subtable
+		uint32_t _cmap_format = 0;
+		size_t _loca = 0;
+		size_t _glyf = 0;
+		size_t _glyf_size = 0;
+		size_t _hmtx = 0;
+
+		// Decoded from 'kern' on load, layout looks up every pair of neighbours
+		std::vector<KerningPair> _kerning_pairs; // Sorted by left glyph, then right
+		std::vector<uint32_t> _kerning_starts;   // By left glyph, its pairs are [starts[left], starts[left + 1])
+	};
+}
@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "UniformBuffer.h"
+
+namespace dvig {
+	uint32_t uniform_type_size(UniformType type) {
+		switch (type) {
+			case UniformType::Float: return 4;
+			case UniformType::Float2: return 8;
+			case UniformType::Float3: return 12;
+			case UniformType::Float4: return 16;
+			case UniformType::Int: return 4;
+			case UniformType::UInt: return 4;
+			case UniformType::Mat4: return 64;
+			default:
+				std::cerr << "Uniform type has no fixed size!\n";
+				abort();
+		}
+	}
+
+	uint32_t UniformLayout::add(const std::string& name, UniformType type) {
+		assert(find_field(name) == nullptr);
+
+		const uint32_t size = uniform_type_size(type);
+		uint32_t offset = _size;
+
+		// Matrices start on a new register, everything else only moves when it would straddle one
+		const bool crosses_register = (offset % 16) + size > 16;
+		if (type == UniformType::Mat4 || crosses_register) {
+			offset = (offset + 15) & ~15u;
+		}
+
+		UniformField field;
+		field.name = name;
+		field.type = type;
+		field.offset = offset;
+		field.size = size;
+		_fields.push_back(field);
+
+		_size = offset + size;
+		return offset;
+	}
+
+	void UniformLayout::add_packed(const UniformField& field) {
+		_fields.push_back(field);
+		_size = std::max(_size, field.offset + field.size);
+	}
+
+	const UniformField* UniformLayout::find_field(const std::string& name) const {
+		for (const UniformField& field : _fields) {
+			if (field.name == name) {
+				return &field;
+			}
+		}
+
+		return nullptr;
+	}
+
+	UniformBuffer::UniformBuffer(const UniformLayout& layout)
+		: _data(layout.size(), 0) {
+		// Everything has to be uploaded once
+		_dirty = !_data.empty();
+		_dirty_begin = 0;
+		_dirty_end = size();
+	}
+
+	void UniformBuffer::set_data(uint32_t offset, const void* data, uint32_t size) {
+		assert(offset != UINT32_MAX && "Invalid uniform handle");
+		assert(offset + size <= _data.size());
+
+		memcpy(_data.data() + offset, data, size);
+
+		const uint32_t begin = offset & ~15u;
+		const uint32_t end = std::min(this->size(), (offset + size + 15) & ~15u);
+		if (_dirty) {
+			_dirty_begin = std::min(_dirty_begin, begin);
+			_dirty_end = std::max(_dirty_end, end);
+		} else {
+			_dirty = true;
+			_dirty_begin = begin;
+			_dirty_end = end;
+		}
+	}
+
+	void UniformBuffer::clear_dirty() {
+		_dirty = false;
+		_dirty_begin = 0;
+		_dirty_end = 0;
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "pch.h"
+
+#include "Memory.h"
+
+namespace dvig {
+	enum class UniformType {
+		Float,
+		Float2,
+		Float3,
+		Float4,
+		Int,
+		UInt,
+		Mat4,
+		Other, // Reflected types without a C++ counterpart (arrays, structs, ...). Can't get a handle for these
+	};
+
+	uint32_t uniform_type_size(UniformType type);
+
+	template<typename Type> struct UniformTypeOf;
+	template<> struct UniformTypeOf<float> { static constexpr UniformType value = UniformType::Float; };
+	template<> struct UniformTypeOf<glm::vec2> { static constexpr UniformType value = UniformType::Float2; };
+	template<> struct UniformTypeOf<glm::vec3> { static constexpr UniformType value = UniformType::Float3; };
+	template<> struct UniformTypeOf<glm::vec4> { static constexpr UniformType value = UniformType::Float4; };
+	template<> struct UniformTypeOf<int32_t> { static constexpr UniformType value = UniformType::Int; };
+	template<> struct UniformTypeOf<uint32_t> { static constexpr UniformType value = UniformType::UInt; };
+	template<> struct UniformTypeOf<glm::mat4> { static constexpr UniformType value = UniformType::Mat4; };
+
+	// Byte offset into the buffer. Resolved once from a UniformLayout, so setting a value
+	// is a memcpy without any lookup.
+	template<typename Type>
+	struct UniformHandle {
+		uint32_t offset = UINT32_MAX;
+
+		bool is_valid() const { return offset != UINT32_MAX; }
+	};
+
+	struct UniformField {
+		std::string name;
+		UniformType type = UniformType::Other;
+		uint32_t offset = 0;
+		uint32_t size = 0;
+	};
+
+	// Layout of one HLSL cbuffer.
+	// Either reflected from the compiled shader (D3D11 fills VertexShader::uniform_layout)
+	// or built by hand with add(), which follows the HLSL packing rules:
+	// a field never straddles a 16 byte register and matrices start on a new one.
+	class UniformLayout {
+	public:
+		// Appends a field with HLSL packing. Returns its byte offset
+		uint32_t add(const std::string& name, UniformType type);
+
+		template<typename Type>
+		UniformHandle<Type> add(const std::string& name) {
+			return { add(name, UniformTypeOf<Type>::value) };
+		}
+
+		// Used by reflection, where the compiler already packed the fields
+		void add_packed(const UniformField& field);
+
+		// Linear search, meant to be called once when setting up, not per frame.
+		// Returns an invalid handle when the name is missing or the type doesn't match.
+		template<typename Type>
+		UniformHandle<Type> find(const std::string& name) const {
+			const UniformField* field = find_field(name);
+			if (field == nullptr || field->type != UniformTypeOf<Type>::value) {
+				return {};
+			}
+
+			return { field->offset };
+		}
+
+		const UniformField* find_field(const std::string& name) const;
+
+		const std::vector<UniformField>& fields() const { return _fields; }
+		bool empty() const { return _fields.empty(); }
+
+		// Rounded up to whole 16 byte registers, the size constant buffers need
+		uint32_t size() const { return (_size + 15) & ~15u; }
+
+	private:
+		std::vector<UniformField> _fields;
+		uint32_t _size = 0;
+	};
+
+	// CPU side copy of a cbuffer. Allocated once from a layout, writes go through handles
+	// and only the dirty byte range is uploaded by Renderer::update(shader, uniform_buffer).
+	class UniformBuffer {
+	public:
+		UniformBuffer() = default;
+		explicit UniformBuffer(const UniformLayout& layout);
+
+		template<typename Type>
+		void set(UniformHandle<Type> handle, const Type& value) {
+			set_data(handle.offset, &value, sizeof(Type));
+		}
+
+		template<typename Type>
+		Type get(UniformHandle<Type> handle) const {
+			assert(handle.is_valid() && handle.offset + sizeof(Type) <= _data.size());
+
+			Type value;
+			memcpy(&value, _data.data() + handle.offset, sizeof(Type));
+			return value;
+		}
+
+		void set_data(uint32_t offset, const void* data, uint32_t size);
+
+		const char* data() const { return _data.data(); }
+		uint32_t size() const { return static_cast<uint32_t>(_data.size()); }
+
+		bool is_dirty() const { return _dirty; }
+		// Dirty range is [dirty_begin, dirty_end), aligned to 16 byte registers
+		uint32_t dirty_begin() const { return _dirty_begin; }
+		uint32_t dirty_end() const { return _dirty_end; }
+		void clear_dirty();
+
+	private:
+		bool _dirty = false;
+		uint32_t _dirty_begin = 0;
+		uint32_t _dirty_end = 0;
+		TrackedVector<char, MemoryTag::Render> _data;
+	};
+}
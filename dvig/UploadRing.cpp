@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "UploadRing.h"
+
+namespace dvig {
+	UploadRing::UploadRing(uint64_t capacity) : _capacity(capacity) {
+		assert(capacity > 0);
+	}
+
+	std::optional<UploadAllocation> UploadRing::allocate(uint64_t size, uint64_t alignment) {
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && _capacity % alignment == 0);
+		if (size == 0 || size > _capacity) {
+			return std::nullopt;
+		}
+
+		uint64_t position = (_head + alignment - 1) & ~(alignment - 1);
+		if (position % _capacity + size > _capacity) {
+			position += _capacity - position % _capacity;
+		}
+
+		if (position + size - _tail > _capacity) {
+			return std::nullopt;
+		}
+
+		UploadAllocation allocation;
+		allocation.offset = position % _capacity;
+		allocation.wrapped = allocation.offset == 0;
+		if (allocation.wrapped) {
+			_pass++;
+		}
+
+		_head = position + size;
+		return allocation;
+	}
+
+	void UploadRing::end_frame(uint64_t fence) {
+		assert(_frames.empty() || _frames.back().fence < fence);
+
+		Frame frame;
+		frame.fence = fence;
+		frame.end = _head;
+		_frames.push_back(frame);
+	}
+
+	void UploadRing::retire(uint64_t completed_fence) {
+		while (!_frames.empty() && _frames.front().fence <= completed_fence) {
+			_tail = _frames.front().end;
+			_frames.pop_front();
+		}
+	}
+
+	void UploadRing::reset() {
+		_head = (_head + _capacity - 1) / _capacity * _capacity;
+		_tail = _head;
+		_frames.clear();
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "pch.h"
+
+namespace dvig {
+	struct UploadAllocation {
+		uint64_t offset = 0;
+		// Starts a new pass over the ring at offset 0 (the very first allocation too).
+		// Backends that rename on discard (D3D11) discard here and write everything else without overwrite
+		bool wrapped = false;
+	};
+
+	// Offset, wrap and fence bookkeeping of a ring buffer that per frame data (dynamic vertices, uniforms)
+	// is sub-allocated from. Owns no memory, the backend keeps the buffer the offsets are into.
+	// Everything allocated until end_frame(fence) stays in use until retire() gets that fence,
+	// an allocation that would run into it fails instead.
+	class UploadRing {
+	public:
+		explicit UploadRing(uint64_t capacity);
+
+		// alignment is a power of two dividing the capacity. An allocation never straddles the end,
+		// the rest of the ring is skipped and it wraps to 0.
+		// nullopt when in flight frames are in the way, and for size 0 so it never counts as a wrap
+		std::optional<UploadAllocation> allocate(uint64_t size, uint64_t alignment);
+		// Fences have to increase
+		void end_frame(uint64_t fence);
+		// Frees every frame up to and including completed_fence
+		void retire(uint64_t completed_fence);
+		// Forgets every allocation, the next one wraps. Only when the old contents can't be overwritten anymore
+		// (a D3D11 discard gives the buffer new memory)
+		void reset();
+
+		uint64_t capacity() const { return _capacity; }
+		// In flight and current frame, including padding skipped for alignment and wraps
+		uint64_t used() const { return _head - _tail; }
+		uint32_t frames_in_flight() const { return static_cast<uint32_t>(_frames.size()); }
+		// Bumped by every wrap. After a discard on wrap the data of earlier passes is gone, 0 is never a pass
+		uint64_t pass() const { return _pass; }
+
+	private:
+		struct Frame {
+			uint64_t fence = 0;
+			uint64_t end = 0; // _head when the frame ended
+		};
+
+		// Positions only grow, the offset is position % capacity
+		uint64_t _capacity = 0;
+		uint64_t _head = 0; // Next free byte
+		uint64_t _tail = 0; // Oldest byte still in use
+		uint64_t _pass = 0;
+		std::deque<Frame> _frames;
+	};
+}
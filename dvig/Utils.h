@@ -5,4 +5,57 @@ namespace utils {
 	void zero_memory(Type* memory) {
 		std::memset(memory, 0, sizeof(Type));
 	}
+
+	// 64 bit FNV-1a. Pass the previous result as seed to hash several pieces as one
+	constexpr uint64_t FNV1A_64_SEED = 0xcbf29ce484222325ull;
+
+	inline uint64_t fnv1a_64(const void* data, size_t size, uint64_t seed = FNV1A_64_SEED) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+
+	inline uint64_t fnv1a_64(const std::string& string, uint64_t seed = FNV1A_64_SEED) {
+		return fnv1a_64(string.data(), string.size(), seed);
+	}
+
+	// Calls function(i) for every i in [0, count) on up to max_threads threads, the caller included.
+	// Threads are started for this call only, meant for a few big independent tasks.
+	template<typename Function>
+	void parallel_for(uint32_t count, Function function, uint32_t max_threads = 0) {
+		if (max_threads == 0) {
+			max_threads = std::max(1u, std::thread::hardware_concurrency());
+		}
+
+		const uint32_t thread_count = std::min(count, max_threads);
+		if (thread_count <= 1) {
+			for (uint32_t i = 0; i < count; ++i) {
+				function(i);
+			}
+			return;
+		}
+
+		std::atomic<uint32_t> next = 0;
+		auto worker = [&]() {
+			for (uint32_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+				function(i);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(thread_count - 1);
+		for (uint32_t i = 0; i < thread_count - 1; ++i) {
+			threads.emplace_back(worker);
+		}
+
+		worker();
+
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	}
 }
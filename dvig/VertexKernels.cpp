@@ -0,0 +1,553 @@
+#include "pch.h"
+#include "VertexKernels.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define DVIG_SIMD_X86 1
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#else
+	#define DVIG_SIMD_X86 0
+#endif
+
+// MSVC compiles intrinsics anywhere. GCC and Clang only compile them into functions that target the
+// instruction set, so the ops carry the target and each entry point flattens its kernel into itself
+#ifdef _MSC_VER
+	#define DVIG_TARGET(isa)
+	#define DVIG_TARGET_ENTRY(isa)
+	#define DVIG_SIMD_INLINE __forceinline
+#else
+	#define DVIG_TARGET(isa) __attribute__((target(isa)))
+	#define DVIG_TARGET_ENTRY(isa) __attribute__((target(isa), flatten))
+	#define DVIG_SIMD_INLINE inline
+	// Kernels pass vectors by value, but only ever run inlined into an entry point of their level
+	#pragma GCC diagnostic ignored "-Wpsabi"
+	// GCC 12 flags the undefined vectors inside its own AVX-512 intrinsics
+	#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+	// AVX-512F has fused multiply adds, GCC would fuse there and nowhere else
+	#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace dvig {
+	namespace {
+		// Unoptimized GCC and Clang don't flatten the kernels into their entry points. The ops then get called from
+		// kernels compiled for the baseline, which pass wider vectors in the wrong registers, so such builds only
+		// go up to what the whole file is compiled for
+	#if defined(_MSC_VER) || defined(__OPTIMIZE__) || defined(__AVX512F__)
+		constexpr SimdLevel MAX_BUILD_LEVEL = SimdLevel::AVX512;
+	#elif defined(__AVX2__)
+		constexpr SimdLevel MAX_BUILD_LEVEL = SimdLevel::AVX2;
+	#else
+		constexpr SimdLevel MAX_BUILD_LEVEL = SimdLevel::SSE2;
+	#endif
+
+		// Every level runs the kernels below with its own ops. They only use adds, subtracts and multiplies
+		// in the same order, never fused, so every level rounds the same way
+
+		struct ScalarOps {
+			using Float = float;
+			using Int = uint32_t;
+			using Mask = bool;
+			static constexpr uint32_t WIDTH = 1;
+
+			static Float load(const float* p) { return *p; }
+			static void store(float* p, Float v) { *p = v; }
+			static Float set(float v) { return v; }
+			static Float add(Float a, Float b) { return a + b; }
+			static Float sub(Float a, Float b) { return a - b; }
+			static Float mul(Float a, Float b) { return a * b; }
+			static Float bit_and(Float a, Float b) { return as_float(as_int(a) & as_int(b)); }
+			static Float bit_xor(Float a, Float b) { return as_float(as_int(a) ^ as_int(b)); }
+
+			static Int load_int(const uint32_t* p) { return *p; }
+			static Int set_int(uint32_t v) { return v; }
+			static Int add_int(Int a, Int b) { return a + b; }
+			static Int and_int(Int a, Int b) { return a & b; }
+			template<int Bits> static Int shift_left(Int a) { return a << Bits; }
+			template<int Bits> static Int shift_right(Int a) { return a >> Bits; }
+			static Int truncate(Float a) { return static_cast<Int>(static_cast<int32_t>(a)); }
+			static Float to_float(Int a) { return static_cast<float>(static_cast<int32_t>(a)); }
+			static Float as_float(Int a) { float result; memcpy(&result, &a, sizeof(result)); return result; }
+			static Int as_int(Float a) { Int result; memcpy(&result, &a, sizeof(result)); return result; }
+
+			static Mask is_zero(Int a) { return a == 0; }
+			static Float select(Mask mask, Float a, Float b) { return mask ? a : b; }
+
+			// WIDTH quads of 4 vertices, corner positions in x and y, the packed color bits of each quad in color
+			static void store_quads(BatchVertex2D* vertices, const Float x[4], const Float y[4], Float color) {
+				for (uint32_t corner = 0; corner < 4; ++corner) {
+					vertices[corner].pos = { x[corner], y[corner] };
+					vertices[corner].color = as_int(color);
+				}
+			}
+		};
+
+	#if DVIG_SIMD_X86
+		struct Sse2Ops {
+			using Float = __m128;
+			using Int = __m128i;
+			using Mask = __m128;
+			static constexpr uint32_t WIDTH = 4;
+
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float load(const float* p) { return _mm_loadu_ps(p); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float set(float v) { return _mm_set1_ps(v); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float bit_and(Float a, Float b) { return _mm_and_ps(a, b); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float bit_xor(Float a, Float b) { return _mm_xor_ps(a, b); }
+
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Int load_int(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Int set_int(uint32_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Int add_int(Int a, Int b) { return _mm_add_epi32(a, b); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Int and_int(Int a, Int b) { return _mm_and_si128(a, b); }
+			template<int Bits> DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Int shift_left(Int a) { return _mm_slli_epi32(a, Bits); }
+			template<int Bits> DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Int shift_right(Int a) { return _mm_srli_epi32(a, Bits); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Int truncate(Float a) { return _mm_cvttps_epi32(a); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float to_float(Int a) { return _mm_cvtepi32_ps(a); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float as_float(Int a) { return _mm_castsi128_ps(a); }
+
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Mask is_zero(Int a) { return _mm_castsi128_ps(_mm_cmpeq_epi32(a, _mm_setzero_si128())); }
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static Float select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+			template<int Quad> DVIG_TARGET("sse2") DVIG_SIMD_INLINE static void store_quad(BatchVertex2D* vertices, Float x, Float y, Float color) {
+				// The 4 vertices are 12 floats: x0 y0 c x1 | y1 c x2 y2 | c x3 y3 c
+				const Float c = _mm_shuffle_ps(color, color, _MM_SHUFFLE(Quad, Quad, Quad, Quad));
+				const Float low = _mm_unpacklo_ps(x, y);  // x0 y0 x1 y1
+				const Float high = _mm_unpackhi_ps(x, y); // x2 y2 x3 y3
+
+				float* out = &vertices[Quad * 4].pos.x;
+				_mm_storeu_ps(out, _mm_shuffle_ps(low, _mm_shuffle_ps(c, low, _MM_SHUFFLE(3, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+				_mm_storeu_ps(out + 4, _mm_shuffle_ps(_mm_shuffle_ps(low, c, _MM_SHUFFLE(0, 0, 3, 3)), high, _MM_SHUFFLE(1, 0, 2, 0)));
+				_mm_storeu_ps(out + 8, _mm_shuffle_ps(_mm_shuffle_ps(c, high, _MM_SHUFFLE(2, 2, 0, 0)), _mm_shuffle_ps(high, c, _MM_SHUFFLE(0, 0, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+			}
+
+			DVIG_TARGET("sse2") DVIG_SIMD_INLINE static void store_quads(BatchVertex2D* vertices, const Float x[4], const Float y[4], Float color) {
+				// Columns become the corners of each quad
+				Float x0 = x[0], x1 = x[1], x2 = x[2], x3 = x[3];
+				Float y0 = y[0], y1 = y[1], y2 = y[2], y3 = y[3];
+				_MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+				_MM_TRANSPOSE4_PS(y0, y1, y2, y3);
+
+				store_quad<0>(vertices, x0, y0, color);
+				store_quad<1>(vertices, x1, y1, color);
+				store_quad<2>(vertices, x2, y2, color);
+				store_quad<3>(vertices, x3, y3, color);
+			}
+		};
+
+		struct Avx2Ops {
+			using Float = __m256;
+			using Int = __m256i;
+			using Mask = __m256;
+			static constexpr uint32_t WIDTH = 8;
+
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float load(const float* p) { return _mm256_loadu_ps(p); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float set(float v) { return _mm256_set1_ps(v); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float bit_and(Float a, Float b) { return _mm256_and_ps(a, b); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float bit_xor(Float a, Float b) { return _mm256_xor_ps(a, b); }
+
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Int load_int(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Int set_int(uint32_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Int add_int(Int a, Int b) { return _mm256_add_epi32(a, b); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Int and_int(Int a, Int b) { return _mm256_and_si256(a, b); }
+			template<int Bits> DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Int shift_left(Int a) { return _mm256_slli_epi32(a, Bits); }
+			template<int Bits> DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Int shift_right(Int a) { return _mm256_srli_epi32(a, Bits); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Int truncate(Float a) { return _mm256_cvttps_epi32(a); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float to_float(Int a) { return _mm256_cvtepi32_ps(a); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float as_float(Int a) { return _mm256_castsi256_ps(a); }
+
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Mask is_zero(Int a) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, _mm256_setzero_si256())); }
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static Float select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+
+			// Each 128 bit half is four quads
+			template<int Half> DVIG_TARGET("avx2") DVIG_SIMD_INLINE static __m128 half(Float v) { return _mm256_extractf128_ps(v, Half); }
+
+			template<int Half> DVIG_TARGET("avx2") DVIG_SIMD_INLINE static void store_half(BatchVertex2D* vertices, const Float x[4], const Float y[4], Float color) {
+				const __m128 half_x[4] = { half<Half>(x[0]), half<Half>(x[1]), half<Half>(x[2]), half<Half>(x[3]) };
+				const __m128 half_y[4] = { half<Half>(y[0]), half<Half>(y[1]), half<Half>(y[2]), half<Half>(y[3]) };
+				Sse2Ops::store_quads(vertices + Half * 16, half_x, half_y, half<Half>(color));
+			}
+
+			DVIG_TARGET("avx2") DVIG_SIMD_INLINE static void store_quads(BatchVertex2D* vertices, const Float x[4], const Float y[4], Float color) {
+				store_half<0>(vertices, x, y, color);
+				store_half<1>(vertices, x, y, color);
+			}
+		};
+
+		// AVX-512F only, the float bit ops go through the integer ones (the float ones need DQ)
+		struct Avx512Ops {
+			using Float = __m512;
+			using Int = __m512i;
+			using Mask = __mmask16;
+			static constexpr uint32_t WIDTH = 16;
+
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float load(const float* p) { return _mm512_loadu_ps(p); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static void store(float* p, Float v) { _mm512_storeu_ps(p, v); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float set(float v) { return _mm512_set1_ps(v); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float bit_and(Float a, Float b) { return as_float(_mm512_and_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float bit_xor(Float a, Float b) { return as_float(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Int load_int(const uint32_t* p) { return _mm512_loadu_si512(p); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Int set_int(uint32_t v) { return _mm512_set1_epi32(static_cast<int>(v)); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Int add_int(Int a, Int b) { return _mm512_add_epi32(a, b); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Int and_int(Int a, Int b) { return _mm512_and_si512(a, b); }
+			template<int Bits> DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Int shift_left(Int a) { return _mm512_slli_epi32(a, Bits); }
+			template<int Bits> DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Int shift_right(Int a) { return _mm512_srli_epi32(a, Bits); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Int truncate(Float a) { return _mm512_cvttps_epi32(a); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float to_float(Int a) { return _mm512_cvtepi32_ps(a); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float as_float(Int a) { return _mm512_castsi512_ps(a); }
+
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Mask is_zero(Int a) { return _mm512_cmpeq_epi32_mask(a, _mm512_setzero_si512()); }
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static Float select(Mask mask, Float a, Float b) { return _mm512_mask_blend_ps(mask, b, a); }
+
+			// Each 128 bit quarter is four quads
+			template<int Quarter> DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static __m128 quarter(Float v) { return _mm512_extractf32x4_ps(v, Quarter); }
+
+			template<int Quarter> DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static void store_quarter(BatchVertex2D* vertices, const Float x[4], const Float y[4], Float color) {
+				const __m128 quarter_x[4] = { quarter<Quarter>(x[0]), quarter<Quarter>(x[1]), quarter<Quarter>(x[2]), quarter<Quarter>(x[3]) };
+				const __m128 quarter_y[4] = { quarter<Quarter>(y[0]), quarter<Quarter>(y[1]), quarter<Quarter>(y[2]), quarter<Quarter>(y[3]) };
+				Sse2Ops::store_quads(vertices + Quarter * 16, quarter_x, quarter_y, quarter<Quarter>(color));
+			}
+
+			DVIG_TARGET("avx512f") DVIG_SIMD_INLINE static void store_quads(BatchVertex2D* vertices, const Float x[4], const Float y[4], Float color) {
+				store_quarter<0>(vertices, x, y, color);
+				store_quarter<1>(vertices, x, y, color);
+				store_quarter<2>(vertices, x, y, color);
+				store_quarter<3>(vertices, x, y, color);
+			}
+		};
+	#endif
+
+		template<typename V>
+		void transform_2d(const glm::mat4& m, const float* x, const float* y, float* out_x, float* out_y, uint32_t count) {
+			// glm computes (m[0] * x + m[1] * y) + (m[2] * z + m[3] * w), with z = 0 and w = 1 the second half is a constant
+			const auto m0x = V::set(m[0].x);
+			const auto m0y = V::set(m[0].y);
+			const auto m1x = V::set(m[1].x);
+			const auto m1y = V::set(m[1].y);
+			const auto tx = V::set(m[2].x * 0.0f + m[3].x);
+			const auto ty = V::set(m[2].y * 0.0f + m[3].y);
+
+			uint32_t i = 0;
+			for (; i + V::WIDTH <= count; i += V::WIDTH) {
+				const auto px = V::load(x + i);
+				const auto py = V::load(y + i);
+				V::store(out_x + i, V::add(V::add(V::mul(m0x, px), V::mul(m1x, py)), tx));
+				V::store(out_y + i, V::add(V::add(V::mul(m0y, px), V::mul(m1y, py)), ty));
+			}
+
+			if constexpr (V::WIDTH > 1) {
+				transform_2d<ScalarOps>(m, x + i, y + i, out_x + i, out_y + i, count - i);
+			}
+		}
+
+		template<typename V>
+		void transform_3d(const glm::mat4& m, const float* x, const float* y, const float* z, float* out_x, float* out_y, float* out_z, uint32_t count) {
+			const auto m0x = V::set(m[0].x);
+			const auto m0y = V::set(m[0].y);
+			const auto m0z = V::set(m[0].z);
+			const auto m1x = V::set(m[1].x);
+			const auto m1y = V::set(m[1].y);
+			const auto m1z = V::set(m[1].z);
+			const auto m2x = V::set(m[2].x);
+			const auto m2y = V::set(m[2].y);
+			const auto m2z = V::set(m[2].z);
+			const auto m3x = V::set(m[3].x);
+			const auto m3y = V::set(m[3].y);
+			const auto m3z = V::set(m[3].z);
+
+			uint32_t i = 0;
+			for (; i + V::WIDTH <= count; i += V::WIDTH) {
+				const auto px = V::load(x + i);
+				const auto py = V::load(y + i);
+				const auto pz = V::load(z + i);
+				V::store(out_x + i, V::add(V::add(V::mul(m0x, px), V::mul(m1x, py)), V::add(V::mul(m2x, pz), m3x)));
+				V::store(out_y + i, V::add(V::add(V::mul(m0y, px), V::mul(m1y, py)), V::add(V::mul(m2y, pz), m3y)));
+				V::store(out_z + i, V::add(V::add(V::mul(m0z, px), V::mul(m1z, py)), V::add(V::mul(m2z, pz), m3z)));
+			}
+
+			if constexpr (V::WIDTH > 1) {
+				transform_3d<ScalarOps>(m, x + i, y + i, z + i, out_x + i, out_y + i, out_z + i, count - i);
+			}
+		}
+
+		// Cephes sinf/cosf: reduced to [-pi/4, pi/4] by octant, then a polynomial each
+		template<typename V>
+		void sin_cos(const typename V::Float& angle, typename V::Float& sin, typename V::Float& cos) {
+			const auto sign_bit = V::as_float(V::set_int(0x80000000u));
+			const auto abs_mask = V::as_float(V::set_int(0x7fffffffu));
+
+			auto sign_sin = V::bit_and(angle, sign_bit);
+			auto x = V::bit_and(angle, abs_mask);
+
+			auto octant = V::truncate(V::mul(x, V::set(1.27323954473516f))); // 4 / pi
+			octant = V::and_int(V::add_int(octant, V::set_int(1)), V::set_int(~1u));
+			const auto y = V::to_float(octant);
+
+			sign_sin = V::bit_xor(sign_sin, V::as_float(V::template shift_left<29>(V::and_int(octant, V::set_int(4)))));
+			const auto sign_cos = V::as_float(V::template shift_left<29>(V::and_int(V::add_int(octant, V::set_int(2)), V::set_int(4))));
+			const auto use_sin_poly = V::is_zero(V::and_int(octant, V::set_int(2)));
+
+			// x - y * pi / 4 in three parts, so the reduction stays exact
+			x = V::sub(x, V::mul(y, V::set(0.78515625f)));
+			x = V::sub(x, V::mul(y, V::set(2.4187564849853515625e-4f)));
+			x = V::sub(x, V::mul(y, V::set(3.77489497744594108e-8f)));
+			const auto z = V::mul(x, x);
+
+			auto cos_poly = V::add(V::mul(V::set(2.443315711809948e-5f), z), V::set(-1.388731625493765e-3f));
+			cos_poly = V::add(V::mul(cos_poly, z), V::set(4.166664568298827e-2f));
+			cos_poly = V::mul(V::mul(cos_poly, z), z);
+			cos_poly = V::add(V::sub(cos_poly, V::mul(z, V::set(0.5f))), V::set(1.0f));
+
+			auto sin_poly = V::add(V::mul(V::set(-1.9515295891e-4f), z), V::set(8.3321608736e-3f));
+			sin_poly = V::add(V::mul(sin_poly, z), V::set(-1.6666654611e-1f));
+			sin_poly = V::add(V::mul(V::mul(sin_poly, z), x), x);
+
+			sin = V::bit_xor(V::select(use_sin_poly, sin_poly, cos_poly), sign_sin);
+			cos = V::bit_xor(V::select(use_sin_poly, cos_poly, sin_poly), sign_cos);
+		}
+
+		QuadInstances advance(const QuadInstances& quads, uint32_t count) {
+			QuadInstances result = quads;
+			result.x += count;
+			result.y += count;
+			result.width += count;
+			result.height += count;
+			result.color += count;
+			if (result.rotation != nullptr) {
+				result.rotation += count;
+			}
+			return result;
+		}
+
+		template<typename V>
+		void expand(const QuadInstances& quads, uint32_t count, glm::vec2 origin, const glm::mat4& m, BatchVertex2D* vertices) {
+			const auto m0x = V::set(m[0].x);
+			const auto m0y = V::set(m[0].y);
+			const auto m1x = V::set(m[1].x);
+			const auto m1y = V::set(m[1].y);
+			const auto tx = V::set(m[2].x * 0.0f + m[3].x);
+			const auto ty = V::set(m[2].y * 0.0f + m[3].y);
+
+			// Corners p1..p4 at (0, 0), (1, 0), (0, 1), (1, 1) in quad space, relative to the origin
+			const float corner_x[2] = { 0.0f - origin.x, 1.0f - origin.x };
+			const float corner_y[2] = { 0.0f - origin.y, 1.0f - origin.y };
+
+			uint32_t i = 0;
+			for (; i + V::WIDTH <= count; i += V::WIDTH) {
+				const auto x = V::load(quads.x + i);
+				const auto y = V::load(quads.y + i);
+				const auto width = V::load(quads.width + i);
+				const auto height = V::load(quads.height + i);
+
+				auto sin = V::set(0.0f);
+				auto cos = V::set(1.0f);
+				if (quads.rotation != nullptr) {
+					sin_cos<V>(V::load(quads.rotation + i), sin, cos);
+				}
+
+				// Same as draw_rect: pos + origin * size + rotate((corner - origin) * size)
+				const auto pivot_x = V::add(x, V::mul(V::set(origin.x), width));
+				const auto pivot_y = V::add(y, V::mul(V::set(origin.y), height));
+				const typename V::Float local_x[2] = { V::mul(V::set(corner_x[0]), width), V::mul(V::set(corner_x[1]), width) };
+				const typename V::Float local_y[2] = { V::mul(V::set(corner_y[0]), height), V::mul(V::set(corner_y[1]), height) };
+
+				typename V::Float pos_x[QuadBatcher::VERTICES_PER_QUAD];
+				typename V::Float pos_y[QuadBatcher::VERTICES_PER_QUAD];
+				for (uint32_t corner = 0; corner < QuadBatcher::VERTICES_PER_QUAD; ++corner) {
+					const auto lx = local_x[corner & 1];
+					const auto ly = local_y[corner >> 1];
+					const auto world_x = V::add(pivot_x, V::sub(V::mul(lx, cos), V::mul(ly, sin)));
+					const auto world_y = V::add(pivot_y, V::add(V::mul(lx, sin), V::mul(ly, cos)));
+					pos_x[corner] = V::add(V::add(V::mul(m0x, world_x), V::mul(m1x, world_y)), tx);
+					pos_y[corner] = V::add(V::add(V::mul(m0y, world_x), V::mul(m1y, world_y)), ty);
+				}
+
+				V::store_quads(vertices + size_t(i) * QuadBatcher::VERTICES_PER_QUAD, pos_x, pos_y, V::as_float(V::load_int(quads.color + i)));
+			}
+
+			if constexpr (V::WIDTH > 1) {
+				expand<ScalarOps>(advance(quads, i), count - i, origin, m, vertices + size_t(i) * QuadBatcher::VERTICES_PER_QUAD);
+			}
+		}
+
+	#if DVIG_SIMD_X86
+		DVIG_TARGET_ENTRY("sse2") void transform_2d_sse2(const glm::mat4& m, const float* x, const float* y, float* out_x, float* out_y, uint32_t count) {
+			transform_2d<Sse2Ops>(m, x, y, out_x, out_y, count);
+		}
+
+		DVIG_TARGET_ENTRY("avx2") void transform_2d_avx2(const glm::mat4& m, const float* x, const float* y, float* out_x, float* out_y, uint32_t count) {
+			transform_2d<Avx2Ops>(m, x, y, out_x, out_y, count);
+		}
+
+		DVIG_TARGET_ENTRY("avx512f") void transform_2d_avx512(const glm::mat4& m, const float* x, const float* y, float* out_x, float* out_y, uint32_t count) {
+			transform_2d<Avx512Ops>(m, x, y, out_x, out_y, count);
+		}
+
+		DVIG_TARGET_ENTRY("sse2") void transform_3d_sse2(const glm::mat4& m, const float* x, const float* y, const float* z, float* out_x, float* out_y, float* out_z, uint32_t count) {
+			transform_3d<Sse2Ops>(m, x, y, z, out_x, out_y, out_z, count);
+		}
+
+		DVIG_TARGET_ENTRY("avx2") void transform_3d_avx2(const glm::mat4& m, const float* x, const float* y, const float* z, float* out_x, float* out_y, float* out_z, uint32_t count) {
+			transform_3d<Avx2Ops>(m, x, y, z, out_x, out_y, out_z, count);
+		}
+
+		DVIG_TARGET_ENTRY("avx512f") void transform_3d_avx512(const glm::mat4& m, const float* x, const float* y, const float* z, float* out_x, float* out_y, float* out_z, uint32_t count) {
+			transform_3d<Avx512Ops>(m, x, y, z, out_x, out_y, out_z, count);
+		}
+
+		DVIG_TARGET_ENTRY("sse2") void expand_sse2(const QuadInstances& quads, uint32_t count, glm::vec2 origin, const glm::mat4& m, BatchVertex2D* vertices) {
+			expand<Sse2Ops>(quads, count, origin, m, vertices);
+		}
+
+		DVIG_TARGET_ENTRY("avx2") void expand_avx2(const QuadInstances& quads, uint32_t count, glm::vec2 origin, const glm::mat4& m, BatchVertex2D* vertices) {
+			expand<Avx2Ops>(quads, count, origin, m, vertices);
+		}
+
+		DVIG_TARGET_ENTRY("avx512f") void expand_avx512(const QuadInstances& quads, uint32_t count, glm::vec2 origin, const glm::mat4& m, BatchVertex2D* vertices) {
+			expand<Avx512Ops>(quads, count, origin, m, vertices);
+		}
+
+		void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4]) {
+		#ifdef _MSC_VER
+			int result[4];
+			__cpuidex(result, static_cast<int>(leaf), static_cast<int>(subleaf));
+			memcpy(registers, result, sizeof(result));
+		#else
+			__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+		#endif
+		}
+
+		// Which register states the OS saves on a context switch
+		uint64_t xgetbv() {
+		#ifdef _MSC_VER
+			return _xgetbv(0);
+		#else
+			uint32_t low, high;
+			__asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+			return (uint64_t(high) << 32) | low;
+		#endif
+		}
+	#endif
+
+		SimdLevel cpu_simd_level() {
+		#if DVIG_SIMD_X86
+			uint32_t registers[4] = {};
+			cpuid(0, 0, registers);
+			const uint32_t max_leaf = registers[0];
+
+			cpuid(1, 0, registers);
+			const bool sse2 = registers[3] & (1u << 26);
+			const bool osxsave = registers[2] & (1u << 27);
+			const bool avx = registers[2] & (1u << 28);
+			if (!sse2) {
+				return SimdLevel::Scalar;
+			}
+
+			if (!osxsave || !avx || max_leaf < 7) {
+				return SimdLevel::SSE2;
+			}
+
+			const uint64_t xcr0 = xgetbv();
+			cpuid(7, 0, registers);
+			const bool avx2 = (registers[1] & (1u << 5)) && (xcr0 & 0x6) == 0x6;          // xmm, ymm
+			const bool avx512 = avx2 && (registers[1] & (1u << 16)) && (xcr0 & 0xe6) == 0xe6; // and opmask, zmm
+			if (avx512) {
+				return SimdLevel::AVX512;
+			}
+			return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+		#else
+			return SimdLevel::Scalar;
+		#endif
+		}
+
+		std::atomic<SimdLevel>& current_level() {
+			static std::atomic<SimdLevel> level(detect_simd_level());
+			return level;
+		}
+	}
+
+	const char* simd_level_name(SimdLevel level) {
+		switch (level) {
+			case SimdLevel::Scalar: return "Scalar";
+			case SimdLevel::SSE2:   return "SSE2";
+			case SimdLevel::AVX2:   return "AVX2";
+			case SimdLevel::AVX512: return "AVX-512";
+		}
+		return "Unknown";
+	}
+
+	SimdLevel detect_simd_level() {
+		return std::min(cpu_simd_level(), MAX_BUILD_LEVEL);
+	}
+
+	SimdLevel simd_level() {
+		return current_level().load(std::memory_order_relaxed);
+	}
+
+	void set_simd_level(SimdLevel level) {
+		current_level().store(std::min(level, detect_simd_level()), std::memory_order_relaxed);
+	}
+
+	void transform_points_2d(
+		const glm::mat4& transform,
+		const float* x, const float* y,
+		float* out_x, float* out_y,
+		uint32_t count
+	) {
+		switch (simd_level()) {
+		#if DVIG_SIMD_X86
+			case SimdLevel::AVX512: transform_2d_avx512(transform, x, y, out_x, out_y, count); return;
+			case SimdLevel::AVX2:   transform_2d_avx2(transform, x, y, out_x, out_y, count); return;
+			case SimdLevel::SSE2:   transform_2d_sse2(transform, x, y, out_x, out_y, count); return;
+		#endif
+			default: transform_2d<ScalarOps>(transform, x, y, out_x, out_y, count); return;
+		}
+	}
+
+	void transform_points_3d(
+		const glm::mat4& transform,
+		const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z,
+		uint32_t count
+	) {
+		switch (simd_level()) {
+		#if DVIG_SIMD_X86
+			case SimdLevel::AVX512: transform_3d_avx512(transform, x, y, z, out_x, out_y, out_z, count); return;
+			case SimdLevel::AVX2:   transform_3d_avx2(transform, x, y, z, out_x, out_y, out_z, count); return;
+			case SimdLevel::SSE2:   transform_3d_sse2(transform, x, y, z, out_x, out_y, out_z, count); return;
+		#endif
+			default: transform_3d<ScalarOps>(transform, x, y, z, out_x, out_y, out_z, count); return;
+		}
+	}
+
+	void expand_quads(
+		const QuadInstances& quads, uint32_t count,
+		glm::vec2 origin,
+		const glm::mat4& transform,
+		BatchVertex2D* vertices
+	) {
+		assert(count == 0 || (quads.x && quads.y && quads.width && quads.height && quads.color));
+
+		switch (simd_level()) {
+		#if DVIG_SIMD_X86
+			case SimdLevel::AVX512: expand_avx512(quads, count, origin, transform, vertices); return;
+			case SimdLevel::AVX2:   expand_avx2(quads, count, origin, transform, vertices); return;
+			case SimdLevel::SSE2:   expand_sse2(quads, count, origin, transform, vertices); return;
+		#endif
+			default: expand<ScalarOps>(quads, count, origin, transform, vertices); return;
+		}
+	}
+}
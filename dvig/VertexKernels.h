@@ -0,0 +1,62 @@
+#pragma once
+#include "pch.h"
+
+#include "QuadBatch.h"
+
+namespace dvig {
+	// Instruction sets the vertex kernels have a path for, from slowest to fastest
+	enum class SimdLevel : uint32_t {
+		Scalar,
+		SSE2,
+		AVX2,
+		AVX512,
+	};
+
+	const char* simd_level_name(SimdLevel level);
+
+	// Best level the CPU and the OS both support, from CPUID. Scalar when not on x86.
+	// Unoptimized GCC and Clang builds stop at the level the compiler targets everywhere (SSE2 by default)
+	SimdLevel detect_simd_level();
+	// Level the kernels run at, detect_simd_level() until set_simd_level() is called
+	SimdLevel simd_level();
+	// Clamped to detect_simd_level(). Every level gives bit identical results, this is for tests and benchmarks
+	void set_simd_level(SimdLevel level);
+
+	// out = transform * (x, y, 0, 1), keeping xy. Matches glm's mat4 * vec4 bit for bit.
+	// The transform has to be affine, nothing is divided by w. The outputs may be the inputs
+	void transform_points_2d(
+		const glm::mat4& transform,
+		const float* x, const float* y,
+		float* out_x, float* out_y,
+		uint32_t count
+	);
+
+	// out = transform * (x, y, z, 1), keeping xyz. Same rules as transform_points_2d
+	void transform_points_3d(
+		const glm::mat4& transform,
+		const float* x, const float* y, const float* z,
+		float* out_x, float* out_y, float* out_z,
+		uint32_t count
+	);
+
+	// Quads as parallel arrays, one element per quad in each
+	struct QuadInstances {
+		const float* x = nullptr;
+		const float* y = nullptr;
+		const float* width = nullptr;
+		const float* height = nullptr;
+		const float* rotation = nullptr; // Radians, nullptr when no quad is rotated
+		const uint32_t* color = nullptr; // RGBA8, R in the lowest byte
+	};
+
+	// Writes 4 vertices per quad, p1..p4 like QuadBatcher::push_quad, with the same math as
+	// draw_rect: the quad spans pos to pos + size and turns around pos + origin * size.
+	// The sine and cosine come from one polynomial shared by every level, within a few ulp of
+	// std::sin/std::cos for rotations below 8192 radians
+	void expand_quads(
+		const QuadInstances& quads, uint32_t count,
+		glm::vec2 origin,
+		const glm::mat4& transform,
+		BatchVertex2D* vertices
+	);
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include "pch.h"
+
+namespace dvig {
+	enum class VertexFormat {
+		Float,
+		Float2,
+		Float3,
+		Float4,
+		RGBA8_UNorm, // 4 bytes unpacked to float4 in 0..1
+		UInt,
+	};
+
+	constexpr uint32_t vertex_format_size(VertexFormat format) {
+		switch (format) {
+			case VertexFormat::Float: return 4;
+			case VertexFormat::Float2: return 8;
+			case VertexFormat::Float3: return 12;
+			case VertexFormat::Float4: return 16;
+			case VertexFormat::RGBA8_UNorm: return 4;
+			case VertexFormat::UInt: return 4;
+		}
+		return 0;
+	}
+
+	// Backend neutral version of D3D11_INPUT_ELEMENT_DESC
+	struct VertexElement {
+		const char* semantic = "";
+		uint32_t semantic_index = 0;
+		VertexFormat format = VertexFormat::Float;
+		uint32_t slot = 0;
+		uint32_t offset = 0;
+		bool per_instance = false;
+		uint32_t instance_step_rate = 0; // Only used when per_instance is set
+	};
+
+	// Format a field type maps to when the attribute doesn't name one
+	template<typename Type> struct VertexFormatOf;
+	template<> struct VertexFormatOf<float> { static constexpr VertexFormat value = VertexFormat::Float; };
+	template<> struct VertexFormatOf<glm::vec2> { static constexpr VertexFormat value = VertexFormat::Float2; };
+	template<> struct VertexFormatOf<glm::vec3> { static constexpr VertexFormat value = VertexFormat::Float3; };
+	template<> struct VertexFormatOf<glm::vec4> { static constexpr VertexFormat value = VertexFormat::Float4; };
+	template<> struct VertexFormatOf<uint32_t> { static constexpr VertexFormat value = VertexFormat::UInt; };
+
+	// One field of a vertex struct. Made with DVIG_VERTEX_ATTRIBUTE, which takes offset and size from the field itself
+	struct VertexAttribute {
+		const char* semantic = "";
+		uint32_t semantic_index = 0;
+		VertexFormat format = VertexFormat::Float;
+		uint32_t offset = 0;
+		uint32_t field_size = 0;
+	};
+
+	// Specialize with a static constexpr std::array<VertexAttribute, N> attributes, e.g.
+	//
+	//   template<> struct VertexLayout<Vertex2D> {
+	//       static constexpr std::array attributes = {
+	//           DVIG_VERTEX_ATTRIBUTE(Vertex2D, pos, "POSITION"),
+	//       };
+	//   };
+	//
+	// Everything below is computed from it at compile time.
+	template<typename Vertex>
+	struct VertexLayout;
+
+	// Returns nullptr when the layout is fine, otherwise why it isn't
+	template<typename Vertex>
+	constexpr const char* vertex_layout_error() {
+		constexpr auto& attributes = VertexLayout<Vertex>::attributes;
+
+		uint32_t covered = 0;
+		uint32_t end = 0;
+		for (const VertexAttribute& attribute : attributes) {
+			if (vertex_format_size(attribute.format) != attribute.field_size) {
+				return "format size doesn't match the field size";
+			}
+			if (attribute.offset % 4 != 0) {
+				return "field isn't 4 byte aligned";
+			}
+			if (attribute.offset < end) {
+				return "attributes have to be listed in field order";
+			}
+			end = attribute.offset + attribute.field_size;
+			covered += attribute.field_size;
+		}
+
+		if (covered != sizeof(Vertex)) {
+			return "attributes don't cover the whole struct (missing field or padding)";
+		}
+		return nullptr;
+	}
+
+	template<typename Vertex>
+	constexpr uint32_t vertex_stride() {
+		static_assert(std::is_trivially_copyable_v<Vertex>, "Vertices are uploaded as bytes");
+		static_assert(std::is_standard_layout_v<Vertex>, "offsetof needs a standard layout struct");
+		static_assert(vertex_layout_error<Vertex>() == nullptr, "VertexLayout doesn't match the struct, see vertex_layout_error()");
+		return static_cast<uint32_t>(sizeof(Vertex));
+	}
+
+	// Input layout elements of Vertex for the given buffer slot
+	template<typename Vertex>
+	constexpr auto vertex_element_array(uint32_t slot = 0, bool per_instance = false) {
+		static_assert(vertex_stride<Vertex>() > 0);
+
+		constexpr auto& attributes = VertexLayout<Vertex>::attributes;
+		std::array<VertexElement, attributes.size()> elements = {};
+		for (size_t i = 0; i < attributes.size(); ++i) {
+			elements[i].semantic = attributes[i].semantic;
+			elements[i].semantic_index = attributes[i].semantic_index;
+			elements[i].format = attributes[i].format;
+			elements[i].slot = slot;
+			elements[i].offset = attributes[i].offset;
+			elements[i].per_instance = per_instance;
+			elements[i].instance_step_rate = per_instance ? 1 : 0;
+		}
+		return elements;
+	}
+
+	// Same as vertex_element_array, appended to layout. Chain it for several slots
+	template<typename Vertex>
+	void append_vertex_elements(std::vector<VertexElement>& layout, uint32_t slot = 0, bool per_instance = false) {
+		const auto elements = vertex_element_array<Vertex>(slot, per_instance);
+		layout.insert(layout.end(), elements.begin(), elements.end());
+	}
+
+	template<typename Vertex>
+	std::vector<VertexElement> vertex_elements(uint32_t slot = 0, bool per_instance = false) {
+		std::vector<VertexElement> layout;
+		append_vertex_elements<Vertex>(layout, slot, per_instance);
+		return layout;
+	}
+}
+
+// Format from the field type
+#define DVIG_VERTEX_ATTRIBUTE(Vertex, field, semantic) \
+	::dvig::VertexAttribute { semantic, 0, ::dvig::VertexFormatOf<decltype(Vertex::field)>::value, offsetof(Vertex, field), sizeof(Vertex::field) }
+
+// Explicit format, e.g. VertexFormat::RGBA8_UNorm for a packed uint32_t color
+#define DVIG_VERTEX_ATTRIBUTE_FORMAT(Vertex, field, semantic, format) \
+	::dvig::VertexAttribute { semantic, 0, format, offsetof(Vertex, field), sizeof(Vertex::field) }
@@ -0,0 +1,363 @@
+#include "pch.h"
+#include "World.h"
+
+namespace dvig {
+	namespace {
+		// Written once per type before its id is handed out, read without the lock afterwards
+		std::array<ComponentInfo, MAX_COMPONENT_TYPES> g_component_infos;
+		uint32_t g_component_count = 0;
+		std::mutex g_component_mutex;
+
+		uint32_t align_up(uint32_t value, uint32_t alignment) {
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		constexpr uint32_t COLUMN_ALIGNMENT = 64;
+		constexpr uint32_t ENTITY_SIZE = static_cast<uint32_t>(sizeof(Entity));
+	}
+
+	uint32_t register_component(const ComponentInfo& info) {
+		std::lock_guard<std::mutex> lock(g_component_mutex);
+		if (g_component_count == MAX_COMPONENT_TYPES) {
+			std::cerr << "More than " << MAX_COMPONENT_TYPES << " component types!\n";
+			abort();
+		}
+
+		g_component_infos[g_component_count] = info;
+		return g_component_count++;
+	}
+
+	const ComponentInfo& component_info(uint32_t id) {
+		assert(id < MAX_COMPONENT_TYPES);
+		return g_component_infos[id];
+	}
+
+	Archetype::Archetype(ComponentMask mask) : _mask(mask) {
+		_offsets.fill(~0u);
+		for (uint32_t component = 0; component < MAX_COMPONENT_TYPES; ++component) {
+			if (has(component)) {
+				_components.push_back(component);
+			}
+		}
+
+		// Columns start on a cache line, so the biggest capacity whose padded layout still fits
+		uint32_t row_size = ENTITY_SIZE;
+		for (uint32_t component : _components) {
+			row_size += component_info(component).size;
+		}
+
+		auto layout_size = [&](uint32_t capacity) {
+			uint32_t size = capacity * ENTITY_SIZE;
+			for (uint32_t component : _components) {
+				size = align_up(size, std::max(COLUMN_ALIGNMENT, component_info(component).alignment));
+				size += capacity * component_info(component).size;
+			}
+			return size;
+		};
+
+		_chunk_capacity = CHUNK_SIZE / row_size;
+		while (_chunk_capacity > 0 && layout_size(_chunk_capacity) > CHUNK_SIZE) {
+			_chunk_capacity--;
+		}
+
+		if (_chunk_capacity == 0) {
+			std::cerr << "Components of an archetype don't fit into a " << CHUNK_SIZE << " byte chunk!\n";
+			abort();
+		}
+
+		uint32_t offset = _chunk_capacity * ENTITY_SIZE;
+		for (uint32_t component : _components) {
+			offset = align_up(offset, std::max(COLUMN_ALIGNMENT, component_info(component).alignment));
+			_offsets[component] = offset;
+			offset += _chunk_capacity * component_info(component).size;
+		}
+	}
+
+	Archetype::~Archetype() {
+		clear();
+	}
+
+	uint32_t Archetype::push(Entity entity) {
+		const uint32_t row = _size;
+		if (row == _chunks.size() * _chunk_capacity) {
+			// Not zeroed, every component is constructed in place
+			_chunks.push_back(Unique<Chunk>(new Chunk));
+		}
+
+		_size++;
+		this->entity(row) = entity;
+		return row;
+	}
+
+	Entity Archetype::erase(uint32_t row) {
+		assert(row < _size);
+		const uint32_t last = _size - 1;
+
+		Entity moved;
+		if (row != last) {
+			for (uint32_t component : _components) {
+				component_info(component).relocate(this->component(row, component), this->component(last, component));
+			}
+			moved = entity(last);
+			entity(row) = moved;
+		}
+
+		_size--;
+		if (_chunks.size() * _chunk_capacity - _size > 2 * _chunk_capacity - 1) {
+			_chunks.pop_back();
+		}
+		return moved;
+	}
+
+	void Archetype::destroy_row(uint32_t row) {
+		for (uint32_t component : _components) {
+			component_info(component).destroy(this->component(row, component));
+		}
+	}
+
+	void Archetype::clear() {
+		for (uint32_t component : _components) {
+			const ComponentInfo& info = component_info(component);
+			for (uint32_t row = 0; row < _size; ++row) {
+				info.destroy(this->component(row, component));
+			}
+		}
+
+		_size = 0;
+		_chunks.resize(std::min<size_t>(_chunks.size(), 1));
+	}
+
+	void CommandBuffer::destroy(Entity entity) {
+		Command& command = _commands.emplace_back();
+		command.type = CommandType::Destroy;
+		command.entity = entity;
+	}
+
+	void CommandBuffer::clear() {
+		for (const Payload& payload : _payloads) {
+			component_info(payload.component).destroy(payload.value);
+		}
+		reset();
+	}
+
+	void* CommandBuffer::allocate(uint32_t size, uint32_t alignment) {
+		uint32_t offset = align_up(_block_offset, alignment);
+		if (_block < _blocks.size() && offset + size > sizeof(Block)) {
+			_block++;
+			offset = 0;
+		}
+
+		if (_block == _blocks.size()) {
+			_blocks.push_back(Unique<Block>(new Block));
+			offset = 0;
+		}
+
+		_block_offset = offset + size;
+		return _blocks[_block]->bytes + offset;
+	}
+
+	void CommandBuffer::reset() {
+		_commands.clear();
+		_payloads.clear();
+		_block = 0;
+		_block_offset = 0;
+	}
+
+	void World::destroy(Entity entity) {
+		assert_no_queries();
+
+		EntityRecord* record = find(entity);
+		if (record == nullptr) {
+			return;
+		}
+
+		Archetype& archetype = *record->archetype;
+		archetype.destroy_row(record->row);
+		const Entity moved = archetype.erase(record->row);
+		if (moved.valid()) {
+			_records[moved.index].row = record->row;
+		}
+
+		record->archetype = nullptr;
+		record->generation++;
+		_free_records.push_back(entity.index);
+		_entity_count--;
+	}
+
+	uint32_t World::count(ComponentMask required, ComponentMask exclude) const {
+		uint32_t result = 0;
+		for (const Archetype* archetype : _archetypes) {
+			if ((archetype->mask() & required) == required && (archetype->mask() & exclude) == 0) {
+				result += archetype->size();
+			}
+		}
+		return result;
+	}
+
+	void World::apply(CommandBuffer& commands) {
+		assert_no_queries();
+
+		for (const CommandBuffer::Command& command : commands._commands) {
+			const CommandBuffer::Payload* payloads = commands._payloads.data() + command.payload_start;
+
+			switch (command.type) {
+				case CommandBuffer::CommandType::Create: {
+					ComponentMask mask = 0;
+					for (uint32_t i = 0; i < command.payload_count; ++i) {
+						mask |= ComponentMask(1) << payloads[i].component;
+					}
+					assert(component_count(mask) == command.payload_count && "Component listed twice");
+
+					Entity entity;
+					Archetype& target = archetype(mask);
+					const uint32_t row = create_row(target, entity);
+					for (uint32_t i = 0; i < command.payload_count; ++i) {
+						component_info(payloads[i].component).relocate(target.component(row, payloads[i].component), payloads[i].value);
+					}
+					break;
+				}
+				case CommandBuffer::CommandType::Destroy:
+					destroy(command.entity);
+					break;
+				case CommandBuffer::CommandType::Add: {
+					const CommandBuffer::Payload& payload = payloads[0];
+					const ComponentInfo& info = component_info(payload.component);
+
+					const EntityRecord* record = find(command.entity);
+					if (record == nullptr) {
+						info.destroy(payload.value);
+					} else if (record->archetype->has(payload.component)) {
+						void* existing = record->archetype->component(record->row, payload.component);
+						info.destroy(existing);
+						info.relocate(existing, payload.value);
+					} else {
+						info.relocate(add_slot(command.entity, payload.component), payload.value);
+					}
+					break;
+				}
+				case CommandBuffer::CommandType::Remove:
+					remove(command.entity, command.component);
+					break;
+			}
+		}
+
+		// Every payload was moved out or destroyed above
+		commands.reset();
+	}
+
+	void World::clear() {
+		assert_no_queries();
+
+		for (Archetype* archetype : _archetypes) {
+			archetype->clear();
+		}
+
+		_free_records.clear();
+		for (uint32_t index = static_cast<uint32_t>(_records.size()); index-- > 0;) {
+			EntityRecord& record = _records[index];
+			if (record.archetype != nullptr) {
+				record.archetype = nullptr;
+				record.generation++;
+			}
+			_free_records.push_back(index);
+		}
+		_entity_count = 0;
+	}
+
+	const World::EntityRecord* World::find(Entity entity) const {
+		if (entity.index >= _records.size()) {
+			return nullptr;
+		}
+
+		const EntityRecord& record = _records[entity.index];
+		if (record.archetype == nullptr || record.generation != entity.generation) {
+			return nullptr;
+		}
+		return &record;
+	}
+
+	Archetype& World::archetype(ComponentMask mask) {
+		Unique<Archetype>& archetype = _archetype_map[mask];
+		if (!archetype) {
+			archetype = std::make_unique<Archetype>(mask);
+			_archetypes.push_back(archetype.get());
+		}
+		return *archetype;
+	}
+
+	uint32_t World::create_row(Archetype& target, Entity& entity) {
+		assert_no_queries();
+
+		if (_free_records.empty()) {
+			entity = { static_cast<uint32_t>(_records.size()), 0 };
+			_records.emplace_back();
+		} else {
+			const uint32_t index = _free_records.back();
+			_free_records.pop_back();
+			entity = { index, _records[index].generation };
+		}
+
+		const uint32_t row = target.push(entity);
+		EntityRecord& record = _records[entity.index];
+		record.archetype = &target;
+		record.row = row;
+		_entity_count++;
+		return row;
+	}
+
+	void World::move(EntityRecord& record, Archetype& target) {
+		Archetype& source = *record.archetype;
+		const uint32_t source_row = record.row;
+		const uint32_t target_row = target.push(source.entity(source_row));
+
+		for (uint32_t component : source.components()) {
+			void* from = source.component(source_row, component);
+			if (target.has(component)) {
+				component_info(component).relocate(target.component(target_row, component), from);
+			} else {
+				component_info(component).destroy(from);
+			}
+		}
+
+		const Entity moved = source.erase(source_row);
+		if (moved.valid()) {
+			_records[moved.index].row = source_row;
+		}
+
+		record.archetype = &target;
+		record.row = target_row;
+	}
+
+	void* World::add_slot(Entity entity, uint32_t component) {
+		assert_no_queries();
+
+		EntityRecord* record = find(entity);
+		if (record == nullptr || record->archetype->has(component)) {
+			return nullptr;
+		}
+
+		Archetype*& edge = record->archetype->_add_edges[component];
+		if (edge == nullptr) {
+			edge = &archetype(record->archetype->mask() | (ComponentMask(1) << component));
+		}
+
+		move(*record, *edge);
+		return edge->component(record->row, component);
+	}
+
+	void World::remove(Entity entity, uint32_t component) {
+		assert_no_queries();
+
+		EntityRecord* record = find(entity);
+		if (record == nullptr || !record->archetype->has(component)) {
+			return;
+		}
+
+		Archetype*& edge = record->archetype->_remove_edges[component];
+		if (edge == nullptr) {
+			edge = &archetype(record->archetype->mask() & ~(ComponentMask(1) << component));
+		}
+
+		move(*record, *edge);
+	}
+}
@@ -0,0 +1,368 @@
+#pragma once
+#include "pch.h"
+
+#include "Types.h"
+
+namespace dvig {
+	// Stays valid until the entity is destroyed, its slot is then reused with the next generation
+	struct Entity {
+		uint32_t index = ~0u;
+		uint32_t generation = 0;
+
+		bool valid() const { return index != ~0u; }
+		bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const Entity& other) const { return !(*this == other); }
+	};
+
+	// One bit per component type
+	using ComponentMask = uint64_t;
+	constexpr uint32_t MAX_COMPONENT_TYPES = 64;
+
+	// Type erased operations, registered the first time component_id<T>() sees a type
+	struct ComponentInfo {
+		uint32_t size = 0;
+		uint32_t alignment = 0;
+		// Moves source into uninitialized destination and destroys source
+		void (*relocate)(void* destination, void* source) = nullptr;
+		void (*destroy)(void* component) = nullptr;
+	};
+
+	// Thread safe. Aborts past MAX_COMPONENT_TYPES
+	uint32_t register_component(const ComponentInfo& info);
+	const ComponentInfo& component_info(uint32_t id);
+
+	// Ids are handed out in first use order, they aren't stable between runs. const T is the same component as T
+	template<typename Component>
+	uint32_t component_id() {
+		if constexpr (std::is_const_v<Component>) {
+			return component_id<std::remove_const_t<Component>>();
+		} else {
+			static_assert(std::is_move_constructible_v<Component>, "Components have to be movable");
+			static const uint32_t id = register_component({
+				static_cast<uint32_t>(sizeof(Component)),
+				static_cast<uint32_t>(alignof(Component)),
+				[](void* destination, void* source) {
+					Component* from = static_cast<Component*>(source);
+					new (destination) Component(std::move(*from));
+					from->~Component();
+				},
+				[](void* component) { static_cast<Component*>(component)->~Component(); },
+			});
+			return id;
+		}
+	}
+
+	template<typename... Components>
+	ComponentMask component_mask() {
+		return (ComponentMask(0) | ... | (ComponentMask(1) << component_id<Components>()));
+	}
+
+	inline uint32_t component_count(ComponentMask mask) {
+		uint32_t count = 0;
+		for (; mask != 0; mask &= mask - 1) {
+			count++;
+		}
+		return count;
+	}
+
+	// Every entity with exactly the same set of components. Rows are packed into fixed size chunks and
+	// every component is an array of its own inside a chunk (SoA), so a query only streams what it asks for.
+	// Rows stay dense, erasing one moves the last row into the hole.
+	class Archetype {
+		friend class World;
+	public:
+		static constexpr uint32_t CHUNK_SIZE = 16 * 1024;
+
+		explicit Archetype(ComponentMask mask);
+		~Archetype();
+
+		Archetype(const Archetype&) = delete;
+		Archetype& operator=(const Archetype&) = delete;
+
+		ComponentMask mask() const { return _mask; }
+		bool has(uint32_t component) const { return (_mask >> component) & 1; }
+		const std::vector<uint32_t>& components() const { return _components; }
+
+		uint32_t size() const { return _size; }
+		uint32_t chunk_capacity() const { return _chunk_capacity; }
+		// Chunks holding rows. Every one is full but the last
+		uint32_t chunk_count() const { return (_size + _chunk_capacity - 1) / _chunk_capacity; }
+		uint32_t chunk_size(uint32_t chunk) const { return std::min(_size - chunk * _chunk_capacity, _chunk_capacity); }
+
+		Entity* entities(uint32_t chunk) { return reinterpret_cast<Entity*>(_chunks[chunk]->bytes); }
+		// Cache line aligned array of chunk_capacity() components
+		void* column(uint32_t chunk, uint32_t component) { return _chunks[chunk]->bytes + _offsets[component]; }
+
+		Entity& entity(uint32_t row) { return entities(row / _chunk_capacity)[row % _chunk_capacity]; }
+		void* component(uint32_t row, uint32_t component) {
+			return static_cast<uint8_t*>(column(row / _chunk_capacity, component)) + static_cast<size_t>(row % _chunk_capacity) * component_info(component).size;
+		}
+
+	private:
+		struct alignas(64) Chunk {
+			uint8_t bytes[CHUNK_SIZE];
+		};
+
+		// Appends a row with uninitialized components
+		uint32_t push(Entity entity);
+		// Moves the last row into row. Its components have to be destroyed or moved out already.
+		// Returns the entity that moved, invalid when row was the last one
+		Entity erase(uint32_t row);
+		// Destroys every component of the row
+		void destroy_row(uint32_t row);
+		void clear();
+
+	private:
+		ComponentMask _mask = 0;
+		std::vector<uint32_t> _components; // Ascending ids
+		std::array<uint32_t, MAX_COMPONENT_TYPES> _offsets; // Of each column in a chunk, by component id
+		uint32_t _chunk_capacity = 0;
+		uint32_t _size = 0;
+		std::vector<Unique<Chunk>> _chunks; // One empty chunk is kept around so a row going back and forth doesn't free and allocate
+
+		// Archetype with one component more or less, filled in as World moves entities
+		std::array<Archetype*, MAX_COMPONENT_TYPES> _add_edges = {};
+		std::array<Archetype*, MAX_COMPONENT_TYPES> _remove_edges = {};
+	};
+
+	// Structural changes recorded during a query or on another thread, World::apply runs them in record order.
+	// Component values are moved into the buffer when recorded. One buffer per thread, it isn't thread safe
+	class CommandBuffer {
+		friend class World;
+	public:
+		CommandBuffer() = default;
+		~CommandBuffer() { clear(); }
+
+		CommandBuffer(const CommandBuffer&) = delete;
+		CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+		// No handle comes back, the entity only exists once applied
+		template<typename... Components>
+		void create(Components&&... components) {
+			Command& command = _commands.emplace_back();
+			command.type = CommandType::Create;
+			command.payload_start = static_cast<uint32_t>(_payloads.size());
+			command.payload_count = sizeof...(Components);
+			(push_payload<std::decay_t<Components>>(std::forward<Components>(components)), ...);
+		}
+
+		// Stale entities are skipped on apply
+		void destroy(Entity entity);
+
+		// Replaces the value when the entity has it already
+		template<typename Component>
+		void add(Entity entity, Component&& component) {
+			Command& command = _commands.emplace_back();
+			command.type = CommandType::Add;
+			command.entity = entity;
+			command.payload_start = static_cast<uint32_t>(_payloads.size());
+			command.payload_count = 1;
+			push_payload<std::decay_t<Component>>(std::forward<Component>(component));
+		}
+
+		template<typename Component>
+		void remove(Entity entity) {
+			Command& command = _commands.emplace_back();
+			command.type = CommandType::Remove;
+			command.entity = entity;
+			command.component = component_id<Component>();
+		}
+
+		bool empty() const { return _commands.empty(); }
+		uint32_t size() const { return static_cast<uint32_t>(_commands.size()); }
+		// Drops what wasn't applied
+		void clear();
+
+	private:
+		enum class CommandType : uint8_t {
+			Create,
+			Destroy,
+			Add,
+			Remove,
+		};
+
+		struct Command {
+			CommandType type = CommandType::Create;
+			Entity entity;
+			uint32_t component = 0;     // Remove
+			uint32_t payload_start = 0; // Create and Add
+			uint32_t payload_count = 0;
+		};
+
+		struct Payload {
+			uint32_t component = 0;
+			void* value = nullptr;
+		};
+
+		// Payloads never move once recorded, so any component type can wait here
+		struct alignas(64) Block {
+			uint8_t bytes[Archetype::CHUNK_SIZE];
+		};
+
+		template<typename Component, typename Value>
+		void push_payload(Value&& value) {
+			static_assert(sizeof(Component) <= sizeof(Block) && alignof(Component) <= alignof(Block), "Component too big for a command buffer");
+			void* memory = allocate(sizeof(Component), alignof(Component));
+			new (memory) Component(std::forward<Value>(value));
+			_payloads.push_back({ component_id<Component>(), memory });
+		}
+
+		void* allocate(uint32_t size, uint32_t alignment);
+		// After apply moved every payload out
+		void reset();
+
+	private:
+		std::vector<Command> _commands;
+		std::vector<Payload> _payloads;
+		std::vector<Unique<Block>> _blocks; // Kept across clears
+		uint32_t _block = 0;                // Being filled
+		uint32_t _block_offset = 0;
+	};
+
+	// Entities and their components, stored by archetype.
+	// Structural changes (create, destroy, add, remove) move rows between archetypes and aren't allowed while
+	// a query runs, record them into a CommandBuffer and apply() it afterwards.
+	// Queries and get() only read the structure, so any number of them can run on different threads at once.
+	class World {
+	public:
+		World() = default;
+		~World() = default;
+
+		World(const World&) = delete;
+		World& operator=(const World&) = delete;
+
+		template<typename... Components>
+		Entity create(Components&&... components) {
+			const ComponentMask mask = component_mask<std::decay_t<Components>...>();
+			assert(component_count(mask) == sizeof...(Components) && "Component listed twice");
+
+			Entity entity;
+			Archetype& target = archetype(mask);
+			const uint32_t row = create_row(target, entity);
+			(new (target.component(row, component_id<std::decay_t<Components>>())) std::decay_t<Components>(std::forward<Components>(components)), ...);
+			return entity;
+		}
+
+		// Stale entities are ignored
+		void destroy(Entity entity);
+		bool alive(Entity entity) const { return find(entity) != nullptr; }
+
+		// Replaces the value when the entity has it already. Stale entities are ignored
+		template<typename Component>
+		void add(Entity entity, Component&& component) {
+			using Type = std::decay_t<Component>;
+			if (Type* existing = get<Type>(entity)) {
+				*existing = std::forward<Component>(component);
+			} else if (void* slot = add_slot(entity, component_id<Type>())) {
+				new (slot) Type(std::forward<Component>(component));
+			}
+		}
+
+		template<typename Component>
+		void remove(Entity entity) { remove(entity, component_id<Component>()); }
+
+		template<typename Component>
+		bool has(Entity entity) const {
+			const EntityRecord* record = find(entity);
+			return record != nullptr && record->archetype->has(component_id<Component>());
+		}
+
+		// nullptr for stale entities and ones without it. Good until the next structural change
+		template<typename Component>
+		Component* get(Entity entity) {
+			const EntityRecord* record = find(entity);
+			const uint32_t component = component_id<Component>();
+			if (record == nullptr || !record->archetype->has(component)) {
+				return nullptr;
+			}
+			return static_cast<Component*>(record->archetype->component(record->row, component));
+		}
+
+		// function(Components&...) or function(Entity, Components&...) for every entity with all of Components
+		// and none of exclude. Ask for const Components when they are only read, see Schedule
+		template<typename... Components, typename Function>
+		void each(Function&& function, ComponentMask exclude = 0) {
+			each_chunk<Components...>([&](uint32_t count, const Entity* entities, Components*... columns) {
+				for (uint32_t i = 0; i < count; ++i) {
+					if constexpr (std::is_invocable_v<Function&, Entity, Components&...>) {
+						function(entities[i], columns[i]...);
+					} else {
+						function(columns[i]...);
+					}
+				}
+			}, exclude);
+		}
+
+		// function(uint32_t count, const Entity* entities, Components*... columns) once per chunk.
+		// The columns are plain arrays, loops over them vectorize
+		template<typename... Components, typename Function>
+		void each_chunk(Function&& function, ComponentMask exclude = 0) {
+			const ComponentMask required = component_mask<Components...>();
+			QueryScope scope(*this);
+
+			for (Archetype* archetype : _archetypes) {
+				if ((archetype->mask() & required) != required || (archetype->mask() & exclude) != 0) {
+					continue;
+				}
+
+				const uint32_t chunk_count = archetype->chunk_count();
+				for (uint32_t chunk = 0; chunk < chunk_count; ++chunk) {
+					function(
+						archetype->chunk_size(chunk), archetype->entities(chunk),
+						static_cast<Components*>(archetype->column(chunk, component_id<Components>()))...
+					);
+				}
+			}
+		}
+
+		// Entities with all of Components and none of exclude
+		template<typename... Components>
+		uint32_t count(ComponentMask exclude = 0) const { return count(component_mask<Components...>(), exclude); }
+		uint32_t count(ComponentMask required, ComponentMask exclude) const;
+
+		// Runs the commands in record order and empties the buffer
+		void apply(CommandBuffer& commands);
+		// Destroys every entity. Archetypes stay
+		void clear();
+
+		uint32_t entity_count() const { return _entity_count; }
+		uint32_t archetype_count() const { return static_cast<uint32_t>(_archetypes.size()); }
+		const std::vector<Archetype*>& archetypes() const { return _archetypes; }
+
+	private:
+		struct EntityRecord {
+			Archetype* archetype = nullptr; // nullptr while the slot is free
+			uint32_t row = 0;
+			uint32_t generation = 0;
+		};
+
+		// Catches structural changes from inside a query in debug builds
+		struct QueryScope {
+			const World& world;
+			QueryScope(const World& world) : world(world) { world._queries_running.fetch_add(1, std::memory_order_relaxed); }
+			~QueryScope() { world._queries_running.fetch_sub(1, std::memory_order_relaxed); }
+		};
+
+		const EntityRecord* find(Entity entity) const;
+		EntityRecord* find(Entity entity) { return const_cast<EntityRecord*>(static_cast<const World&>(*this).find(entity)); }
+		Archetype& archetype(ComponentMask mask);
+		// Allocates the entity and a row with uninitialized components for it
+		uint32_t create_row(Archetype& target, Entity& entity);
+		// Moves the entity's row to target. Components target doesn't have are destroyed, the ones only target has are left uninitialized
+		void move(EntityRecord& record, Archetype& target);
+		// Uninitialized memory for the new component, nullptr for stale entities or when it's there already
+		void* add_slot(Entity entity, uint32_t component);
+		void remove(Entity entity, uint32_t component);
+		void assert_no_queries() const { assert(_queries_running.load(std::memory_order_relaxed) == 0 && "Structural change during a query, use a CommandBuffer"); }
+
+	private:
+		std::unordered_map<ComponentMask, Unique<Archetype>> _archetype_map;
+		std::vector<Archetype*> _archetypes; // Creation order, queries walk this
+
+		std::vector<EntityRecord> _records;  // By Entity::index
+		std::vector<uint32_t> _free_records;
+		uint32_t _entity_count = 0;
+
+		mutable std::atomic<uint32_t> _queries_running = 0;
+	};
+}
@@ -1,3 +1,4 @@
+#pragma once
 #include <cstdint>
 #include <vector>
 #include <string>
@@ -8,13 +9,38 @@
 #include <unordered_map>
 #include <algorithm>
 #include <optional>
+#include <memory>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <fstream>
+#include <cmath>
+#include <array>
+#include <string_view>
+#include <limits>
+#include <cstdio>
+#include <type_traits>
+#include <deque>
+#include <numeric>
+#include <bitset>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <d3d11.h>
+#include <d3d11_1.h>
+#include <d3d11shader.h>
 #include <d3dcompiler.h>
 
 #include <wrl/client.h>
+using Microsoft::WRL::ComPtr;
+#endif
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
\ No newline at end of file
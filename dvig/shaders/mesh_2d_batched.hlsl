@@ -0,0 +1,21 @@
+// Positions come in already transformed by QuadBatcher
+struct VsIn {
+    float2 pos : POSITION;
+    float4 color : COLOR;
+};
+
+struct VsOut {
+    float4 pos : SV_POSITION;
+    float4 color : COLOR;
+};
+
+VsOut vertex_main(VsIn vs_in) {
+    VsOut vs_out;
+    vs_out.pos = float4(vs_in.pos.x, vs_in.pos.y, 0, 1);
+    vs_out.color = vs_in.color;
+    return vs_out;
+}
+
+float4 pixel_main(VsOut input) : SV_TARGET {
+    return input.color;
+}
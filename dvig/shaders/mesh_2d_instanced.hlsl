@@ -0,0 +1,37 @@
+struct VsIn {
+    float2 pos : POSITION; // Unit quad corner, 0..1
+
+    float2 instance_pos : INSTANCE_POS;
+    float2 instance_size : INSTANCE_SIZE;
+    float2 instance_origin : INSTANCE_ORIGIN;
+    float instance_rotation : INSTANCE_ROTATION;
+    float4 instance_color : INSTANCE_COLOR;
+};
+
+cbuffer ConstBuffer {
+    float4x4 view_projection;
+};
+
+struct VsOut {
+    float4 pos : SV_POSITION;
+    float4 color : COLOR;
+};
+
+VsOut vertex_main(VsIn vs_in) {
+    float2 local = (vs_in.pos - vs_in.instance_origin) * vs_in.instance_size;
+
+    float s, c;
+    sincos(vs_in.instance_rotation, s, c);
+    float2 rotated = float2(local.x * c - local.y * s, local.x * s + local.y * c);
+
+    float2 world = vs_in.instance_pos + vs_in.instance_origin * vs_in.instance_size + rotated;
+
+    VsOut vs_out;
+    vs_out.pos = mul(view_projection, float4(world.x, world.y, 0, 1));
+    vs_out.color = vs_in.instance_color;
+    return vs_out;
+}
+
+float4 pixel_main(VsOut input) : SV_TARGET {
+    return input.color;
+}
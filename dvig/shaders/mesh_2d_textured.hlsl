@@ -0,0 +1,31 @@
+struct VsIn {
+    float2 pos : POSITION;
+    float2 uv : TEXCOORD;
+};
+
+cbuffer ConstBuffer {
+    float4 color;
+    float4x4 transform;
+    float4 uv_rect; // xy at uv (0, 0), zw at (1, 1)
+};
+
+Texture2D color_texture : register(t0);
+SamplerState color_sampler : register(s0);
+
+struct VsOut {
+    float4 pos : SV_POSITION;
+    float4 color : COLOR;
+    float2 uv : TEXCOORD;
+};
+
+VsOut vertex_main(VsIn vs_in) {
+    VsOut vs_out;
+    vs_out.pos = mul(transform, float4(vs_in.pos.x, vs_in.pos.y, 0, 1));
+    vs_out.color = color;
+    vs_out.uv = lerp(uv_rect.xy, uv_rect.zw, vs_in.uv);
+    return vs_out;
+}
+
+float4 pixel_main(VsOut input) : SV_TARGET {
+    return color_texture.Sample(color_sampler, input.uv) * input.color;
+}
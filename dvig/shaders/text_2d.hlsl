@@ -0,0 +1,46 @@
+// Glyph quads from TextBatcher, positions already transformed.
+// The texture holds a signed distance field: 0.5 on the outline, 0 and 1 distance_range / 2 texels outside and inside
+struct VsIn {
+    float2 pos : POSITION;
+    float2 uv : TEXCOORD;
+    float4 color : COLOR; // Straight alpha
+};
+
+cbuffer ConstBuffer {
+    float distance_range; // Texels
+};
+
+Texture2D distance_texture : register(t0);
+SamplerState distance_sampler : register(s0);
+
+struct VsOut {
+    float4 pos : SV_POSITION;
+    float4 color : COLOR;
+    float2 uv : TEXCOORD;
+    // The constant buffer is only bound to the vertex stage
+    nointerpolation float distance_range : DISTANCE_RANGE;
+};
+
+VsOut vertex_main(VsIn vs_in) {
+    VsOut vs_out;
+    vs_out.pos = float4(vs_in.pos.x, vs_in.pos.y, 0, 1);
+    vs_out.color = vs_in.color;
+    vs_out.uv = vs_in.uv;
+    vs_out.distance_range = distance_range;
+    return vs_out;
+}
+
+float4 pixel_main(VsOut input) : SV_TARGET {
+    float2 size;
+    distance_texture.GetDimensions(size.x, size.y);
+
+    // Distance range in screen pixels, so edges stay one pixel wide at every scale
+    float2 texels_per_pixel = fwidth(input.uv) * size;
+    float screen_range = max(0.5 * dot(input.distance_range / texels_per_pixel, float2(1, 1)), 1.0);
+
+    float distance = distance_texture.Sample(distance_sampler, input.uv).a;
+    float coverage = saturate((distance - 0.5) * screen_range + 0.5);
+
+    float alpha = input.color.a * coverage;
+    return float4(input.color.rgb * alpha, alpha);
+}
@@ -8,20 +8,33 @@ std::filesystem::path Sandbox::get_dvig_path() const {
 	return std::filesystem::absolute("../dvig");
 }
 
-struct ConstBuffer {
-	glm::mat4 projection;
-};
-
 struct LayoutDesc {
 	std::string name;
 };
 
 void Sandbox::init() {
-	glm::mat4 view(1.0f);
-	view = glm::translate(view, glm::vec3(0, 0, 5.0f));
-	ConstBuffer buffer;
-	buffer.projection = glm::perspectiveLH(glm::radians(45.0f), window_aspect_ratio(), 0.1f, 100.0f);
-	buffer.projection *= view;
+	_camera.set_viewport_size(glm::vec2(window_size()));
+
+	// A million rects, one in a hundred spinning
+	constexpr int32_t SIDE = 1000;
+	constexpr float SPACING = 24.0f;
+	for (int32_t y = 0; y < SIDE; ++y) {
+		for (int32_t x = 0; x < SIDE; ++x) {
+			Transform2D transform;
+			transform.position = glm::vec2(x - SIDE / 2, y - SIDE / 2) * SPACING;
+			Drawable drawable;
+			drawable.size = { 16.0f, 16.0f };
+			drawable.color = { float(x) / SIDE, float(y) / SIDE, 0.6f, 1.0f };
+
+			if ((x + y * SIDE) % 100 == 0) {
+				world().create(transform, drawable, Velocity2D{ {}, 2.0f });
+			} else {
+				world().create(transform, drawable);
+			}
+		}
+	}
+
+	add_core_systems(systems());
 }
 
 void Sandbox::fixed_update(float fixed_dt) {}
@@ -31,18 +44,35 @@ void Sandbox::update(float dt) {
 	while (Input::poll_events(e)) {
 		if (e.type == EventType::Close) {
 			close();
-		} else if (e.type == EventType::KeyPressed) {
+		} else if (e.type == EventType::Resized && e.size.x > 0 && e.size.y > 0) {
+			_camera.set_viewport_size(glm::vec2(e.size));
 		}
 	}
+
+	// WASD pans at a constant speed on screen, Q/E rotate, the wheel zooms at the cursor
+	glm::vec2 direction = { 0.0f, 0.0f };
+	if (Input::key_down('W')) direction.y -= 1.0f;
+	if (Input::key_down('S')) direction.y += 1.0f;
+	if (Input::key_down('A')) direction.x -= 1.0f;
+	if (Input::key_down('D')) direction.x += 1.0f;
+	const float c = std::cos(_camera.rotation());
+	const float s = std::sin(_camera.rotation());
+	direction = { c * direction.x - s * direction.y, s * direction.x + c * direction.y };
+	_camera.move(direction * (600.0f / _camera.zoom() * dt));
+
+	if (Input::key_down('Q')) _camera.set_rotation(_camera.rotation() - dt);
+	if (Input::key_down('E')) _camera.set_rotation(_camera.rotation() + dt);
+
+	const float wheel = Input::state().wheel;
+	if (wheel != 0.0f) {
+		_camera.zoom_at(glm::vec2(Input::mouse_position()), std::pow(1.1f, wheel));
+	}
 }
 
-void Sandbox::render(float dt) {
+void Sandbox::render(float dt, float alpha) {
 	Renderer& renderer = this->renderer();
 	renderer.clear_color({ 0.1f, 0.1f, 0.15f, 1 });
 
-	glm::vec2 size = window_size();
-
-	glm::mat4 transform = glm::orthoLH(0.0f, size.x, size.y, 0.0f, -1.0f, 1.0f);
-	glm::vec4 color = { 1, 0, 1, 1 };
-	renderer.draw_quad({ 0, 0 }, { 50, 0 }, { 0,  50 }, { 50, 50 }, color, transform);
+	_drawables.sync(world());
+	_drawables.draw(world(), renderer, _camera);
 }
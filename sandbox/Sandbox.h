@@ -1,5 +1,7 @@
 #pragma once
 #include <dvig/App.h>
+#include <dvig/Camera.h>
+#include <dvig/CoreComponents.h>
 
 class Sandbox final : public dvig::App {
 public:
@@ -9,10 +11,9 @@ public:
 	void init() override;
 	void fixed_update(float fixed_dt) override;
 	void update(float dt) override;
-	void render(float dt) override;
+	void render(float dt, float alpha) override;
 
 private:
-	ComPtr<ID3D11Buffer> _vertex_buffer;
-	dvig::Shared<dvig::VertexShader> _vertex_shader;
-	dvig::Shared<dvig::PixelShader> _pixel_shader;
+	dvig::OrthoCamera _camera;
+	dvig::DrawableIndex _drawables;
 };
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdio>
+
+// Failed CHECKs are printed and counted, a test's main returns check_result() so ctest sees them
+inline int& check_failures() {
+	static int failures = 0;
+	return failures;
+}
+
+inline int check_result() {
+	if (check_failures() > 0) {
+		std::printf("%d checks failed\n", check_failures());
+		return 1;
+	}
+	return 0;
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			check_failures()++; \
+		} \
+	} while (false)
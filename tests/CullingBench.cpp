@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "World.h"
+#include "CoreComponents.h"
+#include "Camera.h"
+#include "Renderer.h"
+
+#include "HeadlessApp.h"
+
+#include <random>
+
+using namespace dvig;
+using SteadyClock = std::chrono::steady_clock;
+
+static double elapsed_ns(SteadyClock::time_point start) {
+	return std::chrono::duration<double, std::nano>(SteadyClock::now() - start).count();
+}
+
+// One drawable per 300 square pixels whatever the world size, so a 1280x720 view always sees about 3000.
+// 1000 of them move, the rest are static, keeping the grid current costs the moving ones
+static void bench_culling(uint32_t entity_count) {
+	constexpr float VIEW_WIDTH = 1280.0f;
+	constexpr float VIEW_HEIGHT = 720.0f;
+	const float side = std::sqrt(static_cast<float>(entity_count) * 300.0f);
+
+	AppSpec spec = headless_spec();
+	spec.width = static_cast<uint32_t>(VIEW_WIDTH);
+	spec.height = static_cast<uint32_t>(VIEW_HEIGHT);
+	HeadlessApp app(spec);
+	World& world = app.world();
+
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(0.0f, side);
+	std::uniform_real_distribution<float> speed(-50.0f, 50.0f);
+	for (uint32_t i = 0; i < entity_count; i++) {
+		Transform2D transform;
+		transform.position = { position(rng), position(rng) };
+		Drawable drawable;
+		drawable.size = glm::vec2(8.0f);
+		drawable.color = { 1.0f, static_cast<float>(i % 7) / 7.0f, 0.5f, 1.0f };
+
+		if (i % (entity_count / 1000) == 0) {
+			world.create(transform, drawable, Velocity2D{ { speed(rng), speed(rng) }, 1.0f });
+		} else {
+			world.create(transform, drawable);
+		}
+	}
+
+	DrawableIndex index;
+	SteadyClock::time_point start = SteadyClock::now();
+	index.sync(world);
+	const double build_ns = elapsed_ns(start);
+
+	// The camera pans over the middle of the world, a frame is moving, syncing, culling and submitting
+	OrthoCamera camera({ VIEW_WIDTH, VIEW_HEIGHT });
+	bool culled = true;
+	uint32_t frame = 0;
+	uint64_t submitted = 0;
+	double sync_ns = 0.0;
+	app.on_render = [&](Renderer& renderer) {
+		const float t = static_cast<float>(frame++) * 0.05f;
+		camera.set_position({ side * 0.5f + std::cos(t) * side * 0.25f, side * 0.5f + std::sin(t) * side * 0.25f });
+
+		integrate_velocities(world, 1.0f / 60.0f);
+		SteadyClock::time_point sync_start = SteadyClock::now();
+		index.sync(world);
+		sync_ns += elapsed_ns(sync_start);
+
+		if (culled) {
+			submitted += index.draw(world, renderer, camera);
+		} else {
+			draw_drawables(world, renderer, camera.view_projection());
+			submitted += entity_count;
+		}
+	};
+
+	// One frame to warm up, every one after it is timed
+	auto run = [&](uint32_t frames) {
+		app.run_headless(1);
+		frame = 0;
+		submitted = 0;
+		sync_ns = 0.0;
+
+		SteadyClock::time_point frames_start = SteadyClock::now();
+		app.run_headless(frames);
+		return elapsed_ns(frames_start) / frames;
+	};
+
+	const double culled_ns = run(100);
+	const uint64_t visible = submitted / 100;
+	const double culled_sync_ns = sync_ns / 100;
+
+	culled = false;
+	const uint32_t unculled_frames = std::max(3u, 2000000u / entity_count);
+	const double unculled_ns = run(unculled_frames);
+
+	std::printf("%8u drawables: index built in %.1f ms, culled frame %.3f ms (sync %.3f ms, %llu submitted), every rect %.3f ms\n",
+		entity_count, build_ns / 1e6, culled_ns / 1e6, culled_sync_ns / 1e6,
+		static_cast<unsigned long long>(visible), unculled_ns / 1e6);
+}
+
+int main() {
+	for (uint32_t entity_count : { 10000u, 100000u, 1000000u }) {
+		bench_culling(entity_count);
+	}
+	return 0;
+}
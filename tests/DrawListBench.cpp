@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+
+#include <random>
+
+using namespace dvig;
+using SteadyClock = std::chrono::steady_clock;
+
+static constexpr uint32_t KEY_COUNT = 1000000;
+
+enum class KeyMix {
+	Random,    // Every byte differs, the worst case
+	DrawKeys,  // 4 layers, 16 depths, runs of 32 draws per sequence, 4 pipelines
+	Equal,     // Only the counting pass
+	Sorted,    // Draw keys already in order
+};
+
+static std::vector<SortItem> make_items(KeyMix mix) {
+	std::mt19937_64 rng(3);
+	std::vector<SortItem> items(KEY_COUNT);
+	for (uint32_t i = 0; i < KEY_COUNT; i++) {
+		uint64_t key = 0;
+		switch (mix) {
+		case KeyMix::Random:
+			key = rng();
+			break;
+		case KeyMix::DrawKeys:
+		case KeyMix::Sorted:
+			key = DrawKey::make(uint8_t(rng() % 4), uint16_t(rng() % 16), i / 32, uint8_t((i / 32) % 4), uint8_t(rng() % 64));
+			break;
+		case KeyMix::Equal:
+			key = DrawKey::make(0, 0, 0, 0, 0);
+			break;
+		}
+		items[i] = { key, i };
+	}
+
+	if (mix == KeyMix::Sorted) {
+		std::stable_sort(items.begin(), items.end(), [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+	}
+	return items;
+}
+
+// Best of 7 runs, each on a fresh copy of the items
+template<typename Sort>
+static void bench(const char* name, const std::vector<SortItem>& items, Sort&& sort) {
+	std::vector<SortItem> copy;
+	double best_ns = std::numeric_limits<double>::max();
+	for (uint32_t run = 0; run < 7; run++) {
+		copy = items;
+		SteadyClock::time_point start = SteadyClock::now();
+		sort(copy);
+		best_ns = std::min(best_ns, std::chrono::duration<double, std::nano>(SteadyClock::now() - start).count());
+	}
+	std::printf("  %-22s %7.2f ms %7.1f Mkeys/s\n", name, best_ns / 1e6, KEY_COUNT / best_ns * 1e3);
+}
+
+int main() {
+	const std::pair<KeyMix, const char*> mixes[] = {
+		{ KeyMix::Random, "random 64 bit keys" },
+		{ KeyMix::DrawKeys, "draw keys" },
+		{ KeyMix::Equal, "equal keys" },
+		{ KeyMix::Sorted, "sorted draw keys" },
+	};
+
+	JobSystem jobs(std::max(3u, JobSystem::default_worker_count()));
+	std::vector<SortItem> scratch(KEY_COUNT);
+	auto by_key = [](const SortItem& a, const SortItem& b) { return a.key < b.key; };
+
+	for (const auto& [mix, name] : mixes) {
+		const std::vector<SortItem> items = make_items(mix);
+
+		uint32_t passes = 0;
+		std::vector<SortItem> counted = items;
+		radix_sort(counted.data(), scratch.data(), KEY_COUNT, nullptr, &passes);
+		std::printf("%s, %u radix passes\n", name, passes);
+
+		bench("radix_sort", items, [&](std::vector<SortItem>& copy) {
+			radix_sort(copy.data(), scratch.data(), KEY_COUNT);
+		});
+		bench("radix_sort over jobs", items, [&](std::vector<SortItem>& copy) {
+			radix_sort(copy.data(), scratch.data(), KEY_COUNT, &jobs);
+		});
+		bench("std::stable_sort", items, [&](std::vector<SortItem>& copy) {
+			std::stable_sort(copy.begin(), copy.end(), by_key);
+		});
+		bench("std::sort", items, [&](std::vector<SortItem>& copy) {
+			std::sort(copy.begin(), copy.end(), by_key);
+		});
+	}
+	return 0;
+}
@@ -0,0 +1,320 @@
+#include "pch.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "Memory.h"
+#include "Renderer.h"
+#include "SoftwareBackend.h"
+
+#include "Check.h"
+#include "HeadlessApp.h"
+
+#include <random>
+
+using namespace dvig;
+
+static void test_draw_key() {
+	const uint64_t key = DrawKey::make(200, 3, 70000, 4, 5);
+	CHECK(DrawKey::layer(key) == 200);
+	CHECK(DrawKey::depth(key) == 3);
+	CHECK(DrawKey::sequence(key) == 70000);
+	CHECK(DrawKey::pipeline(key) == 4);
+	CHECK(DrawKey::resource(key) == 5);
+
+	// Layer over depth over sequence over pipeline and resource
+	CHECK(DrawKey::make(0, DrawKey::MAX_DEPTH, DrawKey::MAX_SEQUENCE, 255, 255) < DrawKey::make(1, 0, 0, 0, 0));
+	CHECK(DrawKey::make(0, 0, DrawKey::MAX_SEQUENCE, 255, 255) < DrawKey::make(0, 1, 0, 0, 0));
+	CHECK(DrawKey::make(0, 0, 1, 255, 255) < DrawKey::make(0, 0, 2, 0, 0));
+
+	// Every depth round trips, the field is all of its 16 bits
+	CHECK(DrawKey::depth(DrawKey::make(0, DrawKey::MAX_DEPTH, 0, 0, 0)) == 0xffff);
+	CHECK(DrawKey::make(0, 0x7fff, DrawKey::MAX_SEQUENCE, 255, 255) < DrawKey::make(0, 0x8000, 0, 0, 0));
+}
+
+// Against std::stable_sort, on the calling thread and split over jobs
+static void test_radix_sort(JobSystem* jobs) {
+	std::mt19937_64 rng(11);
+	for (uint32_t count : { 0u, 1u, 2u, 3u, 100u, 1000u, 65535u, 65536u, 70001u, 300000u }) {
+		for (uint32_t distribution = 0; distribution < 5; distribution++) {
+			std::vector<SortItem> items(count);
+			std::vector<SortItem> scratch(count);
+			for (uint32_t i = 0; i < count; i++) {
+				uint64_t key = 0;
+				switch (distribution) {
+				case 0: key = rng(); break;
+				case 1: key = rng() % 4; break;
+				case 2: key = 42; break;
+				case 3: key = DrawKey::make(uint8_t(rng() % 3), uint16_t(rng() % 8), uint32_t(i / 16), uint8_t(rng() % 2), uint8_t(rng() % 5)); break;
+				default: key = uint64_t(i / 3) << 40; break; // Already in order
+				}
+				items[i] = { key, i };
+			}
+
+			std::vector<SortItem> expected = items;
+			std::stable_sort(expected.begin(), expected.end(), [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+
+			uint32_t passes = ~0u;
+			const SortItem* sorted = radix_sort(items.data(), scratch.data(), count, jobs, &passes);
+			bool same = true;
+			for (uint32_t i = 0; i < count; i++) {
+				same = same && sorted[i].key == expected[i].key && sorted[i].value == expected[i].value;
+			}
+			CHECK(same);
+
+			if (count < 2 || distribution == 2 || distribution == 4) {
+				CHECK(passes == 0);
+			} else if (distribution == 1 && count >= 100) {
+				CHECK(passes == 1);
+			}
+		}
+	}
+}
+
+static const glm::vec2 CORNERS[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+
+static void push_quad(DrawList& list) {
+	list.push_quad(CORNERS, glm::vec4(1.0f), glm::mat4(1.0f));
+}
+
+static void push_rect(DrawList& list, const glm::mat4& view_projection = glm::mat4(1.0f)) {
+	list.push_rect(RectInstance{}, view_projection);
+}
+
+static void push_texture(DrawList& list, Shared<Texture2D> texture = nullptr) {
+	TextureDraw draw;
+	draw.texture = std::move(texture);
+	list.push_texture(std::move(draw));
+}
+
+// Types and indices of the sorted items, "Q0 T0 Q1"
+static std::string sorted_order(DrawList& list) {
+	const char* names[] = { "Q", "R", "T", "X" };
+	const SortItem* items = list.sort();
+
+	std::string order;
+	for (uint32_t i = 0; i < list.size(); i++) {
+		if (!order.empty()) {
+			order += " ";
+		}
+		order += names[static_cast<uint32_t>(DrawList::type(items[i].value))] + std::to_string(DrawList::index(items[i].value));
+	}
+	return order;
+}
+
+static void test_issue_order() {
+	DrawList list;
+
+	// Quads, rects and textures in one layer and depth draw in the order they were issued
+	push_quad(list);
+	push_texture(list);
+	push_quad(list);
+	push_rect(list);
+	push_quad(list);
+	push_texture(list);
+	push_rect(list);
+	CHECK(sorted_order(list) == "Q0 T0 Q1 R0 Q2 T1 R1");
+	list.clear();
+
+	// Depth and layer still go first, each keeping the issue order inside
+	list.set_depth(2);
+	push_texture(list);
+	push_quad(list);
+	list.set_depth(1);
+	push_quad(list);
+	push_texture(list);
+	list.set_layer(1);
+	list.set_depth(0);
+	push_rect(list);
+	list.set_layer(0);
+	list.set_depth(2);
+	push_rect(list);
+	CHECK(sorted_order(list) == "Q1 T1 T0 Q0 R1 R0");
+	list.clear();
+	list.set_depth(0);
+
+	// A run of draws that can batch shares a sequence, another pipeline or view projection starts a new one
+	push_quad(list);
+	push_quad(list);
+	push_rect(list);
+	push_rect(list);
+	push_rect(list, glm::mat4(2.0f));
+	const SortItem* items = list.sort();
+	CHECK(DrawKey::sequence(items[0].key) == DrawKey::sequence(items[1].key));
+	CHECK(DrawKey::sequence(items[1].key) < DrawKey::sequence(items[2].key));
+	CHECK(DrawKey::sequence(items[2].key) == DrawKey::sequence(items[3].key));
+	CHECK(DrawKey::sequence(items[3].key) < DrawKey::sequence(items[4].key));
+	list.clear();
+}
+
+static void test_order_independent() {
+	DrawList list;
+
+	push_texture(list);
+	list.set_order_independent(true);
+	push_rect(list);
+	push_quad(list);
+	push_rect(list);
+	push_quad(list);
+	list.set_order_independent(false);
+	push_rect(list);
+	push_quad(list);
+
+	// Grouped by pipeline between the draws around them, which keep their place
+	CHECK(sorted_order(list) == "T0 Q0 Q1 R0 R1 R2 Q2");
+}
+
+static void test_resources() {
+	DrawList list;
+	std::vector<Shared<Texture2D>> textures;
+	for (int i = 0; i < 300; i++) {
+		textures.push_back(std::make_shared<Texture2D>());
+	}
+
+	// Ids in order of first use, the same texture keeps its id
+	push_texture(list, textures[5]);
+	push_texture(list, textures[9]);
+	push_texture(list, textures[5]);
+	push_texture(list);
+	const SortItem* items = list.sort();
+	CHECK(DrawKey::resource(items[0].key) == 1 && DrawKey::resource(items[1].key) == 2);
+	CHECK(DrawKey::resource(items[2].key) == 1 && DrawKey::resource(items[3].key) == 0);
+	CHECK(sorted_order(list) == "T0 T1 T2 T3");
+	list.clear();
+
+	// Order independent draws group by texture, the first use decides which group goes first
+	list.set_order_independent(true);
+	for (int i = 0; i < 6; i++) {
+		push_texture(list, textures[i % 2 == 0 ? 7 : 3]);
+	}
+	CHECK(sorted_order(list) == "T0 T2 T4 T1 T3 T5");
+	list.clear();
+
+	// Ids start over every flush and saturate at 255, past it the draws keep their order
+	for (const Shared<Texture2D>& texture : textures) {
+		push_texture(list, texture);
+	}
+	items = list.sort();
+	bool in_order = true;
+	for (uint32_t i = 0; i < list.size(); i++) {
+		in_order = in_order && DrawList::index(items[i].value) == i;
+	}
+	CHECK(in_order);
+	CHECK(DrawKey::resource(items[0].key) == 1 && DrawKey::resource(items[253].key) == 254);
+	CHECK(DrawKey::resource(items[254].key) == 255 && DrawKey::resource(items[299].key) == 255);
+	list.clear();
+	list.set_order_independent(false);
+
+	// Rects get the index of their view projection, saturating too instead of wrapping onto the first ones
+	for (int i = 0; i < 300; i++) {
+		push_rect(list, glm::mat4(static_cast<float>(i + 1)));
+	}
+	items = list.sort();
+	CHECK(DrawKey::resource(items[0].key) == 1 && DrawKey::resource(items[1].key) == 2);
+	CHECK(DrawKey::resource(items[256].key) == 255 && DrawKey::resource(items[299].key) == 255);
+	list.clear();
+
+	// What the renderer asks before updating a texture
+	CHECK(!list.references(textures[0].get()));
+	push_texture(list, textures[0]);
+	CHECK(list.references(textures[0].get()) && !list.references(textures[1].get()));
+	list.clear();
+	CHECK(!list.references(textures[0].get()));
+
+	// Once the ids ran out every texture may be used
+	for (int i = 0; i < 255; i++) {
+		push_texture(list, textures[i]);
+	}
+	CHECK(list.references(textures[299].get()));
+}
+
+// Quads, a texture and a rect overlapping in one layer and depth on the software backend,
+// each drawn over the ones issued before it
+static void test_submitted_order() {
+	AppSpec spec = headless_spec();
+	spec.render_backend = RenderBackendType::Software;
+	spec.width = 64;
+	spec.height = 64;
+	HeadlessApp app(spec);
+
+	const glm::vec4 red(1.0f, 0.0f, 0.0f, 1.0f);
+	const glm::vec4 green(0.0f, 1.0f, 0.0f, 1.0f);
+	const glm::vec4 blue(0.0f, 0.0f, 1.0f, 1.0f);
+	const glm::vec4 yellow(1.0f, 1.0f, 0.0f, 1.0f);
+
+	// Pixels to clip space, y down
+	glm::mat4 view_projection(1.0f);
+	view_projection[0][0] = 2.0f / 64.0f;
+	view_projection[1][1] = -2.0f / 64.0f;
+	view_projection[3][0] = -1.0f;
+	view_projection[3][1] = 1.0f;
+
+	app.on_render = [&](Renderer& renderer) {
+		// The renderer is only initialized once the app runs
+		Shared<Texture2D> white = renderer.create_texture(1, 1, 1, TextureFormat::RGBA8_UNorm);
+		const uint32_t white_texel = 0xffffffffu;
+		renderer.update(white, 0, { 0, 0, 1, 1 }, &white_texel);
+
+		auto draw_square = [&](float min, float max, const glm::vec4& color) {
+			renderer.draw_quad({ min, min }, { max, min }, { min, max }, { max, max }, color, view_projection);
+		};
+
+		renderer.clear_color(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		draw_square(8.0f, 40.0f, red);
+		renderer.draw_texture(white, { 16.0f, 16.0f }, { 40.0f, 40.0f }, green, view_projection);
+		draw_square(32.0f, 48.0f, blue);
+		renderer.draw_rect({ 44.0f, 8.0f }, { 16.0f, 12.0f }, yellow, view_projection);
+	};
+	app.run_headless(1);
+
+	const SoftwareBackend& backend = static_cast<const SoftwareBackend&>(app.renderer().backend());
+	CHECK(backend.pixel(12, 12) == pack_color_rgba8(red));
+	CHECK(backend.pixel(20, 20) == pack_color_rgba8(green));
+	CHECK(backend.pixel(40, 40) == pack_color_rgba8(blue));
+	CHECK(backend.pixel(52, 52) == pack_color_rgba8(green));
+	CHECK(backend.pixel(50, 18) == pack_color_rgba8(yellow));
+	CHECK(backend.pixel(4, 60) == pack_color_rgba8(glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+// A texture drawn, updated and drawn again in one frame: the first draw shows the texels from before the update
+static void test_texture_update() {
+	AppSpec spec = headless_spec();
+	spec.render_backend = RenderBackendType::Software;
+	spec.width = 32;
+	spec.height = 16;
+	HeadlessApp app(spec);
+
+	glm::mat4 view_projection(1.0f);
+	view_projection[0][0] = 2.0f / 32.0f;
+	view_projection[1][1] = -2.0f / 16.0f;
+	view_projection[3][0] = -1.0f;
+	view_projection[3][1] = 1.0f;
+
+	const uint32_t red = pack_color_rgba8(glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+	const uint32_t blue = pack_color_rgba8(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+	app.on_render = [&](Renderer& renderer) {
+		Shared<Texture2D> texture = renderer.create_texture(1, 1, 1, TextureFormat::RGBA8_UNorm);
+		renderer.update(texture, 0, { 0, 0, 1, 1 }, &red);
+		renderer.draw_texture(texture, { 0.0f, 0.0f }, { 16.0f, 16.0f }, glm::vec4(1.0f), view_projection);
+		renderer.update(texture, 0, { 0, 0, 1, 1 }, &blue);
+		renderer.draw_texture(texture, { 16.0f, 0.0f }, { 16.0f, 16.0f }, glm::vec4(1.0f), view_projection);
+	};
+	app.run_headless(1);
+
+	const SoftwareBackend& backend = static_cast<const SoftwareBackend&>(app.renderer().backend());
+	CHECK(backend.pixel(8, 8) == red);
+	CHECK(backend.pixel(24, 8) == blue);
+}
+
+int main() {
+	test_draw_key();
+	test_radix_sort(nullptr);
+	{
+		JobSystem jobs(3);
+		test_radix_sort(&jobs);
+	}
+	test_issue_order();
+	test_order_independent();
+	test_resources();
+	test_submitted_order();
+	test_texture_update();
+	return check_result();
+}
@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "Font.h"
+#include "Renderer.h"
+
+#include "HeadlessApp.h"
+
+using namespace dvig;
+using SteadyClock = std::chrono::steady_clock;
+
+static double elapsed_ns(SteadyClock::time_point start) {
+	return std::chrono::duration<double, std::nano>(SteadyClock::now() - start).count();
+}
+
+static const char* const PARAGRAPH =
+	"The quick brown fox jumps over the lazy dog. Pack my box with five dozen liquor jugs!\n"
+	"AVATAR WAVE Today Yellow; kerning pairs like AV, To and Yo take the slow path.\n"
+	"0123456789 +-*/=()[]{} \"quotes\" and 'apostrophes', 50% off @ 12:30.\n"
+	"\xce\x91\xce\xbb\xcf\x86\xce\xb1\xce\xb2\xce\xb7\xcf\x84\xce\xbf \xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xd0\xbc\xd0\xb8\xd1\x80\n";
+
+// Uncached layout of the same paragraph, glyph metrics are cached after the first run
+static void bench_layout(Font& font) {
+	TextLayout layout;
+	font.layout(PARAGRAPH, 16.0f, layout);
+	font.reset_stats();
+
+	constexpr uint32_t RUNS = 20000;
+	SteadyClock::time_point start = SteadyClock::now();
+	for (uint32_t i = 0; i < RUNS; ++i) {
+		font.layout(PARAGRAPH, 16.0f + static_cast<float>(i % 4), layout);
+	}
+	const double ns = elapsed_ns(start);
+
+	const FontStats& stats = font.stats();
+	std::printf("layout:        %.0f ns/layout, %.1f ns/glyph, %.1f M glyphs/s (%llu glyphs)\n",
+		ns / RUNS, ns / static_cast<double>(stats.glyphs_laid_out), static_cast<double>(stats.glyphs_laid_out) / ns * 1e3,
+		static_cast<unsigned long long>(stats.glyphs_laid_out));
+}
+
+// Lookups of strings that are all in the cache
+static void bench_cached_layout(Font& font) {
+	std::vector<std::string> labels;
+	for (uint32_t i = 0; i < 200; ++i) {
+		labels.push_back("Label number " + std::to_string(i));
+		font.cached_layout(labels.back(), 16.0f);
+	}
+	font.reset_stats();
+
+	constexpr uint32_t RUNS = 500;
+	SteadyClock::time_point start = SteadyClock::now();
+	for (uint32_t i = 0; i < RUNS; ++i) {
+		for (const std::string& label : labels) {
+			font.cached_layout(label, 16.0f);
+		}
+	}
+	const double ns = elapsed_ns(start);
+	std::printf("cached layout: %.0f ns/lookup, layout hit rate %.3f\n",
+		ns / (RUNS * labels.size()), font.stats().layout_hit_rate());
+}
+
+// UI like frames: static labels, counters that change every frame and optionally lines
+// scrolling through the paragraph, which brings new glyphs in all the time
+static void bench_frames(HeadlessApp& app, Font& font, const char* name, uint32_t scrolling) {
+	glm::mat4 view_projection(1.0f);
+	view_projection[0][0] = 2.0f / 1280.0f;
+	view_projection[1][1] = -2.0f / 720.0f;
+	view_projection[3][0] = -1.0f;
+	view_projection[3][1] = 1.0f;
+
+	uint32_t frame = 0;
+	TextLayout counter;
+	app.on_render = [&](Renderer& renderer) {
+		for (uint32_t i = 0; i < 100; ++i) {
+			const float y = static_cast<float>(i % 40) * 18.0f;
+			renderer.draw_text(font, "Static label " + std::to_string(i), { 10.0f + 300.0f * static_cast<float>(i / 40), y }, 14.0f, glm::vec4(1.0f), view_projection);
+		}
+		for (uint32_t i = 0; i < 20; ++i) {
+			font.layout("Frame " + std::to_string(frame * 20 + i), 14.0f, counter);
+			renderer.draw_text(font, counter, { 950.0f, 18.0f * static_cast<float>(i) }, glm::vec4(1.0f), view_projection);
+		}
+		for (uint32_t i = 0; i < scrolling; ++i) {
+			const char* line = PARAGRAPH + (frame * 7 + i * 31) % 180;
+			renderer.draw_text(font, std::string_view(line, 40), { 10.0f, 500.0f + 20.0f * static_cast<float>(i) }, 18.0f, glm::vec4(1.0f), view_projection);
+		}
+		font.next_frame();
+		frame++;
+	};
+
+	app.run_headless(10);
+	font.reset_stats();
+	const uint32_t evicted = font.atlas().stats().evicted;
+
+	constexpr uint32_t FRAMES = 300;
+	SteadyClock::time_point start = SteadyClock::now();
+	app.run_headless(FRAMES);
+	const double ns = elapsed_ns(start);
+	app.on_render = nullptr;
+
+	const FontStats& stats = font.stats();
+	std::printf("%-14s %.3f ms/frame, %llu glyphs/frame, glyph hit rate %.4f, layout hit rate %.3f, %u rasterized, %u failed, %u evicted\n",
+		name, ns / 1e6 / FRAMES, static_cast<unsigned long long>(stats.glyph_lookups / FRAMES),
+		stats.glyph_hit_rate(), stats.layout_hit_rate(), stats.glyphs_rasterized, stats.glyphs_failed, font.atlas().stats().evicted - evicted);
+}
+
+int main(int argc, char** argv) {
+	const char* path = argc > 1 ? argv[1] : DVIG_TEST_FONT;
+
+	HeadlessApp app(headless_spec());
+	app.run_headless(1);
+
+	Unique<Font> font = std::make_unique<Font>(app.renderer());
+	std::string error;
+	if (!font->load(path, error)) {
+		std::printf("Can't load %s: %s\nUsage: FontBench [font.ttf]\n", path, error.c_str());
+		return 1;
+	}
+
+	bench_layout(*font);
+	bench_cached_layout(*font);
+	bench_frames(app, *font, "ui frames:", 0);
+
+	// One page too small for the glyphs of a frame, they keep evicting each other and some don't fit
+	FontDesc desc;
+	desc.sdf_size = 36.0f;
+	desc.atlas = { 256, 1, 1 };
+	Unique<Font> small = std::make_unique<Font>(app.renderer(), desc);
+	small->load(path, error);
+	bench_frames(app, *small, "small atlas:", 8);
+	return 0;
+}
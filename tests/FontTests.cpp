@@ -0,0 +1,130 @@
+#include "pch.h"
+#include "Font.h"
+#include "Renderer.h"
+
+#include "Check.h"
+#include "HeadlessApp.h"
+
+using namespace dvig;
+
+static glm::mat4 pixel_projection(float width, float height) {
+	glm::mat4 view_projection(1.0f);
+	view_projection[0][0] = 2.0f / width;
+	view_projection[1][1] = -2.0f / height;
+	view_projection[3][0] = -1.0f;
+	view_projection[3][1] = 1.0f;
+	return view_projection;
+}
+
+static Unique<Font> load_font(Renderer& renderer, const FontDesc& desc = {}) {
+	Unique<Font> font = std::make_unique<Font>(renderer, desc);
+	std::string error;
+	if (!font->load(DVIG_TEST_FONT, error)) {
+		std::printf("Can't load %s: %s\n", DVIG_TEST_FONT, error.c_str());
+		std::abort();
+	}
+	return font;
+}
+
+static void test_layout_cache() {
+	HeadlessApp app(headless_spec());
+	app.run_headless(1);
+	Unique<Font> font = load_font(app.renderer());
+
+	CHECK(font->stats().layout_hit_rate() == 1.0);
+
+	const TextLayout& hello = font->cached_layout("Hello", 16.0f);
+	CHECK(hello.quads.size() == 5 && hello.line_count == 1);
+	CHECK(&font->cached_layout("Hello", 16.0f) == &hello);
+	font->cached_layout("Hello", 32.0f);
+	font->cached_layout("Hello", 16.0f);
+
+	FontStats stats = font->stats();
+	CHECK(stats.cache_misses == 2 && stats.cache_hits == 2);
+	CHECK(stats.layouts == 2 && stats.glyphs_laid_out == 10);
+	CHECK(stats.cached_layouts == 2);
+	CHECK(stats.layout_hit_rate() == 0.5);
+	CHECK(stats.glyphs == 4); // H, e, l, o
+
+	// Uncached layouts count as layouts, not as cache lookups
+	TextLayout layout;
+	font->layout("Two words\nand a line", 20.0f, layout);
+	CHECK(layout.line_count == 2 && layout.quads.size() == 16);
+	CHECK(font->stats().layouts == 3 && font->stats().cache_misses == 2);
+
+	// Unused layouts are dropped after layout_cache_frames
+	for (uint32_t frame = 0; frame <= font->desc().layout_cache_frames; ++frame) {
+		font->next_frame();
+	}
+	CHECK(font->stats().cache_evictions == 2 && font->stats().cached_layouts == 0);
+
+	// Glyphs and cached layouts are what's there now, they survive the reset
+	font->cached_layout("Hello", 16.0f);
+	font->reset_stats();
+	stats = font->stats();
+	CHECK(stats.cache_hits == 0 && stats.cache_misses == 0 && stats.layouts == 0 && stats.cache_evictions == 0);
+	CHECK(stats.cached_layouts == 1 && stats.glyphs > 4);
+	CHECK(stats.layout_hit_rate() == 1.0);
+}
+
+static void test_glyph_hit_rate() {
+	HeadlessApp app(headless_spec());
+	app.run_headless(1);
+
+	// One small page, an alphabet fits but both don't
+	FontDesc desc;
+	desc.sdf_size = 48.0f;
+	desc.atlas = { 256, 1, 1 };
+	Unique<Font> font = load_font(app.renderer(), desc);
+	const glm::mat4 view_projection = pixel_projection(1280.0f, 720.0f);
+
+	std::vector<std::string> texts;
+	app.on_render = [&](Renderer& renderer) {
+		for (size_t i = 0; i < texts.size(); ++i) {
+			renderer.draw_text(*font, texts[i], { 10.0f, 10.0f + 30.0f * static_cast<float>(i) }, 24.0f, glm::vec4(1.0f), view_projection);
+		}
+		font->next_frame();
+	};
+
+	CHECK(font->stats().glyph_hit_rate() == 1.0);
+
+	// Rasterized on the first draw, the second "abc" and every later frame hit
+	texts = { "abc abc" };
+	app.run_headless(1);
+	CHECK(font->stats().glyph_lookups == 6);
+	CHECK(font->stats().glyphs_rasterized == 3);
+	CHECK(font->stats().glyph_hit_rate() == 0.5);
+
+	app.run_headless(3);
+	CHECK(font->stats().glyph_lookups == 24);
+	CHECK(font->stats().glyphs_rasterized == 3);
+	CHECK(font->stats().glyph_hit_rate() == 0.875);
+
+	font->reset_stats();
+	CHECK(font->stats().glyph_lookups == 0 && font->stats().glyph_hit_rate() == 1.0);
+	app.run_headless(1);
+	CHECK(font->stats().glyph_lookups == 6 && font->stats().glyph_hit_rate() == 1.0);
+
+	// Alternating alphabets evict each other's glyphs, the evicted ones are misses again
+	const std::string upper = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+	const std::string lower = "abcdefghijklmnopqrstuvwxyz";
+	font->reset_stats();
+	for (int frame = 0; frame < 6; ++frame) {
+		texts = { frame % 2 == 0 ? upper : lower };
+		app.run_headless(1);
+	}
+
+	const FontStats stats = font->stats();
+	const TextureAtlasStats atlas_stats = font->atlas().stats();
+	CHECK(stats.glyph_lookups == 6 * 26);
+	CHECK(atlas_stats.evicted > 0);
+	CHECK(stats.glyphs_rasterized > 26);
+	CHECK(stats.glyphs_failed == 0);
+	CHECK(stats.glyph_hit_rate() < 0.9 && stats.glyph_hit_rate() >= 0.0);
+}
+
+int main() {
+	test_layout_cache();
+	test_glyph_hit_rate();
+	return check_result();
+}
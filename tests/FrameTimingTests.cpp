@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "FrameTiming.h"
+
+#include "Check.h"
+#include "HeadlessApp.h"
+
+#include <random>
+
+using namespace dvig;
+
+static constexpr int64_t MS = 1'000'000;
+static constexpr int64_t SECOND = 1'000'000'000;
+
+// Ten seconds in frames of random length give exactly ten seconds of steps, whatever the rate
+static void test_exact_step_counts() {
+	for (uint32_t ups : { 50u, 60u, 120u }) {
+		std::mt19937 rng(ups);
+		FixedTimestep timestep(static_cast<float>(ups));
+		CHECK(timestep.fixed_dt() == 1.0f / static_cast<float>(ups));
+
+		uint64_t steps = 0;
+		int64_t total = 0;
+		for (uint32_t second = 1; second <= 10; ++second) {
+			while (total < second * SECOND) {
+				const int64_t frame = std::min<int64_t>(std::uniform_int_distribution<int64_t>(MS, 30 * MS)(rng), second * SECOND - total);
+				total += frame;
+				steps += timestep.advance(frame);
+			}
+			CHECK(steps == uint64_t(second) * ups);
+			CHECK(timestep.alpha() == 0.0f);
+		}
+		CHECK(timestep.step_count() == steps);
+		CHECK(timestep.dropped_step_count() == 0);
+	}
+
+	// Half a step left over shows in alpha
+	FixedTimestep timestep(50.0f);
+	CHECK(timestep.advance(30 * MS) == 1);
+	CHECK(std::abs(timestep.alpha() - 0.5f) < 1e-6f);
+}
+
+static void test_clamp_and_drops() {
+	FixedTimestep timestep(60.0f, 8);
+
+	// 30 steps worth, 8 run, the rest are dropped. The time inside the next step is kept
+	CHECK(timestep.advance(510 * MS) == 8);
+	CHECK(timestep.dropped_step_count() == 22);
+	CHECK(std::abs(timestep.alpha() - 0.6f) < 1e-6f);
+
+	// Past MAX_FRAME_NS it counts as one second
+	CHECK(timestep.advance(10 * SECOND) == 8);
+	CHECK(timestep.dropped_step_count() == 22 + 52);
+	CHECK(timestep.step_count() == 16);
+
+	// A clock going backwards adds nothing
+	CHECK(timestep.advance(-SECOND) == 0);
+	CHECK(timestep.step_count() == 16);
+
+	// Back under the limit nothing is dropped
+	CHECK(timestep.advance(30 * MS) == 2);
+	CHECK(timestep.dropped_step_count() == 74);
+}
+
+// Every clock read moves the fake time 1ms, so the pacer's spin advances it deterministically
+static void test_frame_pacer() {
+	int64_t now = 0;
+	Clock clock = [&now] { return now += MS; };
+
+	FramePacer pacer(clock, 100.0f);
+	pacer.wait();
+	const int64_t start = now;
+
+	for (int64_t frame = 1; frame <= 10; ++frame) {
+		now += 3 * MS; // Work of the frame
+		pacer.wait();
+		CHECK(now >= start + frame * 10 * MS);
+		CHECK(now <= start + frame * 10 * MS + 2 * MS);
+	}
+
+	// A frame more than a frame late starts a new schedule instead of rushing the next ones
+	now += 50 * MS;
+	pacer.wait();
+	const int64_t restart = now;
+	now += 3 * MS;
+	pacer.wait();
+	CHECK(now >= restart + 10 * MS && now <= restart + 12 * MS);
+}
+
+// run_headless with AppSpec::clock times frames like run()
+static void test_injected_clock() {
+	int64_t now = 0;
+	AppSpec spec = headless_spec();
+	spec.clock = [&now] { return now; };
+	spec.fixed_ups = 60;
+	spec.max_fixed_steps_per_frame = 4;
+	spec.width = 64;
+	spec.height = 64;
+
+	HeadlessApp app(spec);
+	uint32_t fixed_updates = 0;
+	std::vector<float> dts;
+	app.on_fixed_update = [&](float fixed_dt) {
+		CHECK(fixed_dt == 1.0f / 60.0f);
+		fixed_updates++;
+	};
+	app.on_update = [&](float dt) {
+		dts.push_back(dt);
+		now += dts.size() == 50 ? SECOND : 25 * MS;
+	};
+
+	// The first frame starts the clock, the other 120 take 25ms except for a 1s stall in the middle.
+	// 119 * 1.5 steps run in full, the stall runs 4 of its 60 and drops the rest
+	app.run_headless(121);
+	CHECK(dts.size() == 121);
+	CHECK(dts[0] == 0.0f);
+	CHECK(dts[50] == 1.0f);
+	CHECK(std::abs(dts[120] - 0.025f) < 1e-6f);
+	CHECK(fixed_updates == 178 + 4);
+}
+
+int main() {
+	test_exact_step_counts();
+	test_clamp_and_drops();
+	test_frame_pacer();
+	test_injected_clock();
+	return check_result();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "App.h"
+
+#include <functional>
+
+// App running on the headless backend, for tests and benchmarks that need a Renderer.
+// The frame callbacks are set by whoever drives it, DVIG_DIR comes from the CMake project
+class HeadlessApp : public dvig::App {
+public:
+	using App::App;
+
+	std::function<void(float)> on_fixed_update;
+	std::function<void(float)> on_update;
+	std::function<void(dvig::Renderer&)> on_render;
+
+	std::filesystem::path get_dvig_path() const override { return DVIG_DIR; }
+
+	void fixed_update(float fixed_dt) override {
+		if (on_fixed_update) {
+			on_fixed_update(fixed_dt);
+		}
+	}
+
+	void update(float dt) override {
+		if (on_update) {
+			on_update(dt);
+		}
+	}
+
+	void render(float /*dt*/, float /*alpha*/) override {
+		if (on_render) {
+			on_render(renderer());
+		}
+	}
+};
+
+inline dvig::AppSpec headless_spec(bool render_thread = false) {
+	dvig::AppSpec spec;
+	spec.render_backend = dvig::RenderBackendType::Headless;
+	spec.shader_hot_reload = false;
+	spec.render_thread = render_thread;
+	return spec;
+}
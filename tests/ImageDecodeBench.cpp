@@ -0,0 +1,460 @@
+#include "pch.h"
+#include "Image.h"
+#include "TextureLoader.h"
+
+#include "HeadlessApp.h"
+
+#include <random>
+
+using namespace dvig;
+using SteadyClock = std::chrono::steady_clock;
+
+static constexpr uint32_t SIZE = 1024;
+
+static double elapsed_ms(SteadyClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(SteadyClock::now() - start).count();
+}
+
+// Flat 8x8 blocks on the top half like UI art, a noisy gradient like a photo below, alpha varies
+static std::vector<uint32_t> make_pixels() {
+	std::mt19937 rng(11);
+	std::vector<uint32_t> pixels(SIZE * SIZE);
+	std::vector<uint32_t> block_colors(SIZE / 8 * SIZE / 8);
+	for (uint32_t& color : block_colors) {
+		color = rng() | 0xff000000u;
+	}
+
+	for (uint32_t y = 0; y < SIZE; y++) {
+		for (uint32_t x = 0; x < SIZE; x++) {
+			uint32_t& pixel = pixels[y * SIZE + x];
+			if (y < SIZE / 2) {
+				pixel = block_colors[(y / 8) * (SIZE / 8) + x / 8];
+			} else {
+				const uint32_t noise = rng() % 16;
+				const uint32_t r = (x / 4 + noise) & 0xff;
+				const uint32_t g = (y / 4 + noise) & 0xff;
+				const uint32_t b = ((x + y) / 8) & 0xff;
+				const uint32_t a = x < SIZE / 4 ? 128 + noise : 255;
+				pixel = r | (g << 8) | (b << 16) | (a << 24);
+			}
+		}
+	}
+	return pixels;
+}
+
+static void put_u16_le(std::vector<uint8_t>& out, uint32_t value) {
+	out.push_back(uint8_t(value));
+	out.push_back(uint8_t(value >> 8));
+}
+
+static void put_u32_le(std::vector<uint8_t>& out, uint32_t value) {
+	put_u16_le(out, value & 0xffff);
+	put_u16_le(out, value >> 16);
+}
+
+static void put_u32_be(std::vector<uint8_t>& out, uint32_t value) {
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		out.push_back(uint8_t(value >> shift));
+	}
+}
+
+// PNG writer, just enough to feed the decoder real files
+// --------------------------------------------------
+
+struct BitWriter {
+	std::vector<uint8_t>& out;
+	uint32_t bits = 0;
+	uint32_t count = 0;
+
+	void put(uint32_t value, uint32_t bit_count) {
+		bits |= value << count;
+		count += bit_count;
+		while (count >= 8) {
+			out.push_back(uint8_t(bits));
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	// Huffman codes go in from their top bit
+	void put_code(uint32_t code, uint32_t bit_count) {
+		uint32_t reversed = 0;
+		for (uint32_t i = 0; i < bit_count; i++) {
+			reversed |= ((code >> i) & 1) << (bit_count - 1 - i);
+		}
+		put(reversed, bit_count);
+	}
+
+	void flush() {
+		if (count > 0) {
+			out.push_back(uint8_t(bits));
+		}
+		bits = 0;
+		count = 0;
+	}
+};
+
+static const uint32_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint32_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint32_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint32_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static void put_fixed_symbol(BitWriter& writer, uint32_t symbol) {
+	if (symbol < 144) {
+		writer.put_code(0x30 + symbol, 8);
+	} else if (symbol < 256) {
+		writer.put_code(0x190 + symbol - 144, 9);
+	} else if (symbol < 280) {
+		writer.put_code(symbol - 256, 7);
+	} else {
+		writer.put_code(0xc0 + symbol - 280, 8);
+	}
+}
+
+// One fixed Huffman block with greedy LZ77 matches, so inflate runs both literals and back references
+static std::vector<uint8_t> zlib_compress(const std::vector<uint8_t>& data) {
+	std::vector<uint8_t> out = { 0x78, 0x01 };
+	BitWriter writer{ out };
+	writer.put(1, 1); // Final block
+	writer.put(1, 2); // Fixed Huffman
+
+	std::vector<uint32_t> head(1 << 15, 0); // Last position + 1 of each 3 byte hash
+	auto hash = [&](size_t i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & 0x7fff; };
+
+	size_t i = 0;
+	while (i < data.size()) {
+		uint32_t length = 0;
+		size_t distance = 0;
+		if (i + 3 <= data.size()) {
+			const uint32_t h = hash(i);
+			if (head[h] != 0 && i - (head[h] - 1) <= 32768) {
+				const size_t candidate = head[h] - 1;
+				while (length < 258 && i + length < data.size() && data[candidate + length] == data[i + length]) {
+					length++;
+				}
+				distance = i - candidate;
+			}
+			head[h] = uint32_t(i + 1);
+		}
+
+		if (length < 3) {
+			put_fixed_symbol(writer, data[i]);
+			i++;
+			continue;
+		}
+
+		uint32_t code = 28;
+		while (LENGTH_BASE[code] > length) {
+			code--;
+		}
+		put_fixed_symbol(writer, 257 + code);
+		writer.put(length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+		uint32_t distance_code = 29;
+		while (DISTANCE_BASE[distance_code] > distance) {
+			distance_code--;
+		}
+		writer.put_code(distance_code, 5);
+		writer.put(uint32_t(distance) - DISTANCE_BASE[distance_code], DISTANCE_EXTRA[distance_code]);
+
+		for (size_t end = i + length; ++i < end;) {
+			if (i + 3 <= data.size()) {
+				head[hash(i)] = uint32_t(i + 1);
+			}
+		}
+	}
+
+	put_fixed_symbol(writer, 256);
+	writer.flush();
+
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (uint8_t byte : data) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	put_u32_be(out, (b << 16) | a);
+	return out;
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size) {
+	uint32_t crc = 0xffffffffu;
+	for (size_t i = 0; i < size; i++) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+static void put_png_chunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data) {
+	put_u32_be(out, uint32_t(data.size()));
+	const size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	put_u32_be(out, crc32(out.data() + start, out.size() - start));
+}
+
+static uint8_t paeth(int a, int b, int c) {
+	const int p = a + b - c;
+	const int pa = std::abs(p - a);
+	const int pb = std::abs(p - b);
+	const int pc = std::abs(p - c);
+	return uint8_t(pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+}
+
+// RGBA, or RGB without alpha. Rows cycle through the five filters so every unfilter path runs
+static std::vector<uint8_t> encode_png(const std::vector<uint32_t>& pixels, bool alpha) {
+	const uint32_t channels = alpha ? 4 : 3;
+	const size_t row_size = size_t(SIZE) * channels;
+	std::vector<uint8_t> raw(row_size * SIZE);
+	for (size_t i = 0; i < pixels.size(); i++) {
+		for (uint32_t c = 0; c < channels; c++) {
+			raw[i * channels + c] = uint8_t(pixels[i] >> (c * 8));
+		}
+	}
+
+	std::vector<uint8_t> filtered;
+	filtered.reserve((row_size + 1) * SIZE);
+	for (uint32_t y = 0; y < SIZE; y++) {
+		const uint8_t filter = uint8_t(y % 5);
+		filtered.push_back(filter);
+		const uint8_t* row = &raw[y * row_size];
+		const uint8_t* above = y > 0 ? &raw[(y - 1) * row_size] : nullptr;
+		for (size_t x = 0; x < row_size; x++) {
+			const int left = x >= channels ? row[x - channels] : 0;
+			const int up = above ? above[x] : 0;
+			const int up_left = above && x >= channels ? above[x - channels] : 0;
+			int predicted = 0;
+			switch (filter) {
+				case 1: predicted = left; break;
+				case 2: predicted = up; break;
+				case 3: predicted = (left + up) / 2; break;
+				case 4: predicted = paeth(left, up, up_left); break;
+			}
+			filtered.push_back(uint8_t(row[x] - predicted));
+		}
+	}
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	std::vector<uint8_t> header;
+	put_u32_be(header, SIZE);
+	put_u32_be(header, SIZE);
+	header.insert(header.end(), { 8, uint8_t(alpha ? 6 : 2), 0, 0, 0 });
+	put_png_chunk(png, "IHDR", header);
+	put_png_chunk(png, "IDAT", zlib_compress(filtered));
+	put_png_chunk(png, "IEND", {});
+	return png;
+}
+
+// TGA and DDS writers
+// --------------------------------------------------
+
+static uint32_t to_bgra(uint32_t rgba) {
+	return (rgba & 0xff00ff00u) | ((rgba & 0xff) << 16) | ((rgba >> 16) & 0xff);
+}
+
+// 32 bit true color, top left origin
+static std::vector<uint8_t> encode_tga(const std::vector<uint32_t>& pixels, bool rle) {
+	std::vector<uint8_t> tga = { 0, 0, uint8_t(rle ? 10 : 2), 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+	put_u16_le(tga, SIZE);
+	put_u16_le(tga, SIZE);
+	tga.push_back(32);
+	tga.push_back(0x28);
+
+	if (!rle) {
+		for (uint32_t pixel : pixels) {
+			put_u32_le(tga, to_bgra(pixel));
+		}
+		return tga;
+	}
+
+	// Packets stay inside a row
+	for (uint32_t y = 0; y < SIZE; y++) {
+		const uint32_t* row = &pixels[y * SIZE];
+		uint32_t x = 0;
+		while (x < SIZE) {
+			uint32_t run = 1;
+			while (x + run < SIZE && run < 128 && row[x + run] == row[x]) {
+				run++;
+			}
+			if (run > 1) {
+				tga.push_back(uint8_t(0x80 | (run - 1)));
+				put_u32_le(tga, to_bgra(row[x]));
+				x += run;
+				continue;
+			}
+
+			uint32_t count = 1;
+			while (x + count < SIZE && count < 128 && (x + count + 1 >= SIZE || row[x + count] != row[x + count + 1])) {
+				count++;
+			}
+			tga.push_back(uint8_t(count - 1));
+			for (uint32_t i = 0; i < count; i++) {
+				put_u32_le(tga, to_bgra(row[x + i]));
+			}
+			x += count;
+		}
+	}
+	return tga;
+}
+
+enum class DdsKind {
+	Bgra8, // Legacy header with bit masks
+	Dxt1,
+	Dxt5,
+};
+
+// The block contents don't change how long a block takes to decode, so the BC blocks are random
+static std::vector<uint8_t> encode_dds(const std::vector<uint32_t>& pixels, DdsKind kind) {
+	std::vector<uint8_t> dds(128, 0);
+	auto put_at = [&](size_t offset, uint32_t value) { memcpy(&dds[offset], &value, sizeof(value)); };
+	memcpy(dds.data(), "DDS ", 4);
+	put_at(4, 124);
+	put_at(8, 0x1 | 0x2 | 0x4 | 0x1000);
+	put_at(12, SIZE);
+	put_at(16, SIZE);
+	put_at(76, 32);
+	put_at(108, 0x1000);
+
+	if (kind == DdsKind::Bgra8) {
+		put_at(80, 0x40 | 0x1);
+		put_at(88, 32);
+		put_at(92, 0x00ff0000u);
+		put_at(96, 0x0000ff00u);
+		put_at(100, 0x000000ffu);
+		put_at(104, 0xff000000u);
+		for (uint32_t pixel : pixels) {
+			put_u32_le(dds, to_bgra(pixel));
+		}
+		return dds;
+	}
+
+	put_at(80, 0x4);
+	memcpy(&dds[84], kind == DdsKind::Dxt1 ? "DXT1" : "DXT5", 4);
+	std::mt19937 rng(13);
+	const size_t block_bytes = size_t(SIZE / 4) * (SIZE / 4) * (kind == DdsKind::Dxt1 ? 8 : 16);
+	for (size_t i = 0; i < block_bytes; i += 4) {
+		put_u32_le(dds, rng());
+	}
+	return dds;
+}
+
+// Benchmarks
+// --------------------------------------------------
+
+struct EncodedImage {
+	const char* name;
+	ImageFileFormat format;
+	const char* extension;
+	std::vector<uint8_t> bytes;
+	bool lossless;
+};
+
+static void bench_decode(const EncodedImage& encoded, const std::vector<uint32_t>& pixels) {
+	Image image;
+	std::string error;
+	if (!decode_image(encoded.bytes.data(), encoded.bytes.size(), encoded.format, image, error)) {
+		std::printf("%-10s failed: %s\n", encoded.name, error.c_str());
+		return;
+	}
+	const bool same = image.width == SIZE && image.height == SIZE
+		&& (!encoded.lossless || memcmp(image.pixels.data(), pixels.data(), image.mip_size(0)) == 0);
+
+	double best_ms = std::numeric_limits<double>::max();
+	for (uint32_t run = 0; run < 5; run++) {
+		const SteadyClock::time_point start = SteadyClock::now();
+		decode_image(encoded.bytes.data(), encoded.bytes.size(), encoded.format, image, error);
+		best_ms = std::min(best_ms, elapsed_ms(start));
+	}
+
+	std::printf("%-10s %6.2f ms, %7.1f MB/s in, %7.1f Mpixels/s, %6zu KB%s\n",
+		encoded.name, best_ms, encoded.bytes.size() / best_ms * 1e-3, double(SIZE) * SIZE / best_ms * 1e-3,
+		encoded.bytes.size() / 1024, same ? "" : ", WRONG PIXELS");
+}
+
+static void bench_post_process(const EncodedImage& encoded) {
+	Image image;
+	std::string error;
+	decode_image(encoded.bytes.data(), encoded.bytes.size(), encoded.format, image, error);
+
+	SteadyClock::time_point start = SteadyClock::now();
+	premultiply_alpha(image);
+	const double premultiply_ms = elapsed_ms(start);
+
+	start = SteadyClock::now();
+	generate_mips(image);
+	std::printf("premultiply_alpha %.2f ms, generate_mips %.2f ms (%u mips)\n", premultiply_ms, elapsed_ms(start), image.mip_count);
+}
+
+// Every file through Renderer::load_texture until the textures are ready, with the default upload budget
+static void bench_loader(const std::vector<EncodedImage>& images, uint32_t copies) {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "dvig_image_decode_bench";
+	std::filesystem::create_directories(directory);
+
+	std::vector<std::filesystem::path> paths;
+	for (uint32_t copy = 0; copy < copies; copy++) {
+		for (const EncodedImage& image : images) {
+			paths.push_back(directory / (std::string(image.name) + "_" + std::to_string(copy) + image.extension));
+			std::ofstream file(paths.back(), std::ios::binary);
+			file.write(reinterpret_cast<const char*>(image.bytes.data()), image.bytes.size());
+		}
+	}
+
+	HeadlessApp app(headless_spec());
+	std::vector<Shared<TextureLoad>> loads;
+	SteadyClock::time_point start;
+	uint32_t frames = 0;
+	app.on_render = [&](Renderer& renderer) {
+		if (loads.empty()) {
+			start = SteadyClock::now();
+			for (const std::filesystem::path& path : paths) {
+				loads.push_back(renderer.load_texture(path));
+			}
+		}
+		frames++;
+		// The main thread waits for vsync in a real frame, spinning here would take a core from the decoders
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		if (std::all_of(loads.begin(), loads.end(), [](const Shared<TextureLoad>& load) { return load->ready() || load->failed(); })) {
+			app.close();
+		}
+	};
+	app.run_headless(std::numeric_limits<uint32_t>::max());
+	const double total_ms = elapsed_ms(start);
+
+	const TextureLoaderStats stats = app.renderer().texture_loader().stats();
+	std::printf("%zu files on %u threads: %.1f ms, %u frames, %u failed, %.1f ms decoding per file, %llu MB uploaded in %u frames\n",
+		paths.size(), app.renderer().texture_loader().thread_count(), total_ms, frames, stats.failed,
+		stats.decode_ns / 1e6 / std::max(1u, stats.decoded),
+		static_cast<unsigned long long>(stats.uploaded_bytes >> 20), stats.upload_frames);
+
+	std::filesystem::remove_all(directory);
+}
+
+int main() {
+	const std::vector<uint32_t> pixels = make_pixels();
+
+	std::vector<uint32_t> opaque = pixels;
+	for (uint32_t& pixel : opaque) {
+		pixel |= 0xff000000u;
+	}
+
+	const std::vector<EncodedImage> images = {
+		{ "png rgba", ImageFileFormat::Png, ".png", encode_png(pixels, true), true },
+		{ "png rgb", ImageFileFormat::Png, ".png", encode_png(opaque, false), true },
+		{ "tga", ImageFileFormat::Tga, ".tga", encode_tga(pixels, false), true },
+		{ "tga rle", ImageFileFormat::Tga, ".tga", encode_tga(pixels, true), true },
+		{ "dds bgra8", ImageFileFormat::Dds, ".dds", encode_dds(pixels, DdsKind::Bgra8), true },
+		{ "dds dxt1", ImageFileFormat::Dds, ".dds", encode_dds(pixels, DdsKind::Dxt1), false },
+		{ "dds dxt5", ImageFileFormat::Dds, ".dds", encode_dds(pixels, DdsKind::Dxt5), false },
+	};
+
+	std::printf("%ux%u, best of 5\n", SIZE, SIZE);
+	for (const EncodedImage& image : images) {
+		bench_decode(image, image.name == std::string("png rgb") ? opaque : pixels);
+	}
+	bench_post_process(images[0]);
+	bench_loader(images, 4);
+	return 0;
+}
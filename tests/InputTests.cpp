@@ -0,0 +1,185 @@
+#include "pch.h"
+#include "Input.h"
+
+#include "Check.h"
+#include "HeadlessApp.h"
+
+using namespace dvig;
+
+// Virtual key codes, the platform layer passes them through
+static constexpr uint32_t KEY_A = 'A';
+static constexpr uint32_t KEY_D = 'D';
+static constexpr uint32_t KEY_SPACE = 0x20;
+
+static Event key_event(EventType type, uint32_t key_code) {
+	Event event;
+	event.type = type;
+	event.key_code = key_code;
+	return event;
+}
+
+static Event mouse_event(EventType type, MouseButton button, glm::ivec2 position = glm::ivec2(0)) {
+	Event event;
+	event.type = type;
+	event.button = button;
+	event.position = position;
+	return event;
+}
+
+static std::vector<Event> poll_all() {
+	std::vector<Event> events;
+	Event event;
+	while (Input::poll_events(event)) {
+		events.push_back(event);
+	}
+	return events;
+}
+
+static void test_pressed_released_held() {
+	Input::begin_frame();
+	poll_all();
+
+	Input::push_event(key_event(EventType::KeyPressed, KEY_A));
+	Input::push_event(mouse_event(EventType::MouseMoved, MouseButton::Left, { 10, 20 }));
+	Input::push_event(mouse_event(EventType::MouseButtonPressed, MouseButton::Right));
+
+	// Nothing shows before the next frame starts
+	CHECK(!Input::key_down(KEY_A));
+	CHECK(poll_all().empty());
+
+	Input::begin_frame();
+	CHECK(Input::key_down(KEY_A) && Input::key_pressed(KEY_A) && !Input::key_released(KEY_A));
+	CHECK(Input::mouse_down(MouseButton::Right) && Input::state().mouse_pressed(MouseButton::Right));
+	CHECK(Input::mouse_position() == glm::ivec2(10, 20));
+	CHECK(Input::state().mouse_delta == glm::ivec2(10, 20));
+
+	const std::vector<Event> events = poll_all();
+	CHECK(events.size() == 3);
+	CHECK(events.size() == 3 && events[0].type == EventType::KeyPressed && events[0].key_code == KEY_A && !events[0].repeat);
+	CHECK(events.size() == 3 && events[1].type == EventType::MouseMoved && events[2].type == EventType::MouseButtonPressed);
+	CHECK(events.size() == 3 && events[0].time != 0 && events[0].time <= events[2].time);
+
+	// Held: still down, no longer pressed. A repeat doesn't press it again
+	Input::push_event(key_event(EventType::KeyPressed, KEY_A));
+	Input::push_event(mouse_event(EventType::MouseMoved, MouseButton::Left, { 15, 18 }));
+	Input::begin_frame();
+	CHECK(Input::key_down(KEY_A) && !Input::key_pressed(KEY_A));
+	CHECK(!Input::state().mouse_pressed(MouseButton::Right) && Input::mouse_down(MouseButton::Right));
+	CHECK(Input::state().mouse_delta == glm::ivec2(5, -2));
+	const std::vector<Event> repeats = poll_all();
+	CHECK(repeats.size() == 2 && repeats[0].repeat);
+
+	// Released
+	Input::push_event(key_event(EventType::KeyReleased, KEY_A));
+	Input::push_event(mouse_event(EventType::MouseButtonReleased, MouseButton::Right));
+	Input::begin_frame();
+	CHECK(!Input::key_down(KEY_A) && Input::key_released(KEY_A) && !Input::key_pressed(KEY_A));
+	CHECK(!Input::mouse_down(MouseButton::Right) && Input::state().mouse_released(MouseButton::Right));
+	CHECK(Input::state().mouse_delta == glm::ivec2(0));
+
+	// A tap inside one frame is pressed and released, never down
+	Input::push_event(key_event(EventType::KeyPressed, KEY_SPACE));
+	Input::push_event(key_event(EventType::KeyReleased, KEY_SPACE));
+	Input::begin_frame();
+	CHECK(Input::key_pressed(KEY_SPACE) && Input::key_released(KEY_SPACE) && !Input::key_down(KEY_SPACE));
+	CHECK(!Input::key_released(KEY_A));
+
+	// Out of range codes are queued but don't touch the state
+	Input::push_event(key_event(EventType::KeyPressed, 1000));
+	Input::begin_frame();
+	CHECK(!Input::key_down(1000) && poll_all().size() == 1);
+
+	// Losing focus releases whatever is held
+	Input::push_event(key_event(EventType::KeyPressed, KEY_D));
+	Input::push_event(mouse_event(EventType::MouseButtonPressed, MouseButton::Left));
+	Input::begin_frame();
+	Input::push_event(Event{ EventType::FocusLost });
+	Input::begin_frame();
+	CHECK(!Input::state().focused);
+	CHECK(!Input::key_down(KEY_D) && Input::key_released(KEY_D));
+	CHECK(!Input::mouse_down(MouseButton::Left) && Input::state().mouse_released(MouseButton::Left));
+	Input::push_event(Event{ EventType::FocusGained });
+	Input::begin_frame();
+	CHECK(Input::state().focused);
+	poll_all();
+}
+
+static void test_overflow() {
+	InputQueue queue(5);
+	CHECK(queue.capacity() == 8);
+
+	// 8 fit, the rest are dropped but still move the keys
+	for (uint32_t key = 0; key < 12; ++key) {
+		queue.push(key_event(EventType::KeyPressed, key));
+	}
+	CHECK(queue.dropped() == 4);
+
+	queue.begin_frame();
+	for (uint32_t key = 0; key < 12; ++key) {
+		CHECK(queue.state().key_pressed(key) && queue.state().key_down(key));
+	}
+
+	Event event;
+	uint32_t polled = 0;
+	while (queue.poll(event)) {
+		CHECK(event.key_code == polled);
+		polled++;
+	}
+	CHECK(polled == 8);
+
+	// The frame's events keep their room until the next begin_frame(), then the unpolled ones are dropped
+	for (uint32_t key = 0; key < 8; ++key) {
+		queue.push(key_event(EventType::KeyReleased, key));
+	}
+	queue.begin_frame();
+	queue.push(key_event(EventType::KeyPressed, 20));
+	CHECK(queue.dropped() == 5);
+	CHECK(queue.poll(event) && event.type == EventType::KeyReleased && event.key_code == 0);
+
+	queue.begin_frame();
+	CHECK(!queue.poll(event));
+	CHECK(queue.state().key_pressed(20) && !queue.state().key_down(7));
+	for (uint32_t key = 0; key < 8; ++key) {
+		queue.push(key_event(EventType::KeyReleased, key + 8));
+	}
+	CHECK(queue.dropped() == 5);
+
+	queue.begin_frame();
+	CHECK(queue.poll(event) && event.key_code == 8);
+	CHECK(!queue.state().key_down(11) && queue.state().key_released(11));
+	CHECK(!queue.state().key_released(0));
+}
+
+// The App drains the queue at the start of every frame, events pushed during update show up in the next one
+static void test_app_frames() {
+	HeadlessApp app(headless_spec());
+	uint32_t frame = 0;
+	app.on_update = [&](float /*dt*/) {
+		switch (frame++) {
+			case 0:
+				Input::push_event(key_event(EventType::KeyPressed, KEY_D));
+				break;
+			case 1:
+				CHECK(Input::key_pressed(KEY_D));
+				CHECK(poll_all().size() == 1);
+				break;
+			case 2:
+				CHECK(Input::key_down(KEY_D) && !Input::key_pressed(KEY_D));
+				Input::push_event(key_event(EventType::KeyReleased, KEY_D));
+				break;
+			case 3:
+				CHECK(Input::key_released(KEY_D) && !Input::key_down(KEY_D));
+				break;
+		}
+	};
+
+	app.run_headless(4);
+	CHECK(frame == 4);
+}
+
+int main() {
+	test_pressed_released_held();
+	test_overflow();
+	test_app_frames();
+	return check_result();
+}
@@ -0,0 +1,111 @@
+#include "pch.h"
+#include "JobSystem.h"
+#include "World.h"
+#include "CoreComponents.h"
+
+using namespace dvig;
+using SteadyClock = std::chrono::steady_clock;
+
+static double elapsed_ms(SteadyClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(SteadyClock::now() - start).count();
+}
+
+struct ChunkRef {
+	Archetype* archetype;
+	uint32_t chunk;
+};
+
+// Every chunk holding Transform2D and Velocity2D, one parallel_for index each
+static std::vector<ChunkRef> movable_chunks(World& world) {
+	std::vector<ChunkRef> chunks;
+	for (Archetype* archetype : world.archetypes()) {
+		if (archetype->has(component_id<Transform2D>()) && archetype->has(component_id<Velocity2D>())) {
+			for (uint32_t chunk = 0; chunk < archetype->chunk_count(); chunk++) {
+				chunks.push_back({ archetype, chunk });
+			}
+		}
+	}
+	return chunks;
+}
+
+// Same work at 1, 2, 4... threads: a compute bound loop, 1M entities integrated chunk by chunk,
+// and the cost of an empty job and an empty parallel_for
+int main() {
+	const uint32_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+	std::printf("hardware threads %u\n", hardware_threads);
+
+	World world;
+	for (uint32_t i = 0; i < 1000000; i++) {
+		Transform2D transform;
+		transform.position.x = static_cast<float>(i);
+		world.create(transform, Velocity2D{ glm::vec2(1.0f), 0.1f });
+	}
+	const std::vector<ChunkRef> chunks = movable_chunks(world);
+
+	std::vector<float> data(1 << 22, 1.0f);
+	const uint32_t max_threads = std::max(8u, hardware_threads);
+	for (uint32_t threads = 1; threads <= max_threads; threads *= 2) {
+		JobSystem jobs(threads - 1);
+
+		const uint32_t compute_repeats = 5;
+		std::atomic<uint32_t> sink = 0;
+		SteadyClock::time_point start = SteadyClock::now();
+		for (uint32_t repeat = 0; repeat < compute_repeats; repeat++) {
+			jobs.parallel_for(static_cast<uint32_t>(data.size()), [&](uint32_t begin, uint32_t end) {
+				float sum = 0.0f;
+				for (uint32_t i = begin; i < end; i++) {
+					float x = data[i] * static_cast<float>(i);
+					for (uint32_t k = 0; k < 16; k++) {
+						x = std::sqrt(x + 1.0f);
+					}
+					sum += x;
+				}
+				sink += static_cast<uint32_t>(sum);
+			}, 4096);
+		}
+		double compute_ms = elapsed_ms(start) / compute_repeats;
+
+		const uint32_t integrate_repeats = 10;
+		const float dt = 0.01f;
+		start = SteadyClock::now();
+		for (uint32_t repeat = 0; repeat < integrate_repeats; repeat++) {
+			jobs.parallel_for(static_cast<uint32_t>(chunks.size()), [&](uint32_t begin, uint32_t end) {
+				for (uint32_t i = begin; i < end; i++) {
+					Archetype& archetype = *chunks[i].archetype;
+					Transform2D* transforms = static_cast<Transform2D*>(archetype.column(chunks[i].chunk, component_id<Transform2D>()));
+					const Velocity2D* velocities = static_cast<const Velocity2D*>(archetype.column(chunks[i].chunk, component_id<Velocity2D>()));
+					const uint32_t size = archetype.chunk_size(chunks[i].chunk);
+					for (uint32_t row = 0; row < size; row++) {
+						transforms[row].position += velocities[row].linear * dt;
+						transforms[row].rotation += velocities[row].angular * dt;
+					}
+				}
+			});
+		}
+		double integrate_ms = elapsed_ms(start) / integrate_repeats;
+
+		const uint32_t job_count = 200000;
+		start = SteadyClock::now();
+		{
+			JobCounter counter;
+			for (uint32_t i = 0; i < job_count; i++) {
+				jobs.run([] {}, &counter);
+			}
+			jobs.wait(counter);
+		}
+		double job_ns = elapsed_ms(start) * 1e6 / job_count;
+
+		const uint32_t parallel_for_count = 20000;
+		start = SteadyClock::now();
+		for (uint32_t i = 0; i < parallel_for_count; i++) {
+			jobs.parallel_for(64, [](uint32_t, uint32_t) {});
+		}
+		double parallel_for_us = elapsed_ms(start) * 1e3 / parallel_for_count;
+
+		JobSystemStats stats = jobs.stats();
+		std::printf("%2u threads: compute %.1f ms, integrate 1M %.2f ms, empty job %.0f ns, empty parallel_for %.2f us, %llu of %llu jobs stolen\n",
+			threads, compute_ms, integrate_ms, job_ns, parallel_for_us,
+			static_cast<unsigned long long>(stats.stolen), static_cast<unsigned long long>(stats.jobs));
+	}
+	return 0;
+}
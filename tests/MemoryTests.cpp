@@ -0,0 +1,249 @@
+#include "pch.h"
+#include "Memory.h"
+#include "Renderer.h"
+
+#include "Check.h"
+#include "HeadlessApp.h"
+
+using namespace dvig;
+
+static_assert(MemoryTracker::TRACKS_HEAP, "Link against dvig_portable_tracked, the steady state check needs every operator new counted");
+
+static void test_frame_arena() {
+	FrameArena arena;
+	CHECK(arena.capacity() == 0 && arena.used() == 0);
+
+	char* bytes = static_cast<char*>(arena.allocate(10, 1));
+	CHECK(arena.capacity() == FrameArena::MIN_BLOCK_SIZE);
+
+	uint64_t* array = arena.allocate_array<uint64_t>(4);
+	CHECK(reinterpret_cast<uintptr_t>(array) % alignof(uint64_t) == 0);
+	CHECK(array[0] == 0 && array[3] == 0);
+	CHECK(bytes + 10 <= reinterpret_cast<char*>(array));
+	CHECK(reinterpret_cast<uintptr_t>(arena.allocate(100, 256)) % 256 == 0);
+
+	// Past the block a bigger one is chained, rewinding gives it back
+	FrameArena::Marker marker = arena.mark();
+	void* big = arena.allocate(200 * 1024, 64);
+	CHECK(reinterpret_cast<uintptr_t>(big) % 64 == 0);
+	memset(big, 1, 200 * 1024);
+	CHECK(arena.capacity() > FrameArena::MIN_BLOCK_SIZE);
+	arena.rewind(marker);
+	CHECK(arena.capacity() == FrameArena::MIN_BLOCK_SIZE);
+	CHECK(arena.high_water() > 200 * 1024);
+
+	// reset() grows the block to what the frame needed, after that frames don't allocate
+	arena.reset();
+	CHECK(arena.used() == 0 && arena.capacity() >= arena.high_water());
+	const size_t capacity = arena.capacity();
+	const uint64_t allocations = MemoryTracker::get().stats(MemoryTag::User).allocations;
+	for (int frame = 0; frame < 10; ++frame) {
+		for (int i = 0; i < 100; ++i) {
+			memset(arena.allocate(2000), 0, 2000);
+		}
+		arena.reset();
+	}
+	CHECK(MemoryTracker::get().stats(MemoryTag::User).allocations == allocations);
+	CHECK(arena.capacity() == capacity);
+
+	{ // Scopes rewind
+		ArenaScope scope(arena);
+		arena.allocate(1000);
+		CHECK(arena.used() >= 1000);
+	}
+	CHECK(arena.used() == 0);
+
+	struct Pair {
+		int x;
+		float y;
+	};
+	Pair* pair = arena.create<Pair>(Pair{ 3, 4.0f });
+	CHECK(pair->x == 3 && pair->y == 4.0f);
+}
+
+static void test_pool_allocator() {
+	const MemoryTagStats before = MemoryTracker::get().stats(MemoryTag::Render);
+	{
+		PoolAllocator pool(24, 32, 4, MemoryTag::Render);
+		CHECK(pool.block_size() == 32);
+
+		std::vector<void*> blocks;
+		for (int i = 0; i < 10; ++i) {
+			blocks.push_back(pool.allocate());
+			CHECK(reinterpret_cast<uintptr_t>(blocks.back()) % 32 == 0);
+			memset(blocks.back(), 7, 24);
+		}
+		CHECK(pool.live_count() == 10 && pool.capacity() == 12);
+
+		std::sort(blocks.begin(), blocks.end());
+		CHECK(std::unique(blocks.begin(), blocks.end()) == blocks.end());
+
+		// Three pages of four
+		const MemoryTagStats filled = MemoryTracker::get().stats(MemoryTag::Render);
+		CHECK(filled.allocations - before.allocations == 3);
+
+		// Freed blocks are handed out again without touching the heap
+		for (void* block : blocks) {
+			pool.free(block);
+		}
+		CHECK(pool.live_count() == 0);
+		for (int i = 0; i < 12; ++i) {
+			pool.allocate();
+		}
+		CHECK(MemoryTracker::get().stats(MemoryTag::Render).allocations == filled.allocations);
+	}
+	CHECK(MemoryTracker::get().stats(MemoryTag::Render).live_bytes == before.live_bytes);
+
+	PoolAllocator shared_pool(16, 8, 64);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < 20000; ++i) {
+				void* a = shared_pool.allocate();
+				void* b = shared_pool.allocate();
+				memset(a, 1, 16);
+				shared_pool.free(a);
+				shared_pool.free(b);
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	CHECK(shared_pool.live_count() == 0);
+}
+
+// Stores through it keep the optimizer from eliding a new/delete pair
+static void* volatile escaped = nullptr;
+
+static void test_memory_tracker() {
+	MemoryTracker& tracker = MemoryTracker::get();
+
+	const MemoryTagStats before = tracker.stats(MemoryTag::Input);
+	{
+		TrackedVector<int, MemoryTag::Input> values;
+		for (int i = 0; i < 100; ++i) {
+			values.push_back(i);
+		}
+
+		const MemoryTagStats grown = tracker.stats(MemoryTag::Input);
+		CHECK(grown.live_bytes - before.live_bytes == values.capacity() * sizeof(int));
+		CHECK(grown.peak_bytes >= grown.live_bytes);
+		CHECK(grown.allocations > before.allocations);
+	}
+	CHECK(tracker.stats(MemoryTag::Input).live_bytes == before.live_bytes);
+
+	tracker.end_frame();
+	tracker.end_frame();
+	CHECK(tracker.stats(MemoryTag::Input).frame_allocations == 0);
+	{
+		TrackedVector<int, MemoryTag::Input> values(5);
+		tracker.end_frame();
+	}
+	CHECK(tracker.stats(MemoryTag::Input).frame_allocations == 1);
+	tracker.reset_peaks();
+	CHECK(tracker.stats(MemoryTag::Input).max_frame_allocations == 0);
+
+	{ // Scopes nest
+		MemoryTagScope render_scope(MemoryTag::Render);
+		CHECK(current_memory_tag() == MemoryTag::Render);
+		{
+			MemoryTagScope assets_scope(MemoryTag::Assets);
+			CHECK(current_memory_tag() == MemoryTag::Assets);
+		}
+		CHECK(current_memory_tag() == MemoryTag::Render);
+	}
+	CHECK(current_memory_tag() == MemoryTag::User);
+
+	// operator new is counted under the scope it was called in, delete under the one it was allocated in
+	const MemoryTagStats assets = tracker.stats(MemoryTag::Assets);
+	{
+		struct alignas(128) Aligned {
+			char bytes[300];
+		};
+
+		MemoryTagScope assets_scope(MemoryTag::Assets);
+		auto* plain = new std::array<char, 1000>;
+		auto* aligned = new Aligned;
+		escaped = plain;
+		escaped = aligned;
+		CHECK(reinterpret_cast<uintptr_t>(aligned) % 128 == 0);
+
+		const MemoryTagStats allocated = tracker.stats(MemoryTag::Assets);
+		CHECK(allocated.allocations - assets.allocations == 2);
+		CHECK(allocated.live_bytes - assets.live_bytes >= sizeof(*plain) + sizeof(*aligned));
+
+		MemoryTagScope input_scope(MemoryTag::Input);
+		delete plain;
+		delete aligned;
+	}
+	CHECK(tracker.stats(MemoryTag::Assets).live_bytes == assets.live_bytes);
+}
+
+// 70k quads and rects over a few depths every frame. Once the first frames warmed the arenas,
+// pools and batch buffers up, no frame touches the heap, with or without the render thread
+static void test_steady_state_frames(bool render_thread) {
+	constexpr uint32_t WARM_UP_FRAMES = 20;
+	constexpr uint32_t FRAMES = 60;
+	constexpr int DRAWS = 70000;
+
+	AppSpec spec = headless_spec(render_thread);
+	spec.width = 320;
+	spec.height = 240;
+	spec.job_threads = 3;
+
+	HeadlessApp app(spec);
+	uint32_t frame = 0;
+	app.on_update = [&](float /*dt*/) {
+		if (++frame == WARM_UP_FRAMES) {
+			MemoryTracker::get().reset_peaks();
+		}
+
+		// Frame arena use from the game
+		float* scratch = app.frame_arena().allocate_array<float>(1000);
+		scratch[999] = 1.0f;
+	};
+
+	app.on_render = [](Renderer& renderer) {
+		glm::mat4 view_projection(1.0f);
+		view_projection[0][0] = 2.0f / 320.0f;
+		view_projection[1][1] = -2.0f / 240.0f;
+		view_projection[3][0] = -1.0f;
+		view_projection[3][1] = 1.0f;
+
+		renderer.clear_color({ 0.1f, 0.2f, 0.3f, 1.0f });
+		for (int i = 0; i < DRAWS; ++i) {
+			const float x = static_cast<float>((i * 37) % 300);
+			const float y = static_cast<float>((i * 53) % 220);
+			const glm::vec4 color = { static_cast<float>(i % 5) / 5.0f, 1.0f, static_cast<float>(i % 3) / 3.0f, 1.0f };
+			renderer.set_depth(static_cast<uint16_t>(i % 7));
+			if (i % 3 == 0) {
+				renderer.draw_rect({ x, y }, { 15.0f, 9.0f }, static_cast<float>(i) * 0.3f, { 0.5f, 0.5f }, color, view_projection);
+			} else {
+				renderer.draw_quad({ x, y }, { x + 20.0f, y + 3.0f }, { x - 2.0f, y + 17.0f }, { x + 22.0f, y + 19.0f }, color, view_projection);
+			}
+		}
+		renderer.set_depth(0);
+	};
+
+	app.run_headless(FRAMES);
+	CHECK(frame == FRAMES);
+
+	for (uint32_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+		const MemoryTagStats stats = MemoryTracker::get().stats(MemoryTag(tag));
+		if (stats.max_frame_allocations != 0) {
+			std::printf("render_thread=%d: %s allocated %llu times in one frame after warm up\n",
+				render_thread, memory_tag_name(MemoryTag(tag)), static_cast<unsigned long long>(stats.max_frame_allocations));
+		}
+		CHECK(stats.max_frame_allocations == 0);
+	}
+}
+
+int main() {
+	test_frame_arena();
+	test_pool_allocator();
+	test_memory_tracker();
+	test_steady_state_frames(false);
+	test_steady_state_frames(true);
+	return check_result();
+}
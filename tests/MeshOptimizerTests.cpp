@@ -0,0 +1,207 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include "Renderer.h"
+#include "HeadlessBackend.h"
+
+#include "Check.h"
+#include "HeadlessApp.h"
+
+#include <random>
+
+using namespace dvig;
+
+static constexpr float PI = 3.14159265358979f;
+
+struct MeshVertex {
+	glm::vec3 pos;
+	glm::vec3 normal;
+};
+
+template<> struct dvig::VertexLayout<MeshVertex> {
+	static constexpr std::array attributes = {
+		DVIG_VERTEX_ATTRIBUTE(MeshVertex, pos, "POSITION"),
+		DVIG_VERTEX_ATTRIBUTE(MeshVertex, normal, "NORMAL"),
+	};
+};
+
+// A torus the way a loader without welding hands it over: three vertices per triangle,
+// triangles in no particular order. Wraps around by index, so shared vertices are bitwise equal
+static MeshData make_torus_soup(uint32_t segments, uint32_t rings, uint32_t seed) {
+	auto vertex = [&](uint32_t segment, uint32_t ring) {
+		const float u = 2.0f * PI * static_cast<float>(segment % segments) / static_cast<float>(segments);
+		const float v = 2.0f * PI * static_cast<float>(ring % rings) / static_cast<float>(rings);
+		const glm::vec3 normal(std::cos(u) * std::cos(v), std::sin(u) * std::cos(v), std::sin(v));
+		const glm::vec3 center(std::cos(u), std::sin(u), 0.0f);
+		return MeshVertex{ glm::vec3(center.x + 0.3f * normal.x, center.y + 0.3f * normal.y, 0.3f * normal.z), normal };
+	};
+
+	std::vector<std::array<MeshVertex, 3>> triangles;
+	for (uint32_t segment = 0; segment < segments; ++segment) {
+		for (uint32_t ring = 0; ring < rings; ++ring) {
+			const MeshVertex a = vertex(segment, ring);
+			const MeshVertex b = vertex(segment + 1, ring);
+			const MeshVertex c = vertex(segment, ring + 1);
+			const MeshVertex d = vertex(segment + 1, ring + 1);
+			triangles.push_back({ a, b, d });
+			triangles.push_back({ a, d, c });
+		}
+	}
+	std::shuffle(triangles.begin(), triangles.end(), std::mt19937(seed));
+
+	std::vector<uint32_t> indices(triangles.size() * 3);
+	for (uint32_t i = 0; i < indices.size(); ++i) {
+		indices[i] = i;
+	}
+	return MeshData::create(triangles[0].data(), static_cast<uint32_t>(indices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+}
+
+// Indexed row by row, like a generated terrain or sprite grid
+static MeshData make_grid_2d(uint32_t size) {
+	std::vector<Vertex2D> vertices;
+	for (uint32_t y = 0; y <= size; ++y) {
+		for (uint32_t x = 0; x <= size; ++x) {
+			vertices.push_back({ { static_cast<float>(x), static_cast<float>(y) } });
+		}
+	}
+
+	std::vector<uint32_t> indices;
+	for (uint32_t y = 0; y < size; ++y) {
+		for (uint32_t x = 0; x < size; ++x) {
+			const uint32_t a = y * (size + 1) + x;
+			const uint32_t c = a + size + 1;
+			indices.insert(indices.end(), { a, a + 1, c + 1, a, c + 1, c });
+		}
+	}
+	return MeshData::create(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+}
+
+// The triangles of a range as vertex bytes, each rotated to start at its smallest vertex, so the
+// winding is part of it but where the optimizer starts a triangle isn't
+static std::vector<std::string> triangle_set(const MeshData& mesh, uint32_t index_start, uint32_t index_count) {
+	auto vertex = [&](uint32_t index) {
+		return std::string(mesh.vertices.data() + static_cast<size_t>(mesh.indices[index]) * mesh.vertex_size, mesh.vertex_size);
+	};
+
+	std::vector<std::string> triangles;
+	for (uint32_t i = index_start; i < index_start + index_count; i += 3) {
+		std::string corners[3] = { vertex(i), vertex(i + 1), vertex(i + 2) };
+		const uint32_t first = static_cast<uint32_t>(std::min_element(corners, corners + 3) - corners);
+		triangles.push_back(corners[first] + corners[(first + 1) % 3] + corners[(first + 2) % 3]);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// Vertices are numbered in the order the indices first use them
+static bool in_first_use_order(const MeshData& mesh) {
+	uint32_t next = 0;
+	for (uint32_t index : mesh.indices) {
+		if (index > next) {
+			return false;
+		}
+		next = std::max(next, index + 1);
+	}
+	return next == mesh.vertex_count();
+}
+
+static void print_stats(const char* name, const MeshOptimizeStats& stats) {
+	std::printf("%-14s %6u -> %6u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %s\n",
+		name, stats.vertices_before, stats.vertices_after, stats.cache_before.acmr, stats.cache_after.acmr,
+		stats.cache_before.atvr, stats.cache_after.atvr, stats.overdraw_sorted ? "sorted" : "kept");
+}
+
+static void test_torus() {
+	constexpr uint32_t SEGMENTS = 96;
+	constexpr uint32_t RINGS = 48;
+	MeshData mesh = make_torus_soup(SEGMENTS, RINGS, 1);
+	const std::vector<std::string> triangles = triangle_set(mesh, 0, static_cast<uint32_t>(mesh.indices.size()));
+
+	const MeshOptimizeStats stats = optimize_mesh(mesh);
+	print_stats("torus soup", stats);
+
+	CHECK(stats.vertices_before == SEGMENTS * RINGS * 6);
+	CHECK(stats.vertices_after == SEGMENTS * RINGS);
+	CHECK(stats.cache_before.acmr == 3.0f);
+	CHECK(stats.cache_after.acmr < 0.8f);
+	CHECK(stats.cache_after.atvr < 1.4f);
+	CHECK(stats.overdraw_sorted);
+	CHECK(in_first_use_order(mesh));
+	CHECK(triangle_set(mesh, 0, static_cast<uint32_t>(mesh.indices.size())) == triangles);
+
+	// Tipsify alone, on already welded indices in random order
+	MeshData welded = make_torus_soup(SEGMENTS, RINGS, 2);
+	deduplicate_vertices(welded);
+	const uint32_t index_count = static_cast<uint32_t>(welded.indices.size());
+	const VertexCacheStats before = analyze_vertex_cache(welded.indices.data(), index_count, welded.vertex_count(), 16);
+	optimize_vertex_cache(welded.indices.data(), index_count, welded.vertex_count(), 16);
+	const VertexCacheStats after = analyze_vertex_cache(welded.indices.data(), index_count, welded.vertex_count(), 16);
+	std::printf("%-14s ACMR %.3f -> %.3f with the vertex cache pass only\n", "torus welded", before.acmr, after.acmr);
+	CHECK(before.acmr > 2.0f && after.acmr < 0.8f);
+}
+
+// Two submeshes, say two materials: triangles are reordered inside each, never across
+static void test_submeshes() {
+	MeshData mesh = make_torus_soup(32, 16, 3);
+	const uint32_t split = static_cast<uint32_t>(mesh.indices.size() / 3 / 3 * 3);
+	const uint32_t index_count = static_cast<uint32_t>(mesh.indices.size());
+	mesh.submeshes = { { 0, split }, { split, index_count - split } };
+
+	const std::vector<std::string> first = triangle_set(mesh, 0, split);
+	const std::vector<std::string> second = triangle_set(mesh, split, index_count - split);
+	optimize_mesh(mesh);
+
+	CHECK(mesh.submeshes.size() == 2 && mesh.indices.size() == index_count);
+	CHECK(triangle_set(mesh, 0, split) == first);
+	CHECK(triangle_set(mesh, split, index_count - split) == second);
+	CHECK(in_first_use_order(mesh));
+}
+
+// Float2 positions: no overdraw pass, the rest still runs
+static void test_2d() {
+	MeshData mesh = make_grid_2d(64);
+	const std::vector<std::string> triangles = triangle_set(mesh, 0, static_cast<uint32_t>(mesh.indices.size()));
+
+	const MeshOptimizeStats stats = optimize_mesh(mesh);
+	print_stats("2d grid", stats);
+
+	CHECK(!stats.overdraw_sorted);
+	CHECK(stats.vertices_after == stats.vertices_before);
+	CHECK(stats.cache_after.acmr < stats.cache_before.acmr);
+	CHECK(triangle_set(mesh, 0, static_cast<uint32_t>(mesh.indices.size())) == triangles);
+}
+
+// create_mesh optimizes static meshes unless told not to, dynamic ones are uploaded as they are
+static void test_create_mesh() {
+	HeadlessApp app(headless_spec());
+	app.run_headless(1);
+	Renderer& renderer = app.renderer();
+
+	const MeshData soup = make_torus_soup(16, 8, 4);
+	const Shared<Mesh> optimized = renderer.create_mesh(soup);
+	const Shared<Mesh> as_is = renderer.create_mesh(soup, BufferDataType::Static, false);
+	const Shared<Mesh> dynamic = renderer.create_mesh(soup, BufferDataType::Dynamic);
+
+	CHECK(renderer.get(optimized->vertex_buffer).count == 16 * 8);
+	CHECK(renderer.get(as_is->vertex_buffer).count == soup.vertex_count());
+	CHECK(renderer.get(dynamic->vertex_buffer).count == soup.vertex_count());
+	CHECK(optimized->submeshes.size() == 1 && optimized->submeshes[0].index_count == soup.indices.size());
+
+	// 16 bit indices, in first use order
+	const HeadlessIndexBuffer& indices = static_cast<const HeadlessIndexBuffer&>(renderer.get(optimized->index_buffer));
+	CHECK(indices.data.size() == soup.indices.size() * sizeof(uint16_t));
+	uint16_t first[3] = {};
+	memcpy(first, indices.data.data(), sizeof(first));
+	CHECK(first[0] == 0 && first[1] == 1 && first[2] == 2);
+
+	renderer.destroy(*optimized);
+	renderer.destroy(*as_is);
+	renderer.destroy(*dynamic);
+}
+
+int main() {
+	test_torus();
+	test_submeshes();
+	test_2d();
+	test_create_mesh();
+	return check_result();
+}
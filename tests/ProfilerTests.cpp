@@ -0,0 +1,208 @@
+#include "pch.h"
+#include "Profiler.h"
+
+#include "Check.h"
+
+#include <map>
+#include <sstream>
+
+using namespace dvig;
+
+static constexpr int64_t MS = 1'000'000;
+
+static const ProfileScopeStats* find_stats(const std::vector<ProfileScopeStats>& stats, const char* name, bool gpu = false) {
+	for (const ProfileScopeStats& scope : stats) {
+		if (scope.name == name && scope.gpu == gpu) {
+			return &scope;
+		}
+	}
+	return nullptr;
+}
+
+static void test_stats() {
+	Profiler& profiler = Profiler::get();
+	profiler.reset();
+
+	// 1..100ms in shuffled order
+	for (int64_t i = 0; i < 100; ++i) {
+		const int64_t duration = (i * 37) % 100 + 1;
+		profiler.record("hundred", 0, duration * MS);
+	}
+
+	// 1..300ms, only the last 256 stay in the window
+	for (int64_t i = 1; i <= 300; ++i) {
+		profiler.record("rolling", 0, i * MS);
+	}
+
+	profiler.record_gpu("hundred", 0, 2 * MS);
+	profiler.end_frame();
+
+	const std::vector<ProfileScopeStats> stats = profiler.stats();
+	CHECK(stats.size() == 3);
+	CHECK(stats[0].name == "hundred" && stats[1].name == "rolling" && stats[2].gpu);
+
+	const ProfileScopeStats* hundred = find_stats(stats, "hundred");
+	CHECK(hundred && hundred->samples == 100);
+	CHECK(hundred && std::abs(hundred->min_ms - 1.0) < 1e-6);
+	CHECK(hundred && std::abs(hundred->avg_ms - 50.5) < 1e-6);
+	CHECK(hundred && std::abs(hundred->p99_ms - 99.0) < 1e-6); // Nearest rank, the 99th of 100
+	CHECK(hundred && std::abs(hundred->last_ms - 64.0) < 1e-6); // (99 * 37) % 100 + 1
+
+	const ProfileScopeStats* rolling = find_stats(stats, "rolling");
+	CHECK(rolling && rolling->samples == Profiler::HISTORY_SIZE);
+	CHECK(rolling && std::abs(rolling->min_ms - 45.0) < 1e-6);
+	CHECK(rolling && std::abs(rolling->avg_ms - 172.5) < 1e-6);
+	CHECK(rolling && std::abs(rolling->p99_ms - 298.0) < 1e-6); // The 254th of 45..300
+	CHECK(rolling && std::abs(rolling->last_ms - 300.0) < 1e-6);
+
+	const ProfileScopeStats* gpu = find_stats(stats, "hundred", true);
+	CHECK(gpu && gpu->samples == 1 && std::abs(gpu->p99_ms - 2.0) < 1e-6);
+}
+
+static void test_full_ring() {
+	Profiler& profiler = Profiler::get();
+	profiler.reset();
+
+	// Nothing drains the ring in between, the events past its capacity are dropped
+	for (uint32_t i = 0; i < ProfileRing::CAPACITY + 100; ++i) {
+		profiler.record("spam", 0, MS);
+	}
+	CHECK(profiler.dropped_event_count() == 100);
+
+	profiler.end_frame();
+	profiler.record("spam", 0, MS);
+	CHECK(profiler.dropped_event_count() == 100);
+	profiler.reset();
+	CHECK(profiler.dropped_event_count() == 0);
+}
+
+struct TraceEvent {
+	std::string name;
+	std::string category;
+	uint32_t thread_id = 0;
+	double ts = 0;
+	double dur = 0;
+};
+
+// The writer puts one event per line, that's all this has to read back
+static std::vector<TraceEvent> parse_trace(const std::string& json, std::map<uint32_t, std::string>& thread_names) {
+	std::vector<TraceEvent> events;
+	std::istringstream lines(json);
+	std::string line;
+	while (std::getline(lines, line)) {
+		char name[64] = {};
+		char category[8] = {};
+		uint32_t thread_id = 0;
+		double ts = 0;
+		double dur = 0;
+		if (std::sscanf(line.c_str(), "{\"name\":\"%63[^\"]\",\"cat\":\"%7[^\"]\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%lf,\"dur\":%lf}",
+			name, category, &thread_id, &ts, &dur) == 5) {
+			events.push_back({ name, category, thread_id, ts, dur });
+		} else if (std::sscanf(line.c_str(), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%63[^\"]\"}}",
+			&thread_id, name) == 2) {
+			thread_names[thread_id] = name;
+		}
+	}
+	return events;
+}
+
+// Nested scopes from several threads while the main thread keeps draining, like frames do
+static void test_threads_and_trace() {
+	constexpr uint32_t THREADS = 4;
+	constexpr uint32_t ITERATIONS = 500;
+
+	Profiler& profiler = Profiler::get();
+	profiler.reset();
+	profiler.set_enabled(true);
+	profiler.start_capture();
+
+	static const char* const NAMES[THREADS] = { "Worker \"0\"", "Worker 1", "Worker 2", "Worker 3" };
+	std::atomic<uint32_t> finished = 0;
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < THREADS; ++t) {
+		threads.emplace_back([&, t] {
+			Profiler::get().set_thread_name(NAMES[t]);
+			for (uint32_t i = 0; i < ITERATIONS; ++i) {
+				DVIG_PROFILE_SCOPE("outer");
+				{
+					DVIG_PROFILE_SCOPE("inner");
+					std::this_thread::yield();
+				}
+				DVIG_PROFILE_SCOPE("second");
+			}
+			finished++;
+		});
+	}
+
+	while (finished < THREADS) {
+		profiler.end_frame();
+		std::this_thread::yield();
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	profiler.end_frame();
+	profiler.set_enabled(false);
+	profiler.stop_capture();
+
+	CHECK(profiler.dropped_event_count() == 0);
+	const std::vector<ProfileScopeStats> stats = profiler.stats();
+	for (const char* name : { "inner", "outer", "second" }) {
+		const ProfileScopeStats* scope = find_stats(stats, name);
+		CHECK(scope && scope->samples == Profiler::HISTORY_SIZE);
+		CHECK(scope && scope->min_ms <= scope->avg_ms && scope->avg_ms <= scope->p99_ms);
+	}
+
+	const std::string json = profiler.chrome_trace_json();
+	CHECK(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", 0) == 0);
+	CHECK(json.size() > 3 && json.compare(json.size() - 3, 3, "]}\n") == 0);
+
+	std::map<uint32_t, std::string> thread_names;
+	const std::vector<TraceEvent> events = parse_trace(json, thread_names);
+	CHECK(events.size() == THREADS * ITERATIONS * 3);
+	CHECK(thread_names[Profiler::GPU_THREAD_ID] == "GPU");
+
+	// Every inner and second scope lies inside an outer one of its thread
+	std::map<uint32_t, std::vector<const TraceEvent*>> outer;
+	std::map<uint32_t, uint32_t> per_thread;
+	double first_ts = 1e30;
+	for (const TraceEvent& event : events) {
+		CHECK(event.category == "cpu" && event.dur >= 0);
+		first_ts = std::min(first_ts, event.ts);
+		per_thread[event.thread_id]++;
+		if (event.name == "outer") {
+			outer[event.thread_id].push_back(&event);
+		}
+	}
+	CHECK(first_ts == 0.0);
+	CHECK(per_thread.size() == THREADS);
+
+	uint32_t nested = 0;
+	for (const TraceEvent& event : events) {
+		if (event.name != "outer") {
+			for (const TraceEvent* parent : outer[event.thread_id]) {
+				if (event.ts >= parent->ts && event.ts + event.dur <= parent->ts + parent->dur + 1e-3) {
+					nested++;
+					break;
+				}
+			}
+		}
+	}
+	CHECK(nested == THREADS * ITERATIONS * 2);
+
+	// Names are escaped, the quotes don't end the string early
+	for (const auto& [thread_id, count] : per_thread) {
+		CHECK(count == ITERATIONS * 3);
+		CHECK(thread_names[thread_id].rfind("Worker ", 0) == 0);
+	}
+	CHECK(json.find("\"args\":{\"name\":\"Worker \\\"0\\\"\"}}") != std::string::npos);
+
+	profiler.reset();
+}
+
+int main() {
+	test_stats();
+	test_full_ring();
+	test_threads_and_trace();
+	return check_result();
+}
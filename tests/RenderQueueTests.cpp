@@ -0,0 +1,246 @@
+#include "pch.h"
+#include "RenderCommands.h"
+
+#include "Check.h"
+
+#include <random>
+
+using namespace dvig;
+
+// Backend objects are only referenced by pointer, recording never touches them
+static VertexBuffer* fake_vertex_buffer(uintptr_t id) { return reinterpret_cast<VertexBuffer*>(id * 16); }
+static VertexShader* fake_shader(uintptr_t id) { return reinterpret_cast<VertexShader*>(id * 16); }
+
+static void test_encode_decode() {
+	RenderCommandBuffer commands(64); // Small, so recording grows it a few times
+
+	const uint8_t vertices[3 * 20] = { 1, 2, 3 };
+	const float uniforms[5] = { 1.0f, 2.0f, 3.0f, 4.0f, 5.0f };
+	VertexBuffer* buffers[2] = { fake_vertex_buffer(1), fake_vertex_buffer(2) };
+	const uint32_t strides[2] = { 20, 8 };
+
+	commands.set_viewport({ 1.0f, 2.0f }, { 640.0f, 480.0f });
+	commands.clear_color({ 0.1f, 0.2f, 0.3f, 1.0f });
+	commands.update(*buffers[0], vertices, 20, 3);
+	commands.bind_vertex_buffers(1, 2, buffers, strides);
+	commands.update(*fake_shader(3), uniforms, 12, sizeof(uniforms));
+	commands.set_topology(TopologyType::TriangleList);
+	commands.draw_instanced(4, 100, 0, 7);
+	commands.draw_indexed(6, 12, -4);
+	commands.begin_gpu_scope("scope");
+	commands.end_gpu_scope();
+	commands.present(1);
+
+	CHECK(commands.command_count() == 11);
+	CHECK(commands.capacity() >= commands.size() && commands.size() % RenderCommandBuffer::ALIGNMENT == 0);
+
+	std::vector<RenderCommandType> types;
+	size_t size = 0;
+	commands.for_each([&](const RenderCommandHeader& header, const uint8_t* payload) {
+		types.push_back(header.type);
+		size += header.size;
+		CHECK(header.size % RenderCommandBuffer::ALIGNMENT == 0);
+
+		switch (header.type) {
+		case RenderCommandType::SetViewport: {
+			const auto command = read_render_command<SetViewportCommand>(payload);
+			CHECK(command.pos.x == 1.0f && command.size.y == 480.0f);
+			break;
+		}
+		case RenderCommandType::ClearColor:
+			CHECK(read_render_command<ClearColorCommand>(payload).color.z == 0.3f);
+			break;
+		case RenderCommandType::UpdateVertexBuffer: {
+			const auto command = read_render_command<UpdateVertexBufferCommand>(payload);
+			CHECK(command.buffer == buffers[0] && command.vertex_size == 20 && command.vertex_count == 3);
+			CHECK(header.size >= sizeof(RenderCommandHeader) + sizeof(command) + sizeof(vertices));
+			CHECK(memcmp(payload + sizeof(command), vertices, sizeof(vertices)) == 0);
+			break;
+		}
+		case RenderCommandType::BindVertexBuffers: {
+			const auto command = read_render_command<BindVertexBuffersCommand>(payload);
+			CHECK(command.first_slot == 1 && command.buffer_count == 2);
+			CHECK(command.buffers[1] == buffers[1] && command.strides[0] == 20 && command.strides[1] == 8);
+			break;
+		}
+		case RenderCommandType::UpdateUniforms: {
+			const auto command = read_render_command<UpdateUniformsCommand>(payload);
+			CHECK(command.shader == fake_shader(3) && command.offset == 12 && command.size == sizeof(uniforms));
+			CHECK(memcmp(payload + sizeof(command), uniforms, sizeof(uniforms)) == 0);
+			break;
+		}
+		case RenderCommandType::SetTopology:
+			CHECK(read_render_command<SetTopologyCommand>(payload).topology == TopologyType::TriangleList);
+			break;
+		case RenderCommandType::DrawInstanced: {
+			const auto command = read_render_command<DrawInstancedCommand>(payload);
+			CHECK(command.vertex_count == 4 && command.instance_count == 100 && command.instance_start_location == 7);
+			break;
+		}
+		case RenderCommandType::DrawIndexed: {
+			const auto command = read_render_command<DrawIndexedCommand>(payload);
+			CHECK(command.index_count == 6 && command.index_start_location == 12 && command.base_vertex_location == -4);
+			break;
+		}
+		case RenderCommandType::BeginGpuScope:
+			CHECK(strcmp(read_render_command<BeginGpuScopeCommand>(payload).name, "scope") == 0);
+			break;
+		case RenderCommandType::Present:
+			CHECK(read_render_command<PresentCommand>(payload).VSync == 1);
+			break;
+		default:
+			break;
+		}
+	});
+
+	const std::vector<RenderCommandType> expected = {
+		RenderCommandType::SetViewport, RenderCommandType::ClearColor, RenderCommandType::UpdateVertexBuffer,
+		RenderCommandType::BindVertexBuffers, RenderCommandType::UpdateUniforms, RenderCommandType::SetTopology,
+		RenderCommandType::DrawInstanced, RenderCommandType::DrawIndexed, RenderCommandType::BeginGpuScope,
+		RenderCommandType::EndGpuScope, RenderCommandType::Present,
+	};
+	CHECK(types == expected);
+	CHECK(size == commands.size());
+
+	// Cleared buffers keep their memory and release what they retained
+	const size_t capacity = commands.capacity();
+	Shared<int> retained = std::make_shared<int>(5);
+	commands.retain(retained);
+	CHECK(retained.use_count() == 2);
+	commands.clear();
+	CHECK(commands.empty() && commands.command_count() == 0);
+	CHECK(commands.capacity() == capacity);
+	CHECK(retained.use_count() == 1);
+}
+
+// Every frame records a varying number of commands with data derived from the frame index, the render
+// thread checks it all arrives intact and in order while both sides run at random speeds
+static void test_stress(uint32_t frames_in_flight) {
+	constexpr uint32_t FRAMES = 20000;
+
+	std::atomic<uint64_t> executed_frames = 0;
+	std::atomic<uint32_t> errors = 0;
+	std::atomic<uint32_t> thread_switches = 0;
+	std::thread::id render_thread_id;
+	std::mt19937 render_rng(1);
+
+	RenderQueue queue(frames_in_flight, true, [&](RenderCommandBuffer& commands) {
+		if (render_thread_id != std::this_thread::get_id()) {
+			render_thread_id = std::this_thread::get_id();
+			thread_switches++;
+		}
+
+		const uint64_t frame = executed_frames.load();
+		uint32_t draws = 0;
+		bool presented = false;
+		commands.for_each([&](const RenderCommandHeader& header, const uint8_t* payload) {
+			switch (header.type) {
+			case RenderCommandType::UpdateUniforms: {
+				const auto command = read_render_command<UpdateUniformsCommand>(payload);
+				uint64_t data[32];
+				memcpy(data, payload + sizeof(command), command.size);
+				for (uint32_t i = 0; i < command.size / sizeof(uint64_t); ++i) {
+					errors += data[i] != frame * 1000 + i;
+				}
+				break;
+			}
+			case RenderCommandType::Draw: {
+				const auto command = read_render_command<DrawCommand>(payload);
+				errors += command.vertex_count != static_cast<uint32_t>(frame) || command.vertex_start_location != draws;
+				draws++;
+				break;
+			}
+			case RenderCommandType::Present:
+				presented = true;
+				break;
+			default:
+				errors++;
+				break;
+			}
+		});
+
+		errors += !presented || draws != frame % 50 || commands.command_count() != draws * 2 + 1;
+		executed_frames++;
+		if (render_rng() % 8 == 0) {
+			std::this_thread::yield();
+		}
+	});
+	CHECK(queue.threaded() && queue.frames_in_flight() == std::max(frames_in_flight, 2u));
+
+	std::mt19937 rng(2);
+	uint64_t data[32];
+	for (uint64_t frame = 0; frame < FRAMES; ++frame) {
+		RenderCommandBuffer& commands = queue.commands();
+		CHECK(commands.empty());
+
+		for (uint32_t draw = 0; draw < frame % 50; ++draw) {
+			const uint32_t count = 1 + static_cast<uint32_t>(rng() % 32);
+			for (uint32_t i = 0; i < count; ++i) {
+				data[i] = frame * 1000 + i;
+			}
+			commands.update(*fake_shader(draw + 1), data, 0, count * sizeof(uint64_t));
+			commands.draw(static_cast<uint32_t>(frame), draw);
+		}
+		commands.present(0);
+
+		// Frames this size never outgrow the initial buffer
+		CHECK(commands.capacity() == RenderCommandBuffer::DEFAULT_CAPACITY);
+
+		queue.submit();
+		CHECK(queue.submitted_frames() == frame + 1);
+		CHECK(queue.submitted_frames() - queue.executed_frames() < queue.frames_in_flight());
+
+		if (rng() % 8 == 0) {
+			std::this_thread::yield();
+		}
+	}
+
+	queue.wait_idle();
+	CHECK(queue.executed_frames() == FRAMES && executed_frames == FRAMES);
+	CHECK(errors == 0);
+	CHECK(thread_switches == 1 && render_thread_id != std::this_thread::get_id());
+}
+
+static void test_unthreaded() {
+	uint32_t executed = 0;
+	RenderQueue queue(3, false, [&](RenderCommandBuffer& commands) {
+		CHECK(commands.command_count() == 1);
+		executed++;
+	});
+	CHECK(!queue.threaded() && queue.frames_in_flight() == 1);
+
+	// Executed within submit(), on this thread
+	for (uint32_t frame = 0; frame < 10; ++frame) {
+		queue.commands().draw(3, 0);
+		queue.submit();
+		CHECK(executed == frame + 1 && queue.executed_frames() == frame + 1);
+		CHECK(queue.commands().empty());
+	}
+}
+
+// Frames still in flight when the queue goes away are executed, not dropped
+static void test_shutdown() {
+	std::atomic<uint32_t> executed = 0;
+	{
+		RenderQueue queue(3, true, [&](RenderCommandBuffer& /*commands*/) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			executed++;
+		});
+
+		for (uint32_t frame = 0; frame < 10; ++frame) {
+			queue.commands().present(0);
+			queue.submit();
+		}
+	}
+	CHECK(executed == 10);
+}
+
+int main() {
+	test_encode_decode();
+	test_stress(1);
+	test_stress(2);
+	test_stress(3);
+	test_unthreaded();
+	test_shutdown();
+	return check_result();
+}
@@ -0,0 +1,168 @@
+#include "pch.h"
+#include "ResourcePool.h"
+#include "HeadlessBackend.h"
+
+#include "Check.h"
+
+using namespace dvig;
+
+// Counts live objects, so the tests see exactly when the pool destroys one
+struct Counted {
+	static inline int live = 0;
+
+	explicit Counted(int value) : value(value) { live++; }
+	Counted(Counted&& other) noexcept : value(other.value) { live++; }
+	~Counted() { live--; }
+
+	int value = 0;
+};
+
+static void test_generation_bump() {
+	ResourcePool<Counted> pool;
+
+	Handle<Counted> first = pool.add(Counted(1));
+	CHECK(first.index() == 0 && first.generation() == 1);
+
+	pool.remove(first, 0);
+	pool.collect(1);
+
+	// Same slot, next generation
+	Handle<Counted> second = pool.add(Counted(2));
+	CHECK(second.index() == first.index());
+	CHECK(second.generation() == 2);
+	CHECK(second != first);
+	CHECK(pool.get(second).value == 2);
+	CHECK(pool.slot_count() == 1);
+
+	// Wraps back to 1, never to the null generation
+	Handle<Counted> handle = second;
+	for (uint32_t i = 0; i < Handle<Counted>::MAX_GENERATION - 1; ++i) {
+		pool.remove(handle, 0);
+		pool.collect(1);
+		handle = pool.add(Counted(3));
+		CHECK(handle.index() == first.index() && handle.generation() >= 1);
+	}
+	CHECK(handle.generation() == 1);
+	CHECK(!handle.is_null());
+}
+
+static void test_stale_handles() {
+	ResourcePool<Counted> pool;
+
+	CHECK(!pool.alive({}));
+	CHECK(pool.find({}) == nullptr);
+	CHECK(pool.find(Handle<Counted>(5, 1)) == nullptr); // Past the slots
+
+	Handle<Counted> a = pool.add(Counted(1));
+	Handle<Counted> b = pool.add(Counted(2));
+	CHECK(pool.alive(a) && pool.find(b)->value == 2);
+	CHECK(pool.size() == 2);
+
+	// Stale right away, the object is still there for commands recorded before
+	pool.remove(a, 0);
+	CHECK(!pool.alive(a));
+	CHECK(pool.find(a) == nullptr);
+	CHECK(pool.size() == 1 && pool.retired_count() == 1);
+
+	// Removing a stale handle again does nothing
+	pool.remove(a, 0);
+	CHECK(pool.size() == 1 && pool.retired_count() == 1);
+
+	// A handle of the slot's next generation isn't handed out yet
+	CHECK(pool.find(Handle<Counted>(a.index(), a.generation() + 1)) == nullptr);
+
+	pool.collect(1);
+	Handle<Counted> c = pool.add(Counted(3));
+	CHECK(c.index() == a.index());
+	CHECK(pool.find(a) == nullptr);
+	CHECK(pool.find(c)->value == 3);
+	CHECK(pool.find(b)->value == 2);
+}
+
+static void test_deferred_destruction() {
+	ResourcePool<Counted> pool;
+	const int live = Counted::live;
+
+	Handle<Counted> handle = pool.add(Counted(7));
+	const Counted* object = pool.find(handle);
+	CHECK(Counted::live == live + 1);
+
+	// Removed while recording frame 5
+	pool.remove(handle, 5);
+	pool.collect(4);
+	pool.collect(5);
+	CHECK(Counted::live == live + 1);
+	CHECK(object->value == 7);
+	CHECK(pool.retired_count() == 1);
+
+	// The slot isn't reused before the frame executed
+	Handle<Counted> other = pool.add(Counted(8));
+	CHECK(other.index() != handle.index());
+
+	// Frame 5 executed
+	pool.collect(6);
+	CHECK(Counted::live == live + 1);
+	CHECK(pool.retired_count() == 0);
+	CHECK(pool.find(other)->value == 8);
+
+	Handle<Counted> reused = pool.add(Counted(9));
+	CHECK(reused.index() == handle.index());
+	CHECK(pool.find(reused) == object); // By value in the same slot
+}
+
+static void test_stable_addresses() {
+	// Move only types go in by value
+	ResourcePool<Unique<int>> pool;
+
+	std::vector<Handle<Unique<int>>> handles;
+	std::vector<const Unique<int>*> objects;
+	for (int i = 0; i < 1000; ++i) {
+		handles.push_back(pool.add(std::make_unique<int>(i)));
+		objects.push_back(pool.find(handles.back()));
+	}
+
+	// Growing adds pages, nothing moves
+	for (int i = 0; i < 1000; ++i) {
+		CHECK(pool.find(handles[i]) == objects[i]);
+		CHECK(**objects[i] == i);
+	}
+	CHECK(pool.slot_count() == 1000);
+}
+
+static void test_headless_backend() {
+	HeadlessBackend backend;
+
+	const float vertices[6] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f };
+	VertexBufferHandle buffer = backend.create_vertex_buffer(vertices, 2 * sizeof(float), 3, BufferDataType::Static);
+	VertexBuffer& object = backend.get(buffer);
+	CHECK(object.count == 3);
+	CHECK(memcmp(static_cast<HeadlessVertexBuffer&>(object).data.data(), vertices, sizeof(vertices)) == 0);
+
+	// Compiled shaders are loose until they go in the pool
+	Shared<VertexShader> compiled = backend.compile_vertex_shader(L"mesh_2d.hlsl", {}, 64, "vertex_main");
+	VertexShaderHandle shader = backend.add(std::move(*compiled));
+	CHECK(backend.get(shader).uniform_buffer_size == 64);
+
+	backend.destroy(buffer, 3);
+	backend.destroy(shader, 3);
+	CHECK(backend.find(buffer) == nullptr);
+	CHECK(backend.find(shader) == nullptr);
+
+	backend.collect_resources(3);
+	VertexBufferHandle next = backend.create_vertex_buffer(nullptr, 4, 1, BufferDataType::Dynamic);
+	CHECK(next.index() != buffer.index());
+
+	backend.collect_resources(4);
+	VertexBufferHandle reused = backend.create_vertex_buffer(nullptr, 4, 1, BufferDataType::Dynamic);
+	CHECK(reused.index() == buffer.index() && reused.generation() == buffer.generation() + 1);
+	CHECK(backend.find(buffer) == nullptr);
+}
+
+int main() {
+	test_generation_bump();
+	test_stale_handles();
+	test_deferred_destruction();
+	test_stable_addresses();
+	test_headless_backend();
+	return check_result();
+}
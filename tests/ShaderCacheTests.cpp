@@ -0,0 +1,228 @@
+#include "pch.h"
+#include "ShaderCache.h"
+
+#include "Check.h"
+
+#include <map>
+
+using namespace dvig;
+
+static const std::filesystem::path CACHE_DIRECTORY = std::filesystem::temp_directory_path() / "dvig_shader_cache_tests";
+
+static std::string read_bytes(const std::filesystem::path& path) {
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void write_bytes(const std::filesystem::path& path, const std::string& bytes) {
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(bytes.data(), bytes.size());
+}
+
+static std::vector<std::filesystem::path> files_in(const std::filesystem::path& directory) {
+	std::vector<std::filesystem::path> files;
+	for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+		files.push_back(entry.path());
+	}
+	return files;
+}
+
+// Includes come from a map instead of the disk
+static std::optional<uint64_t> hash_with(const std::string& source, const std::map<std::string, std::string>& files) {
+	return hash_shader_source("shaders/main.hlsl", source, [&](const std::filesystem::path& path, std::string& content) {
+		auto it = files.find(path.generic_string());
+		if (it == files.end()) {
+			return false;
+		}
+		content = it->second;
+		return true;
+	});
+}
+
+static void test_key_changes() {
+	const std::string source = "#include \"common.hlsl\"\nfloat4 main() : SV_Target { return 1; }\n";
+	const std::map<std::string, std::string> files = { { "shaders/common.hlsl", "#define ONE 1\n" } };
+
+	const std::optional<uint64_t> base_hash = hash_with(source, files);
+	CHECK(base_hash.has_value());
+	CHECK(hash_with(source, files) == base_hash);
+
+	// Source, include content and include name all change the hash
+	CHECK(hash_with(source + " ", files) != base_hash);
+	CHECK(hash_with(source, { { "shaders/common.hlsl", "#define ONE 2\n" } }) != base_hash);
+	CHECK(hash_with("#include \"other.hlsl\"\nfloat4 main() : SV_Target { return 1; }\n", { { "shaders/other.hlsl", "#define ONE 1\n" } }) != base_hash);
+	// A missing include hashes differently from an empty one
+	CHECK(hash_with(source, {}) != hash_with(source, { { "shaders/common.hlsl", "" } }));
+
+	ShaderCacheKey base;
+	base.source_hash = *base_hash;
+	base.entry = "pixel_main";
+	base.profile = "ps_4_0";
+	base.flags = 1;
+	base.compiler_version = 47;
+
+	std::vector<ShaderCacheKey> keys(6, base);
+	keys[1].source_hash = *hash_with(source, { { "shaders/common.hlsl", "#define ONE 2\n" } });
+	keys[2].entry = "vertex_main";
+	keys[3].profile = "ps_5_0";
+	keys[4].flags = 3;
+	keys[5].compiler_version = 43;
+
+	const ShaderCache cache(CACHE_DIRECTORY);
+	for (size_t a = 0; a < keys.size(); ++a) {
+		for (size_t b = a + 1; b < keys.size(); ++b) {
+			CHECK(keys[a].to_string() != keys[b].to_string());
+			CHECK(keys[a].hash() != keys[b].hash());
+			CHECK(cache.entry_path(keys[a]) != cache.entry_path(keys[b]));
+		}
+	}
+
+	ShaderCacheKey same = base;
+	CHECK(same.to_string() == base.to_string() && same.hash() == base.hash());
+}
+
+static void test_includes() {
+	// Nested includes resolve relative to the including file, cycles end
+	const std::map<std::string, std::string> files = {
+		{ "shaders/lib/a.hlsl", "  #  include \"b.hlsl\"\n" },
+		{ "shaders/lib/b.hlsl", "#include <../lib/a.hlsl>\nfloat b;\n" },
+	};
+	const std::optional<uint64_t> hash = hash_with("#include \"lib/a.hlsl\"\n", files);
+	CHECK(hash.has_value());
+
+	std::map<std::string, std::string> changed = files;
+	changed["shaders/lib/b.hlsl"] = "#include <../lib/a.hlsl>\nfloat c;\n";
+	CHECK(hash_with("#include \"lib/a.hlsl\"\n", changed) != hash);
+
+	// From disk
+	const std::filesystem::path directory = CACHE_DIRECTORY / "source";
+	std::filesystem::create_directories(directory);
+	write_bytes(directory / "main.hlsl", "#include \"common.hlsl\"\n");
+	write_bytes(directory / "common.hlsl", "float a;\n");
+	const std::optional<uint64_t> disk_hash = hash_shader_source(directory / "main.hlsl");
+	CHECK(disk_hash.has_value());
+	write_bytes(directory / "common.hlsl", "float b;\n");
+	CHECK(hash_shader_source(directory / "main.hlsl") != disk_hash);
+	CHECK(!hash_shader_source(directory / "missing.hlsl"));
+	std::filesystem::remove_all(directory);
+}
+
+static ShaderCacheKey test_key(uint32_t flags) {
+	ShaderCacheKey key;
+	key.source_hash = 0x1234;
+	key.entry = "vertex_main";
+	key.profile = "vs_4_0";
+	key.flags = flags;
+	key.compiler_version = 47;
+	return key;
+}
+
+static void test_store_and_load() {
+	const ShaderCache cache(CACHE_DIRECTORY);
+	const std::string bytecode = "DXBC fake bytecode";
+
+	std::vector<char> loaded;
+	CHECK(!cache.load(test_key(0), loaded));
+
+	cache.store(test_key(0), bytecode.data(), bytecode.size());
+	CHECK(cache.load(test_key(0), loaded));
+	CHECK(std::string(loaded.begin(), loaded.end()) == bytecode);
+	CHECK(!cache.load(test_key(1), loaded));
+
+	// Only the entry, no temporary file
+	const std::vector<std::filesystem::path> files = files_in(CACHE_DIRECTORY);
+	CHECK(files.size() == 1 && files[0] == cache.entry_path(test_key(0)));
+
+	// A temporary file a crash left behind is overwritten
+	std::filesystem::path temp_path = cache.entry_path(test_key(2));
+	temp_path += ".tmp";
+	write_bytes(temp_path, "half written");
+	cache.store(test_key(2), bytecode.data(), bytecode.size());
+	CHECK(!std::filesystem::exists(temp_path));
+	CHECK(cache.load(test_key(2), loaded));
+
+#ifdef __linux__
+	// Writes to /dev/full fail on flush. The temporary file goes away and the entry never appears
+	temp_path = cache.entry_path(test_key(3));
+	temp_path += ".tmp";
+	std::filesystem::create_symlink("/dev/full", temp_path);
+	cache.store(test_key(3), bytecode.data(), bytecode.size());
+	CHECK(!std::filesystem::exists(cache.entry_path(test_key(3))));
+	CHECK(!std::filesystem::is_symlink(temp_path));
+#endif
+
+	std::filesystem::remove_all(CACHE_DIRECTORY);
+}
+
+// Every damaged file is a miss and gets removed, the next store writes a good one
+static void test_rejected_entries() {
+	const ShaderCache cache(CACHE_DIRECTORY);
+	const std::string bytecode = "DXBC fake bytecode";
+	const ShaderCacheKey key = test_key(0);
+	const std::filesystem::path path = cache.entry_path(key);
+
+	cache.store(key, bytecode.data(), bytecode.size());
+	const std::string good = read_bytes(path);
+	CHECK(good.size() == sizeof(ShaderCacheFileHeader) + key.to_string().size() + bytecode.size());
+
+	auto with_header = [&](auto change) {
+		ShaderCacheFileHeader header;
+		memcpy(&header, good.data(), sizeof(header));
+		change(header);
+		std::string bytes = good;
+		memcpy(bytes.data(), &header, sizeof(header));
+		return bytes;
+	};
+
+	std::string flipped_key = good;
+	flipped_key[sizeof(ShaderCacheFileHeader) + 2] ^= 1;
+	std::string flipped_bytecode = good;
+	flipped_bytecode.back() ^= 1;
+
+	const std::vector<std::pair<const char*, std::string>> damaged = {
+		{ "empty", "" },
+		{ "short header", good.substr(0, sizeof(ShaderCacheFileHeader) / 2) },
+		{ "truncated bytecode", good.substr(0, good.size() - 1) },
+		{ "trailing bytes", good + "x" },
+		{ "magic", with_header([](ShaderCacheFileHeader& header) { header.magic ^= 1; }) },
+		{ "version", with_header([](ShaderCacheFileHeader& header) { header.version++; }) },
+		{ "key hash", with_header([](ShaderCacheFileHeader& header) { header.key_hash++; }) },
+		{ "key size", with_header([](ShaderCacheFileHeader& header) { header.key_size--; }) },
+		{ "huge bytecode size", with_header([](ShaderCacheFileHeader& header) { header.bytecode_size = 0xffffffff; }) },
+		{ "bytecode hash", with_header([](ShaderCacheFileHeader& header) { header.bytecode_hash++; }) },
+		{ "key", flipped_key },
+		{ "bytecode", flipped_bytecode },
+	};
+
+	for (const auto& [name, bytes] : damaged) {
+		write_bytes(path, bytes);
+		std::vector<char> loaded = { 'x' };
+		const bool hit = cache.load(key, loaded);
+		if (hit || !loaded.empty() || std::filesystem::exists(path)) {
+			std::printf("%s: accepted or not removed\n", name);
+		}
+		CHECK(!hit && loaded.empty());
+		CHECK(!std::filesystem::exists(path));
+	}
+
+	// A good entry of another key at this key's path
+	const ShaderCacheKey other = test_key(5);
+	cache.store(other, bytecode.data(), bytecode.size());
+	std::filesystem::rename(cache.entry_path(other), path);
+	std::vector<char> loaded;
+	CHECK(!cache.load(key, loaded));
+
+	cache.store(key, bytecode.data(), bytecode.size());
+	CHECK(cache.load(key, loaded));
+
+	std::filesystem::remove_all(CACHE_DIRECTORY);
+}
+
+int main() {
+	std::filesystem::remove_all(CACHE_DIRECTORY);
+	test_key_changes();
+	test_includes();
+	test_store_and_load();
+	test_rejected_entries();
+	return check_result();
+}
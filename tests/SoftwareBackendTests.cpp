@@ -0,0 +1,281 @@
+#include "pch.h"
+#include "Renderer.h"
+#include "SoftwareBackend.h"
+
+#include "Check.h"
+#include "HeadlessApp.h"
+
+#include <fstream>
+
+using namespace dvig;
+
+// Golden images are built here from the D3D coverage rules instead of stored files: a pixel belongs to an axis
+// aligned edge when its center is inside, centers exactly on one belong to the top and left edges only.
+// The sizes aren't multiples of SoftwareBackend::TILE_SIZE, so the partial tiles on the right and bottom run too
+static constexpr uint32_t WIDTH = 200;
+static constexpr uint32_t HEIGHT = 150;
+
+static const float PI = 3.14159265f;
+
+static const glm::vec4 BLACK(0.0f, 0.0f, 0.0f, 1.0f);
+static const glm::vec4 RED(1.0f, 0.0f, 0.0f, 1.0f);
+static const glm::vec4 GREEN(0.0f, 1.0f, 0.0f, 1.0f);
+static const glm::vec4 BLUE(0.0f, 0.0f, 1.0f, 1.0f);
+static const glm::vec4 YELLOW(1.0f, 1.0f, 0.0f, 1.0f);
+
+struct Golden {
+	uint32_t width = WIDTH;
+	uint32_t height = HEIGHT;
+	std::vector<uint32_t> pixels;
+
+	Golden(const glm::vec4& clear) : pixels(size_t(WIDTH) * HEIGHT, pack_color_rgba8(clear)) {}
+
+	// Pixels from ceil(min - 0.5) to ceil(max - 0.5), so the min edges include centers on them and the max edges don't
+	void fill(glm::vec2 min, glm::vec2 max, uint32_t color, glm::ivec2 clip_min = glm::ivec2(0), glm::ivec2 clip_max = glm::ivec2(WIDTH, HEIGHT)) {
+		const int32_t x0 = std::max(clip_min.x, int32_t(std::ceil(min.x - 0.5f)));
+		const int32_t y0 = std::max(clip_min.y, int32_t(std::ceil(min.y - 0.5f)));
+		const int32_t x1 = std::min(clip_max.x, int32_t(std::ceil(max.x - 0.5f)));
+		const int32_t y1 = std::min(clip_max.y, int32_t(std::ceil(max.y - 0.5f)));
+		for (int32_t y = y0; y < y1; ++y) {
+			for (int32_t x = x0; x < x1; ++x) {
+				pixels[size_t(y) * width + x] = color;
+			}
+		}
+	}
+
+	void fill(glm::vec2 min, glm::vec2 max, const glm::vec4& color) {
+		fill(min, max, pack_color_rgba8(color));
+	}
+};
+
+static void write_ppm(const std::string& path, const std::vector<uint32_t>& pixels) {
+	std::ofstream file(path, std::ios::binary);
+	file << "P6\n" << WIDTH << " " << HEIGHT << "\n255\n";
+	for (uint32_t pixel : pixels) {
+		const char rgb[3] = { char(pixel & 0xff), char((pixel >> 8) & 0xff), char((pixel >> 16) & 0xff) };
+		file.write(rgb, 3);
+	}
+}
+
+// Channels may differ by tolerance. On a mismatch both images are written next to the test as .ppm
+static bool matches(const char* name, const SoftwareBackend& backend, const Golden& golden, int tolerance = 0) {
+	std::vector<uint32_t> pixels;
+	backend.read_pixels(pixels);
+	if (pixels.size() != golden.pixels.size()) {
+		std::printf("%s: %zu pixels, expected %zu\n", name, pixels.size(), golden.pixels.size());
+		return false;
+	}
+
+	uint32_t mismatches = 0;
+	for (size_t i = 0; i < pixels.size(); ++i) {
+		for (uint32_t shift = 0; shift < 32; shift += 8) {
+			const int actual = int((pixels[i] >> shift) & 0xff);
+			const int expected = int((golden.pixels[i] >> shift) & 0xff);
+			if (std::abs(actual - expected) > tolerance) {
+				if (mismatches++ == 0) {
+					std::printf("%s: first mismatch at %zu, %zu: %08x, expected %08x\n",
+						name, i % WIDTH, i / WIDTH, pixels[i], golden.pixels[i]);
+				}
+				break;
+			}
+		}
+	}
+
+	if (mismatches > 0) {
+		std::printf("%s: %u pixels differ\n", name, mismatches);
+		write_ppm(std::string(name) + "_actual.ppm", pixels);
+		write_ppm(std::string(name) + "_expected.ppm", golden.pixels);
+	}
+	return mismatches == 0;
+}
+
+// Pixels of a size x size target to clip space, y down
+static glm::mat4 pixel_projection(glm::vec2 size) {
+	glm::mat4 projection(1.0f);
+	projection[0][0] = 2.0f / size.x;
+	projection[1][1] = -2.0f / size.y;
+	projection[3][0] = -1.0f;
+	projection[3][1] = 1.0f;
+	return projection;
+}
+
+static const glm::mat4 VIEW_PROJECTION = pixel_projection({ WIDTH, HEIGHT });
+
+static void draw_box(Renderer& renderer, glm::vec2 min, glm::vec2 max, const glm::vec4& color, const glm::mat4& transform = VIEW_PROJECTION) {
+	renderer.draw_quad(min, { max.x, min.y }, { min.x, max.y }, max, color, transform);
+}
+
+// Runs one frame of draw on the software backend and compares it
+static void check_render(const char* name, const std::function<void(Renderer&)>& draw, const Golden& golden, int tolerance = 0) {
+	AppSpec spec = headless_spec();
+	spec.render_backend = RenderBackendType::Software;
+	spec.width = WIDTH;
+	spec.height = HEIGHT;
+
+	HeadlessApp app(spec);
+	app.on_render = draw;
+	app.run_headless(1);
+
+	const auto& backend = static_cast<const SoftwareBackend&>(app.renderer().backend());
+	CHECK(backend.framebuffer_size() == glm::ivec2(WIDTH, HEIGHT));
+	CHECK(matches(name, backend, golden, tolerance));
+}
+
+static void test_clear() {
+	const glm::vec4 color(0.2f, 0.4f, 0.6f, 1.0f);
+	check_render("clear", [&](Renderer& renderer) {
+		renderer.clear_color(RED);
+		renderer.clear_color(color);
+	}, Golden(color));
+}
+
+static void test_quads() {
+	Golden golden(BLACK);
+	golden.fill({ 10.0f, 12.0f }, { 40.0f, 30.0f }, RED);
+	// Fractional edges, centers exactly on the min edges
+	golden.fill({ 50.5f, 60.5f }, { 130.5f, 70.5f }, GREEN);
+	golden.fill({ 150.25f, 20.75f }, { 160.75f, 33.25f }, BLUE);
+	// Over the framebuffer edges
+	golden.fill({ -20.0f, 130.0f }, { 30.0f, 170.0f }, YELLOW);
+	golden.fill({ 190.0f, -5.0f }, { 260.0f, 8.0f }, YELLOW);
+
+	check_render("quads", [](Renderer& renderer) {
+		renderer.clear_color(BLACK);
+		draw_box(renderer, { 10.0f, 12.0f }, { 40.0f, 30.0f }, RED);
+		draw_box(renderer, { 50.5f, 60.5f }, { 130.5f, 70.5f }, GREEN);
+		draw_box(renderer, { 150.25f, 20.75f }, { 160.75f, 33.25f }, BLUE);
+		draw_box(renderer, { -20.0f, 130.0f }, { 30.0f, 170.0f }, YELLOW);
+		draw_box(renderer, { 190.0f, -5.0f }, { 260.0f, 8.0f }, YELLOW);
+		// Counter clockwise is a back face
+		renderer.draw_quad({ 100.0f, 100.0f }, { 100.0f, 120.0f }, { 120.0f, 100.0f }, { 120.0f, 120.0f }, RED, VIEW_PROJECTION);
+	}, golden);
+}
+
+static void test_rects() {
+	Golden golden(BLACK);
+	golden.fill({ 20.0f, 20.0f }, { 70.0f, 35.0f }, GREEN);
+	// 30 x 10 turned 90 degrees clockwise around its top left corner
+	golden.fill({ 90.25f, 20.25f }, { 100.25f, 50.25f }, RED);
+	// Half a turn around the center stays in place
+	golden.fill({ 120.0f, 80.0f }, { 180.0f, 100.0f }, BLUE);
+
+	check_render("rects", [](Renderer& renderer) {
+		renderer.clear_color(BLACK);
+		renderer.draw_rect({ 20.0f, 20.0f }, { 50.0f, 15.0f }, GREEN, VIEW_PROJECTION);
+		renderer.draw_rect({ 100.25f, 20.25f }, { 30.0f, 10.0f }, 0.5f * PI, { 0.0f, 0.0f }, RED, VIEW_PROJECTION);
+		renderer.draw_rect({ 120.0f, 80.0f }, { 60.0f, 20.0f }, PI, { 0.5f, 0.5f }, BLUE, VIEW_PROJECTION);
+	}, golden);
+}
+
+static void test_textured_quads() {
+	// 4 x 4 texels, each a different opaque color
+	std::array<uint32_t, 16> texels;
+	for (uint32_t i = 0; i < 16; ++i) {
+		texels[i] = 0xff000000u | (i * 16) | ((255 - i * 16) << 8) | ((i % 4) * 80 << 16);
+	}
+
+	Golden golden(BLACK);
+	// Point sampled 4 times magnified, every texel a 4 x 4 block
+	for (uint32_t i = 0; i < 16; ++i) {
+		const glm::vec2 min(32.0f + (i % 4) * 4.0f, 40.0f + (i / 4) * 4.0f);
+		golden.fill(min, min + glm::vec2(4.0f), texels[i]);
+	}
+	// The tint multiplies every channel, the sub rect picks the texels in the middle
+	for (uint32_t i : { 5u, 6u, 9u, 10u }) {
+		const glm::vec2 min(100.0f + (i % 4 - 1) * 8.0f, 40.0f + (i / 4 - 1) * 8.0f);
+		const uint32_t texel = texels[i];
+		uint32_t tinted = 0;
+		for (uint32_t shift = 0; shift < 32; shift += 8) {
+			const uint32_t tint = shift == 24 ? 255 : 128;
+			tinted |= (((texel >> shift) & 0xff) * tint + 127) / 255 << shift;
+		}
+		golden.fill(min, min + glm::vec2(8.0f), tinted);
+	}
+
+	check_render("textured_quads", [&](Renderer& renderer) {
+		Shared<Texture2D> texture = renderer.create_texture(4, 4, 1, TextureFormat::RGBA8_UNorm);
+		renderer.update(texture, 0, { 0, 0, 4, 4 }, texels.data());
+		Shared<Sampler> point = renderer.create_sampler({ TextureFilter::Point, TextureAddress::Clamp });
+
+		renderer.clear_color(BLACK);
+		renderer.draw_texture(texture, { 32.0f, 40.0f }, { 16.0f, 16.0f }, glm::vec4(1.0f), VIEW_PROJECTION, point);
+		renderer.draw_texture(texture, { 0.25f, 0.25f }, { 0.75f, 0.75f }, { 100.0f, 40.0f }, { 16.0f, 16.0f },
+			glm::vec4(128.0f / 255.0f, 128.0f / 255.0f, 128.0f / 255.0f, 1.0f), VIEW_PROJECTION, point);
+	}, golden, 1);
+}
+
+// Edges on and around tile borders, shared edges cover every pixel exactly once
+static void test_tile_edges() {
+	constexpr float TILE = float(SoftwareBackend::TILE_SIZE);
+
+	Golden golden(BLACK);
+	golden.fill({ TILE - 1.0f, 0.0f }, { TILE, HEIGHT }, RED);
+	golden.fill({ TILE, 0.0f }, { TILE + 1.0f, HEIGHT }, GREEN);
+	golden.fill({ 0.0f, 2.0f * TILE - 1.0f }, { WIDTH, 2.0f * TILE + 1.0f }, BLUE);
+	// Four boxes meeting at a tile corner
+	golden.fill({ 40.0f, 40.0f }, { TILE, TILE }, RED);
+	golden.fill({ TILE, 40.0f }, { 90.0f, TILE }, GREEN);
+	golden.fill({ 40.0f, TILE }, { TILE, 90.0f }, BLUE);
+	golden.fill({ TILE, TILE }, { 90.0f, 90.0f }, YELLOW);
+	// Up to the last pixel of the partial tiles
+	golden.fill({ WIDTH - 3.0f, HEIGHT - 3.0f }, { WIDTH, HEIGHT }, GREEN);
+
+	check_render("tile_edges", [&](Renderer& renderer) {
+		renderer.clear_color(BLACK);
+		draw_box(renderer, { TILE - 1.0f, 0.0f }, { TILE, HEIGHT }, RED);
+		draw_box(renderer, { TILE, 0.0f }, { TILE + 1.0f, HEIGHT }, GREEN);
+		draw_box(renderer, { 0.0f, 2.0f * TILE - 1.0f }, { WIDTH, 2.0f * TILE + 1.0f }, BLUE);
+		draw_box(renderer, { 40.0f, 40.0f }, { TILE, TILE }, RED);
+		draw_box(renderer, { TILE, 40.0f }, { 90.0f, TILE }, GREEN);
+		draw_box(renderer, { 40.0f, TILE }, { TILE, 90.0f }, BLUE);
+		draw_box(renderer, { TILE, TILE }, { 90.0f, 90.0f }, YELLOW);
+		draw_box(renderer, { WIDTH - 3.0f, HEIGHT - 3.0f }, { WIDTH, HEIGHT }, GREEN);
+	}, golden);
+
+	// A fan of triangles around a point next to a tile corner leaves no gaps
+	Golden covered(GREEN);
+	check_render("shared_edges", [&](Renderer& renderer) {
+		renderer.clear_color(RED);
+		const glm::vec2 center(TILE + 0.3f, TILE - 0.7f);
+		const glm::vec2 corners[4] = { { -1.0f, -1.0f }, { WIDTH + 1.0f, -1.0f }, { WIDTH + 1.0f, HEIGHT + 1.0f }, { -1.0f, HEIGHT + 1.0f } };
+		for (int i = 0; i < 4; ++i) {
+			// Degenerate fourth corner, so each quad is one visible triangle
+			renderer.draw_quad(center, corners[i], center, corners[(i + 1) % 4], GREEN, VIEW_PROJECTION);
+		}
+	}, covered);
+}
+
+// The viewport clips like a scissor, even where the projection reaches past it
+static void test_viewport_scissor() {
+	const glm::ivec2 viewport_min(30, 20);
+	const glm::ivec2 viewport_size(100, 70);
+
+	Golden golden(BLACK);
+	const glm::ivec2 viewport_max = viewport_min + viewport_size;
+	auto fill_local = [&](glm::vec2 min, glm::vec2 max, const glm::vec4& color) {
+		golden.fill(glm::vec2(viewport_min) + min, glm::vec2(viewport_min) + max, pack_color_rgba8(color), viewport_min, viewport_max);
+	};
+	fill_local({ -10.0f, -10.0f }, { 40.0f, 30.0f }, RED);
+	fill_local({ 80.0f, 50.0f }, { 150.0f, 120.0f }, GREEN);
+	fill_local({ 45.0f, 5.0f }, { 55.0f, 15.0f }, BLUE);
+
+	check_render("viewport_scissor", [&](Renderer& renderer) {
+		renderer.clear_color(BLACK);
+		renderer.set_viewport(glm::vec2(viewport_min), glm::vec2(viewport_size));
+		const glm::mat4 projection = pixel_projection(glm::vec2(viewport_size));
+		draw_box(renderer, { -10.0f, -10.0f }, { 40.0f, 30.0f }, RED, projection);
+		draw_box(renderer, { 80.0f, 50.0f }, { 150.0f, 120.0f }, GREEN, projection);
+		draw_box(renderer, { 45.0f, 5.0f }, { 55.0f, 15.0f }, BLUE, projection);
+		renderer.set_viewport({ 0.0f, 0.0f }, { WIDTH, HEIGHT });
+	}, golden);
+}
+
+int main() {
+	test_clear();
+	test_quads();
+	test_rects();
+	test_textured_quads();
+	test_tile_edges();
+	test_viewport_scissor();
+	return check_result();
+}
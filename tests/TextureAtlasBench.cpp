@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "TextureAtlas.h"
+
+#include "HeadlessApp.h"
+
+#include <random>
+
+using namespace dvig;
+using SteadyClock = std::chrono::steady_clock;
+
+static double elapsed_ns(SteadyClock::time_point start) {
+	return std::chrono::duration<double, std::nano>(SteadyClock::now() - start).count();
+}
+
+enum class SizeMix {
+	Uniform,     // 8 to 128 on both sides
+	PowerOfTwo,  // Squares from 8 to 64
+	Skewed,      // Glyph and sprite like, mostly small with long thin ones
+};
+
+static std::vector<glm::uvec2> make_sizes(SizeMix mix, uint32_t count) {
+	std::mt19937 rng(42);
+	auto random = [&](uint32_t range) { return static_cast<uint32_t>(rng() % range); };
+
+	std::vector<glm::uvec2> sizes;
+	for (uint32_t i = 0; i < count; i++) {
+		glm::uvec2 size;
+		switch (mix) {
+		case SizeMix::Uniform:
+			size = { 8 + random(121), 8 + random(121) };
+			break;
+		case SizeMix::PowerOfTwo:
+			size = glm::uvec2(8u << random(4));
+			break;
+		case SizeMix::Skewed:
+			size = { 4 + static_cast<uint32_t>(std::exp2(random(1000) / 1000.0 * 5.5)), 4 + random(48) };
+			if (random(2)) {
+				std::swap(size.x, size.y);
+			}
+			break;
+		}
+		sizes.push_back(size);
+	}
+	return sizes;
+}
+
+// Bare packer filling 2048 pages one after another
+static void bench_packer(const char* name, const std::vector<glm::uvec2>& sizes) {
+	std::vector<SkylinePacker> pages;
+	pages.emplace_back(2048, 2048);
+
+	SteadyClock::time_point start = SteadyClock::now();
+	for (glm::uvec2 size : sizes) {
+		glm::uvec2 position;
+		if (!pages.back().insert(size.x, size.y, position)) {
+			pages.emplace_back(2048, 2048);
+			pages.back().insert(size.x, size.y, position);
+		}
+	}
+	double ns = elapsed_ns(start);
+
+	// The last page is only partly filled
+	double occupancy = pages[0].occupancy();
+	if (pages.size() > 1) {
+		occupancy = 0.0;
+		for (size_t i = 0; i + 1 < pages.size(); i++) {
+			occupancy += pages[i].occupancy();
+		}
+		occupancy /= static_cast<double>(pages.size() - 1);
+	}
+
+	std::printf("%-12s packer: %zu pages, full page occupancy %.3f, %.0f ns/insert\n",
+		name, pages.size(), occupancy, ns / static_cast<double>(sizes.size()));
+}
+
+// The whole atlas with padding, CPU copies and sub rect updates, executed every 64 inserts
+static void bench_atlas(const char* name, const std::vector<glm::uvec2>& sizes) {
+	HeadlessApp app(headless_spec());
+	app.run_headless(1);
+
+	TextureAtlasDesc desc;
+	desc.max_pages = 64;
+	TextureAtlas atlas(app.renderer(), desc);
+
+	std::vector<std::vector<uint32_t>> pixels;
+	for (glm::uvec2 size : sizes) {
+		pixels.emplace_back(size.x * size.y, 0xffffffffu);
+	}
+
+	double frame_ns = 0.0;
+	double page_ns = 0.0;
+	SteadyClock::time_point start = SteadyClock::now();
+	for (size_t i = 0; i < sizes.size(); i++) {
+		uint32_t pages_before = atlas.stats().pages;
+		SteadyClock::time_point insert_start = SteadyClock::now();
+		atlas.insert(pixels[i].data(), sizes[i].x, sizes[i].y);
+		if (atlas.stats().pages != pages_before) {
+			page_ns += elapsed_ns(insert_start);
+		}
+
+		if ((i + 1) % 64 == 0) {
+			SteadyClock::time_point frame_start = SteadyClock::now();
+			app.run_headless(1);
+			frame_ns += elapsed_ns(frame_start);
+		}
+	}
+	double insert_ns = elapsed_ns(start) - frame_ns - page_ns;
+	app.run_headless(1);
+
+	TextureAtlasStats stats = atlas.stats();
+	double count = static_cast<double>(sizes.size());
+	std::printf("%-12s atlas:  %u pages, occupancy %.3f, %.0f ns/insert (+%.0f ns executing the updates, %.1f ms per new page), %llu KB uploaded\n",
+		name, stats.pages, static_cast<double>(stats.used_area) / static_cast<double>(stats.page_area),
+		insert_ns / count, frame_ns / count, page_ns / 1e6 / stats.pages,
+		static_cast<unsigned long long>(stats.uploaded_bytes / 1024));
+}
+
+int main() {
+	const std::pair<SizeMix, const char*> mixes[] = {
+		{ SizeMix::Uniform, "uniform" },
+		{ SizeMix::PowerOfTwo, "pow2" },
+		{ SizeMix::Skewed, "skewed" },
+	};
+
+	for (const auto& [mix, name] : mixes) {
+		std::vector<glm::uvec2> sizes = make_sizes(mix, 10000);
+		bench_packer(name, sizes);
+		bench_atlas(name, sizes);
+	}
+	return 0;
+}
@@ -0,0 +1,145 @@
+#include "pch.h"
+#include "UploadRing.h"
+
+#include "Check.h"
+
+using namespace dvig;
+
+static void test_alignment() {
+	UploadRing ring(1024);
+
+	std::optional<UploadAllocation> first = ring.allocate(3, 1);
+	CHECK(first && first->offset == 0 && first->wrapped);
+	CHECK(ring.pass() == 1);
+
+	std::optional<UploadAllocation> aligned = ring.allocate(10, 16);
+	CHECK(aligned && aligned->offset == 16 && !aligned->wrapped);
+
+	std::optional<UploadAllocation> aligned_256 = ring.allocate(1, 256);
+	CHECK(aligned_256 && aligned_256->offset == 256);
+
+	// The padding counts as used
+	CHECK(ring.used() == 257);
+	CHECK(ring.pass() == 1);
+}
+
+static void test_zero_size() {
+	UploadRing ring(256);
+
+	CHECK(!ring.allocate(0, 16));
+	CHECK(ring.pass() == 0 && ring.used() == 0);
+
+	CHECK(ring.allocate(256, 16));
+	ring.end_frame(1);
+	ring.retire(1);
+	CHECK(!ring.allocate(0, 16));
+	CHECK(ring.pass() == 1);
+}
+
+static void test_straddle_wraps() {
+	UploadRing ring(256);
+
+	CHECK(ring.allocate(200, 4));
+	ring.end_frame(1);
+	ring.retire(1);
+
+	// 56 bytes are left at the end, 64 don't fit so they go to 0
+	std::optional<UploadAllocation> straddling = ring.allocate(64, 4);
+	CHECK(straddling && straddling->offset == 0 && straddling->wrapped);
+	CHECK(ring.pass() == 2);
+	CHECK(ring.used() == 56 + 64);
+
+	// Fits exactly at the end without wrapping
+	UploadRing exact(256);
+	CHECK(exact.allocate(192, 4));
+	std::optional<UploadAllocation> tail = exact.allocate(64, 4);
+	CHECK(tail && tail->offset == 192 && !tail->wrapped);
+	CHECK(exact.pass() == 1);
+
+	CHECK(!exact.allocate(257, 1));
+}
+
+static void test_in_flight_frames() {
+	UploadRing ring(256);
+
+	CHECK(ring.allocate(100, 4));
+	ring.end_frame(1);
+	CHECK(ring.allocate(100, 4));
+	ring.end_frame(2);
+	CHECK(ring.frames_in_flight() == 2);
+
+	// Wrapping would overwrite frame 1
+	CHECK(!ring.allocate(100, 4));
+	// The failed allocation didn't move anything
+	CHECK(ring.used() == 200);
+	std::optional<UploadAllocation> rest = ring.allocate(56, 4);
+	CHECK(rest && rest->offset == 200);
+	CHECK(!ring.allocate(1, 1));
+	ring.end_frame(3);
+
+	// Frame 1 is done, its 100 bytes at the start are free again
+	ring.retire(1);
+	CHECK(ring.frames_in_flight() == 2);
+	CHECK(ring.used() == 156);
+	std::optional<UploadAllocation> wrapped = ring.allocate(100, 4);
+	CHECK(wrapped && wrapped->offset == 0 && wrapped->wrapped);
+	CHECK(!ring.allocate(1, 1));
+}
+
+static void test_retire() {
+	UploadRing ring(1024);
+
+	for (uint64_t fence = 1; fence <= 4; fence++) {
+		CHECK(ring.allocate(100, 4));
+		ring.end_frame(fence * 10);
+	}
+	CHECK(ring.used() == 400);
+
+	// Only frames up to and including the fence
+	ring.retire(25);
+	CHECK(ring.frames_in_flight() == 2);
+	CHECK(ring.used() == 200);
+
+	ring.retire(30);
+	CHECK(ring.frames_in_flight() == 1);
+	CHECK(ring.used() == 100);
+
+	ring.retire(1000);
+	CHECK(ring.frames_in_flight() == 0);
+	CHECK(ring.used() == 0);
+}
+
+static void test_reset_after_discard() {
+	UploadRing ring(256);
+
+	CHECK(ring.allocate(100, 4));
+	ring.end_frame(1);
+	CHECK(ring.allocate(100, 4));
+	ring.end_frame(2);
+	CHECK(!ring.allocate(100, 4));
+
+	// A discard gave the buffer new memory, nothing in flight is in the way anymore
+	ring.reset();
+	CHECK(ring.used() == 0 && ring.frames_in_flight() == 0);
+
+	std::optional<UploadAllocation> after = ring.allocate(200, 4);
+	CHECK(after && after->offset == 0 && after->wrapped);
+	CHECK(ring.pass() == 2);
+
+	// Resetting right at the start of a pass doesn't skip a whole ring
+	UploadRing fresh(256);
+	fresh.reset();
+	std::optional<UploadAllocation> first = fresh.allocate(16, 16);
+	CHECK(first && first->offset == 0 && first->wrapped);
+	CHECK(fresh.pass() == 1);
+}
+
+int main() {
+	test_alignment();
+	test_zero_size();
+	test_straddle_wraps();
+	test_in_flight_frames();
+	test_retire();
+	test_reset_after_discard();
+	return check_result();
+}
@@ -0,0 +1,163 @@
+#include "pch.h"
+#include "VertexKernels.h"
+
+#include "Check.h"
+
+#include <random>
+
+using namespace dvig;
+
+// Odd counts around every vector width, so the tails of each path run
+static const uint32_t COUNTS[] = { 0, 1, 2, 3, 5, 7, 9, 15, 17, 31, 33, 63, 65, 1001 };
+// In floats from a 64 byte aligned start, so loads and stores land on every alignment
+static const uint32_t OFFSETS[] = { 0, 1, 2, 3, 5 };
+static const float SENTINEL = -12345.0f;
+
+static std::mt19937 rng(5);
+
+static float random_float(float min, float max) {
+	return std::uniform_real_distribution<float>(min, max)(rng);
+}
+
+static glm::mat4 random_affine() {
+	glm::mat4 transform(1.0f);
+	for (uint32_t column = 0; column < 4; column++) {
+		for (uint32_t row = 0; row < 3; row++) {
+			transform[column][row] = random_float(-3.0f, 3.0f);
+		}
+	}
+	return transform;
+}
+
+static bool same_bits(const void* a, const void* b, size_t size) {
+	return std::memcmp(a, b, size) == 0;
+}
+
+// offset + count + 1 floats, the one after the output is a sentinel that must survive
+struct Floats {
+	std::vector<float, std::allocator<float>> storage;
+	uint32_t offset = 0;
+
+	Floats(uint32_t count, uint32_t offset) : storage(offset + count + 1 + 16, SENTINEL), offset(offset) {}
+
+	float* data() { return storage.data() + offset; }
+	bool tail_intact(uint32_t count) const { return storage[offset + count] == SENTINEL; }
+};
+
+static std::vector<SimdLevel> levels() {
+	std::vector<SimdLevel> result;
+	for (uint32_t level = 0; level <= static_cast<uint32_t>(detect_simd_level()); level++) {
+		result.push_back(static_cast<SimdLevel>(level));
+	}
+	return result;
+}
+
+static void test_transform_points() {
+	for (uint32_t count : COUNTS) {
+		for (uint32_t offset : OFFSETS) {
+			const glm::mat4 transform = offset == 0 ? glm::orthoLH(0.0f, 1280.0f, 720.0f, 0.0f, -1.0f, 1.0f) : random_affine();
+
+			Floats x(count, offset), y(count, offset), z(count, offset);
+			for (uint32_t i = 0; i < count; i++) {
+				x.data()[i] = random_float(-1000.0f, 1000.0f);
+				y.data()[i] = random_float(-1000.0f, 1000.0f);
+				z.data()[i] = random_float(-1000.0f, 1000.0f);
+			}
+
+			// The scalar path against glm, then every other level against the scalar path
+			set_simd_level(SimdLevel::Scalar);
+			Floats scalar_x(count, offset), scalar_y(count, offset), scalar_z(count, offset);
+			transform_points_3d(transform, x.data(), y.data(), z.data(), scalar_x.data(), scalar_y.data(), scalar_z.data(), count);
+			for (uint32_t i = 0; i < count; i++) {
+				const glm::vec4 expected = transform * glm::vec4(x.data()[i], y.data()[i], z.data()[i], 1.0f);
+				CHECK(same_bits(&scalar_x.data()[i], &expected.x, sizeof(float)));
+				CHECK(same_bits(&scalar_y.data()[i], &expected.y, sizeof(float)));
+				CHECK(same_bits(&scalar_z.data()[i], &expected.z, sizeof(float)));
+			}
+
+			Floats scalar_x_2d(count, offset), scalar_y_2d(count, offset);
+			transform_points_2d(transform, x.data(), y.data(), scalar_x_2d.data(), scalar_y_2d.data(), count);
+
+			for (SimdLevel level : levels()) {
+				set_simd_level(level);
+				CHECK(simd_level() == level);
+
+				Floats out_x(count, offset), out_y(count, offset), out_z(count, offset);
+				transform_points_3d(transform, x.data(), y.data(), z.data(), out_x.data(), out_y.data(), out_z.data(), count);
+				CHECK(same_bits(out_x.data(), scalar_x.data(), count * sizeof(float)));
+				CHECK(same_bits(out_y.data(), scalar_y.data(), count * sizeof(float)));
+				CHECK(same_bits(out_z.data(), scalar_z.data(), count * sizeof(float)));
+				CHECK(out_x.tail_intact(count) && out_y.tail_intact(count) && out_z.tail_intact(count));
+
+				Floats out_x_2d(count, offset), out_y_2d(count, offset);
+				transform_points_2d(transform, x.data(), y.data(), out_x_2d.data(), out_y_2d.data(), count);
+				CHECK(same_bits(out_x_2d.data(), scalar_x_2d.data(), count * sizeof(float)));
+				CHECK(same_bits(out_y_2d.data(), scalar_y_2d.data(), count * sizeof(float)));
+				CHECK(out_x_2d.tail_intact(count) && out_y_2d.tail_intact(count));
+
+				// In place
+				Floats in_place_x = x, in_place_y = y;
+				transform_points_2d(transform, in_place_x.data(), in_place_y.data(), in_place_x.data(), in_place_y.data(), count);
+				CHECK(same_bits(in_place_x.data(), scalar_x_2d.data(), count * sizeof(float)));
+				CHECK(same_bits(in_place_y.data(), scalar_y_2d.data(), count * sizeof(float)));
+			}
+		}
+	}
+}
+
+static void test_expand_quads() {
+	for (uint32_t count : COUNTS) {
+		for (uint32_t offset : OFFSETS) {
+			const glm::mat4 transform = random_affine();
+			const glm::vec2 origin = offset % 2 == 0 ? glm::vec2(0.5f) : glm::vec2(0.0f);
+
+			Floats x(count, offset), y(count, offset), width(count, offset), height(count, offset), rotation(count, offset);
+			std::vector<uint32_t> colors(offset + count);
+			for (uint32_t i = 0; i < count; i++) {
+				x.data()[i] = random_float(-1000.0f, 1000.0f);
+				y.data()[i] = random_float(-1000.0f, 1000.0f);
+				width.data()[i] = random_float(-100.0f, 100.0f);
+				height.data()[i] = random_float(-100.0f, 100.0f);
+				rotation.data()[i] = i % 7 == 0 ? 0.0f : random_float(-20.0f, 20.0f);
+				colors[offset + i] = static_cast<uint32_t>(rng());
+			}
+
+			QuadInstances quads;
+			quads.x = x.data();
+			quads.y = y.data();
+			quads.width = width.data();
+			quads.height = height.data();
+			quads.color = colors.data() + offset;
+
+			for (bool rotated : { false, true }) {
+				quads.rotation = rotated ? rotation.data() : nullptr;
+
+				set_simd_level(SimdLevel::Scalar);
+				std::vector<BatchVertex2D> expected(size_t(count) * 4);
+				expand_quads(quads, count, origin, transform, expected.data());
+
+				for (SimdLevel level : levels()) {
+					set_simd_level(level);
+
+					// One vertex past the end is a sentinel, the vertices start unaligned like the inputs
+					std::vector<BatchVertex2D> storage(size_t(count) * 4 + 2);
+					BatchVertex2D* vertices = storage.data() + (offset % 2);
+					const BatchVertex2D sentinel = { { SENTINEL, SENTINEL }, 0xabababab };
+					vertices[size_t(count) * 4] = sentinel;
+
+					expand_quads(quads, count, origin, transform, vertices);
+					CHECK(same_bits(vertices, expected.data(), expected.size() * sizeof(BatchVertex2D)));
+					CHECK(same_bits(&vertices[size_t(count) * 4], &sentinel, sizeof(sentinel)));
+				}
+			}
+		}
+	}
+}
+
+int main() {
+	std::printf("CPU supports %s\n", simd_level_name(detect_simd_level()));
+	test_transform_points();
+	test_expand_quads();
+	set_simd_level(detect_simd_level());
+	return check_result();
+}
@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "World.h"
+#include "CoreComponents.h"
+
+#include <random>
+
+using namespace dvig;
+using SteadyClock = std::chrono::steady_clock;
+
+static double elapsed_ns(SteadyClock::time_point start) {
+	return std::chrono::duration<double, std::nano>(SteadyClock::now() - start).count();
+}
+
+struct Health {
+	float value = 1.0f;
+};
+
+struct Tag {
+	int32_t values[4] = {};
+};
+
+// Transform2D + Velocity2D integration over entity_count entities spread over four archetypes,
+// next to the same update on shuffled heap objects (the usual OO layout)
+static void bench_integrate(uint32_t entity_count) {
+	World world;
+
+	SteadyClock::time_point start = SteadyClock::now();
+	for (uint32_t i = 0; i < entity_count; i++) {
+		Transform2D transform;
+		transform.position.x = static_cast<float>(i);
+		Velocity2D velocity{ glm::vec2(1.0f), 0.1f };
+
+		switch (i % 4) {
+		case 0: world.create(transform, velocity); break;
+		case 1: world.create(transform, velocity, Health{}); break;
+		case 2: world.create(transform, velocity, Drawable{}); break;
+		default: world.create(transform, velocity, Tag{}); break;
+		}
+	}
+	double create_ns = elapsed_ns(start);
+
+	const uint32_t repeats = std::max(3u, 20000000u / entity_count);
+	const float dt = 0.01f;
+
+	integrate_velocities(world, dt);
+	start = SteadyClock::now();
+	for (uint32_t repeat = 0; repeat < repeats; repeat++) {
+		integrate_velocities(world, dt);
+	}
+	double chunk_ns = elapsed_ns(start) / repeats;
+
+	start = SteadyClock::now();
+	for (uint32_t repeat = 0; repeat < repeats; repeat++) {
+		world.each<Transform2D, const Velocity2D>([dt](Transform2D& transform, const Velocity2D& velocity) {
+			transform.position += velocity.linear * dt;
+			transform.rotation += velocity.angular * dt;
+		});
+	}
+	double each_ns = elapsed_ns(start) / repeats;
+
+	struct Object {
+		Transform2D transform;
+		Velocity2D velocity;
+		Drawable drawable;
+		Health health;
+	};
+
+	std::vector<Unique<Object>> objects(entity_count);
+	std::vector<Object*> shuffled(entity_count);
+	for (uint32_t i = 0; i < entity_count; i++) {
+		objects[i] = std::make_unique<Object>();
+		shuffled[i] = objects[i].get();
+	}
+	std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1));
+
+	start = SteadyClock::now();
+	for (uint32_t repeat = 0; repeat < repeats; repeat++) {
+		for (Object* object : shuffled) {
+			object->transform.position += object->velocity.linear * dt;
+			object->transform.rotation += object->velocity.angular * dt;
+		}
+	}
+	double objects_ns = elapsed_ns(start) / repeats;
+
+	double count = static_cast<double>(entity_count);
+	std::printf("%8u entities: create %.1f ns/e, integrate_velocities %.2f ns/e, each %.2f ns/e, shuffled objects %.2f ns/e\n",
+		entity_count, create_ns / count, chunk_ns / count, each_ns / count, objects_ns / count);
+}
+
+int main() {
+	for (uint32_t entity_count : { 10000u, 100000u, 1000000u }) {
+		bench_integrate(entity_count);
+	}
+	return 0;
+}